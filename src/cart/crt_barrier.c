@@ -36,11 +36,15 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /**
- * This file is part of CaRT. It implements the barrier APIs.
+ * This file is part of CaRT. It implements the barrier APIs, see
+ * crt_barrier.h for the algorithm.
  */
 #define D_LOGFAC	DD_FAC(grp)
 
 #include "crt_internal.h"
+
+static int crt_barrier_send_rpc(struct crt_barrier_msg *msg);
+
 int
 crt_barrier_info_init(struct crt_grp_priv *grp_priv)
 {
@@ -54,14 +58,14 @@ crt_barrier_info_init(struct crt_grp_priv *grp_priv)
 	if (rc != 0)
 		D_GOTO(exit, rc);
 
-	/* Default barrier master is the lowest numbered rank.  At startup,
-	 * it's index 0.  It gets updated in crt_barrier_update_master
-	 */
-	if (grp_priv->gp_membs == NULL)
-		info->bi_master_pri_rank = 0;
-	else
-		info->bi_master_pri_rank = grp_priv->gp_membs->rl_ranks[0];
-	info->bi_master_idx = 0;
+	D_INIT_LIST_HEAD(&info->bi_barriers);
+	D_INIT_LIST_HEAD(&info->bi_resend);
+	info->bi_resend_cb = false;
+	info->bi_live = NULL;
+	info->bi_ver = 0;
+	info->bi_num_created = 0;
+	info->bi_num_exited = 0;
+	info->bi_send = crt_barrier_send_rpc;
 	if (grp_priv->gp_primary)
 		info->bi_primary_grp = grp_priv;
 	else {
@@ -75,12 +79,6 @@ crt_barrier_info_init(struct crt_grp_priv *grp_priv)
 		info->bi_primary_grp = container_of(grp, struct crt_grp_priv,
 						    gp_pub);
 	}
-
-	/* Eventually, this will be handled by a flag passed to the corpc
-	 * routine but until then, create a list to exclude self from broadcast
-	 */
-	info->bi_exclude_self.rl_nr = 1;
-	info->bi_exclude_self.rl_ranks = &info->bi_primary_grp->gp_self;
 exit:
 	return rc;
 }
@@ -88,377 +86,610 @@ exit:
 void
 crt_barrier_info_destroy(struct crt_grp_priv *grp_priv)
 {
-	D_MUTEX_DESTROY(&grp_priv->gp_barrier_info.bi_lock);
+	struct crt_barrier_info	*info;
+	struct crt_barrier	*ab, *next;
+	struct crt_barrier_msg	*msg, *next_msg;
+
+	info = &grp_priv->gp_barrier_info;
+	d_list_for_each_entry_safe(ab, next, &info->bi_barriers, b_link) {
+		d_list_del(&ab->b_link);
+		D_FREE_PTR(ab);
+	}
+	d_list_for_each_entry_safe(msg, next_msg, &info->bi_resend, bm_link) {
+		d_list_del(&msg->bm_link);
+		D_FREE_PTR(msg);
+	}
+	d_rank_list_free(info->bi_live);
+	info->bi_live = NULL;
+	D_MUTEX_DESTROY(&info->bi_lock);
 }
 
-/* Update the master rank.  Returns true if the master has changed since
- * the last update.
- */
-bool
-crt_barrier_update_master(struct crt_grp_priv *grp_priv)
+/* Find barrier b_num, allocating it if create is set. Called with bi_lock */
+static struct crt_barrier *
+crt_barrier_lookup_locked(struct crt_barrier_info *info, uint64_t b_num,
+			  bool create)
 {
-	struct crt_barrier_info		*info;
-	struct crt_grp_priv		*primary_grp;
-	d_rank_t			 rank;
-	bool				 new_master = false;
-	int				 i;
+	struct crt_barrier	*ab;
+	d_list_t		*pos;
+
+	/* the list is sorted and new barriers are usually the last ones */
+	for (pos = info->bi_barriers.prev; pos != &info->bi_barriers;
+	     pos = pos->prev) {
+		ab = d_list_entry(pos, struct crt_barrier, b_link);
+		if (ab->b_num == b_num)
+			return ab;
+		if (ab->b_num < b_num)
+			break;
+	}
 
-	info = &grp_priv->gp_barrier_info;
+	if (!create)
+		return NULL;
 
-	primary_grp = info->bi_primary_grp;
+	D_ALLOC_PTR(ab);
+	if (ab == NULL)
+		return NULL;
+	ab->b_num = b_num;
+	ab->b_ver = info->bi_ver;
+	ab->b_recv_ver = info->bi_ver;
+	d_list_add(&ab->b_link, pos);
 
-	D_MUTEX_LOCK(&info->bi_lock);
+	return ab;
+}
 
-	D_RWLOCK_RDLOCK(primary_grp->gp_rwlock_ft);
-	if (!d_rank_in_rank_list(grp_priv->gp_live_ranks,
-				 info->bi_master_pri_rank)) {
-		rank = -1;
-		/* Master has failed */
-		new_master = true;
-		for (i = info->bi_master_idx + 1;
-		     i < grp_priv->gp_membs->rl_nr; i++) {
-			rank = grp_priv->gp_membs->rl_ranks[i];
-			if (d_rank_in_rank_list(grp_priv->gp_live_ranks, rank))
-				break;
-		}
+static int
+crt_barrier_queue_msg(d_list_t *msgs, d_rank_t rank, uint64_t b_num,
+		      uint32_t ver, uint32_t round)
+{
+	struct crt_barrier_msg	*msg;
 
-		/* This should be impossible since the current rank, at least,
-		 * is still alive and can be the master.
-		 */
-		D_ASSERTF(i != grp_priv->gp_membs->rl_nr,
-			  "No more ranks for barrier");
-		D_ASSERTF(rank != -1, "No more ranks for barrier");
-		info->bi_master_pri_rank = rank;
-		info->bi_master_idx = i;
+	D_ALLOC_PTR(msg);
+	if (msg == NULL)
+		return -DER_NOMEM;
+
+	msg->bm_rank = rank;
+	msg->bm_in.b_num = b_num;
+	msg->bm_in.b_ver = ver;
+	msg->bm_in.b_round = round;
+	d_list_add_tail(&msg->bm_link, msgs);
+
+	return 0;
+}
+
+/* rank notified by this rank in the given round */
+static inline d_rank_t
+crt_barrier_peer(struct crt_barrier_info *info, uint32_t round)
+{
+	uint32_t	nr = info->bi_live->rl_nr;
+
+	return info->bi_live->rl_ranks[(info->bi_self_idx +
+					(1ULL << round) % nr) % nr];
+}
+
+/*
+ * Send the rounds whose previous round was received, restarting them if the
+ * membership changed, and mark the barrier done after the last one. Called
+ * with bi_lock, the notifications are queued on msgs.
+ */
+static void
+crt_barrier_progress_locked(struct crt_barrier_info *info,
+			    struct crt_barrier *ab, d_list_t *msgs)
+{
+	uint64_t	all = (1ULL << info->bi_rounds) - 1;
+	uint64_t	recv;
+	int		rc;
+
+	if (!ab->b_active || ab->b_done)
+		return;
+
+	if (ab->b_ver != info->bi_ver) {
+		D_DEBUG(DB_TRACE, "barrier "DF_U64" restarts at version %u\n",
+			ab->b_num, info->bi_ver);
+		ab->b_ver = info->bi_ver;
+		ab->b_round = 0;
+		ab->b_restarted = true;
+	}
+	/* receipts from an older version are stale, newer ones are kept */
+	if (ab->b_recv_ver < info->bi_ver) {
+		ab->b_recv = 0;
+		ab->b_recv_ver = info->bi_ver;
+	}
+	recv = ab->b_recv_ver == info->bi_ver ? ab->b_recv : 0;
+
+	while (ab->b_round < info->bi_rounds &&
+	       (ab->b_round == 0 || recv & (1ULL << (ab->b_round - 1)))) {
+		rc = crt_barrier_queue_msg(msgs,
+					   crt_barrier_peer(info, ab->b_round),
+					   ab->b_num, ab->b_ver, ab->b_round);
+		if (rc != 0) {
+			D_ERROR("barrier "DF_U64" failed, rc: %d\n",
+				ab->b_num, rc);
+			ab->b_rc = rc;
+			ab->b_done = true;
+			return;
+		}
+		ab->b_round++;
 	}
 
-	D_RWLOCK_UNLOCK(primary_grp->gp_rwlock_ft);
-	D_MUTEX_UNLOCK(&info->bi_lock);
+	if (ab->b_round == info->bi_rounds && (recv & all) == all)
+		ab->b_done = true;
+}
 
-	return new_master;
+/* Tell the peers of all rounds, on both sides, that barrier b_num completed */
+static void
+crt_barrier_flood_locked(struct crt_barrier_info *info, uint64_t b_num,
+			 d_list_t *msgs)
+{
+	uint32_t	nr = info->bi_live->rl_nr;
+	uint32_t	round;
+	d_rank_t	pred;
+	int		rc = 0;
+
+	for (round = 0; round < info->bi_rounds && rc == 0; round++) {
+		pred = info->bi_live->rl_ranks[(info->bi_self_idx + nr -
+						(1ULL << round) % nr) % nr];
+		rc = crt_barrier_queue_msg(msgs, crt_barrier_peer(info, round),
+					   b_num, info->bi_ver,
+					   CRT_BARRIER_ROUND_DONE);
+		if (rc == 0)
+			rc = crt_barrier_queue_msg(msgs, pred, b_num,
+						   info->bi_ver,
+						   CRT_BARRIER_ROUND_DONE);
+	}
+	if (rc != 0)
+		D_ERROR("barrier "DF_U64" notification failed, rc: %d\n",
+			b_num, rc);
 }
 
-/* Callback for enter broadcast
- * All non-master ranks execute this callback
+/*
+ * Another rank told that barrier b_num completed, which means that all ranks
+ * arrived in it and in all barriers before it. Pass it on if it is news so
+ * that the ranks that restarted these barriers after an eviction learn it too.
  */
-void
-crt_hdlr_barrier_enter(crt_rpc_t *rpc_req)
+static void
+crt_barrier_learn_done_locked(struct crt_barrier_info *info, uint64_t b_num,
+			      d_list_t *msgs)
 {
-	struct crt_barrier_in		*in;
-	struct crt_barrier_out		*out;
-	struct crt_barrier		*ab;
-	struct crt_barrier_info		*barrier_info = NULL;
-	struct crt_grp_priv		*grp_priv;
-	int				rc = 0;
+	struct crt_barrier	*ab;
+	bool			 learned = false;
+
+	d_list_for_each_entry(ab, &info->bi_barriers, b_link) {
+		if (ab->b_num > b_num)
+			break;
+		if (!ab->b_done) {
+			ab->b_done = true;
+			learned = true;
+		}
+	}
+	if (!learned)
+		return;
 
-	in = crt_req_get(rpc_req);
-	D_ASSERT(in != NULL);
+	D_DEBUG(DB_TRACE, "barrier "DF_U64" completed remotely\n", b_num);
+	crt_barrier_flood_locked(info, b_num, msgs);
+}
 
-	if (rpc_req->cr_ep.ep_grp == NULL)
-		grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
-	else
-		grp_priv = container_of(rpc_req->cr_ep.ep_grp,
-					struct crt_grp_priv, gp_pub);
+/* Move the barriers to complete, in order, to done_list. Called with bi_lock */
+static void
+crt_barrier_complete_locked(struct crt_barrier_info *info, d_list_t *done_list)
+{
+	struct crt_barrier	*ab;
 
-	if (grp_priv == NULL) {
-		D_ERROR("crt_hdlr_barrier_enter failed, no group\n");
-		D_GOTO(send_reply, rc = -DER_NONEXIST);
+	while (!d_list_empty(&info->bi_barriers)) {
+		ab = d_list_entry(info->bi_barriers.next, struct crt_barrier,
+				  b_link);
+		if (ab->b_num != info->bi_num_exited + 1 || !ab->b_active ||
+		    !ab->b_done)
+			break;
+		info->bi_num_exited = ab->b_num;
+		d_list_move_tail(&ab->b_link, done_list);
 	}
+}
 
-	barrier_info = &grp_priv->gp_barrier_info;
+/*
+ * Schedule the resend of msg, which failed with rc, or fail its barrier after
+ * CRT_BARRIER_SEND_RETRY resends. msg is freed unless it is resent, the
+ * barriers to complete are moved to done_list.
+ */
+static void
+crt_barrier_send_failed(struct crt_barrier_msg *msg, int rc,
+			d_list_t *done_list)
+{
+	struct crt_barrier_info	*info = msg->bm_info;
+	struct crt_barrier	*ab;
 
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
+	D_MUTEX_LOCK(&info->bi_lock);
+	/*
+	 * resend unless the membership changed meanwhile, even if the
+	 * barrier completed here the peer may still wait for it.
+	 */
+	if (msg->bm_in.b_ver != info->bi_ver)
+		D_GOTO(unlock, 0);
+
+	if (msg->bm_retry < CRT_BARRIER_SEND_RETRY) {
+		D_DEBUG(DB_TRACE, "barrier "DF_U64" round %u to rank %d "
+			"failed, rc: %d, resending\n", msg->bm_in.b_num,
+			msg->bm_in.b_round, msg->bm_rank, rc);
+		msg->bm_resend_ts = d_timeus_secdiff(0) +
+				    ((uint64_t)CRT_BARRIER_RESEND_US <<
+				     msg->bm_retry);
+		msg->bm_retry++;
+		d_list_add_tail(&msg->bm_link, &info->bi_resend);
+		D_MUTEX_UNLOCK(&info->bi_lock);
+		return;
+	}
 
-	D_DEBUG(DB_TRACE, "barrier enter msg received for %d\n", in->b_num);
+	D_ERROR("barrier "DF_U64" send to rank %d failed, rc: %d\n",
+		msg->bm_in.b_num, msg->bm_rank, rc);
+	ab = crt_barrier_lookup_locked(info, msg->bm_in.b_num, false);
+	if (ab != NULL && ab->b_active && !ab->b_done) {
+		ab->b_rc = rc;
+		ab->b_done = true;
+		crt_barrier_complete_locked(info, done_list);
+	}
+unlock:
+	D_MUTEX_UNLOCK(&info->bi_lock);
+	D_FREE_PTR(msg);
+}
 
-	if (barrier_info->bi_num_exited >= in->b_num) {
-		/* It's a duplicate.   Send the reply again */
-		D_GOTO(send_reply, rc = 0);
+/* Send the queued notifications and run the completion callbacks */
+static void
+crt_barrier_flush(struct crt_barrier_info *info, d_list_t *msgs,
+		  d_list_t *done_list)
+{
+	struct crt_barrier_cb_info	 cb_info;
+	struct crt_barrier_msg		*msg;
+	struct crt_barrier		*ab, *next;
+	int				 rc;
+
+	while (!d_list_empty(msgs)) {
+		msg = d_list_entry(msgs->next, struct crt_barrier_msg,
+				   bm_link);
+		d_list_del(&msg->bm_link);
+		msg->bm_info = info;
+		rc = info->bi_send(msg);
+		if (rc != 0)
+			crt_barrier_send_failed(msg, rc, done_list);
 	}
 
-	ab = &barrier_info->bi_barriers[in->b_num % CRT_MAX_BARRIER_INFLIGHT];
+	d_list_for_each_entry_safe(ab, next, done_list, b_link) {
+		d_list_del(&ab->b_link);
+		D_DEBUG(DB_TRACE, "barrier "DF_U64" complete, rc: %d\n",
+			ab->b_num, ab->b_rc);
+		cb_info.bci_rc = ab->b_rc;
+		cb_info.bci_arg = ab->b_arg;
+		ab->b_complete_cb(&cb_info);
+		D_FREE_PTR(ab);
+	}
+}
 
-	if (!ab->b_active) {
-		/* Local node hasn't arrived yet */
-		ab->b_enter_rpc = rpc_req;
-		/* decref in crt_barrier */
-		RPC_PUB_ADDREF(rpc_req);
-		D_MUTEX_UNLOCK(&barrier_info->bi_lock);
+void
+crt_barrier_set_live(struct crt_barrier_info *info, d_rank_list_t *live,
+		     d_rank_t self, uint32_t ver)
+{
+	struct crt_barrier	*ab;
+	d_list_t		 msgs;
+	d_list_t		 done_list;
+	uint64_t		 done;
+	uint32_t		 idx;
+	bool			 restart;
+
+	D_ASSERT(live != NULL && live->rl_nr > 0);
+	D_INIT_LIST_HEAD(&msgs);
+	D_INIT_LIST_HEAD(&done_list);
+
+	for (idx = 0; idx < live->rl_nr; idx++)
+		if (live->rl_ranks[idx] == self)
+			break;
+	if (idx == live->rl_nr) {
+		D_ERROR("rank %d not live at version %u\n", self, ver);
+		d_rank_list_free(live);
+		return;
+	}
+
+	D_MUTEX_LOCK(&info->bi_lock);
+	/* racing updates, keep the newest */
+	if (info->bi_live != NULL && ver <= info->bi_ver) {
+		D_MUTEX_UNLOCK(&info->bi_lock);
+		d_rank_list_free(live);
 		return;
 	}
 
-	/* Local node already arrived.   Send a reply.  This could happen
-	 * more than once in presence of node failures but it doesn't matter.
+	restart = info->bi_live != NULL;
+	d_rank_list_free(info->bi_live);
+	info->bi_live = live;
+	info->bi_ver = ver;
+	info->bi_self_idx = idx;
+	for (info->bi_rounds = 0; (1ULL << info->bi_rounds) < live->rl_nr;
+	     info->bi_rounds++)
+		;
+
+	done = info->bi_num_exited;
+	d_list_for_each_entry(ab, &info->bi_barriers, b_link) {
+		if (ab->b_done && ab->b_rc == 0)
+			done = ab->b_num;
+		crt_barrier_progress_locked(info, ab, &msgs);
+	}
+	/*
+	 * the peers at the new version may restart barriers this rank already
+	 * completed and wait for it in vain, tell them.
 	 */
-send_reply:
+	if (restart && done > 0)
+		crt_barrier_flood_locked(info, done, &msgs);
+	crt_barrier_complete_locked(info, &done_list);
+	D_MUTEX_UNLOCK(&info->bi_lock);
 
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
-	out = crt_reply_get(rpc_req);
-	D_ASSERT(out != NULL);
+	crt_barrier_flush(info, &msgs, &done_list);
+}
 
-	out->b_rc = rc;
+int
+crt_barrier_enter(struct crt_barrier_info *info, crt_barrier_cb_t complete_cb,
+		  void *cb_arg)
+{
+	struct crt_barrier	*ab;
+	d_list_t		 msgs;
+	d_list_t		 done_list;
 
-	rc = crt_reply_send(rpc_req);
+	D_INIT_LIST_HEAD(&msgs);
+	D_INIT_LIST_HEAD(&done_list);
 
-	/* If the reply is lost, timeout will try again */
-	if (rc != 0)
-		D_ERROR("Could not send reply for barrier broadcast,rc = %d\n",
-			rc);
+	D_MUTEX_LOCK(&info->bi_lock);
+	if (info->bi_live == NULL) {
+		D_MUTEX_UNLOCK(&info->bi_lock);
+		return -DER_UNINIT;
+	}
+
+	/* other ranks may have started it already */
+	ab = crt_barrier_lookup_locked(info, info->bi_num_created + 1, true);
+	if (ab == NULL) {
+		D_MUTEX_UNLOCK(&info->bi_lock);
+		return -DER_NOMEM;
+	}
+	info->bi_num_created++;
+	ab->b_active = true;
+	ab->b_complete_cb = complete_cb;
+	ab->b_arg = cb_arg;
+	D_DEBUG(DB_TRACE, "barrier "DF_U64" started\n", ab->b_num);
+
+	crt_barrier_progress_locked(info, ab, &msgs);
+	crt_barrier_complete_locked(info, &done_list);
+	D_MUTEX_UNLOCK(&info->bi_lock);
+
+	crt_barrier_flush(info, &msgs, &done_list);
+
+	return 0;
 }
 
-/* Callback for exit broadcast signalling that all ranks have arrived
- * All non-master ranks execute this callback
- */
 void
-crt_hdlr_barrier_exit(crt_rpc_t *rpc_req)
+crt_barrier_recv(struct crt_barrier_info *info,
+		 const struct crt_barrier_in *in, struct crt_barrier_out *out)
 {
-	crt_barrier_cb_t		complete_cb = NULL;
-	struct crt_barrier_cb_info	cb_info;
-	struct crt_barrier_in		*in;
-	struct crt_barrier_out		*out;
-	struct crt_barrier		*ab = NULL;
-	struct crt_barrier_info		*barrier_info = NULL;
-	struct crt_grp_priv		*grp_priv;
-	int				rc = 0;
+	struct crt_barrier	*ab;
+	d_list_t		 msgs;
+	d_list_t		 done_list;
 
-	in = crt_req_get(rpc_req);
-	out = crt_reply_get(rpc_req);
-	D_ASSERT(in != NULL && out != NULL);
+	D_INIT_LIST_HEAD(&msgs);
+	D_INIT_LIST_HEAD(&done_list);
+	out->b_rc = 0;
+	out->b_done = 0;
 
-	if (rpc_req->cr_ep.ep_grp == NULL)
-		grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
-	else
-		grp_priv = container_of(rpc_req->cr_ep.ep_grp,
-					struct crt_grp_priv, gp_pub);
+	D_DEBUG(DB_TRACE, "barrier "DF_U64" round %u version %u received\n",
+		in->b_num, in->b_round, in->b_ver);
 
-	if (grp_priv == NULL) {
-		D_ERROR("crt_barrier_enter failed, no group\n");
-		D_GOTO(send_reply, rc = -DER_NONEXIST);
+	D_MUTEX_LOCK(&info->bi_lock);
+	if (in->b_num <= info->bi_num_exited) {
+		out->b_done = 1;
+		D_GOTO(unlock, 0);
 	}
 
-	barrier_info = &grp_priv->gp_barrier_info;
-	D_DEBUG(DB_TRACE, "barrier exit msg received for %d\n", in->b_num);
+	if (in->b_round == CRT_BARRIER_ROUND_DONE) {
+		crt_barrier_learn_done_locked(info, in->b_num, &msgs);
+		out->b_done = 1;
+		D_GOTO(complete, 0);
+	}
 
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
+	ab = crt_barrier_lookup_locked(info, in->b_num, true);
+	if (ab == NULL) {
+		out->b_rc = -DER_NOMEM;
+		D_GOTO(unlock, 0);
+	}
 
-	if (barrier_info->bi_num_exited >= in->b_num) {
-		/* Duplicate message.  Send reply again */
-		D_DEBUG(DB_TRACE, "barrier exit msg %d is duplcate\n",
-			in->b_num);
-		D_GOTO(send_reply, rc = 0);
+	if (in->b_round < 64) {
+		if (in->b_ver > ab->b_recv_ver) {
+			ab->b_recv = 0;
+			ab->b_recv_ver = in->b_ver;
+		}
+		/* notifications of an older version are ignored */
+		if (in->b_ver == ab->b_recv_ver)
+			ab->b_recv |= 1ULL << in->b_round;
+		crt_barrier_progress_locked(info, ab, &msgs);
 	}
+	out->b_done = ab->b_done && ab->b_rc == 0;
 
-	/* Only record a new number if this isn't a replay */
-	if (in->b_num > barrier_info->bi_num_exited)
-		barrier_info->bi_num_exited = in->b_num;
+complete:
+	crt_barrier_complete_locked(info, &done_list);
+unlock:
+	D_MUTEX_UNLOCK(&info->bi_lock);
 
-	ab = &barrier_info->bi_barriers[in->b_num % CRT_MAX_BARRIER_INFLIGHT];
-	ab->b_active = false;
-	complete_cb = ab->b_complete_cb;
-	cb_info.bci_rc = 0;
-	cb_info.bci_arg = ab->b_arg;
-	complete_cb = ab->b_complete_cb;
-	ab->b_complete_cb = NULL;
-	ab->b_arg = NULL;
-send_reply:
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
+	crt_barrier_flush(info, &msgs, &done_list);
+}
+
+void
+crt_barrier_sent(struct crt_barrier_msg *msg, int rc,
+		 const struct crt_barrier_out *out)
+{
+	struct crt_barrier_info	*info = msg->bm_info;
+	struct crt_barrier	*ab;
+	d_list_t		 msgs;
+	d_list_t		 done_list;
 
-	if (complete_cb != NULL) {
-		/* Execute completion callback */
-		complete_cb(&cb_info);
+	D_INIT_LIST_HEAD(&msgs);
+	D_INIT_LIST_HEAD(&done_list);
+	if (rc == 0)
+		rc = out->b_rc;
+	if (rc != 0) {
+		crt_barrier_send_failed(msg, rc, &done_list);
+		D_GOTO(out, 0);
 	}
 
-	out->b_rc = rc;
-	rc = crt_reply_send(rpc_req);
+	/*
+	 * without a restart the peers that completed do not stop this rank
+	 * from completing, no need to pass it on.
+	 */
+	D_MUTEX_LOCK(&info->bi_lock);
+	ab = crt_barrier_lookup_locked(info, msg->bm_in.b_num, false);
+	if (ab == NULL || !ab->b_restarted || !out->b_done)
+		D_GOTO(unlock, 0);
 
-	/* If the reply is lost, timeout will try again */
-	if (rc != 0)
-		D_ERROR("Could not send reply for barrier broadcast,rc = %d\n",
-			rc);
+	crt_barrier_learn_done_locked(info, msg->bm_in.b_num, &msgs);
+	crt_barrier_complete_locked(info, &done_list);
+unlock:
+	D_MUTEX_UNLOCK(&info->bi_lock);
+	D_FREE_PTR(msg);
+out:
+	crt_barrier_flush(info, &msgs, &done_list);
 }
 
-int
-crt_hdlr_barrier_aggregate(crt_rpc_t *source, crt_rpc_t *result, void *arg)
+void
+crt_barrier_resend(struct crt_barrier_info *info, uint64_t now)
 {
-	int	*reply_source, *reply_result;
+	struct crt_barrier_msg	*msg, *next;
+	d_list_t		 msgs;
+	d_list_t		 done_list;
 
-	D_ASSERT(source != NULL && result != NULL);
-	reply_source = crt_reply_get(source);
-	reply_result = crt_reply_get(result);
-	D_ASSERT(reply_source != NULL && reply_result != NULL);
-	if (*reply_result == 0)
-		*reply_result = *reply_source;
+	D_INIT_LIST_HEAD(&msgs);
+	D_INIT_LIST_HEAD(&done_list);
 
-	return 0;
+	D_MUTEX_LOCK(&info->bi_lock);
+	d_list_for_each_entry_safe(msg, next, &info->bi_resend, bm_link) {
+		if (msg->bm_in.b_ver != info->bi_ver) {
+			d_list_del(&msg->bm_link);
+			D_FREE_PTR(msg);
+		} else if (msg->bm_resend_ts <= now) {
+			d_list_move_tail(&msg->bm_link, &msgs);
+		}
+	}
+	D_MUTEX_UNLOCK(&info->bi_lock);
+
+	crt_barrier_flush(info, &msgs, &done_list);
 }
 
-/* The barrier master sends broadcast messages to other ranks signaling
- * start or completion of the barrier.  It is assumes the following about
- * broadcast:
- *
- * 1. Group membership changes will be handled internally and completion
- * callback is only invoked when all current members have received the
- * message.
- * 2. Failed ranks are automatically excluded
- *
- * Neither condition is true today.
- */
-static void
-send_barrier_msg(struct crt_grp_priv *grp_priv, int b_num,
-		 crt_cb_t complete_cb, int opcode)
+/* Rebuild the live rank list of the barrier if the membership changed */
+static int
+crt_barrier_live_update(struct crt_grp_priv *grp_priv)
 {
-	crt_rpc_t			*rpc_req;
-	crt_barrier_cb_t		b_complete = NULL;
-	struct crt_barrier_cb_info	cb_info;
-	struct crt_barrier		*ab;
-	struct crt_barrier_info		*barrier_info;
-	struct crt_barrier_in		*in;
-	crt_context_t			crt_ctx;
-	int				rc;
+	struct crt_barrier_info	*info;
+	struct crt_grp_priv	*primary_grp;
+	d_rank_list_t		*live;
+	d_rank_t		 rank;
+	uint32_t		 ver;
+	uint32_t		 nr;
+	uint32_t		 i;
+	bool			 uptodate;
 
-	/* Context 0 is required and this condition is checked in
-	 * crt_barrier_create so assertion is fine.
-	 */
-	crt_ctx = crt_context_lookup(0);
-	D_ASSERT(crt_ctx != CRT_CONTEXT_NULL);
-	D_DEBUG(DB_TRACE, "Sending barrier message for %d (OPC=%d)\n",
-		b_num, opcode);
+	info = &grp_priv->gp_barrier_info;
+	primary_grp = info->bi_primary_grp;
 
-	/* TODO: Eventually, there will be a flag to exclude self from
-	 * from the broadcast.  Until then, the rank list including
-	 * self will suffice.
-	 */
-	/* TODO: Tree topology changed for now to KARY due to CART-348 */
-	rc = crt_corpc_req_create(crt_ctx, &grp_priv->gp_pub,
-			     &grp_priv->gp_barrier_info.bi_exclude_self,
-			     opcode, NULL, NULL, 0,
-			     crt_tree_topo(CRT_TREE_KARY, 4), &rpc_req);
-
-	/* If this fails, we have nothing to do but fail the barrier
-	 * and let the user deal with it
-	 */
-	if (rc != 0) {
-		D_ERROR("Failed to create barrier opc %d rpc, rc = %d",
-			opcode, rc);
-		D_GOTO(handle_error, rc);
+	D_RWLOCK_RDLOCK(primary_grp->gp_rwlock_ft);
+	ver = grp_priv->gp_membs_ver;
+
+	D_MUTEX_LOCK(&info->bi_lock);
+	uptodate = info->bi_live != NULL && info->bi_ver == ver;
+	D_MUTEX_UNLOCK(&info->bi_lock);
+	if (uptodate) {
+		D_RWLOCK_UNLOCK(primary_grp->gp_rwlock_ft);
+		return 0;
 	}
-	D_DEBUG(DB_TRACE, "Created req for %d\n", b_num);
-	in = crt_req_get(rpc_req);
 
-	in->b_num = b_num;
+	nr = grp_priv->gp_membs != NULL ? grp_priv->gp_membs->rl_nr :
+					   grp_priv->gp_size;
+	live = d_rank_list_alloc(nr);
+	if (live == NULL) {
+		D_RWLOCK_UNLOCK(primary_grp->gp_rwlock_ft);
+		return -DER_NOMEM;
+	}
 
-	rc = crt_req_send(rpc_req, complete_cb, NULL);
+	live->rl_nr = 0;
+	for (i = 0; i < nr; i++) {
+		rank = grp_priv->gp_membs != NULL ?
+		       grp_priv->gp_membs->rl_ranks[i] : i;
+		if (grp_priv->gp_live_set == NULL ||
+		    d_rank_set_has(grp_priv->gp_live_set, rank))
+			live->rl_ranks[live->rl_nr++] = rank;
+	}
+	D_RWLOCK_UNLOCK(primary_grp->gp_rwlock_ft);
 
-	D_DEBUG(DB_TRACE, "Sent req for %d\n", b_num);
-	if (rc != 0) {
-		D_ERROR("Failed to send barrier opc %d rpc, rc = %d",
-			opcode, rc);
-		D_GOTO(handle_error, rc);
-	}
-	return;
-handle_error:
-	barrier_info = &grp_priv->gp_barrier_info;
-	D_ERROR("Critical failure in barrier master, rc = %d\n", rc);
-	/* Assume all errors in this function are unrecoverable */
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
-	ab = &barrier_info->bi_barriers[b_num % CRT_MAX_BARRIER_INFLIGHT];
-	ab->b_active = false;
-	cb_info.bci_rc = rc;
-	cb_info.bci_arg = ab->b_arg;
-	b_complete = ab->b_complete_cb;
-	ab->b_complete_cb = NULL;
-	ab->b_arg = NULL;
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
-
-	if (b_complete != NULL)
-		b_complete(&cb_info);
+	crt_barrier_set_live(info, live, grp_priv->gp_self, ver);
+
+	return 0;
 }
 
 static void
-barrier_exit_cb(const struct crt_cb_info *cb_info)
+crt_barrier_send_cb(const struct crt_cb_info *cb_info)
 {
-	struct crt_grp_priv		*grp_priv;
-	struct crt_barrier		*ab;
-	struct crt_barrier_info		*barrier_info;
-	struct crt_barrier_in		*in;
-	struct crt_barrier_out		*out;
-	crt_barrier_cb_t		complete_cb = NULL;
-	struct crt_barrier_cb_info	info;
-	crt_rpc_t			*rpc_req;
-	int				b_num;
-
-	rpc_req = cb_info->cci_rpc;
-
-	out = crt_reply_get(rpc_req);
-	in = crt_req_get(rpc_req);
+	crt_barrier_sent(cb_info->cci_arg, cb_info->cci_rc,
+			 cb_info->cci_rc == 0 ?
+			 crt_reply_get(cb_info->cci_rpc) : NULL);
+}
 
-	if (rpc_req->cr_ep.ep_grp == NULL)
-		grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
-	else
-		grp_priv = container_of(rpc_req->cr_ep.ep_grp,
-					struct crt_grp_priv, gp_pub);
-	D_ASSERT(grp_priv != NULL);
+/* Resend the failed notifications that are due, on the progress of context 0 */
+static void
+crt_barrier_prog_cb(crt_context_t crt_ctx, void *arg)
+{
+	int	ctx_idx;
 
-	if (cb_info->cci_rc != 0 || out->b_rc != 0) {
-		/* Resend the exit message */
-		send_barrier_msg(grp_priv, in->b_num, barrier_exit_cb,
-				 CRT_OPC_BARRIER_EXIT);
+	if (crt_context_idx(crt_ctx, &ctx_idx) != 0 || ctx_idx != 0)
 		return;
-	}
-	D_DEBUG(DB_TRACE, "Exit phase complete for %d\n", in->b_num);
 
-	barrier_info = &grp_priv->gp_barrier_info;
-	ab = &barrier_info->bi_barriers[in->b_num % CRT_MAX_BARRIER_INFLIGHT];
+	crt_barrier_resend(arg, d_timeus_secdiff(0));
+}
+
+static int
+crt_barrier_send_rpc(struct crt_barrier_msg *msg)
+{
+	struct crt_barrier_info	*info = msg->bm_info;
+	crt_context_t		 crt_ctx;
+	crt_endpoint_t		 tgt_ep = {0};
+	crt_rpc_t		*rpc_req;
+	int			 rc = 0;
 
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
+	/* Context 0 is required and this condition is checked in
+	 * crt_barrier so assertion is fine.
+	 */
+	crt_ctx = crt_context_lookup(0);
+	D_ASSERT(crt_ctx != CRT_CONTEXT_NULL);
 
-	if (barrier_info->bi_num_exited < in->b_num) {
-		/* otherwise, this is a replay */
-		barrier_info->bi_num_exited = in->b_num;
-		ab->b_active = false;
-		info.bci_rc = 0;
-		info.bci_arg = ab->b_arg;
-		complete_cb = ab->b_complete_cb;
-		ab->b_complete_cb = NULL;
-		ab->b_arg = NULL;
+	/* crt_plugin_init() comes after the groups, register on first use */
+	D_MUTEX_LOCK(&info->bi_lock);
+	if (!info->bi_resend_cb) {
+		rc = crt_register_progress_cb(crt_barrier_prog_cb, info);
+		info->bi_resend_cb = rc == 0;
 	}
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
+	D_MUTEX_UNLOCK(&info->bi_lock);
+	if (rc != 0)
+		return rc;
 
-	if (complete_cb != NULL)
-		complete_cb(&info);
+	tgt_ep.ep_grp = &info->bi_primary_grp->gp_pub;
+	tgt_ep.ep_rank = msg->bm_rank;
+	rc = crt_req_create(crt_ctx, &tgt_ep, CRT_OPC_BARRIER, &rpc_req);
+	if (rc != 0)
+		return rc;
 
-	/* Ok, now check if the next barrier is pending_exit */
-	b_num = in->b_num + 1;
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
-	ab = &barrier_info->bi_barriers[b_num % CRT_MAX_BARRIER_INFLIGHT];
-	if (!ab->b_active || !ab->b_pending_exit)
-		ab = NULL;
-	else
-		ab->b_pending_exit = false;
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
+	*(struct crt_barrier_in *)crt_req_get(rpc_req) = msg->bm_in;
 
-	if (ab != NULL) {
-		/* Send exit message for next barrier */
-		send_barrier_msg(grp_priv, b_num, barrier_exit_cb,
-				 CRT_OPC_BARRIER_EXIT);
-	}
+	return crt_req_send(rpc_req, crt_barrier_send_cb, msg);
 }
 
-static void
-barrier_enter_cb(const struct crt_cb_info *cb_info)
+/* Handler of the notifications of the other ranks */
+void
+crt_hdlr_barrier(crt_rpc_t *rpc_req)
 {
-	struct crt_grp_priv	*grp_priv;
-	struct crt_barrier	*ab;
-	struct crt_barrier_info	*barrier_info;
-	crt_rpc_t		*rpc_req;
-	struct crt_barrier_out	*out;
-	struct crt_barrier_in	*in;
-	bool			send_exit = false;
-
-	rpc_req = cb_info->cci_rpc;
+	struct crt_barrier_in		*in;
+	struct crt_barrier_out		*out;
+	struct crt_grp_priv		*grp_priv;
+	int				rc = 0;
 
-	out = crt_reply_get(rpc_req);
 	in = crt_req_get(rpc_req);
+	out = crt_reply_get(rpc_req);
+	D_ASSERT(in != NULL && out != NULL);
 
 	if (rpc_req->cr_ep.ep_grp == NULL)
 		grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
@@ -466,47 +697,33 @@ barrier_enter_cb(const struct crt_cb_info *cb_info)
 		grp_priv = container_of(rpc_req->cr_ep.ep_grp,
 					struct crt_grp_priv, gp_pub);
 
-	D_ASSERT(grp_priv != NULL);
-
-	if (cb_info->cci_rc != 0 || out->b_rc != 0) {
-		/* Resend the enter message */
-		send_barrier_msg(grp_priv, in->b_num, barrier_enter_cb,
-				 CRT_OPC_BARRIER_ENTER);
-		return;
+	if (grp_priv == NULL) {
+		D_ERROR("crt_hdlr_barrier failed, no group\n");
+		rc = -DER_NONEXIST;
+	} else {
+		rc = crt_barrier_live_update(grp_priv);
 	}
 
-	D_DEBUG(DB_TRACE, "Enter phase complete for %d\n", in->b_num);
-
-	barrier_info = &grp_priv->gp_barrier_info;
-	ab = &barrier_info->bi_barriers[in->b_num % CRT_MAX_BARRIER_INFLIGHT];
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
-
-	ab->b_pending_exit = true;
-
-	/* If we've processed prior exits, we can go ahead and send the exit */
-	if (barrier_info->bi_num_exited == (in->b_num - 1)) {
-		send_exit = true;
-		ab->b_pending_exit = false;
+	if (rc == 0) {
+		crt_barrier_recv(&grp_priv->gp_barrier_info, in, out);
+	} else {
+		out->b_rc = rc;
+		out->b_done = 0;
 	}
 
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
-
-	if (send_exit)
-		send_barrier_msg(grp_priv, in->b_num, barrier_exit_cb,
-				 CRT_OPC_BARRIER_EXIT);
+	rc = crt_reply_send(rpc_req);
+	/* If the reply is lost, the sender resends */
+	if (rc != 0)
+		D_ERROR("Could not send reply for barrier notification, "
+			"rc = %d\n", rc);
 }
 
 int
 crt_barrier(crt_group_t *grp, crt_barrier_cb_t complete_cb, void *cb_arg)
 {
 	struct crt_context_t		*crt_ctx;
-	struct crt_barrier_info		*barrier_info;
-	struct crt_barrier		*ab;
 	struct crt_grp_priv		*grp_priv;
-	crt_rpc_t			*rpc_req = NULL;
-	struct crt_barrier_out		*out;
-	struct crt_barrier_cb_info	info;
-	int				enter_num;
+	int				rc;
 
 	if (!crt_initialized()) {
 		D_ERROR("CRT not initialized.\n");
@@ -552,103 +769,21 @@ crt_barrier(crt_group_t *grp, crt_barrier_cb_t complete_cb, void *cb_arg)
 		return -DER_OOG;
 	}
 
-	if (grp_priv->gp_size == 1) {
-		/* No need for broadcast */
-		info.bci_rc = 0;
-		info.bci_arg = cb_arg;
-
-		complete_cb(&info);
-		return 0;
-	}
-
-	barrier_info = &grp_priv->gp_barrier_info;
-
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
-	enter_num = barrier_info->bi_num_created + 1;
-
-	ab = &barrier_info->bi_barriers[enter_num % CRT_MAX_BARRIER_INFLIGHT];
-
-	if (ab->b_active) {
-		D_MUTEX_UNLOCK(&barrier_info->bi_lock);
-		return -DER_BUSY;
-	}
-
-	ab->b_active = true;
-
-	ab->b_arg = cb_arg;
-	ab->b_complete_cb = complete_cb;
-	/* If master already arrived, this field will be non-NULL.  We save
-	 * the value so we can reply
-	 */
-	rpc_req = ab->b_enter_rpc;
-	ab->b_enter_rpc = NULL;
-
-	barrier_info->bi_num_created = enter_num;
-
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
-
-	if (rpc_req != NULL) {
-		out = crt_reply_get(rpc_req);
-
-		out->b_rc = 0;
-		crt_reply_send(rpc_req);
-
-		/* addref in crt_hdlr_barrier_enter_cb */
-		RPC_PUB_DECREF(rpc_req);
-	}
-
-	if (barrier_info->bi_master_pri_rank == grp_priv->gp_self)
-		send_barrier_msg(grp_priv, enter_num, barrier_enter_cb,
-				 CRT_OPC_BARRIER_ENTER);
-
-	D_DEBUG(DB_TRACE, "barrier %d started\n", enter_num);
+	rc = crt_barrier_live_update(grp_priv);
+	if (rc != 0)
+		return rc;
 
-	return 0;
+	return crt_barrier_enter(&grp_priv->gp_barrier_info, complete_cb,
+				 cb_arg);
 }
 
 void
 crt_barrier_handle_eviction(struct crt_grp_priv *grp_priv)
 {
-	bool			updated;
-	struct crt_barrier_info	*barrier_info;
-	int			saved_exited;
-	int			saved_created;
-
-	/* We only handle barriers for primary group at present but this is
-	 * the code that would need to change to cycle through more than
-	 * just the primary group.
-	 */
-
-	updated = crt_barrier_update_master(grp_priv);
-
-	if (!updated) /* Same master as before */
-		return;
+	int	rc;
 
-	barrier_info = &grp_priv->gp_barrier_info;
-
-	if (barrier_info->bi_master_pri_rank != grp_priv->gp_self)
-		return; /* New master is another rank */
-
-	/* Ok, we are the new master.   We need to replay the last enter
-	 * message and exit messages received.
-	 */
-	D_MUTEX_LOCK(&barrier_info->bi_lock);
-	saved_exited = barrier_info->bi_num_exited;
-	saved_created = barrier_info->bi_num_created;
-	D_MUTEX_UNLOCK(&barrier_info->bi_lock);
-
-	/* First send the exit message remote ranks may have missed */
-	D_DEBUG(DB_TRACE, "New master sending exit for %d\n", saved_exited);
-	send_barrier_msg(grp_priv, saved_exited,  barrier_exit_cb,
-			 CRT_OPC_BARRIER_EXIT);
-	/* Now send any enter messages that remote nodes may have missed */
-	saved_exited++;
-	for (; saved_exited <= saved_created; ++saved_exited) {
-		D_DEBUG(DB_TRACE, "New master sending enter for %d\n",
-			saved_exited);
-		send_barrier_msg(grp_priv, saved_exited,  barrier_enter_cb,
-				 CRT_OPC_BARRIER_ENTER);
-	}
-	send_barrier_msg(grp_priv, saved_exited,  barrier_exit_cb,
-			 CRT_OPC_BARRIER_EXIT);
+	/* We only handle barriers for primary group at present */
+	rc = crt_barrier_live_update(grp_priv);
+	if (rc != 0)
+		D_ERROR("barrier membership update failed, rc: %d\n", rc);
 }
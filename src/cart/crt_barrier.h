@@ -42,36 +42,107 @@
 #ifndef __CRT_BARRIER_H__
 #define __CRT_BARRIER_H__
 
-#define CRT_MAX_BARRIER_INFLIGHT 4
+/*
+ * The barrier is a dissemination barrier over the live ranks of the primary
+ * group: in round k the rank of index i in the live rank list notifies the
+ * rank of index (i + 2^k) % n and waits for the notification of the rank of
+ * index (i - 2^k) % n, so all ranks know all others arrived after
+ * ceil(log2(n)) rounds and there is no master rank. Barriers are numbered
+ * from 1 in the order they are started on each rank and any number of them
+ * can be in flight, they complete in order.
+ *
+ * An eviction changes the live rank list and its version, the barriers in
+ * flight restart their rounds at the new version. The ranks that completed
+ * a barrier before restarting it do not take part in the new rounds, so the
+ * notifications of a completed barrier are answered with b_done set and
+ * these ranks send CRT_BARRIER_ROUND_DONE to their peers of all rounds, on
+ * both sides, when they learn the new version. A rank that learns the
+ * completion of a barrier it restarted passes it on the same way. As all
+ * ranks arrived in a completed barrier, they also arrived in the barriers
+ * before it, so the notification covers them too.
+ *
+ * A notification that fails to send, right away or on its reply, is resent
+ * after a delay doubling from CRT_BARRIER_RESEND_US, unless the membership
+ * changed meanwhile. After CRT_BARRIER_SEND_RETRY resends the barrier fails
+ * locally with the error of the last one.
+ */
+
+/* b_round of the notification of a completed barrier */
+#define CRT_BARRIER_ROUND_DONE	((uint32_t)-1)
+/* resends of a notification before failing its barrier */
+#define CRT_BARRIER_SEND_RETRY	(8)
+/* delay before the first resend, in us */
+#define CRT_BARRIER_RESEND_US	(10000)
 
 struct crt_barrier {
-	crt_rpc_t		*b_enter_rpc;   /* enter rpc */
-	crt_barrier_cb_t	 b_complete_cb;  /* user callback */
-	void			*b_arg;         /* user callback arg */
-	bool			 b_active;       /* Local rank in barrier */
-	bool			 b_pending_exit; /* Master ready to exit */
+	d_list_t		 b_link;	/* link to bi_barriers */
+	crt_barrier_cb_t	 b_complete_cb;	/* user callback */
+	void			*b_arg;		/* callback arg */
+	uint64_t		 b_num;		/* barrier number */
+	uint64_t		 b_recv;	/* bitmap of rounds received */
+	uint32_t		 b_recv_ver;	/* version of b_recv */
+	uint32_t		 b_ver;		/* version of b_round */
+	uint32_t		 b_round;	/* number of rounds sent */
+	int			 b_rc;		/* local failure */
+	bool			 b_active;	/* entered here */
+	bool			 b_done;	/* all ranks in barrier */
+	bool			 b_restarted;	/* rounds restarted */
 };
 
+struct crt_barrier_info;
+
+/* a notification of this rank, owned by the transport while in flight */
+struct crt_barrier_msg {
+	d_list_t		 bm_link;	/* link to bi_resend */
+	struct crt_barrier_info	*bm_info;	/* sender */
+	d_rank_t		 bm_rank;	/* receiver */
+	uint32_t		 bm_retry;	/* resends so far */
+	uint64_t		 bm_resend_ts;	/* time of the resend, in us */
+	struct crt_barrier_in	 bm_in;
+};
+
+/*
+ * send the notification msg, its reply is passed to crt_barrier_sent() unless
+ * the send fails right away
+ */
+typedef int (*crt_barrier_send_t)(struct crt_barrier_msg *msg);
+
 struct crt_barrier_info {
-	d_rank_list_t		 bi_exclude_self;    /* rank list for self */
 	struct crt_grp_priv	*bi_primary_grp;     /* primary group */
 	pthread_mutex_t		 bi_lock;            /* lock for barriers */
-	struct crt_barrier	 bi_barriers[CRT_MAX_BARRIER_INFLIGHT];
-	d_rank_t		 bi_master_pri_rank; /* lowest live rank */
-	int			 bi_master_idx;      /* index of master */
-	int			 bi_num_created;     /* creation count */
-	int			 bi_num_exited;      /* completion count */
+	d_list_t		 bi_barriers;	     /* by b_num */
+	d_rank_list_t		*bi_live;	     /* live ranks */
+	uint32_t		 bi_ver;	     /* membership version */
+	uint32_t		 bi_self_idx;	     /* self in bi_live */
+	uint32_t		 bi_rounds;	     /* rounds per barrier */
+	uint64_t		 bi_num_created;     /* creation count */
+	uint64_t		 bi_num_exited;      /* completion count */
+	crt_barrier_send_t	 bi_send;	     /* transport */
+	d_list_t		 bi_resend;	     /* failed notifications */
+	bool			 bi_resend_cb;	     /* progress callback */
 };
 
 int crt_barrier_info_init(struct crt_grp_priv *grp_priv);
 void crt_barrier_info_destroy(struct crt_grp_priv *grp_priv);
-void crt_hdlr_barrier_enter(crt_rpc_t *rpc_req);
-void crt_hdlr_barrier_exit(crt_rpc_t *rpc_req);
-int crt_hdlr_barrier_aggregate(crt_rpc_t *source, crt_rpc_t *result, void *arg);
-/* Update the barrier master */
-bool crt_barrier_update_master(struct crt_grp_priv *grp_priv);
+void crt_hdlr_barrier(crt_rpc_t *rpc_req);
+
+/*
+ * Transport independent part of the barrier, the live rank list (owned by
+ * info afterwards) must be set before starting a barrier.
+ */
+void crt_barrier_set_live(struct crt_barrier_info *info, d_rank_list_t *live,
+			  d_rank_t self, uint32_t ver);
+int crt_barrier_enter(struct crt_barrier_info *info,
+		      crt_barrier_cb_t complete_cb, void *cb_arg);
+void crt_barrier_recv(struct crt_barrier_info *info,
+		      const struct crt_barrier_in *in,
+		      struct crt_barrier_out *out);
+void crt_barrier_sent(struct crt_barrier_msg *msg, int rc,
+		      const struct crt_barrier_out *out);
+/* Resend the failed notifications due at time now, in us */
+void crt_barrier_resend(struct crt_barrier_info *info, uint64_t now);
 
-/* Transfer to new barrier master, if necessary, on rank eviction */
+/* Restart the barriers in flight on rank eviction */
 void crt_barrier_handle_eviction(struct crt_grp_priv *grp_priv);
 
 
@@ -0,0 +1,348 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It implements the file based bootstrap, which
+ * assigns the ranks of the primary group and exchanges their URIs through a
+ * directory shared by the processes of the job instead of PMIx.
+ *
+ * Each process writes its URI to a temporary file and link()s it to
+ * "<dir>/<grpid>[.<job>].boot.<rank>", the first rank whose link succeeds
+ * being its own. It then reads the files of all other ranks, waiting for those
+ * not there yet, and rank 0 of a service group saves the attach info of the
+ * group for clients to attach through crt_grp_config_load(). Each process
+ * removes its file at crt_finalize(). The files of a job that did not finalize
+ * are left behind, setting CRT_BOOTSTRAP_JOB keeps the next job off them.
+ */
+#define D_LOGFAC	DD_FAC(pmix)
+
+#include "crt_internal.h"
+
+#define CRT_BOOT_NO_RANK	((d_rank_t)-1)
+
+static char		crt_boot_dir[PATH_MAX];
+/* rank pinned through CRT_BOOTSTRAP_RANK, or CRT_BOOT_NO_RANK */
+static d_rank_t		crt_boot_rank;
+/* ".<job>" from CRT_BOOTSTRAP_JOB, or empty */
+static char		crt_boot_job[CRT_BOOT_JOB_MAX_LEN + 2];
+/* bootstrap file of this process, removed by crt_boot_fini() */
+static char		*crt_boot_slot;
+
+int
+crt_boot_init(void)
+{
+	char		*dir;
+	char		*job;
+	uint32_t	 size = 0;
+	int		 rc;
+
+	crt_gdata.cg_boot = false;
+	dir = getenv(CRT_BOOT_DIR_ENV);
+	if (dir == NULL || strlen(dir) == 0)
+		return 0;
+
+	d_getenv_int(CRT_BOOT_SIZE_ENV, &size);
+	if (size == 0) {
+		D_ERROR("ENV %s set without a valid %s.\n", CRT_BOOT_DIR_ENV,
+			CRT_BOOT_SIZE_ENV);
+		return -DER_INVAL;
+	}
+	crt_boot_rank = CRT_BOOT_NO_RANK;
+	d_getenv_int(CRT_BOOT_RANK_ENV, &crt_boot_rank);
+	if (crt_boot_rank != CRT_BOOT_NO_RANK && crt_boot_rank >= size) {
+		D_ERROR("ENV %s %d out of range [0, %d).\n", CRT_BOOT_RANK_ENV,
+			crt_boot_rank, size);
+		return -DER_INVAL;
+	}
+
+	crt_boot_job[0] = '\0';
+	job = getenv(CRT_BOOT_JOB_ENV);
+	if (job != NULL && strlen(job) > 0) {
+		if (strlen(job) > CRT_BOOT_JOB_MAX_LEN ||
+		    strchr(job, '/') != NULL) {
+			D_ERROR("ENV %s %s invalid, at most %d characters "
+				"w/o '/'.\n", CRT_BOOT_JOB_ENV, job,
+				CRT_BOOT_JOB_MAX_LEN);
+			return -DER_INVAL;
+		}
+		snprintf(crt_boot_job, sizeof(crt_boot_job), ".%s", job);
+	}
+
+	/* the attach info of the job goes along with the rank files */
+	rc = crt_group_config_path_set(dir);
+	if (rc != 0)
+		return rc;
+	strncpy(crt_boot_dir, dir, PATH_MAX - 1);
+
+	crt_gdata.cg_boot = true;
+	crt_gdata.cg_boot_size = size;
+	D_DEBUG(DB_ALL, "bootstrap through %s, job %s, group size %d.\n",
+		crt_boot_dir, job == NULL ? "" : job, size);
+
+	return 0;
+}
+
+/* remove the bootstrap file of this process */
+void
+crt_boot_fini(void)
+{
+	if (crt_boot_slot == NULL)
+		return;
+
+	if (unlink(crt_boot_slot) != 0 && errno != ENOENT)
+		D_ERROR("unlink file %s failed (%s).\n", crt_boot_slot,
+			strerror(errno));
+	D_FREE(crt_boot_slot);
+}
+
+static inline char *
+crt_boot_filename(crt_group_id_t grpid, d_rank_t rank)
+{
+	char	*filename;
+
+	D_ASPRINTF(filename, "%s/%s%s.boot.%d", crt_boot_dir, grpid,
+		   crt_boot_job, rank);
+
+	return filename;
+}
+
+/* publish the URI of this process under the first free rank of grp_priv */
+static int
+crt_boot_rank_claim(struct crt_grp_priv *grp_priv)
+{
+	crt_group_id_t	 grpid = grp_priv->gp_pub.cg_grpid;
+	uint32_t	 size = crt_gdata.cg_boot_size;
+	char		*tmp_name = NULL;
+	char		*filename;
+	d_rank_t	 first;
+	d_rank_t	 rank;
+	uint32_t	 i;
+	int		 fd;
+	int		 rc = 0;
+
+	D_ASPRINTF(tmp_name, "%s/%s%s.boot-XXXXXX", crt_boot_dir, grpid,
+		   crt_boot_job);
+	if (tmp_name == NULL)
+		return -DER_NOMEM;
+	fd = mkstemp(tmp_name);
+	if (fd == -1) {
+		D_ERROR("mkstemp() failed on %s, error: %s.\n",
+			tmp_name, strerror(errno));
+		D_FREE(tmp_name);
+		return d_errno2der(errno);
+	}
+	rc = dprintf(fd, "%s\n", crt_gdata.cg_addr);
+	if (rc < 0 || close(fd) != 0) {
+		D_ERROR("write to file %s failed (%s).\n",
+			tmp_name, strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
+
+	/* spread the first tries so that the ranks are claimed in few rounds */
+	if (crt_boot_rank != CRT_BOOT_NO_RANK)
+		first = crt_boot_rank;
+	else
+		first = crt_gdata.cg_pid % size;
+	rc = -DER_BUSY;
+	for (i = 0; i < size; i++) {
+		rank = (first + i) % size;
+		filename = crt_boot_filename(grpid, rank);
+		if (filename == NULL)
+			D_GOTO(out, rc = -DER_NOMEM);
+		rc = link(tmp_name, filename);
+		if (rc == 0) {
+			D_ASSERT(crt_boot_slot == NULL);
+			crt_boot_slot = filename;
+			grp_priv->gp_self = rank;
+			break;
+		}
+		rc = d_errno2der(errno);
+		D_FREE(filename);
+		if (rc != -DER_EXIST || crt_boot_rank != CRT_BOOT_NO_RANK) {
+			D_ERROR("cannot claim rank %d of group %s in %s, "
+				"rc: %d.\n", rank, grpid, crt_boot_dir, rc);
+			D_GOTO(out, rc);
+		}
+	}
+	if (rc != 0)
+		D_ERROR("all %d ranks of group %s in %s are taken, left over "
+			"from a previous job?\n", size, grpid, crt_boot_dir);
+
+out:
+	unlink(tmp_name);
+	D_FREE(tmp_name);
+	return rc;
+}
+
+/*
+ * Read the URI of rank from its bootstrap file. With a non-zero deadline,
+ * wait until then for the file to show up.
+ */
+static int
+crt_boot_uri_read(crt_group_id_t grpid, d_rank_t rank, uint64_t deadline,
+		  char **uri)
+{
+	char		*filename;
+	char		 fmt[16];
+	FILE		*fp;
+	uint32_t	 poll_us = CRT_BOOT_POLL_MIN_US;
+	int		 rc = 0;
+
+	filename = crt_boot_filename(grpid, rank);
+	if (filename == NULL)
+		return -DER_NOMEM;
+
+	while ((fp = fopen(filename, "r")) == NULL) {
+		if (errno != ENOENT || deadline == 0 ||
+		    d_timeus_secdiff(0) >= deadline) {
+			D_ERROR("open file %s failed (%s).\n",
+				filename, strerror(errno));
+			D_GOTO(out, rc = d_errno2der(errno));
+		}
+		usleep(poll_us);
+		poll_us = min(poll_us * 2, CRT_BOOT_POLL_MAX_US);
+	}
+
+	D_ALLOC(*uri, CRT_ADDR_STR_MAX_LEN);
+	if (*uri == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	snprintf(fmt, sizeof(fmt), "%%%ds", CRT_ADDR_STR_MAX_LEN - 1);
+	if (fscanf(fp, fmt, *uri) != 1) {
+		D_ERROR("read from file %s failed.\n", filename);
+		D_FREE(*uri);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+out:
+	if (fp != NULL)
+		fclose(fp);
+	D_FREE(filename);
+	return rc;
+}
+
+/*
+ * Stand-in for crt_pmix_assign_rank(), crt_pmix_publish_self() and the fence
+ * that follows them: claim a rank, wait for all others and fill the lookup
+ * cache of a service group with their URIs.
+ */
+int
+crt_boot_assign_rank(struct crt_grp_priv *grp_priv)
+{
+	crt_group_id_t	 grpid = grp_priv->gp_pub.cg_grpid;
+	char		**uris = NULL;
+	uint64_t	 deadline;
+	d_rank_t	 rank;
+	uint32_t	 size = crt_gdata.cg_boot_size;
+	int		 rc;
+
+	D_ASSERT(grp_priv->gp_rank_map != NULL);
+
+	rc = crt_boot_rank_claim(grp_priv);
+	if (rc != 0)
+		D_GOTO(out, rc);
+	grp_priv->gp_size = size;
+	for (rank = 0; rank < size; rank++) {
+		grp_priv->gp_rank_map[rank].rm_rank = rank;
+		grp_priv->gp_rank_map[rank].rm_status = CRT_RANK_ALIVE;
+	}
+
+	D_ALLOC_ARRAY(uris, size);
+	if (uris == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	deadline = d_timeus_secdiff(crt_gdata.cg_timeout);
+	for (rank = 0; rank < size; rank++) {
+		if (rank == grp_priv->gp_self) {
+			D_STRNDUP(uris[rank], crt_gdata.cg_addr,
+				  CRT_ADDR_STR_MAX_LEN);
+			if (uris[rank] == NULL)
+				D_GOTO(out, rc = -DER_NOMEM);
+			continue;
+		}
+		rc = crt_boot_uri_read(grpid, rank, deadline, &uris[rank]);
+		if (rc != 0) {
+			D_ERROR("group %s, rank %d did not show up, rc: %d.\n",
+				grpid, rank, rc);
+			D_GOTO(out, rc);
+		}
+	}
+
+	if (!grp_priv->gp_service)
+		D_GOTO(out, rc = 0);
+
+	for (rank = 0; rank < size; rank++) {
+		rc = crt_grp_lc_uri_insert(grp_priv, 0, rank, 0, uris[rank]);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+	if (grp_priv->gp_self == 0) {
+		rc = crt_grp_attach_info_save(grp_priv, 0, true, uris);
+		if (rc != 0)
+			D_ERROR("saving attach info of group %s failed, "
+				"rc: %d.\n", grpid, rc);
+	}
+
+out:
+	if (uris != NULL) {
+		for (rank = 0; rank < size; rank++)
+			D_FREE(uris[rank]);
+		D_FREE(uris);
+	}
+	if (rc == 0)
+		D_DEBUG(DB_TRACE, "crt_boot_assign_rank group %s, size %d, "
+			"self %d.\n", grpid, grp_priv->gp_size,
+			grp_priv->gp_self);
+	else
+		D_ERROR("crt_boot_assign_rank group %s failed, rc: %d.\n",
+			grpid, rc);
+	return rc;
+}
+
+/** Stand-in for crt_pmix_uri_lookup(), *uri is released with free() */
+int
+crt_boot_uri_lookup(crt_group_id_t grpid, d_rank_t rank, char **uri)
+{
+	char	*boot_uri = NULL;
+	int	 rc;
+
+	rc = crt_boot_uri_read(grpid, rank, 0, &boot_uri);
+	if (rc != 0)
+		return rc;
+	*uri = strndup(boot_uri, CRT_ADDR_STR_MAX_LEN);
+	D_FREE(boot_uri);
+
+	return *uri == NULL ? -DER_NOMEM : 0;
+}
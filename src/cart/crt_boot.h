@@ -0,0 +1,72 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It gives out the function declarations of the
+ * file based bootstrap, which stands in for PMIx at job startup.
+ */
+
+#ifndef __CRT_BOOT_H__
+#define __CRT_BOOT_H__
+
+/*
+ * ENV naming the directory shared by the processes of the job. Setting it
+ * together with CRT_BOOTSTRAP_SIZE enables the bootstrap, and makes it the
+ * attach info directory unless CRT_ATTACH_INFO_PATH is set.
+ */
+#define CRT_BOOT_DIR_ENV	"CRT_BOOTSTRAP_DIR"
+/* ENV giving the number of processes of the primary group */
+#define CRT_BOOT_SIZE_ENV	"CRT_BOOTSTRAP_SIZE"
+/* optional ENV pinning the rank of this process, e.g. to the launcher's */
+#define CRT_BOOT_RANK_ENV	"CRT_BOOTSTRAP_RANK"
+/*
+ * optional ENV scoping the files of the job, e.g. the launcher's job id or a
+ * generation nonce, which has to be the same for all processes of the job
+ */
+#define CRT_BOOT_JOB_ENV	"CRT_BOOTSTRAP_JOB"
+#define CRT_BOOT_JOB_MAX_LEN	(64)
+
+/* poll interval bounds while waiting for the other ranks, in microseconds */
+#define CRT_BOOT_POLL_MIN_US	(1000)
+#define CRT_BOOT_POLL_MAX_US	(100000)
+
+int crt_boot_init(void);
+void crt_boot_fini(void);
+int crt_boot_assign_rank(struct crt_grp_priv *grp_priv);
+int crt_boot_uri_lookup(crt_group_id_t grpid, d_rank_t rank, char **uri);
+
+#endif /* __CRT_BOOT_H__ */
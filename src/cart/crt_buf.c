@@ -0,0 +1,401 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It implements the registered buffer pool APIs.
+ */
+#define D_LOGFAC	DD_FAC(bulk)
+
+#include <sys/mman.h>
+
+#include "crt_internal.h"
+
+static int
+crt_buf_class_init(struct crt_buf_pool *pool, struct crt_buf_class *cls,
+		   size_t size, uint32_t nr)
+{
+	struct crt_buf_priv	*buf_priv;
+	d_sg_list_t		 sgl;
+	d_iov_t			 iov;
+	void			*slab = MAP_FAILED;
+	size_t			 slab_len;
+	uint32_t		 i;
+	int			 rc = 0;
+
+	cls->cbc_pool = pool;
+	cls->cbc_size = size;
+	cls->cbc_nr = nr;
+	D_INIT_LIST_HEAD(&cls->cbc_free_list);
+
+	slab_len = size * nr;
+	if (pool->cbp_flags & CRT_BUF_POOL_HUGEPAGE) {
+		slab_len = (slab_len + CRT_BUF_HUGEPAGE_SIZE - 1) &
+			   ~(CRT_BUF_HUGEPAGE_SIZE - 1);
+		slab = mmap(NULL, slab_len, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (slab == MAP_FAILED) {
+			D_DEBUG(DB_TRACE, "no huge pages for %zu bytes (%s), "
+				"use normal pages.\n", slab_len,
+				strerror(errno));
+			slab_len = size * nr;
+		}
+	}
+	if (slab == MAP_FAILED) {
+		slab = mmap(NULL, slab_len, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+		if (slab == MAP_FAILED) {
+			D_ERROR("mmap %zu bytes failed, errno: %d(%s).\n",
+				slab_len, errno, strerror(errno));
+			D_GOTO(out, rc = -DER_NOMEM);
+		}
+	}
+	cls->cbc_slab = slab;
+	cls->cbc_slab_len = slab_len;
+
+	/* register the whole slab once */
+	iov.iov_buf = slab;
+	iov.iov_buf_len = slab_len;
+	iov.iov_len = slab_len;
+	sgl.sg_nr = 1;
+	sgl.sg_nr_out = 0;
+	sgl.sg_iovs = &iov;
+	rc = crt_bulk_create(pool->cbp_ctx, &sgl, CRT_BULK_RW,
+			     &cls->cbc_bulk_hdl);
+	if (rc != 0) {
+		D_ERROR("crt_bulk_create failed, rc: %d.\n", rc);
+		D_GOTO(out, rc);
+	}
+
+	D_ALLOC_ARRAY(cls->cbc_bufs, nr);
+	if (cls->cbc_bufs == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	for (i = 0; i < nr; i++) {
+		buf_priv = &cls->cbc_bufs[i];
+		buf_priv->cbr_class = cls;
+		buf_priv->cbr_pub.cb_buf = (char *)slab + i * size;
+		buf_priv->cbr_pub.cb_size = size;
+		buf_priv->cbr_pub.cb_bulk_hdl = cls->cbc_bulk_hdl;
+		buf_priv->cbr_pub.cb_bulk_off = i * size;
+		d_list_add_tail(&buf_priv->cbr_link, &cls->cbc_free_list);
+	}
+
+out:
+	return rc;
+}
+
+static void
+crt_buf_class_fini(struct crt_buf_class *cls)
+{
+	uint32_t	i;
+
+	if (cls->cbc_bufs != NULL) {
+		for (i = 0; i < cls->cbc_nr; i++)
+			crt_bulk_free(cls->cbc_bufs[i].cbr_view_hdl);
+		D_FREE(cls->cbc_bufs);
+	}
+	if (cls->cbc_bulk_hdl != CRT_BULK_NULL) {
+		crt_bulk_free(cls->cbc_bulk_hdl);
+		cls->cbc_bulk_hdl = CRT_BULK_NULL;
+	}
+	if (cls->cbc_slab != NULL) {
+		munmap(cls->cbc_slab, cls->cbc_slab_len);
+		cls->cbc_slab = NULL;
+	}
+}
+
+void
+crt_buf_pool_destroy_force(struct crt_buf_pool *pool)
+{
+	int	i;
+
+	if (pool->cbp_inuse != 0)
+		D_WARN("destroy buffer pool %p with %u buffers in use.\n",
+		       pool, pool->cbp_inuse);
+
+	for (i = 0; i < pool->cbp_class_nr; i++)
+		crt_buf_class_fini(&pool->cbp_classes[i]);
+	D_SPIN_DESTROY(&pool->cbp_lock);
+	D_FREE(pool);
+}
+
+static int
+crt_buf_size_cmp(const void *a, const void *b)
+{
+	size_t	size_a = *(const size_t *)a;
+	size_t	size_b = *(const size_t *)b;
+
+	return (size_a > size_b) - (size_a < size_b);
+}
+
+int
+crt_buf_pool_create(crt_context_t crt_ctx, const size_t *sizes, int nr_sizes,
+		    uint32_t bufs_per_class, uint32_t flags,
+		    crt_buf_pool_t *pool)
+{
+	struct crt_buf_pool	*pool_priv = NULL;
+	size_t			*sorted = NULL;
+	int			 i;
+	int			 rc = 0;
+
+	if (crt_ctx == CRT_CONTEXT_NULL || sizes == NULL || nr_sizes <= 0 ||
+	    bufs_per_class == 0 || pool == NULL) {
+		D_ERROR("invalid parameter, crt_ctx %p, sizes %p, nr_sizes %d, "
+			"bufs_per_class %u, pool %p.\n", crt_ctx, sizes,
+			nr_sizes, bufs_per_class, pool);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+	for (i = 0; i < nr_sizes; i++) {
+		if (sizes[i] == 0) {
+			D_ERROR("invalid zero size of class %d.\n", i);
+			D_GOTO(out, rc = -DER_INVAL);
+		}
+	}
+
+	D_ALLOC_ARRAY(sorted, nr_sizes);
+	if (sorted == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	memcpy(sorted, sizes, nr_sizes * sizeof(*sizes));
+	qsort(sorted, nr_sizes, sizeof(*sorted), crt_buf_size_cmp);
+
+	D_ALLOC(pool_priv, offsetof(struct crt_buf_pool,
+				    cbp_classes[nr_sizes]));
+	if (pool_priv == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	rc = D_SPIN_INIT(&pool_priv->cbp_lock, PTHREAD_PROCESS_PRIVATE);
+	if (rc != 0) {
+		D_FREE(pool_priv);
+		D_GOTO(out, rc);
+	}
+	pool_priv->cbp_ctx = crt_ctx;
+	pool_priv->cbp_flags = flags;
+
+	for (i = 0; i < nr_sizes; i++) {
+		/* the classes initialized so far are freed on failure */
+		pool_priv->cbp_class_nr = i + 1;
+		rc = crt_buf_class_init(pool_priv, &pool_priv->cbp_classes[i],
+					sorted[i], bufs_per_class);
+		if (rc != 0) {
+			D_ERROR("init class of size %zu failed, rc: %d.\n",
+				sorted[i], rc);
+			crt_buf_pool_destroy_force(pool_priv);
+			D_GOTO(out, rc);
+		}
+	}
+
+	*pool = pool_priv;
+	D_DEBUG(DB_TRACE, "created buffer pool %p, %d classes of %u buffers, "
+		"flags %#x.\n", pool_priv, nr_sizes, bufs_per_class, flags);
+
+out:
+	D_FREE(sorted);
+	return rc;
+}
+
+int
+crt_buf_pool_destroy(crt_buf_pool_t pool)
+{
+	struct crt_buf_pool	*pool_priv = pool;
+	uint32_t		 inuse;
+	int			 rc = 0;
+
+	if (pool_priv == NULL) {
+		D_ERROR("invalid parameter, NULL pool.\n");
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	D_SPIN_LOCK(&pool_priv->cbp_lock);
+	inuse = pool_priv->cbp_inuse;
+	D_SPIN_UNLOCK(&pool_priv->cbp_lock);
+	if (inuse != 0) {
+		D_ERROR("buffer pool %p has %u buffers in use.\n",
+			pool_priv, inuse);
+		D_GOTO(out, rc = -DER_BUSY);
+	}
+
+	crt_buf_pool_destroy_force(pool_priv);
+
+out:
+	return rc;
+}
+
+int
+crt_buf_get(crt_buf_pool_t pool, size_t len, struct crt_buf **buf)
+{
+	struct crt_buf_pool	*pool_priv = pool;
+	struct crt_buf_class	*cls;
+	struct crt_buf_priv	*buf_priv = NULL;
+	int			 i;
+	int			 rc = 0;
+
+	if (pool_priv == NULL || len == 0 || buf == NULL) {
+		D_ERROR("invalid parameter, pool %p, len %zu, buf %p.\n",
+			pool_priv, len, buf);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	D_SPIN_LOCK(&pool_priv->cbp_lock);
+	for (i = 0; i < pool_priv->cbp_class_nr; i++) {
+		cls = &pool_priv->cbp_classes[i];
+		if (cls->cbc_size < len || d_list_empty(&cls->cbc_free_list))
+			continue;
+		buf_priv = d_list_entry(cls->cbc_free_list.next,
+					struct crt_buf_priv, cbr_link);
+		d_list_del_init(&buf_priv->cbr_link);
+		pool_priv->cbp_inuse++;
+		break;
+	}
+	D_SPIN_UNLOCK(&pool_priv->cbp_lock);
+
+	if (buf_priv == NULL)
+		D_GOTO(out, rc = -DER_NOSPACE);
+
+	buf_priv->cbr_pub.cb_len = len;
+	*buf = &buf_priv->cbr_pub;
+
+out:
+	return rc;
+}
+
+int
+crt_buf_put(struct crt_buf *buf)
+{
+	struct crt_buf_priv	*buf_priv;
+	struct crt_buf_pool	*pool_priv;
+	int			 rc = 0;
+
+	if (buf == NULL) {
+		D_ERROR("invalid parameter, NULL buf.\n");
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	buf_priv = crt_buf_pub2priv(buf);
+	pool_priv = buf_priv->cbr_class->cbc_pool;
+
+	D_SPIN_LOCK(&pool_priv->cbp_lock);
+	D_ASSERT(d_list_empty(&buf_priv->cbr_link));
+	D_ASSERT(pool_priv->cbp_inuse > 0);
+	d_list_add(&buf_priv->cbr_link, &buf_priv->cbr_class->cbc_free_list);
+	pool_priv->cbp_inuse--;
+	D_SPIN_UNLOCK(&pool_priv->cbp_lock);
+
+out:
+	return rc;
+}
+
+/*
+ * Get a bulk handle covering exactly the first len bytes of the buffer, for
+ * the cases where the handle is exposed (e.g. as the chained bulk of a corpc)
+ * and its length matters. The handle is cached in the buffer and stays valid
+ * until the buffer is put back; it is registered again only when a later user
+ * of the buffer asks for another length.
+ */
+int
+crt_buf_view(struct crt_buf *buf, size_t len, crt_bulk_t *bulk_hdl)
+{
+	struct crt_buf_priv	*buf_priv;
+	d_sg_list_t		 sgl;
+	d_iov_t			 iov;
+	int			 rc = 0;
+
+	D_ASSERT(buf != NULL && bulk_hdl != NULL);
+	D_ASSERT(len > 0 && len <= buf->cb_size);
+	buf_priv = crt_buf_pub2priv(buf);
+
+	if (buf_priv->cbr_view_hdl != CRT_BULK_NULL &&
+	    buf_priv->cbr_view_len == len)
+		D_GOTO(out, rc = 0);
+
+	if (buf_priv->cbr_view_hdl != CRT_BULK_NULL) {
+		crt_bulk_free(buf_priv->cbr_view_hdl);
+		buf_priv->cbr_view_hdl = CRT_BULK_NULL;
+	}
+
+	iov.iov_buf = buf->cb_buf;
+	iov.iov_buf_len = len;
+	iov.iov_len = len;
+	sgl.sg_nr = 1;
+	sgl.sg_nr_out = 0;
+	sgl.sg_iovs = &iov;
+	rc = crt_bulk_create(buf_priv->cbr_class->cbc_pool->cbp_ctx, &sgl,
+			     CRT_BULK_RW, &buf_priv->cbr_view_hdl);
+	if (rc != 0) {
+		D_ERROR("crt_bulk_create failed, rc: %d.\n", rc);
+		buf_priv->cbr_view_hdl = CRT_BULK_NULL;
+		D_GOTO(out, rc);
+	}
+	buf_priv->cbr_view_len = len;
+
+out:
+	if (rc == 0)
+		*bulk_hdl = buf_priv->cbr_view_hdl;
+	return rc;
+}
+
+/*
+ * The internal pool of a context, created on first use. Returns NULL if it
+ * cannot be created or is disabled by ENV CRT_BUF_POOL=0, callers then fall
+ * back to allocating and registering buffers per use.
+ */
+struct crt_buf_pool *
+crt_context_buf_pool(struct crt_context *ctx)
+{
+	size_t			 sizes[] = CRT_BUF_POOL_INT_SIZES;
+	crt_buf_pool_t		 pool = NULL;
+	int			 rc;
+
+	if (!crt_gdata.cg_buf_pool)
+		return NULL;
+
+	D_MUTEX_LOCK(&ctx->cc_mutex);
+	if (ctx->cc_buf_pool == NULL && !ctx->cc_buf_pool_failed) {
+		rc = crt_buf_pool_create(ctx, sizes, CRT_BUF_POOL_INT_CLASS_NR,
+					 CRT_BUF_POOL_INT_BUFS, 0, &pool);
+		if (rc == 0) {
+			ctx->cc_buf_pool = pool;
+		} else {
+			D_WARN("context %d, crt_buf_pool_create failed, rc: "
+			       "%d, buffers are registered per use.\n",
+			       ctx->cc_idx, rc);
+			ctx->cc_buf_pool_failed = 1;
+		}
+	}
+	D_MUTEX_UNLOCK(&ctx->cc_mutex);
+
+	return ctx->cc_buf_pool;
+}
@@ -0,0 +1,100 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It is the internal registered buffer pool
+ * interface.
+ */
+
+#ifndef __CRT_BUF_H__
+#define __CRT_BUF_H__
+
+/* the internal pool of a context, used by corpc and IV bulk */
+#define CRT_BUF_POOL_INT_CLASS_NR	(3)
+#define CRT_BUF_POOL_INT_SIZES		{ 4096, 65536, 1048576 }
+#define CRT_BUF_POOL_INT_BUFS		(8)
+
+/* size of the huge pages used for CRT_BUF_POOL_HUGEPAGE */
+#define CRT_BUF_HUGEPAGE_SIZE		(2UL << 20)
+
+struct crt_buf_class;
+
+/* one buffer of a pool */
+struct crt_buf_priv {
+	struct crt_buf		 cbr_pub;
+	/* link to crt_buf_class::cbc_free_list when not in use */
+	d_list_t		 cbr_link;
+	struct crt_buf_class	*cbr_class;
+	/* cached bulk handle covering exactly cbr_view_len bytes */
+	crt_bulk_t		 cbr_view_hdl;
+	size_t			 cbr_view_len;
+};
+
+/* the buffers of one size class, carved from a single registered slab */
+struct crt_buf_class {
+	struct crt_buf_pool	*cbc_pool;
+	size_t			 cbc_size;
+	uint32_t		 cbc_nr;
+	void			*cbc_slab;
+	size_t			 cbc_slab_len;
+	crt_bulk_t		 cbc_bulk_hdl;
+	d_list_t		 cbc_free_list;
+	struct crt_buf_priv	*cbc_bufs;
+};
+
+struct crt_buf_pool {
+	struct crt_context	*cbp_ctx;
+	/* protects the free lists and cbp_inuse */
+	pthread_spinlock_t	 cbp_lock;
+	uint32_t		 cbp_flags;
+	uint32_t		 cbp_inuse;
+	int			 cbp_class_nr;
+	/* sorted by ascending cbc_size */
+	struct crt_buf_class	 cbp_classes[0];
+};
+
+static inline struct crt_buf_priv *
+crt_buf_pub2priv(struct crt_buf *buf)
+{
+	return container_of(buf, struct crt_buf_priv, cbr_pub);
+}
+
+int crt_buf_view(struct crt_buf *buf, size_t len, crt_bulk_t *bulk_hdl);
+struct crt_buf_pool *crt_context_buf_pool(struct crt_context *ctx);
+void crt_buf_pool_destroy_force(struct crt_buf_pool *pool);
+
+#endif /* __CRT_BUF_H__ */
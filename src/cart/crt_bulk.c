@@ -177,6 +177,33 @@ out:
 	return rc;
 }
 
+int
+crt_bulk_transfer_vec(struct crt_bulk_desc *bulk_descs, int nr,
+		      crt_bulk_vec_cb_t complete_cb, void *arg)
+{
+	int			i;
+	int			rc = 0;
+
+	if (bulk_descs == NULL || nr <= 0) {
+		D_ERROR("invalid parameter, bulk_descs: %p, nr: %d.\n",
+			bulk_descs, nr);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+	for (i = 0; i < nr; i++) {
+		if (!crt_bulk_desc_valid(&bulk_descs[i])) {
+			D_ERROR("invalid parameter of bulk_descs[%d].\n", i);
+			D_GOTO(out, rc = -DER_INVAL);
+		}
+	}
+
+	rc = crt_hg_bulk_transfer_vec(bulk_descs, nr, complete_cb, arg);
+	if (rc != 0)
+		D_ERROR("crt_hg_bulk_transfer_vec failed, rc: %d.\n", rc);
+
+out:
+	return rc;
+}
+
 int
 crt_bulk_get_len(crt_bulk_t bulk_hdl, size_t *bulk_len)
 {
@@ -214,3 +241,25 @@ crt_bulk_abort(crt_context_t crt_ctx, crt_bulk_opid_t opid)
 {
 	return crt_hg_bulk_cancel(opid);
 }
+
+int
+crt_bulk_sm_stats_get(crt_context_t crt_ctx, uint64_t *count, uint64_t *bytes)
+{
+	struct crt_hg_context	*hg_ctx;
+	int			 rc = 0;
+
+	if (crt_ctx == CRT_CONTEXT_NULL || count == NULL || bytes == NULL) {
+		D_ERROR("invalid parameter, crt_ctx: %p, count: %p, "
+			"bytes: %p.\n", crt_ctx, count, bytes);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	hg_ctx = &((struct crt_context *)crt_ctx)->cc_hg_ctx;
+	D_SPIN_LOCK(&hg_ctx->chc_bulk_sm_lock);
+	*count = hg_ctx->chc_bulk_sm_count;
+	*bytes = hg_ctx->chc_bulk_sm_bytes;
+	D_SPIN_UNLOCK(&hg_ctx->chc_bulk_sm_lock);
+
+out:
+	return rc;
+}
@@ -0,0 +1,1065 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It implements the allgather and all-to-all
+ * collectives, see crt_coll.h for the algorithms.
+ */
+#define D_LOGFAC	DD_FAC(grp)
+
+#include "crt_internal.h"
+
+/* a notification to send once ci_lock is released */
+struct crt_coll_send {
+	d_list_t		cs_link;
+	struct crt_coll		*cs_coll;
+	d_rank_t		cs_rank;
+	struct crt_coll_in	cs_in;
+};
+
+/* what to do once ci_lock is released */
+struct crt_coll_acts {
+	d_list_t		ca_sends;	/* struct crt_coll_send */
+	d_list_t		ca_pulls;	/* struct crt_coll_msg */
+	d_list_t		ca_replies;	/* struct crt_coll_msg */
+	d_list_t		ca_done;	/* struct crt_coll */
+};
+
+static struct crt_coll_transport crt_coll_rpc_transport;
+
+int
+crt_coll_info_init(struct crt_grp_priv *grp_priv)
+{
+	struct crt_coll_info	*info;
+	int			 rc;
+
+	info = &grp_priv->gp_coll_info;
+
+	rc = D_MUTEX_INIT(&info->ci_lock, NULL);
+	if (rc != 0)
+		return rc;
+
+	D_INIT_LIST_HEAD(&info->ci_colls);
+	info->ci_num_created = 0;
+	info->ci_live = NULL;
+	info->ci_ver = 0;
+	info->ci_self_idx = 0;
+	info->ci_stale_ver = 0;
+	info->ci_stale_num = 0;
+	info->ci_transport = &crt_coll_rpc_transport;
+
+	return 0;
+}
+
+static void
+crt_coll_free(struct crt_coll *coll)
+{
+	struct crt_coll_transport	*ct = coll->cl_info->ci_transport;
+
+	if (coll->cl_bulk != CRT_BULK_NULL)
+		ct->ct_bulk_free(coll->cl_bulk);
+	if (coll->cl_recv_bulk != CRT_BULK_NULL)
+		ct->ct_bulk_free(coll->cl_recv_bulk);
+	if (coll->cl_buf != coll->cl_recv.iov_buf &&
+	    coll->cl_type == CRT_COLL_ALLGATHER)
+		D_FREE(coll->cl_buf);
+	d_rank_list_free(coll->cl_live);
+	D_FREE_PTR(coll);
+}
+
+/* Cancel the collectives still in flight, started ones complete first */
+void
+crt_coll_info_destroy(struct crt_grp_priv *grp_priv)
+{
+	struct crt_coll_info	*info;
+	struct crt_coll_cb_info	 cb_info;
+	struct crt_coll		*coll, *next;
+	struct crt_coll_msg	*msg, *next_msg;
+
+	info = &grp_priv->gp_coll_info;
+	d_list_for_each_entry_safe(coll, next, &info->ci_colls, cl_link) {
+		d_list_for_each_entry_safe(msg, next_msg, &coll->cl_msgs,
+					   cm_link) {
+			d_list_del(&msg->cm_link);
+			info->ci_transport->ct_reply(msg, -DER_CANCELED);
+		}
+		d_list_del(&coll->cl_link);
+		if (coll->cl_active) {
+			D_DEBUG(DB_TRACE, "collective "DF_U64" canceled\n",
+				coll->cl_num);
+			cb_info.coci_arg = coll->cl_arg;
+			cb_info.coci_rc = -DER_CANCELED;
+			cb_info.coci_rank_nr = coll->cl_live->rl_nr;
+			coll->cl_complete_cb(&cb_info);
+		}
+		crt_coll_free(coll);
+	}
+	d_rank_list_free(info->ci_live);
+	D_MUTEX_DESTROY(&info->ci_lock);
+}
+
+static inline void
+crt_coll_acts_init(struct crt_coll_acts *acts)
+{
+	D_INIT_LIST_HEAD(&acts->ca_sends);
+	D_INIT_LIST_HEAD(&acts->ca_pulls);
+	D_INIT_LIST_HEAD(&acts->ca_replies);
+	D_INIT_LIST_HEAD(&acts->ca_done);
+}
+
+/*
+ * Find collective cl_num, or the position to insert it at through pos.
+ * Called with ci_lock
+ */
+static struct crt_coll *
+crt_coll_lookup_locked(struct crt_coll_info *info, uint64_t num, d_list_t **pos)
+{
+	struct crt_coll	*coll;
+	d_list_t	*cur;
+
+	/* the list is sorted and new collectives are usually the last ones */
+	for (cur = info->ci_colls.prev; cur != &info->ci_colls;
+	     cur = cur->prev) {
+		coll = d_list_entry(cur, struct crt_coll, cl_link);
+		if (coll->cl_num == num)
+			return coll;
+		if (coll->cl_num < num)
+			break;
+	}
+
+	if (pos != NULL)
+		*pos = cur;
+	return NULL;
+}
+
+static inline uint32_t
+crt_coll_total(struct crt_coll *coll)
+{
+	return coll->cl_type == CRT_COLL_ALLGATHER ? coll->cl_rounds :
+						     coll->cl_live->rl_nr - 1;
+}
+
+static void
+crt_coll_fail_locked(struct crt_coll *coll, int rc)
+{
+	if (coll->cl_rc != 0)
+		return;
+
+	D_ERROR("collective "DF_U64" failed, rc: %d\n", coll->cl_num, rc);
+	coll->cl_rc = rc;
+}
+
+static inline void
+crt_coll_reply_locked(struct crt_coll_acts *acts, struct crt_coll_msg *msg,
+		      int rc)
+{
+	msg->cm_rc = rc;
+	d_list_add_tail(&msg->cm_link, &acts->ca_replies);
+}
+
+/*
+ * Queue notification idx, the round of an allgather or the step of an
+ * all-to-all, carrying cl_rc instead of the blocks after a failure.
+ */
+static int
+crt_coll_notify_locked(struct crt_coll *coll, uint32_t idx,
+		       struct crt_coll_acts *acts)
+{
+	struct crt_coll_send	*send;
+	struct crt_coll_in	*in;
+	uint32_t		 nr = coll->cl_live->rl_nr;
+	uint32_t		 dist;
+
+	D_ALLOC_PTR(send);
+	if (send == NULL)
+		return -DER_NOMEM;
+
+	send->cs_coll = coll;
+	in = &send->cs_in;
+	in->c_num = coll->cl_num;
+	in->c_len = coll->cl_len;
+	in->c_ver = coll->cl_ver;
+	in->c_type = coll->cl_type;
+	in->c_rc = coll->cl_rc;
+	in->c_bulk = coll->cl_rc == 0 ? coll->cl_bulk : CRT_BULK_NULL;
+
+	if (coll->cl_type == CRT_COLL_ALLGATHER) {
+		/* the blocks of the 2^idx ranks up to self */
+		dist = 1U << idx;
+		in->c_round = idx;
+		in->c_cnt = min(dist, nr - dist);
+		in->c_first = (coll->cl_self_idx + nr + 1 - in->c_cnt) % nr;
+	} else {
+		dist = idx + 1;
+		in->c_first = coll->cl_live->rl_ranks[coll->cl_self_idx];
+		in->c_cnt = 1;
+	}
+	send->cs_rank = coll->cl_live->rl_ranks[(coll->cl_self_idx + dist) %
+						nr];
+	d_list_add_tail(&send->cs_link, &acts->ca_sends);
+
+	return 0;
+}
+
+/* Check the notification msg of a started collective and queue its pulls */
+static void
+crt_coll_accept_locked(struct crt_coll *coll, struct crt_coll_msg *msg,
+		       struct crt_coll_acts *acts)
+{
+	struct crt_coll_in	*in = &msg->cm_in;
+	uint32_t		 nr = coll->cl_live->rl_nr;
+	uint64_t		 len = coll->cl_len;
+	uint32_t		 cnt;
+
+	if (coll->cl_rc != 0) {
+		crt_coll_reply_locked(acts, msg, coll->cl_rc);
+		return;
+	}
+
+	if (in->c_rc != 0) {
+		crt_coll_fail_locked(coll, in->c_rc);
+		crt_coll_reply_locked(acts, msg, 0);
+		return;
+	}
+
+	if (in->c_ver != coll->cl_ver || in->c_type != coll->cl_type ||
+	    in->c_len != len) {
+		D_ERROR("collective "DF_U64" version %u type %u len "DF_U64
+			" does not match local version %u type %u len "DF_U64
+			"\n", coll->cl_num, in->c_ver, in->c_type, in->c_len,
+			coll->cl_ver, coll->cl_type, len);
+		crt_coll_fail_locked(coll, -DER_MISMATCH);
+		crt_coll_reply_locked(acts, msg, -DER_MISMATCH);
+		return;
+	}
+
+	if (coll->cl_type == CRT_COLL_ALLGATHER) {
+		if (in->c_round >= coll->cl_rounds || in->c_first >= nr ||
+		    in->c_cnt == 0 || in->c_cnt > nr ||
+		    coll->cl_recv_mask & (1ULL << in->c_round))
+			D_GOTO(out_proto, 0);
+
+		/* the blocks can wrap around the end of the live ranks */
+		cnt = min(in->c_cnt, nr - in->c_first);
+		msg->cm_seg_nr = 1;
+		msg->cm_segs[0].off = in->c_first * len;
+		msg->cm_segs[0].remote_off = msg->cm_segs[0].off;
+		msg->cm_segs[0].len = cnt * len;
+		if (cnt < in->c_cnt) {
+			msg->cm_seg_nr = 2;
+			msg->cm_segs[1].off = 0;
+			msg->cm_segs[1].remote_off = 0;
+			msg->cm_segs[1].len = (in->c_cnt - cnt) * len;
+		}
+	} else {
+		if (in->c_cnt != 1 ||
+		    (in->c_first + 1) * len > coll->cl_recv.iov_len ||
+		    in->c_first == coll->cl_live->rl_ranks[coll->cl_self_idx])
+			D_GOTO(out_proto, 0);
+
+		msg->cm_seg_nr = 1;
+		msg->cm_segs[0].off = in->c_first * len;
+		msg->cm_segs[0].remote_off =
+			coll->cl_live->rl_ranks[coll->cl_self_idx] * len;
+		msg->cm_segs[0].len = len;
+	}
+
+	msg->cm_pulls = msg->cm_seg_nr;
+	msg->cm_rc = 0;
+	coll->cl_pulling++;
+	d_list_add_tail(&msg->cm_link, &acts->ca_pulls);
+	return;
+
+out_proto:
+	D_ERROR("collective "DF_U64" invalid notification, round %u first %u "
+		"cnt %u\n", coll->cl_num, in->c_round, in->c_first, in->c_cnt);
+	crt_coll_fail_locked(coll, -DER_PROTO);
+	crt_coll_reply_locked(acts, msg, -DER_PROTO);
+}
+
+/*
+ * Pass on that the collectives up to ci_stale_num ran before ci_stale_ver, to
+ * the peers of the allgather rounds. Called with ci_lock.
+ */
+static void
+crt_coll_stale_send_locked(struct crt_coll_info *info,
+			   struct crt_coll_acts *acts)
+{
+	struct crt_coll_send	*send;
+	uint32_t		 nr;
+	uint32_t		 dist;
+
+	if (info->ci_live == NULL || info->ci_ver != info->ci_stale_ver ||
+	    info->ci_stale_num == 0)
+		return;
+
+	nr = info->ci_live->rl_nr;
+	for (dist = 1; dist < nr; dist <<= 1) {
+		D_ALLOC_PTR(send);
+		if (send == NULL) {
+			D_ERROR("collective stale notification "DF_U64
+				" version %u lost\n", info->ci_stale_num,
+				info->ci_stale_ver);
+			return;
+		}
+		send->cs_coll = NULL;
+		send->cs_rank = info->ci_live->rl_ranks[(info->ci_self_idx +
+							  dist) % nr];
+		send->cs_in.c_type = CRT_COLL_STALE;
+		send->cs_in.c_num = info->ci_stale_num;
+		send->cs_in.c_ver = info->ci_stale_ver;
+		send->cs_in.c_bulk = CRT_BULK_NULL;
+		d_list_add_tail(&send->cs_link, &acts->ca_sends);
+	}
+}
+
+static void crt_coll_progress_locked(struct crt_coll *coll,
+				     struct crt_coll_acts *acts);
+
+/*
+ * Some rank ran the collectives up to num before version ver, fail the ones
+ * started at ver here. Called with ci_lock.
+ */
+static void
+crt_coll_stale_locked(struct crt_coll_info *info, uint32_t ver, uint64_t num,
+		      struct crt_coll_acts *acts)
+{
+	struct crt_coll		*coll, *next;
+
+	if (ver < info->ci_stale_ver ||
+	    (ver == info->ci_stale_ver && num <= info->ci_stale_num))
+		return;
+
+	info->ci_stale_ver = ver;
+	info->ci_stale_num = num;
+	d_list_for_each_entry_safe(coll, next, &info->ci_colls, cl_link) {
+		if (coll->cl_num > num)
+			break;
+		if (!coll->cl_active || coll->cl_ver != ver)
+			continue;
+		crt_coll_fail_locked(coll, -DER_MISMATCH);
+		crt_coll_progress_locked(coll, acts);
+	}
+	crt_coll_stale_send_locked(info, acts);
+}
+
+/*
+ * Pull what the received notifications carry, send the notifications that
+ * can go and move the collective to ca_done once nothing is in flight any
+ * more. Called with ci_lock.
+ */
+static void
+crt_coll_progress_locked(struct crt_coll *coll, struct crt_coll_acts *acts)
+{
+	struct crt_coll_msg	*msg, *next;
+	uint64_t		 mask;
+	uint32_t		 total;
+	bool			 recv_done;
+	bool			 failed;
+	int			 rc;
+
+	if (!coll->cl_active)
+		return;
+
+	d_list_for_each_entry_safe(msg, next, &coll->cl_msgs, cm_link) {
+		d_list_del(&msg->cm_link);
+		crt_coll_accept_locked(coll, msg, acts);
+	}
+
+	total = crt_coll_total(coll);
+	while (coll->cl_sent < total) {
+		/*
+		 * Round k carries the blocks of all rounds before it, after a
+		 * failure pass it on right away.
+		 */
+		if (coll->cl_rc == 0 && coll->cl_type == CRT_COLL_ALLGATHER) {
+			mask = (1ULL << coll->cl_sent) - 1;
+			if ((coll->cl_recv_mask & mask) != mask)
+				break;
+		}
+		if (coll->cl_rc == 0 && coll->cl_type == CRT_COLL_ALLTOALL &&
+		    coll->cl_sending >= CRT_COLL_WINDOW)
+			break;
+
+		failed = coll->cl_rc != 0;
+		rc = crt_coll_notify_locked(coll, coll->cl_sent, acts);
+		if (rc != 0) {
+			crt_coll_fail_locked(coll, rc);
+			/* try to pass the failure on, once */
+			if (!failed)
+				continue;
+		} else {
+			coll->cl_sending++;
+		}
+		coll->cl_sent++;
+	}
+
+	if (coll->cl_type == CRT_COLL_ALLGATHER)
+		recv_done = coll->cl_recv_mask ==
+			    (1ULL << coll->cl_rounds) - 1;
+	else
+		recv_done = coll->cl_recv_nr == total;
+
+	if ((coll->cl_rc == 0 && !recv_done) || coll->cl_sent < total ||
+	    coll->cl_sending > 0 || coll->cl_pulling > 0)
+		return;
+
+	d_list_move_tail(&coll->cl_link, &acts->ca_done);
+}
+
+/* Send, pull and reply what is queued and run the completion callbacks */
+static void
+crt_coll_flush(struct crt_coll_info *info, struct crt_coll_acts *acts)
+{
+	struct crt_coll_transport	*ct = info->ci_transport;
+	struct crt_coll_cb_info		 cb_info;
+	struct crt_coll_send		*send, *next_send;
+	struct crt_coll_msg		*msg, *next_msg;
+	struct crt_coll			*coll, *next;
+	uint32_t			 seg_nr;
+	uint32_t			 i;
+	int				 rc;
+
+	d_list_for_each_entry_safe(send, next_send, &acts->ca_sends, cs_link) {
+		d_list_del(&send->cs_link);
+		rc = ct->ct_send(send->cs_coll, send->cs_rank, &send->cs_in);
+		if (rc != 0) {
+			D_ERROR("collective "DF_U64" send to rank %d failed, "
+				"rc: %d\n", send->cs_in.c_num, send->cs_rank,
+				rc);
+			if (send->cs_coll != NULL)
+				crt_coll_sent(send->cs_coll, &send->cs_in, rc);
+		}
+		D_FREE_PTR(send);
+	}
+
+	d_list_for_each_entry_safe(msg, next_msg, &acts->ca_pulls, cm_link) {
+		d_list_del(&msg->cm_link);
+		/* msg can be gone once its last pull is started */
+		seg_nr = msg->cm_seg_nr;
+		for (i = 0; i < seg_nr; i++) {
+			rc = ct->ct_pull(msg, i);
+			if (rc != 0) {
+				D_ERROR("collective pull failed, rc: %d\n", rc);
+				crt_coll_pulled(msg, rc);
+			}
+		}
+	}
+
+	d_list_for_each_entry_safe(msg, next_msg, &acts->ca_replies, cm_link) {
+		d_list_del(&msg->cm_link);
+		ct->ct_reply(msg, msg->cm_rc);
+	}
+
+	d_list_for_each_entry_safe(coll, next, &acts->ca_done, cl_link) {
+		d_list_del(&coll->cl_link);
+		/* back from live rank order to rank order */
+		if (coll->cl_rc == 0 && coll->cl_type == CRT_COLL_ALLGATHER &&
+		    coll->cl_buf != coll->cl_recv.iov_buf) {
+			for (i = 0; i < coll->cl_live->rl_nr; i++)
+				memcpy(coll->cl_recv.iov_buf +
+				       coll->cl_live->rl_ranks[i] *
+				       coll->cl_len,
+				       coll->cl_buf + i * coll->cl_len,
+				       coll->cl_len);
+		}
+		D_DEBUG(DB_TRACE, "collective "DF_U64" complete, rc: %d\n",
+			coll->cl_num, coll->cl_rc);
+		cb_info.coci_arg = coll->cl_arg;
+		cb_info.coci_rc = coll->cl_rc;
+		cb_info.coci_rank_nr = coll->cl_live->rl_nr;
+		coll->cl_complete_cb(&cb_info);
+		crt_coll_free(coll);
+	}
+}
+
+int
+crt_coll_start(struct crt_coll_info *info, crt_context_t crt_ctx,
+	       enum crt_coll_type type, d_rank_list_t *live, d_rank_t self,
+	       uint32_t ver, uint32_t grp_size, d_iov_t *send_iov,
+	       d_iov_t *recv_iov, uint64_t len, crt_coll_cb_t complete_cb,
+	       void *cb_arg)
+{
+	struct crt_coll_transport	*ct = info->ci_transport;
+	struct crt_coll_acts		 acts;
+	struct crt_coll			*coll, *old;
+	struct crt_coll_msg		*msg, *next_msg;
+	d_list_t			*pos;
+	uint32_t			 nr = live->rl_nr;
+	uint32_t			 idx;
+	int				 rc = 0;
+
+	for (idx = 0; idx < nr; idx++)
+		if (live->rl_ranks[idx] == self)
+			break;
+	if (idx == nr) {
+		D_ERROR("rank %d not live at version %u\n", self, ver);
+		d_rank_list_free(live);
+		return -DER_EVICTED;
+	}
+
+	D_ALLOC_PTR(coll);
+	if (coll == NULL) {
+		d_rank_list_free(live);
+		return -DER_NOMEM;
+	}
+	D_INIT_LIST_HEAD(&coll->cl_msgs);
+	coll->cl_info = info;
+	coll->cl_complete_cb = complete_cb;
+	coll->cl_arg = cb_arg;
+	coll->cl_ctx = crt_ctx;
+	coll->cl_len = len;
+	coll->cl_type = type;
+	coll->cl_ver = ver;
+	coll->cl_live = live;
+	coll->cl_self_idx = idx;
+	for (coll->cl_rounds = 0; (1ULL << coll->cl_rounds) < nr;
+	     coll->cl_rounds++)
+		;
+	coll->cl_recv = *recv_iov;
+	coll->cl_recv.iov_len = grp_size * len;
+	coll->cl_bulk = CRT_BULK_NULL;
+	coll->cl_recv_bulk = CRT_BULK_NULL;
+
+	if (type == CRT_COLL_ALLGATHER) {
+		/* blocks go by live rank, which is by rank w/o eviction */
+		if (nr == grp_size) {
+			coll->cl_buf = recv_iov->iov_buf;
+		} else {
+			D_ALLOC(coll->cl_buf, nr * len);
+			if (coll->cl_buf == NULL)
+				D_GOTO(out, rc = -DER_NOMEM);
+		}
+		memmove(coll->cl_buf + idx * len, send_iov->iov_buf, len);
+		rc = ct->ct_bulk_create(coll, coll->cl_buf, nr * len,
+					&coll->cl_bulk);
+	} else {
+		coll->cl_buf = send_iov->iov_buf;
+		memcpy(coll->cl_recv.iov_buf + self * len,
+		       coll->cl_buf + self * len, len);
+		rc = ct->ct_bulk_create(coll, coll->cl_buf, grp_size * len,
+					&coll->cl_bulk);
+		if (rc == 0)
+			rc = ct->ct_bulk_create(coll, coll->cl_recv.iov_buf,
+						grp_size * len,
+						&coll->cl_recv_bulk);
+	}
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	crt_coll_acts_init(&acts);
+	coll->cl_active = true;
+
+	D_MUTEX_LOCK(&info->ci_lock);
+	coll->cl_num = ++info->ci_num_created;
+	/* take the notifications of the peers that started already */
+	old = crt_coll_lookup_locked(info, coll->cl_num, &pos);
+	if (old != NULL) {
+		d_list_for_each_entry_safe(msg, next_msg, &old->cl_msgs,
+					   cm_link) {
+			msg->cm_coll = coll;
+			d_list_move_tail(&msg->cm_link, &coll->cl_msgs);
+		}
+		d_list_add(&coll->cl_link, &old->cl_link);
+		d_list_del(&old->cl_link);
+		D_FREE_PTR(old);
+	} else {
+		d_list_add(&coll->cl_link, pos);
+	}
+	D_DEBUG(DB_TRACE, "collective "DF_U64" type %d started over %u ranks\n",
+		coll->cl_num, type, nr);
+	if (ver == info->ci_stale_ver && coll->cl_num <= info->ci_stale_num)
+		crt_coll_fail_locked(coll, -DER_MISMATCH);
+
+	crt_coll_progress_locked(coll, &acts);
+	D_MUTEX_UNLOCK(&info->ci_lock);
+
+	crt_coll_flush(info, &acts);
+	return 0;
+
+out:
+	crt_coll_free(coll);
+	return rc;
+}
+
+void
+crt_coll_recv(struct crt_coll_info *info, struct crt_coll_msg *msg)
+{
+	struct crt_coll_acts	 acts;
+	struct crt_coll		*coll;
+	d_list_t		*pos;
+
+	crt_coll_acts_init(&acts);
+
+	D_DEBUG(DB_TRACE, "collective "DF_U64" notification round %u first %u "
+		"received\n", msg->cm_in.c_num, msg->cm_in.c_round,
+		msg->cm_in.c_first);
+
+	D_MUTEX_LOCK(&info->ci_lock);
+	if (msg->cm_in.c_type == CRT_COLL_STALE) {
+		crt_coll_stale_locked(info, msg->cm_in.c_ver, msg->cm_in.c_num,
+				      &acts);
+		crt_coll_reply_locked(&acts, msg, 0);
+		D_GOTO(unlock, 0);
+	}
+
+	coll = crt_coll_lookup_locked(info, msg->cm_in.c_num, &pos);
+	if (coll == NULL) {
+		/* done here already, which means that the sender failed */
+		if (msg->cm_in.c_num <= info->ci_num_created) {
+			crt_coll_reply_locked(&acts, msg, -DER_CANCELED);
+			D_GOTO(unlock, 0);
+		}
+
+		/* wait for the local start */
+		D_ALLOC_PTR(coll);
+		if (coll == NULL) {
+			crt_coll_reply_locked(&acts, msg, -DER_NOMEM);
+			D_GOTO(unlock, 0);
+		}
+		coll->cl_info = info;
+		coll->cl_num = msg->cm_in.c_num;
+		D_INIT_LIST_HEAD(&coll->cl_msgs);
+		d_list_add(&coll->cl_link, pos);
+	}
+
+	msg->cm_coll = coll;
+	d_list_add_tail(&msg->cm_link, &coll->cl_msgs);
+	crt_coll_progress_locked(coll, &acts);
+unlock:
+	D_MUTEX_UNLOCK(&info->ci_lock);
+
+	crt_coll_flush(info, &acts);
+}
+
+void
+crt_coll_sent(struct crt_coll *coll, const struct crt_coll_in *in, int rc)
+{
+	struct crt_coll_info	*info = coll->cl_info;
+	struct crt_coll_acts	 acts;
+
+	crt_coll_acts_init(&acts);
+
+	D_MUTEX_LOCK(&info->ci_lock);
+	coll->cl_sending--;
+	if (rc != 0) {
+		D_ERROR("collective "DF_U64" notification round %u first %u "
+			"failed, rc: %d\n", in->c_num, in->c_round,
+			in->c_first, rc);
+		crt_coll_fail_locked(coll, rc);
+	}
+	crt_coll_progress_locked(coll, &acts);
+	D_MUTEX_UNLOCK(&info->ci_lock);
+
+	crt_coll_flush(info, &acts);
+}
+
+void
+crt_coll_pulled(struct crt_coll_msg *msg, int rc)
+{
+	struct crt_coll		*coll = msg->cm_coll;
+	struct crt_coll_info	*info = coll->cl_info;
+	struct crt_coll_acts	 acts;
+
+	crt_coll_acts_init(&acts);
+
+	D_MUTEX_LOCK(&info->ci_lock);
+	if (rc != 0 && msg->cm_rc == 0)
+		msg->cm_rc = rc;
+	if (--msg->cm_pulls > 0) {
+		D_MUTEX_UNLOCK(&info->ci_lock);
+		return;
+	}
+
+	coll->cl_pulling--;
+	if (msg->cm_rc != 0)
+		crt_coll_fail_locked(coll, msg->cm_rc);
+	else if (coll->cl_type == CRT_COLL_ALLGATHER)
+		coll->cl_recv_mask |= 1ULL << msg->cm_in.c_round;
+	else
+		coll->cl_recv_nr++;
+	crt_coll_reply_locked(&acts, msg, msg->cm_rc);
+	crt_coll_progress_locked(coll, &acts);
+	D_MUTEX_UNLOCK(&info->ci_lock);
+
+	crt_coll_flush(info, &acts);
+}
+
+void
+crt_coll_set_ver(struct crt_coll_info *info, d_rank_list_t *live,
+		 d_rank_t self, uint32_t ver)
+{
+	struct crt_coll_acts	 acts;
+	struct crt_coll		*coll, *next;
+	uint32_t		 idx;
+
+	for (idx = 0; idx < live->rl_nr; idx++)
+		if (live->rl_ranks[idx] == self)
+			break;
+
+	crt_coll_acts_init(&acts);
+
+	D_MUTEX_LOCK(&info->ci_lock);
+	if (ver <= info->ci_ver) {
+		D_MUTEX_UNLOCK(&info->ci_lock);
+		d_rank_list_free(live);
+		return;
+	}
+
+	d_list_for_each_entry_safe(coll, next, &info->ci_colls, cl_link) {
+		if (!coll->cl_active || coll->cl_ver >= ver)
+			continue;
+		crt_coll_fail_locked(coll, -DER_MISMATCH);
+		crt_coll_progress_locked(coll, &acts);
+	}
+
+	d_rank_list_free(info->ci_live);
+	info->ci_ver = ver;
+	if (idx == live->rl_nr) {
+		/* evicted, nothing to tell */
+		d_rank_list_free(live);
+		info->ci_live = NULL;
+	} else {
+		info->ci_live = live;
+		info->ci_self_idx = idx;
+	}
+
+	/* the collectives started so far ran before ver */
+	if (info->ci_stale_ver < ver) {
+		info->ci_stale_ver = ver;
+		info->ci_stale_num = 0;
+	}
+	info->ci_stale_num = max(info->ci_stale_num, info->ci_num_created);
+	crt_coll_stale_send_locked(info, &acts);
+	D_MUTEX_UNLOCK(&info->ci_lock);
+
+	crt_coll_flush(info, &acts);
+}
+
+static int
+crt_coll_rpc_bulk_create(struct crt_coll *coll, void *buf, uint64_t len,
+			 crt_bulk_t *bulk)
+{
+	d_sg_list_t	sgl;
+	d_iov_t		iov;
+
+	iov.iov_buf = buf;
+	iov.iov_buf_len = len;
+	iov.iov_len = len;
+	sgl.sg_iovs = &iov;
+	sgl.sg_nr = 1;
+
+	return crt_bulk_create(coll->cl_ctx, &sgl, CRT_BULK_RW, bulk);
+}
+
+static void
+crt_coll_rpc_bulk_free(crt_bulk_t bulk)
+{
+	crt_bulk_free(bulk);
+}
+
+static void
+crt_coll_rpc_send_cb(const struct crt_cb_info *cb_info)
+{
+	struct crt_coll_out	*out;
+	struct crt_coll_in	*in = crt_req_get(cb_info->cci_rpc);
+	int			 rc = cb_info->cci_rc;
+
+	if (rc == 0) {
+		out = crt_reply_get(cb_info->cci_rpc);
+		rc = out->c_rc;
+	}
+
+	if (cb_info->cci_arg != NULL)
+		crt_coll_sent(cb_info->cci_arg, in, rc);
+	else if (rc != 0)
+		D_ERROR("collective stale notification "DF_U64" version %u "
+			"failed, rc: %d\n", in->c_num, in->c_ver, rc);
+}
+
+static int
+crt_coll_rpc_send(struct crt_coll *coll, d_rank_t rank,
+		  struct crt_coll_in *in)
+{
+	crt_endpoint_t	 tgt_ep = {0};
+	crt_context_t	 crt_ctx;
+	crt_rpc_t	*rpc_req;
+	int		 rc;
+
+	crt_ctx = coll != NULL ? coll->cl_ctx : crt_context_lookup(0);
+	if (crt_ctx == CRT_CONTEXT_NULL)
+		return -DER_UNINIT;
+
+	tgt_ep.ep_rank = rank;
+	rc = crt_req_create(crt_ctx, &tgt_ep, CRT_OPC_COLL, &rpc_req);
+	if (rc != 0)
+		return rc;
+
+	*(struct crt_coll_in *)crt_req_get(rpc_req) = *in;
+
+	/* failures are reported through crt_coll_rpc_send_cb */
+	crt_req_send(rpc_req, crt_coll_rpc_send_cb, coll);
+	return 0;
+}
+
+static int
+crt_coll_rpc_pull_cb(const struct crt_bulk_cb_info *cb_info)
+{
+	crt_coll_pulled(cb_info->bci_arg, cb_info->bci_rc);
+	return 0;
+}
+
+static int
+crt_coll_rpc_pull(struct crt_coll_msg *msg, uint32_t seg)
+{
+	struct crt_coll		*coll = msg->cm_coll;
+	struct crt_bulk_desc	 bulk_desc;
+
+	bulk_desc.bd_rpc = msg->cm_handle;
+	bulk_desc.bd_bulk_op = CRT_BULK_GET;
+	bulk_desc.bd_remote_hdl = msg->cm_in.c_bulk;
+	bulk_desc.bd_remote_off = msg->cm_segs[seg].remote_off;
+	bulk_desc.bd_local_hdl = coll->cl_type == CRT_COLL_ALLGATHER ?
+				 coll->cl_bulk : coll->cl_recv_bulk;
+	bulk_desc.bd_local_off = msg->cm_segs[seg].off;
+	bulk_desc.bd_len = msg->cm_segs[seg].len;
+
+	return crt_bulk_transfer(&bulk_desc, crt_coll_rpc_pull_cb, msg, NULL);
+}
+
+static void
+crt_coll_rpc_reply(struct crt_coll_msg *msg, int rc)
+{
+	crt_rpc_t		*rpc_req = msg->cm_handle;
+	struct crt_coll_out	*out;
+
+	out = crt_reply_get(rpc_req);
+	out->c_rc = rc;
+	rc = crt_reply_send(rpc_req);
+	/* the sender fails on timeout */
+	if (rc != 0)
+		D_ERROR("Could not send reply for collective notification, "
+			"rc = %d\n", rc);
+
+	/* addref in crt_hdlr_coll */
+	crt_req_decref(rpc_req);
+	D_FREE_PTR(msg);
+}
+
+static struct crt_coll_transport crt_coll_rpc_transport = {
+	.ct_bulk_create	= crt_coll_rpc_bulk_create,
+	.ct_bulk_free	= crt_coll_rpc_bulk_free,
+	.ct_send	= crt_coll_rpc_send,
+	.ct_pull	= crt_coll_rpc_pull,
+	.ct_reply	= crt_coll_rpc_reply,
+};
+
+/* Handler of the notifications of the other ranks */
+void
+crt_hdlr_coll(crt_rpc_t *rpc_req)
+{
+	struct crt_coll_out	*out;
+	struct crt_coll_msg	*msg;
+	struct crt_grp_priv	*grp_priv;
+	int			 rc;
+
+	if (rpc_req->cr_ep.ep_grp == NULL)
+		grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
+	else
+		grp_priv = container_of(rpc_req->cr_ep.ep_grp,
+					struct crt_grp_priv, gp_pub);
+	if (grp_priv == NULL) {
+		D_ERROR("crt_hdlr_coll failed, no group\n");
+		D_GOTO(out, rc = -DER_NONEXIST);
+	}
+
+	D_ALLOC_PTR(msg);
+	if (msg == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	/* decref in crt_coll_rpc_reply */
+	crt_req_addref(rpc_req);
+	msg->cm_handle = rpc_req;
+	msg->cm_in = *(struct crt_coll_in *)crt_req_get(rpc_req);
+	crt_coll_recv(&grp_priv->gp_coll_info, msg);
+	return;
+
+out:
+	out = crt_reply_get(rpc_req);
+	out->c_rc = rc;
+	rc = crt_reply_send(rpc_req);
+	if (rc != 0)
+		D_ERROR("Could not send reply for collective notification, "
+			"rc = %d\n", rc);
+}
+
+/* Live ranks of grp_priv, and the membership version they are valid for */
+static int
+crt_coll_live_get(struct crt_grp_priv *grp_priv, d_rank_list_t **live_out,
+		  uint32_t *ver)
+{
+	d_rank_list_t		*live;
+	d_rank_t		 rank;
+	uint32_t		 nr;
+	uint32_t		 i;
+
+	D_RWLOCK_RDLOCK(grp_priv->gp_rwlock_ft);
+	*ver = grp_priv->gp_membs_ver;
+	nr = grp_priv->gp_membs != NULL ? grp_priv->gp_membs->rl_nr :
+					   grp_priv->gp_size;
+	live = d_rank_list_alloc(nr);
+	if (live == NULL) {
+		D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
+		return -DER_NOMEM;
+	}
+
+	live->rl_nr = 0;
+	for (i = 0; i < nr; i++) {
+		rank = grp_priv->gp_membs != NULL ?
+		       grp_priv->gp_membs->rl_ranks[i] : i;
+		if (grp_priv->gp_live_set == NULL ||
+		    d_rank_set_has(grp_priv->gp_live_set, rank))
+			live->rl_ranks[live->rl_nr++] = rank;
+	}
+	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
+
+	*live_out = live;
+	return 0;
+}
+
+/* Checks shared by crt_allgather() and crt_alltoall() */
+static int
+crt_coll_common(crt_context_t crt_ctx, crt_group_t *grp,
+		enum crt_coll_type type, d_iov_t *send_iov, d_iov_t *recv_iov,
+		crt_coll_cb_t complete_cb, void *cb_arg)
+{
+	struct crt_grp_priv	*grp_priv;
+	d_rank_list_t		*live;
+	uint32_t		 ver;
+	uint32_t		 grp_size;
+	uint64_t		 len;
+	int			 rc;
+
+	if (!crt_initialized()) {
+		D_ERROR("CRT not initialized.\n");
+		return -DER_UNINIT;
+	}
+
+	if (!crt_is_service()) {
+		D_ERROR("Collectives not supported in client group\n");
+		return -DER_NO_PERM;
+	}
+
+	if (crt_ctx == CRT_CONTEXT_NULL || send_iov == NULL ||
+	    recv_iov == NULL || complete_cb == NULL) {
+		D_ERROR("Invalid argument(s)\n");
+		return -DER_INVAL;
+	}
+
+	if (grp == NULL)
+		grp = crt_group_lookup(NULL);
+	if (grp == NULL) {
+		D_ERROR("Could not find primary group\n");
+		return -DER_UNINIT;
+	}
+
+	grp_priv = container_of(grp, struct crt_grp_priv, gp_pub);
+	if (grp_priv->gp_primary != 1 || grp_priv->gp_local == 0) {
+		D_ERROR("Collectives only supported on the local primary "
+			"group.\n");
+		return -DER_OOG;
+	}
+
+	rc = crt_coll_live_get(grp_priv, &live, &ver);
+	if (rc != 0)
+		return rc;
+
+	grp_size = grp_priv->gp_size;
+	len = type == CRT_COLL_ALLGATHER ? send_iov->iov_len :
+					   send_iov->iov_len / grp_size;
+	if (len == 0 || (type == CRT_COLL_ALLTOALL &&
+			 send_iov->iov_len != len * grp_size) ||
+	    send_iov->iov_buf == NULL || recv_iov->iov_buf == NULL ||
+	    recv_iov->iov_buf_len < len * grp_size) {
+		D_ERROR("Invalid buffer(s), send len "DF_U64", recv buf len "
+			DF_U64", group size %u\n", send_iov->iov_len,
+			recv_iov->iov_buf_len, grp_size);
+		d_rank_list_free(live);
+		return -DER_INVAL;
+	}
+
+	rc = crt_coll_start(&grp_priv->gp_coll_info, crt_ctx, type, live,
+			    grp_priv->gp_self, ver, grp_size, send_iov,
+			    recv_iov, len, complete_cb, cb_arg);
+	if (rc == 0)
+		recv_iov->iov_len = len * grp_size;
+
+	return rc;
+}
+
+int
+crt_allgather(crt_context_t crt_ctx, crt_group_t *grp, d_iov_t *send_iov,
+	      d_iov_t *recv_iov, crt_coll_cb_t complete_cb, void *cb_arg)
+{
+	return crt_coll_common(crt_ctx, grp, CRT_COLL_ALLGATHER, send_iov,
+			       recv_iov, complete_cb, cb_arg);
+}
+
+int
+crt_alltoall(crt_context_t crt_ctx, crt_group_t *grp, d_iov_t *send_iov,
+	     d_iov_t *recv_iov, crt_coll_cb_t complete_cb, void *cb_arg)
+{
+	return crt_coll_common(crt_ctx, grp, CRT_COLL_ALLTOALL, send_iov,
+			       recv_iov, complete_cb, cb_arg);
+}
+
+void
+crt_coll_handle_eviction(struct crt_grp_priv *grp_priv)
+{
+	d_rank_list_t	*live;
+	uint32_t	 ver;
+	int		 rc;
+
+	rc = crt_coll_live_get(grp_priv, &live, &ver);
+	if (rc != 0) {
+		D_ERROR("crt_coll_live_get failed, rc: %d\n", rc);
+		return;
+	}
+
+	crt_coll_set_ver(&grp_priv->gp_coll_info, live, grp_priv->gp_self,
+			 ver);
+}
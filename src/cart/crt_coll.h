@@ -0,0 +1,194 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT.  It is the internal allgather and all-to-all
+ * interface.
+ */
+
+#ifndef __CRT_COLL_H__
+#define __CRT_COLL_H__
+
+/*
+ * The collectives run over the live ranks of the primary group, which
+ * exchange their blocks point to point: a notification tells the receiver
+ * which blocks to pull from the bulk handle of the sender, and is replied
+ * once they are pulled.
+ *
+ * Allgather is a Bruck allgather, the dissemination pattern of the barrier:
+ * in round k the rank of index i in the live rank list notifies the rank of
+ * index (i + 2^k) % n of the 2^k blocks it holds, so all ranks hold all blocks
+ * after ceil(log2(n)) rounds. A round is sent once all rounds before it are
+ * pulled. Blocks are kept in live rank order, the buffer of the user directly
+ * if no rank is evicted.
+ *
+ * All-to-all is a pairwise exchange, rank i notifies rank (i + d) % n for d
+ * from 1 to n - 1 with at most CRT_COLL_WINDOW notifications in flight.
+ *
+ * Collectives are numbered from 1 in the order they are started on each rank,
+ * as barriers are, so notifications for a collective not started yet wait
+ * for it. They all fail with -DER_MISMATCH if the membership changes before
+ * they complete. A failed rank passes its error on with the notifications it
+ * did not send yet, instead of the blocks.
+ *
+ * A rank that learns a new version sends a CRT_COLL_STALE notification to
+ * its peers of the allgather rounds at the new version, telling that the
+ * collectives it started so far ran at an older version. A rank which learns
+ * a higher number this way for its current version passes it on the same
+ * way, and fails the collectives up to this number it started at the new
+ * version, as some rank will never take part in them.
+ */
+
+/* all-to-all notifications in flight per rank */
+#define CRT_COLL_WINDOW		(32)
+
+enum crt_coll_type {
+	CRT_COLL_ALLGATHER	= 1,
+	CRT_COLL_ALLTOALL,
+	/* collectives up to c_num of the sender ran before version c_ver */
+	CRT_COLL_STALE,
+};
+
+struct crt_coll_info;
+struct crt_coll;
+
+/* a received notification, until it is replied */
+struct crt_coll_msg {
+	d_list_t		 cm_link;	/* link to cl_msgs */
+	struct crt_coll		*cm_coll;
+	void			*cm_handle;	/* for the transport */
+	struct crt_coll_in	 cm_in;
+	/* pulls in flight, and where they go */
+	uint32_t		 cm_pulls;
+	uint32_t		 cm_seg_nr;
+	struct {
+		uint64_t	 off;
+		uint64_t	 remote_off;
+		uint64_t	 len;
+	}			 cm_segs[2];
+	int			 cm_rc;
+};
+
+struct crt_coll {
+	d_list_t		 cl_link;	/* link to ci_colls */
+	struct crt_coll_info	*cl_info;
+	crt_coll_cb_t		 cl_complete_cb;
+	void			*cl_arg;
+	crt_context_t		 cl_ctx;	/* for the transport */
+	uint64_t		 cl_num;
+	uint64_t		 cl_len;	/* block length */
+	enum crt_coll_type	 cl_type;
+	uint32_t		 cl_ver;
+	d_rank_list_t		*cl_live;	/* live ranks at cl_ver */
+	uint32_t		 cl_self_idx;	/* self in cl_live */
+	uint32_t		 cl_rounds;	/* allgather rounds */
+	/* blocks sent, by live rank (allgather) or by rank (all-to-all) */
+	void			*cl_buf;
+	/* blocks received, by rank. cl_buf for an allgather w/o eviction */
+	d_iov_t			 cl_recv;
+	crt_bulk_t		 cl_bulk;	/* of cl_buf */
+	crt_bulk_t		 cl_recv_bulk;	/* of cl_recv */
+	d_list_t		 cl_msgs;	/* notifications not pulled */
+	/* rounds (allgather) or steps (all-to-all) notified */
+	uint32_t		 cl_sent;
+	uint32_t		 cl_sending;	/* notifications in flight */
+	uint32_t		 cl_pulling;	/* notifications pulled */
+	uint64_t		 cl_recv_mask;	/* allgather rounds pulled */
+	uint32_t		 cl_recv_nr;	/* blocks pulled */
+	int			 cl_rc;
+	bool			 cl_active;	/* started here */
+};
+
+/* the transport, see crt_coll.c for the RPC based one */
+struct crt_coll_transport {
+	/* register len bytes at buf for the pulls of the peers */
+	int (*ct_bulk_create)(struct crt_coll *coll, void *buf, uint64_t len,
+			      crt_bulk_t *bulk);
+	void (*ct_bulk_free)(crt_bulk_t bulk);
+	/*
+	 * send in to rank, the reply is passed to crt_coll_sent, coll is
+	 * NULL for CRT_COLL_STALE and the reply is dropped
+	 */
+	int (*ct_send)(struct crt_coll *coll, d_rank_t rank,
+		       struct crt_coll_in *in);
+	/* pull segment seg of msg, completion is passed to crt_coll_pulled */
+	int (*ct_pull)(struct crt_coll_msg *msg, uint32_t seg);
+	/* reply rc to msg */
+	void (*ct_reply)(struct crt_coll_msg *msg, int rc);
+};
+
+struct crt_coll_info {
+	pthread_mutex_t			 ci_lock;
+	d_list_t			 ci_colls;	/* by cl_num */
+	uint64_t			 ci_num_created;
+	d_rank_list_t			*ci_live;	/* live ranks */
+	uint32_t			 ci_ver;	/* of ci_live */
+	uint32_t			 ci_self_idx;	/* self in ci_live */
+	/* collectives up to ci_stale_num cannot run at ci_stale_ver */
+	uint32_t			 ci_stale_ver;
+	uint64_t			 ci_stale_num;
+	struct crt_coll_transport	*ci_transport;
+};
+
+int crt_coll_info_init(struct crt_grp_priv *grp_priv);
+void crt_coll_info_destroy(struct crt_grp_priv *grp_priv);
+void crt_hdlr_coll(crt_rpc_t *rpc_req);
+
+/*
+ * Transport independent part of the collectives. The live rank list is owned
+ * by the collective afterwards, blocks are len bytes long.
+ */
+int crt_coll_start(struct crt_coll_info *info, crt_context_t crt_ctx,
+		   enum crt_coll_type type, d_rank_list_t *live, d_rank_t self,
+		   uint32_t ver, uint32_t grp_size, d_iov_t *send_iov,
+		   d_iov_t *recv_iov, uint64_t len, crt_coll_cb_t complete_cb,
+		   void *cb_arg);
+void crt_coll_recv(struct crt_coll_info *info, struct crt_coll_msg *msg);
+void crt_coll_sent(struct crt_coll *coll, const struct crt_coll_in *in,
+		   int rc);
+void crt_coll_pulled(struct crt_coll_msg *msg, int rc);
+/*
+ * Fail the collectives started before version ver, the live rank list is
+ * owned by info afterwards
+ */
+void crt_coll_set_ver(struct crt_coll_info *info, d_rank_list_t *live,
+		      d_rank_t self, uint32_t ver);
+
+/* Fail the collectives in flight on rank eviction */
+void crt_coll_handle_eviction(struct crt_grp_priv *grp_priv);
+
+#endif /* __CRT_COLL_H__ */
@@ -148,6 +148,7 @@ crt_context_init(crt_context_t crt_ctx)
 		D_GOTO(out, rc);
 
 	D_INIT_LIST_HEAD(&ctx->cc_link);
+	D_INIT_LIST_HEAD(&ctx->cc_ul_batches);
 
 	/* create timeout binheap */
 	bh_node_cnt = CRT_DEFAULT_CREDITS_PER_EP_CTX * 64;
@@ -251,6 +252,10 @@ crt_rpc_complete(struct crt_rpc_priv *rpc_priv, int rc)
 {
 	D_ASSERT(rpc_priv != NULL);
 
+	/* release the requests parked on the address this one resolved */
+	if (rpc_priv->crp_lc_owner)
+		crt_req_lc_release(rpc_priv, rc);
+
 	if (rc == -DER_CANCELED)
 		rpc_priv->crp_state = RPC_STATE_CANCELED;
 	else if (rc == -DER_TIMEDOUT)
@@ -444,6 +449,11 @@ crt_context_destroy(crt_context_t crt_ctx, int force)
 	D_MUTEX_UNLOCK(&ctx->cc_mutex);
 	D_MUTEX_DESTROY(&ctx->cc_mutex);
 
+	if (ctx->cc_buf_pool != NULL) {
+		crt_buf_pool_destroy_force(ctx->cc_buf_pool);
+		ctx->cc_buf_pool = NULL;
+	}
+
 	rc = crt_hg_ctx_fini(&ctx->cc_hg_ctx);
 	if (rc == 0) {
 		D_RWLOCK_WRLOCK(&crt_gdata.cg_rwlock);
@@ -494,6 +504,47 @@ crt_ep_abort(crt_endpoint_t *ep)
 	return rc;
 }
 
+int
+crt_ep_stats_get(crt_context_t crt_ctx, d_rank_t rank,
+		 struct crt_ep_stats *stats)
+{
+	struct crt_context	*ctx;
+	struct crt_ep_inflight	*epi;
+	d_list_t		*rlink;
+	int			 rc = 0;
+
+	if (crt_ctx == CRT_CONTEXT_NULL || stats == NULL) {
+		D_ERROR("invalid parameter, crt_ctx %p, stats %p.\n",
+			crt_ctx, stats);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+	ctx = crt_ctx;
+
+	D_MUTEX_LOCK(&ctx->cc_mutex);
+	rlink = d_hash_rec_find(&ctx->cc_epi_table, (void *)&rank,
+				sizeof(rank));
+	if (rlink == NULL) {
+		D_MUTEX_UNLOCK(&ctx->cc_mutex);
+		D_GOTO(out, rc = -DER_NONEXIST);
+	}
+	epi = epi_link2ptr(rlink);
+
+	D_MUTEX_LOCK(&epi->epi_mutex);
+	stats->eps_req_num = epi->epi_req_num;
+	stats->eps_reply_num = epi->epi_reply_num;
+	stats->eps_sm_reply_num = epi->epi_sm_reply_num;
+	stats->eps_fabric_reply_num = epi->epi_reply_num -
+				      epi->epi_sm_reply_num;
+	stats->eps_wait_num = epi->epi_req_wait_num;
+	D_MUTEX_UNLOCK(&epi->epi_mutex);
+
+	d_hash_rec_decref(&ctx->cc_epi_table, rlink);
+	D_MUTEX_UNLOCK(&ctx->cc_mutex);
+
+out:
+	return rc;
+}
+
 /* caller should already hold crt_ctx->cc_mutex */
 int
 crt_req_timeout_track(crt_rpc_t *req)
@@ -648,7 +699,24 @@ crt_req_timeout_hdlr(struct crt_rpc_priv *rpc_priv)
 	switch (rpc_priv->crp_state) {
 	case RPC_STATE_URI_LOOKUP:
 		ul_req = rpc_priv->crp_ul_req;
-		D_ASSERT(ul_req != NULL);
+		if (ul_req == NULL) {
+			/*
+			 * parked in a batched URI_LOOKUP, released by its
+			 * completion if not parked anymore
+			 */
+			if (!crt_req_ul_cancel(rpc_priv))
+				break;
+			D_ERROR("rpc opc: %#x timedout due to batched "
+				"URI_LOOKUP to group %s, rank %d.\n",
+				rpc_priv->crp_pub.cr_opc,
+				grp_priv->gp_pub.cg_grpid, tgt_ep->ep_rank);
+			crt_context_req_untrack(&rpc_priv->crp_pub);
+			crt_rpc_complete(rpc_priv, -DER_TIMEDOUT);
+			RPC_DECREF(rpc_priv); /* destroy */
+			/* addref in crt_req_uri_lookup */
+			RPC_DECREF(rpc_priv);
+			break;
+		}
 		ul_in = crt_req_get(ul_req);
 		D_ERROR("rpc opc: %#x timedout due to URI_LOOKUP to group %s, "
 			"rank %d through PSR %d timedout.\n",
@@ -670,6 +738,17 @@ crt_req_timeout_hdlr(struct crt_rpc_priv *rpc_priv)
 			tgt_ep->ep_rank, rpc_priv->crp_tgt_uri);
 		crt_rpc_complete(rpc_priv, -DER_UNREACH);
 		break;
+	case RPC_STATE_ADDR_WAIT:
+		/* released by the owner of the lookup if not parked anymore */
+		if (!crt_req_lc_cancel(rpc_priv))
+			break;
+		D_ERROR("rpc opc: %#x timedout waiting for the address of "
+			"group %s, rank %d.\n", rpc_priv->crp_pub.cr_opc,
+			grp_priv->gp_pub.cg_grpid, tgt_ep->ep_rank);
+		crt_context_req_untrack(&rpc_priv->crp_pub);
+		crt_rpc_complete(rpc_priv, -DER_UNREACH);
+		RPC_DECREF(rpc_priv);
+		break;
 	case RPC_STATE_FWD_UNREACH:
 		D_ERROR("rpc opc: %#x to group %s, rank %d, tgt_uri %s "
 			"can't reach the target.\n",
@@ -783,6 +862,7 @@ crt_context_req_track(crt_rpc_t *req)
 		D_INIT_LIST_HEAD(&epi->epi_req_q);
 		epi->epi_req_num = 0;
 		epi->epi_reply_num = 0;
+		epi->epi_sm_reply_num = 0;
 		D_INIT_LIST_HEAD(&epi->epi_req_waitq);
 		epi->epi_req_wait_num = 0;
 		/* epi_ref init as 1 to avoid other thread delete it but here
@@ -876,6 +956,7 @@ crt_context_req_untrack(crt_rpc_t *req)
 		 rpc_priv->crp_state == RPC_STATE_TIMEOUT ||
 		 rpc_priv->crp_state == RPC_STATE_ADDR_LOOKUP ||
 		 rpc_priv->crp_state == RPC_STATE_URI_LOOKUP ||
+		 rpc_priv->crp_state == RPC_STATE_ADDR_WAIT ||
 		 rpc_priv->crp_state == RPC_STATE_CANCELED ||
 		 rpc_priv->crp_state == RPC_STATE_FWD_UNREACH);
 	epi = rpc_priv->crp_epi;
@@ -886,9 +967,11 @@ crt_context_req_untrack(crt_rpc_t *req)
 	D_MUTEX_LOCK(&epi->epi_mutex);
 	/* remove from inflight queue */
 	d_list_del_init(&rpc_priv->crp_epi_link);
-	if (rpc_priv->crp_state == RPC_STATE_COMPLETED)
+	if (rpc_priv->crp_state == RPC_STATE_COMPLETED) {
 		epi->epi_reply_num++;
-	else /* RPC_CANCELED or RPC_INITED or RPC_TIMEOUT */
+		if (rpc_priv->crp_sm_route)
+			epi->epi_sm_reply_num++;
+	} else /* RPC_CANCELED or RPC_INITED or RPC_TIMEOUT */
 		epi->epi_req_num--;
 	D_ASSERT(epi->epi_req_num >= epi->epi_reply_num);
 
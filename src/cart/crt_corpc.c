@@ -41,10 +41,37 @@
 
 #include "crt_internal.h"
 
+static inline void
+crt_corpc_fail_child_rpc(struct crt_rpc_priv *parent_rpc_priv,
+			 uint32_t failed_num, int failed_rc);
+
+/* drop the filter ranks that are not members of grp_priv */
+static void
+crt_corpc_filter_ranks_trim(struct crt_grp_priv *grp_priv,
+			    d_rank_list_t *filter_ranks)
+{
+	d_rank_t	grp_rank;
+	uint32_t	nr = 0;
+	uint32_t	i;
+
+	if (filter_ranks == NULL)
+		return;
+
+	for (i = 0; i < filter_ranks->rl_nr; i++) {
+		if (grp_priv->gp_primary ?
+		    filter_ranks->rl_ranks[i] >= grp_priv->gp_membs->rl_nr :
+		    crt_grp_rank_p2s(grp_priv, filter_ranks->rl_ranks[i],
+				     &grp_rank) != 0)
+			continue;
+		filter_ranks->rl_ranks[nr++] = filter_ranks->rl_ranks[i];
+	}
+	filter_ranks->rl_nr = nr;
+}
+
 static inline int
 crt_corpc_info_init(struct crt_rpc_priv *rpc_priv,
 		    struct crt_grp_priv *grp_priv, bool grp_ref_taken,
-		    d_rank_list_t *excluded_ranks, uint32_t grp_ver,
+		    d_rank_list_t *filter_ranks, uint32_t grp_ver,
 		    crt_bulk_t co_bulk_hdl, void *priv, uint32_t flags,
 		    int tree_topo, d_rank_t grp_root, bool init_hdr,
 		    bool root_excluded)
@@ -60,8 +87,8 @@ crt_corpc_info_init(struct crt_rpc_priv *rpc_priv,
 	if (co_info == NULL)
 		D_GOTO(out, rc = -DER_NOMEM);
 
-	rc = d_rank_list_dup_sort_uniq(&co_info->co_excluded_ranks,
-				       excluded_ranks);
+	rc = d_rank_list_dup_sort_uniq(&co_info->co_filter_ranks,
+				       filter_ranks);
 	if (rc != 0) {
 		D_ERROR("d_rank_list_dup failed, rc: %d.\n", rc);
 		D_FREE_PTR(co_info);
@@ -71,12 +98,12 @@ crt_corpc_info_init(struct crt_rpc_priv *rpc_priv,
 		crt_grp_priv_addref(grp_priv);
 	co_info->co_grp_ref_taken = 1;
 	co_info->co_grp_priv = grp_priv;
-	d_rank_list_filter(co_info->co_grp_priv->gp_membs,
-			   co_info->co_excluded_ranks, false /* exclude */);
+	crt_corpc_filter_ranks_trim(grp_priv, co_info->co_filter_ranks);
 	co_info->co_grp_ver = grp_ver;
 	co_info->co_tree_topo = tree_topo;
 	co_info->co_root = grp_root;
 	co_info->co_root_excluded = root_excluded;
+	co_info->co_filter_incl = (flags & CRT_RPC_FLAG_INCLUSIVE) != 0;
 
 	rpc_priv->crp_pub.cr_co_bulk_hdl = co_bulk_hdl;
 	co_info->co_priv = priv;
@@ -91,13 +118,16 @@ crt_corpc_info_init(struct crt_rpc_priv *rpc_priv,
 			rpc_priv->crp_flags |= CRT_RPC_FLAG_PRIMARY_GRP;
 		else if (flags & CRT_RPC_FLAG_GRP_DESTROY)
 			rpc_priv->crp_flags |= CRT_RPC_FLAG_GRP_DESTROY;
+		if (flags & CRT_RPC_FLAG_INCLUSIVE)
+			rpc_priv->crp_flags |= CRT_RPC_FLAG_INCLUSIVE;
 
 		co_hdr->coh_int_grpid = grp_priv->gp_int_grpid;
-		co_hdr->coh_excluded_ranks = co_info->co_excluded_ranks;
+		co_hdr->coh_filter_ranks = co_info->co_filter_ranks;
 		co_hdr->coh_inline_ranks = NULL;
 		co_hdr->coh_grp_ver = grp_ver;
 		co_hdr->coh_tree_topo = tree_topo;
 		co_hdr->coh_root = grp_root;
+		co_hdr->coh_host_map = 0;
 	}
 	co_hdr->coh_bulk_hdl = co_bulk_hdl;
 
@@ -112,7 +142,7 @@ void
 crt_corpc_info_fini(struct crt_rpc_priv *rpc_priv)
 {
 	D_ASSERT(rpc_priv->crp_coll && rpc_priv->crp_corpc_info);
-	d_rank_list_free(rpc_priv->crp_corpc_info->co_excluded_ranks);
+	d_rank_list_free(rpc_priv->crp_corpc_info->co_filter_ranks);
 	if (rpc_priv->crp_corpc_info->co_grp_ref_taken)
 		crt_grp_priv_decref(rpc_priv->crp_corpc_info->co_grp_priv);
 	D_FREE_PTR(rpc_priv->crp_corpc_info);
@@ -147,7 +177,7 @@ crt_corpc_initiate(struct crt_rpc_priv *rpc_priv)
 	}
 
 	rc = crt_corpc_info_init(rpc_priv, grp_priv, grp_ref_taken,
-			co_hdr->coh_excluded_ranks,
+			co_hdr->coh_filter_ranks,
 			co_hdr->coh_grp_ver /* grp_ver */,
 			rpc_priv->crp_pub.cr_co_bulk_hdl,
 			NULL /* priv */, rpc_priv->crp_flags,
@@ -171,6 +201,89 @@ out:
 	return rc;
 }
 
+static int
+crt_corpc_free_chained_bulk(crt_bulk_t bulk_hdl)
+{
+	d_iov_t		*iovs = NULL;
+	d_sg_list_t	 sgl;
+	uint32_t	 seg_num;
+	int		 i, rc = 0;
+
+	if (bulk_hdl == CRT_BULK_NULL)
+		return 0;
+
+	sgl.sg_nr = 0;
+	sgl.sg_iovs = NULL;
+	rc = crt_bulk_access(bulk_hdl, &sgl);
+	if (rc != -DER_TRUNC) {
+		if (rc == 0)
+			rc = -DER_PROTO;
+		D_ERROR("crt_bulk_access failed, rc: %d.\n", rc);
+		D_GOTO(out, rc);
+	}
+
+	seg_num = sgl.sg_nr_out;
+	if (seg_num == 0) {
+		D_ERROR("bad zero seg_num.\n");
+		D_GOTO(out, rc = -DER_PROTO);
+	}
+	D_ALLOC_ARRAY(iovs, seg_num);
+	if (iovs == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	sgl.sg_nr = seg_num;
+	sgl.sg_iovs = iovs;
+	rc = crt_bulk_access(bulk_hdl, &sgl);
+	if (rc != 0) {
+		D_ERROR("crt_bulk_access failed, rc: %d.\n", rc);
+		D_GOTO(out, rc);
+	}
+
+	for (i = 0; i < seg_num; i++)
+		free(iovs[i].iov_buf);
+
+	rc = crt_bulk_free(bulk_hdl);
+	if (rc != 0)
+		D_ERROR("crt_bulk_free failed, rc: %d.\n", rc);
+
+out:
+	if (iovs != NULL)
+		D_FREE(iovs);
+	return rc;
+}
+
+/*
+ * Release the local copy of the chained bulk of a forwarded corpc. A pooled
+ * buffer goes back to its pool together with its cached view handle. That
+ * handle covers memory inside the pool's registered slab, so it must never
+ * be freed, nor its segment free()d, as a calloc()ed chained bulk is.
+ * local_buf is the buffer of a local_bulk_hdl not passed on yet, NULL to find
+ * the segments through crt_bulk_access().
+ */
+static void
+crt_corpc_local_bulk_release(struct crt_rpc_priv *rpc_priv,
+			     crt_bulk_t local_bulk_hdl, void *local_buf)
+{
+	int	rc;
+
+	if (rpc_priv->crp_co_buf != NULL) {
+		crt_buf_put(rpc_priv->crp_co_buf);
+		rpc_priv->crp_co_buf = NULL;
+		return;
+	}
+
+	if (local_buf != NULL) {
+		crt_bulk_free(local_bulk_hdl);
+		free(local_buf);
+		return;
+	}
+
+	rc = crt_corpc_free_chained_bulk(local_bulk_hdl);
+	if (rc != 0)
+		D_ERROR("crt_corpc_free_chainded_bulk failed, rc: %d, "
+			"opc: %#x.\n", rc, rpc_priv->crp_pub.cr_opc);
+}
+
 static int
 crt_corpc_chained_bulk_cb(const struct crt_bulk_cb_info *cb_info)
 {
@@ -195,7 +308,9 @@ crt_corpc_chained_bulk_cb(const struct crt_bulk_cb_info *cb_info)
 	if (rc != 0) {
 		D_ERROR("crt_corpc_chained_bulk_cb, bulk failed, rc: %d, "
 			"opc: %#x.\n", rc, rpc_req->cr_opc);
-		D_FREE(bulk_buf);
+		crt_corpc_local_bulk_release(rpc_priv, local_bulk_hdl,
+					     bulk_buf);
+		crt_hg_reply_error_send(rpc_priv, rc);
 		D_GOTO(out, rc);
 	}
 
@@ -212,57 +327,486 @@ out:
 	return rc;
 }
 
+/*
+ * Take the local buffer of the chained bulk from the context's registered
+ * buffer pool. The handle forwarded to the children and passed to the handler
+ * has to cover exactly bulk_len bytes, it is cached in the pooled buffer so
+ * that collectives of the same size do not register memory again.
+ */
 static int
-crt_corpc_free_chained_bulk(crt_bulk_t bulk_hdl)
+crt_corpc_chained_bulk_pool_get(struct crt_rpc_priv *rpc_priv, size_t bulk_len,
+				d_iov_t *bulk_iov, crt_bulk_t *local_bulk_hdl)
 {
-	d_iov_t		*iovs = NULL;
-	d_sg_list_t	 sgl;
-	uint32_t	 seg_num;
-	int		 i, rc = 0;
+	struct crt_buf_pool	*pool;
+	struct crt_buf		*co_buf;
+	int			 rc;
 
-	if (bulk_hdl == CRT_BULK_NULL)
-		return 0;
+	pool = crt_context_buf_pool(rpc_priv->crp_pub.cr_ctx);
+	if (pool == NULL)
+		return -DER_NOSPACE;
 
-	sgl.sg_nr = 0;
-	sgl.sg_iovs = NULL;
-	rc = crt_bulk_access(bulk_hdl, &sgl);
-	if (rc != -DER_TRUNC) {
-		if (rc == 0)
-			rc = -DER_PROTO;
-		D_ERROR("crt_bulk_access failed, rc: %d.\n", rc);
-		D_GOTO(out, rc);
+	rc = crt_buf_get(pool, bulk_len, &co_buf);
+	if (rc != 0)
+		return rc;
+
+	rc = crt_buf_view(co_buf, bulk_len, local_bulk_hdl);
+	if (rc != 0) {
+		crt_buf_put(co_buf);
+		return rc;
 	}
 
-	seg_num = sgl.sg_nr_out;
-	if (seg_num == 0) {
-		D_ERROR("bad zero seg_num.\n");
-		D_GOTO(out, rc = -DER_PROTO);
+	bulk_iov->iov_buf = co_buf->cb_buf;
+	bulk_iov->iov_buf_len = bulk_len;
+	rpc_priv->crp_co_buf = co_buf;
+
+	return 0;
+}
+
+/*
+ * Pipelined chained bulk.
+ *
+ * A chained bulk larger than one segment (ENV CRT_CORPC_SEG_SIZE) is pulled
+ * segment by segment. A forwarding node forwards the corpc to its children
+ * right away, with its own local buffer as their chained bulk, and they pull
+ * each segment from it as soon as it landed here. A node learns how many
+ * segments its parent holds with CRT_OPC_CORPC_SEG_WAIT, which the parent
+ * replies once it has pulled at least the number asked for. The root holds the
+ * whole bulk and marks it with CRT_CORPC_SEG_COMPLETE, its children never
+ * wait. The local RPC handler runs once the whole bulk is pulled.
+ */
+struct crt_corpc_pipe {
+	/* link to crt_corpc_pipes */
+	d_list_t		 cpp_link;
+	/* list of struct crt_corpc_pipe_waiter */
+	d_list_t		 cpp_waiters;
+	struct crt_rpc_priv	*cpp_rpc;
+	crt_bulk_t		 cpp_parent_hdl;
+	crt_bulk_t		 cpp_local_hdl;
+	size_t			 cpp_len;
+	uint32_t		 cpp_id;
+	/* parent's pipe and rank, to wait for its segments */
+	uint32_t		 cpp_parent_id;
+	d_rank_t		 cpp_parent_rank;
+	uint32_t		 cpp_shift;
+	uint32_t		 cpp_seg_nr;
+	/* number of segments pulled into the local buffer */
+	uint32_t		 cpp_pulled;
+	/* number of segments known to be held by the parent */
+	uint32_t		 cpp_parent_avail;
+	/* a segment is being pulled */
+	uint32_t		 cpp_pulling:1,
+	/* a CRT_OPC_CORPC_SEG_WAIT is in flight */
+				 cpp_waiting:1,
+	/* whole bulk pulled, or the pipe failed or stopped */
+				 cpp_done:1;
+	int			 cpp_rc;
+};
+
+/* a child's CRT_OPC_CORPC_SEG_WAIT, replied once csw_want segments landed */
+struct crt_corpc_pipe_waiter {
+	d_list_t		 cpw_link;
+	crt_rpc_t		*cpw_rpc;
+	uint32_t		 cpw_want;
+};
+
+/* protects crt_corpc_pipes and all pipes on it */
+static pthread_mutex_t	crt_corpc_pipe_lock = PTHREAD_MUTEX_INITIALIZER;
+static D_LIST_HEAD(crt_corpc_pipes);
+static uint32_t		crt_corpc_pipe_next_id;
+
+static void crt_corpc_pipe_progress(struct crt_corpc_pipe *pipe);
+
+/* called with crt_corpc_pipe_lock held */
+static struct crt_corpc_pipe *
+crt_corpc_pipe_lookup(uint32_t id)
+{
+	struct crt_corpc_pipe	*pipe;
+
+	d_list_for_each_entry(pipe, &crt_corpc_pipes, cpp_link) {
+		if (pipe->cpp_id == id)
+			return pipe;
 	}
-	D_ALLOC_ARRAY(iovs, seg_num);
-	if (iovs == NULL)
-		D_GOTO(out, rc = -DER_NOMEM);
 
-	sgl.sg_nr = seg_num;
-	sgl.sg_iovs = iovs;
-	rc = crt_bulk_access(bulk_hdl, &sgl);
-	if (rc != 0) {
-		D_ERROR("crt_bulk_access failed, rc: %d.\n", rc);
-		D_GOTO(out, rc);
+	return NULL;
+}
+
+/* reply and release the waiters moved out of a pipe */
+static void
+crt_corpc_pipe_wake(d_list_t *waiters, uint32_t avail, int wait_rc)
+{
+	struct crt_corpc_pipe_waiter	*waiter, *next;
+	struct crt_corpc_seg_wait_out	*out;
+	int				 rc;
+
+	d_list_for_each_entry_safe(waiter, next, waiters, cpw_link) {
+		d_list_del(&waiter->cpw_link);
+		out = crt_reply_get(waiter->cpw_rpc);
+		out->csw_avail = avail;
+		out->csw_rc = wait_rc;
+		rc = crt_reply_send(waiter->cpw_rpc);
+		if (rc != 0)
+			D_ERROR("crt_reply_send failed, rc: %d.\n", rc);
+		crt_req_decref(waiter->cpw_rpc);
+		D_FREE_PTR(waiter);
 	}
+}
 
-	for (i = 0; i < seg_num; i++)
-		free(iovs[i].iov_buf);
+static void
+crt_corpc_pipe_stop(struct crt_corpc_pipe *pipe)
+{
+	d_list_t	waiters;
 
-	rc = crt_bulk_free(bulk_hdl);
-	if (rc != 0)
-		D_ERROR("crt_bulk_free failed, rc: %d.\n", rc);
+	D_INIT_LIST_HEAD(&waiters);
+
+	D_MUTEX_LOCK(&crt_corpc_pipe_lock);
+	d_list_del_init(&pipe->cpp_link);
+	pipe->cpp_done = 1;
+	d_list_splice_init(&pipe->cpp_waiters, &waiters);
+	D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+
+	crt_corpc_pipe_wake(&waiters, 0, -DER_CANCELED);
+}
+
+void
+crt_corpc_pipe_free(struct crt_corpc_pipe *pipe)
+{
+	crt_corpc_pipe_stop(pipe);
+	D_FREE_PTR(pipe);
+}
+
+static int
+crt_corpc_pipe_get_cb(const struct crt_bulk_cb_info *cb_info)
+{
+	struct crt_corpc_pipe	*pipe = cb_info->bci_arg;
+	struct crt_rpc_priv	*rpc_priv = pipe->cpp_rpc;
+
+	D_MUTEX_LOCK(&crt_corpc_pipe_lock);
+	pipe->cpp_pulling = 0;
+	if (cb_info->bci_rc != 0) {
+		D_ERROR("pull of segment %d failed, rc: %d, opc: %#x.\n",
+			pipe->cpp_pulled, cb_info->bci_rc,
+			rpc_priv->crp_pub.cr_opc);
+		if (pipe->cpp_rc == 0)
+			pipe->cpp_rc = cb_info->bci_rc;
+	} else {
+		pipe->cpp_pulled++;
+	}
+	D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+
+	crt_corpc_pipe_progress(pipe);
+
+	/* corresponds to addref in crt_corpc_pipe_get */
+	RPC_DECREF(rpc_priv);
+	return 0;
+}
+
+/* pull segment seg from the parent */
+static int
+crt_corpc_pipe_get(struct crt_corpc_pipe *pipe, uint32_t seg)
+{
+	struct crt_bulk_desc	bulk_desc;
+	size_t			off;
+	int			rc;
+
+	off = (size_t)seg << pipe->cpp_shift;
+
+	bulk_desc.bd_rpc = &pipe->cpp_rpc->crp_pub;
+	bulk_desc.bd_bulk_op = CRT_BULK_GET;
+	bulk_desc.bd_remote_hdl = pipe->cpp_parent_hdl;
+	bulk_desc.bd_remote_off = off;
+	bulk_desc.bd_local_hdl = pipe->cpp_local_hdl;
+	bulk_desc.bd_local_off = off;
+	bulk_desc.bd_len = min(pipe->cpp_len - off,
+			       (size_t)1 << pipe->cpp_shift);
+
+	RPC_ADDREF(pipe->cpp_rpc);
+	rc = crt_bulk_transfer(&bulk_desc, crt_corpc_pipe_get_cb, pipe, NULL);
+	if (rc != 0) {
+		D_ERROR("crt_bulk_transfer failed, rc: %d, opc: %#x.\n",
+			rc, pipe->cpp_rpc->crp_pub.cr_opc);
+		RPC_DECREF(pipe->cpp_rpc);
+	}
 
-out:
-	if (iovs != NULL)
-		D_FREE(iovs);
 	return rc;
 }
 
+static void
+crt_corpc_pipe_wait_cb(const struct crt_cb_info *cb_info)
+{
+	struct crt_corpc_pipe		*pipe = cb_info->cci_arg;
+	struct crt_rpc_priv		*rpc_priv = pipe->cpp_rpc;
+	struct crt_corpc_seg_wait_out	*out = NULL;
+	int				 rc;
+
+	rc = cb_info->cci_rc;
+	if (rc == 0) {
+		out = crt_reply_get(cb_info->cci_rpc);
+		rc = out->csw_rc;
+	}
+
+	D_MUTEX_LOCK(&crt_corpc_pipe_lock);
+	pipe->cpp_waiting = 0;
+	if (rc != 0) {
+		D_ERROR("wait for segment %d of parent %d failed, rc: %d, "
+			"opc: %#x.\n", pipe->cpp_parent_avail,
+			pipe->cpp_parent_rank, rc, rpc_priv->crp_pub.cr_opc);
+		if (pipe->cpp_rc == 0)
+			pipe->cpp_rc = rc;
+	} else if (out->csw_avail > pipe->cpp_parent_avail) {
+		pipe->cpp_parent_avail = min(out->csw_avail,
+					     pipe->cpp_seg_nr);
+	}
+	D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+
+	crt_corpc_pipe_progress(pipe);
+
+	/* corresponds to addref in crt_corpc_pipe_wait */
+	RPC_DECREF(rpc_priv);
+}
+
+/* ask the parent to reply once it holds want segments */
+static void
+crt_corpc_pipe_wait(struct crt_corpc_pipe *pipe, uint32_t want)
+{
+	struct crt_corpc_seg_wait_in	*in;
+	crt_endpoint_t			 tgt_ep = {0};
+	crt_rpc_t			*req;
+	int				 rc;
+
+	tgt_ep.ep_rank = pipe->cpp_parent_rank;
+	rc = crt_req_create(pipe->cpp_rpc->crp_pub.cr_ctx, &tgt_ep,
+			    CRT_OPC_CORPC_SEG_WAIT, &req);
+	if (rc != 0) {
+		struct crt_cb_info	cb_info;
+
+		D_ERROR("crt_req_create failed, rc: %d.\n", rc);
+		RPC_ADDREF(pipe->cpp_rpc);
+		cb_info.cci_rpc = NULL;
+		cb_info.cci_arg = pipe;
+		cb_info.cci_rc = rc;
+		crt_corpc_pipe_wait_cb(&cb_info);
+		return;
+	}
+
+	in = crt_req_get(req);
+	in->csw_id = pipe->cpp_parent_id;
+	in->csw_want = want;
+
+	RPC_ADDREF(pipe->cpp_rpc);
+	/* failures are reported through crt_corpc_pipe_wait_cb */
+	crt_req_send(req, crt_corpc_pipe_wait_cb, pipe);
+}
+
+/*
+ * Move the pipe forward: wake the children waiting for pulled segments, pull
+ * the next segment the parent holds and ask the parent for more before running
+ * out of them. Runs the local handler once the whole bulk is pulled, or fails
+ * the local part of the corpc after a failed pull.
+ */
+static void
+crt_corpc_pipe_progress(struct crt_corpc_pipe *pipe)
+{
+	struct crt_rpc_priv		*rpc_priv = pipe->cpp_rpc;
+	struct crt_corpc_pipe_waiter	*waiter, *next;
+	d_list_t			 ready;
+	uint32_t			 avail;
+	uint32_t			 seg = 0;
+	uint32_t			 want = 0;
+	bool				 get = false;
+	bool				 wait = false;
+	bool				 local = false;
+	int				 pipe_rc;
+	int				 rc;
+
+	D_INIT_LIST_HEAD(&ready);
+
+	D_MUTEX_LOCK(&crt_corpc_pipe_lock);
+	/* a failure is handled once the in flight pull returned */
+	if (pipe->cpp_done || pipe->cpp_pulling) {
+		D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+		return;
+	}
+
+	pipe_rc = pipe->cpp_rc;
+	avail = pipe->cpp_pulled;
+	if (pipe_rc != 0) {
+		pipe->cpp_done = 1;
+		d_list_splice_init(&pipe->cpp_waiters, &ready);
+	} else {
+		d_list_for_each_entry_safe(waiter, next, &pipe->cpp_waiters,
+					   cpw_link) {
+			if (waiter->cpw_want <= avail)
+				d_list_move_tail(&waiter->cpw_link, &ready);
+		}
+
+		if (avail == pipe->cpp_seg_nr) {
+			pipe->cpp_done = 1;
+			local = true;
+		} else {
+			if (avail < pipe->cpp_parent_avail) {
+				seg = avail;
+				pipe->cpp_pulling = 1;
+				get = true;
+			}
+			if (!pipe->cpp_waiting &&
+			    pipe->cpp_parent_avail < pipe->cpp_seg_nr &&
+			    pipe->cpp_parent_avail <= avail + 1) {
+				want = pipe->cpp_parent_avail + 1;
+				pipe->cpp_waiting = 1;
+				wait = true;
+			}
+		}
+	}
+	D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+
+	crt_corpc_pipe_wake(&ready, avail, pipe_rc);
+
+	if (pipe_rc != 0) {
+		struct crt_cb_info	cb_info;
+
+		/*
+		 * fail the local part as a local reply, so that the replies
+		 * of the children queued for co_local_done are released.
+		 */
+		rpc_priv->crp_reply_hdr.cch_rc = pipe_rc;
+		cb_info.cci_rpc = &rpc_priv->crp_pub;
+		cb_info.cci_rc = pipe_rc;
+		cb_info.cci_arg = rpc_priv;
+		crt_corpc_reply_hdlr(&cb_info);
+		return;
+	}
+
+	if (local) {
+		rc = crt_rpc_common_hdlr(rpc_priv);
+		if (rc != 0)
+			D_ERROR("crt_rpc_common_hdlr (opc: %#x) failed, "
+				"rc: %d.\n", rpc_priv->crp_pub.cr_opc, rc);
+		return;
+	}
+
+	if (get) {
+		rc = crt_corpc_pipe_get(pipe, seg);
+		if (rc != 0) {
+			D_MUTEX_LOCK(&crt_corpc_pipe_lock);
+			pipe->cpp_pulling = 0;
+			pipe->cpp_rc = rc;
+			if (wait) {
+				pipe->cpp_waiting = 0;
+				wait = false;
+			}
+			D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+			crt_corpc_pipe_progress(pipe);
+		}
+	}
+
+	if (wait)
+		crt_corpc_pipe_wait(pipe, want);
+}
+
+/*
+ * Start pulling the chained bulk of a received corpc by segments and forward
+ * the corpc to the children without waiting for it.
+ */
+static int
+crt_corpc_pipe_start(struct crt_rpc_priv *rpc_priv, crt_bulk_t parent_bulk_hdl,
+		     crt_bulk_t local_bulk_hdl, size_t bulk_len)
+{
+	struct crt_corpc_hdr	*co_hdr = &rpc_priv->crp_coreq_hdr;
+	struct crt_corpc_pipe	*pipe;
+	int			 rc;
+
+	D_ALLOC_PTR(pipe);
+	if (pipe == NULL)
+		return -DER_NOMEM;
+
+	D_INIT_LIST_HEAD(&pipe->cpp_link);
+	D_INIT_LIST_HEAD(&pipe->cpp_waiters);
+	pipe->cpp_rpc = rpc_priv;
+	pipe->cpp_parent_hdl = parent_bulk_hdl;
+	pipe->cpp_local_hdl = local_bulk_hdl;
+	pipe->cpp_len = bulk_len;
+	pipe->cpp_shift = co_hdr->coh_seg & CRT_CORPC_SEG_SHIFT_MASK;
+	pipe->cpp_seg_nr = (bulk_len + ((size_t)1 << pipe->cpp_shift) - 1) >>
+			   pipe->cpp_shift;
+	pipe->cpp_parent_id = co_hdr->coh_seg >> CRT_CORPC_SEG_ID_SHIFT;
+	pipe->cpp_parent_rank = rpc_priv->crp_req_hdr.cch_rank;
+	if (co_hdr->coh_seg & CRT_CORPC_SEG_COMPLETE)
+		pipe->cpp_parent_avail = pipe->cpp_seg_nr;
+
+	D_MUTEX_LOCK(&crt_corpc_pipe_lock);
+	pipe->cpp_id = crt_corpc_pipe_next_id++ & CRT_CORPC_SEG_ID_MASK;
+	d_list_add_tail(&pipe->cpp_link, &crt_corpc_pipes);
+	D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+
+	/* the children pull from this node, and wait for this pipe */
+	co_hdr->coh_seg = pipe->cpp_shift |
+			  (pipe->cpp_id << CRT_CORPC_SEG_ID_SHIFT);
+	rpc_priv->crp_co_pipe = pipe;
+
+	rpc_priv->crp_pub.cr_co_bulk_hdl = local_bulk_hdl;
+	rc = crt_corpc_initiate(rpc_priv);
+	if (rc != 0) {
+		D_ERROR("crt_corpc_initiate failed, rc: %d, opc: %#x.\n",
+			rc, rpc_priv->crp_pub.cr_opc);
+		rpc_priv->crp_co_pipe = NULL;
+		rpc_priv->crp_pub.cr_co_bulk_hdl = CRT_BULK_NULL;
+		crt_corpc_pipe_free(pipe);
+		return rc;
+	}
+
+	D_DEBUG(DB_TRACE, "pipe %d pulls %zu bytes in %d segments from rank "
+		"%d pipe %d, opc: %#x.\n", pipe->cpp_id, bulk_len,
+		pipe->cpp_seg_nr, pipe->cpp_parent_rank, pipe->cpp_parent_id,
+		rpc_priv->crp_pub.cr_opc);
+
+	crt_corpc_pipe_progress(pipe);
+
+	return 0;
+}
+
+void
+crt_hdlr_corpc_seg_wait(crt_rpc_t *rpc_req)
+{
+	struct crt_corpc_seg_wait_in	*in;
+	struct crt_corpc_seg_wait_out	*out;
+	struct crt_corpc_pipe_waiter	*waiter;
+	struct crt_corpc_pipe		*pipe;
+	int				 rc = 0;
+
+	in = crt_req_get(rpc_req);
+	out = crt_reply_get(rpc_req);
+
+	D_ALLOC_PTR(waiter);
+
+	D_MUTEX_LOCK(&crt_corpc_pipe_lock);
+	pipe = crt_corpc_pipe_lookup(in->csw_id);
+	if (pipe == NULL) {
+		rc = -DER_NONEXIST;
+	} else if (pipe->cpp_rc != 0) {
+		rc = pipe->cpp_rc;
+	} else if (pipe->cpp_pulled >= in->csw_want) {
+		out->csw_avail = pipe->cpp_pulled;
+	} else if (waiter == NULL) {
+		rc = -DER_NOMEM;
+	} else {
+		/* replied by crt_corpc_pipe_progress */
+		crt_req_addref(rpc_req);
+		waiter->cpw_rpc = rpc_req;
+		waiter->cpw_want = in->csw_want;
+		d_list_add_tail(&waiter->cpw_link, &pipe->cpp_waiters);
+		D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+		return;
+	}
+	D_MUTEX_UNLOCK(&crt_corpc_pipe_lock);
+
+	D_FREE_PTR(waiter);
+
+	out->csw_rc = rc;
+	rc = crt_reply_send(rpc_req);
+	if (rc != 0)
+		D_ERROR("crt_reply_send failed, rc: %d.\n", rc);
+}
+
 /* only be called in crt_rpc_handler_common after RPC header unpacked */
 int
 crt_corpc_common_hdlr(struct crt_rpc_priv *rpc_priv)
@@ -297,19 +841,37 @@ crt_corpc_common_hdlr(struct crt_rpc_priv *rpc_priv)
 			D_GOTO(out, rc);
 		}
 
-		bulk_iov.iov_buf = calloc(1, bulk_len);
-		if (bulk_iov.iov_buf == NULL)
-			D_GOTO(out, rc = -DER_NOMEM);
-		bulk_iov.iov_buf_len = bulk_len;
-		bulk_sgl.sg_nr = 1;
-		bulk_sgl.sg_iovs = &bulk_iov;
-
-		rc = crt_bulk_create(rpc_priv->crp_pub.cr_ctx, &bulk_sgl,
-				     CRT_BULK_RW, &local_bulk_hdl);
+		rc = crt_corpc_chained_bulk_pool_get(rpc_priv, bulk_len,
+						     &bulk_iov,
+						     &local_bulk_hdl);
 		if (rc != 0) {
-			D_ERROR("crt_bulk_create failed, rc: %d, opc: %#x.\n",
-				rc, rpc_priv->crp_pub.cr_opc);
-			free(bulk_iov.iov_buf);
+			/* no pooled buffer, allocate and register one */
+			bulk_iov.iov_buf = calloc(1, bulk_len);
+			if (bulk_iov.iov_buf == NULL)
+				D_GOTO(out, rc = -DER_NOMEM);
+			bulk_iov.iov_buf_len = bulk_len;
+			bulk_sgl.sg_nr = 1;
+			bulk_sgl.sg_iovs = &bulk_iov;
+
+			rc = crt_bulk_create(rpc_priv->crp_pub.cr_ctx,
+					     &bulk_sgl, CRT_BULK_RW,
+					     &local_bulk_hdl);
+			if (rc != 0) {
+				D_ERROR("crt_bulk_create failed, rc: %d, "
+					"opc: %#x.\n", rc,
+					rpc_priv->crp_pub.cr_opc);
+				free(bulk_iov.iov_buf);
+				D_GOTO(out, rc);
+			}
+		}
+
+		if (co_hdr->coh_seg & CRT_CORPC_SEG_SHIFT_MASK) {
+			rc = crt_corpc_pipe_start(rpc_priv, parent_bulk_hdl,
+						  local_bulk_hdl, bulk_len);
+			if (rc != 0)
+				crt_corpc_local_bulk_release(rpc_priv,
+							     local_bulk_hdl,
+							     bulk_iov.iov_buf);
 			D_GOTO(out, rc);
 		}
 
@@ -328,7 +890,8 @@ crt_corpc_common_hdlr(struct crt_rpc_priv *rpc_priv)
 		if (rc != 0) {
 			D_ERROR("crt_bulk_transfer failed, rc: %d,opc: %#x.\n",
 				rc, rpc_priv->crp_pub.cr_opc);
-			D_FREE(bulk_iov.iov_buf);
+			crt_corpc_local_bulk_release(rpc_priv, local_bulk_hdl,
+						     bulk_iov.iov_buf);
 			RPC_DECREF(rpc_priv);
 		}
 		D_GOTO(out, rc);
@@ -349,7 +912,7 @@ out:
 
 int
 crt_corpc_req_create(crt_context_t crt_ctx, crt_group_t *grp,
-		     d_rank_list_t *excluded_ranks, crt_opcode_t opc,
+		     d_rank_list_t *filter_ranks, crt_opcode_t opc,
 		     crt_bulk_t co_bulk_hdl, void *priv,  uint32_t flags,
 		     int tree_topo, crt_rpc_t **req)
 {
@@ -357,7 +920,7 @@ crt_corpc_req_create(crt_context_t crt_ctx, crt_group_t *grp,
 	struct crt_grp_priv	*default_grp_priv;
 	struct crt_grp_gdata	*grp_gdata;
 	struct crt_rpc_priv	*rpc_priv = NULL;
-	d_rank_list_t		*tobe_excluded_ranks = NULL;
+	d_rank_list_t		*tobe_filter_ranks = NULL;
 	bool			 root_excluded = false;
 	crt_rpc_t		*rpc_pub;
 	d_rank_t		 grp_root, pri_root;
@@ -414,12 +977,28 @@ crt_corpc_req_create(crt_context_t crt_ctx, crt_group_t *grp,
 	/* grp_root is logical rank number in this group */
 	grp_root = grp_priv->gp_self;
 	pri_root = grp_priv->gp_membs->rl_ranks[grp_root];
-	tobe_excluded_ranks = excluded_ranks;
+	tobe_filter_ranks = filter_ranks;
 	/*
-	 * if bcast initiator is in excluded ranks, here we remove it and set
-	 * a special flag to indicate need not to execute RPC handler.
+	 * if bcast initiator is in excluded ranks, or not in the included
+	 * ones, here we put it in the tree and set a special flag to indicate
+	 * need not to execute RPC handler.
 	 */
-	if (d_rank_in_rank_list(excluded_ranks, pri_root)) {
+	if (flags & CRT_RPC_FLAG_INCLUSIVE) {
+		if (!d_rank_in_rank_list(filter_ranks, pri_root)) {
+			if (filter_ranks == NULL)
+				tobe_filter_ranks = d_rank_list_alloc(0);
+			else
+				rc = d_rank_list_dup(&tobe_filter_ranks,
+						     filter_ranks);
+			if (rc != 0 || tobe_filter_ranks == NULL)
+				D_GOTO(out, rc = -DER_NOMEM);
+			root_excluded = true;
+
+			rc = d_rank_list_append(tobe_filter_ranks, pri_root);
+			if (rc != 0)
+				D_GOTO(out, rc);
+		}
+	} else if (d_rank_in_rank_list(filter_ranks, pri_root)) {
 		d_rank_list_t		tmp_rank_list;
 		d_rank_t		tmp_rank;
 
@@ -427,11 +1006,11 @@ crt_corpc_req_create(crt_context_t crt_ctx, crt_group_t *grp,
 		tmp_rank_list.rl_nr = 1;
 		tmp_rank_list.rl_ranks = &tmp_rank;
 
-		rc =  d_rank_list_dup(&tobe_excluded_ranks, excluded_ranks);
+		rc =  d_rank_list_dup(&tobe_filter_ranks, filter_ranks);
 		if (rc != 0)
 			D_GOTO(out, rc);
 
-		d_rank_list_filter(&tmp_rank_list, tobe_excluded_ranks,
+		d_rank_list_filter(&tmp_rank_list, tobe_filter_ranks,
 				   true /* exclude */);
 		root_excluded = true;
 	}
@@ -440,7 +1019,7 @@ crt_corpc_req_create(crt_context_t crt_ctx, crt_group_t *grp,
 	grp_ver = default_grp_priv->gp_membs_ver;
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
 
-	rc = crt_corpc_info_init(rpc_priv, grp_priv, false, tobe_excluded_ranks,
+	rc = crt_corpc_info_init(rpc_priv, grp_priv, false, tobe_filter_ranks,
 				 grp_ver /* grp_ver */, co_bulk_hdl, priv,
 				 flags, tree_topo, grp_root,
 				 true /* init_hdr */, root_excluded);
@@ -455,7 +1034,7 @@ out:
 	if (rc < 0)
 		crt_rpc_priv_free(rpc_priv);
 	if (root_excluded)
-		d_rank_list_free(tobe_excluded_ranks);
+		d_rank_list_free(tobe_filter_ranks);
 	return rc;
 }
 
@@ -494,12 +1073,13 @@ corpc_add_child_rpc(struct crt_rpc_priv *parent_rpc_priv,
 	child_co_hdr->coh_int_grpid = parent_co_hdr->coh_int_grpid;
 	/* child's coh_bulk_hdl is different with parent_co_hdr */
 	child_co_hdr->coh_bulk_hdl = parent_rpc_priv->crp_pub.cr_co_bulk_hdl;
-	child_co_hdr->coh_excluded_ranks = parent_co_hdr->coh_excluded_ranks;
+	child_co_hdr->coh_filter_ranks = parent_co_hdr->coh_filter_ranks;
 	child_co_hdr->coh_inline_ranks = parent_co_hdr->coh_inline_ranks;
 	child_co_hdr->coh_grp_ver = parent_co_hdr->coh_grp_ver;
 	child_co_hdr->coh_tree_topo = parent_co_hdr->coh_tree_topo;
 	child_co_hdr->coh_root = parent_co_hdr->coh_root;
-	child_co_hdr->coh_padding = parent_co_hdr->coh_padding;
+	child_co_hdr->coh_seg = parent_co_hdr->coh_seg;
+	child_co_hdr->coh_host_map = parent_co_hdr->coh_host_map;
 
 	co_info = parent_rpc_priv->crp_corpc_info;
 
@@ -542,6 +1122,7 @@ static inline void
 crt_corpc_complete(struct crt_rpc_priv *rpc_priv)
 {
 	struct crt_corpc_info	*co_info;
+	struct crt_corpc_hdr	*co_hdr = &rpc_priv->crp_coreq_hdr;
 	d_rank_t		 myrank;
 	bool			 am_root;
 	int			 rc;
@@ -561,15 +1142,17 @@ crt_corpc_complete(struct crt_rpc_priv *rpc_priv)
 		if (rc != 0)
 			D_ERROR("crt_hg_reply_send failed, rc: %d,opc: %#x.\n",
 				rc, rpc_priv->crp_pub.cr_opc);
+		/* the children are done with the local chained bulk */
+		if (rpc_priv->crp_co_pipe != NULL)
+			crt_corpc_pipe_stop(rpc_priv->crp_co_pipe);
 		/*
 		 * on root node, don't need to free chained bulk handle as it is
 		 * created and passed in by user.
 		 */
-		rc = crt_corpc_free_chained_bulk(
-			rpc_priv->crp_coreq_hdr.coh_bulk_hdl);
-		if (rc != 0)
-			D_ERROR("crt_corpc_free_chainded_bulk failed, rc: %d, "
-				"opc: %#x.\n", rc, rpc_priv->crp_pub.cr_opc);
+		if (rpc_priv->crp_co_buf != NULL)
+			rpc_priv->crp_pub.cr_co_bulk_hdl = CRT_BULK_NULL;
+		crt_corpc_local_bulk_release(rpc_priv, co_hdr->coh_bulk_hdl,
+					     NULL);
 		/*
 		 * reset it to NULL to avoid crt_proc_corpc_hdr->
 		 * crt_proc_crt_bulk_t free the bulk handle again.
@@ -619,6 +1202,74 @@ crt_corpc_fail_child_rpc(struct crt_rpc_priv *parent_rpc_priv,
 		crt_corpc_complete(parent_rpc_priv);
 }
 
+/*
+ * Reduce the replied child RPCs of the parent RPC with the built-in reduction
+ * of co_ops. Called with the parent's crp_lock held and co_local_done set. The
+ * lock is dropped while reducing, replies arriving meanwhile are only queued
+ * and picked up by the next round so that one thread reduces at a time.
+ */
+static void
+crt_corpc_reduce_locked(struct crt_rpc_priv *parent_rpc_priv,
+			struct crt_corpc_ops *co_ops)
+{
+	struct crt_corpc_info	*co_info = parent_rpc_priv->crp_corpc_info;
+	struct crt_rpc_priv	*tmp_rpc_priv, *next;
+	d_list_t		 reduce_list;
+	crt_rpc_t		*result = &parent_rpc_priv->crp_pub;
+	d_iov_t			*iov;
+	bool			 copy_first;
+	int			 reduce_rc = 0;
+	int			 rc;
+
+	if (co_info->co_reducing)
+		return;
+
+	co_info->co_reducing = 1;
+	D_INIT_LIST_HEAD(&reduce_list);
+	while (!d_list_empty(&co_info->co_replied_rpcs)) {
+		d_list_splice_init(&co_info->co_replied_rpcs, &reduce_list);
+		/* when root excluded, the first reply is the initial result */
+		copy_first = co_info->co_root_excluded && !co_info->co_reduced;
+		co_info->co_reduced = 1;
+		D_SPIN_UNLOCK(&parent_rpc_priv->crp_lock);
+
+		d_list_for_each_entry(tmp_rpc_priv, &reduce_list,
+				      crp_parent_link) {
+			if (copy_first && result->cr_output_size > 0) {
+				memcpy(result->cr_output,
+				       tmp_rpc_priv->crp_pub.cr_output,
+				       result->cr_output_size);
+				iov = (d_iov_t *)((char *)result->cr_output +
+						  co_ops->co_reduce.cr_offset);
+				d_iov_set(iov, NULL, 0);
+			}
+			copy_first = false;
+
+			rc = crt_reduce_reply(parent_rpc_priv,
+					      &tmp_rpc_priv->crp_pub,
+					      &co_ops->co_reduce);
+			if (rc != 0) {
+				D_ERROR("crt_reduce_reply failed, rc: %d, "
+					"opc: %#x.\n", rc, result->cr_opc);
+				reduce_rc = rc;
+			}
+		}
+
+		D_SPIN_LOCK(&parent_rpc_priv->crp_lock);
+		d_list_for_each_entry_safe(tmp_rpc_priv, next, &reduce_list,
+					   crp_parent_link) {
+			co_info->co_child_ack_num++;
+			corpc_del_child_rpc_locked(parent_rpc_priv,
+						   tmp_rpc_priv);
+		}
+		if (reduce_rc != 0) {
+			crt_corpc_fail_parent_rpc(parent_rpc_priv, reduce_rc);
+			reduce_rc = 0;
+		}
+	}
+	co_info->co_reducing = 0;
+}
+
 void
 crt_corpc_reply_hdlr(const struct crt_cb_info *cb_info)
 {
@@ -680,6 +1331,19 @@ crt_corpc_reply_hdlr(const struct crt_cb_info *cb_info)
 		goto aggregate_done;
 	}
 
+	if (co_ops->co_flags & CRT_CORPC_FLAG_REDUCE) {
+		if (parent_rpc_priv == child_rpc_priv) {
+			co_info->co_local_done = 1;
+			co_info->co_child_ack_num++;
+		} else {
+			d_list_move_tail(&child_rpc_priv->crp_parent_link,
+					 &co_info->co_replied_rpcs);
+		}
+		if (co_info->co_local_done == 1)
+			crt_corpc_reduce_locked(parent_rpc_priv, co_ops);
+		goto aggregate_done;
+	}
+
 	if (parent_rpc_priv == child_rpc_priv) {
 		struct crt_rpc_priv	*tmp_rpc_priv, *next;
 
@@ -764,6 +1428,89 @@ out:
 	return;
 }
 
+/*
+ * Resolve CRT_TREE_AUTO on the root of the corpc. The children copy the chosen
+ * tree from the corpc header, so only the root ever sees CRT_TREE_AUTO.
+ */
+static int
+crt_corpc_tree_auto(struct crt_rpc_priv *rpc_priv)
+{
+	struct crt_corpc_info	*co_info = rpc_priv->crp_corpc_info;
+	size_t			 bulk_len = 0;
+	uint32_t		 filter_nr, rank_nr;
+	int			 tree_topo;
+	int			 rc;
+
+	if (rpc_priv->crp_pub.cr_co_bulk_hdl != CRT_BULK_NULL) {
+		rc = crt_bulk_get_len(rpc_priv->crp_pub.cr_co_bulk_hdl,
+				      &bulk_len);
+		if (rc != 0) {
+			D_ERROR("crt_bulk_get_len failed, rc: %d, opc: %#x.\n",
+				rc, rpc_priv->crp_pub.cr_opc);
+			return rc;
+		}
+	}
+
+	filter_nr = co_info->co_filter_ranks == NULL ? 0 :
+		    co_info->co_filter_ranks->rl_nr;
+	if (co_info->co_filter_incl)
+		rank_nr = filter_nr;
+	else if (co_info->co_grp_priv->gp_size > filter_nr)
+		rank_nr = co_info->co_grp_priv->gp_size - filter_nr;
+	else
+		rank_nr = 1;
+	tree_topo = crt_tree_auto_select(co_info->co_grp_priv, rank_nr,
+				rpc_priv->crp_pub.cr_input_size + bulk_len);
+	co_info->co_tree_topo = tree_topo;
+	rpc_priv->crp_coreq_hdr.coh_tree_topo = tree_topo;
+
+	return 0;
+}
+
+/*
+ * The root sends the host map its HIER tree is built on, or a knomial tree
+ * without one. Other ranks refuse a HIER tree built on another host map
+ * rather than compute a different tree than their parent.
+ */
+static int
+crt_corpc_tree_hier(struct crt_rpc_priv *rpc_priv, bool is_root)
+{
+	struct crt_corpc_info	*co_info = rpc_priv->crp_corpc_info;
+	struct crt_corpc_hdr	*co_hdr = &rpc_priv->crp_coreq_hdr;
+
+	if (!is_root)
+		return crt_tree_hier_check(co_info->co_tree_topo,
+					   co_hdr->coh_host_map);
+
+	co_info->co_tree_topo = crt_tree_hier_resolve(co_info->co_tree_topo,
+						      &co_hdr->coh_host_map);
+	co_hdr->coh_tree_topo = co_info->co_tree_topo;
+
+	return 0;
+}
+
+/*
+ * On the root, pipeline a chained bulk larger than one segment. The root holds
+ * the whole bulk so its children need not wait for any segment.
+ */
+static void
+crt_corpc_seg_init(struct crt_rpc_priv *rpc_priv)
+{
+	uint32_t	shift = crt_gdata.cg_corpc_seg_shift;
+	size_t		bulk_len;
+	int		rc;
+
+	rpc_priv->crp_coreq_hdr.coh_seg = 0;
+	if (shift == 0 || rpc_priv->crp_pub.cr_co_bulk_hdl == CRT_BULK_NULL)
+		return;
+
+	rc = crt_bulk_get_len(rpc_priv->crp_pub.cr_co_bulk_hdl, &bulk_len);
+	if (rc != 0 || bulk_len <= ((size_t)1 << shift))
+		return;
+
+	rpc_priv->crp_coreq_hdr.coh_seg = shift | CRT_CORPC_SEG_COMPLETE;
+}
+
 int
 crt_corpc_req_hdlr(crt_rpc_t *req)
 {
@@ -814,9 +1561,26 @@ crt_corpc_req_hdlr(crt_rpc_t *req)
 		}
 	}
 
+	if (crt_tree_type(co_info->co_tree_topo) == CRT_TREE_AUTO) {
+		rc = crt_corpc_tree_auto(rpc_priv);
+		if (rc != 0) {
+			crt_corpc_fail_parent_rpc(rpc_priv, rc);
+			D_GOTO(forward_done, rc);
+		}
+	}
+
+	rc = crt_corpc_tree_hier(rpc_priv, grp_rank == co_info->co_root);
+	if (rc != 0) {
+		crt_corpc_fail_parent_rpc(rpc_priv, rc);
+		D_GOTO(forward_done, rc);
+	}
+
+	if (grp_rank == co_info->co_root)
+		crt_corpc_seg_init(rpc_priv);
 
 	rc = crt_tree_get_children(co_info->co_grp_priv, co_info->co_grp_ver,
-				   co_info->co_excluded_ranks,
+				   co_info->co_filter_ranks,
+				   co_info->co_filter_incl,
 				   co_info->co_tree_topo, co_info->co_root,
 				   co_info->co_grp_priv->gp_self,
 				   &children_rank_list, &ver_match);
@@ -908,6 +1672,9 @@ forward_done:
 		cb_info.cci_arg = rpc_priv;
 
 		crt_corpc_reply_hdlr(&cb_info);
+	} else if (rpc_priv->crp_co_pipe != NULL) {
+		/* run by the pipe once the whole chained bulk is pulled */
+		rc = 0;
 	} else {
 		rc = crt_rpc_common_hdlr(rpc_priv);
 		if (rc != 0)
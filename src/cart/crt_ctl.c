@@ -42,8 +42,6 @@
 
 #include "crt_internal.h"
 
-#define MAX_HOSTNAME_SIZE 1024
-
 static int verify_ctl_in_args(struct crt_ctl_in *in_args)
 {
 	struct crt_grp_priv	*grp_priv;
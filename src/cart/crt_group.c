@@ -42,106 +42,179 @@
 
 #include "crt_internal.h"
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 /* global CRT group list */
 D_LIST_HEAD(crt_grp_list);
 /* protect global group list */
 pthread_rwlock_t crt_grp_list_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
-struct crt_lookup_item *
-crt_li_link2ptr(d_list_t *rlink)
+static inline uint32_t
+crt_li_map_nr(struct crt_li_map *map)
 {
-	D_ASSERT(rlink != NULL);
-	return container_of(rlink, struct crt_lookup_item, li_link);
+	return map->lm_inline_nr +
+	       (map->lm_overflow == NULL ? 0 : map->lm_overflow->lo_nr);
 }
 
-static int
-li_op_key_get(struct d_hash_table *hhtab, d_list_t *rlink, void **key_pp)
+/* get the idx-th entry, inline entries come first. Caller holds li_mutex */
+static inline struct crt_li_ent *
+crt_li_map_ent(struct crt_li_map *map, uint32_t idx)
 {
-	struct crt_lookup_item *li = crt_li_link2ptr(rlink);
+	D_ASSERT(idx < crt_li_map_nr(map));
 
-	*key_pp = (void *)&li->li_rank;
-	return sizeof(li->li_rank);
+	if (idx < map->lm_inline_nr)
+		return &map->lm_inline[idx];
+	return &map->lm_overflow->lo_ents[idx - map->lm_inline_nr];
 }
 
-static uint32_t
-li_op_key_hash(struct d_hash_table *hhtab, const void *key, unsigned int ksize)
+/* find the entry of key, it may hold a NULL value. Caller holds li_mutex */
+static struct crt_li_ent *
+crt_li_map_find(struct crt_li_map *map, uint32_t key)
 {
-	D_ASSERT(ksize == sizeof(d_rank_t));
+	struct crt_li_ent	*ent;
+	uint32_t		 i;
+
+	for (i = 0; i < crt_li_map_nr(map); i++) {
+		ent = crt_li_map_ent(map, i);
+		if (ent->le_key == key)
+			return ent;
+	}
 
-	return (unsigned int)(*(const uint32_t *)key %
-		(1U << CRT_LOOKUP_CACHE_BITS));
+	return NULL;
 }
 
-static bool
-li_op_key_cmp(struct d_hash_table *hhtab, d_list_t *rlink,
-	      const void *key, unsigned int ksize)
+/*
+ * Get the value of key without li_mutex, NULL if key is not present. Entries
+ * are published after being filled in and never move within an array, so a
+ * reader sees either a complete entry or none.
+ */
+static void *
+crt_li_map_get(struct crt_li_map *map, uint32_t key)
 {
-	struct crt_lookup_item *li = crt_li_link2ptr(rlink);
+	struct crt_li_ovf	*ovf;
+	uint32_t		 nr;
+	uint32_t		 i;
+
+	nr = __atomic_load_n(&map->lm_inline_nr, __ATOMIC_ACQUIRE);
+	for (i = 0; i < nr; i++) {
+		if (map->lm_inline[i].le_key == key)
+			return __atomic_load_n(&map->lm_inline[i].le_val,
+					       __ATOMIC_ACQUIRE);
+	}
 
-	D_ASSERT(ksize == sizeof(d_rank_t));
+	ovf = __atomic_load_n(&map->lm_overflow, __ATOMIC_ACQUIRE);
+	if (ovf == NULL)
+		return NULL;
+	nr = __atomic_load_n(&ovf->lo_nr, __ATOMIC_ACQUIRE);
+	for (i = 0; i < nr; i++) {
+		if (ovf->lo_ents[i].le_key == key)
+			return __atomic_load_n(&ovf->lo_ents[i].le_val,
+					       __ATOMIC_ACQUIRE);
+	}
 
-	return li->li_rank == *(d_rank_t *)key;
+	return NULL;
 }
 
-static void
-li_op_rec_addref(struct d_hash_table *hhtab, d_list_t *rlink)
+/*
+ * Set the value of key, appending a new entry if key is not present. Setting
+ * a NULL value removes the key but keeps its entry for reuse. Caller holds
+ * li_mutex.
+ */
+static int
+crt_li_map_set(struct crt_li_map *map, uint32_t key, void *val)
 {
-	struct crt_lookup_item *li = crt_li_link2ptr(rlink);
+	struct crt_li_ent	*ent;
+	struct crt_li_ovf	*ovf;
+	struct crt_li_ovf	*new_ovf;
+	uint32_t		 new_cap;
+
+	ent = crt_li_map_find(map, key);
+	if (ent != NULL) {
+		__atomic_store_n(&ent->le_val, val, __ATOMIC_RELEASE);
+		return 0;
+	}
 
-	D_ASSERT(li->li_initialized);
-	D_MUTEX_LOCK(&li->li_mutex);
-	li->li_ref++;
-	D_MUTEX_UNLOCK(&li->li_mutex);
-}
+	if (map->lm_inline_nr < CRT_LI_INLINE_NR) {
+		ent = &map->lm_inline[map->lm_inline_nr];
+		ent->le_key = key;
+		ent->le_val = val;
+		__atomic_store_n(&map->lm_inline_nr, map->lm_inline_nr + 1,
+				 __ATOMIC_RELEASE);
+		return 0;
+	}
 
-static bool
-li_op_rec_decref(struct d_hash_table *hhtab, d_list_t *rlink)
-{
-	uint32_t			 ref;
-	struct crt_lookup_item		*li = crt_li_link2ptr(rlink);
+	ovf = map->lm_overflow;
+	if (ovf == NULL || ovf->lo_nr == ovf->lo_cap) {
+		new_cap = ovf == NULL ? CRT_LI_INLINE_NR * 2 : ovf->lo_cap * 2;
+		D_ALLOC(new_ovf, sizeof(*new_ovf) +
+				 new_cap * sizeof(new_ovf->lo_ents[0]));
+		if (new_ovf == NULL)
+			return -DER_NOMEM;
+		new_ovf->lo_cap = new_cap;
+		if (ovf != NULL) {
+			memcpy(new_ovf->lo_ents, ovf->lo_ents,
+			       ovf->lo_nr * sizeof(ovf->lo_ents[0]));
+			new_ovf->lo_nr = ovf->lo_nr;
+		}
+		/* readers may still walk the old array, free it with the map */
+		new_ovf->lo_prev = ovf;
+		__atomic_store_n(&map->lm_overflow, new_ovf, __ATOMIC_RELEASE);
+		ovf = new_ovf;
+	}
 
-	D_ASSERT(li->li_initialized);
-	D_MUTEX_LOCK(&li->li_mutex);
-	li->li_ref--;
-	ref = li->li_ref;
-	D_MUTEX_UNLOCK(&li->li_mutex);
+	ent = &ovf->lo_ents[ovf->lo_nr];
+	ent->le_key = key;
+	ent->le_val = val;
+	__atomic_store_n(&ovf->lo_nr, ovf->lo_nr + 1, __ATOMIC_RELEASE);
 
-	return ref == 0;
+	return 0;
 }
 
 static void
-li_op_rec_free(struct d_hash_table *hhtab, d_list_t *rlink)
+crt_li_map_fini(struct crt_li_map *map)
 {
-	crt_li_destroy(crt_li_link2ptr(rlink));
-}
+	struct crt_li_ovf	*ovf;
 
-static d_hash_table_ops_t lookup_table_ops = {
-	.hop_key_get		= li_op_key_get,
-	.hop_key_hash		= li_op_key_hash,
-	.hop_key_cmp		= li_op_key_cmp,
-	.hop_rec_addref		= li_op_rec_addref,
-	.hop_rec_decref		= li_op_rec_decref,
-	.hop_rec_free		= li_op_rec_free,
-};
+	while (map->lm_overflow != NULL) {
+		ovf = map->lm_overflow;
+		map->lm_overflow = ovf->lo_prev;
+		D_FREE(ovf);
+	}
+	map->lm_inline_nr = 0;
+}
 
 void
 crt_li_destroy(struct crt_lookup_item *li)
 {
-	int	i;
+	struct crt_li_pending	*lp;
+	struct crt_li_pending	*lp_next;
+	struct crt_li_ent	*ent;
+	uint32_t		 i;
 
 	D_ASSERT(li != NULL);
-	D_ASSERT(li->li_ref == 0);
-	D_ASSERT(li->li_initialized == 1);
 
-	D_FREE(li->li_base_phy_addr);
+	for (i = 0; i < crt_li_map_nr(&li->li_tag_addr); i++) {
+		ent = crt_li_map_ent(&li->li_tag_addr, i);
+		if (ent->le_val != NULL)
+			D_ERROR("ctx_idx %d, tag %d, li_tag_addr not freed.\n",
+				CRT_LI_ADDR_KEY_CTX(ent->le_key),
+				ent->le_key & 0xFFFF);
+	}
+	crt_li_map_fini(&li->li_tag_addr);
 
-	for (i = 0; i < CRT_SRV_CONTEXT_NUM; i++) {
-		if (li->li_tag_addr[i] != NULL)
-			D_ERROR("tag %d, li_tag_addr not freed.\n", i);
+	for (i = 0; i < crt_li_map_nr(&li->li_uri); i++) {
+		ent = crt_li_map_ent(&li->li_uri, i);
+		D_FREE(ent->le_val);
+	}
+	crt_li_map_fini(&li->li_uri);
 
-		if (li->li_uri[i])
-			D_FREE(li->li_uri[i]);
+	d_list_for_each_entry_safe(lp, lp_next, &li->li_pending, lp_link) {
+		D_ERROR("rank %d, ctx_idx %d, tag %d, address still being "
+			"resolved.\n", li->li_rank,
+			CRT_LI_ADDR_KEY_CTX(lp->lp_key), lp->lp_key & 0xFFFF);
+		d_list_del(&lp->lp_link);
+		D_FREE_PTR(lp);
 	}
 
 	D_MUTEX_DESTROY(&li->li_mutex);
@@ -149,74 +222,134 @@ crt_li_destroy(struct crt_lookup_item *li)
 	D_FREE_PTR(li);
 }
 
-static int
-crt_grp_lc_create(struct crt_grp_priv *grp_priv)
+int
+crt_grp_lc_destroy(struct crt_grp_priv *grp_priv)
 {
-	struct d_hash_table	**htables;
-	int			  i, rc = 0;
+	struct crt_lookup_item	*li;
+	struct crt_lookup_item	*next;
 
 	D_ASSERT(grp_priv != NULL);
-	if (grp_priv->gp_primary == 0) {
-		D_ERROR("need not create lookup cache for sub-group.\n");
-		D_GOTO(out, rc = -DER_NO_PERM);
-	}
 
-	D_ALLOC_ARRAY(htables, CRT_SRV_CONTEXT_NUM);
-	if (htables == NULL)
-		D_GOTO(out, rc = -DER_NOMEM);
+	if (grp_priv->gp_lookup_cache == NULL)
+		return 0;
 
-	for (i = 0; i < CRT_SRV_CONTEXT_NUM; i++) {
-		rc = d_hash_table_create(D_HASH_FT_NOLOCK,
-					 CRT_LOOKUP_CACHE_BITS,
-					 NULL, &lookup_table_ops, &htables[i]);
-		if (rc != 0) {
-			D_ERROR("d_hash_table_create failed, rc: %d.\n", rc);
-			D_GOTO(out, rc);
-		}
-		D_ASSERT(htables[i] != NULL);
+	d_list_for_each_entry_safe(li, next, &grp_priv->gp_lc_items, li_link) {
+		d_list_del(&li->li_link);
+		grp_priv->gp_lookup_cache[li->li_rank] = NULL;
+		crt_li_destroy(li);
 	}
-	grp_priv->gp_lookup_cache = htables;
+	D_FREE(grp_priv->gp_lookup_cache);
+	memset(grp_priv->gp_lc_ctx_mask, 0, sizeof(grp_priv->gp_lc_ctx_mask));
 
-out:
-	if (rc != 0)
-		D_ERROR("crt_grp_lc_create failed, rc: %d.\n", rc);
-	return rc;
+	return 0;
 }
 
-static int
-crt_grp_lc_destroy(struct crt_grp_priv *grp_priv)
+/*
+ * Get the lookup item of rank. If it does not exist yet, it is allocated when
+ * create is true, otherwise NULL is returned. The rank-indexed array itself is
+ * allocated with the first item. Items stay in the cache until it is
+ * destroyed.
+ *
+ * The array and the items are published with release stores under gp_rwlock
+ * and never move afterwards, so finding an existing item takes no lock.
+ */
+static struct crt_lookup_item *
+crt_grp_lc_item_get(struct crt_grp_priv *grp_priv, d_rank_t rank, bool create)
 {
-	int	rc = 0, i;
+	struct crt_lookup_item	**cache;
+	struct crt_lookup_item	*li = NULL;
+	struct crt_lookup_item	*li_new;
+	int			 rc;
 
-	D_ASSERT(grp_priv != NULL);
+	D_ASSERT(grp_priv->gp_primary == 1);
+	D_ASSERT(rank < grp_priv->gp_size);
 
-	if (grp_priv->gp_lookup_cache == NULL)
-		return 0;
+	cache = __atomic_load_n(&grp_priv->gp_lookup_cache, __ATOMIC_ACQUIRE);
+	if (cache != NULL)
+		li = __atomic_load_n(&cache[rank], __ATOMIC_ACQUIRE);
+	if (li != NULL || !create)
+		return li;
 
-	for (i = 0; i < CRT_SRV_CONTEXT_NUM; i++) {
-		rc = d_hash_table_destroy(grp_priv->gp_lookup_cache[i],
-					  true /* force */);
-		if (rc != 0) {
-			D_ERROR("d_hash_table_destroy_inplace failed, "
-				"rc: %d.\n", rc);
-			D_GOTO(out, rc);
+	D_ALLOC_PTR(li_new);
+	if (li_new == NULL)
+		return NULL;
+	rc = D_MUTEX_INIT(&li_new->li_mutex, NULL);
+	if (rc != 0) {
+		D_FREE_PTR(li_new);
+		return NULL;
+	}
+	D_INIT_LIST_HEAD(&li_new->li_link);
+	D_INIT_LIST_HEAD(&li_new->li_pending);
+	li_new->li_grp_priv = grp_priv;
+	li_new->li_rank = rank;
+
+	D_RWLOCK_WRLOCK(&grp_priv->gp_rwlock);
+	cache = grp_priv->gp_lookup_cache;
+	if (cache == NULL) {
+		D_ALLOC_ARRAY(cache, grp_priv->gp_size);
+		if (cache == NULL) {
+			D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
+			crt_li_destroy(li_new);
+			return NULL;
 		}
+		__atomic_store_n(&grp_priv->gp_lookup_cache, cache,
+				 __ATOMIC_RELEASE);
+		D_DEBUG(DB_TRACE, "created lookup cache, group %s, size %d.\n",
+			grp_priv->gp_pub.cg_grpid, grp_priv->gp_size);
+	}
+	li = cache[rank];
+	if (li == NULL) {
+		d_list_add_tail(&li_new->li_link, &grp_priv->gp_lc_items);
+		__atomic_store_n(&cache[rank], li_new, __ATOMIC_RELEASE);
+		li = li_new;
+		li_new = NULL;
 	}
-	D_FREE(grp_priv->gp_lookup_cache);
+	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
 
-out:
-	return rc;
+	if (li_new != NULL) {
+		D_DEBUG(DB_TRACE, "entry already exists, grp_priv %p, "
+			"rank: %d.\n", grp_priv, rank);
+		crt_li_destroy(li_new);
+	}
+
+	return li;
+}
+
+static inline bool
+crt_grp_lc_ctx_used(struct crt_grp_priv *grp_priv, int ctx_idx)
+{
+	return (grp_priv->gp_lc_ctx_mask[ctx_idx / 64] &
+		(1ULL << (ctx_idx % 64))) != 0;
+}
+
+/* record that ctx_idx has HG addresses cached in the group */
+static void
+crt_grp_lc_ctx_use(struct crt_grp_priv *grp_priv, int ctx_idx)
+{
+	bool	used;
+
+	D_RWLOCK_RDLOCK(&grp_priv->gp_rwlock);
+	used = crt_grp_lc_ctx_used(grp_priv, ctx_idx);
+	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
+	if (used)
+		return;
+
+	D_RWLOCK_WRLOCK(&grp_priv->gp_rwlock);
+	grp_priv->gp_lc_ctx_mask[ctx_idx / 64] |= 1ULL << (ctx_idx % 64);
+	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
 }
 
 /*
- * Fill in the base URI of rank in the lookup cache of the crt_ctx.
+ * Fill in the URI of (rank, tag) in the lookup cache. URIs do not depend on
+ * the local context so they are shared by all contexts, ctx_idx is only used
+ * for logging.
  */
 int
 crt_grp_lc_uri_insert(struct crt_grp_priv *grp_priv, int ctx_idx,
 		      d_rank_t rank, uint32_t tag, const char *uri)
 {
-	d_list_t		*rlink;
 	struct crt_lookup_item	*li;
+	char			*uri_dup;
 	int			 rc = 0;
 
 	D_ASSERT(ctx_idx >= 0 && ctx_idx < CRT_SRV_CONTEXT_NUM);
@@ -225,84 +358,39 @@ crt_grp_lc_uri_insert(struct crt_grp_priv *grp_priv, int ctx_idx,
 			tag, CRT_SRV_CONTEXT_NUM - 1);
 		return -DER_INVAL;
 	}
-	D_RWLOCK_RDLOCK(&grp_priv->gp_rwlock);
-	rlink = d_hash_rec_find(grp_priv->gp_lookup_cache[ctx_idx],
-				(void *)&rank, sizeof(rank));
-	if (rlink == NULL) {
-		D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
-		/* target rank not in cache */
-		D_ALLOC_PTR(li);
-		if (li == NULL)
-			D_GOTO(out, rc = -DER_NOMEM);
-
-		rc = D_MUTEX_INIT(&li->li_mutex, NULL);
-		if (rc != 0)
-			D_GOTO(out, rc);
-
-		D_INIT_LIST_HEAD(&li->li_link);
-		li->li_grp_priv = grp_priv;
-		li->li_rank = rank;
-		D_STRNDUP(li->li_uri[tag], uri, CRT_ADDR_STR_MAX_LEN);
-		if (li->li_uri[tag] == NULL)
-			D_GOTO(out, rc = -DER_NOMEM);
-		if (tag == 0) {
-			D_STRNDUP(li->li_base_phy_addr, uri,
-				  CRT_ADDR_STR_MAX_LEN);
-			if (li->li_base_phy_addr == NULL) {
-				D_FREE(li->li_uri[tag]);
-				D_GOTO(out, rc = -DER_NOMEM);
-			}
-		}
-		li->li_initialized = 1;
-		li->li_evicted = 0;
-
-		D_RWLOCK_WRLOCK(&grp_priv->gp_rwlock);
-		rc = d_hash_rec_insert(grp_priv->gp_lookup_cache[ctx_idx],
-				       &rank, sizeof(rank), &li->li_link,
-				       true /* exclusive */);
-		if (rc != 0) {
-			D_DEBUG(DB_TRACE, "entry already exists in lookup "
-				"table, grp_priv %p ctx_idx %d, rank: %d.\n",
-				grp_priv, ctx_idx, rank);
-			crt_li_destroy(li);
-			rc = 0;
-		} else {
-			D_DEBUG(DB_TRACE, "Filling in URI in lookup table. "
-				" grp_priv %p ctx_idx %d, rank: %d, rlink %p\n",
-				grp_priv, ctx_idx, rank, &li->li_link);
-		}
-		D_GOTO(unlock, rc);
+	if (rank >= grp_priv->gp_size) {
+		D_ERROR("rank %d out of range [0, %d).\n",
+			rank, grp_priv->gp_size);
+		return -DER_INVAL;
 	}
-	li = crt_li_link2ptr(rlink);
+
+	li = crt_grp_lc_item_get(grp_priv, rank, true /* create */);
+	if (li == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
 	D_ASSERT(li->li_grp_priv == grp_priv);
 	D_ASSERT(li->li_rank == rank);
-	D_ASSERT(li->li_initialized != 0);
+
 	D_MUTEX_LOCK(&li->li_mutex);
-	if (li->li_uri[tag] == NULL) {
-		D_STRNDUP(li->li_uri[tag], uri, CRT_ADDR_STR_MAX_LEN);
-		if (li->li_uri[tag] == NULL)
-			rc = -DER_NOMEM;
-		if (tag == 0) {
-			D_STRNDUP(li->li_base_phy_addr, uri,
-				  CRT_ADDR_STR_MAX_LEN);
-			if (li->li_base_phy_addr == NULL) {
-				D_FREE(li->li_uri[tag]);
-				rc = -DER_NOMEM;
-			}
-		}
-		D_DEBUG(DB_TRACE, "Filling in URI in lookup table. "
-			" grp_priv %p ctx_idx %d, rank: %d, tag: %u rlink %p\n",
-			grp_priv, ctx_idx, rank, tag, &li->li_link);
-	} else {
-		D_WARN("URI already exists. grp_priv %p ctx_idx %d, "
-		       "tag: %u rank: %d, rlink %p\n", grp_priv, ctx_idx, rank,
-		       tag, &li->li_link);
+	if (crt_li_map_get(&li->li_uri, tag) != NULL) {
+		D_DEBUG(DB_TRACE, "URI already exists. grp_priv %p ctx_idx %d, "
+			"rank: %d, tag: %u\n", grp_priv, ctx_idx, rank, tag);
+		D_GOTO(unlock, rc);
 	}
-	D_MUTEX_UNLOCK(&li->li_mutex);
-	d_hash_rec_decref(grp_priv->gp_lookup_cache[ctx_idx], rlink);
+
+	D_STRNDUP(uri_dup, uri, CRT_ADDR_STR_MAX_LEN);
+	if (uri_dup == NULL)
+		D_GOTO(unlock, rc = -DER_NOMEM);
+	rc = crt_li_map_set(&li->li_uri, tag, uri_dup);
+	if (rc != 0) {
+		D_FREE(uri_dup);
+		D_GOTO(unlock, rc);
+	}
+	D_DEBUG(DB_TRACE, "Filling in URI in lookup table. "
+		" grp_priv %p ctx_idx %d, rank: %d, tag: %u\n",
+		grp_priv, ctx_idx, rank, tag);
 
 unlock:
-	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
+	D_MUTEX_UNLOCK(&li->li_mutex);
 out:
 	return rc;
 }
@@ -315,54 +403,46 @@ int
 crt_grp_lc_uri_insert_all(crt_group_t *grp, d_rank_t rank, const char *uri)
 {
 	struct crt_grp_priv	*grp_priv;
-	int			 i;
 	int			 rc = 0;
 
 	grp_priv = crt_grp_pub2priv(grp);
 
-	for (i = 0; i < CRT_SRV_CONTEXT_NUM; i++) {
-		rc = crt_grp_lc_uri_insert(grp_priv, i, rank, 0, uri);
-		if (rc != 0) {
-			D_ERROR("crt_grp_lc_uri_insert(%p, %d, %d, %s) failed."
-				" rc: %d\n", grp_priv, i, rank, uri, rc);
-			return rc;
-		}
-	}
+	/* the URI cache is shared by all contexts */
+	rc = crt_grp_lc_uri_insert(grp_priv, 0, rank, 0, uri);
+	if (rc != 0)
+		D_ERROR("crt_grp_lc_uri_insert(%p, %d, %s) failed. rc: %d\n",
+			grp_priv, rank, uri, rc);
 
 	return rc;
 }
 
+/* free all HG addrs of li which were connected through ctx */
 static int
-crt_grp_lc_addr_invalid(d_list_t *rlink, void *arg)
+crt_grp_lc_addr_invalid(struct crt_lookup_item *li, struct crt_context *ctx)
 {
-	struct crt_lookup_item	*li;
-	struct crt_context	*ctx;
-	int			 i;
+	struct crt_li_ent	*ent;
+	uint32_t		 i;
 	int			 rc = 0;
 
-	D_ASSERT(rlink != NULL);
-	D_ASSERT(arg != NULL);
-	li = crt_li_link2ptr(rlink);
-	ctx = (struct crt_context *)arg;
+	D_ASSERT(li != NULL);
+	D_ASSERT(ctx != NULL);
 
 	D_MUTEX_LOCK(&li->li_mutex);
-	for (i = 0; i < CRT_SRV_CONTEXT_NUM; i++) {
-		if (li->li_uri[i])
-			D_FREE(li->li_uri[i]);
-
-		if (li->li_tag_addr[i] == NULL)
+	for (i = 0; i < crt_li_map_nr(&li->li_tag_addr); i++) {
+		ent = crt_li_map_ent(&li->li_tag_addr, i);
+		if (CRT_LI_ADDR_KEY_CTX(ent->le_key) != ctx->cc_idx ||
+		    ent->le_val == NULL)
 			continue;
-		rc = crt_hg_addr_free(&ctx->cc_hg_ctx, li->li_tag_addr[i]);
+		rc = crt_hg_addr_free(&ctx->cc_hg_ctx, ent->le_val);
 		if (rc != 0) {
 			D_ERROR("crt_hg_addr_free failed, ctx_idx %d, tag %d, "
-				"rc: %d.\n", ctx->cc_idx, i, rc);
+				"rc: %d.\n", ctx->cc_idx, ent->le_key & 0xFFFF,
+				rc);
 			D_GOTO(out, rc);
 		}
-		li->li_tag_addr[i] = NULL;
+		__atomic_store_n(&ent->le_val, NULL, __ATOMIC_RELEASE);
 	}
 
-	D_FREE(li->li_base_phy_addr);
-
 out:
 	D_MUTEX_UNLOCK(&li->li_mutex);
 	return rc;
@@ -375,21 +455,32 @@ out:
 static int
 crt_grp_lc_ctx_invalid(struct crt_grp_priv *grp_priv, struct crt_context *ctx)
 {
-	struct d_hash_table	*lc_cache;
-	int			 ctx_idx;
+	struct crt_lookup_item	*li;
 	int			 rc = 0;
 
 	D_ASSERT(grp_priv != NULL && grp_priv->gp_primary == 1);
 	D_ASSERT(ctx != NULL);
-	ctx_idx = ctx->cc_idx;
-	D_ASSERT(ctx_idx >= 0 && ctx_idx < CRT_SRV_CONTEXT_NUM);
+	D_ASSERT(ctx->cc_idx >= 0 && ctx->cc_idx < CRT_SRV_CONTEXT_NUM);
 
-	lc_cache = grp_priv->gp_lookup_cache[ctx_idx];
-	D_ASSERT(lc_cache != NULL);
-	rc = d_hash_table_traverse(lc_cache, crt_grp_lc_addr_invalid, ctx);
-	if (rc != 0)
-		D_ERROR("d_hash_table_traverse failed, ctx_idx %d, rc: %d.\n",
-			ctx_idx, rc);
+	/* only walk the items if this context ever cached an address */
+	D_RWLOCK_WRLOCK(&grp_priv->gp_rwlock);
+	if (!crt_grp_lc_ctx_used(grp_priv, ctx->cc_idx))
+		D_GOTO(out, rc);
+
+	d_list_for_each_entry(li, &grp_priv->gp_lc_items, li_link) {
+		rc = crt_grp_lc_addr_invalid(li, ctx);
+		if (rc != 0) {
+			D_ERROR("crt_grp_lc_addr_invalid failed, ctx_idx %d, "
+				"rank %d, rc: %d.\n", ctx->cc_idx,
+				li->li_rank, rc);
+			D_GOTO(out, rc);
+		}
+	}
+	grp_priv->gp_lc_ctx_mask[ctx->cc_idx / 64] &=
+		~(1ULL << (ctx->cc_idx % 64));
+
+out:
+	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
 
 	return rc;
 }
@@ -440,17 +531,18 @@ out:
 }
 
 /*
- * Fill in the hg address  of a tag in the lookup cache of crt_ctx. The host
- * rank where the tag resides in must exist in the cache before calling this
- * routine.
+ * Fill in the hg address of a tag in the lookup cache of crt_ctx. If another
+ * thread inserted an address first, *hg_addr is freed and replaced by the
+ * cached one. If the rank got evicted, *hg_addr is freed and -DER_EVICTED
+ * returned.
  */
 int
 crt_grp_lc_addr_insert(struct crt_grp_priv *grp_priv,
 		       struct crt_context *crt_ctx,
 		       d_rank_t rank, uint32_t tag, hg_addr_t *hg_addr)
 {
-	d_list_t		*rlink;
 	struct crt_lookup_item	*li;
+	void			*cached;
 	int			 ctx_idx;
 	int			 rc = 0;
 
@@ -460,46 +552,205 @@ crt_grp_lc_addr_insert(struct crt_grp_priv *grp_priv,
 		tag = 0;
 
 	ctx_idx = crt_ctx->cc_idx;
-	D_RWLOCK_RDLOCK(&grp_priv->gp_rwlock);
-	rlink = d_hash_rec_find(grp_priv->gp_lookup_cache[ctx_idx],
-				(void *)&rank, sizeof(rank));
-	D_ASSERT(rlink != NULL);
-	li = crt_li_link2ptr(rlink);
+	li = crt_grp_lc_item_get(grp_priv, rank, true /* create */);
+	if (li == NULL)
+		return -DER_NOMEM;
 	D_ASSERT(li->li_grp_priv == grp_priv);
 	D_ASSERT(li->li_rank == rank);
-	D_ASSERT(li->li_initialized != 0);
+
+	/* mark the context before li_mutex, gp_rwlock is taken first */
+	crt_grp_lc_ctx_use(grp_priv, ctx_idx);
 
 	D_MUTEX_LOCK(&li->li_mutex);
-	if (li->li_evicted == 1)
-		rc = -DER_EVICTED;
-	if (li->li_tag_addr[tag] == NULL) {
-		li->li_tag_addr[tag] = *hg_addr;
+	/* don't cache an address of an evicted rank, nobody would free it */
+	if (__atomic_load_n(&li->li_evicted, __ATOMIC_ACQUIRE)) {
+		D_DEBUG(DB_TRACE, "rank %d evicted, drop its address.\n",
+			rank);
+		rc = crt_hg_addr_free(&crt_ctx->cc_hg_ctx, *hg_addr);
+		if (rc != 0)
+			D_ERROR("crt_hg_addr_free failed, crt_idx %d, *hg_addr"
+				" 0x%p, rc %d\n", ctx_idx, *hg_addr, rc);
+		*hg_addr = NULL;
+		D_GOTO(out, rc = -DER_EVICTED);
+	}
+	cached = crt_li_map_get(&li->li_tag_addr,
+				CRT_LI_ADDR_KEY(ctx_idx, tag));
+	if (cached == NULL) {
+		rc = crt_li_map_set(&li->li_tag_addr,
+				    CRT_LI_ADDR_KEY(ctx_idx, tag), *hg_addr);
+		if (rc != 0)
+			D_ERROR("crt_li_map_set failed, rc %d\n", rc);
 	} else {
 		D_WARN("NA address already exits. "
-		       " grp_priv %p ctx_idx %d, rank: %d, tag %d, rlink %p\n",
-		       grp_priv, ctx_idx, rank, tag, &li->li_link);
+		       " grp_priv %p ctx_idx %d, rank: %d, tag %d\n",
+		       grp_priv, ctx_idx, rank, tag);
 		rc = crt_hg_addr_free(&crt_ctx->cc_hg_ctx, *hg_addr);
 		if (rc != 0) {
 			D_ERROR("crt_hg_addr_free failed, crt_idx %d, *hg_addr"
 				" 0x%p, rc %d\n", ctx_idx, *hg_addr, rc);
 			D_GOTO(out, rc);
 		}
-		*hg_addr = li->li_tag_addr[tag];
+		*hg_addr = cached;
 	}
 out:
 	D_MUTEX_UNLOCK(&li->li_mutex);
-	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
-	d_hash_rec_decref(grp_priv->gp_lookup_cache[ctx_idx], rlink);
 
 	return rc;
 }
 
+/* the lookup item of rank in grp_priv, subgroup ranks live in the primary */
+static struct crt_lookup_item *
+crt_grp_lc_item_find(struct crt_grp_priv *grp_priv, d_rank_t rank, bool create)
+{
+	if (grp_priv->gp_primary == 0) {
+		rank = grp_priv->gp_membs->rl_ranks[rank];
+		grp_priv = crt_grp_pub2priv(NULL);
+		D_ASSERT(grp_priv != NULL);
+	}
+
+	return crt_grp_lc_item_get(grp_priv, rank, create);
+}
+
+static struct crt_li_pending *
+crt_li_pending_find(struct crt_lookup_item *li, uint32_t key)
+{
+	struct crt_li_pending	*lp;
+
+	d_list_for_each_entry(lp, &li->li_pending, lp_link) {
+		if (lp->lp_key == key)
+			return lp;
+	}
+
+	return NULL;
+}
+
+/*
+ * Called by a request which missed the HG address of (rank, tag) on context
+ * ctx_idx. Returns 0 if the caller is to resolve it, *hg_addr is set instead if
+ * it got resolved in the meantime. Returns 1 if another request is already
+ * resolving it, waiter is then parked until crt_grp_lc_resolve_end().
+ */
+int
+crt_grp_lc_resolve_begin(struct crt_grp_priv *grp_priv, int ctx_idx,
+			 d_rank_t rank, uint32_t tag, d_list_t *waiter,
+			 hg_addr_t *hg_addr)
+{
+	struct crt_lookup_item	*li;
+	struct crt_li_pending	*lp;
+	uint32_t		 key;
+	int			 rc = 0;
+
+	D_ASSERT(ctx_idx >= 0 && ctx_idx < CRT_SRV_CONTEXT_NUM);
+	D_ASSERT(tag < CRT_SRV_CONTEXT_NUM);
+
+	if (crt_gdata.cg_share_na == true)
+		tag = 0;
+	key = CRT_LI_ADDR_KEY(ctx_idx, tag);
+
+	li = crt_grp_lc_item_find(grp_priv, rank, true /* create */);
+	if (li == NULL)
+		return -DER_NOMEM;
+
+	D_MUTEX_LOCK(&li->li_mutex);
+	*hg_addr = crt_li_map_get(&li->li_tag_addr, key);
+	if (*hg_addr != NULL)
+		D_GOTO(out, rc);
+
+	lp = crt_li_pending_find(li, key);
+	if (lp != NULL) {
+		d_list_add_tail(waiter, &lp->lp_waiters);
+		D_GOTO(out, rc = 1);
+	}
+
+	D_ALLOC_PTR(lp);
+	if (lp == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	lp->lp_li = li;
+	lp->lp_key = key;
+	D_INIT_LIST_HEAD(&lp->lp_waiters);
+	d_list_add_tail(&lp->lp_link, &li->li_pending);
+
+out:
+	D_MUTEX_UNLOCK(&li->li_mutex);
+	return rc;
+}
+
+/*
+ * Called by the request which resolved (rank, tag) when it succeeded or
+ * failed. Returns the waiters to release through crt_li_pending_pop(), requests
+ * missing the address from now on start a new resolution.
+ */
+struct crt_li_pending *
+crt_grp_lc_resolve_end(struct crt_grp_priv *grp_priv, int ctx_idx,
+		       d_rank_t rank, uint32_t tag)
+{
+	struct crt_lookup_item	*li;
+	struct crt_li_pending	*lp;
+
+	if (crt_gdata.cg_share_na == true)
+		tag = 0;
+
+	li = crt_grp_lc_item_find(grp_priv, rank, false /* create */);
+	if (li == NULL)
+		return NULL;
+
+	D_MUTEX_LOCK(&li->li_mutex);
+	lp = crt_li_pending_find(li, CRT_LI_ADDR_KEY(ctx_idx, tag));
+	if (lp != NULL)
+		d_list_del_init(&lp->lp_link);
+	D_MUTEX_UNLOCK(&li->li_mutex);
+
+	return lp;
+}
+
+/* pop the first waiter of lp, lp is freed and NULL returned once empty */
+d_list_t *
+crt_li_pending_pop(struct crt_li_pending *lp)
+{
+	struct crt_lookup_item	*li = lp->lp_li;
+	d_list_t		*waiter = NULL;
+
+	D_MUTEX_LOCK(&li->li_mutex);
+	if (!d_list_empty(&lp->lp_waiters)) {
+		waiter = lp->lp_waiters.next;
+		d_list_del_init(waiter);
+	}
+	D_MUTEX_UNLOCK(&li->li_mutex);
+
+	if (waiter == NULL)
+		D_FREE_PTR(lp);
+	return waiter;
+}
+
+/*
+ * Unpark waiter, e.g. on timeout. Returns false if it was already released by
+ * crt_li_pending_pop(), which then hands it back to its owner.
+ */
+bool
+crt_grp_lc_resolve_cancel(struct crt_grp_priv *grp_priv, d_rank_t rank,
+			  d_list_t *waiter)
+{
+	struct crt_lookup_item	*li;
+	bool			 parked;
+
+	li = crt_grp_lc_item_find(grp_priv, rank, false /* create */);
+	if (li == NULL)
+		return false;
+
+	D_MUTEX_LOCK(&li->li_mutex);
+	parked = !d_list_empty(waiter);
+	if (parked)
+		d_list_del_init(waiter);
+	D_MUTEX_UNLOCK(&li->li_mutex);
+
+	return parked;
+}
+
 /*
  * Lookup the URI and NA address of a (rank, tag) combination in the addr cache.
  * This function only looks into the address cache. If the requested (rank, tag)
- * pair doesn't exist in the address cache, *hg_addr will be NULL on return, and
- * an empty record for the requested rank with NULL values will be inserted to
- * the cache. For input parameters, base_addr and hg_addr can not be both NULL.
+ * pair doesn't exist in the address cache, *uri and *hg_addr are left
+ * untouched. For input parameters, base_addr and hg_addr can not be both NULL.
  * (hg_addr == NULL) means the caller only want to lookup the base_addr.
  * (base_addr == NULL) means the caller only want to lookup the hg_addr.
  */
@@ -509,8 +760,8 @@ crt_grp_lc_lookup(struct crt_grp_priv *grp_priv, int ctx_idx,
 		  crt_phy_addr_t *uri, hg_addr_t *hg_addr)
 {
 	struct crt_lookup_item	*li;
-	d_list_t		*rlink;
 	struct crt_grp_priv	*default_grp_priv;
+	void			*cached;
 	int			 rc = 0;
 
 	D_ASSERT(grp_priv != NULL);
@@ -531,72 +782,28 @@ crt_grp_lc_lookup(struct crt_grp_priv *grp_priv, int ctx_idx,
 		rank = grp_priv->gp_membs->rl_ranks[rank];
 	}
 
-	D_RWLOCK_RDLOCK(&default_grp_priv->gp_rwlock);
-	rlink = d_hash_rec_find(default_grp_priv->gp_lookup_cache[ctx_idx],
-				(void *)&rank, sizeof(rank));
-	if (rlink != NULL) {
-		li = crt_li_link2ptr(rlink);
-		D_ASSERT(li->li_grp_priv == default_grp_priv);
-		D_ASSERT(li->li_rank == rank);
-		D_ASSERT(li->li_initialized != 0);
-
-		D_MUTEX_LOCK(&li->li_mutex);
-		if (li->li_evicted == 1) {
-			D_MUTEX_UNLOCK(&li->li_mutex);
-			D_RWLOCK_UNLOCK(&default_grp_priv->gp_rwlock);
-			d_hash_rec_decref(
-				default_grp_priv->gp_lookup_cache[ctx_idx],
-				rlink);
-			D_ERROR("tag %d on rank %d already evicted.\n", tag,
-				rank);
-			D_GOTO(out, rc = -DER_OOG);
-		}
-		D_MUTEX_UNLOCK(&li->li_mutex);
-		if (uri != NULL)
-			*uri = li->li_uri[tag];
-		if (hg_addr == NULL)
-			D_ASSERT(uri != NULL);
-		else if (li->li_tag_addr[tag] != NULL)
-			*hg_addr = li->li_tag_addr[tag];
-		D_RWLOCK_UNLOCK(&default_grp_priv->gp_rwlock);
-		d_hash_rec_decref(
-			default_grp_priv->gp_lookup_cache[ctx_idx], rlink);
-		D_GOTO(out, rc);
-	}
-	D_RWLOCK_UNLOCK(&default_grp_priv->gp_rwlock);
-
-	/* target rank not in cache */
-	D_ALLOC_PTR(li);
+	/* lock-free, entries are only published once fully filled in */
+	li = crt_grp_lc_item_get(default_grp_priv, rank, false /* create */);
 	if (li == NULL)
-		D_GOTO(out, rc = -DER_NOMEM);
-	D_INIT_LIST_HEAD(&li->li_link);
-	li->li_grp_priv = default_grp_priv;
-	li->li_rank = rank;
-	li->li_base_phy_addr = NULL;
-	li->li_initialized = 1;
-	li->li_evicted = 0;
-
-	rc = D_MUTEX_INIT(&li->li_mutex, NULL);
-	if (rc != 0) {
-		crt_li_destroy(li);
 		D_GOTO(out, rc);
-	}
+	D_ASSERT(li->li_grp_priv == default_grp_priv);
+	D_ASSERT(li->li_rank == rank);
 
-	D_RWLOCK_WRLOCK(&default_grp_priv->gp_rwlock);
-	rc = d_hash_rec_insert(default_grp_priv->gp_lookup_cache[ctx_idx],
-			       &rank, sizeof(rank), &li->li_link,
-			       true /* exclusive */);
-	if (rc != 0) {
-		D_DEBUG(DB_TRACE, "entry already exists.\n");
-		crt_li_destroy(li);
-	} else {
-		D_DEBUG(DB_TRACE, "Inserted lookup table entry without base "
-			"URI. default_grp_priv %p ctx_idx %d, rank: %d, "
-			"tag: %u, rlink %p\n", default_grp_priv, ctx_idx, rank,
-			tag, &li->li_link);
+	if (__atomic_load_n(&li->li_evicted, __ATOMIC_ACQUIRE)) {
+		D_ERROR("tag %d on rank %d already evicted.\n", tag, rank);
+		D_GOTO(out, rc = -DER_OOG);
+	}
+	if (uri != NULL) {
+		cached = crt_li_map_get(&li->li_uri, tag);
+		if (cached != NULL)
+			*uri = cached;
+	}
+	if (hg_addr != NULL) {
+		cached = crt_li_map_get(&li->li_tag_addr,
+					CRT_LI_ADDR_KEY(ctx_idx, tag));
+		if (cached != NULL)
+			*hg_addr = cached;
 	}
-	/* the only possible failure is key conflict */
-	D_RWLOCK_UNLOCK(&default_grp_priv->gp_rwlock);
 
 out:
 	return rc;
@@ -675,6 +882,104 @@ crt_grp_del_locked(struct crt_grp_priv *grp_priv)
 	d_list_del_init(&grp_priv->gp_link);
 }
 
+int
+crt_grp_membs_idx_init(struct crt_grp_priv *grp_priv)
+{
+	d_rank_list_t	*membs = grp_priv->gp_membs;
+	uint64_t	 span;
+	uint32_t	 i;
+
+	D_ASSERT(grp_priv->gp_membs_idx == NULL);
+
+	/* primary rank translation is identity for primary groups */
+	if (grp_priv->gp_primary || membs == NULL || membs->rl_nr == 0)
+		return 0;
+
+	/* gp_membs is sorted and unique */
+	span = (uint64_t)membs->rl_ranks[membs->rl_nr - 1] -
+	       membs->rl_ranks[0] + 1;
+	if (span > (uint64_t)membs->rl_nr * CRT_GRP_MEMBS_IDX_DENSITY) {
+		D_DEBUG(DB_TRACE, "group %s, %u members span "DF_U64" ranks, "
+			"no dense index.\n", grp_priv->gp_pub.cg_grpid,
+			membs->rl_nr, span);
+		return 0;
+	}
+
+	D_ALLOC_ARRAY(grp_priv->gp_membs_idx, (uint32_t)span);
+	if (grp_priv->gp_membs_idx == NULL)
+		return -DER_NOMEM;
+	memset(grp_priv->gp_membs_idx, 0xff,
+	       span * sizeof(*grp_priv->gp_membs_idx));
+
+	grp_priv->gp_membs_base = membs->rl_ranks[0];
+	grp_priv->gp_membs_span = span;
+	for (i = 0; i < membs->rl_nr; i++)
+		grp_priv->gp_membs_idx[membs->rl_ranks[i] -
+				       grp_priv->gp_membs_base] = i;
+
+	return 0;
+}
+
+void
+crt_grp_membs_idx_fini(struct crt_grp_priv *grp_priv)
+{
+	D_FREE(grp_priv->gp_membs_idx);
+	grp_priv->gp_membs_base = 0;
+	grp_priv->gp_membs_span = 0;
+}
+
+/*
+ * Translate a primary rank to its rank in grp_priv, O(1) through the dense
+ * reverse index, or O(log n) by binary searching the sorted gp_membs.
+ * Returns -DER_OOG if pri_rank is not a member.
+ */
+int
+crt_grp_rank_p2s(struct crt_grp_priv *grp_priv, d_rank_t pri_rank,
+		 d_rank_t *grp_rank)
+{
+	d_rank_list_t	*membs = grp_priv->gp_membs;
+	uint32_t	 lo;
+	uint32_t	 hi;
+	uint32_t	 mid;
+	uint32_t	 idx;
+
+	if (grp_priv->gp_primary) {
+		*grp_rank = pri_rank;
+		return 0;
+	}
+
+	if (grp_priv->gp_membs_idx != NULL) {
+		if (pri_rank < grp_priv->gp_membs_base ||
+		    pri_rank - grp_priv->gp_membs_base >=
+		    grp_priv->gp_membs_span)
+			return -DER_OOG;
+		idx = grp_priv->gp_membs_idx[pri_rank -
+					     grp_priv->gp_membs_base];
+		if (idx == CRT_GRP_NO_IDX)
+			return -DER_OOG;
+		*grp_rank = idx;
+		return 0;
+	}
+
+	if (membs == NULL)
+		return -DER_OOG;
+
+	lo = 0;
+	hi = membs->rl_nr;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (membs->rl_ranks[mid] < pri_rank)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == membs->rl_nr || membs->rl_ranks[lo] != pri_rank)
+		return -DER_OOG;
+
+	*grp_rank = lo;
+	return 0;
+}
+
 static inline int
 crt_grp_priv_create(struct crt_grp_priv **grp_priv_created,
 		    crt_group_id_t grp_id, bool primary_grp,
@@ -693,6 +998,7 @@ crt_grp_priv_create(struct crt_grp_priv **grp_priv_created,
 		D_GOTO(out, rc = -DER_NOMEM);
 
 	D_INIT_LIST_HEAD(&grp_priv->gp_link);
+	D_INIT_LIST_HEAD(&grp_priv->gp_lc_items);
 	grp_priv->gp_local = 1;
 	grp_priv->gp_primary = primary_grp;
 	D_STRNDUP(grp_priv->gp_pub.cg_grpid, grp_id, CRT_GROUP_ID_MAX_LEN + 1);
@@ -708,6 +1014,15 @@ crt_grp_priv_create(struct crt_grp_priv **grp_priv_created,
 		D_GOTO(out, rc);
 	}
 
+	rc = crt_grp_membs_idx_init(grp_priv);
+	if (rc != 0) {
+		D_ERROR("crt_grp_membs_idx_init failed, rc: %d.\n", rc);
+		d_rank_list_free(grp_priv->gp_membs);
+		D_FREE(grp_priv->gp_pub.cg_grpid);
+		D_FREE_PTR(grp_priv);
+		D_GOTO(out, rc);
+	}
+
 	grp_priv->gp_status = CRT_GRP_CREATING;
 	grp_priv->gp_priv = arg;
 
@@ -719,13 +1034,40 @@ crt_grp_priv_create(struct crt_grp_priv **grp_priv_created,
 	grp_priv->gp_refcount = 1;
 	rc = D_RWLOCK_INIT(&grp_priv->gp_rwlock, NULL);
 	if (rc != 0) {
+		crt_grp_membs_idx_fini(grp_priv);
+		d_rank_list_free(grp_priv->gp_membs);
 		D_FREE(grp_priv->gp_pub.cg_grpid);
 		D_FREE_PTR(grp_priv);
 		D_GOTO(out, rc);
 	}
 
+	rc = crt_tree_cache_init(grp_priv);
+	if (rc != 0) {
+		crt_grp_membs_idx_fini(grp_priv);
+		d_rank_list_free(grp_priv->gp_membs);
+		D_FREE(grp_priv->gp_pub.cg_grpid);
+		D_RWLOCK_DESTROY(&grp_priv->gp_rwlock);
+		D_FREE_PTR(grp_priv);
+		D_GOTO(out, rc);
+	}
+
 	rc = crt_barrier_info_init(grp_priv);
 	if (rc != 0) {
+		crt_tree_cache_fini(grp_priv);
+		crt_grp_membs_idx_fini(grp_priv);
+		d_rank_list_free(grp_priv->gp_membs);
+		D_FREE(grp_priv->gp_pub.cg_grpid);
+		D_RWLOCK_DESTROY(&grp_priv->gp_rwlock);
+		D_FREE_PTR(grp_priv);
+		D_GOTO(out, rc);
+	}
+
+	rc = crt_coll_info_init(grp_priv);
+	if (rc != 0) {
+		crt_barrier_info_destroy(grp_priv);
+		crt_tree_cache_fini(grp_priv);
+		crt_grp_membs_idx_fini(grp_priv);
+		d_rank_list_free(grp_priv->gp_membs);
 		D_FREE(grp_priv->gp_pub.cg_grpid);
 		D_RWLOCK_DESTROY(&grp_priv->gp_rwlock);
 		D_FREE_PTR(grp_priv);
@@ -738,6 +1080,20 @@ out:
 	return rc;
 }
 
+static void
+crt_grp_ras_fini(struct crt_grp_priv *grp_priv)
+{
+	D_ASSERT(grp_priv->gp_service);
+	if (grp_priv->gp_primary) {
+		d_rank_set_free(grp_priv->gp_failed_set);
+		D_RWLOCK_DESTROY(grp_priv->gp_rwlock_ft);
+		D_FREE(grp_priv->gp_rwlock_ft);
+	}
+	grp_priv->gp_failed_set = NULL;
+	d_rank_set_free(grp_priv->gp_live_set);
+	grp_priv->gp_live_set = NULL;
+}
+
 static int
 crt_grp_ras_init(struct crt_grp_priv *grp_priv)
 {
@@ -745,31 +1101,45 @@ crt_grp_ras_init(struct crt_grp_priv *grp_priv)
 
 	D_ASSERT(grp_priv->gp_service);
 
-	rc = d_rank_list_dup(&grp_priv->gp_live_ranks, grp_priv->gp_membs);
+	if (grp_priv->gp_primary) {
+		/* the primary group members are 0 to gp_size - 1 */
+		grp_priv->gp_live_set = d_rank_set_alloc();
+		if (grp_priv->gp_live_set == NULL)
+			D_GOTO(out, rc = -DER_NOMEM);
+		rc = d_rank_set_add_range(grp_priv->gp_live_set, 0,
+					  grp_priv->gp_size - 1);
+	} else {
+		rc = d_rank_set_from_list(&grp_priv->gp_live_set,
+					  grp_priv->gp_membs);
+	}
 	if (rc != 0) {
-		D_ERROR("d_rank_list_dup() failed, group: %s, rc: %d\n",
+		D_ERROR("building live rank set failed, group: %s, rc: %d\n",
 				grp_priv->gp_pub.cg_grpid, rc);
-		D_GOTO(out, rc = -DER_NOMEM);
+		d_rank_set_free(grp_priv->gp_live_set);
+		grp_priv->gp_live_set = NULL;
+		D_GOTO(out, rc);
 	}
 
 	if (grp_priv->gp_primary) {
-		grp_priv->gp_failed_ranks = d_rank_list_alloc(0);
-		if (grp_priv->gp_failed_ranks == NULL) {
-			D_ERROR("d_rank_list_alloc failed.\n");
-			d_rank_list_free(grp_priv->gp_live_ranks);
+		grp_priv->gp_failed_set = d_rank_set_alloc();
+		if (grp_priv->gp_failed_set == NULL) {
+			D_ERROR("d_rank_set_alloc failed.\n");
+			d_rank_set_free(grp_priv->gp_live_set);
 			D_GOTO(out, rc = -DER_NOMEM);
 		}
 
 		D_ALLOC_PTR(grp_priv->gp_rwlock_ft);
 		if (grp_priv->gp_rwlock_ft == NULL) {
-			d_rank_list_free(grp_priv->gp_live_ranks);
+			d_rank_set_free(grp_priv->gp_failed_set);
+			d_rank_set_free(grp_priv->gp_live_set);
 			D_GOTO(out, rc = -DER_NOMEM);
 		}
 
 		rc = D_RWLOCK_INIT(grp_priv->gp_rwlock_ft, NULL);
 		if (rc != 0) {
 			D_FREE(grp_priv->gp_rwlock_ft);
-			d_rank_list_free(grp_priv->gp_live_ranks);
+			d_rank_set_free(grp_priv->gp_failed_set);
+			d_rank_set_free(grp_priv->gp_live_set);
 			D_GOTO(out, rc);
 		}
 
@@ -779,14 +1149,18 @@ crt_grp_ras_init(struct crt_grp_priv *grp_priv)
 		default_grp_priv = crt_grp_pub2priv(NULL);
 		D_ASSERT(default_grp_priv != NULL);
 
-		grp_priv->gp_failed_ranks = default_grp_priv->gp_failed_ranks;
+		grp_priv->gp_failed_set = default_grp_priv->gp_failed_set;
 		grp_priv->gp_rwlock_ft = default_grp_priv->gp_rwlock_ft;
 	}
 
 	D_RWLOCK_WRLOCK(grp_priv->gp_rwlock_ft);
-	d_rank_list_filter(grp_priv->gp_failed_ranks, grp_priv->gp_live_ranks,
-			   true /* exclude */);
+	rc = d_rank_set_diff(grp_priv->gp_live_set, grp_priv->gp_failed_set);
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
+	if (rc != 0) {
+		D_ERROR("d_rank_set_diff failed, group: %s, rc: %d\n",
+			grp_priv->gp_pub.cg_grpid, rc);
+		crt_grp_ras_fini(grp_priv);
+	}
 
 out:
 	return rc;
@@ -849,6 +1223,10 @@ crt_grp_priv_destroy(struct crt_grp_priv *grp_priv)
 	D_RWLOCK_UNLOCK(&crt_grp_list_rwlock);
 
 	/* destroy the grp_priv */
+	crt_grp_lc_destroy(grp_priv);
+	crt_tree_cache_fini(grp_priv);
+	crt_grp_membs_idx_fini(grp_priv);
+	D_FREE(grp_priv->gp_host_ids);
 	d_rank_list_free(grp_priv->gp_membs);
 	if (grp_priv->gp_psr_phy_addr != NULL)
 		free(grp_priv->gp_psr_phy_addr);
@@ -856,6 +1234,7 @@ crt_grp_priv_destroy(struct crt_grp_priv *grp_priv)
 	free(grp_priv->gp_pub.cg_grpid);
 
 	crt_barrier_info_destroy(grp_priv);
+	crt_coll_info_destroy(grp_priv);
 
 	D_FREE_PTR(grp_priv);
 }
@@ -916,15 +1295,13 @@ crt_hdlr_grp_create(crt_rpc_t *rpc_req)
 		 grp_priv->gp_membs->rl_nr > 0 &&
 		 grp_priv->gp_membs->rl_ranks != NULL);
 	grp_priv->gp_size = grp_priv->gp_membs->rl_nr;
-	rc = d_idx_in_rank_list(grp_priv->gp_membs, pri_rank,
-				&grp_priv->gp_self);
+	rc = crt_grp_rank_p2s(grp_priv, pri_rank, &grp_priv->gp_self);
 	if (rc != 0) {
-		D_ERROR("d_idx_in_rank_list(rank %d, group %s) failed, "
+		D_ERROR("crt_grp_rank_p2s(rank %d, group %s) failed, "
 			"rc: %d.\n", pri_rank, gc_in->gc_grp_id, rc);
-		D_GOTO(out, rc = -DER_OOG);
+		D_GOTO(out, rc);
 	}
 
-	crt_barrier_update_master(grp_priv);
 out:
 	gc_out->gc_rank = pri_rank;
 	gc_out->gc_rc = rc;
@@ -1047,8 +1424,6 @@ crt_group_create(crt_group_id_t grp_id, d_rank_list_t *member_ranks,
 	uint32_t			 grp_size;
 	crt_rpc_t			*gc_corpc;
 	struct crt_grp_create_in	*gc_in;
-	d_rank_list_t			*excluded_ranks;
-	d_rank_list_t			*default_gp_membs;
 	bool				 in_grp = false;
 	int				 i;
 	int				 rc = 0;
@@ -1107,24 +1482,13 @@ crt_group_create(crt_group_id_t grp_id, d_rank_list_t *member_ranks,
 	grp_priv->gp_ctx = crt_ctx;
 
 	/* TODO handle the populate_now == false */
-	/* TODO add another corpc function which takes a inclusion list */
 
-	/* Construct an exclusion list for crt_corpc_req_create(). The exclusion
-	 * list contains all live ranks minus non subgroup members so that the
-	 * RPC is only sent to subgroup members.
-	 */
-	default_gp_membs = default_grp_priv->gp_membs;
-	rc = d_rank_list_dup(&excluded_ranks, default_gp_membs);
-	if (rc != 0) {
-		D_ERROR("d_rank_list_dup() failed, rc %d\n", rc);
-		D_GOTO(out, rc);
-	}
-	d_rank_list_filter(member_ranks, excluded_ranks, true /* exlude */);
-	rc = crt_corpc_req_create(crt_ctx, NULL, excluded_ranks,
-			     CRT_OPC_GRP_CREATE, NULL, NULL, 0,
+	/* the RPC is only sent to the subgroup members */
+	rc = crt_corpc_req_create(crt_ctx, NULL, grp_priv->gp_membs,
+			     CRT_OPC_GRP_CREATE, NULL, NULL,
+			     CRT_RPC_FLAG_INCLUSIVE,
 			     crt_tree_topo(CRT_TREE_KNOMIAL, 4),
 			     &gc_corpc);
-	d_rank_list_free(excluded_ranks);
 	if (rc != 0) {
 		D_ERROR("crt_corpc_req_create(CRT_OPC_GRP_CREATE) failed, "
 			"rc %d\n", rc);
@@ -1215,17 +1579,6 @@ out:
 	return (grp_priv == NULL) ? NULL : &grp_priv->gp_pub;
 }
 
-static void
-crt_grp_ras_fini(struct crt_grp_priv *grp_priv)
-{
-	D_ASSERT(grp_priv->gp_service);
-	if (grp_priv->gp_primary) {
-		d_rank_list_free(grp_priv->gp_failed_ranks);
-		D_RWLOCK_DESTROY(grp_priv->gp_rwlock_ft);
-		D_FREE(grp_priv->gp_rwlock_ft);
-	}
-	d_rank_list_free(grp_priv->gp_live_ranks);
-}
 
 void
 crt_hdlr_grp_destroy(crt_rpc_t *rpc_req)
@@ -1464,17 +1817,10 @@ crt_group_rank_p2s(crt_group_t *subgrp, d_rank_t rank_in, d_rank_t *rank_out)
 
 	}
 
-	if (grp_priv->gp_primary) {
-		*rank_out = rank_in;
-		return rc;
-	}
-
-	rc = d_idx_in_rank_list(grp_priv->gp_membs, rank_in, rank_out);
-	if (rc != 0) {
+	rc = crt_grp_rank_p2s(grp_priv, rank_in, rank_out);
+	if (rc != 0)
 		D_ERROR("primary rank %d is not a member of subgroup %s.\n",
 			rank_in, subgrp->cg_grpid);
-		rc = -DER_OOG;
-	}
 
 	return rc;
 }
@@ -1601,6 +1947,83 @@ out:
 	return rc;
 }
 
+struct crt_host_key {
+	uint64_t	hk_hash;
+	d_rank_t	hk_rank;
+};
+
+static int
+crt_host_key_cmp(const void *a, const void *b)
+{
+	const struct crt_host_key	*ka = a;
+	const struct crt_host_key	*kb = b;
+
+	if (ka->hk_hash != kb->hk_hash)
+		return ka->hk_hash < kb->hk_hash ? -1 : 1;
+	return ka->hk_rank < kb->hk_rank ? -1 : ka->hk_rank > kb->hk_rank;
+}
+
+/*
+ * Build gp_host_ids from the URIs in the lookup cache. They are all there
+ * after a file bootstrap or a URI prefetch, and are the same on every rank,
+ * so every rank derives the same map. Otherwise there is no map. Whether
+ * CRT_TREE_HIER is used is decided by the root of each collective, which
+ * sends gp_host_map along, see crt_tree_hier_resolve().
+ */
+static int
+crt_grp_host_map_init(struct crt_grp_priv *grp_priv)
+{
+	struct crt_host_key	*keys = NULL;
+	crt_phy_addr_t		 uri;
+	uint32_t		*ids = NULL;
+	uint32_t		 host_nr;
+	d_rank_t		 rank;
+	uint32_t		 i;
+	int			 rc = 0;
+
+	D_ASSERT(grp_priv->gp_primary && grp_priv->gp_local);
+
+	D_ALLOC_ARRAY(keys, grp_priv->gp_size);
+	if (keys == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	for (rank = 0; rank < grp_priv->gp_size; rank++) {
+		uri = NULL;
+		rc = crt_grp_lc_lookup(grp_priv, 0, rank, 0, &uri, NULL);
+		if (rc != 0 || uri == NULL) {
+			D_DEBUG(DB_TRACE, "group %s, URI of rank %d unknown, "
+				"no host map.\n", grp_priv->gp_pub.cg_grpid,
+				rank);
+			D_GOTO(out, rc = 0);
+		}
+		keys[rank].hk_hash = crt_uri_host_key(uri);
+		keys[rank].hk_rank = rank;
+	}
+	qsort(keys, grp_priv->gp_size, sizeof(*keys), crt_host_key_cmp);
+
+	D_ALLOC_ARRAY(ids, grp_priv->gp_size);
+	if (ids == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	host_nr = 0;
+	for (i = 0; i < grp_priv->gp_size; i++) {
+		if (i == 0 || keys[i].hk_hash != keys[i - 1].hk_hash)
+			host_nr++;
+		ids[keys[i].hk_rank] = host_nr - 1;
+	}
+	grp_priv->gp_host_ids = ids;
+	grp_priv->gp_host_nr = host_nr;
+	grp_priv->gp_host_map = d_hash_murmur64((unsigned char *)ids,
+				grp_priv->gp_size * sizeof(*ids), host_nr);
+	if (grp_priv->gp_host_map == 0)
+		grp_priv->gp_host_map = 1;
+	D_DEBUG(DB_TRACE, "group %s, %d ranks on %d hosts, map "DF_X64".\n",
+		grp_priv->gp_pub.cg_grpid, grp_priv->gp_size, host_nr,
+		grp_priv->gp_host_map);
+
+out:
+	D_FREE(keys);
+	return rc;
+}
+
 static int
 crt_primary_grp_init(crt_group_id_t grpid)
 {
@@ -1636,6 +2059,14 @@ crt_primary_grp_init(crt_group_id_t grpid)
 	if (crt_is_singleton()) {
 		grp_priv->gp_size = 1;
 		grp_priv->gp_self = 0;
+	} else if (crt_is_bootstrap()) {
+		D_ALLOC_ARRAY(grp_priv->gp_rank_map, pmix_gdata->pg_univ_size);
+		if (grp_priv->gp_rank_map == NULL)
+			D_GOTO(out, rc = -DER_NOMEM);
+
+		rc = crt_boot_assign_rank(grp_priv);
+		if (rc != 0)
+			D_GOTO(out, rc);
 	} else {
 		/* init the rank map */
 		D_ALLOC_ARRAY(grp_priv->gp_rank_map, pmix_gdata->pg_univ_size);
@@ -1653,6 +2084,10 @@ crt_primary_grp_init(crt_group_id_t grpid)
 		rc = crt_pmix_fence();
 		if (rc != 0)
 			D_GOTO(out, rc);
+
+		/* a failed prefetch leaves the lookups to be done on demand */
+		if (is_service && crt_gdata.cg_uri_prefetch)
+			crt_pmix_uri_prefetch(grp_priv);
 	}
 
 	grp_priv->gp_membs = d_rank_list_alloc(grp_priv->gp_size);
@@ -1666,19 +2101,15 @@ crt_primary_grp_init(crt_group_id_t grpid)
 		grp_priv->gp_subgrp_idx = 1;
 
 		grp_gdata->gg_srv_pri_grp = grp_priv;
-		rc = crt_grp_lc_create(grp_gdata->gg_srv_pri_grp);
-		if (rc != 0) {
-			D_ERROR("crt_grp_lc_create failed, rc: %d.\n",
-				rc);
-			D_GOTO(out, rc);
-		}
 		rc = crt_grp_ras_init(grp_priv);
 		if (rc != 0) {
 			D_ERROR("crt_grp_ras_init() failed, rc %d.\n", rc);
 			D_GOTO(out, rc);
 		}
 
-		crt_barrier_update_master(grp_priv);
+		/* without a host map HIER trees are knomial ones */
+		if (crt_grp_host_map_init(grp_priv) != 0)
+			D_ERROR("crt_grp_host_map_init() failed.\n");
 	} else {
 		grp_gdata->gg_cli_pri_grp = grp_priv;
 	}
@@ -1828,6 +2259,115 @@ err_out:
 	return rc;
 }
 
+struct crt_uri_lookup_pmix {
+	crt_rpc_t		*ulp_req;
+	d_rank_t		 ulp_g_rank;
+};
+
+/*
+ * Completion of the PMIx lookup of the base URI of a rank for a URI_LOOKUP,
+ * called from the PMIx progress thread.
+ */
+static void
+crt_uri_lookup_pmix_cb(const char *uri, int rc, void *arg)
+{
+	struct crt_uri_lookup_pmix	*ulp = arg;
+	struct crt_uri_lookup_in	*ul_in;
+	struct crt_uri_lookup_out	*ul_out;
+	crt_rpc_t			*ul_req = ulp->ulp_req;
+	struct crt_context		*crt_ctx;
+
+	ul_in = crt_req_get(ul_req);
+	ul_out = crt_reply_get(ul_req);
+	crt_ctx = ul_req->cr_ctx;
+
+	if (rc == 0) {
+		rc = crt_grp_lc_uri_insert(crt_gdata.cg_grp->gg_srv_pri_grp,
+					   crt_ctx->cc_idx, ulp->ulp_g_rank, 0,
+					   uri);
+		if (rc != 0)
+			D_ERROR("crt_grp_lc_uri_insert() failed, rc %d\n", rc);
+	}
+
+	if (rc == 0 && ul_in->ul_tag != 0) {
+		/* forward to the final target, which replies to ul_req */
+		rc = crt_uri_lookup_forward(ul_req, ulp->ulp_g_rank);
+		if (rc != 0)
+			D_ERROR("crt_uri_lookup_forward() failed, rc %d\n",
+				rc);
+		D_GOTO(out, rc);
+	}
+
+	ul_out->ul_uri = (rc == 0) ? (crt_phy_addr_t)uri : NULL;
+	ul_out->ul_rc = rc;
+	rc = crt_reply_send(ul_req);
+	if (rc != 0)
+		D_ERROR("crt_reply_send failed, rc: %d, opc: %#x.\n",
+			rc, ul_req->cr_opc);
+
+out:
+	/* addref in crt_uri_lookup_pmix */
+	RPC_PUB_DECREF(ul_req);
+	D_FREE_PTR(ulp);
+}
+
+/* look up the base URI of g_rank through PMIx, then answer ul_req */
+static int
+crt_uri_lookup_pmix(crt_rpc_t *ul_req, d_rank_t g_rank)
+{
+	struct crt_uri_lookup_pmix	*ulp;
+	int				 rc;
+
+	D_ALLOC_PTR(ulp);
+	if (ulp == NULL)
+		return -DER_NOMEM;
+	ulp->ulp_req = ul_req;
+	ulp->ulp_g_rank = g_rank;
+
+	/* decref in crt_uri_lookup_pmix_cb */
+	RPC_PUB_ADDREF(ul_req);
+	rc = crt_pmix_uri_lookup_nb(crt_gdata.cg_grp->gg_srv_pri_grp->
+				    gp_pub.cg_grpid, g_rank,
+				    crt_uri_lookup_pmix_cb, ulp);
+	if (rc != 0) {
+		RPC_PUB_DECREF(ul_req);
+		D_FREE_PTR(ulp);
+	}
+
+	return rc;
+}
+
+/*
+ * Find the local group a URI_LOOKUP asks about. A subgroup is returned with a
+ * reference taken, which is flagged in *should_decref.
+ */
+static struct crt_grp_priv *
+crt_uri_lookup_grp_get(crt_group_id_t grp_id, bool *should_decref)
+{
+	struct crt_grp_priv	*default_grp_priv;
+	struct crt_grp_priv	*grp_priv;
+
+	*should_decref = false;
+	default_grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
+	if (strncmp(grp_id, default_grp_priv->gp_pub.cg_grpid,
+		    CRT_GROUP_ID_MAX_LEN) == 0) {
+		D_DEBUG(DB_TRACE, "ul_grp_id %s matches with gg_srv_pri_grp "
+			"%s.\n", grp_id, default_grp_priv->gp_pub.cg_grpid);
+		return default_grp_priv;
+	}
+
+	/* handle subgroup lookups */
+	D_RWLOCK_RDLOCK(&crt_grp_list_rwlock);
+	grp_priv = crt_grp_lookup_locked(grp_id);
+	if (grp_priv != NULL) {
+		crt_grp_priv_addref(grp_priv);
+		*should_decref = true;
+	}
+	D_RWLOCK_UNLOCK(&crt_grp_list_rwlock);
+
+	return grp_priv;
+}
+
 void
 crt_hdlr_uri_lookup(crt_rpc_t *rpc_req)
 {
@@ -1852,24 +2392,9 @@ crt_hdlr_uri_lookup(crt_rpc_t *rpc_req)
 		rc = -DER_PROTO;
 	}
 	default_grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
-	if (strncmp(ul_in->ul_grp_id, default_grp_priv->gp_pub.cg_grpid,
-		    CRT_GROUP_ID_MAX_LEN) == 0) {
-		grp_priv = default_grp_priv;
-		D_DEBUG(DB_TRACE, "ul_grp_id %s matches with gg_srv_pri_grp "
-			"%s.\n", ul_in->ul_grp_id,
-			default_grp_priv->gp_pub.cg_grpid);
-	} else {
-		/* handle subgroup lookups */
-		D_RWLOCK_RDLOCK(&crt_grp_list_rwlock);
-		grp_priv = crt_grp_lookup_locked(ul_in->ul_grp_id);
-		if (grp_priv == NULL) {
-			rc = -DER_INVAL;
-		} else {
-			crt_grp_priv_addref(grp_priv);
-			should_decref = true;
-		}
-		D_RWLOCK_UNLOCK(&crt_grp_list_rwlock);
-	}
+	grp_priv = crt_uri_lookup_grp_get(ul_in->ul_grp_id, &should_decref);
+	if (grp_priv == NULL)
+		rc = -DER_INVAL;
 
 	if (rc != 0) {
 		ul_out->ul_uri = NULL;
@@ -1910,95 +2435,663 @@ crt_hdlr_uri_lookup(crt_rpc_t *rpc_req)
 		if (tmp_uri == NULL)
 			D_GOTO(out, rc = -DER_NOMEM);
 
-		rc = crt_hg_get_addr(tmp_crt_ctx->cc_hg_ctx.chc_hgcla,
-				tmp_uri, &uri_len);
-		if (rc != 0) {
-			D_ERROR("na_class_get_addr failed, rc: %d.\n", rc);
-			D_FREE(tmp_uri);
-			D_GOTO(out, rc = -DER_HG);
+		rc = crt_hg_get_addr(tmp_crt_ctx->cc_hg_ctx.chc_hgcla,
+				tmp_uri, &uri_len);
+		if (rc != 0) {
+			D_ERROR("na_class_get_addr failed, rc: %d.\n", rc);
+			D_FREE(tmp_uri);
+			D_GOTO(out, rc = -DER_HG);
+		}
+
+		ul_out->ul_uri = tmp_uri;
+		D_GOTO(out, rc);
+	}
+
+	/* convert the requested rank to global rank */
+	g_rank = grp_priv->gp_membs->rl_ranks[ul_in->ul_rank];
+
+	/* step 1, lookup the URI in the local cache */
+	rc = crt_grp_lc_lookup(default_grp_priv, crt_ctx->cc_idx, g_rank,
+			       ul_in->ul_tag, &cached_uri, NULL);
+	if (rc != 0) {
+		D_ERROR("crt_grp_lc_lookup(grp %s, rank %d, tag %d) failed, "
+			"rc: %d.\n", default_grp_priv->gp_pub.cg_grpid,
+			g_rank, ul_in->ul_tag, rc);
+		D_GOTO(out, rc);
+	}
+	ul_out->ul_uri = cached_uri;
+	if (ul_out->ul_uri != NULL)
+		D_GOTO(out, rc);
+
+	/**
+	 * step 2, make sure URI of tag 0 is in cache in preparation to forward
+	 * the lookup RPC
+	 */
+	if (ul_in->ul_tag != 0) {
+		/* tag != 0, check if tag 0 is in cache */
+		rc = crt_grp_lc_lookup(default_grp_priv, crt_ctx->cc_idx,
+				       g_rank, 0, &cached_uri, NULL);
+		if (rc != 0) {
+			D_ERROR("crt_grp_lc_lookup(grp %s, rank %d, tag %d) "
+				"failed, rc: %d.\n",
+				default_grp_priv->gp_pub.cg_grpid,
+				g_rank, 0, rc);
+			D_GOTO(out, rc);
+		}
+	}
+	ul_out->ul_uri = cached_uri;
+
+	if (cached_uri == NULL) {
+		/* tag 0 URI not in cache, resort to PMIx */
+		rc = crt_uri_lookup_pmix(rpc_req, g_rank);
+		if (rc != 0) {
+			D_ERROR("crt_uri_lookup_pmix() failed, rc %d\n", rc);
+			D_GOTO(out, rc);
+		}
+		/* replied by crt_uri_lookup_pmix_cb */
+		if (should_decref)
+			crt_grp_priv_decref(grp_priv);
+		return;
+	}
+	/* tag 0 uri in cache now */
+
+	if (ul_in->ul_tag == 0) {
+		/* we are done at this point */
+		D_GOTO(out, rc);
+	}
+
+	/* step 3, forward the requst to the final target */
+	rc = crt_uri_lookup_forward(rpc_req, g_rank);
+	if (rc != 0)
+		D_ERROR("crt_uri_lookup_forward() failed, rc %d\n", rc);
+
+	if (should_decref)
+		crt_grp_priv_decref(grp_priv);
+	return;
+
+out:
+	if (should_decref)
+		crt_grp_priv_decref(grp_priv);
+	ul_out->ul_rc = rc;
+	rc = crt_reply_send(rpc_req);
+	if (rc != 0)
+		D_ERROR("crt_reply_send failed, rc: %d, opc: %#x.\n",
+			rc, rpc_req->cr_opc);
+	if (tmp_uri != NULL)
+		free(tmp_uri);
+}
+
+/*
+ * Copy the URI of (rank, tag) of grp_priv into uri if this rank knows it,
+ * otherwise leave uri empty. Only resolves what crt_hdlr_uri_lookup() can
+ * answer without forwarding or asking PMIx, i.e. its own and cached URIs.
+ */
+static int
+crt_uri_lookup_known(struct crt_context *crt_ctx, struct crt_grp_priv *grp_priv,
+		     d_rank_t rank, uint32_t tag, char *uri)
+{
+	struct crt_grp_priv	*default_grp_priv;
+	struct crt_context	*tag_ctx;
+	crt_phy_addr_t		 cached_uri = NULL;
+	na_size_t		 uri_len = CRT_ADDR_STR_MAX_LEN;
+	d_rank_t		 g_rank;
+	int			 rc;
+
+	uri[0] = '\0';
+	if (rank >= grp_priv->gp_size || tag >= CRT_SRV_CONTEXT_NUM)
+		return -DER_INVAL;
+
+	if (rank == grp_priv->gp_self) {
+		tag_ctx = crt_context_lookup(tag);
+		if (tag_ctx == NULL)
+			return -DER_NONEXIST;
+		rc = crt_hg_get_addr(tag_ctx->cc_hg_ctx.chc_hgcla, uri,
+				     &uri_len);
+		if (rc != 0) {
+			D_ERROR("crt_hg_get_addr failed, rc: %d.\n", rc);
+			return -DER_HG;
+		}
+		return 0;
+	}
+
+	default_grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
+	g_rank = grp_priv->gp_membs->rl_ranks[rank];
+	rc = crt_grp_lc_lookup(default_grp_priv, crt_ctx->cc_idx, g_rank, tag,
+			       &cached_uri, NULL);
+	if (rc != 0)
+		return rc;
+	if (cached_uri != NULL) {
+		strncpy(uri, cached_uri, CRT_ADDR_STR_MAX_LEN - 1);
+		uri[CRT_ADDR_STR_MAX_LEN - 1] = '\0';
+	}
+
+	return rc;
+}
+
+struct crt_uri_batch_put {
+	crt_rpc_t		*ubp_req;
+	crt_bulk_t		 ubp_bulk;
+	char			*ubp_buf;
+};
+
+static int
+crt_uri_lookup_batch_put_cb(const struct crt_bulk_cb_info *cb_info)
+{
+	struct crt_uri_batch_put	*put = cb_info->bci_arg;
+	struct crt_uri_lookup_batch_out	*ulb_out;
+	int				 rc;
+
+	ulb_out = crt_reply_get(put->ubp_req);
+	if (cb_info->bci_rc != 0) {
+		D_ERROR("bulk put of URIs failed, rc: %d.\n", cb_info->bci_rc);
+		ulb_out->ulb_rc = cb_info->bci_rc;
+	}
+	rc = crt_reply_send(put->ubp_req);
+	if (rc != 0)
+		D_ERROR("crt_reply_send failed, rc: %d.\n", rc);
+
+	crt_bulk_free(put->ubp_bulk);
+	D_FREE(put->ubp_buf);
+	RPC_PUB_DECREF(put->ubp_req);
+	D_FREE_PTR(put);
+	return 0;
+}
+
+/* put the URIs into the bulk buffer of the requester, then reply */
+static int
+crt_uri_lookup_batch_put(crt_rpc_t *rpc_req, char *buf, size_t len)
+{
+	struct crt_uri_lookup_batch_in	*ulb_in;
+	struct crt_uri_batch_put	*put;
+	struct crt_bulk_desc		 bulk_desc;
+	d_sg_list_t			 sgl;
+	d_iov_t				 iov;
+	size_t				 bulk_len;
+	int				 rc;
+
+	ulb_in = crt_req_get(rpc_req);
+	rc = crt_bulk_get_len(ulb_in->ulb_bulk, &bulk_len);
+	if (rc != 0)
+		return rc;
+	if (bulk_len < len) {
+		D_ERROR("bulk of %zu bytes too small for %zu bytes URIs.\n",
+			bulk_len, len);
+		return -DER_TRUNC;
+	}
+
+	D_ALLOC_PTR(put);
+	if (put == NULL)
+		return -DER_NOMEM;
+	d_iov_set(&iov, buf, len);
+	sgl.sg_nr = 1;
+	sgl.sg_nr_out = 0;
+	sgl.sg_iovs = &iov;
+	rc = crt_bulk_create(rpc_req->cr_ctx, &sgl, CRT_BULK_RO,
+			     &put->ubp_bulk);
+	if (rc != 0) {
+		D_FREE_PTR(put);
+		return rc;
+	}
+	put->ubp_req = rpc_req;
+	put->ubp_buf = buf;
+	/* decref in crt_uri_lookup_batch_put_cb */
+	RPC_PUB_ADDREF(rpc_req);
+
+	bulk_desc.bd_rpc = rpc_req;
+	bulk_desc.bd_bulk_op = CRT_BULK_PUT;
+	bulk_desc.bd_remote_hdl = ulb_in->ulb_bulk;
+	bulk_desc.bd_remote_off = 0;
+	bulk_desc.bd_local_hdl = put->ubp_bulk;
+	bulk_desc.bd_local_off = 0;
+	bulk_desc.bd_len = len;
+	rc = crt_bulk_transfer(&bulk_desc, crt_uri_lookup_batch_put_cb, put,
+			       NULL);
+	if (rc != 0) {
+		D_ERROR("crt_bulk_transfer failed, rc: %d.\n", rc);
+		crt_bulk_free(put->ubp_bulk);
+		RPC_PUB_DECREF(rpc_req);
+		D_FREE_PTR(put);
+	}
+
+	return rc;
+}
+
+void
+crt_hdlr_uri_lookup_batch(crt_rpc_t *rpc_req)
+{
+	struct crt_uri_lookup_batch_in	*ulb_in;
+	struct crt_uri_lookup_batch_out	*ulb_out;
+	struct crt_grp_priv		*grp_priv = NULL;
+	struct crt_uri_pair		*pairs;
+	bool				 should_decref = false;
+	char				*buf = NULL;
+	size_t				 len = 0;
+	uint32_t			 nr;
+	uint32_t			 i;
+	int				 rc = 0;
+
+	ulb_in = crt_req_get(rpc_req);
+	ulb_out = crt_reply_get(rpc_req);
+
+	if (!crt_is_service()) {
+		D_ERROR("crt_hdlr_uri_lookup_batch invalid on client.\n");
+		D_GOTO(out, rc = -DER_PROTO);
+	}
+	grp_priv = crt_uri_lookup_grp_get(ulb_in->ulb_grp_id, &should_decref);
+	if (grp_priv == NULL)
+		D_GOTO(out, rc = -DER_INVAL);
+
+	pairs = ulb_in->ulb_pairs.iov_buf;
+	nr = ulb_in->ulb_pairs.iov_len / sizeof(*pairs);
+	if (nr == 0 || nr > CRT_UL_BATCH_MAX)
+		D_GOTO(out, rc = -DER_INVAL);
+
+	D_ALLOC(buf, nr * CRT_ADDR_STR_MAX_LEN);
+	if (buf == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	for (i = 0; i < nr; i++) {
+		rc = crt_uri_lookup_known(rpc_req->cr_ctx, grp_priv,
+					  pairs[i].uip_rank, pairs[i].uip_tag,
+					  buf + len);
+		if (rc != 0) {
+			D_DEBUG(DB_TRACE, "no URI for group %s rank %d tag %d, "
+				"rc: %d.\n", ulb_in->ulb_grp_id,
+				pairs[i].uip_rank, pairs[i].uip_tag, rc);
+			buf[len] = '\0';
+			rc = 0;
+		}
+		len += strlen(buf + len) + 1;
+	}
+	ulb_out->ulb_len = len;
+
+	if (ulb_in->ulb_bulk != CRT_BULK_NULL) {
+		rc = crt_uri_lookup_batch_put(rpc_req, buf, len);
+		if (rc == 0) {
+			/* replied and freed by crt_uri_lookup_batch_put_cb */
+			buf = NULL;
+			D_GOTO(decref, rc);
+		}
+		D_GOTO(out, rc);
+	}
+	d_iov_set(&ulb_out->ulb_uris, buf, len);
+
+out:
+	ulb_out->ulb_rc = rc;
+	rc = crt_reply_send(rpc_req);
+	if (rc != 0)
+		D_ERROR("crt_reply_send failed, rc: %d, opc: %#x.\n",
+			rc, rpc_req->cr_opc);
+decref:
+	if (should_decref)
+		crt_grp_priv_decref(grp_priv);
+	D_FREE(buf);
+}
+
+/* a (rank, tag) waiting for a batched URI_LOOKUP */
+struct crt_ul_pending {
+	d_list_t		 ulp_link;
+	d_rank_t		 ulp_rank;
+	uint32_t		 ulp_tag;
+	crt_grp_ul_cb_t		 ulp_cb;
+	void			*ulp_arg;
+};
+
+/* URI lookups of one context to one attached group */
+struct crt_ul_batch {
+	/* link to crt_context::cc_ul_batches */
+	d_list_t		 ulb_link;
+	struct crt_context	*ulb_ctx;
+	struct crt_grp_priv	*ulb_grp_priv;
+	/* lookups not sent yet */
+	d_list_t		 ulb_pending;
+	/* the batched URI_LOOKUP in flight, NULL once it completes */
+	struct crt_ul_batch_req	*ulb_req;
+	/* a batched URI_LOOKUP is in flight */
+	uint32_t		 ulb_inflight:1;
+};
+
+/* one batched URI_LOOKUP RPC */
+struct crt_ul_batch_req {
+	struct crt_ul_batch	*ubr_batch;
+	/* crt_ul_pending sent in this RPC, in request order */
+	d_list_t		 ubr_list;
+	uint32_t		 ubr_nr;
+	struct crt_uri_pair	*ubr_pairs;
+	/* bulk buffer for the reply, only for large batches */
+	char			*ubr_buf;
+	crt_bulk_t		 ubr_bulk;
+};
+
+/*
+ * Take the next batch of pending lookups, or clear ulb_inflight and release
+ * the batch if nothing is pending.
+ */
+static struct crt_ul_batch_req *
+crt_ul_batch_next(struct crt_ul_batch *batch)
+{
+	struct crt_context	*ctx = batch->ulb_ctx;
+	struct crt_ul_batch_req	*req = NULL;
+	struct crt_ul_pending	*ulp;
+
+	D_ALLOC_PTR(req);
+
+	D_MUTEX_LOCK(&ctx->cc_mutex);
+	D_ASSERT(batch->ulb_inflight);
+	if (d_list_empty(&batch->ulb_pending)) {
+		batch->ulb_inflight = 0;
+		d_list_del(&batch->ulb_link);
+		D_MUTEX_UNLOCK(&ctx->cc_mutex);
+		D_FREE_PTR(batch);
+		D_FREE_PTR(req);
+		return NULL;
+	}
+	if (req == NULL) {
+		/* fail the first one, make progress for the others */
+		ulp = d_list_entry(batch->ulb_pending.next,
+				   struct crt_ul_pending, ulp_link);
+		d_list_del(&ulp->ulp_link);
+		D_MUTEX_UNLOCK(&ctx->cc_mutex);
+		ulp->ulp_cb(NULL, -DER_NOMEM, ulp->ulp_arg);
+		D_FREE_PTR(ulp);
+		return crt_ul_batch_next(batch);
+	}
+
+	req->ubr_batch = batch;
+	D_INIT_LIST_HEAD(&req->ubr_list);
+	while (!d_list_empty(&batch->ulb_pending) &&
+	       req->ubr_nr < CRT_UL_BATCH_MAX) {
+		ulp = d_list_entry(batch->ulb_pending.next,
+				   struct crt_ul_pending, ulp_link);
+		d_list_move_tail(&ulp->ulp_link, &req->ubr_list);
+		req->ubr_nr++;
+	}
+	batch->ulb_req = req;
+	D_MUTEX_UNLOCK(&ctx->cc_mutex);
+
+	return req;
+}
+
+/*
+ * complete all lookups of req, uris is NULL on failure. Lookups cancelled by
+ * crt_grp_uri_lookup_cancel() keep their slot in the reply but have no
+ * callback anymore.
+ */
+static void
+crt_ul_batch_req_complete(struct crt_ul_batch_req *req, const char *uris,
+			  size_t len, int rc)
+{
+	struct crt_ul_batch	*batch = req->ubr_batch;
+	struct crt_ul_pending	*ulp;
+	struct crt_ul_pending	*next;
+	d_list_t		 list;
+	const char		*uri;
+	size_t			 off = 0;
+	int			 ulp_rc;
+
+	/* no more cancellation once the lookups leave the batch */
+	D_INIT_LIST_HEAD(&list);
+	D_MUTEX_LOCK(&batch->ulb_ctx->cc_mutex);
+	d_list_splice_init(&req->ubr_list, &list);
+	batch->ulb_req = NULL;
+	D_MUTEX_UNLOCK(&batch->ulb_ctx->cc_mutex);
+
+	d_list_for_each_entry_safe(ulp, next, &list, ulp_link) {
+		d_list_del(&ulp->ulp_link);
+		uri = NULL;
+		ulp_rc = rc;
+		if (rc == 0) {
+			if (off >= len ||
+			    strnlen(uris + off, len - off) == len - off) {
+				D_ERROR("malformed batched URI_LOOKUP reply.\n");
+				ulp_rc = -DER_PROTO;
+			} else {
+				uri = uris + off;
+				off += strlen(uri) + 1;
+			}
 		}
-
-		ul_out->ul_uri = tmp_uri;
-		D_GOTO(out, rc);
+		if (uri != NULL && uri[0] == '\0')
+			uri = NULL;
+		if (uri != NULL) {
+			ulp_rc = crt_grp_lc_uri_insert(batch->ulb_grp_priv,
+						       batch->ulb_ctx->cc_idx,
+						       ulp->ulp_rank,
+						       ulp->ulp_tag, uri);
+			if (ulp_rc != 0)
+				D_ERROR("crt_grp_lc_uri_insert() failed, "
+					"rc %d\n", ulp_rc);
+		}
+		if (ulp->ulp_cb != NULL)
+			ulp->ulp_cb(ulp_rc == 0 ? uri : NULL, ulp_rc,
+				    ulp->ulp_arg);
+		D_FREE_PTR(ulp);
 	}
 
-	/* convert the requested rank to global rank */
-	g_rank = grp_priv->gp_membs->rl_ranks[ul_in->ul_rank];
+	if (req->ubr_bulk != CRT_BULK_NULL)
+		crt_bulk_free(req->ubr_bulk);
+	D_FREE(req->ubr_buf);
+	D_FREE(req->ubr_pairs);
+	D_FREE_PTR(req);
+}
+
+static void crt_ul_batch_send(struct crt_ul_batch *batch);
+
+static void
+crt_ul_batch_cb(const struct crt_cb_info *cb_info)
+{
+	struct crt_ul_batch_req		*req = cb_info->cci_arg;
+	struct crt_ul_batch		*batch = req->ubr_batch;
+	struct crt_uri_lookup_batch_out	*ulb_out;
+	const char			*uris = NULL;
+	size_t				 len = 0;
+	int				 rc = cb_info->cci_rc;
 
-	/* step 1, lookup the URI in the local cache */
-	rc = crt_grp_lc_lookup(default_grp_priv, crt_ctx->cc_idx, g_rank,
-			       ul_in->ul_tag, &cached_uri, NULL);
 	if (rc != 0) {
-		D_ERROR("crt_grp_lc_lookup(grp %s, rank %d, tag %d) failed, "
-			"rc: %d.\n", default_grp_priv->gp_pub.cg_grpid,
-			g_rank, ul_in->ul_tag, rc);
+		D_ERROR("batched URI_LOOKUP to group %s failed, rc: %d.\n",
+			batch->ulb_grp_priv->gp_pub.cg_grpid, rc);
 		D_GOTO(out, rc);
 	}
-	ul_out->ul_uri = cached_uri;
-	if (ul_out->ul_uri != NULL)
+	ulb_out = crt_reply_get(cb_info->cci_rpc);
+	rc = ulb_out->ulb_rc;
+	if (rc != 0) {
+		D_ERROR("batched URI_LOOKUP to group %s failed on PSR, "
+			"rc: %d.\n", batch->ulb_grp_priv->gp_pub.cg_grpid, rc);
 		D_GOTO(out, rc);
+	}
+	len = ulb_out->ulb_len;
+	if (req->ubr_buf != NULL) {
+		uris = req->ubr_buf;
+		if (len > req->ubr_nr * CRT_ADDR_STR_MAX_LEN)
+			rc = -DER_PROTO;
+	} else {
+		uris = ulb_out->ulb_uris.iov_buf;
+		if (len > ulb_out->ulb_uris.iov_len)
+			rc = -DER_PROTO;
+	}
 
-	/**
-	 * step 2, make sure URI of tag 0 is in cache in preparation to forward
-	 * the lookup RPC
-	 */
-	if (ul_in->ul_tag != 0) {
-		/* tag != 0, check if tag 0 is in cache */
-		rc = crt_grp_lc_lookup(default_grp_priv, crt_ctx->cc_idx,
-				       g_rank, 0, &cached_uri, NULL);
+out:
+	crt_ul_batch_req_complete(req, uris, len, rc);
+	crt_ul_batch_send(batch);
+}
+
+static int
+crt_ul_batch_req_send(struct crt_ul_batch_req *req)
+{
+	struct crt_ul_batch		*batch = req->ubr_batch;
+	struct crt_grp_priv		*grp_priv = batch->ulb_grp_priv;
+	struct crt_uri_lookup_batch_in	*ulb_in;
+	struct crt_ul_pending		*ulp;
+	crt_endpoint_t			 psr_ep = {0};
+	crt_rpc_t			*rpc;
+	d_sg_list_t			 sgl;
+	d_iov_t				 iov;
+	uint32_t			 i = 0;
+	int				 rc;
+
+	D_ALLOC_ARRAY(req->ubr_pairs, req->ubr_nr);
+	if (req->ubr_pairs == NULL)
+		return -DER_NOMEM;
+	d_list_for_each_entry(ulp, &req->ubr_list, ulp_link) {
+		req->ubr_pairs[i].uip_rank = ulp->ulp_rank;
+		req->ubr_pairs[i].uip_tag = ulp->ulp_tag;
+		i++;
+	}
+
+	if (req->ubr_nr > CRT_UL_BATCH_INLINE_NR) {
+		D_ALLOC(req->ubr_buf, req->ubr_nr * CRT_ADDR_STR_MAX_LEN);
+		if (req->ubr_buf == NULL)
+			return -DER_NOMEM;
+		d_iov_set(&iov, req->ubr_buf,
+			  req->ubr_nr * CRT_ADDR_STR_MAX_LEN);
+		sgl.sg_nr = 1;
+		sgl.sg_nr_out = 0;
+		sgl.sg_iovs = &iov;
+		rc = crt_bulk_create(batch->ulb_ctx, &sgl, CRT_BULK_RW,
+				     &req->ubr_bulk);
 		if (rc != 0) {
-			D_ERROR("crt_grp_lc_lookup(grp %s, rank %d, tag %d) "
-				"failed, rc: %d.\n",
-				default_grp_priv->gp_pub.cg_grpid,
-				g_rank, 0, rc);
-			D_GOTO(out, rc);
+			D_ERROR("crt_bulk_create failed, rc: %d.\n", rc);
+			return rc;
 		}
 	}
-	ul_out->ul_uri = cached_uri;
 
-	if (cached_uri == NULL) {
-		/* tag 0 URI not in cache, resort to PMIx */
-		rc = crt_pmix_uri_lookup(default_grp_priv->gp_pub.cg_grpid,
-					 g_rank, &tmp_uri);
-		if (rc != 0) {
-			D_ERROR("crt_pmix_uri_lookup() failed, rc %d\n", rc);
-			D_GOTO(out, rc);
-		}
-		rc = crt_grp_lc_uri_insert(default_grp_priv, crt_ctx->cc_idx,
-				g_rank, 0, tmp_uri);
-		if (rc != 0) {
-			D_ERROR("crt_grp_lc_uri_insert() failed, rc %d\n", rc);
-			D_GOTO(out, rc);
-		}
+	psr_ep.ep_grp = &grp_priv->gp_pub;
+	D_RWLOCK_RDLOCK(&grp_priv->gp_rwlock);
+	psr_ep.ep_rank = grp_priv->gp_psr_rank;
+	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
+	rc = crt_req_create(batch->ulb_ctx, &psr_ep, CRT_OPC_URI_LOOKUP_BATCH,
+			    &rpc);
+	if (rc != 0) {
+		D_ERROR("crt_req_create URI_LOOKUP_BATCH failed, rc: %d.\n",
+			rc);
+		return rc;
+	}
+	ulb_in = crt_req_get(rpc);
+	ulb_in->ulb_grp_id = grp_priv->gp_pub.cg_grpid;
+	d_iov_set(&ulb_in->ulb_pairs, req->ubr_pairs,
+		  req->ubr_nr * sizeof(*req->ubr_pairs));
+	ulb_in->ulb_bulk = req->ubr_bulk;
 
-		ul_out->ul_uri = tmp_uri;
+	D_DEBUG(DB_NET, "batched URI_LOOKUP of %u ranks to group %s PSR %d.\n",
+		req->ubr_nr, grp_priv->gp_pub.cg_grpid, psr_ep.ep_rank);
+	/* failures are reported through crt_ul_batch_cb() */
+	return crt_req_send(rpc, crt_ul_batch_cb, req);
+}
+
+/* send pending lookups of batch until one RPC is in flight or none is left */
+static void
+crt_ul_batch_send(struct crt_ul_batch *batch)
+{
+	struct crt_ul_batch_req	*req;
+	int			 rc;
+
+	while ((req = crt_ul_batch_next(batch)) != NULL) {
+		rc = crt_ul_batch_req_send(req);
+		if (rc == 0)
+			break;
+		crt_ul_batch_req_complete(req, NULL, 0, rc);
 	}
-	/* tag 0 uri in cache now */
+}
 
-	if (ul_in->ul_tag == 0) {
-		/* we are done at this point */
-		D_GOTO(out, rc);
+/*
+ * Look up the URI of (rank, tag) of an attached group through its PSR. The
+ * lookups of a context to a group are coalesced, while one batched URI_LOOKUP
+ * is in flight the following ones queue up and go out together in the next
+ * one. The URI is inserted into the lookup cache before cb is called, cb gets
+ * a NULL uri if the PSR does not know it without forwarding.
+ */
+int
+crt_grp_uri_lookup(struct crt_context *ctx, struct crt_grp_priv *grp_priv,
+		   d_rank_t rank, uint32_t tag, crt_grp_ul_cb_t cb, void *arg)
+{
+	struct crt_ul_batch	*batch;
+	struct crt_ul_batch	*new_batch;
+	struct crt_ul_pending	*ulp;
+	bool			 send = false;
+
+	D_ASSERT(grp_priv->gp_local == 0);
+
+	D_ALLOC_PTR(ulp);
+	if (ulp == NULL)
+		return -DER_NOMEM;
+	ulp->ulp_rank = rank;
+	ulp->ulp_tag = tag;
+	ulp->ulp_cb = cb;
+	ulp->ulp_arg = arg;
+	D_ALLOC_PTR(new_batch);
+	if (new_batch == NULL) {
+		D_FREE_PTR(ulp);
+		return -DER_NOMEM;
+	}
+
+	D_MUTEX_LOCK(&ctx->cc_mutex);
+	d_list_for_each_entry(batch, &ctx->cc_ul_batches, ulb_link) {
+		if (batch->ulb_grp_priv == grp_priv)
+			break;
+	}
+	if (&batch->ulb_link == &ctx->cc_ul_batches) {
+		batch = new_batch;
+		new_batch = NULL;
+		batch->ulb_ctx = ctx;
+		batch->ulb_grp_priv = grp_priv;
+		D_INIT_LIST_HEAD(&batch->ulb_pending);
+		d_list_add_tail(&batch->ulb_link, &ctx->cc_ul_batches);
+	}
+	d_list_add_tail(&ulp->ulp_link, &batch->ulb_pending);
+	if (!batch->ulb_inflight) {
+		batch->ulb_inflight = 1;
+		send = true;
 	}
+	D_MUTEX_UNLOCK(&ctx->cc_mutex);
 
-	/* step 3, forward the requst to the final target */
-	rc = crt_uri_lookup_forward(rpc_req, g_rank);
-	if (rc != 0)
-		D_ERROR("crt_uri_lookup_forward() failed, rc %d\n", rc);
+	D_FREE(new_batch);
+	if (send)
+		crt_ul_batch_send(batch);
 
-	if (should_decref)
-		crt_grp_priv_decref(grp_priv);
-	return;
+	return 0;
+}
 
-out:
-	if (should_decref)
-		crt_grp_priv_decref(grp_priv);
-	ul_out->ul_rc = rc;
-	rc = crt_reply_send(rpc_req);
-	if (rc != 0)
-		D_ERROR("crt_reply_send failed, rc: %d, opc: %#x.\n",
-			rc, rpc_req->cr_opc);
-	if (tmp_uri != NULL)
-		free(tmp_uri);
+/*
+ * Withdraw the lookup queued by crt_grp_uri_lookup() with arg, its callback is
+ * not called anymore. Returns false if the callback already runs or ran.
+ */
+bool
+crt_grp_uri_lookup_cancel(struct crt_context *ctx,
+			  struct crt_grp_priv *grp_priv, void *arg)
+{
+	struct crt_ul_batch	*batch;
+	struct crt_ul_pending	*ulp;
+	struct crt_ul_pending	*found = NULL;
+	bool			 cancelled = false;
+
+	D_MUTEX_LOCK(&ctx->cc_mutex);
+	d_list_for_each_entry(batch, &ctx->cc_ul_batches, ulb_link) {
+		if (batch->ulb_grp_priv != grp_priv)
+			continue;
+		/* not sent yet */
+		d_list_for_each_entry(ulp, &batch->ulb_pending, ulp_link) {
+			if (ulp->ulp_arg == arg) {
+				d_list_del(&ulp->ulp_link);
+				found = ulp;
+				cancelled = true;
+				break;
+			}
+		}
+		if (cancelled || batch->ulb_req == NULL)
+			break;
+		/* in flight, the reply still has its slot */
+		d_list_for_each_entry(ulp, &batch->ulb_req->ubr_list,
+				      ulp_link) {
+			if (ulp->ulp_arg == arg && ulp->ulp_cb != NULL) {
+				ulp->ulp_cb = NULL;
+				cancelled = true;
+				break;
+			}
+		}
+		break;
+	}
+	D_MUTEX_UNLOCK(&ctx->cc_mutex);
+
+	D_FREE(found);
+	return cancelled;
 }
 
 /*
@@ -2192,7 +3285,6 @@ int
 crt_grp_attach(crt_group_id_t srv_grpid, crt_group_t **attached_grp)
 {
 	struct crt_grp_priv	*grp_priv = NULL;
-	struct crt_context	*crt_ctx = NULL;
 	int			 rc = 0;
 
 	D_ASSERT(srv_grpid != NULL);
@@ -2210,7 +3302,7 @@ crt_grp_attach(crt_group_id_t srv_grpid, crt_group_t **attached_grp)
 	grp_priv->gp_local = 0;
 	grp_priv->gp_service = 1;
 
-	if (crt_is_singleton()) {
+	if (crt_is_singleton() || crt_is_bootstrap()) {
 		rc = crt_grp_config_load(grp_priv);
 		if (rc != 0) {
 			D_ERROR("crt_grp_config_load (grpid %s) failed, "
@@ -2226,21 +3318,13 @@ crt_grp_attach(crt_group_id_t srv_grpid, crt_group_t **attached_grp)
 		}
 	}
 
-	rc = crt_grp_lc_create(grp_priv);
+	/* insert PSR's base uri into the lookup cache */
+	rc = crt_grp_lc_uri_insert(grp_priv, 0, grp_priv->gp_psr_rank, 0,
+				   grp_priv->gp_psr_phy_addr);
 	if (rc != 0) {
-		D_ERROR("crt_grp_lc_create failed, rc: %d.\n", rc);
+		D_ERROR("crt_grp_lc_uri_insert() failed, rc %d\n", rc);
 		D_GOTO(out, rc);
 	}
-	/* insert PSR's base uri into hash table */
-	d_list_for_each_entry(crt_ctx, &crt_gdata.cg_ctx_list, cc_link) {
-		rc = crt_grp_lc_uri_insert(grp_priv, crt_ctx->cc_idx,
-					   grp_priv->gp_psr_rank, 0,
-					   grp_priv->gp_psr_phy_addr);
-		if (rc != 0) {
-			D_ERROR("crt_grp_lc_uri_insert() failed, rc %d\n", rc);
-			D_GOTO(out, rc);
-		}
-	}
 
 	rc = crt_grp_ras_init(grp_priv);
 	if (rc != 0) {
@@ -2474,6 +3558,20 @@ crt_grp_attach_info_filename(struct crt_grp_priv *grp_priv)
 	return filename;
 }
 
+static inline char *
+crt_grp_attach_info_bin_filename(struct crt_grp_priv *grp_priv)
+{
+	crt_group_id_t	 grpid;
+	char		*filename;
+
+	D_ASSERT(grp_priv != NULL);
+	grpid = grp_priv->gp_pub.cg_grpid;
+
+	D_ASPRINTF(filename, "%s/%s.attach_info_bin", crt_attach_prefix, grpid);
+
+	return filename;
+}
+
 static inline FILE *
 open_tmp_attach_info_file(char **filename)
 {
@@ -2497,48 +3595,368 @@ open_tmp_attach_info_file(char **filename)
 			*filename, strerror(errno));
 		return NULL;
 	}
-
-	tmp_file = fdopen(tmp_fd, "w");
-	if (tmp_file == NULL) {
-		D_ERROR("fdopen() failed on %s, error: %s\n",
-			*filename, strerror(errno));
-		close(tmp_fd);
+
+	tmp_file = fdopen(tmp_fd, "w");
+	if (tmp_file == NULL) {
+		D_ERROR("fdopen() failed on %s, error: %s\n",
+			*filename, strerror(errno));
+		close(tmp_fd);
+	}
+
+	return tmp_file;
+}
+
+int
+crt_group_config_path_set(const char *path)
+{
+	struct stat buf;
+	int rc;
+
+	if (path == NULL) {
+		D_ERROR("path can't be NULL");
+		return -DER_INVAL;
+	}
+
+	if (strlen(path) >= CRT_MAX_ATTACH_PREFIX) {
+		D_ERROR("specified path must be fewer than %d characters",
+			CRT_MAX_ATTACH_PREFIX);
+		return -DER_INVAL;
+	}
+
+	rc = stat(path, &buf);
+	if (rc != 0) {
+		D_ERROR("bad path specified: %s", path);
+		return d_errno2der(errno);
+	}
+
+	if (!S_ISDIR(buf.st_mode)) {
+		D_ERROR("not a directory: %s", path);
+		return -DER_NOTDIR;
+	}
+
+	strncpy(crt_attach_prefix, path, CRT_MAX_ATTACH_PREFIX-1);
+
+	return 0;
+}
+
+/*
+ * Build the binary attach info image of group grpid. uris holds the URI of
+ * each rank when forall is set, otherwise only the URI of rank self. The
+ * returned buffer is freed by the caller.
+ */
+int
+crt_attach_info_pack(crt_group_id_t grpid, uint32_t size, d_rank_t self,
+		     bool forall, char **uris, void **buf, size_t *len)
+{
+	struct crt_attach_info_hdr	*hdr;
+	uint32_t			*offs;
+	char				*pool;
+	uint64_t			 pool_len = 0;
+	uint64_t			 total;
+	uint32_t			 nr;
+	uint32_t			 i;
+	size_t				 uri_len;
+
+	D_ASSERT(grpid != NULL && uris != NULL);
+	D_ASSERT(buf != NULL && len != NULL);
+	if (size == 0 || strlen(grpid) > CRT_GROUP_ID_MAX_LEN)
+		return -DER_INVAL;
+
+	nr = forall ? size : 1;
+	for (i = 0; i < nr; i++) {
+		if (uris[i] != NULL)
+			pool_len += strlen(uris[i]) + 1;
+	}
+	if (pool_len >= CRT_AI_NO_URI)
+		return -DER_OVERFLOW;
+
+	total = sizeof(*hdr) + (uint64_t)nr * sizeof(*offs) + pool_len;
+	D_ALLOC(hdr, total);
+	if (hdr == NULL)
+		return -DER_NOMEM;
+
+	hdr->ahi_magic = CRT_AI_MAGIC;
+	hdr->ahi_version = CRT_AI_VERSION;
+	hdr->ahi_len = total;
+	hdr->ahi_size = size;
+	hdr->ahi_nr = nr;
+	hdr->ahi_self = forall ? CRT_AI_NO_URI : self;
+	hdr->ahi_flags = forall ? CRT_AIF_ALL : 0;
+	strncpy(hdr->ahi_grpid, grpid, CRT_GROUP_ID_MAX_LEN);
+
+	offs = (uint32_t *)(hdr + 1);
+	pool = (char *)(offs + nr);
+	pool_len = 0;
+	for (i = 0; i < nr; i++) {
+		if (uris[i] == NULL) {
+			offs[i] = CRT_AI_NO_URI;
+			continue;
+		}
+		uri_len = strlen(uris[i]) + 1;
+		memcpy(pool + pool_len, uris[i], uri_len);
+		offs[i] = pool_len;
+		pool_len += uri_len;
+	}
+
+	*buf = hdr;
+	*len = total;
+	return 0;
+}
+
+/*
+ * Validate the binary attach info image at buf, of len bytes, against the
+ * group grpid. On success *hdr points into buf.
+ */
+int
+crt_attach_info_unpack(void *buf, size_t len, crt_group_id_t grpid,
+		       struct crt_attach_info_hdr **hdr)
+{
+	struct crt_attach_info_hdr	*ahi = buf;
+
+	D_ASSERT(buf != NULL && grpid != NULL && hdr != NULL);
+
+	if (len < sizeof(*ahi) || ahi->ahi_magic != CRT_AI_MAGIC) {
+		D_DEBUG(DB_TRACE, "not a binary attach info image.\n");
+		return -DER_INVAL;
+	}
+	if (ahi->ahi_version != CRT_AI_VERSION) {
+		D_DEBUG(DB_TRACE, "unsupported attach info version %d.\n",
+			ahi->ahi_version);
+		return -DER_INVAL;
+	}
+	if (ahi->ahi_len != len || ahi->ahi_size == 0 ||
+	    ahi->ahi_nr != ((ahi->ahi_flags & CRT_AIF_ALL) ?
+			    ahi->ahi_size : 1) ||
+	    (uint64_t)ahi->ahi_nr * sizeof(uint32_t) > len - sizeof(*ahi)) {
+		D_ERROR("corrupted attach info image (len %zu/"DF_U64
+			", size %d, nr %d).\n", len, ahi->ahi_len,
+			ahi->ahi_size, ahi->ahi_nr);
+		return -DER_INVAL;
+	}
+	if (ahi->ahi_grpid[CRT_GROUP_ID_MAX_LEN] != '\0' ||
+	    strncmp(ahi->ahi_grpid, grpid, CRT_GROUP_ID_MAX_LEN) != 0) {
+		D_ERROR("grpname %.*s in file mismatch with grpid %s.\n",
+			CRT_GROUP_ID_MAX_LEN, ahi->ahi_grpid, grpid);
+		return -DER_INVAL;
+	}
+
+	*hdr = ahi;
+	return 0;
+}
+
+/*
+ * Look up the URI of rank in an image validated by crt_attach_info_unpack().
+ * An image saved for a single rank returns that rank's URI whatever rank
+ * asked for, *uri_rank tells which one it is.
+ */
+int
+crt_attach_info_uri(struct crt_attach_info_hdr *hdr, d_rank_t rank,
+		    d_rank_t *uri_rank, const char **uri)
+{
+	uint32_t	*offs;
+	const char	*pool;
+	uint64_t	 pool_len;
+	uint32_t	 idx;
+
+	D_ASSERT(hdr != NULL && uri_rank != NULL && uri != NULL);
+
+	if (hdr->ahi_flags & CRT_AIF_ALL) {
+		if (rank >= hdr->ahi_size)
+			return -DER_INVAL;
+		idx = rank;
+		*uri_rank = rank;
+	} else {
+		idx = 0;
+		*uri_rank = hdr->ahi_self;
+	}
+
+	offs = (uint32_t *)(hdr + 1);
+	pool = (const char *)(offs + hdr->ahi_nr);
+	pool_len = hdr->ahi_len - sizeof(*hdr) -
+		   (uint64_t)hdr->ahi_nr * sizeof(*offs);
+	if (offs[idx] == CRT_AI_NO_URI)
+		return -DER_NONEXIST;
+	if (offs[idx] >= pool_len ||
+	    memchr(pool + offs[idx], '\0', pool_len - offs[idx]) == NULL) {
+		D_ERROR("corrupted attach info image (rank %d, offset %d).\n",
+			*uri_rank, offs[idx]);
+		return -DER_INVAL;
+	}
+
+	*uri = pool + offs[idx];
+	return 0;
+}
+
+/*
+ * Write the binary attach info file of grp_priv, through a temporary file
+ * renamed into place so that readers never see a partial image.
+ */
+static int
+crt_grp_attach_info_bin_save(struct crt_grp_priv *grp_priv, d_rank_t self,
+			     bool forall, char **uris)
+{
+	FILE	*fp = NULL;
+	char	*filename = NULL;
+	char	*tmp_name = NULL;
+	void	*buf = NULL;
+	size_t	 len;
+	int	 rc;
+
+	rc = crt_attach_info_pack(grp_priv->gp_pub.cg_grpid, grp_priv->gp_size,
+				  self, forall, uris, &buf, &len);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	filename = crt_grp_attach_info_bin_filename(grp_priv);
+	if (filename == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	fp = open_tmp_attach_info_file(&tmp_name);
+	if (fp == NULL) {
+		D_ERROR("cannot create temp file.\n");
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
+	D_ASSERT(tmp_name != NULL);
+	if (fwrite(buf, len, 1, fp) != 1) {
+		D_ERROR("write to file %s failed (%s).\n",
+			tmp_name, strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
+	rc = fclose(fp);
+	fp = NULL;
+	if (rc != 0) {
+		D_ERROR("file %s closing failed (%s).\n",
+			tmp_name, strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
 	}
 
-	return tmp_file;
+	rc = rename(tmp_name, filename);
+	if (rc != 0) {
+		D_ERROR("Failed to rename %s to %s (%s).\n",
+			tmp_name, filename, strerror(errno));
+		rc = d_errno2der(errno);
+	}
+out:
+	if (fp != NULL)
+		fclose(fp);
+	if (tmp_name != NULL) {
+		if (rc != 0)
+			unlink(tmp_name);
+		D_FREE(tmp_name);
+	}
+	/* don't leave a stale image behind to shadow the text file */
+	if (rc != 0 && filename != NULL)
+		unlink(filename);
+	free(filename);
+	D_FREE(buf);
+	return rc;
 }
 
+/*
+ * Write the attach info of grp_priv, in the text format and, if possible, in
+ * the binary format. uris holds the URI of each rank when forall is set,
+ * otherwise only the URI of rank.
+ */
 int
-crt_group_config_path_set(const char *path)
+crt_grp_attach_info_save(struct crt_grp_priv *grp_priv, d_rank_t rank,
+			 bool forall, char **uris)
 {
-	struct stat buf;
-	int rc;
+	FILE			*fp = NULL;
+	char			*filename = NULL;
+	char			*bin_name = NULL;
+	char			*tmp_name = NULL;
+	crt_group_id_t		 grpid;
+	d_rank_t		 i;
+	int			 rc = 0;
 
-	if (path == NULL) {
-		D_ERROR("path can't be NULL");
-		return -DER_INVAL;
+	grpid = grp_priv->gp_pub.cg_grpid;
+	filename = crt_grp_attach_info_filename(grp_priv);
+	if (filename == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	bin_name = crt_grp_attach_info_bin_filename(grp_priv);
+	if (bin_name == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	fp = open_tmp_attach_info_file(&tmp_name);
+	if (fp == NULL) {
+		D_ERROR("cannot create temp file.\n");
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
+	D_ASSERT(tmp_name != NULL);
+	rc = fprintf(fp, "%s %s\n", "name", grpid);
+	if (rc < 0) {
+		D_ERROR("write to file %s failed (%s).\n",
+			tmp_name, strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
+	rc = fprintf(fp, "%s %d\n", "size", grp_priv->gp_size);
+	if (rc < 0) {
+		D_ERROR("write to file %s failed (%s).\n",
+			tmp_name, strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
+	if (forall)
+		rc = fprintf(fp, "all\n");
+	else
+		rc = fprintf(fp, "self\n");
+	if (rc < 0) {
+		D_ERROR("write to file %s failed (%s).\n",
+			tmp_name, strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
 	}
 
-	if (strlen(path) >= CRT_MAX_ATTACH_PREFIX) {
-		D_ERROR("specified path must be fewer than %d characters",
-			CRT_MAX_ATTACH_PREFIX);
-		return -DER_INVAL;
+	for (i = 0; i < (forall ? grp_priv->gp_size : 1); i++) {
+		rc = fprintf(fp, "%d %s\n", forall ? i : rank, uris[i]);
+		if (rc < 0) {
+			D_ERROR("write to file %s failed (%s).\n",
+				tmp_name, strerror(errno));
+			D_GOTO(out, rc = d_errno2der(errno));
+		}
 	}
 
-	rc = stat(path, &buf);
-	if (rc != 0) {
-		D_ERROR("bad path specified: %s", path);
-		return d_errno2der(errno);
+	if (fclose(fp) != 0) {
+		D_ERROR("file %s closing failed (%s).\n",
+			tmp_name, strerror(errno));
+		fp = NULL;
+		D_GOTO(out, rc = d_errno2der(errno));
 	}
+	fp = NULL;
 
-	if (!S_ISDIR(buf.st_mode)) {
-		D_ERROR("not a directory: %s", path);
-		return -DER_NOTDIR;
+	/*
+	 * readers prefer the binary file, drop the previous one first so that
+	 * it never shadows the new text file
+	 */
+	if (unlink(bin_name) != 0 && errno != ENOENT) {
+		D_ERROR("Failed to remove %s (%s).\n", bin_name,
+			strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
 	}
 
-	strncpy(crt_attach_prefix, path, CRT_MAX_ATTACH_PREFIX-1);
+	rc = rename(tmp_name, filename);
+	if (rc != 0) {
+		D_ERROR("Failed to rename %s to %s (%s).\n",
+			tmp_name, filename, strerror(errno));
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
 
-	return 0;
+	/* the binary format is optional, readers fall back to the text file */
+	rc = crt_grp_attach_info_bin_save(grp_priv, rank, forall, uris);
+	if (rc != 0) {
+		D_ERROR("saving binary attach info of grp %s failed, rc: %d.\n",
+			grpid, rc);
+		rc = 0;
+	}
+out:
+	free(filename);
+	free(bin_name);
+	if (tmp_name != NULL) {
+		if (rc != 0)
+			unlink(tmp_name);
+		D_FREE(tmp_name);
+	}
+	if (fp != NULL)
+		fclose(fp);
+	return rc;
 }
 
 /**
@@ -2559,18 +3977,21 @@ crt_group_config_path_set(const char *path)
  * self
  * 4 tcp://192.168.0.1:1234
  * ========================
+ *
+ * The same information is also saved in the binary format described in
+ * crt_group.h to "<singleton_attach_path>/grpid.attach_info_bin", which is
+ * what attaching clients read first.
  */
 int
 crt_group_config_save(crt_group_t *grp, bool forall)
 {
 	struct crt_grp_priv	*grp_priv;
-	FILE			*fp = NULL;
-	char			*filename = NULL;
-	char			*tmp_name = NULL;
 	crt_group_id_t		 grpid;
 	d_rank_t		 rank;
 	crt_phy_addr_t		 addr = NULL;
 	bool			 addr_free = false;
+	char			**uris = NULL;
+	uint32_t		 uri_nr = 0;
 	int			 rc = 0;
 
 
@@ -2599,100 +4020,120 @@ crt_group_config_save(crt_group_t *grp, bool forall)
 			addr_free = true;
 	}
 
+	if (!forall || grp_priv->gp_size == 1) {
+		rc = crt_grp_attach_info_save(grp_priv, rank, false, &addr);
+		D_GOTO(out, rc);
+	}
+
 	grpid = grp_priv->gp_pub.cg_grpid;
-	filename = crt_grp_attach_info_filename(grp_priv);
-	if (filename == NULL)
+	D_ALLOC_ARRAY(uris, grp_priv->gp_size);
+	if (uris == NULL)
 		D_GOTO(out, rc = -DER_NOMEM);
+	uri_nr = grp_priv->gp_size;
 
-	fp = open_tmp_attach_info_file(&tmp_name);
-	if (fp == NULL) {
-		D_ERROR("cannot create temp file.\n");
-		D_GOTO(out, rc = d_errno2der(errno));
+	for (rank = 0; rank < grp_priv->gp_size; rank++) {
+		rc = crt_pmix_uri_lookup(grpid, rank, &uris[rank]);
+		if (rc != 0) {
+			D_ERROR("crt_pmix_uri_lookup(grp %s, rank %d), failed "
+				"rc: %d.\n", grpid, rank, rc);
+			D_GOTO(out, rc);
+		}
+		D_ASSERT(uris[rank] != NULL);
 	}
-	D_ASSERT(tmp_name != NULL);
-	rc = fprintf(fp, "%s %s\n", "name", grpid);
-	if (rc < 0) {
-		D_ERROR("write to file %s failed (%s).\n",
-			tmp_name, strerror(errno));
+
+	rc = crt_grp_attach_info_save(grp_priv, 0, true, uris);
+
+out:
+	if (addr_free)
+		D_FREE(addr);
+	for (rank = 0; rank < uri_nr; rank++)
+		free(uris[rank]);
+	D_FREE(uris);
+	return rc;
+}
+
+/*
+ * Load psr from the binary attach info file, mmap()ed so that only the pages
+ * holding the header and the psr's entry are read.
+ * Returns -DER_NONEXIST when there is no such file.
+ */
+static int
+crt_grp_attach_info_bin_load(struct crt_grp_priv *grp_priv, d_rank_t psr_rank)
+{
+	struct crt_attach_info_hdr	*hdr;
+	struct stat			 st;
+	char				*filename = NULL;
+	void				*buf = MAP_FAILED;
+	const char			*uri;
+	crt_phy_addr_t			 addr_str = NULL;
+	d_rank_t			 rank;
+	int				 fd = -1;
+	int				 rc;
+
+	filename = crt_grp_attach_info_bin_filename(grp_priv);
+	if (filename == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		D_DEBUG(DB_TRACE, "open file %s failed (%s).\n",
+			filename, strerror(errno));
 		D_GOTO(out, rc = d_errno2der(errno));
 	}
-	rc = fprintf(fp, "%s %d\n", "size", grp_priv->gp_size);
-	if (rc < 0) {
-		D_ERROR("write to file %s failed (%s).\n",
-			tmp_name, strerror(errno));
+	if (fstat(fd, &st) != 0) {
+		D_ERROR("stat file %s failed (%s).\n",
+			filename, strerror(errno));
 		D_GOTO(out, rc = d_errno2der(errno));
 	}
-	if (forall)
-		rc = fprintf(fp, "all\n");
-	else
-		rc = fprintf(fp, "self\n");
-	if (rc < 0) {
-		D_ERROR("write to file %s failed (%s).\n",
-			tmp_name, strerror(errno));
+	if (st.st_size < (off_t)sizeof(*hdr))
+		D_GOTO(out, rc = -DER_INVAL);
+
+	buf = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (buf == MAP_FAILED) {
+		D_ERROR("mmap file %s failed (%s).\n",
+			filename, strerror(errno));
 		D_GOTO(out, rc = d_errno2der(errno));
 	}
 
-	if (!forall || grp_priv->gp_size == 1) {
-		rc = fprintf(fp, "%d %s\n", rank, addr);
-		if (rc < 0) {
-			D_ERROR("write to file %s failed (%s).\n",
-				tmp_name, strerror(errno));
-			D_GOTO(out, rc = d_errno2der(errno));
-		}
-		D_GOTO(done, rc);
+	rc = crt_attach_info_unpack(buf, st.st_size, grp_priv->gp_pub.cg_grpid,
+				    &hdr);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	if (psr_rank == -1) {
+		crt_group_rank(NULL, &rank);
+		psr_rank = rank % hdr->ahi_size;
+	} else if (psr_rank >= hdr->ahi_size) {
+		D_ERROR("invalid parameter (psr %d, gp_size %d).\n",
+			psr_rank, hdr->ahi_size);
+		D_GOTO(out, rc = -DER_INVAL);
 	}
 
-	for (rank = 0; rank < grp_priv->gp_size; rank++) {
-		char *uri;
+	rc = crt_attach_info_uri(hdr, psr_rank, &rank, &uri);
+	if (rc != 0)
+		D_GOTO(out, rc);
 
-		uri = NULL;
-		rc = crt_pmix_uri_lookup(grpid, rank, &uri);
-		if (rc != 0) {
-			D_ERROR("crt_pmix_uri_lookup(grp %s, rank %d), failed "
-				"rc: %d.\n", grpid, rank, rc);
-			D_GOTO(out, rc);
-		}
-		D_ASSERT(uri != NULL);
-		rc = fprintf(fp, "%d %s\n", rank, uri);
-		free(uri);
-		if (rc < 0) {
-			D_ERROR("write to file %s failed (%s).\n",
-				tmp_name, strerror(errno));
-			D_GOTO(out, rc = d_errno2der(errno));
-		}
-	}
+	D_STRNDUP(addr_str, uri, CRT_ADDR_STR_MAX_LEN);
+	if (addr_str == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
 
-done:
-	if (fclose(fp) != 0) {
-		D_ERROR("file %s closing failed (%s).\n",
-			tmp_name, strerror(errno));
-		fp = NULL;
-		D_GOTO(out, rc = d_errno2der(errno));
-	}
-	fp = NULL;
+	grp_priv->gp_size = hdr->ahi_size;
+	D_DEBUG(DB_TRACE, "grp %s selected psr_rank %d, uri %s.\n",
+		grp_priv->gp_pub.cg_grpid, rank, addr_str);
+	crt_grp_psr_set(grp_priv, rank, addr_str);
 
-	rc = rename(tmp_name, filename);
-	if (rc != 0) {
-		D_ERROR("Failed to rename %s to %s (%s).\n",
-			tmp_name, filename, strerror(errno));
-		rc = d_errno2der(errno);
-	}
 out:
+	if (buf != MAP_FAILED)
+		munmap(buf, st.st_size);
+	if (fd != -1)
+		close(fd);
 	free(filename);
-	if (tmp_name != NULL) {
-		if (rc != 0)
-			unlink(tmp_name);
-		D_FREE(tmp_name);
-	}
-	if (fp != NULL)
-		fclose(fp);
-	if (addr_free)
-		D_FREE(addr);
 	return rc;
 }
 
 /*
- * Load psr from singleton config file.
+ * Load psr from singleton config file, the binary one if it is there and
+ * usable, else the text one.
  * If psr_rank set as "-1", will mod the group rank with group size as psr rank.
  */
 int
@@ -2712,6 +4153,14 @@ crt_grp_config_psr_load(struct crt_grp_priv *grp_priv, d_rank_t psr_rank)
 	D_ASSERT(grp_priv != NULL);
 
 	grpid = grp_priv->gp_pub.cg_grpid;
+	rc = crt_grp_attach_info_bin_load(grp_priv, psr_rank);
+	if (rc == 0)
+		D_GOTO(out, rc);
+	if (rc == -DER_NOMEM)
+		D_GOTO(out, rc);
+	D_DEBUG(DB_TRACE, "grp %s, no usable binary attach info (rc %d), "
+		"falling back to the text file.\n", grpid, rc);
+
 	filename = crt_grp_attach_info_filename(grp_priv);
 	if (filename == NULL)
 		D_GOTO(out, rc = -DER_NOMEM);
@@ -2833,69 +4282,25 @@ out:
 }
 
 /*
- * mark rank as evicted in every crt_context's address lookup cache.
+ * mark rank as evicted in the address lookup cache.
  */
 static int
 crt_grp_lc_mark_evicted(struct crt_grp_priv *grp_priv, d_rank_t rank)
 {
-	int				 ctx_idx;
-	d_list_t			*rlink;
 	struct crt_lookup_item		*li;
-	struct d_hash_table		*htable;
-	int				 rc = 0;
 
 	D_ASSERT(grp_priv != NULL);
 	D_ASSERT(rank < grp_priv->gp_size);
 
-	for (ctx_idx = 0; ctx_idx < CRT_SRV_CONTEXT_NUM; ctx_idx++) {
-		htable = grp_priv->gp_lookup_cache[ctx_idx];
-		D_RWLOCK_RDLOCK(&grp_priv->gp_rwlock);
-		rlink = d_hash_rec_find(htable, &rank, sizeof(rank));
-		if (rlink == NULL) {
-			D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
-			D_ALLOC_PTR(li);
-			if (li == NULL)
-				D_GOTO(out, rc = -DER_NOMEM);
-			D_INIT_LIST_HEAD(&li->li_link);
-			li->li_grp_priv = grp_priv;
-			li->li_rank = rank;
-			D_STRNDUP(li->li_base_phy_addr, "evicted", 32);
-			li->li_initialized = 1;
-			li->li_evicted = 1;
-			rc = D_MUTEX_INIT(&li->li_mutex, NULL);
-			if (rc != 0) {
-				crt_li_destroy(li);
-				D_GOTO(out, rc);
-			}
+	li = crt_grp_lc_item_get(grp_priv, rank, true /* create */);
+	if (li == NULL)
+		return -DER_NOMEM;
+	D_ASSERT(li->li_grp_priv == grp_priv);
+	D_ASSERT(li->li_rank == rank);
 
-			D_RWLOCK_WRLOCK(&grp_priv->gp_rwlock);
-			rc = d_hash_rec_insert(htable, &rank, sizeof(rank),
-					       &li->li_link, true);
-			if (rc == 0) {
-				D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
-				continue;
-			}
-			/* insert failed */
-			crt_li_destroy(li);
-			D_DEBUG(DB_TRACE, "entry already exists, "
-				"group %s, rank %d, context id %d\n",
-				grp_priv->gp_pub.cg_grpid, rank, ctx_idx);
-			rlink = d_hash_rec_find(htable, (void *) &rank,
-						sizeof(rank));
-			D_ASSERT(rlink != NULL);
-		}
-		li = crt_li_link2ptr(rlink);
-		D_ASSERT(li->li_grp_priv == grp_priv);
-		D_ASSERT(li->li_rank == rank);
-		D_MUTEX_LOCK(&li->li_mutex);
-		li->li_evicted = 1;
-		D_MUTEX_UNLOCK(&li->li_mutex);
-		d_hash_rec_decref(htable, rlink);
-		D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
-	}
+	__atomic_store_n(&li->li_evicted, 1, __ATOMIC_RELEASE);
 
-out:
-	return rc;
+	return 0;
 }
 
 /* query if a rank is evicted from a group. grp must be a primary group */
@@ -2921,7 +4326,7 @@ crt_rank_evicted(crt_group_t *grp, d_rank_t rank)
 	}
 
 	D_RWLOCK_RDLOCK(grp_priv->gp_rwlock_ft);
-	ret = d_rank_in_rank_list(grp_priv->gp_failed_ranks, rank);
+	ret = d_rank_set_has(grp_priv->gp_failed_set, rank);
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
 
 out:
@@ -2947,7 +4352,6 @@ crt_rank_evict(crt_group_t *grp, d_rank_t rank)
 	struct crt_grp_priv	*grp_priv = NULL;
 	crt_endpoint_t		 tgt_ep;
 	struct crt_grp_priv	*curr_entry = NULL;
-	d_rank_list_t		 tmp_rank_list;
 	int			 rc = 0;
 
 	if (!crt_initialized()) {
@@ -2975,30 +4379,34 @@ crt_rank_evict(crt_group_t *grp, d_rank_t rank)
 	}
 
 	D_RWLOCK_WRLOCK(grp_priv->gp_rwlock_ft);
-	if (d_rank_in_rank_list(grp_priv->gp_failed_ranks, rank)) {
+	if (d_rank_set_has(grp_priv->gp_failed_set, rank)) {
 		D_DEBUG(DB_TRACE, "Rank %d already evicted.\n", rank);
 		D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
 		D_GOTO(out, rc = -DER_EVICTED);
 	}
 
-	tmp_rank_list.rl_nr = 1;
-	tmp_rank_list.rl_ranks = &rank;
-
-	d_rank_list_filter(&tmp_rank_list, grp_priv->gp_live_ranks,
-			   true /* exlude */);
+	rc = d_rank_set_add(grp_priv->gp_failed_set, rank);
+	if (rc != 0) {
+		D_ERROR("d_rank_set_add() failed, rc: %d\n", rc);
+		D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
+		D_GOTO(out_cb, rc);
+	}
 
-	rc = d_rank_list_append(grp_priv->gp_failed_ranks, rank);
+	rc = d_rank_set_del(grp_priv->gp_live_set, rank);
 	if (rc != 0) {
-		D_ERROR("d_rank_list_append() failed, rc: %d\n", rc);
+		D_ERROR("d_rank_set_del() failed, rc: %d\n", rc);
+		d_rank_set_del(grp_priv->gp_failed_set, rank);
 		D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
 		D_GOTO(out_cb, rc);
 	}
 
 	grp_priv->gp_membs_ver++;
 	/* remove rank from sub groups */
-	d_list_for_each_entry(curr_entry, &crt_grp_list, gp_link)
-		d_rank_list_filter(&tmp_rank_list, curr_entry->gp_live_ranks,
-				   true /* exclude */);
+	d_list_for_each_entry(curr_entry, &crt_grp_list, gp_link) {
+		if (d_rank_set_del(curr_entry->gp_live_set, rank) != 0)
+			D_ERROR("d_rank_set_del() failed, group %s.\n",
+				curr_entry->gp_pub.cg_grpid);
+	}
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
 
 	rc = crt_grp_lc_mark_evicted(grp_priv, rank);
@@ -3010,8 +4418,10 @@ crt_rank_evict(crt_group_t *grp, d_rank_t rank)
 		grp_priv->gp_pub.cg_grpid, rank);
 
 out_cb:
-	if (grp_priv->gp_local)
+	if (grp_priv->gp_local) {
 		crt_barrier_handle_eviction(grp_priv);
+		crt_coll_handle_eviction(grp_priv);
+	}
 
 	crt_exec_eviction_cb(&grp_priv->gp_pub, rank);
 	tgt_ep.ep_grp = grp;
@@ -3062,10 +4472,10 @@ crt_grp_failed_ranks_dup(crt_group_t *grp, d_rank_list_t **failed_ranks)
 		D_GOTO(out, rc = -DER_NO_PERM);
 	}
 	D_RWLOCK_RDLOCK(grp_priv->gp_rwlock_ft);
-	rc = d_rank_list_dup(failed_ranks, grp_priv->gp_failed_ranks);
+	rc = d_rank_set_to_list(grp_priv->gp_failed_set, failed_ranks);
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
 	if (rc != 0)
-		D_ERROR("d_rank_list_dup() failed, group: %s, rc: %d\n",
+		D_ERROR("d_rank_set_to_list() failed, group: %s, rc: %d\n",
 			grp_priv->gp_pub.cg_grpid, rc);
 
 out:
@@ -3121,7 +4531,7 @@ crt_grp_psr_reload(struct crt_grp_priv *grp_priv)
 		}
 	}
 
-	if (crt_is_singleton()) {
+	if (crt_is_singleton() || crt_is_bootstrap()) {
 		rc = crt_grp_config_psr_load(grp_priv, psr_rank);
 		if (rc != 0)
 			D_ERROR("crt_grp_config_psr_load(grp %s, psr_rank %d), "
@@ -43,6 +43,7 @@
 #define __CRT_GROUP_H__
 
 #include "crt_barrier.h"
+#include "crt_coll.h"
 #include "crt_pmix.h"
 
 enum crt_grp_status {
@@ -63,8 +64,36 @@ struct crt_rank_map {
 	enum crt_rank_status	rm_status; /* health status */
 };
 
-/* (1 << CRT_LOOKUP_CACHE_BITS) is the number of buckets of lookup hash table */
-#define CRT_LOOKUP_CACHE_BITS	(4)
+/* number of tree nodes memoized per group, see crt_tree.c */
+#define CRT_TREE_CACHE_NR	(8)
+
+/*
+ * A memoized position of this rank in a collective tree. The key is the
+ * (membership version, filter ranks, tree topo, root, self) tuple the tree
+ * was computed for, the value its children and parent in primary ranks.
+ */
+struct crt_tree_cache_ent {
+	/* key */
+	uint32_t		 tc_membs_ver;
+	int			 tc_tree_topo;
+	d_rank_t		 tc_root;
+	d_rank_t		 tc_self;
+	uint64_t		 tc_filter_hash;
+	uint32_t		 tc_filter_nr;
+	d_rank_t		*tc_filter_ranks;
+	/* tc_filter_ranks is an inclusion list rather than an exclusion one */
+	bool			 tc_filter_incl;
+	/* value, tc_empty means no live rank left after the filtering */
+	uint32_t		 tc_valid:1,
+				 tc_empty:1;
+	uint32_t		 tc_nchildren;
+	d_rank_t		*tc_children;
+	d_rank_t		 tc_parent;
+	/* 0, or the error of to_get_parent, e.g. for the root */
+	int			 tc_parent_rc;
+	/* last use, for LRU replacement */
+	uint64_t		 tc_stamp;
+};
 
 struct crt_grp_priv {
 	d_list_t		 gp_link; /* link to crt_grp_list */
@@ -74,21 +103,30 @@ struct crt_grp_priv {
 	 * number within the primary group.
 	 */
 	d_rank_list_t		*gp_membs;
+	/*
+	 * reverse index of gp_membs for subgroups, gp_membs_idx[r -
+	 * gp_membs_base] is the subgroup rank of primary rank r or
+	 * CRT_GRP_NO_IDX. It covers the gp_membs_span ranks from the lowest to
+	 * the highest member and is NULL when gp_membs is too sparse for that,
+	 * in which case translation binary searches gp_membs.
+	 */
+	uint32_t		*gp_membs_idx;
+	d_rank_t		 gp_membs_base;
+	uint32_t		 gp_membs_span;
 	/*
 	 * the version number of membership list gp_membs, also the version
 	 * number of the failed rank list gp_pri_srv->ps_failed_ranks
 	 */
 	uint32_t		 gp_membs_ver;
 	/*
-	 * member ranks that are still alive, should be unique and sorted, each
-	 * member is the rank number within the primary group. Only valid for
-	 * the local primary service group.
+	 * member ranks that are still alive, each member is the rank number
+	 * within the primary group. Only valid for local service groups.
 	 */
-	d_rank_list_t		*gp_live_ranks;
-	/* failed ranks. a subgroup's list points to its parent's list */
-	d_rank_list_t		*gp_failed_ranks;
+	d_rank_set_t		*gp_live_set;
+	/* failed ranks. a subgroup's set points to its parent's set */
+	d_rank_set_t		*gp_failed_set;
 	/*
-	 * protects gp_membs_ver, gp_live_ranks, gp_failed_ranks. Only allocated
+	 * protects gp_membs_ver, gp_live_set, gp_failed_set. Only allocated
 	 * for primary groups, a subgroup references its parent group's lock
 	 */
 	pthread_rwlock_t	*gp_rwlock_ft;
@@ -119,8 +157,18 @@ struct crt_grp_priv {
 	d_rank_t		 gp_psr_rank;
 	/* PSR phy addr address in attached group */
 	crt_phy_addr_t		 gp_psr_phy_addr;
-	/* address lookup cache, only valid for primary group */
-	struct d_hash_table	 **gp_lookup_cache;
+	/*
+	 * address lookup cache, only valid for primary group. Dense array of
+	 * gp_size item pointers indexed by rank and shared by all contexts.
+	 * The array is allocated on the first insert and an item when its rank
+	 * is first resolved. Both are published under gp_rwlock with release
+	 * stores and read without it.
+	 */
+	struct crt_lookup_item	**gp_lookup_cache;
+	/* items allocated in gp_lookup_cache */
+	d_list_t		 gp_lc_items;
+	/* bitmap of the contexts that cached HG addresses in this group */
+	uint64_t		 gp_lc_ctx_mask[CRT_SRV_CONTEXT_NUM / 64];
 	enum crt_grp_status	 gp_status; /* group status */
 	/* set of variables only valid in primary service groups */
 	uint32_t		 gp_primary:1, /* flag of primary group */
@@ -133,16 +181,37 @@ struct crt_grp_priv {
 	/* group reference count */
 	uint32_t		 gp_refcount;
 
+	/*
+	 * host of each rank for CRT_TREE_HIER, only for the local primary
+	 * service group and only when the URIs of all ranks are known at init.
+	 * Ranks whose URIs have the same crt_uri_host_key() share an id in
+	 * [0, gp_host_nr). gp_host_map is a hash of the map, 0 without one.
+	 */
+	uint32_t		*gp_host_ids;
+	uint32_t		 gp_host_nr;
+	uint64_t		 gp_host_map;
+
 	/* rank map array, only needed for local primary group */
 	struct crt_rank_map	*gp_rank_map;
 	/* pmix errhdlr ref, used for PMIx_Deregister_event_handler */
 	size_t			 gp_errhdlr_ref;
 	/* Barrier information.  Only used in local service groups */
 	struct crt_barrier_info	 gp_barrier_info;
+	/* Allgather and all-to-all, local primary group only */
+	struct crt_coll_info	 gp_coll_info;
 
 	/* temporary return code for group creation */
 	int			 gp_rc;
 
+	/*
+	 * memoized tree nodes, keyed on the primary group's gp_membs_ver so an
+	 * eviction invalidates them. Protected by gp_tree_cache_lock, which
+	 * nests inside gp_rwlock_ft.
+	 */
+	struct crt_tree_cache_ent gp_tree_cache[CRT_TREE_CACHE_NR];
+	uint64_t		 gp_tree_cache_clock;
+	pthread_mutex_t		 gp_tree_cache_lock;
+
 	crt_grp_create_cb_t	 gp_create_cb; /* grp create completion cb */
 	crt_grp_destroy_cb_t	 gp_destroy_cb; /* grp destroy completion cb */
 	void			*gp_destroy_cb_arg;
@@ -150,26 +219,77 @@ struct crt_grp_priv {
 	pthread_rwlock_t	 gp_rwlock; /* protect all fields above */
 };
 
-/* lookup cache item for one target */
+/* number of entries of a crt_li_map stored inline in the lookup item */
+#define CRT_LI_INLINE_NR	(2)
+
+/* key of a connected HG address in crt_lookup_item::li_tag_addr */
+#define CRT_LI_ADDR_KEY(ctx_idx, tag)	(((uint32_t)(ctx_idx) << 16) | (tag))
+#define CRT_LI_ADDR_KEY_CTX(key)	((int)((key) >> 16))
+
+struct crt_li_ent {
+	uint32_t		 le_key;
+	void			*le_val;
+};
+
+/* overflow entries of a crt_li_map */
+struct crt_li_ovf {
+	/* smaller array this one replaced, freed with the map */
+	struct crt_li_ovf	*lo_prev;
+	uint32_t		 lo_nr;
+	uint32_t		 lo_cap;
+	struct crt_li_ent	 lo_ents[0];
+};
+
+/*
+ * Sparse key/value storage of a lookup item. Most ranks are only ever reached
+ * through one or two (context, tag) pairs, so the first CRT_LI_INLINE_NR
+ * entries live inline and the rest go to an overflow array.
+ *
+ * Writers hold li_mutex. Entries are only appended and never move, a removed
+ * key keeps its entry with a NULL value, and a grown overflow array replaces
+ * the old one without freeing it, so readers need no lock.
+ */
+struct crt_li_map {
+	struct crt_li_ent	 lm_inline[CRT_LI_INLINE_NR];
+	uint32_t		 lm_inline_nr;
+	struct crt_li_ovf	*lm_overflow;
+};
+
+/* lookup cache item for one target, shared by all contexts */
 struct crt_lookup_item {
-	/* link to crt_grp_priv::gp_lookup_cache[ctx_idx] */
+	/* link to crt_grp_priv::gp_lc_items */
 	d_list_t		 li_link;
 	/* point back to grp_priv */
 	struct crt_grp_priv	*li_grp_priv;
 	/* rank of the target */
 	d_rank_t		 li_rank;
-	/* base phy addr published through PMIx */
-	crt_phy_addr_t		 li_base_phy_addr;
-	/* connected HG addr */
-	hg_addr_t		 li_tag_addr[CRT_SRV_CONTEXT_NUM];
-	crt_phy_addr_t		 li_uri[CRT_SRV_CONTEXT_NUM];
-	/* reference count */
-	uint32_t		 li_ref;
-	uint32_t		 li_initialized:1,
-				 li_evicted:1;
+	/* accessed atomically, lookups do not take li_mutex */
+	uint32_t		 li_evicted;
+	/* URIs (crt_phy_addr_t) keyed by tag, tag 0 is the base URI */
+	struct crt_li_map	 li_uri;
+	/* connected HG addrs keyed by CRT_LI_ADDR_KEY(ctx_idx, tag) */
+	struct crt_li_map	 li_tag_addr;
+	/* HG addrs being resolved, list of crt_li_pending */
+	d_list_t		 li_pending;
+	/* serializes updates of the item */
 	pthread_mutex_t		 li_mutex;
 };
 
+/*
+ * Resolution in progress of the HG address of one (context, tag) of a lookup
+ * item. The first request that misses the address resolves it, the following
+ * ones park here and are released in order when it is done.
+ */
+struct crt_li_pending {
+	/* link to crt_lookup_item::li_pending */
+	d_list_t		 lp_link;
+	struct crt_lookup_item	*lp_li;
+	/* CRT_LI_ADDR_KEY(ctx_idx, tag) */
+	uint32_t		 lp_key;
+	/* parked requests, in the order they were sent */
+	d_list_t		 lp_waiters;
+};
+
 /* structure of global group data */
 struct crt_grp_gdata {
 	/* PMIx related global data */
@@ -198,6 +318,21 @@ struct crt_grp_gdata {
 void crt_hdlr_grp_create(crt_rpc_t *rpc_req);
 void crt_hdlr_grp_destroy(crt_rpc_t *rpc_req);
 void crt_hdlr_uri_lookup(crt_rpc_t *rpc_req);
+void crt_hdlr_uri_lookup_batch(crt_rpc_t *rpc_req);
+
+/* max number of (rank, tag) pairs in one batched URI_LOOKUP */
+#define CRT_UL_BATCH_MAX	(1024)
+/* batches of more pairs get their URIs back through bulk */
+#define CRT_UL_BATCH_INLINE_NR	(16)
+
+/* completion callback of crt_grp_uri_lookup(), uri is NULL if not found */
+typedef void (*crt_grp_ul_cb_t)(const char *uri, int rc, void *arg);
+
+int crt_grp_uri_lookup(struct crt_context *ctx, struct crt_grp_priv *grp_priv,
+		       d_rank_t rank, uint32_t tag, crt_grp_ul_cb_t cb,
+		       void *arg);
+bool crt_grp_uri_lookup_cancel(struct crt_context *ctx,
+			       struct crt_grp_priv *grp_priv, void *arg);
 int crt_grp_attach(crt_group_id_t srv_grpid, crt_group_t **attached_grp);
 int crt_grp_detach(crt_group_t *attached_grp);
 char *crt_get_tag_uri(const char *base_uri, uint32_t tag);
@@ -210,6 +345,15 @@ int crt_grp_lc_addr_insert(struct crt_grp_priv *grp_priv,
 			   struct crt_context *ctx_idx,
 			   d_rank_t rank, uint32_t tag, hg_addr_t *hg_addr);
 int crt_grp_ctx_invalid(struct crt_context *ctx, bool locked);
+int crt_grp_lc_resolve_begin(struct crt_grp_priv *grp_priv, int ctx_idx,
+			     d_rank_t rank, uint32_t tag, d_list_t *waiter,
+			     hg_addr_t *hg_addr);
+struct crt_li_pending *crt_grp_lc_resolve_end(struct crt_grp_priv *grp_priv,
+					      int ctx_idx, d_rank_t rank,
+					      uint32_t tag);
+d_list_t *crt_li_pending_pop(struct crt_li_pending *lp);
+bool crt_grp_lc_resolve_cancel(struct crt_grp_priv *grp_priv, d_rank_t rank,
+			       d_list_t *waiter);
 struct crt_grp_priv *crt_grp_lookup_int_grpid(uint64_t int_grpid);
 int crt_validate_grpid(const crt_group_id_t grpid);
 int crt_grp_init(crt_group_id_t grpid);
@@ -250,8 +394,7 @@ crt_ep_copy(crt_endpoint_t *dst_ep, crt_endpoint_t *src_ep)
 }
 
 void crt_li_destroy(struct crt_lookup_item *li);
-
-struct crt_lookup_item *crt_li_link2ptr(d_list_t *rlink);
+int crt_grp_lc_destroy(struct crt_grp_priv *grp_priv);
 
 static inline uint64_t
 crt_get_subgrp_id()
@@ -367,6 +510,57 @@ struct crt_grp_priv *crt_grp_pub2priv(crt_group_t *grp);
 int crt_grp_lc_uri_insert_all(crt_group_t *grp, d_rank_t rank, const char *uri);
 bool crt_rank_evicted(crt_group_t *grp, d_rank_t rank);
 int crt_grp_config_psr_load(struct crt_grp_priv *grp_priv, d_rank_t psr_rank);
+
+/* no subgroup rank in crt_grp_priv::gp_membs_idx */
+#define CRT_GRP_NO_IDX			(UINT32_MAX)
+/*
+ * a subgroup gets a dense gp_membs_idx when its members span at most this
+ * many primary ranks per member
+ */
+#define CRT_GRP_MEMBS_IDX_DENSITY	(8)
+
+int crt_grp_membs_idx_init(struct crt_grp_priv *grp_priv);
+void crt_grp_membs_idx_fini(struct crt_grp_priv *grp_priv);
+int crt_grp_rank_p2s(struct crt_grp_priv *grp_priv, d_rank_t pri_rank,
+		     d_rank_t *grp_rank);
+
+/*
+ * Binary attach info file "<prefix>/<grpid>.attach_info_bin", written next to
+ * the text one by crt_group_config_save() and mmap()ed by attaching clients.
+ * Layout: the header below, then ahi_nr uint32_t offsets indexed by rank (or
+ * a single entry for ahi_self when CRT_AIF_ALL is not set), then a pool of
+ * NUL-terminated URIs the offsets point into. Integers are in host order, a
+ * foreign file fails the magic check and the text format is used instead.
+ */
+#define CRT_AI_MAGIC		(0x41545243)	/* "CRTA" */
+#define CRT_AI_VERSION		(1)
+/* the file holds the URIs of all ranks, otherwise only that of ahi_self */
+#define CRT_AIF_ALL		(1U << 0)
+/* offset table value for a rank without URI */
+#define CRT_AI_NO_URI		(UINT32_MAX)
+
+struct crt_attach_info_hdr {
+	uint32_t	ahi_magic;
+	uint32_t	ahi_version;
+	/* length of the whole file, in bytes */
+	uint64_t	ahi_len;
+	/* group size */
+	uint32_t	ahi_size;
+	/* number of entries in the offset table */
+	uint32_t	ahi_nr;
+	uint32_t	ahi_self;
+	uint32_t	ahi_flags;
+	char		ahi_grpid[CRT_GROUP_ID_MAX_LEN + 1];
+};
+
+int crt_grp_attach_info_save(struct crt_grp_priv *grp_priv, d_rank_t rank,
+			     bool forall, char **uris);
+int crt_attach_info_pack(crt_group_id_t grpid, uint32_t size, d_rank_t self,
+			 bool forall, char **uris, void **buf, size_t *len);
+int crt_attach_info_unpack(void *buf, size_t len, crt_group_id_t grpid,
+			   struct crt_attach_info_hdr **hdr);
+int crt_attach_info_uri(struct crt_attach_info_hdr *hdr, d_rank_t rank,
+			d_rank_t *uri_rank, const char **uri);
 int crt_grp_psr_reload(struct crt_grp_priv *grp_priv);
 int crt_grp_create_corpc_aggregate(crt_rpc_t *source, crt_rpc_t *result,
 				   void *priv);
@@ -41,6 +41,7 @@
 #define D_LOGFAC	DD_FAC(hg)
 
 #include "crt_internal.h"
+#include <sys/uio.h>
 
 /*
  * na_dict table should be in the same order of enum crt_na_type, the last one
@@ -473,6 +474,24 @@ out:
 	return rc;
 }
 
+/*
+ * Return true if the URI carries an SM route to the host we are running on,
+ * i.e. Mercury will reach it through the SM NA class rather than the fabric.
+ */
+bool
+crt_hg_uri_is_local(const char *uri)
+{
+	const char	*self_uri = crt_gdata.cg_addr;
+
+	if (!crt_gdata.cg_auto_sm || uri == NULL || self_uri == NULL)
+		return false;
+	if (strchr(uri, CRT_HG_ADDR_DELIM) == NULL ||
+	    strchr(self_uri, CRT_HG_ADDR_DELIM) == NULL)
+		return false;
+
+	return crt_uri_host_key(uri) == crt_uri_host_key(self_uri);
+}
+
 static int
 crt_hg_reg_rpcid(hg_class_t *hg_class)
 {
@@ -507,21 +526,25 @@ out:
 	return rc;
 }
 
+/* info string of the NA class of context ctx_idx, bound to its rail */
 static int
-crt_get_info_string(char **string)
+crt_get_info_string(char **string, int ctx_idx)
 {
 	int	 plugin;
 	char	*plugin_str;
+	int	 rail;
 
 	plugin = crt_gdata.cg_na_plugin;
 	D_ASSERT(plugin == crt_na_dict[plugin].nad_type);
 	plugin_str = crt_na_dict[plugin].nad_str;
 
-	if (!crt_na_dict[plugin].nad_port_bind)
+	if (!crt_na_dict[plugin].nad_port_bind) {
 		D_ASPRINTF(*string, "%s://", plugin_str);
-	else
+	} else {
+		rail = crt_na_ofi_rail(ctx_idx);
 		D_ASPRINTF(*string, "%s://%s", plugin_str,
-			   crt_na_ofi_conf.noc_ip_str);
+			   crt_na_ofi_conf.noc_rail_ip_str[rail]);
+	}
 	if (*string == NULL)
 		return -DER_NOMEM;
 
@@ -569,7 +592,7 @@ crt_hg_init(crt_phy_addr_t *addr, bool server)
 
 	D_ASSERTF(*addr == NULL, "Can only be called in crt_init().\n");
 
-	rc = crt_get_info_string(&info_string);
+	rc = crt_get_info_string(&info_string, 0);
 	if (rc != 0)
 		D_GOTO(out, rc);
 
@@ -577,6 +600,11 @@ crt_hg_init(crt_phy_addr_t *addr, bool server)
 	init_info.na_init_info.auth_key = NULL;
 	init_info.na_init_info.max_contexts = 1;
 	init_info.na_class = NULL;
+	init_info.stats = HG_FALSE;
+	/* nothing to route when the primary plugin is SM already */
+	if (crt_gdata.cg_na_plugin == CRT_NA_SM)
+		crt_gdata.cg_auto_sm = false;
+	init_info.auto_sm = crt_gdata.cg_auto_sm ? HG_TRUE : HG_FALSE;
 	if (crt_gdata.cg_share_na == false)
 		/* one context per NA class */
 		init_info.na_init_info.max_contexts = 1;
@@ -625,9 +653,13 @@ crt_hg_init(crt_phy_addr_t *addr, bool server)
 		char		addr_str[CRT_ADDR_STR_MAX_LEN] = {'\0'};
 		na_size_t	str_size = CRT_ADDR_STR_MAX_LEN;
 
-		rc = na_class_get_addr(na_class, addr_str, &str_size);
+		if (crt_gdata.cg_auto_sm)
+			/* the HG address carries both the SM and fabric URI */
+			rc = crt_hg_get_addr(hg_class, addr_str, &str_size);
+		else
+			rc = na_class_get_addr(na_class, addr_str, &str_size);
 		if (rc != 0) {
-			D_ERROR("na_class_get_addr failed, rc: %d.\n", rc);
+			D_ERROR("failed to get self address, rc: %d.\n", rc);
 			HG_Finalize(hg_class);
 			NA_Finalize(na_class);
 			D_GOTO(out, rc = -DER_HG);
@@ -725,7 +757,7 @@ crt_hg_ctx_init(struct crt_hg_context *hg_ctx, int idx)
 		char		addr_str[CRT_ADDR_STR_MAX_LEN] = {'\0'};
 		na_size_t	str_size = CRT_ADDR_STR_MAX_LEN;
 
-		rc = crt_get_info_string(&info_string);
+		rc = crt_get_info_string(&info_string, idx);
 		if (rc != 0)
 			D_GOTO(out, rc);
 
@@ -733,6 +765,9 @@ crt_hg_ctx_init(struct crt_hg_context *hg_ctx, int idx)
 		init_info.na_init_info.auth_key = NULL;
 		init_info.na_init_info.max_contexts = 1;
 		init_info.na_class = NULL;
+		/* SM routing is only set up for the class of context 0 */
+		init_info.auto_sm = HG_FALSE;
+		init_info.stats = HG_FALSE;
 		na_class = NA_Initialize_opt(info_string, crt_is_service(),
 					     &init_info.na_init_info);
 		if (na_class == NULL) {
@@ -746,8 +781,8 @@ crt_hg_ctx_init(struct crt_hg_context *hg_ctx, int idx)
 			NA_Finalize(na_class);
 			D_GOTO(out, rc = -DER_HG);
 		}
-		D_DEBUG(DB_NET, "New context(idx:%d), listen address: %s.\n",
-			idx, addr_str);
+		D_DEBUG(DB_NET, "New context(idx:%d), rail %d, listen address: "
+			"%s.\n", idx, crt_na_ofi_rail(idx), addr_str);
 
 		init_info.na_class = na_class;
 		/* first two args unused because init_info.na_class is not NULL.
@@ -802,6 +837,13 @@ crt_hg_ctx_init(struct crt_hg_context *hg_ctx, int idx)
 	D_ASSERT(hg_ctx->chc_bulkcla != NULL);
 	D_ASSERT(hg_ctx->chc_bulkctx != NULL);
 
+	D_INIT_LIST_HEAD(&hg_ctx->chc_bulk_sm_list);
+	hg_ctx->chc_bulk_sm_count = 0;
+	hg_ctx->chc_bulk_sm_bytes = 0;
+	rc = D_SPIN_INIT(&hg_ctx->chc_bulk_sm_lock, PTHREAD_PROCESS_PRIVATE);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
 	rc = crt_hg_pool_init(hg_ctx);
 	if (rc != 0)
 		D_ERROR("context idx %d hg_ctx %p, crt_hg_pool_init failed, "
@@ -825,6 +867,10 @@ crt_hg_ctx_fini(struct crt_hg_context *hg_ctx)
 	hg_context = hg_ctx->chc_hgctx;
 	D_ASSERT(hg_context != NULL);
 
+	/* complete the shared-memory bulk ops not yet called back */
+	crt_hg_bulk_sm_trigger(hg_ctx);
+	D_SPIN_DESTROY(&hg_ctx->chc_bulk_sm_lock);
+
 	crt_hg_pool_fini(hg_ctx);
 
 	hg_ret = HG_Context_destroy(hg_context);
@@ -910,7 +956,8 @@ crt_rpc_handler_common(hg_handle_t hg_hdl)
 	rc = crt_hg_unpack_header(hg_hdl, &rpc_tmp, &proc);
 	if (rc != 0) {
 		D_ERROR("crt_hg_unpack_header failed, rc: %d.\n", rc);
-		crt_hg_reply_error_send(&rpc_tmp, -DER_MISC);
+		crt_hg_reply_error_send(&rpc_tmp, rc == -DER_MISMATCH ?
+					rc : -DER_MISC);
 		/** safe to return here because relevant portion of rpc_tmp is
 		 * already serialized by Mercury. Same for below.
 		 */
@@ -1202,6 +1249,10 @@ crt_hg_req_send_cb(const struct hg_cb_info *hg_cbinfo)
 			if (hg_ret == HG_SUCCESS) {
 				rpc_priv->crp_output_got = 1;
 				rc = rpc_priv->crp_reply_hdr.cch_rc;
+				if (rpc_priv->crp_send_ts != 0)
+					crt_tree_hop_sample(
+						d_timeus_secdiff(0) -
+						rpc_priv->crp_send_ts);
 			} else {
 				D_ERROR("HG_Get_output failed, hg_ret: %d, opc:"
 					" %#x.\n", hg_ret, opc);
@@ -1235,6 +1286,14 @@ crt_hg_req_send(struct crt_rpc_priv *rpc_priv)
 
 	D_ASSERT(rpc_priv != NULL);
 
+	/*
+	 * the round trip of point-to-point RPCs tells CRT_TREE_AUTO the per-hop
+	 * latency, forwarded corpcs include their whole subtree.
+	 */
+	if (!rpc_priv->crp_forward &&
+	    rpc_priv->crp_opc_info->coi_no_reply == 0)
+		rpc_priv->crp_send_ts = d_timeus_secdiff(0);
+
 	hg_ret = HG_Forward(rpc_priv->crp_hg_hdl, crt_hg_req_send_cb, rpc_priv,
 			    &rpc_priv->crp_pub.cr_input);
 	if (hg_ret != HG_SUCCESS)
@@ -1378,6 +1437,202 @@ crt_hg_trigger(struct crt_hg_context *hg_ctx)
 	return 0;
 }
 
+/*
+ * Shared-memory bulk path. When the sender of an RPC runs on the same host,
+ * bulk transfers inside its handler are done with process_vm_readv/writev
+ * straight from/to the sender's address space, bypassing the NA plugin. As
+ * for the NA path the bulk is assumed to belong to the RPC sender. Completed
+ * ops are queued to the context and called back from crt_hg_progress(), so
+ * the completion semantics match the NA path.
+ */
+struct crt_hg_bulk_sm_op {
+	d_list_t		 bso_link;
+	struct crt_bulk_desc	 bso_desc;
+	crt_bulk_cb_t		 bso_cb;
+	void			*bso_arg;
+};
+
+/* get the iovecs covering [off, off + len) of a local or remote bulk handle */
+static int
+crt_hg_bulk_sm_iovs(crt_bulk_t bulk_hdl, off_t off, size_t len,
+		    hg_uint8_t flags, struct iovec **iovs, hg_uint32_t *iov_nr)
+{
+	void		**buf_ptrs = NULL;
+	hg_size_t	 *buf_sizes = NULL;
+	struct iovec	 *iov = NULL;
+	hg_uint32_t	  max_nr;
+	hg_uint32_t	  i;
+	hg_return_t	  hg_ret;
+	int		  rc = 0;
+
+	max_nr = HG_Bulk_get_segment_count(bulk_hdl);
+	if (max_nr == 0 || max_nr > IOV_MAX)
+		D_GOTO(out, rc = -DER_NOSYS);
+
+	D_ALLOC_ARRAY(buf_ptrs, max_nr);
+	D_ALLOC_ARRAY(buf_sizes, max_nr);
+	D_ALLOC_ARRAY(iov, max_nr);
+	if (buf_ptrs == NULL || buf_sizes == NULL || iov == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	hg_ret = HG_Bulk_access(bulk_hdl, off, len, flags, max_nr, buf_ptrs,
+				buf_sizes, iov_nr);
+	if (hg_ret != HG_SUCCESS) {
+		D_DEBUG(DB_NET, "HG_Bulk_access failed, hg_ret: %d.\n", hg_ret);
+		D_GOTO(out, rc = -DER_HG);
+	}
+	for (i = 0; i < *iov_nr; i++) {
+		iov[i].iov_base = buf_ptrs[i];
+		iov[i].iov_len = buf_sizes[i];
+	}
+	*iovs = iov;
+
+out:
+	if (rc != 0)
+		D_FREE(iov);
+	D_FREE(buf_sizes);
+	D_FREE(buf_ptrs);
+	return rc;
+}
+
+/* copy the data, returns zero on success or an error to fall back to NA */
+static int
+crt_hg_bulk_sm_copy(struct crt_bulk_desc *bulk_desc, pid_t pid)
+{
+	struct iovec	*local_iovs = NULL;
+	struct iovec	*remote_iovs = NULL;
+	hg_uint32_t	 local_nr;
+	hg_uint32_t	 remote_nr;
+	ssize_t		 nbytes;
+	bool		 is_put;
+	int		 rc;
+
+	is_put = (bulk_desc->bd_bulk_op == CRT_BULK_PUT);
+	rc = crt_hg_bulk_sm_iovs(bulk_desc->bd_local_hdl,
+				 bulk_desc->bd_local_off, bulk_desc->bd_len,
+				 HG_BULK_READWRITE, &local_iovs, &local_nr);
+	if (rc != 0)
+		D_GOTO(out, rc);
+	rc = crt_hg_bulk_sm_iovs(bulk_desc->bd_remote_hdl,
+				 bulk_desc->bd_remote_off, bulk_desc->bd_len,
+				 is_put ? HG_BULK_READWRITE : HG_BULK_READ_ONLY,
+				 &remote_iovs, &remote_nr);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	if (is_put)
+		nbytes = process_vm_writev(pid, local_iovs, local_nr,
+					   remote_iovs, remote_nr, 0);
+	else
+		nbytes = process_vm_readv(pid, local_iovs, local_nr,
+					  remote_iovs, remote_nr, 0);
+	if (nbytes < 0) {
+		/* no permission to attach to the peer, stop trying */
+		if (errno == EPERM || errno == ESRCH || errno == ENOSYS) {
+			D_WARN("cross-memory attach to pid %d failed, errno "
+			       "%d, disable shared-memory bulk.\n", pid, errno);
+			__atomic_store_n(&crt_gdata.cg_bulk_sm, false,
+					 __ATOMIC_RELAXED);
+		}
+		D_GOTO(out, rc = d_errno2der(errno));
+	}
+	if (nbytes != bulk_desc->bd_len) {
+		D_DEBUG(DB_NET, "partial cross-memory copy, %zd of %zu.\n",
+			nbytes, bulk_desc->bd_len);
+		D_GOTO(out, rc = -DER_IO);
+	}
+
+out:
+	D_FREE(remote_iovs);
+	D_FREE(local_iovs);
+	return rc;
+}
+
+/*
+ * Try to do the bulk transfer by cross-memory attach. Returns zero if the
+ * transfer completed and its callback was queued, non-zero to fall back.
+ */
+static int
+crt_hg_bulk_sm_transfer(struct crt_bulk_desc *bulk_desc,
+			crt_bulk_cb_t complete_cb, void *arg)
+{
+	struct crt_rpc_priv		*rpc_priv;
+	struct crt_hg_context		*hg_ctx;
+	struct crt_hg_bulk_sm_op	*sm_op;
+	struct crt_common_hdr		*hdr;
+	int				 rc;
+
+	rpc_priv = container_of(bulk_desc->bd_rpc, struct crt_rpc_priv,
+				crp_pub);
+	hdr = &rpc_priv->crp_req_hdr;
+	if (!__atomic_load_n(&crt_gdata.cg_bulk_sm, __ATOMIC_RELAXED) ||
+	    rpc_priv->crp_srv == 0 || hdr->cch_src_pid == 0 ||
+	    !crt_host_id_is_local(&hdr->cch_src_host))
+		return -DER_NOSYS;
+
+	D_ALLOC_PTR(sm_op);
+	if (sm_op == NULL)
+		return -DER_NOMEM;
+
+	rc = crt_hg_bulk_sm_copy(bulk_desc, hdr->cch_src_pid);
+	if (rc != 0) {
+		D_DEBUG(DB_NET, "shared-memory bulk with pid %d failed, rc: "
+			"%d, fall back to NA.\n", hdr->cch_src_pid, rc);
+		D_FREE_PTR(sm_op);
+		return rc;
+	}
+
+	crt_bulk_desc_dup(&sm_op->bso_desc, bulk_desc);
+	sm_op->bso_cb = complete_cb;
+	sm_op->bso_arg = arg;
+
+	hg_ctx = &((struct crt_context *)bulk_desc->bd_rpc->cr_ctx)->cc_hg_ctx;
+	D_SPIN_LOCK(&hg_ctx->chc_bulk_sm_lock);
+	d_list_add_tail(&sm_op->bso_link, &hg_ctx->chc_bulk_sm_list);
+	hg_ctx->chc_bulk_sm_count++;
+	hg_ctx->chc_bulk_sm_bytes += bulk_desc->bd_len;
+	D_SPIN_UNLOCK(&hg_ctx->chc_bulk_sm_lock);
+
+	return 0;
+}
+
+/* call back the completed shared-memory bulk ops, returns the number */
+int
+crt_hg_bulk_sm_trigger(struct crt_hg_context *hg_ctx)
+{
+	struct crt_hg_bulk_sm_op	*sm_op;
+	struct crt_hg_bulk_sm_op	*sm_op_tmp;
+	struct crt_bulk_cb_info		 cb_info;
+	d_list_t			 done_list;
+	int				 count = 0;
+	int				 rc;
+
+	if (d_list_empty(&hg_ctx->chc_bulk_sm_list))
+		return 0;
+
+	D_INIT_LIST_HEAD(&done_list);
+	D_SPIN_LOCK(&hg_ctx->chc_bulk_sm_lock);
+	d_list_splice_init(&hg_ctx->chc_bulk_sm_list, &done_list);
+	D_SPIN_UNLOCK(&hg_ctx->chc_bulk_sm_lock);
+
+	d_list_for_each_entry_safe(sm_op, sm_op_tmp, &done_list, bso_link) {
+		d_list_del(&sm_op->bso_link);
+		if (sm_op->bso_cb != NULL) {
+			cb_info.bci_bulk_desc = &sm_op->bso_desc;
+			cb_info.bci_arg = sm_op->bso_arg;
+			cb_info.bci_rc = 0;
+			rc = sm_op->bso_cb(&cb_info);
+			if (rc != 0)
+				D_ERROR("bulk completion callback failed, "
+					"rc: %d.\n", rc);
+		}
+		D_FREE_PTR(sm_op);
+		count++;
+	}
+
+	return count;
+}
+
 int
 crt_hg_progress(struct crt_hg_context *hg_ctx, int64_t timeout)
 {
@@ -1404,6 +1659,10 @@ crt_hg_progress(struct crt_hg_context *hg_ctx, int64_t timeout)
 	if (rc != 0)
 		return rc;
 
+	/* do not block in HG while shared-memory bulk completions wait */
+	if (crt_hg_bulk_sm_trigger(hg_ctx) > 0)
+		hg_timeout = 0;
+
 	/** progress RPC execution */
 	hg_ret = HG_Progress(hg_context, hg_timeout);
 	if (hg_ret == HG_TIMEOUT)
@@ -1417,6 +1676,7 @@ crt_hg_progress(struct crt_hg_context *hg_ctx, int64_t timeout)
 	rc = crt_hg_trigger(hg_ctx);
 
 out:
+	crt_hg_bulk_sm_trigger(hg_ctx);
 	return rc;
 }
 
@@ -1644,6 +1904,11 @@ crt_hg_bulk_transfer(struct crt_bulk_desc *bulk_desc, crt_bulk_cb_t complete_cb,
 	hg_ctx = &ctx->cc_hg_ctx;
 	D_ASSERT(hg_ctx != NULL && hg_ctx->chc_bulkctx != NULL);
 
+	/* an op done by cross-memory attach cannot be aborted by opid */
+	if (opid == NULL &&
+	    crt_hg_bulk_sm_transfer(bulk_desc, complete_cb, arg) == 0)
+		D_GOTO(out, rc = 0);
+
 	D_ALLOC_PTR(bulk_cbinfo);
 	if (bulk_cbinfo == NULL)
 		D_GOTO(out, rc = -DER_NOMEM);
@@ -1678,3 +1943,223 @@ crt_hg_bulk_transfer(struct crt_bulk_desc *bulk_desc, crt_bulk_cb_t complete_cb,
 out:
 	return rc;
 }
+
+/*
+ * Aggregated state of one crt_hg_bulk_transfer_vec() call. It is allocated
+ * in one piece together with the trailing arrays of descriptors, per-op
+ * callback args and return codes, see crt_hg_bulk_vec_alloc().
+ */
+struct crt_hg_bulk_vec_info {
+	struct crt_bulk_desc		*bvi_descs;
+	struct crt_hg_bulk_vec_op	*bvi_ops;
+	int				*bvi_rcs;
+	int				 bvi_nr;
+	/* number of not yet completed ops plus one for the submitter */
+	int				 bvi_pending;
+	pthread_spinlock_t		 bvi_lock;
+	crt_bulk_vec_cb_t		 bvi_cb;
+	void				*bvi_arg;
+};
+
+/* per-descriptor callback arg of HG_Bulk_transfer */
+struct crt_hg_bulk_vec_op {
+	struct crt_hg_bulk_vec_info	*bvo_info;
+	int				 bvo_idx;
+};
+
+static struct crt_hg_bulk_vec_info *
+crt_hg_bulk_vec_alloc(int nr)
+{
+	struct crt_hg_bulk_vec_info	*vec_info;
+	size_t				 size;
+	int				 rc;
+
+	size = sizeof(*vec_info) + nr * (sizeof(struct crt_bulk_desc) +
+	       sizeof(struct crt_hg_bulk_vec_op) + sizeof(int));
+	D_ALLOC(vec_info, size);
+	if (vec_info == NULL)
+		return NULL;
+
+	rc = D_SPIN_INIT(&vec_info->bvi_lock, PTHREAD_PROCESS_PRIVATE);
+	if (rc != 0) {
+		D_FREE(vec_info);
+		return NULL;
+	}
+	vec_info->bvi_descs = (struct crt_bulk_desc *)(vec_info + 1);
+	vec_info->bvi_ops = (struct crt_hg_bulk_vec_op *)
+			    (vec_info->bvi_descs + nr);
+	vec_info->bvi_rcs = (int *)(vec_info->bvi_ops + nr);
+	vec_info->bvi_nr = nr;
+
+	return vec_info;
+}
+
+static void
+crt_hg_bulk_vec_free(struct crt_hg_bulk_vec_info *vec_info)
+{
+	D_SPIN_DESTROY(&vec_info->bvi_lock);
+	D_FREE(vec_info);
+}
+
+/* drop one pending reference, call the user callback after the last one */
+static void
+crt_hg_bulk_vec_put(struct crt_hg_bulk_vec_info *vec_info)
+{
+	struct crt_bulk_vec_cb_info	 cb_info;
+	bool				 done;
+	int				 i;
+	int				 rc;
+
+	D_SPIN_LOCK(&vec_info->bvi_lock);
+	D_ASSERT(vec_info->bvi_pending > 0);
+	done = (--vec_info->bvi_pending == 0);
+	D_SPIN_UNLOCK(&vec_info->bvi_lock);
+	if (!done)
+		return;
+
+	if (vec_info->bvi_cb == NULL) {
+		D_DEBUG(DB_NET, "No bulk completion callback registered.\n");
+		D_GOTO(out, 0);
+	}
+
+	cb_info.bvci_bulk_descs = vec_info->bvi_descs;
+	cb_info.bvci_rcs = vec_info->bvi_rcs;
+	cb_info.bvci_nr = vec_info->bvi_nr;
+	cb_info.bvci_arg = vec_info->bvi_arg;
+	cb_info.bvci_rc = 0;
+	for (i = 0; i < vec_info->bvi_nr; i++) {
+		if (vec_info->bvi_rcs[i] != 0) {
+			cb_info.bvci_rc = vec_info->bvi_rcs[i];
+			break;
+		}
+	}
+
+	rc = vec_info->bvi_cb(&cb_info);
+	if (rc != 0)
+		D_ERROR("bulk vec completion callback failed, rc: %d.\n", rc);
+
+out:
+	crt_hg_bulk_vec_free(vec_info);
+}
+
+static hg_return_t
+crt_hg_bulk_vec_transfer_cb(const struct hg_cb_info *hg_cbinfo)
+{
+	struct crt_hg_bulk_vec_op	*vec_op;
+	struct crt_hg_bulk_vec_info	*vec_info;
+	hg_return_t			 hg_ret = HG_SUCCESS;
+	int				 rc = 0;
+
+	D_ASSERT(hg_cbinfo != NULL);
+	D_ASSERT(hg_cbinfo->type == HG_CB_BULK);
+	vec_op = hg_cbinfo->arg;
+	D_ASSERT(vec_op != NULL);
+	vec_info = vec_op->bvo_info;
+	D_ASSERT(vec_info != NULL);
+
+	if (hg_cbinfo->ret != HG_SUCCESS) {
+		if (hg_cbinfo->ret == HG_CANCELED) {
+			D_DEBUG(DB_NET, "bulk transferring canceled.\n");
+			rc = -DER_CANCELED;
+		} else {
+			D_ERROR("crt_hg_bulk_vec_transfer_cb, desc %d, "
+				"hg_cbinfo->ret: %d.\n", vec_op->bvo_idx,
+				hg_cbinfo->ret);
+			hg_ret = hg_cbinfo->ret;
+			rc = -DER_HG;
+		}
+	}
+	vec_info->bvi_rcs[vec_op->bvo_idx] = rc;
+
+	crt_hg_bulk_vec_put(vec_info);
+	return hg_ret;
+}
+
+/* completion of a descriptor done by cross-memory attach */
+static int
+crt_hg_bulk_vec_sm_cb(const struct crt_bulk_cb_info *cb_info)
+{
+	struct crt_hg_bulk_vec_op	*vec_op = cb_info->bci_arg;
+	struct crt_hg_bulk_vec_info	*vec_info = vec_op->bvo_info;
+
+	vec_info->bvi_rcs[vec_op->bvo_idx] = cb_info->bci_rc;
+	crt_hg_bulk_vec_put(vec_info);
+	return 0;
+}
+
+int
+crt_hg_bulk_transfer_vec(struct crt_bulk_desc *bulk_descs, int nr,
+			 crt_bulk_vec_cb_t complete_cb, void *arg)
+{
+	struct crt_hg_bulk_vec_info	*vec_info;
+	struct crt_bulk_desc		*bulk_desc;
+	struct crt_context		*ctx;
+	struct crt_rpc_priv		*rpc_priv;
+	hg_bulk_op_t			 hg_bulk_op;
+	hg_return_t			 hg_ret;
+	int				 submitted = 0;
+	int				 i;
+	int				 rc = 0;
+
+	D_ASSERT(bulk_descs != NULL && nr > 0);
+
+	vec_info = crt_hg_bulk_vec_alloc(nr);
+	if (vec_info == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	vec_info->bvi_cb = complete_cb;
+	vec_info->bvi_arg = arg;
+	/* the extra reference is dropped after all ops were submitted */
+	vec_info->bvi_pending = nr + 1;
+
+	for (i = 0; i < nr; i++) {
+		bulk_desc = &vec_info->bvi_descs[i];
+		crt_bulk_desc_dup(bulk_desc, &bulk_descs[i]);
+		vec_info->bvi_ops[i].bvo_info = vec_info;
+		vec_info->bvi_ops[i].bvo_idx = i;
+
+		/* same path as crt_hg_bulk_transfer() */
+		if (crt_hg_bulk_sm_transfer(bulk_desc, crt_hg_bulk_vec_sm_cb,
+					    &vec_info->bvi_ops[i]) == 0) {
+			submitted++;
+			continue;
+		}
+
+		ctx = bulk_desc->bd_rpc->cr_ctx;
+		D_ASSERT(ctx->cc_hg_ctx.chc_bulkctx != NULL);
+		rpc_priv = container_of(bulk_desc->bd_rpc, struct crt_rpc_priv,
+					crp_pub);
+		hg_bulk_op = (bulk_desc->bd_bulk_op == CRT_BULK_PUT) ?
+			     HG_BULK_PUSH : HG_BULK_PULL;
+		hg_ret = HG_Bulk_transfer(ctx->cc_hg_ctx.chc_bulkctx,
+				crt_hg_bulk_vec_transfer_cb,
+				&vec_info->bvi_ops[i], hg_bulk_op,
+				rpc_priv->crp_hg_addr,
+				bulk_desc->bd_remote_hdl,
+				bulk_desc->bd_remote_off,
+				bulk_desc->bd_local_hdl,
+				bulk_desc->bd_local_off,
+				bulk_desc->bd_len, HG_OP_ID_IGNORE);
+		if (hg_ret == HG_SUCCESS) {
+			submitted++;
+			continue;
+		}
+
+		/* report it through the callback, the others still go */
+		D_ERROR("HG_Bulk_transfer of desc %d failed, hg_ret: %d.\n",
+			i, hg_ret);
+		vec_info->bvi_rcs[i] = -DER_HG;
+		crt_hg_bulk_vec_put(vec_info);
+	}
+
+	if (submitted == 0) {
+		/* nothing in flight, fail the whole call */
+		crt_hg_bulk_vec_free(vec_info);
+		D_GOTO(out, rc = -DER_HG);
+	}
+
+	/* drop the submitter's reference */
+	crt_hg_bulk_vec_put(vec_info);
+
+out:
+	return rc;
+}
@@ -61,6 +61,12 @@
 /** number of prepost HG handles when enable pool */
 #define CRT_HG_POOL_PREPOST_NUM	(16)
 
+/*
+ * With SM routing (CRT_AUTO_SM) an HG address string is
+ * "<host uuid>#<SM address>#<fabric address>".
+ */
+#define CRT_HG_ADDR_DELIM	'#'
+
 struct crt_rpc_priv;
 struct crt_common_hdr;
 struct crt_corpc_hdr;
@@ -117,6 +123,13 @@ struct crt_hg_context {
 	hg_class_t		*chc_bulkcla; /* bulk class */
 	hg_context_t		*chc_bulkctx; /* bulk context */
 	struct crt_hg_pool	 chc_hg_pool; /* HG handle pool */
+	/* shared-memory bulk ops completed but not yet called back */
+	d_list_t		 chc_bulk_sm_list;
+	/* protects chc_bulk_sm_list and the counters below */
+	pthread_spinlock_t	 chc_bulk_sm_lock;
+	/* number and bytes of bulk transfers done by cross-memory attach */
+	uint64_t		 chc_bulk_sm_count;
+	uint64_t		 chc_bulk_sm_bytes;
 };
 
 /** HG level global data */
@@ -146,10 +159,12 @@ int crt_hg_reply_send(struct crt_rpc_priv *rpc_priv);
 void crt_hg_reply_error_send(struct crt_rpc_priv *rpc_priv, int error_code);
 int crt_hg_req_cancel(struct crt_rpc_priv *rpc_priv);
 int crt_hg_progress(struct crt_hg_context *hg_ctx, int64_t timeout);
+int crt_hg_bulk_sm_trigger(struct crt_hg_context *hg_ctx);
 int crt_hg_addr_lookup(struct crt_hg_context *hg_ctx, const char *name,
 		       crt_hg_addr_lookup_cb_t complete_cb, void *arg);
 int crt_hg_addr_free(struct crt_hg_context *hg_ctx, hg_addr_t addr);
 int crt_hg_get_addr(hg_class_t *hg_class, char *addr_str, size_t *str_size);
+bool crt_hg_uri_is_local(const char *uri);
 
 int crt_rpc_handler_common(hg_handle_t hg_hdl);
 
@@ -242,6 +257,8 @@ int crt_hg_bulk_access(crt_bulk_t bulk_hdl, d_sg_list_t *sgl);
 int crt_hg_bulk_transfer(struct crt_bulk_desc *bulk_desc,
 			 crt_bulk_cb_t complete_cb,
 			 void *arg, crt_bulk_opid_t *opid);
+int crt_hg_bulk_transfer_vec(struct crt_bulk_desc *bulk_descs, int nr,
+			     crt_bulk_vec_cb_t complete_cb, void *arg);
 static inline int
 crt_hg_bulk_cancel(crt_bulk_opid_t opid)
 {
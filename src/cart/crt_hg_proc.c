@@ -447,7 +447,7 @@ crt_proc_corpc_hdr(crt_proc_t proc, struct crt_corpc_hdr *hdr)
 		D_ERROR("crt proc error, rc: %d.\n", rc);
 		D_GOTO(out, rc);
 	}
-	rc = crt_proc_crt_rank_list_t(hg_proc, &hdr->coh_excluded_ranks);
+	rc = crt_proc_crt_rank_list_t(hg_proc, &hdr->coh_filter_ranks);
 	if (rc != 0) {
 		D_ERROR("crt proc error, rc: %d.\n", rc);
 		D_GOTO(out, rc);
@@ -472,7 +472,12 @@ crt_proc_corpc_hdr(crt_proc_t proc, struct crt_corpc_hdr *hdr)
 		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
 		D_GOTO(out, rc = -DER_HG);
 	}
-	hg_ret = hg_proc_hg_uint32_t(hg_proc, &hdr->coh_padding);
+	hg_ret = hg_proc_hg_uint32_t(hg_proc, &hdr->coh_seg);
+	if (hg_ret != HG_SUCCESS) {
+		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
+		D_GOTO(out, rc = -DER_HG);
+	}
+	hg_ret = hg_proc_hg_uint64_t(hg_proc, &hdr->coh_host_map);
 	if (hg_ret != HG_SUCCESS) {
 		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
 		rc = -DER_HG;
@@ -507,6 +512,13 @@ crt_proc_common_hdr(crt_proc_t proc, struct crt_common_hdr *hdr)
 		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
 		D_GOTO(out, rc = -DER_HG);
 	}
+	/* the rest of the header depends on the version, don't guess */
+	if (hg_proc_get_op(hg_proc) == HG_DECODE &&
+	    hdr->cch_version != CRT_RPC_VERSION) {
+		D_ERROR("RPC version %#x, expected %#x.\n", hdr->cch_version,
+			CRT_RPC_VERSION);
+		D_GOTO(out, rc = -DER_MISMATCH);
+	}
 	hg_ret = hg_proc_hg_uint32_t(hg_proc, &hdr->cch_opc);
 	if (hg_ret != HG_SUCCESS) {
 		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
@@ -533,6 +545,21 @@ crt_proc_common_hdr(crt_proc_t proc, struct crt_common_hdr *hdr)
 		D_GOTO(out, rc = -DER_HG);
 	}
 	hg_ret = hg_proc_hg_uint32_t(hg_proc, &hdr->cch_rc);
+	if (hg_ret != HG_SUCCESS) {
+		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
+		D_GOTO(out, rc = -DER_HG);
+	}
+	hg_ret = hg_proc_hg_uint32_t(hg_proc, &hdr->cch_src_pid);
+	if (hg_ret != HG_SUCCESS) {
+		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
+		D_GOTO(out, rc = -DER_HG);
+	}
+	rc = crt_proc_uuid_t(hg_proc, &hdr->cch_src_host.chi_boot_id);
+	if (rc != 0) {
+		D_ERROR("hg proc error, rc: %d.\n", rc);
+		D_GOTO(out, rc);
+	}
+	hg_ret = hg_proc_hg_uint64_t(hg_proc, &hdr->cch_src_host.chi_pid_ns);
 	if (hg_ret != HG_SUCCESS) {
 		D_ERROR("hg proc error, hg_ret: %d.\n", hg_ret);
 		rc = -DER_HG;
@@ -621,18 +648,21 @@ crt_hg_header_copy(struct crt_rpc_priv *in, struct crt_rpc_priv *out)
 	out->crp_req_hdr.cch_rank = in->crp_req_hdr.cch_rank;
 	out->crp_req_hdr.cch_grp_id = in->crp_req_hdr.cch_grp_id;
 	out->crp_req_hdr.cch_rc = in->crp_req_hdr.cch_rc;
+	out->crp_req_hdr.cch_src_pid = in->crp_req_hdr.cch_src_pid;
+	out->crp_req_hdr.cch_src_host = in->crp_req_hdr.cch_src_host;
 
 	if (!(out->crp_flags & CRT_RPC_FLAG_COLL))
 		return;
 
 	out->crp_coreq_hdr.coh_int_grpid = in->crp_coreq_hdr.coh_int_grpid;
 	out->crp_coreq_hdr.coh_bulk_hdl = in->crp_coreq_hdr.coh_bulk_hdl;
-	out->crp_coreq_hdr.coh_excluded_ranks = in->crp_coreq_hdr.coh_excluded_ranks;
+	out->crp_coreq_hdr.coh_filter_ranks = in->crp_coreq_hdr.coh_filter_ranks;
 	out->crp_coreq_hdr.coh_inline_ranks = in->crp_coreq_hdr.coh_inline_ranks;
 	out->crp_coreq_hdr.coh_grp_ver = in->crp_coreq_hdr.coh_grp_ver;
 	out->crp_coreq_hdr.coh_tree_topo = in->crp_coreq_hdr.coh_tree_topo;
 	out->crp_coreq_hdr.coh_root = in->crp_coreq_hdr.coh_root;
-	out->crp_coreq_hdr.coh_padding = in->crp_coreq_hdr.coh_padding;
+	out->crp_coreq_hdr.coh_seg = in->crp_coreq_hdr.coh_seg;
+	out->crp_coreq_hdr.coh_host_map = in->crp_coreq_hdr.coh_host_map;
 }
 
 void
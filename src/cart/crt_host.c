@@ -0,0 +1,142 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It identifies the host a process or a URI is on.
+ *
+ * The host id of a process is the boot id of the kernel it runs on and the
+ * inode of its PID namespace. Two processes with the same host id see the
+ * same pids and can use cross-memory attach on each other; it is sent in
+ * every RPC header for the shared-memory bulk path.
+ *
+ * Peers known only by their URI are compared by crt_uri_host_key(), which
+ * is what the SM route and the host aware trees use.
+ */
+#define D_LOGFAC	DD_FAC(hg)
+
+#include <sys/stat.h>
+
+#include "crt_internal.h"
+
+#define CRT_BOOT_ID_PATH	"/proc/sys/kernel/random/boot_id"
+#define CRT_PID_NS_PATH		"/proc/self/ns/pid"
+
+/* fill crt_gdata.cg_host_id, left zeroed if the host can't be identified */
+void
+crt_host_id_init(void)
+{
+	struct crt_host_id	*id = &crt_gdata.cg_host_id;
+	char			 buf[64];
+	struct stat		 st;
+	FILE			*fp;
+	int			 rc;
+
+	memset(id, 0, sizeof(*id));
+
+	fp = fopen(CRT_BOOT_ID_PATH, "r");
+	if (fp == NULL) {
+		D_DEBUG(DB_ALL, "can't open %s, errno %d.\n",
+			CRT_BOOT_ID_PATH, errno);
+		return;
+	}
+	if (fgets(buf, sizeof(buf), fp) == NULL) {
+		D_DEBUG(DB_ALL, "can't read %s.\n", CRT_BOOT_ID_PATH);
+		fclose(fp);
+		return;
+	}
+	fclose(fp);
+	buf[strcspn(buf, "\n")] = '\0';
+
+	rc = stat(CRT_PID_NS_PATH, &st);
+	if (rc != 0) {
+		D_DEBUG(DB_ALL, "can't stat %s, errno %d.\n",
+			CRT_PID_NS_PATH, errno);
+		return;
+	}
+
+	if (uuid_parse(buf, id->chi_boot_id) != 0) {
+		D_DEBUG(DB_ALL, "bad boot id %s.\n", buf);
+		memset(id, 0, sizeof(*id));
+		return;
+	}
+	id->chi_pid_ns = st.st_ino;
+	D_DEBUG(DB_ALL, "host id: boot id %s, pid namespace "DF_X64".\n",
+		buf, id->chi_pid_ns);
+}
+
+/* true if a process with host id \a id shares our kernel and PID namespace */
+bool
+crt_host_id_is_local(const struct crt_host_id *id)
+{
+	const struct crt_host_id	*self = &crt_gdata.cg_host_id;
+
+	if (uuid_is_null(self->chi_boot_id) || self->chi_pid_ns == 0)
+		return false;
+
+	return uuid_compare(id->chi_boot_id, self->chi_boot_id) == 0 &&
+	       id->chi_pid_ns == self->chi_pid_ns;
+}
+
+/*
+ * Key of the host a URI is on. With SM routing the URI starts with the id
+ * Mercury gives the host, which is also what Mercury checks to pick the SM
+ * route. Otherwise it is the host part of the fabric address, between "://"
+ * and the port.
+ */
+uint64_t
+crt_uri_host_key(const char *uri)
+{
+	const char	*start;
+	const char	*delim;
+	size_t		 len;
+	size_t		 i;
+
+	delim = strchr(uri, CRT_HG_ADDR_DELIM);
+	if (delim != NULL)
+		return d_hash_murmur64((unsigned char *)uri, delim - uri, 0);
+
+	start = strstr(uri, "://");
+	start = (start == NULL) ? uri : start + 3;
+	len = strcspn(start, "/");
+	for (i = len; i > 0; i--) {
+		if (start[i - 1] == ':') {
+			len = i - 1;
+			break;
+		}
+	}
+	return d_hash_murmur64((unsigned char *)start, len, 0);
+}
@@ -53,6 +53,12 @@ static int data_init(crt_init_options_t *opt)
 	uint32_t	credits;
 	bool		share_addr = false;
 	uint32_t	ctx_num = 1;
+	bool		bulk_sm = true;
+	bool		auto_sm = false;
+	bool		buf_pool = true;
+	bool		uri_prefetch = false;
+	uint32_t	seg_size = CRT_CORPC_SEG_SIZE_DEFAULT;
+	uint32_t	seg_shift = 0;
 	int		rc = 0;
 
 	D_DEBUG(DB_ALL, "initializing crt_gdata...\n");
@@ -132,6 +138,42 @@ static int data_init(crt_init_options_t *opt)
 		D_WARN("CRT_CTX_NUM has no effect because CRT_CTX_SHARE_ADDR "
 		       "is not set or set to 0\n");
 
+	/* identify co-located peers for the shared-memory bulk path */
+	crt_gdata.cg_pid = getpid();
+	crt_host_id_init();
+	d_getenv_bool("CRT_BULK_SM", &bulk_sm);
+	crt_gdata.cg_bulk_sm = bulk_sm;
+	D_DEBUG(DB_ALL, "set cg_bulk_sm %d, pid %d.\n",
+		crt_gdata.cg_bulk_sm, crt_gdata.cg_pid);
+
+	d_getenv_bool("CRT_AUTO_SM", &auto_sm);
+	crt_gdata.cg_auto_sm = auto_sm;
+	D_DEBUG(DB_ALL, "set cg_auto_sm %d.\n", crt_gdata.cg_auto_sm);
+
+	d_getenv_bool("CRT_BUF_POOL", &buf_pool);
+	crt_gdata.cg_buf_pool = buf_pool;
+	D_DEBUG(DB_ALL, "set cg_buf_pool %d.\n", crt_gdata.cg_buf_pool);
+
+	if (opt && opt->cio_prefetch_override)
+		uri_prefetch = opt->cio_uri_prefetch;
+	else
+		d_getenv_bool("CRT_URI_PREFETCH", &uri_prefetch);
+	crt_gdata.cg_uri_prefetch = uri_prefetch;
+	D_DEBUG(DB_ALL, "set cg_uri_prefetch %d.\n",
+		crt_gdata.cg_uri_prefetch);
+
+	/* CRT_CORPC_SEG_SIZE=0 pulls the corpc chained bulk as a whole */
+	d_getenv_int("CRT_CORPC_SEG_SIZE", &seg_size);
+	if (seg_size != 0) {
+		seg_shift = 31 - __builtin_clz(seg_size);
+		if (seg_shift < CRT_CORPC_SEG_SHIFT_MIN)
+			seg_shift = CRT_CORPC_SEG_SHIFT_MIN;
+		if (seg_shift > CRT_CORPC_SEG_SHIFT_MAX)
+			seg_shift = CRT_CORPC_SEG_SHIFT_MAX;
+	}
+	crt_gdata.cg_corpc_seg_shift = seg_shift;
+	D_DEBUG(DB_ALL, "set cg_corpc_seg_shift %d.\n",
+		crt_gdata.cg_corpc_seg_shift);
 
 	gdata_init_flag = 1;
 exit:
@@ -243,6 +285,14 @@ crt_init_opt(crt_group_id_t grpid, uint32_t flags, crt_init_options_t *opt)
 		if ((flags & CRT_FLAG_BIT_SINGLETON) != 0)
 			crt_gdata.cg_singleton = true;
 
+		if (!crt_gdata.cg_singleton) {
+			rc = crt_boot_init();
+			if (rc != 0) {
+				D_ERROR("crt_boot_init failed, rc: %d.\n", rc);
+				D_GOTO(unlock, rc);
+			}
+		}
+
 		path = getenv("CRT_ATTACH_INFO_PATH");
 		if (path != NULL && strlen(path) > 0) {
 			rc = crt_group_config_path_set(path);
@@ -454,6 +504,8 @@ crt_finalize(void)
 			D_RWLOCK_UNLOCK(&crt_gdata.cg_rwlock);
 			D_GOTO(out, rc);
 		}
+		if (crt_gdata.cg_boot)
+			crt_boot_fini();
 
 		rc = crt_hg_fini();
 		if (rc != 0) {
@@ -570,20 +622,54 @@ out:
 	return rc;
 }
 
+/* find the IPv4 address of interface if_name, IPv6 is not supported yet */
+static int
+crt_na_ofi_if_ip(struct ifaddrs *if_addrs, const char *if_name, char *ip_str)
+{
+	struct ifaddrs	*ifa;
+	void		*tmp_ptr;
+
+	for (ifa = if_addrs; ifa != NULL; ifa = ifa->ifa_next) {
+		if (strcmp(ifa->ifa_name, if_name))
+			continue;
+		if (ifa->ifa_addr == NULL)
+			continue;
+		if (ifa->ifa_addr->sa_family != AF_INET)
+			continue;
+
+		memset(ip_str, 0, INET_ADDRSTRLEN);
+		tmp_ptr = &((struct sockaddr_in *)ifa->ifa_addr)->sin_addr;
+		if (inet_ntop(AF_INET, tmp_ptr, ip_str,
+			      INET_ADDRSTRLEN) == NULL) {
+			D_ERROR("inet_ntop failed, errno: %d(%s).\n",
+				errno, strerror(errno));
+			return -DER_PROTO;
+		}
+		D_DEBUG(DB_ALL, "interface %s, IPv4 address %s.\n",
+			if_name, ip_str);
+		return 0;
+	}
+
+	D_ERROR("no IP addr found for interface %s.\n", if_name);
+	return -DER_PROTO;
+}
+
 int crt_na_ofi_config_init(void)
 {
 	char		*port_str;
 	char		*interface;
+	char		*if_list = NULL;
+	char		*if_name;
+	char		*saveptr = NULL;
 	int		port;
 	struct ifaddrs	*if_addrs = NULL;
-	struct ifaddrs	*ifa = NULL;
-	void		*tmp_ptr;
-	const char	*ip_str = NULL;
+	int		rail_num = 0;
 	int		rc = 0;
 
 	interface = getenv("OFI_INTERFACE");
 	if (interface != NULL && strlen(interface) > 0) {
-		D_STRNDUP(crt_na_ofi_conf.noc_interface, interface, 64);
+		D_STRNDUP(crt_na_ofi_conf.noc_interface, interface,
+			  64 * CRT_NA_OFI_RAIL_MAX);
 		if (crt_na_ofi_conf.noc_interface == NULL)
 			D_GOTO(out, rc = -DER_NOMEM);
 	} else {
@@ -599,47 +685,43 @@ int crt_na_ofi_config_init(void)
 		D_GOTO(out, rc = -DER_PROTO);
 	}
 
-	for (ifa = if_addrs; ifa != NULL; ifa = ifa->ifa_next) {
-		if (strcmp(ifa->ifa_name, crt_na_ofi_conf.noc_interface))
-			continue;
-		if (ifa->ifa_addr == NULL)
-			continue;
-		memset(crt_na_ofi_conf.noc_ip_str, 0, INET_ADDRSTRLEN);
-		if (ifa->ifa_addr->sa_family == AF_INET) {
-			/* check it is a valid IPv4 Address */
-			tmp_ptr =
-			&((struct sockaddr_in *)ifa->ifa_addr)->sin_addr;
-			ip_str = inet_ntop(AF_INET, tmp_ptr,
-					   crt_na_ofi_conf.noc_ip_str,
-					   INET_ADDRSTRLEN);
-			if (ip_str == NULL) {
-				D_ERROR("inet_ntop failed, errno: %d(%s).\n",
-					errno, strerror(errno));
-				freeifaddrs(if_addrs);
-				D_GOTO(out, rc = -DER_PROTO);
-			}
-			/*
-			 * D_DEBUG("Get interface %s IPv4 Address %s\n",
-			 * ifa->ifa_name, na_ofi_conf.noc_ip_str);
-			 */
+	/* OFI_INTERFACE can list several interfaces, one rail for each */
+	D_STRNDUP(if_list, crt_na_ofi_conf.noc_interface,
+		  64 * CRT_NA_OFI_RAIL_MAX);
+	if (if_list == NULL) {
+		freeifaddrs(if_addrs);
+		D_GOTO(out, rc = -DER_NOMEM);
+	}
+	for (if_name = strtok_r(if_list, ",", &saveptr); if_name != NULL;
+	     if_name = strtok_r(NULL, ",", &saveptr)) {
+		if (rail_num == CRT_NA_OFI_RAIL_MAX) {
+			D_WARN("OFI_INTERFACE lists more than %d interfaces, "
+			       "ignore %s and after.\n", CRT_NA_OFI_RAIL_MAX,
+			       if_name);
 			break;
-		} else if (ifa->ifa_addr->sa_family == AF_INET6) {
-			/* check it is a valid IPv6 Address */
-			/*
-			 * tmp_ptr =
-			 * &((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr;
-			 * inet_ntop(AF_INET6, tmp_ptr, na_ofi_conf.noc_ip_str,
-			 *           INET6_ADDRSTRLEN);
-			 * D_DEBUG("Get %s IPv6 Address %s\n",
-			 *         ifa->ifa_name, na_ofi_conf.noc_ip_str);
-			 */
 		}
+		rc = crt_na_ofi_if_ip(if_addrs, if_name,
+				crt_na_ofi_conf.noc_rail_ip_str[rail_num]);
+		if (rc != 0)
+			break;
+		rail_num++;
 	}
+	D_FREE(if_list);
 	freeifaddrs(if_addrs);
-	if (ip_str == NULL) {
-		D_ERROR("no IP addr found.\n");
-		D_GOTO(out, rc = -DER_PROTO);
+	if (rc != 0)
+		D_GOTO(out, rc);
+	if (rail_num == 0) {
+		D_ERROR("no interface found in OFI_INTERFACE %s.\n",
+			crt_na_ofi_conf.noc_interface);
+		D_GOTO(out, rc = -DER_INVAL);
 	}
+	crt_na_ofi_conf.noc_rail_num = rail_num;
+	strncpy(crt_na_ofi_conf.noc_ip_str, crt_na_ofi_conf.noc_rail_ip_str[0],
+		INET_ADDRSTRLEN);
+	if (rail_num > 1 && crt_gdata.cg_share_na)
+		D_WARN("%d interfaces in OFI_INTERFACE, but contexts share "
+		       "one NA class, only the first one is used.\n",
+		       rail_num);
 
 	rc = crt_get_port(&port);
 	if (rc != 0) {
@@ -661,11 +743,28 @@ int crt_na_ofi_config_init(void)
 	crt_na_ofi_conf.noc_port = port;
 
 out:
+	if (rc != 0)
+		D_FREE(crt_na_ofi_conf.noc_interface);
 	return rc;
 }
 
+/*
+ * The rail (index of the interface in OFI_INTERFACE) of a context, contexts
+ * are bound to the rails round-robin so that the traffic of different
+ * contexts goes through different NICs.
+ */
+int
+crt_na_ofi_rail(int ctx_idx)
+{
+	if (crt_na_ofi_conf.noc_rail_num <= 1 || crt_gdata.cg_share_na)
+		return 0;
+
+	return ctx_idx % crt_na_ofi_conf.noc_rail_num;
+}
+
 void crt_na_ofi_config_fini(void)
 {
 	D_FREE(crt_na_ofi_conf.noc_interface);
 	crt_na_ofi_conf.noc_port = 0;
+	crt_na_ofi_conf.noc_rail_num = 0;
 }
@@ -56,8 +56,10 @@
 #include "crt_tree.h"
 #include "crt_self_test.h"
 #include "crt_ctl.h"
+#include "crt_buf.h"
 
 #include "crt_pmix.h"
+#include "crt_boot.h"
 #include "crt_lm.h"
 
 #endif /* __CRT_INTERNAL_H__ */
@@ -46,6 +46,11 @@
 /** crt_init.c */
 bool crt_initialized(void);
 
+/** crt_host.c */
+void crt_host_id_init(void);
+bool crt_host_id_is_local(const struct crt_host_id *id);
+uint64_t crt_uri_host_key(const char *uri);
+
 /** crt_register.c */
 int crt_opc_map_create(unsigned int bits);
 int crt_opc_map_create_legacy(unsigned int bits);
@@ -86,6 +91,13 @@ crt_is_singleton()
 	return crt_gdata.cg_singleton;
 }
 
+/* ranks and URIs are exchanged through the file based bootstrap, not PMIx */
+static inline bool
+crt_is_bootstrap()
+{
+	return crt_gdata.cg_boot;
+}
+
 static inline void
 crt_bulk_desc_dup(struct crt_bulk_desc *bulk_desc_new,
 		  struct crt_bulk_desc *bulk_desc)
@@ -51,17 +51,30 @@
 #include <gurt/list.h>
 #include <gurt/hash.h>
 #include <gurt/heap.h>
+#include <gurt/rank_set.h>
 
 struct crt_hg_gdata;
 struct crt_grp_gdata;
 
 /* CaRT global data */
+/* host a process runs on, see crt_host.c */
+struct crt_host_id {
+	/* boot id of the kernel */
+	uuid_t		chi_boot_id;
+	/* inode of the PID namespace */
+	uint64_t	chi_pid_ns;
+};
+
 struct crt_gdata {
 	crt_phy_addr_t		cg_addr;
 	uint32_t		cg_addr_len;
 
 	bool			cg_server;
 	bool			cg_singleton; /* true for singleton client */
+	/* file based bootstrap in use, see crt_boot.h */
+	bool			cg_boot;
+	/* size of the primary group with the file based bootstrap */
+	uint32_t		cg_boot_size;
 	/*
 	 * share NA addr flag, true means all contexts share one NA class, fasle
 	 * means each context has its own NA class.  Each NA class has an
@@ -69,6 +82,26 @@ struct crt_gdata {
 	 */
 	bool			cg_share_na;
 	int			cg_na_plugin; /* NA plugin type */
+	/*
+	 * shared-memory bulk flag, true means bulk transfers with a peer on
+	 * the same host use cross-memory attach instead of the NA plugin.
+	 */
+	bool			cg_bulk_sm;
+	/*
+	 * shared-memory routing flag, true means the HG classes also open an
+	 * SM NA class and RPCs to a peer on the same host go through it. The
+	 * published URI then carries both the SM and the fabric address.
+	 */
+	bool			cg_auto_sm;
+	/* use registered buffer pools for internal corpc and IV bulk */
+	bool			cg_buf_pool;
+	/* fetch all URIs of the primary service group at init time */
+	bool			cg_uri_prefetch;
+	/* log2 of the corpc chained bulk segment size, 0 to not pipeline */
+	uint32_t		cg_corpc_seg_shift;
+	/* pid and host id, sent in every RPC header */
+	uint32_t		cg_pid;
+	struct crt_host_id	cg_host_id;
 
 	/* global timeout value (second) for all RPCs */
 	uint32_t		cg_timeout;
@@ -158,11 +191,18 @@ extern struct crt_plugin_gdata		crt_plugin_gdata;
 # define CRT_SRV_CONTEXT_NUM		(256)
 #endif
 
+#define MAX_HOSTNAME_SIZE 1024
+
 /* (1 << CRT_EPI_TABLE_BITS) is the number of buckets of epi hash table */
 #define CRT_EPI_TABLE_BITS		(3)
 #define CRT_DEFAULT_CREDITS_PER_EP_CTX	(32)
 #define CRT_MAX_CREDITS_PER_EP_CTX	(256)
 
+/* segment size of a pipelined corpc chained bulk, see crt_corpc_pipe_start */
+#define CRT_CORPC_SEG_SIZE_DEFAULT	(1U << 20)
+#define CRT_CORPC_SEG_SHIFT_MIN		(12)
+#define CRT_CORPC_SEG_SHIFT_MAX		(30)
+
 /* crt_context */
 struct crt_context {
 	d_list_t		 cc_link; /* link to gdata.cg_ctx_list */
@@ -174,10 +214,15 @@ struct crt_context {
 	struct d_hash_table	 cc_epi_table;
 	/* binheap for inflight RPC timeout tracking */
 	struct d_binheap	 cc_bh_timeout;
-	/* mutex to protect cc_epi_table and timeout binheap */
+	/* batched URI lookups to attached groups, see crt_grp_uri_lookup() */
+	d_list_t		 cc_ul_batches;
+	/* mutex to protect cc_epi_table, timeout binheap and cc_ul_batches */
 	pthread_mutex_t		 cc_mutex;
 	/* timeout per-context */
 	uint32_t		 cc_timeout_sec;
+	/* internal registered buffer pool, see crt_context_buf_pool() */
+	struct crt_buf_pool	*cc_buf_pool;
+	uint32_t		 cc_buf_pool_failed:1;
 };
 
 /* in-flight RPC req list, be tracked per endpoint for every crt_context */
@@ -193,6 +238,7 @@ struct crt_ep_inflight {
 	/* (ei_req_num - ei_reply_num) is the number of inflight req */
 	int64_t			 epi_req_num; /* total number of req send */
 	int64_t			 epi_reply_num; /* total number of reply recv */
+	int64_t			 epi_sm_reply_num; /* reply recv over SM route */
 	/* RPC req wait queue */
 	d_list_t		 epi_req_waitq;
 	int64_t			 epi_req_wait_num;
@@ -206,7 +252,8 @@ struct crt_ep_inflight {
 
 #define CRT_UNLOCK			(0)
 #define CRT_LOCKED			(1)
-#define CRT_ADDR_STR_MAX_LEN		(128)
+/* large enough for a URI carrying both an SM and a fabric address */
+#define CRT_ADDR_STR_MAX_LEN		(256)
 
 #define CRT_OPC_MAP_BITS	8
 #define CRT_OPC_MAP_BITS_LEGACY	12
@@ -274,15 +321,23 @@ struct crt_opc_map {
 	struct crt_opc_map_L2	*com_map;
 };
 
+/* max number of interfaces (rails) listed in ENV OFI_INTERFACE */
+#define CRT_NA_OFI_RAIL_MAX	(8)
+
 struct na_ofi_config {
 	int32_t		 noc_port;
+	/* the OFI_INTERFACE string, a comma separated list of interfaces */
 	char		*noc_interface;
-	/* IP addr str for the noc_interface */
+	/* IP addr str for the first interface */
 	char		 noc_ip_str[INET_ADDRSTRLEN];
+	/* number of rails, noc_rail_ip_str[0] is the same as noc_ip_str */
+	int		 noc_rail_num;
+	char		 noc_rail_ip_str[CRT_NA_OFI_RAIL_MAX][INET_ADDRSTRLEN];
 };
 
 int crt_na_ofi_config_init(void);
 void crt_na_ofi_config_fini(void);
+int crt_na_ofi_rail(int ctx_idx);
 
 extern struct na_ofi_config crt_na_ofi_conf;
 
@@ -97,6 +97,8 @@ struct crt_global_ns {
 	uint32_t		gn_num_class;
 	/* Associated tree topology */
 	int			gn_tree_topo;
+	/* host map of a CRT_TREE_HIER tree, see crt_tree_hier_resolve() */
+	uint64_t		gn_host_map;
 	/* Associated group ID */
 	uint64_t		gn_int_grp_id;
 
@@ -767,6 +769,7 @@ crt_iv_namespace_create(crt_context_t crt_ctx, crt_group_t *grp, int tree_topo,
 {
 	struct crt_ivns_internal	*ivns_internal = NULL;
 	struct crt_grp_priv		*grp_priv = NULL;
+	uint64_t			host_map;
 	int				rc = 0;
 
 	if (ivns == NULL || g_ivns == NULL) {
@@ -782,6 +785,11 @@ crt_iv_namespace_create(crt_context_t crt_ctx, crt_group_t *grp, int tree_topo,
 	/* decref done in crt_iv_namespace_destroy */
 	crt_grp_priv_addref(grp_priv);
 
+	/* the tree is fixed for the namespace, IV messages are small */
+	if (crt_tree_type(tree_topo) == CRT_TREE_AUTO)
+		tree_topo = crt_tree_auto_select(grp_priv, 0, 0);
+	tree_topo = crt_tree_hier_resolve(tree_topo, &host_map);
+
 	ivns_internal = crt_ivns_internal_create(crt_ctx, grp_priv,
 						iv_classes, num_class,
 						tree_topo, NULL);
@@ -790,6 +798,7 @@ crt_iv_namespace_create(crt_context_t crt_ctx, crt_group_t *grp, int tree_topo,
 		D_GOTO(exit, rc = -DER_NOMEM);
 	}
 
+	ivns_internal->cii_gns.gn_host_map = host_map;
 	*ivns = (crt_iv_namespace_t)ivns_internal;
 
 	/* TODO: Need to flatten the structure */
@@ -843,6 +852,11 @@ crt_iv_namespace_attach(crt_context_t crt_ctx, d_iov_t *g_ivns,
 		D_GOTO(exit, rc = -DER_NOMEM);
 	}
 
+	rc = crt_tree_hier_check(ivns_global->gn_tree_topo,
+				 ivns_global->gn_host_map);
+	if (rc != 0)
+		D_GOTO(exit, rc);
+
 	ivns_internal = crt_ivns_internal_create(crt_ctx, grp_priv,
 					iv_classes, num_class,
 					ivns_global->gn_tree_topo,
@@ -851,6 +865,7 @@ crt_iv_namespace_attach(crt_context_t crt_ctx, d_iov_t *g_ivns,
 		D_ERROR("Failed to create new ivns internal\n");
 		D_GOTO(exit, rc = -DER_NOMEM);
 	}
+	ivns_internal->cii_gns.gn_host_map = ivns_global->gn_host_map;
 
 	*ivns = (crt_iv_namespace_t)ivns_internal;
 
@@ -1286,7 +1301,7 @@ crt_iv_ranks_parent_get(struct crt_ivns_internal *ivns_internal,
 
 	D_ASSERT(ivns_internal->cii_grp_priv != NULL);
 
-	rc = crt_tree_get_parent(ivns_internal->cii_grp_priv, 0, NULL,
+	rc = crt_tree_get_parent(ivns_internal->cii_grp_priv, 0, NULL, false,
 			ivns_internal->cii_gns.gn_tree_topo, root_node,
 			cur_node, &parent_rank);
 	if (rc == 0)
@@ -2331,8 +2346,26 @@ struct bulk_update_cb_info {
 	d_sg_list_t		buc_iv_value;
 	/* Users private data */
 	void			*buc_user_priv;
+	/* Pooled buffer the value was pulled into, if any */
+	struct crt_buf		*buc_buf;
 };
 
+/* Copy the value pulled into a pooled buffer out to the IV value */
+static void
+crt_iv_buf_copy_out(struct crt_buf *buf, d_sg_list_t *iv_value)
+{
+	size_t	off = 0;
+	size_t	len;
+	int	i;
+
+	for (i = 0; i < iv_value->sg_nr && off < buf->cb_len; i++) {
+		len = min(iv_value->sg_iovs[i].iov_buf_len, buf->cb_len - off);
+		memcpy(iv_value->sg_iovs[i].iov_buf,
+		       (char *)buf->cb_buf + off, len);
+		off += len;
+	}
+}
+
 static int
 bulk_update_transfer_done(const struct crt_bulk_cb_info *info)
 {
@@ -2366,6 +2399,12 @@ bulk_update_transfer_done(const struct crt_bulk_cb_info *info)
 		D_GOTO(send_error, rc = info->bci_rc);
 	}
 
+	if (cb_info->buc_buf != NULL) {
+		crt_iv_buf_copy_out(cb_info->buc_buf, &cb_info->buc_iv_value);
+		crt_buf_put(cb_info->buc_buf);
+		cb_info->buc_buf = NULL;
+	}
+
 	update_rc = iv_ops->ivo_on_update(ivns_internal,
 			&input->ivu_key, 0, false, &cb_info->buc_iv_value,
 			cb_info->buc_user_priv);
@@ -2430,6 +2469,8 @@ exit:
 	return rc;
 
 send_error:
+	if (cb_info->buc_buf != NULL)
+		crt_buf_put(cb_info->buc_buf);
 	rc = crt_bulk_free(cb_info->buc_bulk_hdl);
 	D_FREE_PTR(cb_info);
 	D_FREE_PTR(update_cb_info);
@@ -2455,11 +2496,13 @@ crt_hdlr_iv_update(crt_rpc_t *rpc_req)
 	struct crt_iv_ops		*iv_ops;
 	d_sg_list_t			iv_value = {0};
 	struct crt_bulk_desc		bulk_desc;
-	crt_bulk_t			local_bulk_handle;
+	crt_bulk_t			local_bulk_handle = CRT_BULK_NULL;
 	struct bulk_update_cb_info	*cb_info;
 	crt_iv_sync_t			*sync_type;
 	d_rank_t			next_rank;
 	struct update_cb_info		*update_cb_info;
+	struct crt_buf_pool		*pool;
+	struct crt_buf			*buf = NULL;
 	int				size;
 	void				*user_priv;
 	int				i;
@@ -2545,23 +2588,40 @@ crt_hdlr_iv_update(crt_rpc_t *rpc_req)
 	for (i = 0; i < iv_value.sg_nr; i++)
 		size += iv_value.sg_iovs[i].iov_buf_len;
 
-	rc = crt_bulk_create(rpc_req->cr_ctx, &iv_value, CRT_BULK_RW,
-			&local_bulk_handle);
-	if (rc != 0) {
-		D_ERROR("crt_bulk_create() failed; rc=%d\n", rc);
-		D_GOTO(send_error, rc);
-	}
-
 	bulk_desc.bd_rpc = rpc_req;
 	bulk_desc.bd_bulk_op = CRT_BULK_GET;
 	bulk_desc.bd_remote_hdl = input->ivu_iv_value_bulk;
 	bulk_desc.bd_remote_off = 0;
-	bulk_desc.bd_local_hdl = local_bulk_handle;
-	bulk_desc.bd_local_off = 0;
 	bulk_desc.bd_len = size;
 
+	/*
+	 * Pull the value into a pre-registered pooled buffer rather than
+	 * registering the user's sgl for every update. Bidirectional syncs
+	 * transfer the value back through the same handle, so keep
+	 * registering the sgl for those.
+	 */
+	sync_type = (crt_iv_sync_t *)input->ivu_sync_type.iov_buf;
+	pool = crt_context_buf_pool(rpc_req->cr_ctx);
+	if (pool != NULL &&
+	    !(sync_type->ivs_flags & CRT_IV_SYNC_BIDIRECTIONAL) &&
+	    crt_buf_get(pool, size, &buf) == 0) {
+		bulk_desc.bd_local_hdl = buf->cb_bulk_hdl;
+		bulk_desc.bd_local_off = buf->cb_bulk_off;
+	} else {
+		rc = crt_bulk_create(rpc_req->cr_ctx, &iv_value, CRT_BULK_RW,
+				&local_bulk_handle);
+		if (rc != 0) {
+			D_ERROR("crt_bulk_create() failed; rc=%d\n", rc);
+			D_GOTO(send_error, rc);
+		}
+		bulk_desc.bd_local_hdl = local_bulk_handle;
+		bulk_desc.bd_local_off = 0;
+	}
+
 	D_ALLOC_PTR(cb_info);
 	if (cb_info == NULL) {
+		if (buf != NULL)
+			crt_buf_put(buf);
 		crt_bulk_free(local_bulk_handle);
 		D_GOTO(send_error, rc = -DER_NOMEM);
 	}
@@ -2571,6 +2631,7 @@ crt_hdlr_iv_update(crt_rpc_t *rpc_req)
 	cb_info->buc_bulk_hdl = local_bulk_handle;
 	cb_info->buc_iv_value = iv_value;
 	cb_info->buc_user_priv = user_priv;
+	cb_info->buc_buf = buf;
 
 	RPC_PUB_ADDREF(rpc_req);
 
@@ -2578,7 +2639,10 @@ crt_hdlr_iv_update(crt_rpc_t *rpc_req)
 				cb_info, 0);
 	if (rc != 0) {
 		D_ERROR("crt_bulk_transfer() failed; rc=%d\n", rc);
+		if (buf != NULL)
+			crt_buf_put(buf);
 		crt_bulk_free(local_bulk_handle);
+		D_FREE_PTR(cb_info);
 		RPC_PUB_DECREF(rpc_req);
 		D_GOTO(send_error, rc);
 	}
@@ -2812,7 +2876,7 @@ crt_iv_get_nchildren(crt_iv_namespace_t ivns, uint32_t class_id,
 		D_GOTO(exit, rc);
 	}
 
-	rc = crt_tree_get_nchildren(ivns_internal->cii_grp_priv, 0, NULL,
+	rc = crt_tree_get_nchildren(ivns_internal->cii_grp_priv, 0, NULL, false,
 		ivns_internal->cii_gns.gn_tree_topo, root_rank, self_rank,
 		nchildren);
 	if (rc != 0)
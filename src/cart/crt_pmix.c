@@ -68,6 +68,11 @@ crt_pmix_init(void)
 		pmix_gdata->pg_num_apps = 1;
 		D_GOTO(bypass_pmix, rc);
 	}
+	if (crt_is_bootstrap()) {
+		pmix_gdata->pg_univ_size = crt_gdata.cg_boot_size;
+		pmix_gdata->pg_num_apps = 1;
+		D_GOTO(bypass_pmix, rc);
+	}
 
 	rc = PMIx_Init(&pmix_gdata->pg_proc, NULL, 0);
 	if (rc != PMIX_SUCCESS) {
@@ -147,7 +152,7 @@ crt_pmix_fini(void)
 
 	pmix_gdata = grp_gdata->gg_pmix;
 
-	if (crt_is_singleton())
+	if (crt_is_singleton() || crt_is_bootstrap())
 		goto bypass;
 
 	rc = PMIx_Finalize(NULL, 0);
@@ -484,6 +489,9 @@ crt_pmix_uri_lookup(crt_group_id_t srv_grpid, d_rank_t rank, char **uri)
 	if (len == 0 || len > CRT_GROUP_ID_MAX_LEN)
 		D_GOTO(out, rc = -DER_INVAL);
 
+	if (crt_is_bootstrap())
+		D_GOTO(out, rc = crt_boot_uri_lookup(srv_grpid, rank, uri));
+
 	PMIX_PDATA_CREATE(pdata, 1);
 	if (pdata == NULL) {
 		D_ERROR("PMIX_PDATA_CREATE returned NULL\n");
@@ -516,6 +524,159 @@ out:
 	return rc;
 }
 
+struct crt_pmix_ul {
+	/* NULL terminated key list of PMIx_Lookup_nb() */
+	char			*pu_keys[2];
+	char			 pu_key[PMIX_MAX_KEYLEN + 1];
+	crt_pmix_uri_cb_t	 pu_cb;
+	void			*pu_arg;
+};
+
+static void
+crt_pmix_uri_lookup_nb_cb(pmix_status_t status, pmix_pdata_t data[],
+			  size_t ndata, void *cbdata)
+{
+	struct crt_pmix_ul	*pu = cbdata;
+	char			*uri = NULL;
+	int			 rc = 0;
+
+	if (status != PMIX_SUCCESS || ndata != 1 ||
+	    data[0].value.type != PMIX_STRING) {
+		D_ERROR("PMIx_Lookup_nb %s failed, rc %d, ndata %zu.\n",
+			pu->pu_key, status, ndata);
+		D_GOTO(out, rc = -DER_PMIX);
+	}
+	uri = data[0].value.data.string;
+	if (strnlen(uri, CRT_ADDR_STR_MAX_LEN) == CRT_ADDR_STR_MAX_LEN) {
+		D_ERROR("got bad uri for %s.\n", pu->pu_key);
+		uri = NULL;
+		rc = -DER_INVAL;
+	}
+
+out:
+	pu->pu_cb(uri, rc, pu->pu_arg);
+	D_FREE_PTR(pu);
+}
+
+/**
+ * Non-blocking version of crt_pmix_uri_lookup(). cb is called from the PMIx
+ * progress thread, with a uri only valid until it returns. It is not called
+ * if this function fails.
+ */
+int
+crt_pmix_uri_lookup_nb(crt_group_id_t srv_grpid, d_rank_t rank,
+		       crt_pmix_uri_cb_t cb, void *arg)
+{
+	struct crt_pmix_ul	*pu;
+	size_t			 len;
+	int			 rc;
+
+	if (srv_grpid == NULL || cb == NULL)
+		return -DER_INVAL;
+	len = strlen(srv_grpid);
+	if (len == 0 || len > CRT_GROUP_ID_MAX_LEN)
+		return -DER_INVAL;
+	/* crt_boot_assign_rank() cached all URIs, a miss is an unknown rank */
+	if (crt_is_bootstrap()) {
+		D_ERROR("group %s has no URI for rank %d.\n", srv_grpid, rank);
+		return -DER_NONEXIST;
+	}
+
+	D_ALLOC_PTR(pu);
+	if (pu == NULL)
+		return -DER_NOMEM;
+	snprintf(pu->pu_key, PMIX_MAX_KEYLEN + 1, "cart-%s-%d-uri",
+		 srv_grpid, rank);
+	pu->pu_keys[0] = pu->pu_key;
+	pu->pu_keys[1] = NULL;
+	pu->pu_cb = cb;
+	pu->pu_arg = arg;
+
+	rc = PMIx_Lookup_nb(pu->pu_keys, NULL, 0, crt_pmix_uri_lookup_nb_cb,
+			    pu);
+	if (rc != PMIX_SUCCESS) {
+		D_ERROR("PMIx_Lookup_nb %s failed, rc %d.\n", pu->pu_key, rc);
+		D_FREE_PTR(pu);
+		return -DER_PMIX;
+	}
+
+	return 0;
+}
+
+/**
+ * Fetch the URIs published by all ranks of the local service group and fill
+ * them in its lookup cache, CRT_PMIX_PREFETCH_NR keys per PMIx round trip.
+ * Must be called after the crt_pmix_fence() following crt_pmix_publish_self().
+ */
+int
+crt_pmix_uri_prefetch(struct crt_grp_priv *grp_priv)
+{
+	pmix_pdata_t	*pdata = NULL;
+	d_rank_t	 rank;
+	d_rank_t	 start;
+	uint32_t	 nr;
+	uint32_t	 i;
+	int		 rc = 0;
+
+	D_ASSERT(grp_priv != NULL);
+	D_ASSERT(grp_priv->gp_local && grp_priv->gp_primary);
+
+	if (!grp_priv->gp_service)
+		return 0;
+
+	rc = crt_grp_lc_uri_insert(grp_priv, 0, grp_priv->gp_self, 0,
+				   crt_gdata.cg_addr);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	for (start = 0; start < grp_priv->gp_size; start += nr) {
+		nr = min(grp_priv->gp_size - start, CRT_PMIX_PREFETCH_NR);
+		PMIX_PDATA_CREATE(pdata, nr);
+		if (pdata == NULL) {
+			D_ERROR("PMIX_PDATA_CREATE returned NULL\n");
+			D_GOTO(out, rc = -DER_NOMEM);
+		}
+
+		for (i = 0; i < nr; i++)
+			snprintf(pdata[i].key, PMIX_MAX_KEYLEN + 1,
+				 "cart-%s-%d-uri", grp_priv->gp_pub.cg_grpid,
+				 start + i);
+		rc = PMIx_Lookup(pdata, nr, NULL, 0);
+		if (rc != PMIX_SUCCESS) {
+			D_ERROR("PMIx_Lookup of ranks [%d, %d) failed, "
+				"rc %d.\n", start, start + nr, rc);
+			D_GOTO(out, rc = -DER_PMIX);
+		}
+
+		for (i = 0; i < nr; i++) {
+			rank = start + i;
+			if (rank == grp_priv->gp_self)
+				continue;
+			if (pdata[i].value.type != PMIX_STRING) {
+				D_ERROR("PMIx_Lookup %s, value type: %d.\n",
+					pdata[i].key, pdata[i].value.type);
+				D_GOTO(out, rc = -DER_PMIX);
+			}
+			rc = crt_grp_lc_uri_insert(grp_priv, 0, rank, 0,
+					pdata[i].value.data.string);
+			if (rc != 0)
+				D_GOTO(out, rc);
+		}
+		PMIX_PDATA_FREE(pdata, nr);
+		pdata = NULL;
+	}
+	D_DEBUG(DB_TRACE, "group %s, prefetched URIs of %d ranks.\n",
+		grp_priv->gp_pub.cg_grpid, grp_priv->gp_size);
+
+out:
+	if (pdata != NULL)
+		PMIX_PDATA_FREE(pdata, nr);
+	if (rc != 0)
+		D_ERROR("crt_pmix_uri_prefetch(grp %s) failed, rc: %d.\n",
+			grp_priv->gp_pub.cg_grpid, rc);
+	return rc;
+}
+
 int
 crt_pmix_psr_load(struct crt_grp_priv *grp_priv, d_rank_t psr_rank)
 {
@@ -696,7 +857,7 @@ crt_plugin_pmix_init(void)
 	sem_t	token_to_proceed;
 	int	rc;
 
-	if (!crt_is_service() || crt_is_singleton())
+	if (!crt_is_service() || crt_is_singleton() || crt_is_bootstrap())
 		return -DER_INVAL;
 
 	D_RWLOCK_WRLOCK(&crt_plugin_gdata.cpg_event_rwlock);
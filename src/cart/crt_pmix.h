@@ -55,6 +55,12 @@ struct crt_pmix_gdata {
 	uint32_t		pg_num_apps;
 };
 
+/* number of URIs fetched per PMIx_Lookup() by crt_pmix_uri_prefetch() */
+#define CRT_PMIX_PREFETCH_NR	(1024)
+
+/* completion callback of crt_pmix_uri_lookup_nb() */
+typedef void (*crt_pmix_uri_cb_t)(const char *uri, int rc, void *arg);
+
 
 int crt_pmix_init(void);
 int crt_pmix_fini(void);
@@ -62,6 +68,9 @@ int crt_pmix_fence(void);
 int crt_pmix_assign_rank(struct crt_grp_priv *grp_priv);
 int crt_pmix_publish_self(struct crt_grp_priv *grp_priv);
 int crt_pmix_uri_lookup(crt_group_id_t srv_grpid, d_rank_t rank, char **uri);
+int crt_pmix_uri_lookup_nb(crt_group_id_t srv_grpid, d_rank_t rank,
+			   crt_pmix_uri_cb_t cb, void *arg);
+int crt_pmix_uri_prefetch(struct crt_grp_priv *grp_priv);
 int crt_pmix_attach(struct crt_grp_priv *grp_priv);
 void crt_pmix_reg_event_hdlr(struct crt_grp_priv *grp_priv);
 void crt_pmix_dereg_event_hdlr(struct crt_grp_priv *grp_priv);
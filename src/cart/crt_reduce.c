@@ -0,0 +1,264 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of CaRT. It implements the built-in reductions of
+ * collective RPC replies, see struct crt_corpc_reduce.
+ *
+ * The kernels work on GCC vector types so that the element-wise loops compile
+ * to SIMD instructions whatever the optimization level, the tail shorter than
+ * one vector is done element by element. Sum and the bitwise operations do not
+ * depend on the signedness and run on unsigned elements, so that overflows
+ * wrap around.
+ */
+#define D_LOGFAC	DD_FAC(corpc)
+
+#include "crt_internal.h"
+
+/* bytes processed per vector operation */
+#define CRT_REDUCE_VEC_BYTES	(32)
+
+typedef uint32_t crt_v_u32 __attribute__((vector_size(CRT_REDUCE_VEC_BYTES)));
+typedef int32_t crt_v_i32 __attribute__((vector_size(CRT_REDUCE_VEC_BYTES)));
+typedef uint64_t crt_v_u64 __attribute__((vector_size(CRT_REDUCE_VEC_BYTES)));
+typedef int64_t crt_v_i64 __attribute__((vector_size(CRT_REDUCE_VEC_BYTES)));
+typedef double crt_v_f64 __attribute__((vector_size(CRT_REDUCE_VEC_BYTES)));
+
+typedef void (*crt_reduce_kernel_t)(void *dst, const void *src_a,
+				    const void *src_b, size_t nr);
+
+/* select a where the mask m is set and b elsewhere, m is of integer type mt */
+#define CRT_REDUCE_VSEL(vt, mt, m, a, b)				\
+	((vt)(((mt)(a) & (m)) | ((mt)(b) & ~(m))))
+
+/*
+ * Define kernel name computing dst[i] = a[i] op b[i]: vop is the operation on
+ * two vectors of type vt, sop the one on two elements of type t. dst may be the
+ * same array as a or b.
+ */
+#define CRT_REDUCE_KERNEL(name, t, vt, vop, sop)			\
+static void								\
+name(void *dst, const void *src_a, const void *src_b, size_t nr)	\
+{									\
+	const size_t	 lanes = CRT_REDUCE_VEC_BYTES / sizeof(t);	\
+	t		*d = dst;					\
+	const t		*pa = src_a;					\
+	const t		*pb = src_b;					\
+	vt		 a, b;						\
+	t		 x, y;						\
+	size_t		 i = 0;						\
+									\
+	for (; i + lanes <= nr; i += lanes) {				\
+		memcpy(&a, pa + i, sizeof(a));				\
+		memcpy(&b, pb + i, sizeof(b));				\
+		a = vop;						\
+		memcpy(d + i, &a, sizeof(a));				\
+	}								\
+	for (; i < nr; i++) {						\
+		x = pa[i];						\
+		y = pb[i];						\
+		d[i] = sop;						\
+	}								\
+}
+
+CRT_REDUCE_KERNEL(crt_reduce_sum_u32, uint32_t, crt_v_u32,
+		  a + b, x + y)
+CRT_REDUCE_KERNEL(crt_reduce_band_u32, uint32_t, crt_v_u32,
+		  a & b, x & y)
+CRT_REDUCE_KERNEL(crt_reduce_bor_u32, uint32_t, crt_v_u32,
+		  a | b, x | y)
+CRT_REDUCE_KERNEL(crt_reduce_bxor_u32, uint32_t, crt_v_u32,
+		  a ^ b, x ^ y)
+CRT_REDUCE_KERNEL(crt_reduce_min_i32, int32_t, crt_v_i32,
+		  CRT_REDUCE_VSEL(crt_v_i32, crt_v_i32, a < b, a, b),
+		  x < y ? x : y)
+CRT_REDUCE_KERNEL(crt_reduce_max_i32, int32_t, crt_v_i32,
+		  CRT_REDUCE_VSEL(crt_v_i32, crt_v_i32, a > b, a, b),
+		  x > y ? x : y)
+
+CRT_REDUCE_KERNEL(crt_reduce_sum_u64, uint64_t, crt_v_u64,
+		  a + b, x + y)
+CRT_REDUCE_KERNEL(crt_reduce_band_u64, uint64_t, crt_v_u64,
+		  a & b, x & y)
+CRT_REDUCE_KERNEL(crt_reduce_bor_u64, uint64_t, crt_v_u64,
+		  a | b, x | y)
+CRT_REDUCE_KERNEL(crt_reduce_bxor_u64, uint64_t, crt_v_u64,
+		  a ^ b, x ^ y)
+CRT_REDUCE_KERNEL(crt_reduce_min_u64, uint64_t, crt_v_u64,
+		  CRT_REDUCE_VSEL(crt_v_u64, crt_v_u64, a < b, a, b),
+		  x < y ? x : y)
+CRT_REDUCE_KERNEL(crt_reduce_max_u64, uint64_t, crt_v_u64,
+		  CRT_REDUCE_VSEL(crt_v_u64, crt_v_u64, a > b, a, b),
+		  x > y ? x : y)
+CRT_REDUCE_KERNEL(crt_reduce_min_i64, int64_t, crt_v_i64,
+		  CRT_REDUCE_VSEL(crt_v_i64, crt_v_i64, a < b, a, b),
+		  x < y ? x : y)
+CRT_REDUCE_KERNEL(crt_reduce_max_i64, int64_t, crt_v_i64,
+		  CRT_REDUCE_VSEL(crt_v_i64, crt_v_i64, a > b, a, b),
+		  x > y ? x : y)
+
+CRT_REDUCE_KERNEL(crt_reduce_sum_f64, double, crt_v_f64,
+		  a + b, x + y)
+CRT_REDUCE_KERNEL(crt_reduce_min_f64, double, crt_v_f64,
+		  CRT_REDUCE_VSEL(crt_v_f64, crt_v_i64, a < b, a, b),
+		  x < y ? x : y)
+CRT_REDUCE_KERNEL(crt_reduce_max_f64, double, crt_v_f64,
+		  CRT_REDUCE_VSEL(crt_v_f64, crt_v_i64, a > b, a, b),
+		  x > y ? x : y)
+
+/* indexed by enum crt_reduce_type and enum crt_reduce_op */
+static const crt_reduce_kernel_t
+crt_reduce_kernels[CRT_REDUCE_TYPE_NR][CRT_REDUCE_OP_NR] = {
+	[CRT_REDUCE_INT32] = {
+		[CRT_REDUCE_SUM]	= crt_reduce_sum_u32,
+		[CRT_REDUCE_MIN]	= crt_reduce_min_i32,
+		[CRT_REDUCE_MAX]	= crt_reduce_max_i32,
+		[CRT_REDUCE_BAND]	= crt_reduce_band_u32,
+		[CRT_REDUCE_BOR]	= crt_reduce_bor_u32,
+		[CRT_REDUCE_BXOR]	= crt_reduce_bxor_u32,
+	},
+	[CRT_REDUCE_INT64] = {
+		[CRT_REDUCE_SUM]	= crt_reduce_sum_u64,
+		[CRT_REDUCE_MIN]	= crt_reduce_min_i64,
+		[CRT_REDUCE_MAX]	= crt_reduce_max_i64,
+		[CRT_REDUCE_BAND]	= crt_reduce_band_u64,
+		[CRT_REDUCE_BOR]	= crt_reduce_bor_u64,
+		[CRT_REDUCE_BXOR]	= crt_reduce_bxor_u64,
+	},
+	[CRT_REDUCE_UINT64] = {
+		[CRT_REDUCE_SUM]	= crt_reduce_sum_u64,
+		[CRT_REDUCE_MIN]	= crt_reduce_min_u64,
+		[CRT_REDUCE_MAX]	= crt_reduce_max_u64,
+		[CRT_REDUCE_BAND]	= crt_reduce_band_u64,
+		[CRT_REDUCE_BOR]	= crt_reduce_bor_u64,
+		[CRT_REDUCE_BXOR]	= crt_reduce_bxor_u64,
+	},
+	/* no bitwise operations on doubles */
+	[CRT_REDUCE_DOUBLE] = {
+		[CRT_REDUCE_SUM]	= crt_reduce_sum_f64,
+		[CRT_REDUCE_MIN]	= crt_reduce_min_f64,
+		[CRT_REDUCE_MAX]	= crt_reduce_max_f64,
+	},
+};
+
+static const size_t crt_reduce_type_size[CRT_REDUCE_TYPE_NR] = {
+	[CRT_REDUCE_INT32]	= sizeof(int32_t),
+	[CRT_REDUCE_INT64]	= sizeof(int64_t),
+	[CRT_REDUCE_UINT64]	= sizeof(uint64_t),
+	[CRT_REDUCE_DOUBLE]	= sizeof(double),
+};
+
+int
+crt_reduce_check(const struct crt_corpc_reduce *reduce, size_t output_size)
+{
+	if (reduce->cr_type < 0 || reduce->cr_type >= CRT_REDUCE_TYPE_NR ||
+	    reduce->cr_op < 0 || reduce->cr_op >= CRT_REDUCE_OP_NR ||
+	    crt_reduce_kernels[reduce->cr_type][reduce->cr_op] == NULL) {
+		D_ERROR("invalid reduction, type %d op %d.\n",
+			reduce->cr_type, reduce->cr_op);
+		return -DER_INVAL;
+	}
+	if (reduce->cr_offset + sizeof(d_iov_t) > output_size) {
+		D_ERROR("reduction offset %zu out of the reply size %zu.\n",
+			reduce->cr_offset, output_size);
+		return -DER_INVAL;
+	}
+
+	return 0;
+}
+
+void
+crt_reduce_array(int type, int op, void *dst, const void *src_a,
+		 const void *src_b, size_t nr)
+{
+	D_ASSERT(type >= 0 && type < CRT_REDUCE_TYPE_NR);
+	D_ASSERT(op >= 0 && op < CRT_REDUCE_OP_NR);
+	D_ASSERT(crt_reduce_kernels[type][op] != NULL);
+
+	crt_reduce_kernels[type][op](dst, src_a, src_b, nr);
+}
+
+/*
+ * Reduce the array of the source reply into the one of the result reply. The
+ * first reduction writes into a buffer owned by the result RPC (freed with it)
+ * and points the result's iov to it, so that the buffer the RPC handler put in
+ * its reply is never written to.
+ */
+int
+crt_reduce_reply(struct crt_rpc_priv *result_priv, crt_rpc_t *source,
+		 const struct crt_corpc_reduce *reduce)
+{
+	d_iov_t		*src_iov;
+	d_iov_t		*dst_iov;
+	size_t		 elem_size;
+	void		*buf;
+
+	src_iov = (d_iov_t *)((char *)source->cr_output + reduce->cr_offset);
+	dst_iov = (d_iov_t *)((char *)result_priv->crp_pub.cr_output +
+			      reduce->cr_offset);
+	elem_size = crt_reduce_type_size[reduce->cr_type];
+
+	/* nothing from this source */
+	if (src_iov->iov_len == 0)
+		return 0;
+
+	if (src_iov->iov_len % elem_size != 0 ||
+	    (dst_iov->iov_len != 0 && dst_iov->iov_len != src_iov->iov_len)) {
+		D_ERROR("cannot reduce %zu bytes into %zu bytes of %zu bytes "
+			"elements.\n", src_iov->iov_len, dst_iov->iov_len,
+			elem_size);
+		return -DER_PROTO;
+	}
+
+	buf = result_priv->crp_co_reduce_buf;
+	if (buf == NULL) {
+		D_ALLOC(buf, src_iov->iov_len);
+		if (buf == NULL)
+			return -DER_NOMEM;
+		result_priv->crp_co_reduce_buf = buf;
+	}
+
+	if (dst_iov->iov_len == 0)
+		memcpy(buf, src_iov->iov_buf, src_iov->iov_len);
+	else
+		crt_reduce_array(reduce->cr_type, reduce->cr_op, buf,
+				 dst_iov->iov_buf, src_iov->iov_buf,
+				 src_iov->iov_len / elem_size);
+
+	d_iov_set(dst_iov, buf, src_iov->iov_len);
+
+	return 0;
+}
@@ -606,6 +606,12 @@ crt_rpc_reg_internal_legacy(crt_opcode_t opc, uint32_t flags,
 	}
 
 reg_opc:
+	if (co_ops != NULL && co_ops->co_flags & CRT_CORPC_FLAG_REDUCE) {
+		rc = crt_reduce_check(&co_ops->co_reduce, output_size);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+
 	rc = crt_opc_reg_legacy(crt_gdata.cg_opc_map_legacy, opc, flags, crf,
 				input_size, output_size, rpc_handler, co_ops,
 				CRT_UNLOCK);
@@ -657,6 +663,13 @@ crt_opc_reg_internal(struct crt_opc_info *opc_info, crt_opcode_t opc,
 	}
 
 reg_opc:
+	if (prf->prf_co_ops != NULL &&
+	    prf->prf_co_ops->co_flags & CRT_CORPC_FLAG_REDUCE) {
+		rc = crt_reduce_check(&prf->prf_co_ops->co_reduce, output_size);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+
 	rc = crt_opc_reg(opc_info, opc, prf->prf_flags, crf, input_size,
 			 output_size, prf->prf_hdlr, prf->prf_co_ops);
 	if (rc != 0)
@@ -99,6 +99,39 @@ static struct crt_req_format CQF_CRT_URI_LOOKUP =
 	DEFINE_CRT_REQ_FMT("CRT_URI_LOOKUP", crt_uri_lookup_in_fields,
 			   crt_uri_lookup_out_fields);
 
+/* batched uri lookup */
+static struct crt_msg_field *crt_uri_lookup_batch_in_fields[] = {
+	&CMF_GRP_ID,		/* ulb_grp_id */
+	&CMF_IOVEC,		/* ulb_pairs */
+	&CMF_BULK,		/* ulb_bulk */
+};
+
+static struct crt_msg_field *crt_uri_lookup_batch_out_fields[] = {
+	&CMF_IOVEC,		/* ulb_uris */
+	&CMF_UINT32,		/* ulb_len */
+	&CMF_INT,		/* ulb_rc */
+};
+
+static struct crt_req_format CQF_CRT_URI_LOOKUP_BATCH =
+	DEFINE_CRT_REQ_FMT("CRT_URI_LOOKUP_BATCH",
+			   crt_uri_lookup_batch_in_fields,
+			   crt_uri_lookup_batch_out_fields);
+
+/* wait for segments of a pipelined corpc chained bulk */
+static struct crt_msg_field *crt_corpc_seg_wait_in_fields[] = {
+	&CMF_UINT32,		/* csw_id */
+	&CMF_UINT32,		/* csw_want */
+};
+
+static struct crt_msg_field *crt_corpc_seg_wait_out_fields[] = {
+	&CMF_UINT32,		/* csw_avail */
+	&CMF_INT,		/* csw_rc */
+};
+
+static struct crt_req_format CQF_CRT_CORPC_SEG_WAIT =
+	DEFINE_CRT_REQ_FMT("CRT_CORPC_SEG_WAIT", crt_corpc_seg_wait_in_fields,
+			   crt_corpc_seg_wait_out_fields);
+
 /* for self-test service */
 static struct crt_msg_field *crt_st_send_id_field[] = {
 	&CMF_UINT64,
@@ -209,6 +242,65 @@ static struct crt_req_format CQF_CRT_SELF_TEST_STATUS_REQ =
 			   crt_st_status_req_field,
 			   crt_st_status_req_reply_field);
 
+static struct crt_msg_field *crt_st_tree_sweep_field[] = {
+	&CMF_UINT32,		/* grp_size */
+	&CMF_UINT32,		/* tree_topo */
+	&CMF_UINT32,		/* payload */
+	&CMF_UINT32,		/* rep_count */
+};
+
+static struct crt_msg_field *crt_st_tree_sweep_reply_field[] = {
+	&CMF_UINT64,		/* test_duration_ns */
+	&CMF_UINT32,		/* tree_topo */
+	&CMF_INT,		/* status */
+};
+
+static struct crt_req_format CQF_CRT_SELF_TEST_TREE_SWEEP =
+	DEFINE_CRT_REQ_FMT("CRT_SELF_TEST_TREE_SWEEP",
+			   crt_st_tree_sweep_field,
+			   crt_st_tree_sweep_reply_field);
+
+static struct crt_msg_field *crt_st_tree_ping_field[] = {
+	&CMF_UINT32,		/* repetition */
+};
+
+static struct crt_req_format CQF_CRT_SELF_TEST_TREE_PING =
+	DEFINE_CRT_REQ_FMT("CRT_SELF_TEST_TREE_PING",
+			   crt_st_tree_ping_field,
+			   crt_st_start_reply_field);
+
+static struct crt_corpc_ops crt_st_tree_ping_co_ops = {
+	.co_aggregate = crt_self_test_tree_ping_aggregate,
+	.co_pre_forward = NULL,
+};
+
+static struct crt_msg_field *crt_st_coll_field[] = {
+	&CMF_UINT32,		/* coll_type */
+	&CMF_UINT32,		/* block_size */
+	&CMF_UINT32,		/* rep_count */
+};
+
+static struct crt_msg_field *crt_st_coll_reply_field[] = {
+	&CMF_UINT64,		/* test_duration_ns */
+	&CMF_UINT32,		/* grp_size */
+	&CMF_INT,		/* status */
+};
+
+static struct crt_req_format CQF_CRT_SELF_TEST_COLL_SWEEP =
+	DEFINE_CRT_REQ_FMT("CRT_SELF_TEST_COLL_SWEEP",
+			   crt_st_coll_field,
+			   crt_st_coll_reply_field);
+
+static struct crt_req_format CQF_CRT_SELF_TEST_COLL_RUN =
+	DEFINE_CRT_REQ_FMT("CRT_SELF_TEST_COLL_RUN",
+			   crt_st_coll_field,
+			   crt_st_coll_reply_field);
+
+static struct crt_corpc_ops crt_st_coll_run_co_ops = {
+	.co_aggregate = crt_self_test_coll_run_aggregate,
+	.co_pre_forward = NULL,
+};
+
 
 
 static struct crt_msg_field *crt_iv_fetch_in_fields[] = {
@@ -271,22 +363,41 @@ static struct crt_req_format CQF_CRT_IV_UPDATE =
 
 /* barrier */
 static struct crt_msg_field *crt_barrier_in_fields[] = {
-	&CMF_INT,		/* enter_num */
+	&CMF_UINT64,		/* b_num */
+	&CMF_UINT32,		/* b_ver */
+	&CMF_UINT32,		/* b_round */
 };
 
 static struct crt_msg_field *crt_barrier_out_fields[] = {
-	&CMF_INT,		/* barrier_rc */
+	&CMF_INT,		/* b_rc */
+	&CMF_UINT32,		/* b_done */
 };
 
 static struct crt_req_format CQF_CRT_BARRIER =
 	DEFINE_CRT_REQ_FMT("CRT_BARRIER", crt_barrier_in_fields,
 			   crt_barrier_out_fields);
 
-static struct crt_corpc_ops crt_barrier_corpc_ops = {
-	.co_aggregate = crt_hdlr_barrier_aggregate,
-	.co_pre_forward = NULL,
+/* allgather and all-to-all */
+static struct crt_msg_field *crt_coll_in_fields[] = {
+	&CMF_UINT64,		/* c_num */
+	&CMF_UINT64,		/* c_len */
+	&CMF_BULK,		/* c_bulk */
+	&CMF_UINT32,		/* c_ver */
+	&CMF_UINT32,		/* c_type */
+	&CMF_UINT32,		/* c_round */
+	&CMF_UINT32,		/* c_first */
+	&CMF_UINT32,		/* c_cnt */
+	&CMF_INT,		/* c_rc */
+};
+
+static struct crt_msg_field *crt_coll_out_fields[] = {
+	&CMF_INT,		/* c_rc */
 };
 
+static struct crt_req_format CQF_CRT_COLL =
+	DEFINE_CRT_REQ_FMT("CRT_COLL", crt_coll_in_fields,
+			   crt_coll_out_fields);
+
 /* for broadcasting RAS notifications on rank failures */
 struct crt_msg_field *crt_lm_evict_in_fields[] = {
 	&CMF_RANK,		/* failed rank */
@@ -458,6 +569,16 @@ crt_rpc_priv_free(struct crt_rpc_priv *rpc_priv)
 	if (rpc_priv->crp_coll && rpc_priv->crp_corpc_info)
 		crt_corpc_info_fini(rpc_priv);
 
+	/* chained bulk buffer of a corpc that failed before completion */
+	if (rpc_priv->crp_co_buf != NULL)
+		crt_buf_put(rpc_priv->crp_co_buf);
+
+	if (rpc_priv->crp_co_pipe != NULL)
+		crt_corpc_pipe_free(rpc_priv->crp_co_pipe);
+
+	if (rpc_priv->crp_co_reduce_buf != NULL)
+		D_FREE(rpc_priv->crp_co_reduce_buf);
+
 	if (rpc_priv->crp_uri_free != 0)
 		D_FREE(rpc_priv->crp_tgt_uri);
 
@@ -735,7 +856,7 @@ out:
 }
 
 static inline int
-crt_req_get_tgt_uri(struct crt_rpc_priv *rpc_priv, crt_phy_addr_t base_uri)
+crt_req_get_tgt_uri(struct crt_rpc_priv *rpc_priv, const char *base_uri)
 {
 	char		*tgt_uri = NULL;
 
@@ -748,6 +869,9 @@ crt_req_get_tgt_uri(struct crt_rpc_priv *rpc_priv, crt_phy_addr_t base_uri)
 
 	strncpy(tgt_uri, base_uri, CRT_ADDR_STR_MAX_LEN - 1);
 
+	/* a request sent again from RPC_STATE_INITED had one already */
+	if (rpc_priv->crp_uri_free != 0)
+		D_FREE(rpc_priv->crp_tgt_uri);
 	rpc_priv->crp_tgt_uri = tgt_uri;
 	rpc_priv->crp_uri_free = 1;
 
@@ -937,6 +1061,50 @@ out:
 	return rc;
 }
 
+/*
+ * Completion of the batched URI_LOOKUP of rpc_priv. URIs the PSR only knows by
+ * forwarding, and failed batches, go through the single URI_LOOKUP which
+ * retries with a reloaded PSR.
+ */
+static void
+crt_req_uri_batch_cb(const char *uri, int rc, void *arg)
+{
+	struct crt_rpc_priv	*rpc_priv = arg;
+
+	D_ASSERT(rpc_priv->crp_state == RPC_STATE_URI_LOOKUP);
+
+	if (rc == -DER_TIMEDOUT)
+		D_GOTO(out, rc);
+	if (rc != 0 || uri == NULL) {
+		rc = crt_req_uri_lookup_psr(rpc_priv, crt_req_uri_lookup_psr_cb,
+					    rpc_priv);
+		if (rc != 0)
+			D_ERROR("crt_req_uri_lookup_psr() failed, rc %d.\n",
+				rc);
+		D_GOTO(out, rc);
+	}
+
+	rc = crt_req_get_tgt_uri(rpc_priv, uri);
+	if (rc != 0) {
+		D_ERROR("crt_req_get_tgt_uri failed, opc: %#x.\n",
+			rpc_priv->crp_pub.cr_opc);
+		D_GOTO(out, rc);
+	}
+	rc = crt_req_send_internal(rpc_priv);
+	if (rc != 0)
+		D_ERROR("crt_req_send_internal() failed, rc %d, opc: %#x\n",
+			rc, rpc_priv->crp_pub.cr_opc);
+
+out:
+	if (rc != 0) {
+		crt_context_req_untrack(&rpc_priv->crp_pub);
+		crt_rpc_complete(rpc_priv, rc);
+		RPC_DECREF(rpc_priv); /* destroy */
+	}
+	/* addref in crt_req_uri_lookup */
+	RPC_DECREF(rpc_priv);
+}
+
 /* look in the local cache to find the NA address of the target */
 static int
 crt_req_ep_lc_lookup(struct crt_rpc_priv *rpc_priv, crt_phy_addr_t *base_addr)
@@ -1034,6 +1202,63 @@ crt_req_is_self(struct crt_rpc_priv *rpc_priv)
 	return (same_group && same_rank);
 }
 
+/*
+ * Completion of the PMIx lookup of the base URI of a rank of the local group,
+ * called from the PMIx progress thread.
+ */
+static void
+crt_req_pmix_uri_cb(const char *uri, int rc, void *arg)
+{
+	struct crt_rpc_priv	*rpc_priv = arg;
+	struct crt_grp_priv	*grp_priv;
+	struct crt_context	*crt_ctx;
+	crt_endpoint_t		*tgt_ep;
+	d_rank_t		 rank;
+
+	D_ASSERT(rpc_priv->crp_state == RPC_STATE_URI_LOOKUP);
+
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	tgt_ep = &rpc_priv->crp_pub.cr_ep;
+	if (tgt_ep->ep_grp == NULL)
+		grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
+	else
+		grp_priv = container_of(tgt_ep->ep_grp, struct crt_grp_priv,
+					gp_pub);
+	rank = tgt_ep->ep_rank;
+	if (grp_priv->gp_primary == 0)
+		rank = grp_priv->gp_membs->rl_ranks[rank];
+
+	crt_ctx = rpc_priv->crp_pub.cr_ctx;
+	rc = crt_grp_lc_uri_insert(crt_grp_pub2priv(NULL), crt_ctx->cc_idx,
+				   rank, 0, uri);
+	if (rc != 0) {
+		D_ERROR("crt_grp_lc_uri_insert() failed, rc %d\n", rc);
+		D_GOTO(out, rc);
+	}
+
+	rc = crt_req_get_tgt_uri(rpc_priv, uri);
+	if (rc != 0) {
+		D_ERROR("crt_req_get_tgt_uri failed, opc: %#x.\n",
+			rpc_priv->crp_pub.cr_opc);
+		D_GOTO(out, rc);
+	}
+	rc = crt_req_send_internal(rpc_priv);
+	if (rc != 0)
+		D_ERROR("crt_req_send_internal() failed, rc %d, opc: %#x\n",
+			rc, rpc_priv->crp_pub.cr_opc);
+
+out:
+	if (rc != 0) {
+		crt_context_req_untrack(&rpc_priv->crp_pub);
+		crt_rpc_complete(rpc_priv, rc);
+		RPC_DECREF(rpc_priv); /* destroy */
+	}
+	/* addref in crt_req_uri_lookup */
+	RPC_DECREF(rpc_priv);
+}
+
 /*
  * the case where we don't have the URI of the target rank
  */
@@ -1062,15 +1287,18 @@ crt_req_uri_lookup(struct crt_rpc_priv *rpc_priv)
 
 	/* this is a remote group, contact the PSR */
 	if (grp_priv->gp_local == 0) {
-		/* send an RPC to the PSR */
+		/* queue for a batched URI_LOOKUP to the PSR */
 		D_DEBUG(DB_NET, "Querying PSR to find out target "
 			"NA Address.\n");
-		rc = crt_req_uri_lookup_psr(rpc_priv, crt_req_uri_lookup_psr_cb,
-					rpc_priv);
+		/* decref in crt_req_uri_batch_cb */
+		RPC_ADDREF(rpc_priv);
+		rc = crt_grp_uri_lookup(rpc_priv->crp_pub.cr_ctx, grp_priv,
+					tgt_ep->ep_rank, tgt_ep->ep_tag,
+					crt_req_uri_batch_cb, rpc_priv);
 		if (rc != 0) {
+			RPC_DECREF(rpc_priv);
 			rpc_priv->crp_state = RPC_STATE_INITED;
-			D_ERROR("crt_grp_uri_lookup_psr() failed, rc %d.\n",
-				rc);
+			D_ERROR("crt_grp_uri_lookup() failed, rc %d.\n", rc);
 		}
 		D_GOTO(out, rc);
 	}
@@ -1089,13 +1317,18 @@ crt_req_uri_lookup(struct crt_rpc_priv *rpc_priv)
 			D_GOTO(out, rc = -DER_NOMEM);
 		}
 	} else {
-		/* lookup through PMIx */
+		/* lookup through PMIx, without blocking the caller */
 		grp_id = default_grp_priv->gp_pub.cg_grpid;
-		rc = crt_pmix_uri_lookup(grp_id, rank, &uri);
+		/* decref in crt_req_pmix_uri_cb */
+		RPC_ADDREF(rpc_priv);
+		rc = crt_pmix_uri_lookup_nb(grp_id, rank, crt_req_pmix_uri_cb,
+					    rpc_priv);
 		if (rc != 0) {
-			D_ERROR("crt_pmix_uri_lookup() failed, rc %d.\n", rc);
-			D_GOTO(out, rc);
+			RPC_DECREF(rpc_priv);
+			D_ERROR("crt_pmix_uri_lookup_nb() failed, rc %d.\n",
+				rc);
 		}
+		D_GOTO(out, rc);
 	}
 	rc = crt_grp_lc_uri_insert(default_grp_priv, crt_ctx->cc_idx,
 				   rank, 0, uri);
@@ -1146,6 +1379,103 @@ crt_req_hg_addr_lookup(struct crt_rpc_priv *rpc_priv)
 	return rc;
 }
 
+static inline struct crt_grp_priv *
+crt_req_grp_priv(struct crt_rpc_priv *rpc_priv)
+{
+	crt_endpoint_t	*tgt_ep = &rpc_priv->crp_pub.cr_ep;
+
+	if (tgt_ep->ep_grp == NULL)
+		return crt_gdata.cg_grp->gg_srv_pri_grp;
+	return container_of(tgt_ep->ep_grp, struct crt_grp_priv, gp_pub);
+}
+
+/*
+ * Called when rpc_priv missed the address of its target. Only the first of
+ * the requests to the same (rank, tag) on a context looks it up, the others
+ * park until it is done. Returns 1 if rpc_priv was parked, 0 if it is to look
+ * up the address or found it in the meantime, or a negative error.
+ */
+static int
+crt_req_lc_park(struct crt_rpc_priv *rpc_priv)
+{
+	struct crt_context	*ctx = rpc_priv->crp_pub.cr_ctx;
+	crt_endpoint_t		*tgt_ep = &rpc_priv->crp_pub.cr_ep;
+	int			 rc;
+
+	/* set ahead, the owner may release rpc_priv as soon as it is parked */
+	rpc_priv->crp_state = RPC_STATE_ADDR_WAIT;
+	rc = crt_grp_lc_resolve_begin(crt_req_grp_priv(rpc_priv), ctx->cc_idx,
+				      tgt_ep->ep_rank, tgt_ep->ep_tag,
+				      &rpc_priv->crp_lc_link,
+				      &rpc_priv->crp_hg_addr);
+	if (rc > 0)
+		return rc;
+
+	rpc_priv->crp_state = RPC_STATE_INITED;
+	if (rc == 0 && rpc_priv->crp_hg_addr == NULL)
+		rpc_priv->crp_lc_owner = 1;
+	return rc;
+}
+
+/*
+ * Release the requests parked on the address rpc_priv looked up, in the order
+ * they were sent. They are sent if rc is 0, or failed with rc.
+ */
+void
+crt_req_lc_release(struct crt_rpc_priv *rpc_priv, int rc)
+{
+	struct crt_context	*ctx = rpc_priv->crp_pub.cr_ctx;
+	crt_endpoint_t		*tgt_ep = &rpc_priv->crp_pub.cr_ep;
+	struct crt_li_pending	*lp;
+	struct crt_rpc_priv	*waiter;
+	d_list_t		*link;
+	int			 waiter_rc;
+
+	if (!rpc_priv->crp_lc_owner)
+		return;
+	rpc_priv->crp_lc_owner = 0;
+
+	lp = crt_grp_lc_resolve_end(crt_req_grp_priv(rpc_priv), ctx->cc_idx,
+				    tgt_ep->ep_rank, tgt_ep->ep_tag);
+	if (lp == NULL)
+		return;
+
+	while ((link = crt_li_pending_pop(lp)) != NULL) {
+		waiter = container_of(link, struct crt_rpc_priv, crp_lc_link);
+		D_ASSERT(waiter->crp_state == RPC_STATE_ADDR_WAIT);
+
+		RPC_ADDREF(waiter);
+		waiter_rc = rc;
+		if (waiter_rc == 0) {
+			waiter->crp_state = RPC_STATE_INITED;
+			waiter_rc = crt_req_send_internal(waiter);
+		}
+		if (waiter_rc != 0) {
+			crt_context_req_untrack(&waiter->crp_pub);
+			crt_rpc_complete(waiter, waiter_rc);
+			RPC_DECREF(waiter); /* destroy */
+		}
+		RPC_DECREF(waiter);
+	}
+}
+
+/* unpark rpc_priv, returns false if it got released meanwhile */
+bool
+crt_req_lc_cancel(struct crt_rpc_priv *rpc_priv)
+{
+	return crt_grp_lc_resolve_cancel(crt_req_grp_priv(rpc_priv),
+					 rpc_priv->crp_pub.cr_ep.ep_rank,
+					 &rpc_priv->crp_lc_link);
+}
+
+/* withdraw rpc_priv from its batched URI lookup, false if released meanwhile */
+bool
+crt_req_ul_cancel(struct crt_rpc_priv *rpc_priv)
+{
+	return crt_grp_uri_lookup_cancel(rpc_priv->crp_pub.cr_ctx,
+					 crt_req_grp_priv(rpc_priv), rpc_priv);
+}
+
 static inline int
 crt_req_send_immediately(struct crt_rpc_priv *rpc_priv)
 {
@@ -1173,6 +1503,10 @@ crt_req_send_immediately(struct crt_rpc_priv *rpc_priv)
 		D_ERROR("crt_hg_req_send failed, rc: %d, rpc_priv: %p,"
 			"opc: %#x.\n", rc, rpc_priv, req->cr_opc);
 
+	/* the address is cached, send the requests parked on it */
+	if (rpc_priv->crp_lc_owner)
+		crt_req_lc_release(rpc_priv, 0);
+
 out:
 	if (rc != 0)
 		D_ERROR("crt_req_send_immediately failed, rc: %d, rpc_priv: %p,"
@@ -1200,6 +1534,18 @@ crt_req_send_internal(struct crt_rpc_priv *rpc_priv)
 				"opc: %#x.\n", rc, req->cr_opc);
 			D_GOTO(out, rc);
 		}
+		rpc_priv->crp_sm_route = crt_hg_uri_is_local(base_addr);
+		if (rpc_priv->crp_hg_addr == NULL && !rpc_priv->crp_lc_owner) {
+			rc = crt_req_lc_park(rpc_priv);
+			if (rc != 0) {
+				/* parked, rpc_priv may be released already */
+				if (rc > 0)
+					return 0;
+				D_ERROR("crt_req_lc_park() failed, rc %d, "
+					"opc: %#x.\n", rc, req->cr_opc);
+				D_GOTO(out, rc);
+			}
+		}
 		if (rpc_priv->crp_hg_addr != NULL) {
 			/* send the RPC if the local cache has the HG_Addr */
 			rc = crt_req_send_immediately(rpc_priv);
@@ -1226,6 +1572,8 @@ crt_req_send_internal(struct crt_rpc_priv *rpc_priv)
 				"opc: %#x\n", rc, req->cr_opc);
 			D_GOTO(out, rc);
 		}
+		rpc_priv->crp_sm_route =
+			crt_hg_uri_is_local(rpc_priv->crp_tgt_uri);
 		if (rpc_priv->crp_hg_addr != NULL) {
 			rc = crt_req_send_immediately(rpc_priv);
 		} else {
@@ -1536,6 +1884,7 @@ crt_rpc_priv_init(struct crt_rpc_priv *rpc_priv, crt_context_t crt_ctx,
 	D_INIT_LIST_HEAD(&rpc_priv->crp_epi_link);
 	D_INIT_LIST_HEAD(&rpc_priv->crp_tmp_link);
 	D_INIT_LIST_HEAD(&rpc_priv->crp_parent_link);
+	D_INIT_LIST_HEAD(&rpc_priv->crp_lc_link);
 	rpc_priv->crp_complete_cb = NULL;
 	rpc_priv->crp_arg = NULL;
 	if (!srv_flag) {
@@ -47,7 +47,8 @@
 #include "gurt/common.h"
 
 #define CRT_RPC_MAGIC			(0xAB0C01EC)
-#define CRT_RPC_VERSION			(0x00000001)
+/* bumped on any change of what goes on the wire */
+#define CRT_RPC_VERSION			(0x00000008)
 
 /* default RPC timeout 60 seconds */
 #define CRT_DEFAULT_TIMEOUT_S	(60) /* second */
@@ -78,8 +79,11 @@ struct crt_corpc_hdr {
 	uint64_t		 coh_int_grpid;
 	/* collective bulk handle */
 	crt_bulk_t		 coh_bulk_hdl;
-	/* optional excluded ranks */
-	d_rank_list_t		*coh_excluded_ranks;
+	/*
+	 * optional excluded ranks, or the included ones with
+	 * CRT_RPC_FLAG_INCLUSIVE
+	 */
+	d_rank_list_t		*coh_filter_ranks;
 	/* optional inline ranks, for example piggyback the group members */
 	d_rank_list_t		*coh_inline_ranks;
 	/* group membership version */
@@ -87,9 +91,23 @@ struct crt_corpc_hdr {
 	uint32_t		 coh_tree_topo;
 	/* root rank of the tree, it is the logical rank within the group */
 	uint32_t		 coh_root;
-	uint32_t		 coh_padding;
+	/* segmentation of the chained bulk, 0 if it is pulled as a whole */
+	uint32_t		 coh_seg;
+	/* host map of a CRT_TREE_HIER tree, see crt_tree_hier_resolve() */
+	uint64_t		 coh_host_map;
 };
 
+/*
+ * coh_seg of a pipelined chained bulk, see crt_corpc_pipe_start():
+ * bits 0-4:  log2 of the segment size
+ * bit 5:     the sender holds the whole bulk
+ * bits 6-31: id of the sender's pipe, for CRT_OPC_CORPC_SEG_WAIT
+ */
+#define CRT_CORPC_SEG_SHIFT_MASK	(0x1fU)
+#define CRT_CORPC_SEG_COMPLETE		(1U << 5)
+#define CRT_CORPC_SEG_ID_SHIFT		(6)
+#define CRT_CORPC_SEG_ID_MASK		(0x3ffffffU)
+
 /* CaRT layer common header */
 struct crt_common_hdr {
 	uint32_t	cch_magic;
@@ -104,6 +122,12 @@ struct crt_common_hdr {
 	uint32_t	cch_grp_id;
 	/* used in crp_reply_hdr to propagate rpc failure back to sender */
 	uint32_t	cch_rc;
+	/*
+	 * pid and host id of the sender process, used to detect co-located
+	 * peers for the shared-memory bulk path, see crt_hg_bulk_sm_transfer()
+	 */
+	uint32_t		cch_src_pid;
+	struct crt_host_id	cch_src_host;
 };
 
 typedef enum {
@@ -117,12 +141,13 @@ typedef enum {
 	RPC_STATE_ADDR_LOOKUP,
 	RPC_STATE_URI_LOOKUP,
 	RPC_STATE_FWD_UNREACH,
+	RPC_STATE_ADDR_WAIT, /* parked on another request's address lookup */
 } crt_rpc_state_t;
 
 /* corpc info to track the tree topo and child RPCs info */
 struct crt_corpc_info {
 	struct crt_grp_priv	*co_grp_priv;
-	d_rank_list_t		*co_excluded_ranks;
+	d_rank_list_t		*co_filter_ranks;
 	uint32_t		 co_grp_ver;
 	uint32_t		 co_tree_topo;
 	d_rank_t		 co_root;
@@ -146,10 +171,22 @@ struct crt_corpc_info {
 	 * (local reply ready).
 	 */
 	uint32_t		 co_local_done:1,
-	/* co_root_excluded is the flag of root in excluded rank list */
+	/*
+	 * co_root_excluded is the flag of root in excluded rank list, or not
+	 * in the inclusion list
+	 */
 				 co_root_excluded:1,
+	/* co_filter_ranks is an inclusion list */
+				 co_filter_incl:1,
 	/* flag of if refcount taken for co_grp_priv */
-				 co_grp_ref_taken:1;
+				 co_grp_ref_taken:1,
+	/*
+	 * with the built-in reduction, co_reducing is set while a thread
+	 * reduces replies outside of crp_lock, co_reduced once a reply has
+	 * been reduced into the result.
+	 */
+				 co_reducing:1,
+				 co_reduced:1;
 	int			 co_rc;
 };
 
@@ -160,12 +197,16 @@ struct crt_rpc_priv {
 	d_list_t			crp_tmp_link;
 	/* link to parent RPC crp_opc_info->co_child_rpcs/co_replied_rpcs */
 	d_list_t			crp_parent_link;
+	/* link to crt_li_pending::lp_waiters in RPC_STATE_ADDR_WAIT */
+	d_list_t			crp_lc_link;
 	/* binheap node for timeout management, in crt_context::cc_bh_timeout */
 	struct d_binheap_node	crp_timeout_bp_node;
 	/* the timeout in seconds set by user */
 	uint32_t		crp_timeout_sec;
 	/* time stamp to be timeout, the key of timeout binheap */
 	uint64_t		crp_timeout_ts;
+	/* time in us it was sent, 0 if its round trip is not sampled */
+	uint64_t		crp_send_ts;
 	crt_cb_t		crp_complete_cb;
 	void			*crp_arg; /* argument for crp_complete_cb */
 	struct crt_ep_inflight	*crp_epi; /* point back to inflight ep */
@@ -200,11 +241,21 @@ struct crt_rpc_priv {
 				/* set to 1 if target ep is set */
 				crp_have_ep:1,
 				/* 1 if RPC is succesfully put on the wire */
-				crp_on_wire:1;
+				crp_on_wire:1,
+				/* 1 if target is reached through the SM route */
+				crp_sm_route:1,
+				/* 1 if resolving the target address for others */
+				crp_lc_owner:1;
 	uint32_t		crp_refcount;
 	struct crt_opc_info	*crp_opc_info;
 	/* corpc info, only valid when (crp_coll == 1) */
 	struct crt_corpc_info	*crp_corpc_info;
+	/* pooled buffer of the chained bulk of a forwarded corpc */
+	struct crt_buf		*crp_co_buf;
+	/* pipe pulling the chained bulk by segments, see crt_corpc_pipe */
+	struct crt_corpc_pipe	*crp_co_pipe;
+	/* array of the built-in reduction result, see crt_reduce_reply */
+	void			*crp_co_reduce_buf;
 	pthread_spinlock_t	crp_lock;
 	struct crt_common_hdr	crp_reply_hdr; /* common header for reply */
 	struct crt_common_hdr	crp_req_hdr; /* common header for request */
@@ -263,12 +314,10 @@ struct crt_rpc_priv {
 	X(CRT_OPC_IV_SYNC,						\
 		0, &CQF_CRT_IV_SYNC,					\
 		crt_hdlr_iv_sync, &crt_iv_sync_co_ops),			\
-	X(CRT_OPC_BARRIER_ENTER,					\
-		0, &CQF_CRT_BARRIER,					\
-		crt_hdlr_barrier_enter, &crt_barrier_corpc_ops),	\
-	X(CRT_OPC_BARRIER_EXIT,						\
-		0, &CQF_CRT_BARRIER,					\
-		crt_hdlr_barrier_exit, &crt_barrier_corpc_ops),		\
+	X(CRT_OPC_BARRIER,						\
+		0, &CQF_CRT_BARRIER, crt_hdlr_barrier, NULL),		\
+	X(CRT_OPC_COLL,							\
+		0, &CQF_CRT_COLL, crt_hdlr_coll, NULL),			\
 	X(CRT_OPC_RANK_EVICT,						\
 		0, &CQF_CRT_LM_EVICT,					\
 		crt_hdlr_rank_evict, &crt_rank_evict_co_ops),		\
@@ -283,7 +332,27 @@ struct crt_rpc_priv {
 	X(CRT_OPC_CTL_GET_PID,						\
 		0, &CQF_CRT_CTL_GET_PID, crt_hdlr_ctl_get_pid, NULL),	\
 	X(CRT_OPC_PROTO_QUERY,						\
-		0, &CQF_CRT_PROTO_QUERY, crt_hdlr_proto_query, NULL)
+		0, &CQF_CRT_PROTO_QUERY, crt_hdlr_proto_query, NULL),	\
+	X(CRT_OPC_URI_LOOKUP_BATCH,					\
+		0, &CQF_CRT_URI_LOOKUP_BATCH,				\
+		crt_hdlr_uri_lookup_batch, NULL),			\
+	X(CRT_OPC_SELF_TEST_TREE_SWEEP,					\
+		0, &CQF_CRT_SELF_TEST_TREE_SWEEP,			\
+		crt_self_test_tree_sweep_handler, NULL),		\
+	X(CRT_OPC_SELF_TEST_TREE_PING,					\
+		0, &CQF_CRT_SELF_TEST_TREE_PING,			\
+		crt_self_test_tree_ping_handler,			\
+		&crt_st_tree_ping_co_ops),				\
+	X(CRT_OPC_SELF_TEST_COLL_SWEEP,					\
+		0, &CQF_CRT_SELF_TEST_COLL_SWEEP,			\
+		crt_self_test_coll_sweep_handler, NULL),		\
+	X(CRT_OPC_SELF_TEST_COLL_RUN,					\
+		0, &CQF_CRT_SELF_TEST_COLL_RUN,				\
+		crt_self_test_coll_run_handler,				\
+		&crt_st_coll_run_co_ops),				\
+	X(CRT_OPC_CORPC_SEG_WAIT,					\
+		0, &CQF_CRT_CORPC_SEG_WAIT,				\
+		crt_hdlr_corpc_seg_wait, NULL)
 
 /* Define for RPC enum population below */
 #define X(a, b, c, d, e) a
@@ -342,12 +411,83 @@ struct crt_uri_lookup_out {
 	int			ul_rc;
 };
 
+/* one (rank, tag) of a batched URI lookup, packed in ulb_pairs */
+struct crt_uri_pair {
+	d_rank_t		uip_rank;
+	uint32_t		uip_tag;
+};
+
+struct crt_uri_lookup_batch_in {
+	crt_group_id_t		ulb_grp_id;
+	/* array of struct crt_uri_pair */
+	d_iov_t			ulb_pairs;
+	/* buffer for the URIs if too large to go inline, or CRT_BULK_NULL */
+	crt_bulk_t		ulb_bulk;
+};
+
+struct crt_uri_lookup_batch_out {
+	/*
+	 * one NUL terminated URI per pair in request order, empty if unknown
+	 * to the PSR. Empty as well if the URIs were put into ulb_bulk.
+	 */
+	d_iov_t			ulb_uris;
+	/* total length of the URIs */
+	uint32_t		ulb_len;
+	int			ulb_rc;
+};
+
+struct crt_corpc_seg_wait_in {
+	/* pipe of the parent, see CRT_CORPC_SEG_ID_SHIFT */
+	uint32_t		csw_id;
+	/* number of segments the child waits for */
+	uint32_t		csw_want;
+};
+
+struct crt_corpc_seg_wait_out {
+	/* number of segments the parent holds */
+	uint32_t		csw_avail;
+	int			csw_rc;
+};
+
 struct crt_barrier_in {
-	int			b_num;
+	uint64_t		b_num;
+	/* membership version of the rounds */
+	uint32_t		b_ver;
+	/* dissemination round, or CRT_BARRIER_ROUND_DONE */
+	uint32_t		b_round;
 };
 
 struct crt_barrier_out {
 	int			b_rc;
+	/* the barrier completed on the replying rank */
+	uint32_t		b_done;
+};
+
+struct crt_coll_in {
+	uint64_t		c_num;
+	/* block length */
+	uint64_t		c_len;
+	/* blocks of the sender, CRT_BULK_NULL if c_rc is set */
+	crt_bulk_t		c_bulk;
+	/* membership version the collective started at */
+	uint32_t		c_ver;
+	/* enum crt_coll_type */
+	uint32_t		c_type;
+	/* allgather round */
+	uint32_t		c_round;
+	/*
+	 * allgather: index of the first block in the live ranks, all-to-all:
+	 * rank of the sender
+	 */
+	uint32_t		c_first;
+	/* number of blocks */
+	uint32_t		c_cnt;
+	/* failure of the collective on the sender, no blocks to pull */
+	int			c_rc;
+};
+
+struct crt_coll_out {
+	int			c_rc;
 };
 
 struct crt_ctl_in {
@@ -444,6 +584,8 @@ crt_common_hdr_init(struct crt_common_hdr *hdr, crt_opcode_t opc)
 	hdr->cch_magic = CRT_RPC_MAGIC;
 	hdr->cch_version = CRT_RPC_VERSION;
 	hdr->cch_grp_id = 0;
+	hdr->cch_src_pid = crt_gdata.cg_pid;
+	hdr->cch_src_host = crt_gdata.cg_host_id;
 	D_ASSERT(crt_group_rank(0, &hdr->cch_rank) == 0);
 }
 
@@ -468,6 +610,9 @@ int crt_internal_rpc_register(void);
 int crt_req_send_sync(crt_rpc_t *rpc, uint64_t timeout);
 int crt_rpc_common_hdlr(struct crt_rpc_priv *rpc_priv);
 int crt_req_send_internal(struct crt_rpc_priv *rpc_priv);
+void crt_req_lc_release(struct crt_rpc_priv *rpc_priv, int rc);
+bool crt_req_lc_cancel(struct crt_rpc_priv *rpc_priv);
+bool crt_req_ul_cancel(struct crt_rpc_priv *rpc_priv);
 
 static inline bool
 crt_req_timedout(crt_rpc_t *rpc)
@@ -479,7 +624,8 @@ crt_req_timedout(crt_rpc_t *rpc)
 		rpc_priv->crp_state == RPC_STATE_URI_LOOKUP ||
 		rpc_priv->crp_state == RPC_STATE_ADDR_LOOKUP ||
 		rpc_priv->crp_state == RPC_STATE_TIMEOUT ||
-		rpc_priv->crp_state == RPC_STATE_FWD_UNREACH) &&
+		rpc_priv->crp_state == RPC_STATE_FWD_UNREACH ||
+		rpc_priv->crp_state == RPC_STATE_ADDR_WAIT) &&
 	       !rpc_priv->crp_in_binheap;
 }
 
@@ -508,6 +654,16 @@ int crt_corpc_req_hdlr(crt_rpc_t *req);
 void crt_corpc_reply_hdlr(const struct crt_cb_info *cb_info);
 int crt_corpc_common_hdlr(struct crt_rpc_priv *rpc_priv);
 void crt_corpc_info_fini(struct crt_rpc_priv *rpc_priv);
+void crt_corpc_pipe_free(struct crt_corpc_pipe *pipe);
+void crt_hdlr_corpc_seg_wait(crt_rpc_t *rpc_req);
+
+/* crt_reduce.c */
+int crt_reduce_check(const struct crt_corpc_reduce *reduce,
+		     size_t output_size);
+void crt_reduce_array(int type, int op, void *dst, const void *src_a,
+		      const void *src_b, size_t nr);
+int crt_reduce_reply(struct crt_rpc_priv *result_priv, crt_rpc_t *source,
+		     const struct crt_corpc_reduce *reduce);
 
 /* crt_iv.c */
 void crt_hdlr_iv_fetch(crt_rpc_t *rpc_req);
@@ -243,6 +243,46 @@ struct crt_st_status_req_reply {
 	int32_t status;
 };
 
+/* see crt_self_test_tree.c */
+struct crt_st_tree_sweep_in {
+	/* number of ranks to broadcast to, including the master endpoint */
+	uint32_t grp_size;
+	/* tree of the broadcasts, can be CRT_TREE_AUTO */
+	uint32_t tree_topo;
+	/* size of the chained bulk, 0 for none */
+	uint32_t payload;
+	uint32_t rep_count;
+};
+
+struct crt_st_tree_sweep_out {
+	int64_t test_duration_ns;
+	/* tree of the last broadcast, CRT_TREE_AUTO resolved */
+	uint32_t tree_topo;
+	int32_t status;
+};
+
+/* see crt_self_test_coll.c, the same for the sweep and each run */
+struct crt_st_coll_in {
+	/* CRT_ST_COLL_ALLGATHER or CRT_ST_COLL_ALLTOALL */
+	uint32_t coll_type;
+	/* bytes each rank sends to each other rank */
+	uint32_t block_size;
+	uint32_t rep_count;
+};
+
+struct crt_st_coll_out {
+	/* of the slowest rank */
+	int64_t test_duration_ns;
+	/* ranks which took part */
+	uint32_t grp_size;
+	int32_t status;
+};
+
+enum crt_st_coll_type {
+	CRT_ST_COLL_ALLGATHER = 0,
+	CRT_ST_COLL_ALLTOALL = 1,
+};
+
 struct st_latency {
 	int64_t val;
 	uint32_t rank;
@@ -307,5 +347,13 @@ void crt_self_test_open_session_handler(crt_rpc_t *rpc_req);
 void crt_self_test_close_session_handler(crt_rpc_t *rpc_req);
 void crt_self_test_start_handler(crt_rpc_t *rpc_req);
 void crt_self_test_status_req_handler(crt_rpc_t *rpc_req);
+void crt_self_test_tree_sweep_handler(crt_rpc_t *rpc_req);
+void crt_self_test_tree_ping_handler(crt_rpc_t *rpc_req);
+int crt_self_test_tree_ping_aggregate(crt_rpc_t *source, crt_rpc_t *result,
+				      void *priv);
+void crt_self_test_coll_sweep_handler(crt_rpc_t *rpc_req);
+void crt_self_test_coll_run_handler(crt_rpc_t *rpc_req);
+int crt_self_test_coll_run_aggregate(crt_rpc_t *source, crt_rpc_t *result,
+				     void *priv);
 
 #endif /* __CRT_SELF_TEST_H__ */
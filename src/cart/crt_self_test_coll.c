@@ -0,0 +1,318 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It implements the collective benchmark of
+ * self-test, which times crt_allgather() and crt_alltoall().
+ *
+ * The client asks a master endpoint, which has to be a server, to broadcast
+ * a run request to all live ranks of its primary group. Each rank then runs
+ * rep_count collectives one after the other and replies with the time they
+ * took, the slowest rank is reported back to the client.
+ */
+#define D_LOGFAC	DD_FAC(self_test)
+
+#include "crt_internal.h"
+
+struct st_coll_run {
+	/* the run request, replied to once all collectives are done */
+	crt_rpc_t		*rpc_req;
+	struct crt_st_coll_in	*args;
+	d_iov_t			 send_iov;
+	d_iov_t			 recv_iov;
+	uint32_t		 rep_idx;
+	/* live ranks of the last collective */
+	uint32_t		 rank_nr;
+	struct timespec		 time_start;
+};
+
+static int coll_run_next(struct st_coll_run *run);
+
+static void
+coll_run_free(struct st_coll_run *run)
+{
+	D_FREE(run->send_iov.iov_buf);
+	D_FREE(run->recv_iov.iov_buf);
+	D_FREE_PTR(run);
+}
+
+static void
+coll_run_done(struct st_coll_run *run, int rc)
+{
+	struct crt_st_coll_out	*reply;
+	struct timespec		 now;
+	int			 ret;
+
+	reply = crt_reply_get(run->rpc_req);
+	D_ASSERT(reply != NULL);
+
+	if (rc == 0) {
+		d_gettime(&now);
+		reply->test_duration_ns = d_timediff_ns(&run->time_start,
+							&now);
+	}
+	reply->grp_size = run->rank_nr;
+	reply->status = rc;
+
+	ret = crt_reply_send(run->rpc_req);
+	if (ret != 0)
+		D_ERROR("crt_reply_send failed; ret = %d\n", ret);
+
+	/* addref in crt_self_test_coll_run_handler */
+	crt_req_decref(run->rpc_req);
+	coll_run_free(run);
+}
+
+static void
+coll_run_cb(const struct crt_coll_cb_info *cb_info)
+{
+	struct st_coll_run	*run = cb_info->coci_arg;
+	int			 ret;
+
+	D_ASSERT(run != NULL);
+
+	run->rank_nr = cb_info->coci_rank_nr;
+	if (cb_info->coci_rc != 0) {
+		D_ERROR("Collective %u failed; rc = %d\n", run->rep_idx,
+			cb_info->coci_rc);
+		coll_run_done(run, cb_info->coci_rc);
+		return;
+	}
+
+	run->rep_idx++;
+	if (run->rep_idx == run->args->rep_count) {
+		coll_run_done(run, 0);
+		return;
+	}
+
+	ret = coll_run_next(run);
+	if (ret != 0)
+		coll_run_done(run, ret);
+}
+
+static int
+coll_run_next(struct st_coll_run *run)
+{
+	int	ret;
+
+	if (run->args->coll_type == CRT_ST_COLL_ALLGATHER)
+		ret = crt_allgather(run->rpc_req->cr_ctx, NULL, &run->send_iov,
+				    &run->recv_iov, coll_run_cb, run);
+	else
+		ret = crt_alltoall(run->rpc_req->cr_ctx, NULL, &run->send_iov,
+				   &run->recv_iov, coll_run_cb, run);
+	if (ret != 0)
+		D_ERROR("Collective %u could not start; ret = %d\n",
+			run->rep_idx, ret);
+
+	return ret;
+}
+
+void
+crt_self_test_coll_run_handler(crt_rpc_t *rpc_req)
+{
+	struct crt_st_coll_in	*args;
+	struct crt_st_coll_out	*reply;
+	struct st_coll_run	*run = NULL;
+	uint32_t		 grp_size;
+	uint64_t		 send_len;
+	uint64_t		 recv_len;
+	int			 ret;
+
+	args = crt_req_get(rpc_req);
+	D_ASSERT(args != NULL);
+
+	if (args->block_size == 0 || args->rep_count == 0 ||
+	    (args->coll_type != CRT_ST_COLL_ALLGATHER &&
+	     args->coll_type != CRT_ST_COLL_ALLTOALL)) {
+		D_ERROR("Invalid collective run, type %u block size %u rep "
+			"count %u\n", args->coll_type, args->block_size,
+			args->rep_count);
+		D_GOTO(send_reply, ret = -DER_INVAL);
+	}
+	ret = crt_group_size(NULL, &grp_size);
+	if (ret != 0)
+		D_GOTO(send_reply, ret);
+
+	D_ALLOC_PTR(run);
+	if (run == NULL)
+		D_GOTO(send_reply, ret = -DER_NOMEM);
+	run->rpc_req = rpc_req;
+	run->args = args;
+
+	recv_len = (uint64_t)args->block_size * grp_size;
+	send_len = args->coll_type == CRT_ST_COLL_ALLGATHER ?
+		   args->block_size : recv_len;
+	D_ALLOC(run->send_iov.iov_buf, send_len);
+	if (run->send_iov.iov_buf == NULL)
+		D_GOTO(send_reply, ret = -DER_NOMEM);
+	run->send_iov.iov_buf_len = send_len;
+	run->send_iov.iov_len = send_len;
+	D_ALLOC(run->recv_iov.iov_buf, recv_len);
+	if (run->recv_iov.iov_buf == NULL)
+		D_GOTO(send_reply, ret = -DER_NOMEM);
+	run->recv_iov.iov_buf_len = recv_len;
+
+	/* decref in coll_run_done */
+	ret = crt_req_addref(rpc_req);
+	if (ret != 0) {
+		D_ERROR("crt_req_addref failed; ret = %d\n", ret);
+		D_GOTO(send_reply, ret);
+	}
+
+	d_gettime(&run->time_start);
+	ret = coll_run_next(run);
+	if (ret != 0)
+		coll_run_done(run, ret);
+	return;
+
+send_reply:
+	if (run != NULL)
+		coll_run_free(run);
+
+	reply = crt_reply_get(rpc_req);
+	D_ASSERT(reply != NULL);
+	reply->status = ret;
+
+	ret = crt_reply_send(rpc_req);
+	if (ret != 0)
+		D_ERROR("crt_reply_send failed; ret = %d\n", ret);
+}
+
+int
+crt_self_test_coll_run_aggregate(crt_rpc_t *source, crt_rpc_t *result,
+				 void *priv)
+{
+	struct crt_st_coll_out	*reply_source;
+	struct crt_st_coll_out	*reply_result;
+
+	reply_source = crt_reply_get(source);
+	reply_result = crt_reply_get(result);
+	D_ASSERT(reply_source != NULL && reply_result != NULL);
+
+	if (reply_result->status == 0)
+		reply_result->status = reply_source->status;
+	reply_result->test_duration_ns = max(reply_result->test_duration_ns,
+					     reply_source->test_duration_ns);
+	reply_result->grp_size = max(reply_result->grp_size,
+				     reply_source->grp_size);
+
+	return 0;
+}
+
+static void
+coll_sweep_cb(const struct crt_cb_info *cb_info)
+{
+	crt_rpc_t		*rpc_req = cb_info->cci_arg;
+	struct crt_st_coll_out	*reply;
+	struct crt_st_coll_out	*run_reply;
+	int			 ret;
+
+	reply = crt_reply_get(rpc_req);
+	D_ASSERT(reply != NULL);
+
+	if (cb_info->cci_rc != 0) {
+		D_ERROR("Collective run failed; rc = %d\n", cb_info->cci_rc);
+		reply->status = cb_info->cci_rc;
+	} else {
+		run_reply = crt_reply_get(cb_info->cci_rpc);
+		D_ASSERT(run_reply != NULL);
+		*reply = *run_reply;
+	}
+
+	ret = crt_reply_send(rpc_req);
+	if (ret != 0)
+		D_ERROR("crt_reply_send failed; ret = %d\n", ret);
+
+	/* addref in crt_self_test_coll_sweep_handler */
+	crt_req_decref(rpc_req);
+}
+
+void
+crt_self_test_coll_sweep_handler(crt_rpc_t *rpc_req)
+{
+	struct crt_st_coll_in	*args;
+	struct crt_st_coll_in	*run_args;
+	struct crt_st_coll_out	*reply;
+	crt_rpc_t		*run_rpc;
+	int			 ret;
+
+	args = crt_req_get(rpc_req);
+	D_ASSERT(args != NULL);
+
+	if (!crt_is_service()) {
+		D_ERROR("Collective test needs a server as master endpoint\n");
+		D_GOTO(send_reply, ret = -DER_NO_PERM);
+	}
+
+	ret = crt_corpc_req_create(rpc_req->cr_ctx, NULL, NULL,
+				   CRT_OPC_SELF_TEST_COLL_RUN, CRT_BULK_NULL,
+				   NULL, 0, crt_tree_topo(CRT_TREE_AUTO, 0),
+				   &run_rpc);
+	if (ret != 0) {
+		D_ERROR("crt_corpc_req_create failed; ret = %d\n", ret);
+		D_GOTO(send_reply, ret);
+	}
+
+	run_args = crt_req_get(run_rpc);
+	D_ASSERT(run_args != NULL);
+	*run_args = *args;
+
+	/* decref in coll_sweep_cb */
+	ret = crt_req_addref(rpc_req);
+	if (ret != 0) {
+		D_ERROR("crt_req_addref failed; ret = %d\n", ret);
+		crt_req_decref(run_rpc);
+		D_GOTO(send_reply, ret);
+	}
+
+	ret = crt_req_send(run_rpc, coll_sweep_cb, rpc_req);
+	if (ret == 0)
+		return;
+
+	D_ERROR("crt_req_send failed; ret = %d\n", ret);
+	crt_req_decref(rpc_req);
+
+send_reply:
+	reply = crt_reply_get(rpc_req);
+	D_ASSERT(reply != NULL);
+	reply->status = ret;
+
+	ret = crt_reply_send(rpc_req);
+	if (ret != 0)
+		D_ERROR("crt_reply_send failed; ret = %d\n", ret);
+}
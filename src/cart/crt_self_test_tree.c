@@ -0,0 +1,293 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It implements the tree sweep of self-test, which
+ * times collective broadcasts over different trees, CRT_TREE_AUTO included,
+ * to check the choices of the tree selection against measurements.
+ *
+ * The client asks a master endpoint, which has to be a server, to broadcast
+ * rep_count empty collectives one after the other over the first grp_size
+ * ranks of its primary group, optionally chaining a bulk of payload bytes.
+ */
+#define D_LOGFAC	DD_FAC(self_test)
+
+#include "crt_internal.h"
+
+struct st_tree_sweep {
+	/* the sweep request, replied to once all broadcasts are done */
+	crt_rpc_t			*rpc_req;
+	struct crt_st_tree_sweep_in	*args;
+	/* ranks of the primary group beyond grp_size */
+	d_rank_list_t			*excluded;
+	/* chained bulk, CRT_BULK_NULL if no payload */
+	crt_bulk_t			 bulk_hdl;
+	d_sg_list_t			 sg_list;
+	d_iov_t				 sg_iov;
+	uint32_t			 rep_idx;
+	/* tree of the last broadcast, as resolved by the root */
+	uint32_t			 tree_topo;
+	struct timespec			 time_start;
+};
+
+static int tree_sweep_send_next(struct st_tree_sweep *sweep);
+
+static void
+tree_sweep_free(struct st_tree_sweep *sweep)
+{
+	if (sweep->bulk_hdl != CRT_BULK_NULL)
+		crt_bulk_free(sweep->bulk_hdl);
+	D_FREE(sweep->sg_iov.iov_buf);
+	d_rank_list_free(sweep->excluded);
+	D_FREE_PTR(sweep);
+}
+
+static void
+tree_sweep_done(struct st_tree_sweep *sweep, int rc)
+{
+	struct crt_st_tree_sweep_out	*reply;
+	struct timespec			 now;
+	int				 ret;
+
+	reply = crt_reply_get(sweep->rpc_req);
+	D_ASSERT(reply != NULL);
+
+	if (rc == 0) {
+		d_gettime(&now);
+		reply->test_duration_ns = d_timediff_ns(&sweep->time_start,
+							&now);
+	}
+	reply->tree_topo = sweep->tree_topo;
+	reply->status = rc;
+
+	ret = crt_reply_send(sweep->rpc_req);
+	if (ret != 0)
+		D_ERROR("crt_reply_send failed; ret = %d\n", ret);
+
+	/* addref in crt_self_test_tree_sweep_handler */
+	crt_req_decref(sweep->rpc_req);
+	tree_sweep_free(sweep);
+}
+
+static void
+tree_ping_cb(const struct crt_cb_info *cb_info)
+{
+	struct st_tree_sweep	*sweep = cb_info->cci_arg;
+	struct crt_rpc_priv	*rpc_priv;
+	int			 ret;
+
+	D_ASSERT(sweep != NULL);
+
+	if (cb_info->cci_rc != 0) {
+		D_ERROR("Tree sweep broadcast %u failed; rc = %d\n",
+			sweep->rep_idx, cb_info->cci_rc);
+		tree_sweep_done(sweep, cb_info->cci_rc);
+		return;
+	}
+
+	rpc_priv = container_of(cb_info->cci_rpc, struct crt_rpc_priv,
+				crp_pub);
+	D_ASSERT(rpc_priv->crp_corpc_info != NULL);
+	sweep->tree_topo = rpc_priv->crp_corpc_info->co_tree_topo;
+
+	sweep->rep_idx++;
+	if (sweep->rep_idx == sweep->args->rep_count) {
+		tree_sweep_done(sweep, 0);
+		return;
+	}
+
+	ret = tree_sweep_send_next(sweep);
+	if (ret != 0)
+		tree_sweep_done(sweep, ret);
+}
+
+static int
+tree_sweep_send_next(struct st_tree_sweep *sweep)
+{
+	crt_rpc_t	*ping_rpc;
+	uint32_t	*ping_args;
+	int		 ret;
+
+	ret = crt_corpc_req_create(sweep->rpc_req->cr_ctx, NULL,
+				   sweep->excluded,
+				   CRT_OPC_SELF_TEST_TREE_PING,
+				   sweep->bulk_hdl, NULL, 0,
+				   sweep->args->tree_topo, &ping_rpc);
+	if (ret != 0) {
+		D_ERROR("crt_corpc_req_create failed; ret = %d\n", ret);
+		return ret;
+	}
+
+	ping_args = crt_req_get(ping_rpc);
+	D_ASSERT(ping_args != NULL);
+	*ping_args = sweep->rep_idx;
+
+	ret = crt_req_send(ping_rpc, tree_ping_cb, sweep);
+	if (ret != 0)
+		D_ERROR("crt_req_send failed; ret = %d\n", ret);
+
+	return ret;
+}
+
+void
+crt_self_test_tree_sweep_handler(crt_rpc_t *rpc_req)
+{
+	struct crt_st_tree_sweep_in	*args;
+	struct crt_st_tree_sweep_out	*reply;
+	struct st_tree_sweep		*sweep = NULL;
+	d_rank_t			 self, rank;
+	uint32_t			 grp_size, excluded_nr, nr;
+	int				 ret;
+
+	args = crt_req_get(rpc_req);
+	D_ASSERT(args != NULL);
+
+	if (!crt_is_service()) {
+		D_ERROR("Tree sweep needs a server as master endpoint\n");
+		D_GOTO(send_reply, ret = -DER_NO_PERM);
+	}
+	ret = crt_group_rank(NULL, &self);
+	if (ret != 0)
+		D_GOTO(send_reply, ret);
+	ret = crt_group_size(NULL, &grp_size);
+	if (ret != 0)
+		D_GOTO(send_reply, ret);
+
+	if (args->grp_size == 0 || args->grp_size > grp_size) {
+		D_ERROR("Tree sweep size %u not in [1:%u]\n", args->grp_size,
+			grp_size);
+		D_GOTO(send_reply, ret = -DER_INVAL);
+	}
+	if (args->rep_count == 0) {
+		D_ERROR("Rep count must be greater than zero\n");
+		D_GOTO(send_reply, ret = -DER_INVAL);
+	}
+
+	D_ALLOC_PTR(sweep);
+	if (sweep == NULL)
+		D_GOTO(send_reply, ret = -DER_NOMEM);
+	sweep->rpc_req = rpc_req;
+	sweep->args = args;
+	sweep->bulk_hdl = CRT_BULK_NULL;
+
+	/* keep self and the lowest other ranks, exclude the rest */
+	excluded_nr = grp_size - args->grp_size;
+	if (excluded_nr > 0) {
+		sweep->excluded = d_rank_list_alloc(excluded_nr);
+		if (sweep->excluded == NULL)
+			D_GOTO(send_reply, ret = -DER_NOMEM);
+		nr = 0;
+		for (rank = grp_size; rank-- > 0 && nr < excluded_nr;) {
+			if (rank != self)
+				sweep->excluded->rl_ranks[nr++] = rank;
+		}
+	}
+
+	if (args->payload > 0) {
+		D_ALLOC(sweep->sg_iov.iov_buf, args->payload);
+		if (sweep->sg_iov.iov_buf == NULL)
+			D_GOTO(send_reply, ret = -DER_NOMEM);
+		sweep->sg_iov.iov_buf_len = args->payload;
+		sweep->sg_iov.iov_len = args->payload;
+		sweep->sg_list.sg_iovs = &sweep->sg_iov;
+		sweep->sg_list.sg_nr = 1;
+
+		ret = crt_bulk_create(rpc_req->cr_ctx, &sweep->sg_list,
+				      CRT_BULK_RO, &sweep->bulk_hdl);
+		if (ret != 0) {
+			D_ERROR("crt_bulk_create failed; ret = %d\n", ret);
+			D_GOTO(send_reply, ret);
+		}
+	}
+
+	/* decref in tree_sweep_done */
+	ret = crt_req_addref(rpc_req);
+	if (ret != 0) {
+		D_ERROR("crt_req_addref failed; ret = %d\n", ret);
+		D_GOTO(send_reply, ret);
+	}
+
+	d_gettime(&sweep->time_start);
+	ret = tree_sweep_send_next(sweep);
+	if (ret != 0)
+		tree_sweep_done(sweep, ret);
+	return;
+
+send_reply:
+	if (sweep != NULL)
+		tree_sweep_free(sweep);
+
+	reply = crt_reply_get(rpc_req);
+	D_ASSERT(reply != NULL);
+	reply->status = ret;
+
+	ret = crt_reply_send(rpc_req);
+	if (ret != 0)
+		D_ERROR("crt_reply_send failed; ret = %d\n", ret);
+}
+
+void
+crt_self_test_tree_ping_handler(crt_rpc_t *rpc_req)
+{
+	int32_t	*reply_status;
+	int	 ret;
+
+	reply_status = crt_reply_get(rpc_req);
+	D_ASSERT(reply_status != NULL);
+	*reply_status = 0;
+
+	ret = crt_reply_send(rpc_req);
+	if (ret != 0)
+		D_ERROR("crt_reply_send failed; ret = %d\n", ret);
+}
+
+int
+crt_self_test_tree_ping_aggregate(crt_rpc_t *source, crt_rpc_t *result,
+				  void *priv)
+{
+	int32_t	*reply_source;
+	int32_t	*reply_result;
+
+	reply_source = crt_reply_get(source);
+	reply_result = crt_reply_get(result);
+	D_ASSERT(reply_source != NULL && reply_result != NULL);
+
+	if (*reply_result == 0)
+		*reply_result = *reply_source;
+
+	return 0;
+}
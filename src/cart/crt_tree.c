@@ -43,74 +43,471 @@
 
 #include "crt_internal.h"
 
+/*
+ * The live ranks of the group the tree is built over. filter_ranks are left
+ * out of it, or with filter_incl it is only the live ones of filter_ranks, so
+ * a sparse collective costs in proportion to its targets.
+ */
 static int
-crt_get_filtered_grp_rank_list(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
-			       d_rank_list_t *exclude_ranks, d_rank_t root,
-			       d_rank_t self, d_rank_t *grp_size,
-			       uint32_t *grp_root, d_rank_t *grp_self,
-			       d_rank_list_t **result_grp_rank_list,
-			       bool *allocated)
+crt_get_filtered_grp_rank_set(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
+			      d_rank_list_t *filter_ranks, bool filter_incl,
+			      d_rank_t root, d_rank_t self, d_rank_t *grp_size,
+			      uint32_t *grp_root, d_rank_t *grp_self,
+			      d_rank_set_t **result_grp_rank_set,
+			      bool *allocated)
 {
-	d_rank_list_t		*grp_rank_list = NULL;
+	d_rank_set_t		*grp_rank_set = NULL;
+	uint32_t		 i;
 	int			 rc = 0;
 
-	if (exclude_ranks == NULL || exclude_ranks->rl_nr == 0) {
-		grp_rank_list = grp_priv->gp_live_ranks;
+	if (filter_incl) {
+		if (filter_ranks == NULL || filter_ranks->rl_nr == 0) {
+			D_DEBUG(DB_TRACE, "empty inclusion list (group %s).\n",
+				grp_priv->gp_pub.cg_grpid);
+			*allocated = false;
+			D_GOTO(out, rc = 0);
+		}
+		rc = d_rank_set_from_list(&grp_rank_set, filter_ranks);
+		if (rc != 0) {
+			D_ERROR("d_rank_set_from_list failed, rc: %d.\n", rc);
+			D_GOTO(out, rc);
+		}
+		D_ASSERT(grp_rank_set != NULL);
+		*allocated = true;
 
-		*grp_size = grp_rank_list->rl_nr;
-		D_ASSERT(*grp_size == grp_rank_list->rl_nr);
+		rc = d_rank_set_intersect(grp_rank_set, grp_priv->gp_live_set);
+		if (rc != 0) {
+			D_ERROR("d_rank_set_intersect failed, rc: %d.\n", rc);
+			D_GOTO(out, rc);
+		}
+		if (d_rank_set_nr(grp_rank_set) == 0) {
+			D_DEBUG(DB_TRACE, "filtered rank set (group %s) "
+				"get empty.\n", grp_priv->gp_pub.cg_grpid);
+			d_rank_set_free(grp_rank_set);
+			grp_rank_set = NULL;
+			*allocated = false;
+			D_GOTO(out, rc = 0);
+		}
+	} else if (filter_ranks == NULL || filter_ranks->rl_nr == 0) {
+		grp_rank_set = grp_priv->gp_live_set;
 		*allocated = false;
 	} else {
-		/* grp_priv->gp_live_ranks/exclude_ranks already sorted
-		 * and unique
-		 */
-		rc = d_rank_list_dup(&grp_rank_list, grp_priv->gp_live_ranks);
-
+		rc = d_rank_set_dup(&grp_rank_set, grp_priv->gp_live_set);
 		if (rc != 0) {
-			D_ERROR("d_rank_list_dup failed, rc: %d.\n", rc);
+			D_ERROR("d_rank_set_dup failed, rc: %d.\n", rc);
 			D_GOTO(out, rc);
 		}
-		D_ASSERT(grp_rank_list != NULL);
-		d_rank_list_filter(exclude_ranks, grp_rank_list,
-				   true /* exclude */);
+		D_ASSERT(grp_rank_set != NULL);
+		*allocated = true;
+
+		for (i = 0; i < filter_ranks->rl_nr; i++) {
+			rc = d_rank_set_del(grp_rank_set,
+					    filter_ranks->rl_ranks[i]);
+			if (rc != 0) {
+				D_ERROR("d_rank_set_del failed, rc: %d.\n",
+					rc);
+				D_GOTO(out, rc);
+			}
+		}
 
-		if (grp_rank_list->rl_nr == 0) {
-			D_DEBUG(DB_TRACE, "d_rank_list_filter(group %s) "
+		if (d_rank_set_nr(grp_rank_set) == 0) {
+			D_DEBUG(DB_TRACE, "filtered rank set (group %s) "
 				"get empty.\n", grp_priv->gp_pub.cg_grpid);
-			d_rank_list_free(grp_rank_list);
-			grp_rank_list = NULL;
+			d_rank_set_free(grp_rank_set);
+			grp_rank_set = NULL;
+			*allocated = false;
 			D_GOTO(out, rc = 0);
 		}
-
-		*allocated = true;
-		*grp_size = grp_rank_list->rl_nr;
 	}
+	*grp_size = d_rank_set_nr(grp_rank_set);
 
-	rc = d_idx_in_rank_list(grp_rank_list,
-				grp_priv->gp_membs->rl_ranks[root], grp_root);
+	rc = d_rank_set_idx(grp_rank_set, grp_priv->gp_membs->rl_ranks[root],
+			    grp_root);
 	if (rc != 0) {
-		D_ERROR("d_idx_in_rank_list (group %s, rank %d), "
+		D_ERROR("d_rank_set_idx (group %s, rank %d), "
 			"failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
 			root, rc);
 		D_GOTO(out, rc);
 	}
-	rc = d_idx_in_rank_list(grp_rank_list,
-				grp_priv->gp_membs->rl_ranks[self], grp_self);
+	rc = d_rank_set_idx(grp_rank_set, grp_priv->gp_membs->rl_ranks[self],
+			    grp_self);
 	if (rc != 0)
-		D_ERROR("d_idx_in_rank_list (group %s, rank %d), "
+		D_ERROR("d_rank_set_idx (group %s, rank %d), "
 			"failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
 			self, rc);
 
 out:
-	if (rc == 0)
-		*result_grp_rank_list = grp_rank_list;
+	if (rc == 0) {
+		*result_grp_rank_set = grp_rank_set;
+	} else if (*allocated) {
+		d_rank_set_free(grp_rank_set);
+		*allocated = false;
+	}
+	return rc;
+}
+
+int
+crt_tree_cache_init(struct crt_grp_priv *grp_priv)
+{
+	int	rc;
+
+	rc = D_MUTEX_INIT(&grp_priv->gp_tree_cache_lock, NULL);
+	if (rc != 0)
+		D_ERROR("D_MUTEX_INIT failed, rc: %d.\n", rc);
+	return rc;
+}
+
+static void
+crt_tree_cache_ent_free(struct crt_tree_cache_ent *ent)
+{
+	D_FREE(ent->tc_filter_ranks);
+	D_FREE(ent->tc_children);
+	memset(ent, 0, sizeof(*ent));
+}
+
+void
+crt_tree_cache_fini(struct crt_grp_priv *grp_priv)
+{
+	int	i;
+
+	for (i = 0; i < CRT_TREE_CACHE_NR; i++)
+		crt_tree_cache_ent_free(&grp_priv->gp_tree_cache[i]);
+	D_MUTEX_DESTROY(&grp_priv->gp_tree_cache_lock);
+}
+
+static inline bool
+crt_tree_cache_match(struct crt_tree_cache_ent *ent, uint32_t membs_ver,
+		     d_rank_list_t *filter_ranks, bool filter_incl,
+		     uint64_t filter_hash, int tree_topo, d_rank_t root,
+		     d_rank_t self)
+{
+	if (!ent->tc_valid || ent->tc_membs_ver != membs_ver ||
+	    ent->tc_tree_topo != tree_topo || ent->tc_root != root ||
+	    ent->tc_self != self || ent->tc_filter_hash != filter_hash ||
+	    ent->tc_filter_incl != filter_incl)
+		return false;
+	if (ent->tc_filter_nr == 0)
+		return filter_ranks == NULL || filter_ranks->rl_nr == 0;
+	return filter_ranks != NULL &&
+	       filter_ranks->rl_nr == ent->tc_filter_nr &&
+	       memcmp(filter_ranks->rl_ranks, ent->tc_filter_ranks,
+		      ent->tc_filter_nr * sizeof(d_rank_t)) == 0;
+}
+
+/*
+ * Host id of each rank of grp_rank_set, in set order, for CRT_TREE_HIER.
+ * *grp_hosts is left NULL when the host map of the primary group is unknown.
+ */
+static int
+crt_tree_grp_hosts(d_rank_set_t *grp_rank_set, uint32_t **grp_hosts,
+		   uint32_t *host_nr)
+{
+	struct crt_grp_priv	*default_grp_priv;
+	d_rank_list_t		*ranks = NULL;
+	uint32_t		*hosts;
+	uint32_t		 i;
+	int			 rc;
+
+	*grp_hosts = NULL;
+	default_grp_priv = crt_grp_pub2priv(NULL);
+	D_ASSERT(default_grp_priv != NULL);
+	if (default_grp_priv->gp_host_ids == NULL) {
+		D_DEBUG(DB_TRACE, "no host map, HIER tree is a knomial one.\n");
+		return 0;
+	}
+
+	rc = d_rank_set_to_list(grp_rank_set, &ranks);
+	if (rc != 0)
+		return rc;
+	D_ALLOC_ARRAY(hosts, ranks->rl_nr);
+	if (hosts == NULL) {
+		d_rank_list_free(ranks);
+		return -DER_NOMEM;
+	}
+	for (i = 0; i < ranks->rl_nr; i++) {
+		D_ASSERT(ranks->rl_ranks[i] < default_grp_priv->gp_size);
+		hosts[i] = default_grp_priv->gp_host_ids[ranks->rl_ranks[i]];
+	}
+	d_rank_list_free(ranks);
+
+	*grp_hosts = hosts;
+	*host_nr = default_grp_priv->gp_host_nr;
+	return 0;
+}
+
+/*
+ * HIER becomes a knomial tree of the same ratio when this rank has no host
+ * map, otherwise *host_map is set to the hash of the map. It is 0 for other
+ * trees.
+ */
+int
+crt_tree_hier_resolve(int tree_topo, uint64_t *host_map)
+{
+	struct crt_grp_priv	*default_grp_priv;
+
+	*host_map = 0;
+	if (crt_tree_type(tree_topo) != CRT_TREE_HIER)
+		return tree_topo;
+
+	default_grp_priv = crt_grp_pub2priv(NULL);
+	D_ASSERT(default_grp_priv != NULL);
+	if (default_grp_priv->gp_host_map == 0) {
+		D_DEBUG(DB_TRACE, "no host map, HIER tree is a knomial one.\n");
+		return crt_tree_topo(CRT_TREE_KNOMIAL,
+				     crt_tree_ratio(tree_topo));
+	}
+	*host_map = default_grp_priv->gp_host_map;
+
+	return tree_topo;
+}
+
+/* a HIER tree resolved on another rank must be built on our host map */
+int
+crt_tree_hier_check(int tree_topo, uint64_t host_map)
+{
+	struct crt_grp_priv	*default_grp_priv;
+
+	if (crt_tree_type(tree_topo) != CRT_TREE_HIER)
+		return 0;
+
+	default_grp_priv = crt_grp_pub2priv(NULL);
+	D_ASSERT(default_grp_priv != NULL);
+	if (default_grp_priv->gp_host_map != host_map) {
+		D_ERROR("HIER tree on host map "DF_X64", ours is "DF_X64".\n",
+			host_map, default_grp_priv->gp_host_map);
+		return -DER_MISMATCH;
+	}
+
+	return 0;
+}
+
+/*
+ * Compute this rank's node of the tree from the live rank set of the group.
+ * Only errors that do not depend on the tree (bad root or self) are returned,
+ * ent->tc_parent_rc carries the to_get_parent result.
+ */
+static int
+crt_tree_node_build(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
+		    d_rank_list_t *filter_ranks, bool filter_incl,
+		    int tree_topo, d_rank_t root, d_rank_t self,
+		    struct crt_tree_cache_ent *ent)
+{
+	d_rank_set_t		*grp_rank_set = NULL;
+	d_rank_t		 grp_root, grp_self;
+	bool			 allocated = false;
+	uint32_t		 tree_type, tree_ratio;
+	uint32_t		 grp_size, tree_parent;
+	uint32_t		*tree_children = NULL;
+	uint32_t		*grp_hosts = NULL;
+	uint32_t		 host_nr = 0;
+	struct crt_topo_ops	*tops;
+	uint32_t		 i;
+	int			 rc = 0;
+
+	/*
+	 * grp_rank_set is the target group (filtered out the excluded ranks)
+	 * for building the tree, rank number in it is for primary group.
+	 */
+	rc = crt_get_filtered_grp_rank_set(grp_priv, grp_ver, filter_ranks,
+					   filter_incl, root, self, &grp_size,
+					   &grp_root, &grp_self, &grp_rank_set,
+					   &allocated);
+	if (rc != 0) {
+		D_ERROR("crt_get_filtered_grp_rank_set(group %s, root %d, "
+			"self %d) failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
+			root, self, rc);
+		D_GOTO(out, rc);
+	}
+	if (grp_rank_set == NULL) {
+		ent->tc_empty = 1;
+		D_GOTO(out, rc = 0);
+	}
+
+	tree_type = crt_tree_type(tree_topo);
+	tree_ratio = crt_tree_ratio(tree_topo);
+	tops = crt_tops[tree_type];
+	if (tree_type == CRT_TREE_HIER) {
+		rc = crt_tree_grp_hosts(grp_rank_set, &grp_hosts, &host_nr);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+
+	if (grp_hosts != NULL)
+		rc = crt_hier_get_children(grp_size, tree_ratio, grp_root,
+					   grp_self, grp_hosts, host_nr, NULL,
+					   &ent->tc_nchildren);
+	else
+		rc = tops->to_get_children_cnt(grp_size, tree_ratio, grp_root,
+					       grp_self, &ent->tc_nchildren);
+	if (rc != 0) {
+		D_ERROR("to_get_children_cnt (group %s, root %d, self %d) "
+			"failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
+			root, self, rc);
+		D_GOTO(out, rc);
+	}
+	if (ent->tc_nchildren > 0) {
+		D_ALLOC_ARRAY(tree_children, ent->tc_nchildren);
+		D_ALLOC_ARRAY(ent->tc_children, ent->tc_nchildren);
+		if (tree_children == NULL || ent->tc_children == NULL)
+			D_GOTO(out, rc = -DER_NOMEM);
+		if (grp_hosts != NULL)
+			rc = crt_hier_get_children(grp_size, tree_ratio,
+						   grp_root, grp_self,
+						   grp_hosts, host_nr,
+						   tree_children,
+						   &ent->tc_nchildren);
+		else
+			rc = tops->to_get_children(grp_size, tree_ratio,
+						   grp_root, grp_self,
+						   tree_children);
+		if (rc != 0) {
+			D_ERROR("to_get_children (group %s, root %d, self %d) "
+				"failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
+				root, self, rc);
+			D_GOTO(out, rc);
+		}
+		for (i = 0; i < ent->tc_nchildren; i++) {
+			rc = d_rank_set_rank(grp_rank_set, tree_children[i],
+					     &ent->tc_children[i]);
+			D_ASSERT(rc == 0);
+		}
+	}
+
+	if (grp_hosts != NULL)
+		ent->tc_parent_rc = crt_hier_get_parent(grp_size, tree_ratio,
+							grp_root, grp_self,
+							grp_hosts, host_nr,
+							&tree_parent);
+	else
+		ent->tc_parent_rc = tops->to_get_parent(grp_size, tree_ratio,
+							grp_root, grp_self,
+							&tree_parent);
+	if (ent->tc_parent_rc == 0)
+		ent->tc_parent_rc = d_rank_set_rank(grp_rank_set, tree_parent,
+						    &ent->tc_parent);
+
+out:
+	D_FREE(grp_hosts);
+	D_FREE(tree_children);
+	if (rc != 0)
+		D_FREE(ent->tc_children);
+	if (allocated)
+		d_rank_set_free(grp_rank_set);
 	return rc;
 }
 
+/*
+ * Look up this rank's node of the tree, computing and memoizing it on a miss.
+ * On success the node is copied to *node, with node->tc_children pointing into
+ * the cache, so it is only usable while the cache lock is held: the caller
+ * must call crt_tree_node_put() when done with it.
+ *
+ * Caller holds gp_rwlock_ft, so the live set and the version are stable.
+ */
+static int
+crt_tree_node_get(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
+		  d_rank_list_t *filter_ranks, bool filter_incl, int tree_topo,
+		  d_rank_t root, d_rank_t self,
+		  struct crt_tree_cache_ent **node)
+{
+	struct crt_grp_priv		*default_grp_priv;
+	struct crt_tree_cache_ent	 new_ent = {0};
+	struct crt_tree_cache_ent	*ent;
+	struct crt_tree_cache_ent	*victim = NULL;
+	uint32_t			 membs_ver;
+	uint64_t			 filter_hash = 0;
+	uint32_t			 filter_nr = 0;
+	int				 i;
+	int				 rc;
+
+	/* every live set change bumps the primary group's version */
+	default_grp_priv = crt_grp_pub2priv(NULL);
+	D_ASSERT(default_grp_priv != NULL);
+	membs_ver = default_grp_priv->gp_membs_ver;
+
+	if (filter_ranks != NULL && filter_ranks->rl_nr > 0) {
+		filter_nr = filter_ranks->rl_nr;
+		filter_hash = d_hash_murmur64(
+				(unsigned char *)filter_ranks->rl_ranks,
+				filter_nr * sizeof(d_rank_t), 0);
+	}
+
+	D_MUTEX_LOCK(&grp_priv->gp_tree_cache_lock);
+	for (i = 0; i < CRT_TREE_CACHE_NR; i++) {
+		ent = &grp_priv->gp_tree_cache[i];
+		if (crt_tree_cache_match(ent, membs_ver, filter_ranks,
+					 filter_incl, filter_hash, tree_topo,
+					 root, self)) {
+			ent->tc_stamp = ++grp_priv->gp_tree_cache_clock;
+			*node = ent;
+			return 0;
+		}
+	}
+	D_MUTEX_UNLOCK(&grp_priv->gp_tree_cache_lock);
+
+	/* miss, build the node without holding the cache lock */
+	new_ent.tc_membs_ver = membs_ver;
+	new_ent.tc_tree_topo = tree_topo;
+	new_ent.tc_root = root;
+	new_ent.tc_self = self;
+	new_ent.tc_filter_hash = filter_hash;
+	new_ent.tc_filter_nr = filter_nr;
+	new_ent.tc_filter_incl = filter_incl;
+	if (filter_nr > 0) {
+		D_ALLOC_ARRAY(new_ent.tc_filter_ranks, filter_nr);
+		if (new_ent.tc_filter_ranks == NULL)
+			return -DER_NOMEM;
+		memcpy(new_ent.tc_filter_ranks, filter_ranks->rl_ranks,
+		       filter_nr * sizeof(d_rank_t));
+	}
+	rc = crt_tree_node_build(grp_priv, grp_ver, filter_ranks, filter_incl,
+				 tree_topo, root, self, &new_ent);
+	if (rc != 0) {
+		crt_tree_cache_ent_free(&new_ent);
+		return rc;
+	}
+	new_ent.tc_valid = 1;
+
+	/*
+	 * Install it over an entry of an older version if any, or the least
+	 * recently used one. A racing thread may have installed the same node
+	 * meanwhile, use that one then.
+	 */
+	D_MUTEX_LOCK(&grp_priv->gp_tree_cache_lock);
+	for (i = 0; i < CRT_TREE_CACHE_NR; i++) {
+		ent = &grp_priv->gp_tree_cache[i];
+		if (crt_tree_cache_match(ent, membs_ver, filter_ranks,
+					 filter_incl, filter_hash, tree_topo,
+					 root, self)) {
+			crt_tree_cache_ent_free(&new_ent);
+			victim = ent;
+			break;
+		}
+		if (ent->tc_valid && ent->tc_membs_ver != membs_ver)
+			crt_tree_cache_ent_free(ent);
+		if (victim == NULL || !ent->tc_valid ||
+		    (victim->tc_valid && ent->tc_stamp < victim->tc_stamp))
+			victim = ent;
+	}
+	if (new_ent.tc_valid) {
+		crt_tree_cache_ent_free(victim);
+		*victim = new_ent;
+	}
+	victim->tc_stamp = ++grp_priv->gp_tree_cache_clock;
+	*node = victim;
+	return 0;
+}
+
+static inline void
+crt_tree_node_put(struct crt_grp_priv *grp_priv)
+{
+	D_MUTEX_UNLOCK(&grp_priv->gp_tree_cache_lock);
+}
+
 #define CRT_TREE_PARAMETER_CHECKING(grp_priv, tree_topo, root, self)	       \
 	do {								       \
 		D_ASSERT(grp_priv != NULL && grp_priv->gp_membs != NULL	       \
-			 && grp_priv->gp_live_ranks != NULL);		       \
+			 && grp_priv->gp_live_set != NULL);		       \
 									       \
 		D_ASSERT(root < grp_priv->gp_size && self < grp_priv->gp_size);\
 		D_ASSERT(crt_tree_topo_valid(tree_topo));		       \
@@ -126,22 +523,19 @@ out:
 /*
  * query number of children.
  *
- * rank number of grp_priv->gp_membs, grp_priv->gp_live_ranks and exclude_ranks
+ * rank number of grp_priv->gp_membs, grp_priv->gp_live_set and filter_ranks
  * are primary rank.  grp_root and grp_self are logical rank number within the
  * group.
  */
 int
 crt_tree_get_nchildren(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
-		       d_rank_list_t *exclude_ranks, int tree_topo,
-		       d_rank_t root, d_rank_t self, uint32_t *nchildren)
+		       d_rank_list_t *filter_ranks, bool filter_incl,
+		       int tree_topo, d_rank_t root, d_rank_t self,
+		       uint32_t *nchildren)
 {
-	d_rank_list_t		*grp_rank_list = NULL;
-	d_rank_t		 grp_root, grp_self;
-	bool			 allocated = false;
-	uint32_t		 tree_type, tree_ratio;
-	uint32_t		 grp_size;
-	struct crt_topo_ops	*tops;
-	int			 rc = 0;
+	struct crt_tree_cache_ent	*node;
+	uint32_t			 tree_type, tree_ratio;
+	int				 rc = 0;
 
 	D_RWLOCK_RDLOCK(grp_priv->gp_rwlock_ft);
 
@@ -151,64 +545,42 @@ crt_tree_get_nchildren(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
 		D_GOTO(out, rc = -DER_INVAL);
 	}
 
-	/*
-	 * grp_rank_list is the target group (filtered out the excluded ranks)
-	 * for building the tree, rank number in it is for primary group.
-	 */
-	rc = crt_get_filtered_grp_rank_list(grp_priv, grp_ver, exclude_ranks,
-					    root, self, &grp_size, &grp_root,
-					    &grp_self, &grp_rank_list,
-					    &allocated);
-	if (rc != 0) {
-		D_ERROR("crt_get_filtered_grp_rank_list(group %s, root %d, "
-			"self %d) failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
-			root, self, rc);
+	rc = crt_tree_node_get(grp_priv, grp_ver, filter_ranks, filter_incl,
+			       tree_topo, root, self, &node);
+	if (rc != 0)
 		D_GOTO(out, rc);
-	}
-	if (grp_rank_list == NULL) {
-		D_ERROR("crt_get_filtered_grp_rank_list(group %s) get empty.\n",
+	if (node->tc_empty) {
+		D_ERROR("crt_get_filtered_grp_rank_set(group %s) get empty.\n",
 			grp_priv->gp_pub.cg_grpid);
-		D_GOTO(out, rc = -DER_INVAL);
+		rc = -DER_INVAL;
+	} else {
+		*nchildren = node->tc_nchildren;
 	}
-
-	tops = crt_tops[tree_type];
-	rc = tops->to_get_children_cnt(grp_size, tree_ratio, grp_root, grp_self,
-				       nchildren);
-	if (rc != 0)
-		D_ERROR("to_get_children_cnt (group %s, root %d, self %d) "
-			"failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
-			root, self, rc);
+	crt_tree_node_put(grp_priv);
 
 out:
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
-	if (allocated)
-		d_rank_list_free(grp_rank_list);
 	return rc;
 }
 
 /*
  * query children rank list (rank number in primary group).
  *
- * rank number of grp_priv->gp_membs, grp_priv->gp_live_ranks and exclude_ranks
+ * rank number of grp_priv->gp_membs, grp_priv->gp_live_set and filter_ranks
  * are primary rank.  grp_root and grp_self are logical rank number within the
  * group.
  */
 int
 crt_tree_get_children(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
-		      d_rank_list_t *exclude_ranks, int tree_topo,
-		      d_rank_t root, d_rank_t self,
+		      d_rank_list_t *filter_ranks, bool filter_incl,
+		      int tree_topo, d_rank_t root, d_rank_t self,
 		      d_rank_list_t **children_rank_list, bool *ver_match)
 {
-	d_rank_list_t		*grp_rank_list = NULL;
-	d_rank_list_t		*result_rank_list = NULL;
-	d_rank_t		 grp_root, grp_self;
-	bool			 allocated = false;
-	uint32_t		 tree_type, tree_ratio;
-	uint32_t		 grp_size, nchildren;
-	uint32_t		 *tree_children;
-	struct crt_topo_ops	*tops;
-	struct crt_grp_priv	*default_grp_priv;
-	int			 i, rc = 0;
+	struct crt_tree_cache_ent	*node;
+	d_rank_list_t			*result_rank_list = NULL;
+	uint32_t			 tree_type, tree_ratio;
+	struct crt_grp_priv		*default_grp_priv;
+	int				 rc = 0;
 
 
 	default_grp_priv = crt_grp_pub2priv(NULL);
@@ -225,85 +597,41 @@ crt_tree_get_children(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
 		D_GOTO(out, rc = -DER_INVAL);
 	}
 
-	/*
-	 * grp_rank_list is the target group (filtered out the excluded ranks)
-	 * for building the tree, rank number in it is for primary group.
-	 */
-	rc = crt_get_filtered_grp_rank_list(grp_priv, grp_ver, exclude_ranks,
-					    root, self, &grp_size, &grp_root,
-					    &grp_self, &grp_rank_list,
-					    &allocated);
-	if (rc != 0) {
-		D_ERROR("crt_get_filtered_grp_rank_list(group %s, root %d, "
-			"self %d) failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
-			root, self, rc);
+	rc = crt_tree_node_get(grp_priv, grp_ver, filter_ranks, filter_incl,
+			       tree_topo, root, self, &node);
+	if (rc != 0)
 		D_GOTO(out, rc);
-	}
-	if (grp_rank_list == NULL) {
-		D_DEBUG(DB_TRACE, "crt_get_filtered_grp_rank_list(group %s) "
-			"get empty.\n", grp_priv->gp_pub.cg_grpid);
+	if (node->tc_empty || node->tc_nchildren == 0) {
+		if (node->tc_empty)
+			D_DEBUG(DB_TRACE, "crt_get_filtered_grp_rank_set(group "
+				"%s) get empty.\n", grp_priv->gp_pub.cg_grpid);
 		*children_rank_list = NULL;
-		D_GOTO(out, rc);
+		D_GOTO(out_put, rc = 0);
 	}
 
-	tops = crt_tops[tree_type];
-	rc = tops->to_get_children_cnt(grp_size, tree_ratio, grp_root, grp_self,
-				       &nchildren);
-	if (rc != 0) {
-		D_ERROR("to_get_children_cnt (group %s, root %d, self %d) "
-			"failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
-			root, self, rc);
-		D_GOTO(out, rc);
-	}
-	if (nchildren == 0) {
-		*children_rank_list = NULL;
-		D_GOTO(out, rc = 0);
-	}
-	result_rank_list = d_rank_list_alloc(nchildren);
+	result_rank_list = d_rank_list_alloc(node->tc_nchildren);
 	if (result_rank_list == NULL)
-		D_GOTO(out, rc = -DER_NOMEM);
-	D_ALLOC_ARRAY(tree_children, nchildren);
-	if (tree_children == NULL) {
-		d_rank_list_free(result_rank_list);
-		D_GOTO(out, rc = -DER_NOMEM);
-	}
-	rc = tops->to_get_children(grp_size, tree_ratio, grp_root, grp_self,
-				   tree_children);
-	if (rc != 0) {
-		D_ERROR("to_get_children (group %s, root %d, self %d) "
-			"failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
-			root, self, rc);
-		d_rank_list_free(result_rank_list);
-		D_FREE(tree_children);
-		D_GOTO(out, rc);
-	}
-
-	for (i = 0; i < nchildren; i++)
-		result_rank_list->rl_ranks[i] =
-			grp_rank_list->rl_ranks[tree_children[i]];
-
-	D_FREE(tree_children);
+		D_GOTO(out_put, rc = -DER_NOMEM);
+	memcpy(result_rank_list->rl_ranks, node->tc_children,
+	       node->tc_nchildren * sizeof(d_rank_t));
 	*children_rank_list = result_rank_list;
 
+out_put:
+	crt_tree_node_put(grp_priv);
 out:
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
-	if (allocated)
-		d_rank_list_free(grp_rank_list);
 	return rc;
 }
 
 int
 crt_tree_get_parent(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
-		    d_rank_list_t *exclude_ranks, int tree_topo,
-		    d_rank_t root, d_rank_t self, d_rank_t *parent_rank)
+		    d_rank_list_t *filter_ranks, bool filter_incl,
+		    int tree_topo, d_rank_t root, d_rank_t self,
+		    d_rank_t *parent_rank)
 {
-	d_rank_list_t		*grp_rank_list = NULL;
-	d_rank_t		 grp_root, grp_self;
-	bool			 allocated = false;
-	uint32_t		 tree_type, tree_ratio;
-	uint32_t		 grp_size, tree_parent;
-	struct crt_topo_ops	*tops;
-	int			 rc = 0;
+	struct crt_tree_cache_ent	*node;
+	uint32_t			 tree_type, tree_ratio;
+	int				 rc = 0;
 
 	D_RWLOCK_RDLOCK(grp_priv->gp_rwlock_ft);
 
@@ -313,40 +641,26 @@ crt_tree_get_parent(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
 		D_GOTO(out, rc = -DER_INVAL);
 	}
 
-	/*
-	 * grp_rank_list is the target group (filtered out the excluded ranks)
-	 * for building the tree, rank number in it is for primary group.
-	 */
-	rc = crt_get_filtered_grp_rank_list(grp_priv, grp_ver, exclude_ranks,
-					    root, self, &grp_size, &grp_root,
-					    &grp_self, &grp_rank_list,
-					    &allocated);
-	if (rc != 0) {
-		D_ERROR("crt_get_filtered_grp_rank_list(group %s, root %d, "
-			"self %d) failed, rc: %d.\n", grp_priv->gp_pub.cg_grpid,
-			root, self, rc);
+	rc = crt_tree_node_get(grp_priv, grp_ver, filter_ranks, filter_incl,
+			       tree_topo, root, self, &node);
+	if (rc != 0)
 		D_GOTO(out, rc);
-	}
-	if (grp_rank_list == NULL) {
-		D_DEBUG(DB_TRACE, "crt_get_filtered_grp_rank_list(group %s) "
+	if (node->tc_empty) {
+		D_DEBUG(DB_TRACE, "crt_get_filtered_grp_rank_set(group %s) "
 			"get empty.\n", grp_priv->gp_pub.cg_grpid);
-		D_GOTO(out, rc = -DER_INVAL);
-	}
-
-	tops = crt_tops[tree_type];
-	rc = tops->to_get_parent(grp_size, tree_ratio, grp_root, grp_self,
-				 &tree_parent);
-	if (rc != 0) {
+		rc = -DER_INVAL;
+	} else if (node->tc_parent_rc != 0) {
 		D_ERROR("to_get_parent (group %s, root %d, self %d) failed, "
-			"rc: %d.\n", grp_priv->gp_pub.cg_grpid, root, self, rc);
+			"rc: %d.\n", grp_priv->gp_pub.cg_grpid, root, self,
+			node->tc_parent_rc);
+		rc = node->tc_parent_rc;
+	} else {
+		*parent_rank = node->tc_parent;
 	}
-
-	*parent_rank = grp_rank_list->rl_ranks[tree_parent];
+	crt_tree_node_put(grp_priv);
 
 out:
 	D_RWLOCK_UNLOCK(grp_priv->gp_rwlock_ft);
-	if (allocated)
-		d_rank_list_free(grp_rank_list);
 	return rc;
 }
 
@@ -355,4 +669,5 @@ struct crt_topo_ops *crt_tops[] = {
 	&crt_flat_ops,		/* CRT_TREE_FLAT */
 	&crt_kary_ops,		/* CRT_TREE_KARY */
 	&crt_knomial_ops,	/* CRT_TREE_KNOMIAL */
+	&crt_knomial_ops,	/* CRT_TREE_HIER, without a host map */
 };
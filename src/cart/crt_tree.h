@@ -45,21 +45,26 @@
 
 /*
  * Query specific tree topo's number of children, child rank number, or parent
- * rank number.
+ * rank number. The tree is built over the live ranks of the group minus
+ * filter_ranks, or with filter_incl over the live ranks of filter_ranks only.
  */
 int crt_tree_get_nchildren(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
-			   d_rank_list_t *exclude_ranks, int tree_topo,
-			   d_rank_t grp_root, d_rank_t grp_self,
+			   d_rank_list_t *filter_ranks, bool filter_incl,
+			   int tree_topo, d_rank_t grp_root, d_rank_t grp_self,
 			   uint32_t *nchildren);
 int crt_tree_get_children(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
-			  d_rank_list_t *exclude_ranks, int tree_topo,
-			  d_rank_t grp_root, d_rank_t grp_self,
+			  d_rank_list_t *filter_ranks, bool filter_incl,
+			  int tree_topo, d_rank_t grp_root, d_rank_t grp_self,
 			  d_rank_list_t **children_rank_list, bool *ver_match);
 int crt_tree_get_parent(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
-			d_rank_list_t *exclude_ranks, int tree_topo,
-			d_rank_t grp_root, d_rank_t grp_self,
+			d_rank_list_t *filter_ranks, bool filter_incl,
+			int tree_topo, d_rank_t grp_root, d_rank_t grp_self,
 			d_rank_t *parent_rank);
 
+/* set up and release the memoized tree nodes of a group */
+int crt_tree_cache_init(struct crt_grp_priv *grp_priv);
+void crt_tree_cache_fini(struct crt_grp_priv *grp_priv);
+
 /*
  * all specific tree type's calculations are based on group rank number.
  * some different types of rank:
@@ -101,6 +106,42 @@ extern struct crt_topo_ops	 crt_knomial_ops;
 
 extern struct crt_topo_ops	*crt_tops[];
 
+/* knomial tree over tree ranks [0, size) rooted at 0, used by HIER as well */
+uint32_t crt_knomial_tree_children(uint32_t *children, uint32_t self,
+				   uint32_t size, uint32_t ratio);
+uint32_t crt_knomial_tree_parent(uint32_t self, uint32_t ratio);
+
+/*
+ * CRT_TREE_HIER also needs the host of each group rank, so it is not a
+ * crt_topo_ops. grp_hosts[i] is the host id of group rank i, in [0, host_nr).
+ */
+int crt_hier_get_children(uint32_t grp_size, uint32_t tree_ratio,
+			  uint32_t grp_root, uint32_t grp_self,
+			  const uint32_t *grp_hosts, uint32_t host_nr,
+			  uint32_t *children, uint32_t *nchildren);
+int crt_hier_get_parent(uint32_t grp_size, uint32_t tree_ratio,
+			uint32_t grp_root, uint32_t grp_self,
+			const uint32_t *grp_hosts, uint32_t host_nr,
+			uint32_t *parent);
+
+/*
+ * CRT_TREE_AUTO is resolved to a concrete tree topology by the root of a
+ * collective, the tree functions above never see it. rank_nr is the number
+ * of ranks the collective reaches, 0 for the whole group.
+ */
+int crt_tree_auto_select(struct crt_grp_priv *grp_priv, uint32_t rank_nr,
+			 uint64_t payload);
+/*
+ * A CRT_TREE_HIER tree is only the same on every rank if they all have the
+ * same host map. The root of a collective resolves the topology it sends
+ * with crt_tree_hier_resolve(), the other ranks check it against their own
+ * map with crt_tree_hier_check().
+ */
+int crt_tree_hier_resolve(int tree_topo, uint64_t *host_map);
+int crt_tree_hier_check(int tree_topo, uint64_t host_map);
+/* feed the round trip in us of a point-to-point RPC to CRT_TREE_AUTO */
+void crt_tree_hop_sample(uint64_t us);
+
 /* some simple helpers */
 static inline int
 crt_tree_type(int tree_topo)
@@ -122,9 +163,11 @@ crt_tree_topo_valid(int tree_topo)
 
 	tree_type = crt_tree_type(tree_topo);
 	tree_ratio = crt_tree_ratio(tree_topo);
-	if (tree_type >= CRT_TREE_MIN && tree_type <= CRT_TREE_MAX &&
-	    (tree_type == CRT_TREE_FLAT || (tree_ratio >= CRT_TREE_MIN_RATIO &&
-					   tree_ratio <= CRT_TREE_MAX_RATIO))) {
+	if (tree_type == CRT_TREE_AUTO ||
+	    (tree_type >= CRT_TREE_MIN && tree_type <= CRT_TREE_MAX &&
+	     (tree_type == CRT_TREE_FLAT ||
+	      (tree_ratio >= CRT_TREE_MIN_RATIO &&
+	       tree_ratio <= CRT_TREE_MAX_RATIO)))) {
 		valid = true;
 	} else {
 		D_ERROR("invalid parameter, tree_type %d, tree_ratio %d.\n",
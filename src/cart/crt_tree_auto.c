@@ -0,0 +1,246 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It chooses the tree of CRT_TREE_AUTO collectives.
+ *
+ * The default model estimates when the last rank has received the payload.
+ * Every hop costs one round trip, and a rank sends to its children one after
+ * the other, each send costing a fixed overhead plus the payload over the
+ * link bandwidth. The round trip is measured on point-to-point RPCs.
+ */
+#define D_LOGFAC	DD_FAC(grp)
+
+#include "crt_internal.h"
+
+/* round trip in us used until a point-to-point RPC has been measured */
+#define CRT_TREE_AUTO_HOP_US		(20)
+/* sender side overhead of each message in ns */
+#define CRT_TREE_AUTO_SEND_NS		(2000)
+/* link bandwidth in MB/s, i.e. bytes per us */
+#define CRT_TREE_AUTO_BW_MBS		(5000)
+/* a hop within a host is taken as this many times cheaper than the average */
+#define CRT_TREE_AUTO_LOCAL_DIV		(4)
+/* branch ratios tried by the default model */
+#define CRT_TREE_AUTO_MAX_RATIO		(32)
+
+/* 8 times the moving average of the round trip in us, 0 if no sample yet */
+static uint64_t			crt_tree_hop_us8;
+
+static pthread_rwlock_t		crt_tree_auto_lock = PTHREAD_RWLOCK_INITIALIZER;
+static crt_tree_auto_cb_t	crt_tree_auto_cb = crt_tree_auto_default;
+static void			*crt_tree_auto_arg;
+
+void
+crt_tree_hop_sample(uint64_t us)
+{
+	uint64_t	avg8, avg;
+
+	if (us == 0)
+		us = 1;
+
+	/*
+	 * Racing updates may lose a sample, that is fine for an estimate. The
+	 * round trip includes the RPC handler, so one slow handler is only
+	 * allowed to double the average.
+	 */
+	avg8 = __atomic_load_n(&crt_tree_hop_us8, __ATOMIC_RELAXED);
+	if (avg8 == 0) {
+		avg8 = us * 8;
+	} else {
+		avg = avg8 / 8;
+		if (us > 2 * avg)
+			us = 2 * avg;
+		avg8 = avg8 - avg + us;
+	}
+	__atomic_store_n(&crt_tree_hop_us8, avg8, __ATOMIC_RELAXED);
+}
+
+/* time in ns for the payload to reach the last of grp_size ranks */
+static uint64_t
+crt_tree_auto_cost(uint32_t tree_type, uint32_t ratio, uint32_t grp_size,
+		   uint64_t hop_ns, uint64_t send_ns)
+{
+	uint64_t	reach, width;
+	uint32_t	depth, m;
+
+	switch (tree_type) {
+	case CRT_TREE_FLAT:
+		return hop_ns + (grp_size - 1) * send_ns;
+	case CRT_TREE_KARY:
+		/* every level waits for the last of ratio sends */
+		depth = 0;
+		for (reach = 1, width = 1; reach < grp_size; reach += width) {
+			width *= ratio;
+			depth++;
+		}
+		return depth * (hop_ns + ratio * send_ns);
+	case CRT_TREE_KNOMIAL:
+		/*
+		 * A rank at level i sends to (ratio - 1) * (depth - i) children,
+		 * smallest subtrees first, so the critical path follows the
+		 * last child of each level.
+		 */
+		depth = 0;
+		for (m = grp_size - 1; m > 0; m /= ratio)
+			depth++;
+		return depth * hop_ns +
+		       (uint64_t)(ratio - 1) * depth * (depth + 1) / 2 *
+		       send_ns;
+	default:
+		D_ASSERT(0);
+		return 0;
+	}
+}
+
+/*
+ * HIER crosses the network only between the leaders of the hosts, the ranks
+ * of a host are reached by cheaper local hops.
+ */
+static uint64_t
+crt_tree_auto_cost_hier(uint32_t ratio, uint32_t grp_size, uint32_t host_nr,
+			uint64_t hop_ns, uint64_t send_ns)
+{
+	uint32_t	local_nr = (grp_size + host_nr - 1) / host_nr;
+
+	return crt_tree_auto_cost(CRT_TREE_KNOMIAL, ratio, host_nr, hop_ns,
+				  send_ns) +
+	       crt_tree_auto_cost(CRT_TREE_KNOMIAL, ratio, local_nr,
+				  hop_ns / CRT_TREE_AUTO_LOCAL_DIV, send_ns);
+}
+
+int
+crt_tree_auto_default(const struct crt_tree_auto_in *in, void *arg)
+{
+	uint32_t	tree_types[] = { CRT_TREE_KARY, CRT_TREE_KNOMIAL };
+	uint32_t	best_type = CRT_TREE_FLAT;
+	uint32_t	best_ratio = 0;
+	uint64_t	hop_ns, send_ns, cost, best;
+	uint32_t	host_nr, ratio, i;
+
+	D_ASSERT(in != NULL);
+	if (in->tai_grp_size <= 2)
+		return crt_tree_topo(CRT_TREE_FLAT, 0);
+
+	hop_ns = (in->tai_hop_us != 0 ? in->tai_hop_us :
+		  CRT_TREE_AUTO_HOP_US) * 1000;
+	send_ns = CRT_TREE_AUTO_SEND_NS +
+		  in->tai_payload * 1000 / CRT_TREE_AUTO_BW_MBS;
+
+	host_nr = min(in->tai_host_nr, in->tai_grp_size);
+
+	best = crt_tree_auto_cost(CRT_TREE_FLAT, 0, in->tai_grp_size, hop_ns,
+				  send_ns);
+	for (ratio = CRT_TREE_MIN_RATIO;
+	     ratio <= CRT_TREE_AUTO_MAX_RATIO && ratio < in->tai_grp_size;
+	     ratio++) {
+		for (i = 0; i < ARRAY_SIZE(tree_types); i++) {
+			cost = crt_tree_auto_cost(tree_types[i], ratio,
+						  in->tai_grp_size, hop_ns,
+						  send_ns);
+			if (cost < best) {
+				best = cost;
+				best_type = tree_types[i];
+				best_ratio = ratio;
+			}
+		}
+		if (host_nr <= 1 || host_nr == in->tai_grp_size)
+			continue;
+		cost = crt_tree_auto_cost_hier(ratio, in->tai_grp_size,
+					       host_nr, hop_ns, send_ns);
+		if (cost < best) {
+			best = cost;
+			best_type = CRT_TREE_HIER;
+			best_ratio = ratio;
+		}
+	}
+
+	return crt_tree_topo(best_type, best_ratio);
+}
+
+int
+crt_tree_auto_register(crt_tree_auto_cb_t cb, void *arg)
+{
+	if (!crt_is_service()) {
+		D_ERROR("tree selection invalid on client-side.\n");
+		return -DER_NO_PERM;
+	}
+
+	D_RWLOCK_WRLOCK(&crt_tree_auto_lock);
+	crt_tree_auto_cb = (cb != NULL) ? cb : crt_tree_auto_default;
+	crt_tree_auto_arg = (cb != NULL) ? arg : NULL;
+	D_RWLOCK_UNLOCK(&crt_tree_auto_lock);
+
+	return 0;
+}
+
+int
+crt_tree_auto_select(struct crt_grp_priv *grp_priv, uint32_t rank_nr,
+		     uint64_t payload)
+{
+	struct crt_grp_priv	*default_grp_priv;
+	struct crt_tree_auto_in	 in;
+	int			 tree_topo;
+
+	D_ASSERT(grp_priv != NULL);
+	default_grp_priv = crt_grp_pub2priv(NULL);
+	D_ASSERT(default_grp_priv != NULL);
+
+	in.tai_grp_size = rank_nr > 0 ? rank_nr : grp_priv->gp_size;
+	in.tai_host_nr = default_grp_priv->gp_host_nr;
+	in.tai_payload = payload;
+	in.tai_hop_us = __atomic_load_n(&crt_tree_hop_us8,
+					__ATOMIC_RELAXED) / 8;
+
+	D_RWLOCK_RDLOCK(&crt_tree_auto_lock);
+	tree_topo = crt_tree_auto_cb(&in, crt_tree_auto_arg);
+	D_RWLOCK_UNLOCK(&crt_tree_auto_lock);
+
+	if (tree_topo < 0 || crt_tree_type(tree_topo) == CRT_TREE_AUTO ||
+	    !crt_tree_topo_valid(tree_topo)) {
+		D_ERROR("tree selection returned invalid tree_topo %#x, "
+			"using the default.\n", tree_topo);
+		tree_topo = crt_tree_auto_default(&in, NULL);
+	}
+
+	D_DEBUG(DB_TRACE, "group %s size %u payload "DF_U64" hop "DF_U64
+		"us: tree type %d ratio %d.\n", grp_priv->gp_pub.cg_grpid,
+		in.tai_grp_size, payload, in.tai_hop_us,
+		crt_tree_type(tree_topo), crt_tree_ratio(tree_topo));
+
+	return tree_topo;
+}
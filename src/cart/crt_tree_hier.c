@@ -0,0 +1,199 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It gives out the hierarchical tree topo related
+ * function implementation.
+ *
+ * The ranks are grouped by host. The first rank of each host in tree rank
+ * order is its leader, so the root leads its own host. The leaders form a
+ * knomial tree among themselves and each leader is the root of a knomial tree
+ * over the other ranks of its host, so a broadcast crosses the network once
+ * per host.
+ */
+#define D_LOGFAC	DD_FAC(grp)
+
+#include "crt_internal.h"
+
+/* position of one rank in the two level tree, all in tree ranks */
+struct hier_layout {
+	/* leader of every host, in tree rank order */
+	uint32_t	*hl_leaders;
+	uint32_t	 hl_nleaders;
+	/* ranks of the host of self, in tree rank order */
+	uint32_t	*hl_local;
+	uint32_t	 hl_nlocal;
+	/* index of self in hl_local, and in hl_leaders when it is 0 */
+	uint32_t	 hl_local_idx;
+	uint32_t	 hl_leader_idx;
+};
+
+static void
+hier_layout_fini(struct hier_layout *hl)
+{
+	D_FREE(hl->hl_leaders);
+	D_FREE(hl->hl_local);
+}
+
+static int
+hier_layout_init(uint32_t grp_size, uint32_t grp_root, uint32_t grp_self,
+		 const uint32_t *grp_hosts, uint32_t host_nr,
+		 struct hier_layout *hl)
+{
+	uint8_t		*seen;
+	uint32_t	 self_host;
+	uint32_t	 tree_self;
+	uint32_t	 host;
+	uint32_t	 t;
+	int		 rc = 0;
+
+	memset(hl, 0, sizeof(*hl));
+	D_ALLOC_ARRAY(seen, host_nr);
+	D_ALLOC_ARRAY(hl->hl_leaders, min(grp_size, host_nr));
+	D_ALLOC_ARRAY(hl->hl_local, grp_size);
+	if (seen == NULL || hl->hl_leaders == NULL || hl->hl_local == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	self_host = grp_hosts[grp_self];
+	tree_self = crt_grprank_2_teerank(grp_size, grp_root, grp_self);
+	for (t = 0; t < grp_size; t++) {
+		host = grp_hosts[crt_treerank_2_grprank(grp_size, grp_root, t)];
+		D_ASSERT(host < host_nr);
+		if (!seen[host]) {
+			seen[host] = 1;
+			if (t == tree_self)
+				hl->hl_leader_idx = hl->hl_nleaders;
+			hl->hl_leaders[hl->hl_nleaders++] = t;
+		}
+		if (host != self_host)
+			continue;
+		if (t == tree_self)
+			hl->hl_local_idx = hl->hl_nlocal;
+		hl->hl_local[hl->hl_nlocal++] = t;
+	}
+
+out:
+	D_FREE(seen);
+	if (rc != 0)
+		hier_layout_fini(hl);
+	return rc;
+}
+
+/*
+ * Query the children of grp_self in the hierarchical tree, grp_hosts[i] is the
+ * host (in [0, host_nr)) of group rank i. A leader lists its children on other
+ * hosts first. With children == NULL only the number of children is returned.
+ */
+int
+crt_hier_get_children(uint32_t grp_size, uint32_t tree_ratio,
+		      uint32_t grp_root, uint32_t grp_self,
+		      const uint32_t *grp_hosts, uint32_t host_nr,
+		      uint32_t *children, uint32_t *nchildren)
+{
+	struct hier_layout	hl;
+	uint32_t		nremote = 0;
+	uint32_t		nlocal;
+	uint32_t		i;
+	int			rc;
+
+	D_ASSERT(grp_size > 0);
+	D_ASSERT(grp_root < grp_size && grp_self < grp_size);
+	D_ASSERT(grp_hosts != NULL && nchildren != NULL);
+	D_ASSERT(tree_ratio >= CRT_TREE_MIN_RATIO &&
+		 tree_ratio <= CRT_TREE_MAX_RATIO);
+
+	rc = hier_layout_init(grp_size, grp_root, grp_self, grp_hosts, host_nr,
+			      &hl);
+	if (rc != 0)
+		return rc;
+
+	if (hl.hl_local_idx == 0) {
+		nremote = crt_knomial_tree_children(children, hl.hl_leader_idx,
+						    hl.hl_nleaders, tree_ratio);
+		for (i = 0; children != NULL && i < nremote; i++)
+			children[i] = hl.hl_leaders[children[i]];
+	}
+	nlocal = crt_knomial_tree_children(children == NULL ? NULL :
+					   children + nremote,
+					   hl.hl_local_idx, hl.hl_nlocal,
+					   tree_ratio);
+	for (i = nremote; children != NULL && i < nremote + nlocal; i++)
+		children[i] = hl.hl_local[children[i]];
+	for (i = 0; children != NULL && i < nremote + nlocal; i++)
+		children[i] = crt_treerank_2_grprank(grp_size, grp_root,
+						     children[i]);
+	*nchildren = nremote + nlocal;
+
+	hier_layout_fini(&hl);
+	return 0;
+}
+
+int
+crt_hier_get_parent(uint32_t grp_size, uint32_t tree_ratio,
+		    uint32_t grp_root, uint32_t grp_self,
+		    const uint32_t *grp_hosts, uint32_t host_nr,
+		    uint32_t *parent)
+{
+	struct hier_layout	hl;
+	uint32_t		tree_parent;
+	int			rc;
+
+	D_ASSERT(grp_size > 0);
+	D_ASSERT(grp_root < grp_size && grp_self < grp_size);
+	D_ASSERT(grp_hosts != NULL && parent != NULL);
+	D_ASSERT(tree_ratio >= CRT_TREE_MIN_RATIO &&
+		 tree_ratio <= CRT_TREE_MAX_RATIO);
+
+	if (grp_self == grp_root)
+		return -DER_INVAL;
+
+	rc = hier_layout_init(grp_size, grp_root, grp_self, grp_hosts, host_nr,
+			      &hl);
+	if (rc != 0)
+		return rc;
+
+	if (hl.hl_local_idx == 0)
+		tree_parent = hl.hl_leaders[crt_knomial_tree_parent(
+					hl.hl_leader_idx, tree_ratio)];
+	else
+		tree_parent = hl.hl_local[crt_knomial_tree_parent(
+					hl.hl_local_idx, tree_ratio)];
+	*parent = crt_treerank_2_grprank(grp_size, grp_root, tree_parent);
+
+	hier_layout_fini(&hl);
+	return 0;
+}
@@ -83,9 +83,9 @@ int_2_knomial_number(uint32_t x, uint32_t ratio, struct knomial_number *n)
 	}
 }
 
-static uint32_t
-knomial_get_children(uint32_t *children, uint32_t self, uint32_t size,
-		     uint32_t ratio)
+uint32_t
+crt_knomial_tree_children(uint32_t *children, uint32_t self, uint32_t size,
+			  uint32_t ratio)
 {
 	struct knomial_number	n;
 	uint32_t		inc = 1;
@@ -113,8 +113,8 @@ knomial_get_children(uint32_t *children, uint32_t self, uint32_t size,
 	return nchildren;
 }
 
-static uint32_t
-knomial_get_parent(uint32_t self, uint32_t ratio)
+uint32_t
+crt_knomial_tree_parent(uint32_t self, uint32_t ratio)
 {
 	struct knomial_number	n;
 	uint32_t		i;
@@ -146,8 +146,8 @@ crt_knomial_get_children_cnt(uint32_t grp_size, uint32_t tree_ratio,
 
 	tree_self = crt_grprank_2_teerank(grp_size, grp_root, grp_self);
 
-	*nchildren = knomial_get_children(NULL, tree_self, grp_size,
-					  tree_ratio);
+	*nchildren = crt_knomial_tree_children(NULL, tree_self, grp_size,
+					       tree_ratio);
 
 	return 0;
 }
@@ -169,8 +169,8 @@ crt_knomial_get_children(uint32_t grp_size, uint32_t tree_ratio,
 
 	tree_self = crt_grprank_2_teerank(grp_size, grp_root, grp_self);
 
-	nchildren = knomial_get_children(children, tree_self, grp_size,
-					 tree_ratio);
+	nchildren = crt_knomial_tree_children(children, tree_self, grp_size,
+					      tree_ratio);
 	for (i = 0; i < nchildren; i++)
 		children[i] = crt_treerank_2_grprank(grp_size, grp_root,
 						     children[i]);
@@ -196,7 +196,7 @@ crt_knomial_get_parent(uint32_t grp_size, uint32_t tree_ratio,
 	tree_self = crt_grprank_2_teerank(grp_size, grp_root, grp_self);
 	D_ASSERT(tree_self != 0);
 
-	tree_parent = knomial_get_parent(tree_self, tree_ratio);
+	tree_parent = crt_knomial_tree_parent(tree_self, tree_ratio);
 
 	*parent = crt_treerank_2_grprank(grp_size, grp_root, tree_parent);
 
@@ -0,0 +1,512 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It implements crt_group_warmup(), which fills the
+ * address lookup cache of a group before the first RPC is sent to it.
+ */
+#define D_LOGFAC	DD_FAC(grp)
+
+#include "crt_internal.h"
+
+/*
+ * max number of (rank, tag) lookups in flight for one warmup, a full window of
+ * lookups to an attached group fits in one batched URI_LOOKUP.
+ */
+#define CRT_WARMUP_WINDOW	CRT_UL_BATCH_MAX
+
+struct crt_warmup {
+	/* primary group whose lookup cache is filled */
+	struct crt_grp_priv	*cw_grp_priv;
+	/* group handle passed by user */
+	crt_group_t		*cw_grp;
+	struct crt_context	*cw_ctx;
+	/* primary group ranks to resolve */
+	d_rank_t		*cw_ranks;
+	uint32_t		*cw_tags;
+	uint32_t		 cw_tag_nr;
+	/* cw_ranks x cw_tags */
+	uint32_t		 cw_total;
+	/* index of the next (rank, tag) to start */
+	uint32_t		 cw_next;
+	uint32_t		 cw_inflight;
+	uint32_t		 cw_resolved;
+	uint32_t		 cw_failed;
+	/* threads in crt_warmup_kick(), the last one out frees the warmup */
+	uint32_t		 cw_ref;
+	int			 cw_rc;
+	uint32_t		 cw_done:1;
+	struct timespec		 cw_start;
+	crt_warmup_cb_t		 cw_cb;
+	void			*cw_arg;
+	/* protects the counters above */
+	pthread_mutex_t		 cw_mutex;
+};
+
+/* one asynchronous (rank, tag) lookup */
+struct crt_warmup_op {
+	struct crt_warmup	*wo_wu;
+	d_rank_t		 wo_rank;
+	uint32_t		 wo_tag;
+};
+
+static void crt_warmup_kick(struct crt_warmup *wu, bool op_done, int op_rc);
+
+static void
+crt_warmup_free(struct crt_warmup *wu)
+{
+	D_MUTEX_DESTROY(&wu->cw_mutex);
+	D_FREE(wu->cw_ranks);
+	D_FREE(wu->cw_tags);
+	D_FREE_PTR(wu);
+}
+
+static void
+crt_warmup_op_done(struct crt_warmup_op *op, int rc)
+{
+	struct crt_warmup	*wu = op->wo_wu;
+
+	if (rc != 0)
+		D_ERROR("warmup of group %s rank %d tag %d failed, rc: %d.\n",
+			wu->cw_grp_priv->gp_pub.cg_grpid, op->wo_rank,
+			op->wo_tag, rc);
+	D_FREE_PTR(op);
+	crt_warmup_kick(wu, true /* op_done */, rc);
+}
+
+static int
+crt_warmup_addr_lookup_cb(hg_addr_t hg_addr, void *arg)
+{
+	struct crt_warmup_op	*op = arg;
+	struct crt_warmup	*wu = op->wo_wu;
+	int			 rc = 0;
+
+	if (hg_addr == NULL)
+		D_GOTO(out, rc = -DER_UNREACH);
+
+	rc = crt_grp_lc_addr_insert(wu->cw_grp_priv, wu->cw_ctx, op->wo_rank,
+				    op->wo_tag, &hg_addr);
+	if (rc != 0)
+		D_ERROR("crt_grp_lc_addr_insert() failed, rc: %d.\n", rc);
+
+out:
+	crt_warmup_op_done(op, rc);
+	return 0;
+}
+
+/* connect the cached URI of op, which stays valid as long as the group */
+static int
+crt_warmup_addr_lookup(struct crt_warmup_op *op, uint32_t uri_tag)
+{
+	struct crt_warmup	*wu = op->wo_wu;
+	crt_phy_addr_t		 uri = NULL;
+	int			 rc;
+
+	rc = crt_grp_lc_lookup(wu->cw_grp_priv, wu->cw_ctx->cc_idx,
+			       op->wo_rank, uri_tag, &uri, NULL);
+	if (rc != 0)
+		return rc;
+	if (uri == NULL)
+		return -DER_NONEXIST;
+
+	rc = crt_hg_addr_lookup(&wu->cw_ctx->cc_hg_ctx, uri,
+				crt_warmup_addr_lookup_cb, op);
+	if (rc != 0)
+		D_ERROR("crt_hg_addr_lookup() failed, rc: %d.\n", rc);
+	return rc;
+}
+
+static void
+crt_warmup_uri_lookup_cb(const struct crt_cb_info *cb_info)
+{
+	struct crt_warmup_op		*op = cb_info->cci_arg;
+	struct crt_warmup		*wu = op->wo_wu;
+	struct crt_uri_lookup_out	*ul_out;
+	int				 rc = cb_info->cci_rc;
+
+	if (rc != 0) {
+		D_ERROR("URI_LOOKUP failed, rc: %d.\n", rc);
+		D_GOTO(out, rc);
+	}
+	ul_out = crt_reply_get(cb_info->cci_rpc);
+	if (ul_out->ul_rc != 0 || ul_out->ul_uri == NULL) {
+		D_ERROR("URI_LOOKUP returned no URI, rc: %d.\n",
+			ul_out->ul_rc);
+		D_GOTO(out, rc = ul_out->ul_rc ? ul_out->ul_rc : -DER_NONEXIST);
+	}
+
+	rc = crt_grp_lc_uri_insert(wu->cw_grp_priv, wu->cw_ctx->cc_idx,
+				   op->wo_rank, op->wo_tag, ul_out->ul_uri);
+	if (rc != 0) {
+		D_ERROR("crt_grp_lc_uri_insert() failed, rc: %d.\n", rc);
+		D_GOTO(out, rc);
+	}
+	rc = crt_warmup_addr_lookup(op, op->wo_tag);
+
+out:
+	if (rc != 0)
+		crt_warmup_op_done(op, rc);
+}
+
+/* ask the PSR of an attached group for the URI of op */
+static int
+crt_warmup_uri_lookup_psr(struct crt_warmup_op *op)
+{
+	struct crt_warmup		*wu = op->wo_wu;
+	struct crt_grp_priv		*grp_priv = wu->cw_grp_priv;
+	struct crt_uri_lookup_in	*ul_in;
+	crt_endpoint_t			 psr_ep = {0};
+	crt_rpc_t			*ul_req;
+	int				 rc;
+
+	psr_ep.ep_grp = &grp_priv->gp_pub;
+	D_RWLOCK_RDLOCK(&grp_priv->gp_rwlock);
+	psr_ep.ep_rank = grp_priv->gp_psr_rank;
+	D_RWLOCK_UNLOCK(&grp_priv->gp_rwlock);
+
+	rc = crt_req_create(wu->cw_ctx, &psr_ep, CRT_OPC_URI_LOOKUP, &ul_req);
+	if (rc != 0) {
+		D_ERROR("crt_req_create URI_LOOKUP failed, rc: %d.\n", rc);
+		return rc;
+	}
+	ul_in = crt_req_get(ul_req);
+	ul_in->ul_grp_id = grp_priv->gp_pub.cg_grpid;
+	ul_in->ul_rank = op->wo_rank;
+	ul_in->ul_tag = op->wo_tag;
+
+	/* failures are reported through crt_warmup_uri_lookup_cb() */
+	return crt_req_send(ul_req, crt_warmup_uri_lookup_cb, op);
+}
+
+/* completion of the batched URI lookup of op through the PSR */
+static void
+crt_warmup_uri_batch_cb(const char *uri, int rc, void *arg)
+{
+	struct crt_warmup_op	*op = arg;
+
+	if (rc == 0) {
+		/* the PSR needs to forward lookups of tags it does not know */
+		if (uri == NULL)
+			rc = crt_warmup_uri_lookup_psr(op);
+		else
+			rc = crt_warmup_addr_lookup(op, op->wo_tag);
+	}
+	if (rc != 0)
+		crt_warmup_op_done(op, rc);
+}
+
+/* completion of the PMIx lookup of the base URI of a local group rank */
+static void
+crt_warmup_pmix_uri_cb(const char *uri, int rc, void *arg)
+{
+	struct crt_warmup_op	*op = arg;
+	struct crt_warmup	*wu = op->wo_wu;
+
+	if (rc == 0) {
+		rc = crt_grp_lc_uri_insert(wu->cw_grp_priv, wu->cw_ctx->cc_idx,
+					   op->wo_rank, 0, uri);
+		if (rc != 0)
+			D_ERROR("crt_grp_lc_uri_insert() failed, rc %d\n", rc);
+	}
+	if (rc == 0)
+		rc = crt_warmup_addr_lookup(op, 0);
+	if (rc != 0)
+		crt_warmup_op_done(op, rc);
+}
+
+/*
+ * Find the base URI of a rank of the local group and cache it. Returns 1 if
+ * the URI is looked up asynchronously through PMIx.
+ */
+static int
+crt_warmup_uri_lookup_local(struct crt_warmup_op *op)
+{
+	struct crt_warmup	*wu = op->wo_wu;
+	struct crt_grp_priv	*grp_priv = wu->cw_grp_priv;
+	int			 rc;
+
+	if (op->wo_rank != grp_priv->gp_self) {
+		rc = crt_pmix_uri_lookup_nb(grp_priv->gp_pub.cg_grpid,
+					    op->wo_rank,
+					    crt_warmup_pmix_uri_cb, op);
+		if (rc != 0) {
+			D_ERROR("crt_pmix_uri_lookup_nb() failed, rc %d.\n",
+				rc);
+			return rc;
+		}
+		return 1;
+	}
+
+	rc = crt_grp_lc_uri_insert(grp_priv, wu->cw_ctx->cc_idx, op->wo_rank,
+				   0, crt_gdata.cg_addr);
+	if (rc != 0)
+		D_ERROR("crt_grp_lc_uri_insert() failed, rc %d\n", rc);
+	return rc;
+}
+
+/*
+ * Start the idx-th (rank, tag) lookup. Returns 0 if it completes
+ * asynchronously, 1 if the address was already cached, or a negative error.
+ */
+static int
+crt_warmup_op_start(struct crt_warmup *wu, uint32_t idx)
+{
+	struct crt_grp_priv	*grp_priv = wu->cw_grp_priv;
+	struct crt_warmup_op	*op;
+	crt_phy_addr_t		 uri = NULL;
+	hg_addr_t		 hg_addr = NULL;
+	uint32_t		 uri_tag;
+	int			 rc;
+
+	D_ALLOC_PTR(op);
+	if (op == NULL)
+		return -DER_NOMEM;
+	op->wo_wu = wu;
+	op->wo_rank = wu->cw_ranks[idx / wu->cw_tag_nr];
+	op->wo_tag = wu->cw_tags[idx % wu->cw_tag_nr];
+
+	/* the local group connects to every tag through the base URI */
+	uri_tag = grp_priv->gp_local ? 0 : op->wo_tag;
+	rc = crt_grp_lc_lookup(grp_priv, wu->cw_ctx->cc_idx, op->wo_rank,
+			       op->wo_tag, NULL, &hg_addr);
+	if (rc != 0)
+		D_GOTO(out, rc);
+	if (hg_addr != NULL)
+		D_GOTO(out, rc = 1);
+
+	rc = crt_grp_lc_lookup(grp_priv, wu->cw_ctx->cc_idx, op->wo_rank,
+			       uri_tag, &uri, NULL);
+	if (rc != 0)
+		D_GOTO(out, rc);
+	if (uri == NULL) {
+		if (!grp_priv->gp_local)
+			D_GOTO(out, rc = crt_grp_uri_lookup(wu->cw_ctx,
+					grp_priv, op->wo_rank, op->wo_tag,
+					crt_warmup_uri_batch_cb, op));
+
+		rc = crt_warmup_uri_lookup_local(op);
+		if (rc > 0)
+			D_GOTO(out, rc = 0);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+	rc = crt_warmup_addr_lookup(op, uri_tag);
+
+out:
+	if (rc != 0)
+		D_FREE_PTR(op);
+	return rc;
+}
+
+/* called with cw_mutex held */
+static void
+crt_warmup_account(struct crt_warmup *wu, int rc)
+{
+	if (rc < 0) {
+		wu->cw_failed++;
+		if (wu->cw_rc == 0)
+			wu->cw_rc = rc;
+	} else {
+		wu->cw_resolved++;
+	}
+}
+
+/*
+ * Account for a finished lookup if op_done, then start lookups until the window
+ * is full. Synchronous results are accounted in the loop rather than by
+ * recursing, and the completion callback is called once everything finished.
+ */
+static void
+crt_warmup_kick(struct crt_warmup *wu, bool op_done, int op_rc)
+{
+	struct crt_warmup_cb_info	 cb_info;
+	struct timespec			 now;
+	uint32_t			 idx;
+	bool				 complete = false;
+	bool				 free_wu;
+	int				 rc;
+
+	D_MUTEX_LOCK(&wu->cw_mutex);
+	wu->cw_ref++;
+	if (op_done) {
+		D_ASSERT(wu->cw_inflight > 0);
+		wu->cw_inflight--;
+		crt_warmup_account(wu, op_rc);
+	}
+
+	while (wu->cw_next < wu->cw_total &&
+	       wu->cw_inflight < CRT_WARMUP_WINDOW) {
+		idx = wu->cw_next++;
+		wu->cw_inflight++;
+		D_MUTEX_UNLOCK(&wu->cw_mutex);
+
+		rc = crt_warmup_op_start(wu, idx);
+
+		D_MUTEX_LOCK(&wu->cw_mutex);
+		if (rc == 0)
+			continue;
+		wu->cw_inflight--;
+		crt_warmup_account(wu, rc);
+	}
+
+	if (wu->cw_next == wu->cw_total && wu->cw_inflight == 0 &&
+	    !wu->cw_done) {
+		wu->cw_done = 1;
+		complete = true;
+	}
+	D_MUTEX_UNLOCK(&wu->cw_mutex);
+
+	if (complete) {
+		d_gettime(&now);
+		cb_info.wci_grp = wu->cw_grp;
+		cb_info.wci_arg = wu->cw_arg;
+		cb_info.wci_rc = wu->cw_rc;
+		cb_info.wci_resolved = wu->cw_resolved;
+		cb_info.wci_failed = wu->cw_failed;
+		cb_info.wci_elapsed_us = d_timediff_ns(&wu->cw_start, &now) /
+					 1000;
+		D_DEBUG(DB_TRACE, "group %s warmed up, %u resolved, %u failed "
+			"in "DF_U64" us.\n", wu->cw_grp_priv->gp_pub.cg_grpid,
+			cb_info.wci_resolved, cb_info.wci_failed,
+			cb_info.wci_elapsed_us);
+		wu->cw_cb(&cb_info);
+	}
+
+	D_MUTEX_LOCK(&wu->cw_mutex);
+	free_wu = (--wu->cw_ref == 0 && wu->cw_done);
+	D_MUTEX_UNLOCK(&wu->cw_mutex);
+	if (free_wu)
+		crt_warmup_free(wu);
+}
+
+int
+crt_group_warmup(crt_group_t *grp, crt_context_t crt_ctx, d_rank_list_t *ranks,
+		 uint32_t *tags, uint32_t tag_nr, crt_warmup_cb_t complete_cb,
+		 void *arg)
+{
+	struct crt_grp_priv	*grp_priv;
+	struct crt_grp_priv	*pri_priv;
+	struct crt_warmup	*wu = NULL;
+	d_rank_t		 rank;
+	uint32_t		 rank_nr;
+	uint32_t		 i;
+	int			 rc = 0;
+
+	if (!crt_initialized()) {
+		D_ERROR("CRT not initialized.\n");
+		D_GOTO(out, rc = -DER_UNINIT);
+	}
+	if (crt_ctx == CRT_CONTEXT_NULL || complete_cb == NULL ||
+	    (tags == NULL && tag_nr != 0) || (tags != NULL && tag_nr == 0)) {
+		D_ERROR("invalid parameter, crt_ctx %p, complete_cb %p, "
+			"tags %p, tag_nr %u.\n", crt_ctx, complete_cb, tags,
+			tag_nr);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	if (grp == NULL)
+		grp_priv = crt_gdata.cg_grp->gg_srv_pri_grp;
+	else
+		grp_priv = container_of(grp, struct crt_grp_priv, gp_pub);
+	if (grp_priv == NULL) {
+		D_ERROR("no service group to warm up.\n");
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+	/* the lookup cache lives in the primary group */
+	pri_priv = grp_priv;
+	if (grp_priv->gp_primary == 0) {
+		pri_priv = crt_grp_pub2priv(NULL);
+		D_ASSERT(pri_priv != NULL);
+	}
+
+	D_ALLOC_PTR(wu);
+	if (wu == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	rc = D_MUTEX_INIT(&wu->cw_mutex, NULL);
+	if (rc != 0) {
+		D_FREE_PTR(wu);
+		D_GOTO(out, rc);
+	}
+	wu->cw_grp_priv = pri_priv;
+	wu->cw_grp = &grp_priv->gp_pub;
+	wu->cw_ctx = crt_ctx;
+	wu->cw_cb = complete_cb;
+	wu->cw_arg = arg;
+
+	rank_nr = ranks == NULL ? grp_priv->gp_size : ranks->rl_nr;
+	if (rank_nr == 0) {
+		D_ERROR("no rank to warm up.\n");
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+	D_ALLOC_ARRAY(wu->cw_ranks, rank_nr);
+	if (wu->cw_ranks == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	for (i = 0; i < rank_nr; i++) {
+		rank = ranks == NULL ? i : ranks->rl_ranks[i];
+		if (rank >= grp_priv->gp_size) {
+			D_ERROR("rank %d out of range [0, %d).\n",
+				rank, grp_priv->gp_size);
+			D_GOTO(out, rc = -DER_INVAL);
+		}
+		if (grp_priv->gp_primary == 0)
+			rank = grp_priv->gp_membs->rl_ranks[rank];
+		wu->cw_ranks[i] = rank;
+	}
+
+	wu->cw_tag_nr = tags == NULL ? 1 : tag_nr;
+	D_ALLOC_ARRAY(wu->cw_tags, wu->cw_tag_nr);
+	if (wu->cw_tags == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+	for (i = 0; tags != NULL && i < tag_nr; i++) {
+		if (tags[i] >= CRT_SRV_CONTEXT_NUM) {
+			D_ERROR("tag %d out of range [0, %d].\n",
+				tags[i], CRT_SRV_CONTEXT_NUM - 1);
+			D_GOTO(out, rc = -DER_INVAL);
+		}
+		wu->cw_tags[i] = tags[i];
+	}
+	wu->cw_total = rank_nr * wu->cw_tag_nr;
+
+	d_gettime(&wu->cw_start);
+	crt_warmup_kick(wu, false /* op_done */, 0);
+	wu = NULL;
+
+out:
+	if (wu != NULL)
+		crt_warmup_free(wu);
+	return rc;
+}
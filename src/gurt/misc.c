@@ -43,6 +43,169 @@
 
 #include <gurt/common.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* below this many ranks insertion sort beats the radix passes */
+#define RANK_SORT_SMALL		64
+/* below this many filter ranks a plain scan beats sorting a copy */
+#define RANK_FILTER_SMALL	16
+
+/*
+ * Return the index of the first occurrence of rank in ranks[0, nr), or -1.
+ * Works on unsorted input, compares 8 (AVX2) or 4 (SSE2) ranks per step.
+ */
+static inline int64_t
+rank_scan(const d_rank_t *ranks, uint32_t nr, d_rank_t rank)
+{
+	uint32_t	i = 0;
+
+#if defined(__AVX2__)
+	__m256i		key = _mm256_set1_epi32((int)rank);
+	int		mask;
+
+	for (; i + 8 <= nr; i += 8) {
+		mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+			_mm256_cmpeq_epi32(key, _mm256_loadu_si256(
+				(const __m256i *)&ranks[i]))));
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#elif defined(__SSE2__)
+	__m128i		key = _mm_set1_epi32((int)rank);
+	int		mask;
+
+	for (; i + 4 <= nr; i += 4) {
+		mask = _mm_movemask_ps(_mm_castsi128_ps(
+			_mm_cmpeq_epi32(key, _mm_loadu_si128(
+				(const __m128i *)&ranks[i]))));
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i < nr; i++) {
+		if (ranks[i] == rank)
+			return i;
+	}
+	return -1;
+}
+
+/* Branchless lower bound: first index in sorted ranks with ranks[i] >= rank */
+static inline uint32_t
+rank_lower_bound(const d_rank_t *ranks, uint32_t nr, d_rank_t rank)
+{
+	const d_rank_t	*base = ranks;
+	uint32_t	 half;
+
+	if (nr == 0)
+		return 0;
+	while (nr > 1) {
+		half = nr / 2;
+		base = (base[half - 1] < rank) ? base + half : base;
+		nr -= half;
+	}
+	return (base - ranks) + (*base < rank);
+}
+
+static inline bool
+rank_sorted(const d_rank_t *ranks, uint32_t nr)
+{
+	uint32_t	i;
+
+	for (i = 1; i < nr; i++) {
+		if (ranks[i - 1] > ranks[i])
+			return false;
+	}
+	return true;
+}
+
+static int rank_compare(const void *rank1, const void *rank2);
+
+/*
+ * Sort ranks in place, LSD radix sort over the 4 bytes of a rank. Passes in
+ * which every rank shares the same byte (the high bytes, typically) are
+ * skipped, so the usual dense rank lists take one or two passes.
+ */
+static void
+rank_sort(d_rank_t *ranks, uint32_t nr)
+{
+	uint32_t	 count[4][256];
+	d_rank_t	*tmp;
+	d_rank_t	*from;
+	d_rank_t	*to;
+	d_rank_t	*swap;
+	d_rank_t	 rank;
+	uint32_t	 sum;
+	uint32_t	 c;
+	uint32_t	 i, j;
+	int		 b;
+
+	if (nr < RANK_SORT_SMALL) {
+		for (i = 1; i < nr; i++) {
+			rank = ranks[i];
+			for (j = i; j > 0 && ranks[j - 1] > rank; j--)
+				ranks[j] = ranks[j - 1];
+			ranks[j] = rank;
+		}
+		return;
+	}
+	if (rank_sorted(ranks, nr))
+		return;
+
+	D_ALLOC_ARRAY(tmp, nr);
+	if (tmp == NULL) {
+		qsort(ranks, nr, sizeof(d_rank_t), rank_compare);
+		return;
+	}
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < nr; i++) {
+		rank = ranks[i];
+		count[0][rank & 0xff]++;
+		count[1][(rank >> 8) & 0xff]++;
+		count[2][(rank >> 16) & 0xff]++;
+		count[3][rank >> 24]++;
+	}
+
+	from = ranks;
+	to = tmp;
+	for (b = 0; b < 4; b++) {
+		if (count[b][(from[0] >> (b * 8)) & 0xff] == nr)
+			continue;
+		for (sum = 0, i = 0; i < 256; i++) {
+			c = count[b][i];
+			count[b][i] = sum;
+			sum += c;
+		}
+		for (i = 0; i < nr; i++)
+			to[count[b][(from[i] >> (b * 8)) & 0xff]++] = from[i];
+		swap = from;
+		from = to;
+		to = swap;
+	}
+	if (from != ranks)
+		memcpy(ranks, from, nr * sizeof(d_rank_t));
+	D_FREE(tmp);
+}
+
+/* Drop duplicates from sorted ranks in place, return the new count */
+static uint32_t
+rank_uniq(d_rank_t *ranks, uint32_t nr)
+{
+	uint32_t	i, n;
+
+	if (nr <= 1)
+		return nr;
+	for (n = 1, i = 1; i < nr; i++) {
+		ranks[n] = ranks[i];
+		n += (ranks[i] != ranks[n - 1]);
+	}
+	return n;
+}
+
 int
 d_rank_list_dup(d_rank_list_t **dst, const d_rank_list_t *src)
 {
@@ -84,9 +247,7 @@ int
 d_rank_list_dup_sort_uniq(d_rank_list_t **dst, const d_rank_list_t *src)
 {
 	d_rank_list_t		*rank_list;
-	d_rank_t		rank_tmp;
-	uint32_t		rank_num, identical_num;
-	int			i, j;
+	uint32_t		rank_num;
 	int			rc = 0;
 
 	rc = d_rank_list_dup(dst, src);
@@ -102,28 +263,12 @@ d_rank_list_dup_sort_uniq(d_rank_list_t **dst, const d_rank_list_t *src)
 	d_rank_list_sort(rank_list);
 
 	/* uniq - remove same rank number in the list */
-	rank_num = src->rl_nr;
-	if (rank_num <= 1)
-		D_GOTO(out, 0);
-	identical_num = 0;
-	rank_tmp = rank_list->rl_ranks[0];
-	for (i = 1; i < rank_num - identical_num; i++) {
-		if (rank_tmp == rank_list->rl_ranks[i]) {
-			identical_num++;
-			for (j = i; j < rank_num; j++)
-				rank_list->rl_ranks[j - 1] =
-					rank_list->rl_ranks[j];
-			D_DEBUG(DB_TRACE, "%s:%d, rank_list %p, removed "
-				"identical rank[%d](%d).\n", __FILE__, __LINE__,
-				rank_list, i, rank_tmp);
-		}
-		rank_tmp = rank_list->rl_ranks[i];
-	}
-	if (identical_num != 0) {
-		rank_list->rl_nr -= identical_num;
+	rank_num = rank_list->rl_nr;
+	rank_list->rl_nr = rank_uniq(rank_list->rl_ranks, rank_num);
+	if (rank_list->rl_nr != rank_num)
 		D_DEBUG(DB_TRACE, "%s:%d, rank_list %p, removed %d ranks.\n",
-			__FILE__, __LINE__, rank_list, identical_num);
-	}
+			__FILE__, __LINE__, rank_list,
+			rank_num - rank_list->rl_nr);
 
 out:
 	return rc;
@@ -141,9 +286,14 @@ void
 d_rank_list_filter(d_rank_list_t *src_set, d_rank_list_t *dst_set,
 		   bool exclude)
 {
-	d_rank_t	rank;
-	uint32_t	rank_num, filter_num;
-	int		i, j;
+	d_rank_t	*filter = NULL;
+	d_rank_t	 rank;
+	uint32_t	 filter_nr;
+	uint32_t	 rank_num;
+	uint32_t	 pos;
+	uint32_t	 i, j;
+	bool		 member;
+	bool		 merge;
 
 	if (src_set == NULL || dst_set == NULL)
 		return;
@@ -154,25 +304,57 @@ d_rank_list_filter(d_rank_list_t *src_set, d_rank_list_t *dst_set,
 	if (rank_num == 0)
 		return;
 
-	filter_num = 0;
-	for (i = 0; i < rank_num - filter_num; i++) {
+	/*
+	 * Membership tests run against a sorted view of src_set: a merge walk
+	 * when dst_set is itself sorted, binary search otherwise. Small or
+	 * unsortable (out of memory) filters fall back to a scan.
+	 */
+	filter_nr = src_set->rl_nr;
+	if (filter_nr >= RANK_FILTER_SMALL) {
+		if (rank_sorted(src_set->rl_ranks, filter_nr)) {
+			filter = src_set->rl_ranks;
+		} else {
+			D_ALLOC_ARRAY(filter, filter_nr);
+			if (filter != NULL) {
+				memcpy(filter, src_set->rl_ranks,
+				       filter_nr * sizeof(d_rank_t));
+				rank_sort(filter, filter_nr);
+			}
+		}
+	}
+
+	merge = filter != NULL && rank_sorted(dst_set->rl_ranks, rank_num);
+	pos = 0;
+	for (i = 0, j = 0; i < rank_num; i++) {
 		rank = dst_set->rl_ranks[i];
-		if (d_rank_in_rank_list(src_set, rank) != exclude)
+		if (filter == NULL) {
+			member = rank_scan(src_set->rl_ranks, filter_nr,
+					   rank) >= 0;
+		} else if (merge) {
+			/* merge walk, pos only moves forward */
+			while (pos < filter_nr && filter[pos] < rank)
+				pos++;
+			member = pos < filter_nr && filter[pos] == rank;
+		} else {
+			pos = rank_lower_bound(filter, filter_nr, rank);
+			member = pos < filter_nr && filter[pos] == rank;
+		}
+		if (member == exclude) {
+			D_DEBUG(DB_TRACE, "%s:%d, rank_list %p, filter "
+				"rank[%d](%d).\n", __FILE__, __LINE__,
+				dst_set, i, rank);
 			continue;
-		filter_num++;
-		for (j = i; j < rank_num - 1; j++)
-			dst_set->rl_ranks[j] =
-				dst_set->rl_ranks[j + 1];
-		D_DEBUG(DB_TRACE, "%s:%d, rank_list %p, filter rank[%d](%d).\n",
-			__FILE__, __LINE__, dst_set, i, rank);
-		/* as dst_set moved one item ahead */
-		i--;
+		}
+		dst_set->rl_ranks[j++] = rank;
 	}
-	if (filter_num != 0) {
-		dst_set->rl_nr -= filter_num;
+	if (j != rank_num) {
+		dst_set->rl_nr = j;
 		D_DEBUG(DB_TRACE, "%s:%d, rank_list %p, filter %d ranks.\n",
-			__FILE__, __LINE__, dst_set, filter_num);
+			__FILE__, __LINE__, dst_set, rank_num - j);
 	}
+
+	if (filter != NULL && filter != src_set->rl_ranks)
+		D_FREE(filter);
 }
 
 d_rank_list_t *
@@ -263,7 +445,7 @@ out:
 	return rc;
 }
 
-static inline int
+static int
 rank_compare(const void *rank1, const void *rank2)
 {
 	const d_rank_t	*r1 = rank1;
@@ -283,8 +465,7 @@ d_rank_list_sort(d_rank_list_t *rank_list)
 {
 	if (rank_list == NULL)
 		return;
-	qsort(rank_list->rl_ranks, rank_list->rl_nr,
-	      sizeof(d_rank_t), rank_compare);
+	rank_sort(rank_list->rl_ranks, rank_list->rl_nr);
 }
 
 /**
@@ -294,18 +475,16 @@ d_rank_list_sort(d_rank_list_t *rank_list)
 bool
 d_rank_list_find(d_rank_list_t *rank_list, d_rank_t rank, int *idx)
 {
-	int i;
+	int64_t	i;
 
 	if (rank_list == NULL)
 		return false;
-	for (i = 0; i < rank_list->rl_nr; i++) {
-		if (rank_list->rl_ranks[i] == rank) {
-			if (idx)
-				*idx = i;
-			return true;
-		}
-	}
-	return false;
+	i = rank_scan(rank_list->rl_ranks, rank_list->rl_nr, rank);
+	if (i < 0)
+		return false;
+	if (idx)
+		*idx = i;
+	return true;
 }
 
 /**
@@ -392,17 +571,10 @@ d_rank_list_identical(d_rank_list_t *rank_list1, d_rank_list_t *rank_list2)
 bool
 d_rank_in_rank_list(d_rank_list_t *rank_list, d_rank_t rank)
 {
-	uint32_t	rank_num, i;
-
 	if (rank_list == NULL)
 		return false;
 
-	rank_num = rank_list->rl_nr;
-	for (i = 0; i < rank_num; i++) {
-		if (rank_list->rl_ranks[i] == rank)
-			return true;
-	}
-	return false;
+	return rank_scan(rank_list->rl_ranks, rank_list->rl_nr, rank) >= 0;
 }
 
 /*
@@ -413,23 +585,16 @@ d_rank_in_rank_list(d_rank_list_t *rank_list, d_rank_t rank)
 int
 d_idx_in_rank_list(d_rank_list_t *rank_list, d_rank_t rank, uint32_t *idx)
 {
-	uint32_t	rank_num;
-	bool		found = false;
-	uint32_t	i;
+	int64_t		i;
 
 	if (rank_list == NULL || idx == NULL)
 		return -DER_INVAL;
 
-	rank_num = rank_list->rl_nr;
-	for (i = 0; i < rank_num; i++) {
-		if (rank_list->rl_ranks[i] == rank) {
-			found = true;
-			*idx = i;
-			break;
-		}
-	}
-
-	return found == true ? 0 : -DER_NONEXIST;
+	i = rank_scan(rank_list->rl_ranks, rank_list->rl_nr, rank);
+	if (i < 0)
+		return -DER_NONEXIST;
+	*idx = i;
+	return 0;
 }
 
 /**
@@ -0,0 +1,1270 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This file is part of CaRT. It implements the compressed rank set of
+ * gurt/rank_set.h.
+ */
+#define D_LOGFAC	DD_FAC(misc)
+
+#include <gurt/common.h>
+#include <gurt/rank_set.h>
+
+/* low rank bits addressed within one container */
+#define RS_LOW_BITS		(16)
+#define RS_CHUNK		(1U << RS_LOW_BITS)
+#define RS_KEY(rank)		((rank) >> RS_LOW_BITS)
+#define RS_LOW(rank)		((rank) & (RS_CHUNK - 1))
+#define RS_RANK(key, low)	(((d_rank_t)(key) << RS_LOW_BITS) | (low))
+/* words of a bitmap container */
+#define RS_WORDS		(RS_CHUNK / 64)
+/* largest array container, a bitmap is smaller past it */
+#define RS_ARRAY_MAX		(4096)
+/* most runs of a run container, a bitmap is smaller past it */
+#define RS_RUN_MAX		(RS_WORDS * sizeof(uint64_t) / \
+				 sizeof(struct rs_run))
+
+enum rs_type {
+	RS_ARRAY,	/* sorted uint16_t low bits */
+	RS_BITMAP,	/* RS_WORDS uint64_t */
+	RS_RUN,		/* sorted, disjoint and non-adjacent struct rs_run */
+};
+
+struct rs_run {
+	uint16_t	rr_first;
+	uint16_t	rr_last;
+};
+
+/* the ranks of a rank set sharing the same upper bits */
+struct rs_cont {
+	uint32_t	 rc_key;	/* upper rank bits */
+	uint32_t	 rc_type;	/* enum rs_type */
+	uint32_t	 rc_card;	/* number of ranks, never 0 */
+	uint32_t	 rc_nr;		/* array entries or runs */
+	uint32_t	 rc_base;	/* ranks in the preceding containers */
+	void		*rc_data;
+};
+
+struct d_rank_set {
+	/* non-empty containers sorted by rc_key */
+	struct rs_cont	*rs_conts;
+	uint32_t	 rs_nr_conts;
+	uint32_t	 rs_cap_conts;
+	/* total number of ranks */
+	uint32_t	 rs_nr;
+};
+
+enum rs_op {
+	RS_OP_UNION,
+	RS_OP_DIFF,
+	RS_OP_INTERSECT,
+};
+
+static inline size_t
+rs_cont_bytes(uint32_t type, uint32_t nr)
+{
+	switch (type) {
+	case RS_ARRAY:
+		return nr * sizeof(uint16_t);
+	case RS_BITMAP:
+		return RS_WORDS * sizeof(uint64_t);
+	default:
+		return nr * sizeof(struct rs_run);
+	}
+}
+
+static inline void
+rs_cont_fini(struct rs_cont *c)
+{
+	D_FREE(c->rc_data);
+}
+
+static int
+rs_cont_dup(struct rs_cont *dst, const struct rs_cont *src)
+{
+	size_t	bytes = rs_cont_bytes(src->rc_type, src->rc_nr);
+
+	*dst = *src;
+	D_ALLOC(dst->rc_data, bytes);
+	if (dst->rc_data == NULL)
+		return -DER_NOMEM;
+	memcpy(dst->rc_data, src->rc_data, bytes);
+
+	return 0;
+}
+
+/* index of the first array entry not less than low */
+static inline uint32_t
+rs_array_lower(const uint16_t *array, uint32_t nr, uint32_t low)
+{
+	uint32_t	lo = 0;
+	uint32_t	hi = nr;
+	uint32_t	mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (array[mid] < low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* index of the last run starting at or before low, nr if none */
+static inline uint32_t
+rs_run_find(const struct rs_run *runs, uint32_t nr, uint32_t low)
+{
+	uint32_t	lo = 0;
+	uint32_t	hi = nr;
+	uint32_t	mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (runs[mid].rr_first <= low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo == 0 ? nr : lo - 1;
+}
+
+static bool
+rs_cont_has(const struct rs_cont *c, uint32_t low)
+{
+	const uint16_t		*array;
+	const uint64_t		*words;
+	const struct rs_run	*runs;
+	uint32_t		 i;
+
+	switch (c->rc_type) {
+	case RS_ARRAY:
+		array = c->rc_data;
+		i = rs_array_lower(array, c->rc_nr, low);
+		return i < c->rc_nr && array[i] == low;
+	case RS_BITMAP:
+		words = c->rc_data;
+		return (words[low / 64] >> (low % 64)) & 1;
+	default:
+		runs = c->rc_data;
+		i = rs_run_find(runs, c->rc_nr, low);
+		return i < c->rc_nr && low <= runs[i].rr_last;
+	}
+}
+
+/* number of ranks of the container less than low */
+static uint32_t
+rs_cont_rank(const struct rs_cont *c, uint32_t low)
+{
+	const uint64_t		*words;
+	const struct rs_run	*runs;
+	uint32_t		 cnt = 0;
+	uint32_t		 i;
+
+	switch (c->rc_type) {
+	case RS_ARRAY:
+		return rs_array_lower(c->rc_data, c->rc_nr, low);
+	case RS_BITMAP:
+		words = c->rc_data;
+		for (i = 0; i < low / 64; i++)
+			cnt += __builtin_popcountll(words[i]);
+		if (low % 64)
+			cnt += __builtin_popcountll(words[i] &
+						    ((1ULL << (low % 64)) - 1));
+		return cnt;
+	default:
+		runs = c->rc_data;
+		for (i = 0; i < c->rc_nr && runs[i].rr_first < low; i++) {
+			if (runs[i].rr_last < low)
+				cnt += runs[i].rr_last - runs[i].rr_first + 1;
+			else
+				cnt += low - runs[i].rr_first;
+		}
+		return cnt;
+	}
+}
+
+/* low bits of the idx-th rank of the container, idx < rc_card */
+static uint32_t
+rs_cont_select(const struct rs_cont *c, uint32_t idx)
+{
+	const uint64_t		*words;
+	const struct rs_run	*runs;
+	uint64_t		 word;
+	uint32_t		 cnt;
+	uint32_t		 i;
+
+	switch (c->rc_type) {
+	case RS_ARRAY:
+		return ((const uint16_t *)c->rc_data)[idx];
+	case RS_BITMAP:
+		words = c->rc_data;
+		for (i = 0; i < RS_WORDS; i++) {
+			cnt = __builtin_popcountll(words[i]);
+			if (idx < cnt)
+				break;
+			idx -= cnt;
+		}
+		D_ASSERT(i < RS_WORDS);
+		for (word = words[i]; idx > 0; idx--)
+			word &= word - 1;
+		return i * 64 + __builtin_ctzll(word);
+	default:
+		runs = c->rc_data;
+		for (i = 0; i < c->rc_nr; i++) {
+			cnt = runs[i].rr_last - runs[i].rr_first + 1;
+			if (idx < cnt)
+				break;
+			idx -= cnt;
+		}
+		D_ASSERT(i < c->rc_nr);
+		return runs[i].rr_first + idx;
+	}
+}
+
+static void
+rs_bitmap_set_range(uint64_t *words, uint32_t first, uint32_t last)
+{
+	uint32_t	fw = first / 64;
+	uint32_t	lw = last / 64;
+	uint64_t	fmask = ~0ULL << (first % 64);
+	uint64_t	lmask = ~0ULL >> (63 - last % 64);
+	uint32_t	i;
+
+	if (fw == lw) {
+		words[fw] |= fmask & lmask;
+		return;
+	}
+	words[fw] |= fmask;
+	for (i = fw + 1; i < lw; i++)
+		words[i] = ~0ULL;
+	words[lw] |= lmask;
+}
+
+/* the first bit at or after from that is set (or clear), RS_CHUNK if none */
+static uint32_t
+rs_bitmap_next(const uint64_t *words, uint32_t from, bool set)
+{
+	uint32_t	i = from / 64;
+	uint64_t	word;
+
+	word = (set ? words[i] : ~words[i]) & (~0ULL << (from % 64));
+	while (word == 0) {
+		if (++i == RS_WORDS)
+			return RS_CHUNK;
+		word = set ? words[i] : ~words[i];
+	}
+
+	return i * 64 + __builtin_ctzll(word);
+}
+
+/* expand a container, or nothing for c == NULL, into a RS_WORDS bitmap */
+static void
+rs_cont_to_bitmap(const struct rs_cont *c, uint64_t *words)
+{
+	const uint16_t		*array;
+	const struct rs_run	*runs;
+	uint32_t		 i;
+
+	if (c != NULL && c->rc_type == RS_BITMAP) {
+		memcpy(words, c->rc_data, RS_WORDS * sizeof(*words));
+		return;
+	}
+
+	memset(words, 0, RS_WORDS * sizeof(*words));
+	if (c == NULL)
+		return;
+
+	if (c->rc_type == RS_ARRAY) {
+		array = c->rc_data;
+		for (i = 0; i < c->rc_nr; i++)
+			words[array[i] / 64] |= 1ULL << (array[i] % 64);
+	} else {
+		runs = c->rc_data;
+		for (i = 0; i < c->rc_nr; i++)
+			rs_bitmap_set_range(words, runs[i].rr_first,
+					    runs[i].rr_last);
+	}
+}
+
+/*
+ * Build the smallest container holding the bits of words. rc_card of the
+ * result is 0 and nothing is allocated if words is empty.
+ */
+static int
+rs_cont_from_bitmap(struct rs_cont *c, uint32_t key, const uint64_t *words)
+{
+	struct rs_run	*runs;
+	uint16_t	*array;
+	uint64_t	 word;
+	uint64_t	 carry = 0;
+	uint32_t	 card = 0;
+	uint32_t	 nruns = 0;
+	uint32_t	 low;
+	uint32_t	 n;
+	uint32_t	 i;
+
+	memset(c, 0, sizeof(*c));
+	c->rc_key = key;
+
+	for (i = 0; i < RS_WORDS; i++) {
+		word = words[i];
+		card += __builtin_popcountll(word);
+		/* a run starts at each set bit following a clear one */
+		nruns += __builtin_popcountll(word & ~((word << 1) | carry));
+		carry = word >> 63;
+	}
+	if (card == 0)
+		return 0;
+	c->rc_card = card;
+
+	if (nruns * sizeof(struct rs_run) < RS_WORDS * sizeof(uint64_t) &&
+	    (card > RS_ARRAY_MAX ||
+	     nruns * sizeof(struct rs_run) < card * sizeof(uint16_t))) {
+		c->rc_type = RS_RUN;
+		c->rc_nr = nruns;
+		D_ALLOC_ARRAY(runs, nruns);
+		if (runs == NULL)
+			return -DER_NOMEM;
+		n = 0;
+		low = rs_bitmap_next(words, 0, true);
+		while (low < RS_CHUNK) {
+			runs[n].rr_first = low;
+			low = rs_bitmap_next(words, low, false);
+			runs[n].rr_last = low - 1;
+			n++;
+			if (low < RS_CHUNK)
+				low = rs_bitmap_next(words, low, true);
+		}
+		D_ASSERT(n == nruns);
+		c->rc_data = runs;
+	} else if (card <= RS_ARRAY_MAX) {
+		c->rc_type = RS_ARRAY;
+		c->rc_nr = card;
+		D_ALLOC_ARRAY(array, card);
+		if (array == NULL)
+			return -DER_NOMEM;
+		n = 0;
+		for (i = 0; i < RS_WORDS; i++) {
+			for (word = words[i]; word != 0; word &= word - 1)
+				array[n++] = i * 64 + __builtin_ctzll(word);
+		}
+		c->rc_data = array;
+	} else {
+		c->rc_type = RS_BITMAP;
+		c->rc_nr = 0;
+		D_ALLOC(c->rc_data, RS_WORDS * sizeof(uint64_t));
+		if (c->rc_data == NULL)
+			return -DER_NOMEM;
+		memcpy(c->rc_data, words, RS_WORDS * sizeof(uint64_t));
+	}
+
+	return 0;
+}
+
+/* write the ranks of a container in ascending order */
+static void
+rs_cont_emit(const struct rs_cont *c, d_rank_t *ranks)
+{
+	const uint16_t		*array;
+	const uint64_t		*words;
+	const struct rs_run	*runs;
+	uint64_t		 word;
+	uint32_t		 low;
+	uint32_t		 n = 0;
+	uint32_t		 i;
+
+	switch (c->rc_type) {
+	case RS_ARRAY:
+		array = c->rc_data;
+		for (i = 0; i < c->rc_nr; i++)
+			ranks[n++] = RS_RANK(c->rc_key, array[i]);
+		break;
+	case RS_BITMAP:
+		words = c->rc_data;
+		for (i = 0; i < RS_WORDS; i++) {
+			for (word = words[i]; word != 0; word &= word - 1)
+				ranks[n++] = RS_RANK(c->rc_key, i * 64 +
+						     __builtin_ctzll(word));
+		}
+		break;
+	default:
+		runs = c->rc_data;
+		for (i = 0; i < c->rc_nr; i++) {
+			for (low = runs[i].rr_first; low <= runs[i].rr_last;
+			     low++)
+				ranks[n++] = RS_RANK(c->rc_key, low);
+		}
+		break;
+	}
+	D_ASSERT(n == c->rc_card);
+}
+
+/* index of the container of key, or where to insert it if !*found */
+static uint32_t
+rs_find(const d_rank_set_t *set, uint32_t key, bool *found)
+{
+	uint32_t	lo = 0;
+	uint32_t	hi = set->rs_nr_conts;
+	uint32_t	mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (set->rs_conts[mid].rc_key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*found = lo < set->rs_nr_conts && set->rs_conts[lo].rc_key == key;
+
+	return lo;
+}
+
+/* update rc_base of the containers from idx on, and rs_nr */
+static void
+rs_rebase(d_rank_set_t *set, uint32_t idx)
+{
+	struct rs_cont	*c;
+	uint32_t	 base;
+
+	if (idx == 0)
+		base = 0;
+	else
+		base = set->rs_conts[idx - 1].rc_base +
+		       set->rs_conts[idx - 1].rc_card;
+	for (; idx < set->rs_nr_conts; idx++) {
+		c = &set->rs_conts[idx];
+		c->rc_base = base;
+		base += c->rc_card;
+	}
+	set->rs_nr = base;
+}
+
+static int
+rs_reserve(d_rank_set_t *set, uint32_t nr)
+{
+	struct rs_cont	*conts;
+	uint32_t	 cap;
+
+	if (nr <= set->rs_cap_conts)
+		return 0;
+
+	cap = set->rs_cap_conts == 0 ? 4 : set->rs_cap_conts;
+	while (cap < nr)
+		cap *= 2;
+	D_REALLOC(conts, set->rs_conts, cap * sizeof(*conts));
+	if (conts == NULL)
+		return -DER_NOMEM;
+	set->rs_conts = conts;
+	set->rs_cap_conts = cap;
+
+	return 0;
+}
+
+/* insert c at idx, the caller reserved room for it */
+static void
+rs_insert(d_rank_set_t *set, uint32_t idx, const struct rs_cont *c)
+{
+	D_ASSERT(set->rs_nr_conts < set->rs_cap_conts);
+	memmove(&set->rs_conts[idx + 1], &set->rs_conts[idx],
+		(set->rs_nr_conts - idx) * sizeof(*c));
+	set->rs_conts[idx] = *c;
+	set->rs_nr_conts++;
+	rs_rebase(set, idx);
+}
+
+static void
+rs_remove(d_rank_set_t *set, uint32_t idx)
+{
+	rs_cont_fini(&set->rs_conts[idx]);
+	set->rs_nr_conts--;
+	memmove(&set->rs_conts[idx], &set->rs_conts[idx + 1],
+		(set->rs_nr_conts - idx) * sizeof(struct rs_cont));
+	rs_rebase(set, idx);
+}
+
+/* replace the container at idx with c, removing it if c is empty */
+static void
+rs_replace(d_rank_set_t *set, uint32_t idx, struct rs_cont *c)
+{
+	if (c->rc_card == 0) {
+		rs_remove(set, idx);
+		return;
+	}
+	rs_cont_fini(&set->rs_conts[idx]);
+	set->rs_conts[idx] = *c;
+	rs_rebase(set, idx);
+}
+
+d_rank_set_t *
+d_rank_set_alloc(void)
+{
+	d_rank_set_t	*set;
+
+	D_ALLOC_PTR(set);
+
+	return set;
+}
+
+void
+d_rank_set_free(d_rank_set_t *set)
+{
+	uint32_t	i;
+
+	if (set == NULL)
+		return;
+
+	for (i = 0; i < set->rs_nr_conts; i++)
+		rs_cont_fini(&set->rs_conts[i]);
+	D_FREE(set->rs_conts);
+	D_FREE_PTR(set);
+}
+
+int
+d_rank_set_dup(d_rank_set_t **dst, const d_rank_set_t *src)
+{
+	d_rank_set_t	*set = NULL;
+	int		 rc = 0;
+
+	if (dst == NULL) {
+		D_ERROR("Invalid parameter, dst: %p, src: %p.\n", dst, src);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	if (src == NULL)
+		D_GOTO(out, 0);
+
+	set = d_rank_set_alloc();
+	if (set == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	rc = rs_reserve(set, src->rs_nr_conts);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	for (; set->rs_nr_conts < src->rs_nr_conts; set->rs_nr_conts++) {
+		rc = rs_cont_dup(&set->rs_conts[set->rs_nr_conts],
+				 &src->rs_conts[set->rs_nr_conts]);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+	set->rs_nr = src->rs_nr;
+
+out:
+	if (rc == 0) {
+		*dst = set;
+	} else {
+		d_rank_set_free(set);
+	}
+	return rc;
+}
+
+int
+d_rank_set_from_list(d_rank_set_t **set, const d_rank_list_t *list)
+{
+	d_rank_list_t	*sorted = NULL;
+	d_rank_set_t	*result = NULL;
+	struct rs_cont	 c;
+	uint16_t	*array;
+	uint64_t	 words[RS_WORDS];
+	uint32_t	 key;
+	uint32_t	 i;
+	uint32_t	 j;
+	uint32_t	 k;
+	int		 rc = 0;
+
+	if (set == NULL) {
+		D_ERROR("Invalid parameter, set: %p, list: %p.\n", set, list);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	if (list == NULL)
+		D_GOTO(out, 0);
+
+	result = d_rank_set_alloc();
+	if (result == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	if (list->rl_nr == 0)
+		D_GOTO(out, 0);
+
+	rc = d_rank_list_dup_sort_uniq(&sorted, list);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	/* one container per run of ranks sharing the same key */
+	for (i = 0; i < sorted->rl_nr; i = j) {
+		key = RS_KEY(sorted->rl_ranks[i]);
+		for (j = i + 1; j < sorted->rl_nr &&
+		     RS_KEY(sorted->rl_ranks[j]) == key; j++)
+			;
+
+		if (j - i <= RS_ARRAY_MAX &&
+		    sorted->rl_ranks[j - 1] - sorted->rl_ranks[i] != j - i - 1) {
+			memset(&c, 0, sizeof(c));
+			c.rc_key = key;
+			c.rc_type = RS_ARRAY;
+			c.rc_card = j - i;
+			c.rc_nr = j - i;
+			D_ALLOC_ARRAY(array, c.rc_nr);
+			if (array == NULL)
+				D_GOTO(out, rc = -DER_NOMEM);
+			for (k = 0; k < c.rc_nr; k++)
+				array[k] = RS_LOW(sorted->rl_ranks[i + k]);
+			c.rc_data = array;
+		} else {
+			memset(words, 0, sizeof(words));
+			for (; i < j; i++)
+				words[RS_LOW(sorted->rl_ranks[i]) / 64] |=
+				    1ULL << (RS_LOW(sorted->rl_ranks[i]) % 64);
+			rc = rs_cont_from_bitmap(&c, key, words);
+			if (rc != 0)
+				D_GOTO(out, rc);
+		}
+
+		rc = rs_reserve(result, result->rs_nr_conts + 1);
+		if (rc != 0) {
+			rs_cont_fini(&c);
+			D_GOTO(out, rc);
+		}
+		rs_insert(result, result->rs_nr_conts, &c);
+	}
+
+out:
+	d_rank_list_free(sorted);
+	if (rc == 0) {
+		*set = result;
+	} else {
+		d_rank_set_free(result);
+	}
+	return rc;
+}
+
+int
+d_rank_set_to_list(const d_rank_set_t *set, d_rank_list_t **list)
+{
+	d_rank_list_t	*result = NULL;
+	uint32_t	 i;
+	int		 rc = 0;
+
+	if (list == NULL) {
+		D_ERROR("Invalid parameter, set: %p, list: %p.\n", set, list);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	if (set == NULL)
+		D_GOTO(out, 0);
+
+	result = d_rank_list_alloc(set->rs_nr);
+	if (result == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	for (i = 0; i < set->rs_nr_conts; i++)
+		rs_cont_emit(&set->rs_conts[i],
+			     &result->rl_ranks[set->rs_conts[i].rc_base]);
+
+out:
+	if (rc == 0)
+		*list = result;
+	return rc;
+}
+
+/* add low, which is not in it yet, to a run container */
+static int
+rs_run_add(struct rs_cont *c, uint32_t low)
+{
+	struct rs_run	*runs = c->rc_data;
+	uint32_t	 i;
+	uint32_t	 j;
+	bool		 left;
+	bool		 right;
+
+	i = rs_run_find(runs, c->rc_nr, low);
+	j = i == c->rc_nr ? 0 : i + 1;
+	left = i < c->rc_nr && runs[i].rr_last + 1 == low;
+	right = j < c->rc_nr && runs[j].rr_first == low + 1;
+
+	if (left && right) {
+		runs[i].rr_last = runs[j].rr_last;
+		memmove(&runs[j], &runs[j + 1],
+			(c->rc_nr - j - 1) * sizeof(*runs));
+		c->rc_nr--;
+	} else if (left) {
+		runs[i].rr_last = low;
+	} else if (right) {
+		runs[j].rr_first = low;
+	} else {
+		D_REALLOC(runs, c->rc_data, (c->rc_nr + 1) * sizeof(*runs));
+		if (runs == NULL)
+			return -DER_NOMEM;
+		c->rc_data = runs;
+		memmove(&runs[j + 1], &runs[j], (c->rc_nr - j) * sizeof(*runs));
+		runs[j].rr_first = low;
+		runs[j].rr_last = low;
+		c->rc_nr++;
+	}
+	c->rc_card++;
+
+	return 0;
+}
+
+/* remove low, which is in it, from a run container */
+static int
+rs_run_del(struct rs_cont *c, uint32_t low)
+{
+	struct rs_run	*runs = c->rc_data;
+	uint32_t	 i;
+
+	i = rs_run_find(runs, c->rc_nr, low);
+	D_ASSERT(i < c->rc_nr && low <= runs[i].rr_last);
+
+	if (runs[i].rr_first == runs[i].rr_last) {
+		memmove(&runs[i], &runs[i + 1],
+			(c->rc_nr - i - 1) * sizeof(*runs));
+		c->rc_nr--;
+	} else if (runs[i].rr_first == low) {
+		runs[i].rr_first++;
+	} else if (runs[i].rr_last == low) {
+		runs[i].rr_last--;
+	} else {
+		/* split the run around low */
+		D_REALLOC(runs, c->rc_data, (c->rc_nr + 1) * sizeof(*runs));
+		if (runs == NULL)
+			return -DER_NOMEM;
+		c->rc_data = runs;
+		memmove(&runs[i + 1], &runs[i], (c->rc_nr - i) * sizeof(*runs));
+		runs[i].rr_last = low - 1;
+		runs[i + 1].rr_first = low + 1;
+		c->rc_nr++;
+	}
+	c->rc_card--;
+
+	return 0;
+}
+
+/* add or remove the ranks first to last of one container through a bitmap */
+static int
+rs_update_bitmap(d_rank_set_t *set, uint32_t key, uint32_t first,
+		 uint32_t last, bool add)
+{
+	struct rs_cont	 c;
+	uint64_t	 words[RS_WORDS];
+	uint32_t	 idx;
+	uint32_t	 low;
+	bool		 found;
+	int		 rc;
+
+	idx = rs_find(set, key, &found);
+	if (!found && !add)
+		return 0;
+	if (!found) {
+		rc = rs_reserve(set, set->rs_nr_conts + 1);
+		if (rc != 0)
+			return rc;
+	}
+
+	rs_cont_to_bitmap(found ? &set->rs_conts[idx] : NULL, words);
+	if (add) {
+		rs_bitmap_set_range(words, first, last);
+	} else {
+		for (low = first; low <= last; low++)
+			words[low / 64] &= ~(1ULL << (low % 64));
+	}
+
+	rc = rs_cont_from_bitmap(&c, key, words);
+	if (rc != 0)
+		return rc;
+
+	if (found)
+		rs_replace(set, idx, &c);
+	else
+		rs_insert(set, idx, &c);
+
+	return 0;
+}
+
+int
+d_rank_set_add(d_rank_set_t *set, d_rank_t rank)
+{
+	struct rs_cont	*c;
+	struct rs_cont	 new_c;
+	uint16_t	*array;
+	uint32_t	 low = RS_LOW(rank);
+	uint32_t	 idx;
+	uint32_t	 i;
+	bool		 found;
+	int		 rc = 0;
+
+	if (set == NULL) {
+		D_ERROR("Invalid parameter, NULL set.\n");
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	idx = rs_find(set, RS_KEY(rank), &found);
+	if (!found) {
+		rc = rs_reserve(set, set->rs_nr_conts + 1);
+		if (rc != 0)
+			D_GOTO(out, rc);
+		memset(&new_c, 0, sizeof(new_c));
+		new_c.rc_key = RS_KEY(rank);
+		new_c.rc_type = RS_ARRAY;
+		new_c.rc_card = 1;
+		new_c.rc_nr = 1;
+		D_ALLOC_ARRAY(array, 1);
+		if (array == NULL)
+			D_GOTO(out, rc = -DER_NOMEM);
+		array[0] = low;
+		new_c.rc_data = array;
+		rs_insert(set, idx, &new_c);
+		D_GOTO(out, rc);
+	}
+
+	c = &set->rs_conts[idx];
+	if (rs_cont_has(c, low))
+		D_GOTO(out, rc);
+
+	if (c->rc_type == RS_BITMAP) {
+		((uint64_t *)c->rc_data)[low / 64] |= 1ULL << (low % 64);
+		c->rc_card++;
+		rs_rebase(set, idx + 1);
+	} else if (c->rc_type == RS_RUN && c->rc_nr < RS_RUN_MAX) {
+		rc = rs_run_add(c, low);
+		if (rc == 0)
+			rs_rebase(set, idx + 1);
+	} else if (c->rc_type == RS_ARRAY && c->rc_nr < RS_ARRAY_MAX) {
+		D_REALLOC(array, c->rc_data, (c->rc_nr + 1) * sizeof(*array));
+		if (array == NULL)
+			D_GOTO(out, rc = -DER_NOMEM);
+		i = rs_array_lower(array, c->rc_nr, low);
+		memmove(&array[i + 1], &array[i],
+			(c->rc_nr - i) * sizeof(*array));
+		array[i] = low;
+		c->rc_data = array;
+		c->rc_nr++;
+		c->rc_card++;
+		rs_rebase(set, idx + 1);
+	} else {
+		rc = rs_update_bitmap(set, RS_KEY(rank), low, low, true);
+	}
+
+out:
+	return rc;
+}
+
+int
+d_rank_set_add_range(d_rank_set_t *set, d_rank_t first, d_rank_t last)
+{
+	uint32_t	key;
+	int		rc = 0;
+
+	if (set == NULL || first > last) {
+		D_ERROR("Invalid parameter, set: %p, first: %u, last: %u.\n",
+			set, first, last);
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	for (key = RS_KEY(first); key <= RS_KEY(last); key++) {
+		rc = rs_update_bitmap(set, key,
+				      key == RS_KEY(first) ? RS_LOW(first) : 0,
+				      key == RS_KEY(last) ? RS_LOW(last) :
+				      RS_CHUNK - 1, true);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+
+out:
+	return rc;
+}
+
+int
+d_rank_set_del(d_rank_set_t *set, d_rank_t rank)
+{
+	struct rs_cont	*c;
+	uint16_t	*array;
+	uint32_t	 low = RS_LOW(rank);
+	uint32_t	 idx;
+	uint32_t	 i;
+	bool		 found;
+	int		 rc = 0;
+
+	if (set == NULL) {
+		D_ERROR("Invalid parameter, NULL set.\n");
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	idx = rs_find(set, RS_KEY(rank), &found);
+	if (!found)
+		D_GOTO(out, rc);
+	c = &set->rs_conts[idx];
+	if (!rs_cont_has(c, low))
+		D_GOTO(out, rc);
+
+	if (c->rc_card == 1) {
+		rs_remove(set, idx);
+	} else if (c->rc_type == RS_ARRAY) {
+		/* keep the allocation, the array only shrinks in place */
+		array = c->rc_data;
+		i = rs_array_lower(array, c->rc_nr, low);
+		memmove(&array[i], &array[i + 1],
+			(c->rc_nr - i - 1) * sizeof(*array));
+		c->rc_nr--;
+		c->rc_card--;
+		rs_rebase(set, idx + 1);
+	} else if (c->rc_type == RS_RUN && c->rc_nr < RS_RUN_MAX) {
+		rc = rs_run_del(c, low);
+		if (rc == 0)
+			rs_rebase(set, idx + 1);
+	} else if (c->rc_type == RS_BITMAP && c->rc_card > RS_ARRAY_MAX + 1) {
+		((uint64_t *)c->rc_data)[low / 64] &= ~(1ULL << (low % 64));
+		c->rc_card--;
+		rs_rebase(set, idx + 1);
+	} else {
+		rc = rs_update_bitmap(set, RS_KEY(rank), low, low, false);
+	}
+
+out:
+	return rc;
+}
+
+bool
+d_rank_set_has(const d_rank_set_t *set, d_rank_t rank)
+{
+	uint32_t	idx;
+	bool		found;
+
+	if (set == NULL)
+		return false;
+
+	idx = rs_find(set, RS_KEY(rank), &found);
+
+	return found && rs_cont_has(&set->rs_conts[idx], RS_LOW(rank));
+}
+
+uint32_t
+d_rank_set_nr(const d_rank_set_t *set)
+{
+	return set == NULL ? 0 : set->rs_nr;
+}
+
+int
+d_rank_set_idx(const d_rank_set_t *set, d_rank_t rank, uint32_t *idx)
+{
+	const struct rs_cont	*c;
+	uint32_t		 i;
+	bool			 found;
+
+	if (set == NULL || idx == NULL)
+		return -DER_INVAL;
+
+	i = rs_find(set, RS_KEY(rank), &found);
+	if (!found)
+		return -DER_NONEXIST;
+	c = &set->rs_conts[i];
+	if (!rs_cont_has(c, RS_LOW(rank)))
+		return -DER_NONEXIST;
+
+	*idx = c->rc_base + rs_cont_rank(c, RS_LOW(rank));
+
+	return 0;
+}
+
+int
+d_rank_set_rank(const d_rank_set_t *set, uint32_t idx, d_rank_t *rank)
+{
+	const struct rs_cont	*c;
+	uint32_t		 lo;
+	uint32_t		 hi;
+	uint32_t		 mid;
+
+	if (set == NULL || rank == NULL)
+		return -DER_INVAL;
+	if (idx >= set->rs_nr)
+		return -DER_NONEXIST;
+
+	/* the last container whose base is not past idx */
+	lo = 0;
+	hi = set->rs_nr_conts;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (set->rs_conts[mid].rc_base <= idx)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	c = &set->rs_conts[lo];
+	*rank = RS_RANK(c->rc_key, rs_cont_select(c, idx - c->rc_base));
+
+	return 0;
+}
+
+/* keep the array entries of a that are (or, when !keep, are not) in b */
+static int
+rs_cont_filter(struct rs_cont *out, const struct rs_cont *a,
+	       const struct rs_cont *b, bool keep)
+{
+	const uint16_t	*src = a->rc_data;
+	uint16_t	*array;
+	uint32_t	 n = 0;
+	uint32_t	 i;
+
+	memset(out, 0, sizeof(*out));
+	out->rc_key = a->rc_key;
+	out->rc_type = RS_ARRAY;
+
+	D_ALLOC_ARRAY(array, a->rc_nr);
+	if (array == NULL)
+		return -DER_NOMEM;
+	for (i = 0; i < a->rc_nr; i++) {
+		if (rs_cont_has(b, src[i]) == keep)
+			array[n++] = src[i];
+	}
+	if (n == 0) {
+		D_FREE(array);
+		return 0;
+	}
+	out->rc_nr = n;
+	out->rc_card = n;
+	out->rc_data = array;
+
+	return 0;
+}
+
+/* merge two array containers whose union fits in an array container */
+static int
+rs_cont_merge(struct rs_cont *out, const struct rs_cont *a,
+	      const struct rs_cont *b)
+{
+	const uint16_t	*aa = a->rc_data;
+	const uint16_t	*ba = b->rc_data;
+	uint16_t	*array;
+	uint32_t	 i = 0;
+	uint32_t	 j = 0;
+	uint32_t	 n = 0;
+
+	memset(out, 0, sizeof(*out));
+	out->rc_key = a->rc_key;
+	out->rc_type = RS_ARRAY;
+
+	D_ALLOC_ARRAY(array, a->rc_nr + b->rc_nr);
+	if (array == NULL)
+		return -DER_NOMEM;
+	while (i < a->rc_nr || j < b->rc_nr) {
+		if (j == b->rc_nr || (i < a->rc_nr && aa[i] < ba[j])) {
+			array[n++] = aa[i++];
+		} else if (i == a->rc_nr || ba[j] < aa[i]) {
+			array[n++] = ba[j++];
+		} else {
+			array[n++] = aa[i++];
+			j++;
+		}
+	}
+	out->rc_nr = n;
+	out->rc_card = n;
+	out->rc_data = array;
+
+	return 0;
+}
+
+/* combine two containers of the same key, out is empty if rc_card is 0 */
+static int
+rs_cont_op(struct rs_cont *out, const struct rs_cont *a,
+	   const struct rs_cont *b, enum rs_op op)
+{
+	uint64_t	wa[RS_WORDS];
+	uint64_t	wb[RS_WORDS];
+	uint32_t	i;
+
+	if (op != RS_OP_UNION && a->rc_type == RS_ARRAY)
+		return rs_cont_filter(out, a, b, op == RS_OP_INTERSECT);
+	if (op == RS_OP_INTERSECT && b->rc_type == RS_ARRAY)
+		return rs_cont_filter(out, b, a, true);
+	if (op == RS_OP_UNION && a->rc_type == RS_ARRAY &&
+	    b->rc_type == RS_ARRAY && a->rc_nr + b->rc_nr <= RS_ARRAY_MAX)
+		return rs_cont_merge(out, a, b);
+
+	rs_cont_to_bitmap(a, wa);
+	rs_cont_to_bitmap(b, wb);
+	for (i = 0; i < RS_WORDS; i++) {
+		switch (op) {
+		case RS_OP_UNION:
+			wa[i] |= wb[i];
+			break;
+		case RS_OP_DIFF:
+			wa[i] &= ~wb[i];
+			break;
+		case RS_OP_INTERSECT:
+			wa[i] &= wb[i];
+			break;
+		}
+	}
+
+	return rs_cont_from_bitmap(out, a->rc_key, wa);
+}
+
+/* dst = dst op src, built aside and swapped in so dst is intact on error */
+static int
+rs_op(d_rank_set_t *dst, const d_rank_set_t *src, enum rs_op op)
+{
+	const struct rs_cont	*a;
+	const struct rs_cont	*b;
+	struct rs_cont		*conts = NULL;
+	uint32_t		 cap;
+	uint32_t		 nr = 0;
+	uint32_t		 i = 0;
+	uint32_t		 j = 0;
+	int			 rc = 0;
+
+	if (dst == NULL) {
+		D_ERROR("Invalid parameter, NULL dst.\n");
+		D_GOTO(out, rc = -DER_INVAL);
+	}
+
+	if (src == NULL || src->rs_nr_conts == 0) {
+		if (op == RS_OP_INTERSECT) {
+			for (i = 0; i < dst->rs_nr_conts; i++)
+				rs_cont_fini(&dst->rs_conts[i]);
+			dst->rs_nr_conts = 0;
+			dst->rs_nr = 0;
+		}
+		D_GOTO(out, rc);
+	}
+
+	cap = dst->rs_nr_conts + (op == RS_OP_UNION ? src->rs_nr_conts : 0);
+	if (cap == 0)
+		D_GOTO(out, rc);
+	D_ALLOC_ARRAY(conts, cap);
+	if (conts == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	while (i < dst->rs_nr_conts || j < src->rs_nr_conts) {
+		a = i < dst->rs_nr_conts ? &dst->rs_conts[i] : NULL;
+		b = j < src->rs_nr_conts ? &src->rs_conts[j] : NULL;
+
+		if (b == NULL || (a != NULL && a->rc_key < b->rc_key)) {
+			/* only in dst */
+			i++;
+			if (op == RS_OP_INTERSECT)
+				continue;
+			rc = rs_cont_dup(&conts[nr], a);
+		} else if (a == NULL || b->rc_key < a->rc_key) {
+			/* only in src */
+			j++;
+			if (op != RS_OP_UNION)
+				continue;
+			rc = rs_cont_dup(&conts[nr], b);
+		} else {
+			i++;
+			j++;
+			rc = rs_cont_op(&conts[nr], a, b, op);
+		}
+		if (rc != 0)
+			D_GOTO(out, rc);
+		if (conts[nr].rc_card != 0)
+			nr++;
+	}
+
+	for (i = 0; i < dst->rs_nr_conts; i++)
+		rs_cont_fini(&dst->rs_conts[i]);
+	D_FREE(dst->rs_conts);
+	dst->rs_conts = conts;
+	dst->rs_nr_conts = nr;
+	dst->rs_cap_conts = cap;
+	rs_rebase(dst, 0);
+	conts = NULL;
+	nr = 0;
+
+out:
+	if (conts != NULL) {
+		for (i = 0; i < nr; i++)
+			rs_cont_fini(&conts[i]);
+		D_FREE(conts);
+	}
+	return rc;
+}
+
+int
+d_rank_set_union(d_rank_set_t *dst, const d_rank_set_t *src)
+{
+	return rs_op(dst, src, RS_OP_UNION);
+}
+
+int
+d_rank_set_diff(d_rank_set_t *dst, const d_rank_set_t *src)
+{
+	return rs_op(dst, src, RS_OP_DIFF);
+}
+
+int
+d_rank_set_intersect(d_rank_set_t *dst, const d_rank_set_t *src)
+{
+	return rs_op(dst, src, RS_OP_INTERSECT);
+}
+
+bool
+d_rank_set_identical(const d_rank_set_t *set1, const d_rank_set_t *set2)
+{
+	const struct rs_cont	*a;
+	const struct rs_cont	*b;
+	uint64_t		 wa[RS_WORDS];
+	uint64_t		 wb[RS_WORDS];
+	uint32_t		 i;
+
+	if (set1 == set2)
+		return true;
+	if (d_rank_set_nr(set1) != d_rank_set_nr(set2))
+		return false;
+	if (set1 == NULL || set2 == NULL)
+		return true;
+	if (set1->rs_nr_conts != set2->rs_nr_conts)
+		return false;
+
+	for (i = 0; i < set1->rs_nr_conts; i++) {
+		a = &set1->rs_conts[i];
+		b = &set2->rs_conts[i];
+		if (a->rc_key != b->rc_key || a->rc_card != b->rc_card)
+			return false;
+		/* the same content may sit in containers of different types */
+		rs_cont_to_bitmap(a, wa);
+		rs_cont_to_bitmap(b, wb);
+		if (memcmp(wa, wb, sizeof(wa)) != 0)
+			return false;
+	}
+
+	return true;
+}
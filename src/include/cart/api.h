@@ -400,6 +400,24 @@ crt_req_abort(crt_rpc_t *req);
 int
 crt_ep_abort(crt_endpoint_t *ep);
 
+/**
+ * Get the RPC statistics of a context for a target rank.
+ *
+ * With ENV CRT_AUTO_SM set to 1, RPCs to a rank running on the same host go
+ * through the shared-memory route and the others through the fabric. The
+ * statistics show which route the completed RPCs took.
+ *
+ * \param[in] crt_ctx          CRT transport context
+ * \param[in] rank             target rank
+ * \param[out] stats           returned statistics
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ *                             -DER_NONEXIST if no RPC was sent to the rank
+ */
+int
+crt_ep_stats_get(crt_context_t crt_ctx, d_rank_t rank,
+		 struct crt_ep_stats *stats);
+
 /**
  * Dynamically register an RPC with features at client-side.
  *
@@ -540,6 +558,31 @@ int
 crt_bulk_transfer(struct crt_bulk_desc *bulk_desc, crt_bulk_cb_t complete_cb,
 		  void *arg, crt_bulk_opid_t *opid);
 
+/**
+ * Start a group of bulk transfers (inside an RPC handler) with one aggregated
+ * completion.
+ *
+ * All descriptors are submitted in order, each the same way as by
+ * crt_bulk_transfer(). \a complete_cb is invoked exactly once after the last
+ * of them completed, and reports the status of each descriptor through
+ * crt_bulk_vec_cb_info::bvci_rcs, a descriptor that could not be submitted
+ * fails alone.
+ *
+ * \param[in] bulk_descs       array of \a nr bulk transferring descriptors,
+ *                             it is user's responsibility to allocate and free
+ *                             it. Can free it after the calling returns.
+ * \param[in] nr               number of descriptors in \a bulk_descs
+ * \param[in] complete_cb      completion callback
+ * \param[in] arg              arguments for the \a complete_cb
+ *
+ * \return                     DER_SUCCESS on success, negative value if error.
+ *                             On error no descriptor was submitted and
+ *                             \a complete_cb will not be called.
+ */
+int
+crt_bulk_transfer_vec(struct crt_bulk_desc *bulk_descs, int nr,
+		      crt_bulk_vec_cb_t complete_cb, void *arg);
+
 /**
  * Get length (number of bytes) of data abstracted by bulk handle.
  *
@@ -576,6 +619,83 @@ crt_bulk_get_sgnum(crt_bulk_t bulk_hdl, unsigned int *bulk_sgnum);
 int
 crt_bulk_abort(crt_context_t crt_ctx, crt_bulk_opid_t opid);
 
+/**
+ * Create a pool of buffers registered for bulk transfers.
+ *
+ * For each size class the pool allocates one slab of \a bufs_per_class
+ * buffers and registers it once, so that crt_buf_get() returns memory that
+ * can be used for bulk transfers without paying the registration again.
+ *
+ * \param[in] crt_ctx          CRT transport context the buffers are
+ *                             registered with
+ * \param[in] sizes            buffer size of each class
+ * \param[in] nr_sizes         number of size classes
+ * \param[in] bufs_per_class   number of buffers of each class
+ * \param[in] flags            bit flags, see CRT_BUF_POOL_HUGEPAGE
+ * \param[out] pool            created pool
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ */
+int
+crt_buf_pool_create(crt_context_t crt_ctx, const size_t *sizes, int nr_sizes,
+		    uint32_t bufs_per_class, uint32_t flags,
+		    crt_buf_pool_t *pool);
+
+/**
+ * Destroy a registered buffer pool.
+ *
+ * \param[in] pool             pool to destroy
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ *                             -DER_BUSY if some buffers are not put back yet
+ */
+int
+crt_buf_pool_destroy(crt_buf_pool_t pool);
+
+/**
+ * Get a buffer of at least \a len bytes from a registered buffer pool.
+ *
+ * The buffer comes from the smallest size class that fits and has a free
+ * buffer. It is not zeroed.
+ *
+ * \param[in] pool             buffer pool
+ * \param[in] len              needed length
+ * \param[out] buf             returned buffer
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ *                             -DER_NOSPACE if no free buffer is large enough
+ */
+int
+crt_buf_get(crt_buf_pool_t pool, size_t len, struct crt_buf **buf);
+
+/**
+ * Put a buffer back to its pool.
+ *
+ * \param[in] buf              buffer returned by crt_buf_get()
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ */
+int
+crt_buf_put(struct crt_buf *buf);
+
+/**
+ * Get the shared-memory bulk counters of a context.
+ *
+ * Bulk transfers inside the handler of an RPC sent by a process on the same
+ * host are done by cross-memory attach instead of the NA plugin, unless it is
+ * disabled by setting ENV CRT_BULK_SM to 0 or the transfer requested an opid.
+ * Transfers that cannot be done this way fall back to the NA plugin.
+ *
+ * \param[in] crt_ctx          CRT transport context
+ * \param[out] count           number of bulk transfers done by cross-memory
+ *                             attach
+ * \param[out] bytes           number of bytes moved by cross-memory attach
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ */
+int
+crt_bulk_sm_stats_get(crt_context_t crt_ctx, uint64_t *count, uint64_t *bytes);
+
 /******************************************************************************
  * CRT group definition and collective APIs.
  ******************************************************************************/
@@ -587,7 +707,19 @@ enum crt_tree_type {
 	CRT_TREE_FLAT		= 1,
 	CRT_TREE_KARY		= 2,
 	CRT_TREE_KNOMIAL	= 3,
-	CRT_TREE_MAX		= 3,
+	/*
+	 * knomial tree over one leader rank per host, each leader fans out to
+	 * the other ranks of its host by a knomial tree of the same ratio.
+	 * Same as CRT_TREE_KNOMIAL when the hosts of the ranks are not known.
+	 */
+	CRT_TREE_HIER		= 4,
+	CRT_TREE_MAX		= 4,
+	/*
+	 * Let the root of each collective pick one of the types above and its
+	 * branch ratio, see crt_tree_auto_register(). The branch ratio given
+	 * to crt_tree_topo() is ignored.
+	 */
+	CRT_TREE_AUTO		= 5,
 };
 
 #define CRT_TREE_TYPE_SHIFT	(16U)
@@ -598,8 +730,9 @@ enum crt_tree_type {
  * Calculate the tree topology. Can only be called on the server side.
  *
  * \param[in] tree_type        tree type
- * \param[in] branch_ratio     branch ratio, be ignored for CRT_TREE_FLAT.
- *                             for KNOMIAL tree or KARY tree, the valid value
+ * \param[in] branch_ratio     branch ratio, be ignored for CRT_TREE_FLAT and
+ *                             CRT_TREE_AUTO.
+ *                             for KNOMIAL, KARY or HIER tree, the valid value
  *                             should within the range of
  *                             [CRT_TREE_MIN_RATIO, CRT_TREE_MAX_RATIO], or
  *                             will be treated as invalid parameter.
@@ -610,13 +743,67 @@ enum crt_tree_type {
 static inline int
 crt_tree_topo(enum crt_tree_type tree_type, uint32_t branch_ratio)
 {
-	if (tree_type < CRT_TREE_MIN || tree_type > CRT_TREE_MAX)
+	if ((tree_type < CRT_TREE_MIN || tree_type > CRT_TREE_MAX) &&
+	    tree_type != CRT_TREE_AUTO)
 		return -DER_INVAL;
 
 	return (tree_type << CRT_TREE_TYPE_SHIFT) |
 	       (branch_ratio & ((1U << CRT_TREE_TYPE_SHIFT) - 1));
 }
 
+/* what a CRT_TREE_AUTO collective is known by when its tree is chosen */
+struct crt_tree_auto_in {
+	/* number of ranks the collective goes to, including the root */
+	uint32_t	tai_grp_size;
+	/* number of hosts in the primary group, 0 if not known */
+	uint32_t	tai_host_nr;
+	/* bytes sent over each hop, the RPC input plus the chained bulk */
+	uint64_t	tai_payload;
+	/* measured point-to-point round trip in us, 0 if none measured yet */
+	uint64_t	tai_hop_us;
+};
+
+/*
+ * Tree selection callback for CRT_TREE_AUTO, called on the root of each
+ * collective before it is forwarded.
+ *
+ * \param[in] in               the collective to choose a tree for
+ * \param[in] arg              argument given to crt_tree_auto_register()
+ *
+ * \return                     a tree topology from crt_tree_topo() of any
+ *                             type but CRT_TREE_AUTO. Invalid values fall
+ *                             back to crt_tree_auto_default().
+ */
+typedef int (*crt_tree_auto_cb_t)(const struct crt_tree_auto_in *in,
+				  void *arg);
+
+/*
+ * Replace the tree selection used for CRT_TREE_AUTO. Can only be called on the
+ * server side.
+ *
+ * \param[in] cb               selection callback, NULL to restore
+ *                             crt_tree_auto_default()
+ * \param[in] arg              argument passed to \a cb
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ */
+int
+crt_tree_auto_register(crt_tree_auto_cb_t cb, void *arg);
+
+/*
+ * The default tree selection of CRT_TREE_AUTO. It estimates the time for the
+ * payload to reach the last rank under FLAT, and under KARY, KNOMIAL and, when
+ * the ranks span several known hosts, HIER of each branch ratio, and returns
+ * the fastest. Exported so that a registered callback can fall back to it.
+ *
+ * \param[in] in               the collective to choose a tree for
+ * \param[in] arg              ignored
+ *
+ * \return                     a tree topology from crt_tree_topo()
+ */
+int
+crt_tree_auto_default(const struct crt_tree_auto_in *in, void *arg);
+
 struct crt_corpc_ops {
 	/**
 	 * collective RPC reply aggregating callback.
@@ -648,6 +835,16 @@ struct crt_corpc_ops {
 	 *				cause CORPC to abort.
 	 */
 	int (*co_pre_forward)(crt_rpc_t *rpc, void *arg);
+
+	/**
+	 * Collective RPC flags, see CRT_CORPC_FLAG_REDUCE. With
+	 * CRT_CORPC_FLAG_REDUCE set CaRT reduces the replies by \a co_reduce
+	 * and \a co_aggregate is not called (it may be NULL).
+	 */
+	uint32_t co_flags;
+
+	/** built-in reduction, used with CRT_CORPC_FLAG_REDUCE */
+	struct crt_corpc_reduce co_reduce;
 };
 
 /**
@@ -805,6 +1002,34 @@ crt_group_config_save(crt_group_t *grp, bool forall);
 int
 crt_group_detach(crt_group_t *attached_grp);
 
+/**
+ * Resolve the addresses of a set of ranks of a group ahead of the first RPC
+ * sent to them. For every (rank, tag) pair the URI is looked up (through PMIx
+ * for the local group, through the PSR for an attached group) and connected
+ * to the HG address of \p crt_ctx, both results go into the address lookup
+ * cache. At most a bounded number of lookups are in flight at a time.
+ *
+ * The call returns once the first lookups are issued. \p complete_cb is called
+ * exactly once after all pairs are resolved or failed, possibly from within
+ * this call. The caller needs to make progress on \p crt_ctx until then, and
+ * must not destroy or detach \p grp before it.
+ *
+ * \param[in] grp              CRT group handle, NULL means the default
+ *                             primary service group
+ * \param[in] crt_ctx          CRT context to connect the addresses for
+ * \param[in] ranks            ranks within \p grp to resolve, NULL for all
+ * \param[in] tags             tags to resolve for every rank, NULL for tag 0
+ * \param[in] tag_nr           number of entries in \p tags
+ * \param[in] complete_cb      completion callback
+ * \param[in] arg              argument passed to \p complete_cb
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ */
+int
+crt_group_warmup(crt_group_t *grp, crt_context_t crt_ctx, d_rank_list_t *ranks,
+		 uint32_t *tags, uint32_t tag_nr, crt_warmup_cb_t complete_cb,
+		 void *arg);
+
 
 /**
  * Convert a primary group rank to a local subgroup rank. Given a primary group
@@ -838,19 +1063,29 @@ crt_group_rank_s2p(crt_group_t *subgrp, d_rank_t rank_in, d_rank_t *rank_out);
  *
  * \param[in] crt_ctx          CRT context
  * \param[in] grp              CRT group for the collective RPC
- * \param[in] excluded_ranks   optional excluded ranks, the RPC will be
+ * \param[in] filter_ranks     optional excluded ranks, the RPC will be
  *                             delivered to all members in the group except
- *                             those in excluded_ranks.
- *                             the ranks in excluded_ranks are numbered in
+ *                             those in filter_ranks. With
+ *                             CRT_RPC_FLAG_INCLUSIVE in flags, the RPC is
+ *                             only delivered to the members in filter_ranks
+ *                             instead, and the cost of the collective is
+ *                             proportional to their number rather than to
+ *                             the group size.
+ *                             the ranks in filter_ranks are numbered in
  *                             primary group.
  * \param[in] opc              unique opcode for the RPC
- * \param[in] co_bulk_hdl      collective bulk handle
+ * \param[in] co_bulk_hdl      collective bulk handle. A bulk larger than
+ *                             ENV CRT_CORPC_SEG_SIZE (default 1MB, 0 to
+ *                             disable) is pipelined down the tree in segments
+ *                             of that size, the RPC handler is still called
+ *                             once the whole bulk arrived on a node.
  * \param[in] priv             A private pointer associated with the request
  *                             will be passed to crt_corpc_ops::co_aggregate as
  *                             2nd parameter.
  * \param[in] flags            collective RPC flags for example taking
  *                             CRT_RPC_FLAG_GRP_DESTROY to destroy the subgroup
- *                             when this bcast RPC successfully finished.
+ *                             when this bcast RPC successfully finished, or
+ *                             CRT_RPC_FLAG_INCLUSIVE for an inclusion list.
  * \param[in] tree_topo        tree topology for the collective propagation,
  *                             can be calculated by crt_tree_topo().
  *                             See \a crt_tree_type,
@@ -861,7 +1096,7 @@ crt_group_rank_s2p(crt_group_t *subgrp, d_rank_t rank_in, d_rank_t *rank_out);
  */
 int
 crt_corpc_req_create(crt_context_t crt_ctx, crt_group_t *grp,
-		     d_rank_list_t *excluded_ranks, crt_opcode_t opc,
+		     d_rank_list_t *filter_ranks, crt_opcode_t opc,
 		     crt_bulk_t co_bulk_hdl, void *priv,  uint32_t flags,
 		     int tree_topo, crt_rpc_t **req);
 
@@ -893,9 +1128,10 @@ crt_corpc_register(crt_opcode_t opc, struct crt_req_format *drf,
 		   crt_rpc_cb_t rpc_handler, struct crt_corpc_ops *co_ops);
 
 /**
- * Start execution of the next available barrier.  If this function
- * returns an error, no internal state is changed. Can only be called on the
- * server side.
+ * Start execution of the next barrier.  If this function returns an error,
+ * no internal state is changed. Can only be called on the server side.
+ * Barriers are numbered in the order they are started on each rank, any
+ * number of them can be in flight and they complete in that order.
  *
  * \param[in] grp              CRT group handle [for future use].   Only the
  *                             primary service group is presently supported
@@ -905,19 +1141,70 @@ crt_corpc_register(crt_opcode_t opc, struct crt_req_format *drf,
  * \param[in] cb_arg           Optional argument passed to completion callback
  *
  * \retval                     DER_SUCCESS on success
- * \retval                     -DER_BUSY if a barrier slot isn't available
- *                             suggesting that prior barriers need to complete
- *                             before trying again.
- *                             Other negative error codes are possible if
- *                             grp doesn't exist or complete_cb is invalid.
+ * \retval                     Negative error codes are possible if grp
+ *                             doesn't exist or complete_cb is invalid.
  *
- * When the rank that is responsible to notify other members of the set of
- * barrier events hits an unrecoverable error (e.g. unable to communicate with
- * any other ranks), the completion callback will be invoked with an error.
+ * The barrier takes ceil(log2(n)) rounds of notifications between the n live
+ * ranks and has no master rank, the barriers in flight restart on rank
+ * eviction. When this rank hits an unrecoverable error (e.g. out of memory),
+ * the completion callback will be invoked with an error.
  */
 int
 crt_barrier(crt_group_t *grp, crt_barrier_cb_t complete_cb, void *cb_arg);
 
+/**
+ * Start an allgather: every live rank of the group contributes a block of
+ * \p send_iov->iov_len bytes and receives the blocks of all live ranks, the
+ * block of rank r at offset r * iov_len of \p recv_iov. The blocks of evicted
+ * ranks are left untouched. Can only be called on the server side, by all
+ * live ranks and in the same order as the other collectives.
+ *
+ * The blocks are exchanged with bulk transfers in ceil(log2(n)) rounds over
+ * the n live ranks. Both buffers must stay valid until \p complete_cb is
+ * called, after which \p recv_iov holds the result on success. The
+ * collectives in flight on some rank when it learns a rank eviction fail
+ * with -DER_MISMATCH on all ranks.
+ *
+ * \param[in] crt_ctx          CRT context to send the notifications from
+ * \param[in] grp              CRT group handle, only the primary service group
+ *                             is supported and NULL means it
+ * \param[in] send_iov         block of this rank
+ * \param[in,out] recv_iov     buffer of at least group size * block length
+ *                             bytes, its iov_len is set to that
+ * \param[in] complete_cb      completion callback
+ * \param[in] cb_arg           argument passed to \p complete_cb
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ */
+int
+crt_allgather(crt_context_t crt_ctx, crt_group_t *grp, d_iov_t *send_iov,
+	      d_iov_t *recv_iov, crt_coll_cb_t complete_cb, void *cb_arg);
+
+/**
+ * Start a personalized all-to-all: \p send_iov holds one block per rank of
+ * the group, block r going to rank r, and the block sent by rank r to this
+ * rank is put at block r of \p recv_iov. Blocks are iov_len / group size bytes
+ * long and the blocks to or from evicted ranks are not exchanged. Same rules
+ * as for crt_allgather() otherwise.
+ *
+ * Each rank pulls the block of every other live rank with a bulk transfer, at
+ * most a bounded number of them are requested at a time.
+ *
+ * \param[in] crt_ctx          CRT context to send the notifications from
+ * \param[in] grp              CRT group handle, only the primary service group
+ *                             is supported and NULL means it
+ * \param[in] send_iov         blocks to send, group size * block length bytes
+ * \param[in,out] recv_iov     buffer of at least as many bytes, its iov_len is
+ *                             set to the length of \p send_iov
+ * \param[in] complete_cb      completion callback
+ * \param[in] cb_arg           argument passed to \p complete_cb
+ *
+ * \return                     DER_SUCCESS on success, negative value if error
+ */
+int
+crt_alltoall(crt_context_t crt_ctx, crt_group_t *grp, d_iov_t *send_iov,
+	     d_iov_t *recv_iov, crt_coll_cb_t complete_cb, void *cb_arg);
+
 /**
  * Query the caller's rank number within group.
  *
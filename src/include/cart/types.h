@@ -82,6 +82,17 @@ typedef struct crt_init_options {
 			 * CRT_CTX_NUM
 			 */
 	int		cio_ctx_max_num;
+	/**
+	 * if cio_prefetch_override is 0, cio_uri_prefetch won't be used.
+	 */
+	uint32_t	cio_prefetch_override:1,
+			/**
+			 * overrides the value of the environment variable
+			 * CRT_URI_PREFETCH, which makes servers fetch the URIs
+			 * of all ranks of the primary group at init time
+			 * instead of looking each up on first use
+			 */
+			cio_uri_prefetch:1;
 } crt_init_options_t;
 
 typedef int		 crt_status_t;
@@ -164,6 +175,11 @@ enum crt_rpc_flags {
 	 * destroy subgroup when the bcast RPC finishes, only valid for corpc
 	 */
 	CRT_RPC_FLAG_GRP_DESTROY	= (1U << 0),
+	/**
+	 * the rank list passed to crt_corpc_req_create() is the ranks to
+	 * deliver to rather than the ones to exclude, only valid for corpc
+	 */
+	CRT_RPC_FLAG_INCLUSIVE		= (1U << 1),
 };
 
 struct crt_rpc;
@@ -343,6 +359,50 @@ typedef enum {
  */
 #define CRT_RPC_FEAT_NO_TIMEOUT		(1U << 2)
 
+/** Element type of a built-in collective RPC reduction */
+enum crt_reduce_type {
+	CRT_REDUCE_INT32,
+	CRT_REDUCE_INT64,
+	CRT_REDUCE_UINT64,
+	CRT_REDUCE_DOUBLE,
+	CRT_REDUCE_TYPE_NR,
+};
+
+/** Element-wise operation of a built-in collective RPC reduction */
+enum crt_reduce_op {
+	CRT_REDUCE_SUM,
+	CRT_REDUCE_MIN,
+	CRT_REDUCE_MAX,
+	/** the bitwise operations are invalid for CRT_REDUCE_DOUBLE */
+	CRT_REDUCE_BAND,
+	CRT_REDUCE_BOR,
+	CRT_REDUCE_BXOR,
+	CRT_REDUCE_OP_NR,
+};
+
+/**
+ * Built-in reduction of the replies of a collective RPC, selected by
+ * \ref CRT_CORPC_FLAG_REDUCE. The reply carries an array in a d_iov_t, the
+ * arrays of all ranks are combined element by element, an empty array is
+ * skipped and the others must have the same length. The other fields of the
+ * reply are left as set by the local RPC handler (or copied from the first
+ * reply when the initiator is excluded).
+ */
+struct crt_corpc_reduce {
+	/** element type, see enum crt_reduce_type */
+	int		cr_type;
+	/** operation, see enum crt_reduce_op */
+	int		cr_op;
+	/** offset of the array's d_iov_t in the reply struct */
+	size_t		cr_offset;
+};
+
+/**
+ * Collective RPC flag, reduce the replies with crt_corpc_ops::co_reduce
+ * instead of calling crt_corpc_ops::co_aggregate.
+ */
+#define CRT_CORPC_FLAG_REDUCE		(1U << 0)
+
 typedef void *crt_bulk_opid_t;
 
 /** Bulk transfer permissions */
@@ -366,6 +426,26 @@ struct crt_bulk_desc {
 	size_t		 bd_len; /**< length of the bulk transferring */
 };
 
+/** abstract registered buffer pool, see crt_buf_pool_create() */
+typedef void *crt_buf_pool_t;
+
+/** back the buffer pool with huge pages when the system has them */
+#define CRT_BUF_POOL_HUGEPAGE	(1U << 0)
+
+/** A buffer of a registered buffer pool, see crt_buf_get() */
+struct crt_buf {
+	void		*cb_buf; /**< start of the buffer */
+	size_t		 cb_len; /**< length asked by crt_buf_get() */
+	size_t		 cb_size; /**< capacity of the buffer */
+	/**
+	 * bulk handle covering the buffer, shared with the other buffers of
+	 * the same size class. Use it together with cb_bulk_off as the local
+	 * side of crt_bulk_transfer(), do not free it.
+	 */
+	crt_bulk_t	 cb_bulk_hdl;
+	off_t		 cb_bulk_off; /**< offset of the buffer in cb_bulk_hdl */
+};
+
 /** Callback info structure */
 struct crt_cb_info {
 	crt_rpc_t		*cci_rpc; /**< rpc struct */
@@ -388,6 +468,29 @@ struct crt_bulk_cb_info {
 	int			bci_rc; /**< return code */
 };
 
+/** Vectored bulk callback info structure, see crt_bulk_transfer_vec() */
+struct crt_bulk_vec_cb_info {
+	/** array of the bulk descriptors passed to crt_bulk_transfer_vec() */
+	struct crt_bulk_desc	*bvci_bulk_descs;
+	/** per-descriptor return codes, bvci_rcs[i] is for descriptor i */
+	int			*bvci_rcs;
+	int			bvci_nr; /**< number of descriptors */
+	void			*bvci_arg; /**< User passed in arg */
+	/** zero if all descriptors succeeded, else the first failure */
+	int			bvci_rc;
+};
+
+/** Per-endpoint RPC statistics of a context, see crt_ep_stats_get() */
+struct crt_ep_stats {
+	uint64_t	eps_req_num; /**< number of requests sent */
+	uint64_t	eps_reply_num; /**< number of replies received */
+	/** replies received through the shared-memory route */
+	uint64_t	eps_sm_reply_num;
+	/** replies received through the fabric */
+	uint64_t	eps_fabric_reply_num;
+	uint64_t	eps_wait_num; /**< requests waiting for credits */
+};
+
 /**
  * completion callback for crt_req_send
  *
@@ -439,12 +542,54 @@ struct crt_barrier_cb_info {
  */
 typedef void (*crt_barrier_cb_t)(struct crt_barrier_cb_info *info);
 
+/** Collective completion info, see crt_allgather() and crt_alltoall() */
+struct crt_coll_cb_info {
+	void		*coci_arg;	/**< optional argument passed by user */
+	int		 coci_rc;	/**< return code of the collective */
+	/** number of live ranks the collective ran over */
+	uint32_t	 coci_rank_nr;
+};
+
+/**
+ * completion callback for crt_allgather() and crt_alltoall()
+ *
+ * \param[in] cb_info	Callback info structure
+ */
+typedef void (*crt_coll_cb_t)(const struct crt_coll_cb_info *cb_info);
+
+struct crt_warmup_cb_info {
+	crt_group_t	*wci_grp;	 /**< group that was warmed up */
+	void		*wci_arg;	 /**< optional argument passed by user */
+	/** return code, first error hit by any of the lookups */
+	int		 wci_rc;
+	/** number of (rank, tag) addresses resolved */
+	uint32_t	 wci_resolved;
+	/** number of (rank, tag) addresses failed to resolve */
+	uint32_t	 wci_failed;
+	/** time from crt_group_warmup() to the last resolution in us */
+	uint64_t	 wci_elapsed_us;
+};
+
+/**
+ * completion callback for crt_group_warmup()
+ *
+ * \param[in] cb_info	Callback info structure
+ */
+typedef void (*crt_warmup_cb_t)(const struct crt_warmup_cb_info *cb_info);
+
 /** completion callback for bulk transferring, i.e. crt_bulk_transfer()
  *
  * \param[in] cb_info	Callback info structure
  */
 typedef int (*crt_bulk_cb_t)(const struct crt_bulk_cb_info *cb_info);
 
+/** completion callback for vectored bulk transferring, i.e.
+ * crt_bulk_transfer_vec(). It is called once after all descriptors completed.
+ *
+ * \param[in] cb_info	Callback info structure
+ */
+typedef int (*crt_bulk_vec_cb_t)(const struct crt_bulk_vec_cb_info *cb_info);
+
 /**
  * Progress condition callback, see \ref crt_progress().
  *
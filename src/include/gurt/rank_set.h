@@ -0,0 +1,250 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* GURT rank set APIs. */
+
+#ifndef __GURT_RANK_SET_H__
+#define __GURT_RANK_SET_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <gurt/common.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * \file
+ *
+ * Rank set
+ *
+ * A compressed set of ranks. The rank space is split into chunks of 65536
+ * ranks sharing the same upper 16 bits, and each non-empty chunk is stored in
+ * whichever container is smallest for its content: a sorted array of the low
+ * 16 bits for sparse chunks, a 65536-bit bitmap for dense ones, or a list of
+ * ranges for runs of consecutive ranks. A group of a million consecutive ranks
+ * thus takes a few hundred bytes instead of the 4MB of a d_rank_list_t.
+ *
+ * Membership, rank to index (the number of smaller ranks in the set) and index
+ * to rank are O(log n) in the number of chunks plus a bounded search within
+ * one chunk. Union, difference and intersection are linear in the size of the
+ * containers, not in the number of ranks.
+ *
+ * A rank set has no internal lock. Concurrent readers are safe, writers need
+ * external serialization.
+ */
+
+/** @addtogroup GURT
+ * @{
+ */
+
+typedef struct d_rank_set d_rank_set_t;
+
+/**
+ * Allocate an empty rank set.
+ *
+ * \return		the new set, NULL if out of memory
+ */
+d_rank_set_t *d_rank_set_alloc(void);
+
+/**
+ * Free a rank set, NULL is allowed.
+ *
+ * \param[in] set	the rank set
+ */
+void d_rank_set_free(d_rank_set_t *set);
+
+/**
+ * Duplicate a rank set.
+ *
+ * \param[out] dst	the new copy, NULL if \a src is NULL
+ * \param[in] src	the rank set to copy
+ *
+ * \return		zero on success, negative value if error
+ */
+int d_rank_set_dup(d_rank_set_t **dst, const d_rank_set_t *src);
+
+/**
+ * Create a rank set from a rank list, which needs not be sorted and may hold
+ * duplicates.
+ *
+ * \param[out] set	the new set, NULL if \a list is NULL
+ * \param[in] list	the rank list
+ *
+ * \return		zero on success, negative value if error
+ */
+int d_rank_set_from_list(d_rank_set_t **set, const d_rank_list_t *list);
+
+/**
+ * Create a sorted rank list holding the ranks of a rank set.
+ *
+ * \param[in] set	the rank set
+ * \param[out] list	the new rank list, NULL if \a set is NULL
+ *
+ * \return		zero on success, negative value if error
+ */
+int d_rank_set_to_list(const d_rank_set_t *set, d_rank_list_t **list);
+
+/**
+ * Add a rank to a rank set, adding a rank already in the set is a no-op.
+ *
+ * \param[in] set	the rank set
+ * \param[in] rank	the rank to add
+ *
+ * \return		zero on success, negative value if error
+ */
+int d_rank_set_add(d_rank_set_t *set, d_rank_t rank);
+
+/**
+ * Add the ranks \a first to \a last inclusive to a rank set.
+ *
+ * \param[in] set	the rank set
+ * \param[in] first	the first rank to add
+ * \param[in] last	the last rank to add
+ *
+ * \return		zero on success, negative value if error
+ */
+int d_rank_set_add_range(d_rank_set_t *set, d_rank_t first, d_rank_t last);
+
+/**
+ * Remove a rank from a rank set, removing a rank not in the set is a no-op.
+ *
+ * \param[in] set	the rank set
+ * \param[in] rank	the rank to remove
+ *
+ * \return		zero on success, negative value if error
+ */
+int d_rank_set_del(d_rank_set_t *set, d_rank_t rank);
+
+/**
+ * Check whether a rank is in a rank set.
+ *
+ * \param[in] set	the rank set, NULL is an empty set
+ * \param[in] rank	the rank to check
+ *
+ * \return		true if \a rank is in \a set
+ */
+bool d_rank_set_has(const d_rank_set_t *set, d_rank_t rank);
+
+/**
+ * Number of ranks in a rank set.
+ *
+ * \param[in] set	the rank set, NULL is an empty set
+ *
+ * \return		the number of ranks
+ */
+uint32_t d_rank_set_nr(const d_rank_set_t *set);
+
+/**
+ * Query the index of a rank within a rank set, i.e. the number of smaller
+ * ranks in the set. This is the index the rank would have in the sorted rank
+ * list of d_rank_set_to_list().
+ *
+ * \param[in] set	the rank set
+ * \param[in] rank	the rank to look up
+ * \param[out] idx	the index of \a rank
+ *
+ * \return		zero on success, -DER_NONEXIST if \a rank is not in
+ *			\a set
+ */
+int d_rank_set_idx(const d_rank_set_t *set, d_rank_t rank, uint32_t *idx);
+
+/**
+ * Query the rank at an index of a rank set, the inverse of d_rank_set_idx().
+ *
+ * \param[in] set	the rank set
+ * \param[in] idx	the index, less than d_rank_set_nr()
+ * \param[out] rank	the rank at \a idx
+ *
+ * \return		zero on success, -DER_NONEXIST if \a idx is out of
+ *			range
+ */
+int d_rank_set_rank(const d_rank_set_t *set, uint32_t idx, d_rank_t *rank);
+
+/**
+ * Add the ranks of \a src to \a dst.
+ *
+ * \param[in,out] dst	the rank set to update
+ * \param[in] src	the ranks to add, NULL is an empty set
+ *
+ * \return		zero on success, negative value if error, in which
+ *			case \a dst is unchanged
+ */
+int d_rank_set_union(d_rank_set_t *dst, const d_rank_set_t *src);
+
+/**
+ * Remove the ranks of \a src from \a dst.
+ *
+ * \param[in,out] dst	the rank set to update
+ * \param[in] src	the ranks to remove, NULL is an empty set
+ *
+ * \return		zero on success, negative value if error, in which
+ *			case \a dst is unchanged
+ */
+int d_rank_set_diff(d_rank_set_t *dst, const d_rank_set_t *src);
+
+/**
+ * Remove the ranks of \a dst that are not in \a src.
+ *
+ * \param[in,out] dst	the rank set to update
+ * \param[in] src	the ranks to keep, NULL is an empty set
+ *
+ * \return		zero on success, negative value if error, in which
+ *			case \a dst is unchanged
+ */
+int d_rank_set_intersect(d_rank_set_t *dst, const d_rank_set_t *src);
+
+/**
+ * Compare whether or not two rank sets hold the same ranks.
+ *
+ * \param[in] set1	the first rank set
+ * \param[in] set2	the second rank set
+ *
+ * \return		true if identical
+ */
+bool d_rank_set_identical(const d_rank_set_t *set1, const d_rank_set_t *set2);
+
+#if defined(__cplusplus)
+}
+#endif
+
+/** @}
+ */
+#endif /* __GURT_RANK_SET_H__ */
@@ -0,0 +1,657 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Micro-benchmarks of CaRT internals: the address lookup cache, the rank
+ * translations of subgroups, and the barrier and collective protocols over a
+ * fake in-process transport. No network is used, the numbers measure the CPU
+ * cost of the data structures and of the protocols.
+ */
+#define D_LOGFAC	DD_FAC(self_test)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "crt_internal.h"
+#include "utest_fake_queue.h"
+
+/* resolved ranks and lookups per thread of the parallel lookup benchmark */
+#define BENCH_LC_RANKS		(10000)
+#define BENCH_LC_LOOKUPS	(1000000)
+#define BENCH_LC_THREADS	(16)
+/* translations timed per subgroup in the p2s benchmark */
+#define BENCH_P2S_LOOKUPS	(1000000)
+/* linear scans timed for comparison, they are O(n) each */
+#define BENCH_P2S_SCANS		(1000)
+/* barriers per group size, and largest group of the barrier benchmark */
+#define BENCH_BARRIERS		(8)
+#define BENCH_BARRIER_RANKS	(4096)
+/* block length and largest group of the collective benchmark */
+#define BENCH_COLL_BLOCK	(4096)
+#define BENCH_COLL_RANKS	(128)
+
+struct bench_lc_thread {
+	struct crt_grp_priv	*bt_grp_priv;
+	pthread_t		 bt_thread;
+	int			 bt_idx;
+	int			 bt_errors;
+};
+
+static void *
+bench_lc_lookup_thread(void *arg)
+{
+	struct bench_lc_thread	*bt = arg;
+	crt_phy_addr_t		 uri;
+	hg_addr_t		 hg_addr;
+	d_rank_t		 rank = bt->bt_idx;
+	int			 i;
+	int			 rc;
+
+	for (i = 0; i < BENCH_LC_LOOKUPS; i++) {
+		/* stride through the resolved ranks */
+		rank = (rank + 7919) % BENCH_LC_RANKS;
+		uri = NULL;
+		hg_addr = NULL;
+		rc = crt_grp_lc_lookup(bt->bt_grp_priv,
+				       bt->bt_idx % CRT_SRV_CONTEXT_NUM,
+				       rank, 0, &uri, &hg_addr);
+		if (rc != 0 || uri == NULL)
+			bt->bt_errors++;
+	}
+
+	return NULL;
+}
+
+/* keep resolving new ranks while the lookup threads run */
+static void *
+bench_lc_insert_thread(void *arg)
+{
+	struct bench_lc_thread	*bt = arg;
+	char			 uri_str[CRT_ADDR_STR_MAX_LEN];
+	d_rank_t		 rank;
+
+	for (rank = BENCH_LC_RANKS; rank < bt->bt_grp_priv->gp_size;
+	     rank++) {
+		snprintf(uri_str, sizeof(uri_str), "tcp://host%d:31416", rank);
+		if (crt_grp_lc_uri_insert(bt->bt_grp_priv, 0, rank, 0,
+					  uri_str) != 0)
+			bt->bt_errors++;
+	}
+
+	return NULL;
+}
+
+/* lookups per second of the address cache, with 1 to 16 threads */
+static int
+bench_lc_lookup(void)
+{
+	struct crt_grp_priv	grp_priv;
+	struct bench_lc_thread	threads[BENCH_LC_THREADS];
+	struct bench_lc_thread	writer;
+	char			uri_str[CRT_ADDR_STR_MAX_LEN];
+	struct timespec		start;
+	struct timespec		end;
+	double			secs;
+	d_rank_t		rank;
+	int			nr_threads;
+	int			errors = 0;
+	int			i;
+	int			rc;
+
+	memset(&grp_priv, 0, sizeof(grp_priv));
+	grp_priv.gp_primary = 1;
+	grp_priv.gp_size = 2 * BENCH_LC_RANKS;
+	D_INIT_LIST_HEAD(&grp_priv.gp_lc_items);
+	rc = D_RWLOCK_INIT(&grp_priv.gp_rwlock, NULL);
+	if (rc != 0)
+		return rc;
+
+	for (rank = 0; rank < BENCH_LC_RANKS; rank++) {
+		snprintf(uri_str, sizeof(uri_str), "tcp://host%d:31416", rank);
+		rc = crt_grp_lc_uri_insert(&grp_priv, 0, rank, 0, uri_str);
+		if (rc != 0)
+			D_GOTO(out, rc);
+	}
+
+	printf("lookup cache, %d resolved ranks:\n", BENCH_LC_RANKS);
+	for (nr_threads = 1; nr_threads <= BENCH_LC_THREADS;
+	     nr_threads *= 4) {
+		memset(&writer, 0, sizeof(writer));
+		writer.bt_grp_priv = &grp_priv;
+		/* inserts race with the lookups on the last round */
+		if (nr_threads == BENCH_LC_THREADS) {
+			rc = pthread_create(&writer.bt_thread, NULL,
+					    bench_lc_insert_thread, &writer);
+			if (rc != 0)
+				D_GOTO(out, rc = -DER_MISC);
+		}
+
+		d_gettime(&start);
+		for (i = 0; i < nr_threads; i++) {
+			memset(&threads[i], 0, sizeof(threads[i]));
+			threads[i].bt_grp_priv = &grp_priv;
+			threads[i].bt_idx = i;
+			rc = pthread_create(&threads[i].bt_thread, NULL,
+					    bench_lc_lookup_thread,
+					    &threads[i]);
+			D_ASSERT(rc == 0);
+		}
+		for (i = 0; i < nr_threads; i++) {
+			pthread_join(threads[i].bt_thread, NULL);
+			errors += threads[i].bt_errors;
+		}
+		d_gettime(&end);
+
+		if (nr_threads == BENCH_LC_THREADS) {
+			pthread_join(writer.bt_thread, NULL);
+			errors += writer.bt_errors;
+		}
+
+		secs = d_timediff_ns(&start, &end) / 1e9;
+		printf("  %2d threads: %.2f M lookups/s\n", nr_threads,
+		       (double)nr_threads * BENCH_LC_LOOKUPS / secs / 1e6);
+	}
+	if (errors != 0) {
+		D_ERROR("%d lookups or inserts failed.\n", errors);
+		rc = -DER_MISC;
+	}
+
+out:
+	crt_grp_lc_destroy(&grp_priv);
+	D_RWLOCK_DESTROY(&grp_priv.gp_rwlock);
+	return rc;
+}
+
+static int
+bench_p2s_size(uint32_t nr, uint32_t stride)
+{
+	struct crt_grp_priv	grp_priv;
+	struct timespec		start;
+	struct timespec		end;
+	double			secs;
+	d_rank_t		rank;
+	uint32_t		idx;
+	uint32_t		i;
+	int			errors = 0;
+	int			rc;
+
+	memset(&grp_priv, 0, sizeof(grp_priv));
+	grp_priv.gp_membs = d_rank_list_alloc(nr);
+	if (grp_priv.gp_membs == NULL)
+		return -DER_NOMEM;
+	for (i = 0; i < nr; i++)
+		grp_priv.gp_membs->rl_ranks[i] = 3 + i * stride;
+	grp_priv.gp_size = nr;
+	rc = crt_grp_membs_idx_init(&grp_priv);
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	d_gettime(&start);
+	for (i = 0; i < BENCH_P2S_LOOKUPS; i++) {
+		idx = (i * 7919) % nr;
+		if (crt_grp_rank_p2s(&grp_priv, 3 + idx * stride, &rank) != 0 ||
+		    rank != idx)
+			errors++;
+	}
+	d_gettime(&end);
+	secs = d_timediff_ns(&start, &end) / 1e9;
+	printf("  subgroup of %7u, stride %3u: %s %.2f M/s", nr, stride,
+	       grp_priv.gp_membs_idx != NULL ? "index " : "search",
+	       BENCH_P2S_LOOKUPS / secs / 1e6);
+
+	d_gettime(&start);
+	for (i = 0; i < BENCH_P2S_SCANS; i++) {
+		idx = (i * 7919) % nr;
+		if (d_idx_in_rank_list(grp_priv.gp_membs, 3 + idx * stride,
+				       &rank) != 0 || rank != idx)
+			errors++;
+	}
+	d_gettime(&end);
+	secs = d_timediff_ns(&start, &end) / 1e9;
+	printf(", linear scan %.4f M/s\n", BENCH_P2S_SCANS / secs / 1e6);
+
+	crt_grp_membs_idx_fini(&grp_priv);
+	if (errors != 0) {
+		D_ERROR("%d translations failed.\n", errors);
+		rc = -DER_MISC;
+	}
+out:
+	d_rank_list_free(grp_priv.gp_membs);
+	return rc;
+}
+
+/* primary to subgroup rank translations per second */
+static int
+bench_p2s(void)
+{
+	uint32_t	sizes[][2] = {{1000, 1}, {100000, 2}, {100000, 100},
+				      {1000000, 1}, {1000000, 3}};
+	int		i;
+	int		rc = 0;
+
+	printf("rank translation:\n");
+	for (i = 0; i < ARRAY_SIZE(sizes) && rc == 0; i++)
+		rc = bench_p2s_size(sizes[i][0], sizes[i][1]);
+
+	return rc;
+}
+
+static d_rank_list_t *
+bench_rank_list(uint32_t size)
+{
+	d_rank_list_t	*ranks;
+	d_rank_t	 rank;
+
+	ranks = d_rank_list_alloc(size);
+	if (ranks == NULL)
+		return NULL;
+	for (rank = 0; rank < size; rank++)
+		ranks->rl_ranks[rank] = rank;
+
+	return ranks;
+}
+
+/* fake in-process transport, notifications are delivered in FIFO order */
+static struct {
+	struct crt_grp_priv		*bb_grps;
+	/* of struct crt_barrier_msg pointers */
+	struct fake_queue		 bb_queue;
+	uint64_t			 bb_sent;
+	uint64_t			 bb_exited;
+} bench_barrier;
+
+static int
+bench_barrier_send(struct crt_barrier_msg *msg)
+{
+	struct crt_barrier_msg	**ev;
+
+	ev = fake_queue_add(&bench_barrier.bb_queue);
+	if (ev == NULL)
+		return -DER_NOMEM;
+	*ev = msg;
+	bench_barrier.bb_sent++;
+
+	return 0;
+}
+
+static void
+bench_barrier_cb(struct crt_barrier_cb_info *cb_info)
+{
+	if (cb_info->bci_rc != 0)
+		D_ERROR("barrier failed, rc: %d\n", cb_info->bci_rc);
+	else
+		bench_barrier.bb_exited++;
+}
+
+/* latency of one dissemination barrier, up to 4096 ranks */
+static int
+bench_barrier_run(void)
+{
+	struct crt_barrier_msg		*msg;
+	struct crt_grp_priv		*grp_priv;
+	struct crt_barrier_info		*info;
+	struct crt_barrier_out		 out;
+	struct timespec			 start;
+	struct timespec			 end;
+	d_rank_list_t			*live;
+	uint64_t			 nsecs;
+	uint32_t			 size;
+	d_rank_t			 rank;
+	int				 i;
+	int				 rc = 0;
+
+	printf("barrier:\n");
+	for (size = 4; size <= BENCH_BARRIER_RANKS && rc == 0; size *= 4) {
+		memset(&bench_barrier, 0, sizeof(bench_barrier));
+		fake_queue_init(&bench_barrier.bb_queue,
+				sizeof(struct crt_barrier_msg *));
+		D_ALLOC_ARRAY(bench_barrier.bb_grps, size);
+		if (bench_barrier.bb_grps == NULL)
+			return -DER_NOMEM;
+		for (rank = 0; rank < size; rank++) {
+			grp_priv = &bench_barrier.bb_grps[rank];
+			grp_priv->gp_primary = 1;
+			grp_priv->gp_self = rank;
+			rc = crt_barrier_info_init(grp_priv);
+			D_ASSERT(rc == 0);
+			info = &grp_priv->gp_barrier_info;
+			info->bi_send = bench_barrier_send;
+			live = bench_rank_list(size);
+			D_ASSERT(live != NULL);
+			crt_barrier_set_live(info, live, rank, 1);
+		}
+
+		d_gettime(&start);
+		for (i = 0; i < BENCH_BARRIERS && rc == 0; i++) {
+			for (rank = 0; rank < size && rc == 0; rank++)
+				rc = crt_barrier_enter(
+					&bench_barrier.bb_grps[rank]
+					.gp_barrier_info, bench_barrier_cb,
+					NULL);
+			while (fake_queue_len(&bench_barrier.bb_queue) > 0) {
+				fake_queue_take(&bench_barrier.bb_queue, false,
+						&msg);
+				crt_barrier_recv(&bench_barrier.bb_grps[
+						 msg->bm_rank].gp_barrier_info,
+						 &msg->bm_in, &out);
+				crt_barrier_sent(msg, 0, &out);
+			}
+		}
+		d_gettime(&end);
+		if (rc == 0 &&
+		    bench_barrier.bb_exited != size * BENCH_BARRIERS) {
+			D_ERROR("only "DF_U64" barriers completed.\n",
+				bench_barrier.bb_exited);
+			rc = -DER_MISC;
+		}
+
+		nsecs = d_timediff_ns(&start, &end) / BENCH_BARRIERS;
+		printf("  %5u ranks: %2u rounds, "DF_U64" notifications, "
+		       "%.1f us per barrier (%.0f ns per rank)\n", size,
+		       bench_barrier.bb_grps[0].gp_barrier_info.bi_rounds,
+		       bench_barrier.bb_sent / BENCH_BARRIERS, nsecs / 1e3,
+		       (double)nsecs / size);
+
+		for (rank = 0; rank < size; rank++)
+			crt_barrier_info_destroy(&bench_barrier.bb_grps[rank]);
+		D_FREE(bench_barrier.bb_grps);
+		fake_queue_fini(&bench_barrier.bb_queue);
+	}
+
+	return rc;
+}
+
+/* an event of the fake collective transport */
+struct bench_coll_ev {
+	enum {
+		BC_EV_SEND,
+		BC_EV_PULL,
+		BC_EV_REPLY,
+	}			 ce_type;
+	struct crt_coll		*ce_src;
+	d_rank_t		 ce_dst;
+	struct crt_coll_in	 ce_in;
+	struct crt_coll_msg	*ce_msg;
+	uint32_t		 ce_seg;
+	int			 ce_rc;
+};
+
+/* fake in-process transport, events are handled in FIFO order */
+static struct {
+	struct crt_grp_priv	*bc_grps;
+	/* of struct bench_coll_ev */
+	struct fake_queue	 bc_queue;
+	uint64_t		 bc_sent;
+	uint64_t		 bc_pulled_bytes;
+	uint32_t		 bc_done;
+	int			 bc_rc;
+} bench_coll;
+
+static struct bench_coll_ev *
+bench_coll_ev_add(int type)
+{
+	struct bench_coll_ev	*ev;
+
+	ev = fake_queue_add(&bench_coll.bc_queue);
+	if (ev == NULL)
+		return NULL;
+	ev->ce_type = type;
+
+	return ev;
+}
+
+/* the fake bulk handle is the address of the buffer */
+static int
+bench_coll_bulk_create(struct crt_coll *coll, void *buf, uint64_t len,
+		       crt_bulk_t *bulk)
+{
+	*bulk = buf;
+	return 0;
+}
+
+static void
+bench_coll_bulk_free(crt_bulk_t bulk)
+{
+}
+
+static int
+bench_coll_send(struct crt_coll *coll, d_rank_t rank, struct crt_coll_in *in)
+{
+	struct bench_coll_ev	*ev = bench_coll_ev_add(BC_EV_SEND);
+
+	if (ev == NULL)
+		return -DER_NOMEM;
+	ev->ce_src = coll;
+	ev->ce_dst = rank;
+	ev->ce_in = *in;
+	bench_coll.bc_sent++;
+
+	return 0;
+}
+
+static int
+bench_coll_pull(struct crt_coll_msg *msg, uint32_t seg)
+{
+	struct bench_coll_ev	*ev = bench_coll_ev_add(BC_EV_PULL);
+
+	if (ev == NULL)
+		return -DER_NOMEM;
+	ev->ce_msg = msg;
+	ev->ce_seg = seg;
+
+	return 0;
+}
+
+static void
+bench_coll_reply(struct crt_coll_msg *msg, int rc)
+{
+	struct bench_coll_ev	*ev = bench_coll_ev_add(BC_EV_REPLY);
+
+	D_ASSERT(ev != NULL);
+	ev->ce_src = msg->cm_handle;
+	ev->ce_in = msg->cm_in;
+	ev->ce_rc = rc;
+	D_FREE_PTR(msg);
+}
+
+static struct crt_coll_transport bench_coll_transport = {
+	.ct_bulk_create	= bench_coll_bulk_create,
+	.ct_bulk_free	= bench_coll_bulk_free,
+	.ct_send	= bench_coll_send,
+	.ct_pull	= bench_coll_pull,
+	.ct_reply	= bench_coll_reply,
+};
+
+static void
+bench_coll_deliver(void)
+{
+	struct bench_coll_ev	 ev;
+	struct crt_coll_msg	*msg;
+	struct crt_coll		*coll;
+	char			*local;
+
+	fake_queue_take(&bench_coll.bc_queue, false, &ev);
+	switch (ev.ce_type) {
+	case BC_EV_SEND:
+		D_ALLOC_PTR(msg);
+		D_ASSERT(msg != NULL);
+		msg->cm_handle = ev.ce_src;
+		msg->cm_in = ev.ce_in;
+		crt_coll_recv(&bench_coll.bc_grps[ev.ce_dst].gp_coll_info,
+			      msg);
+		break;
+	case BC_EV_PULL:
+		msg = ev.ce_msg;
+		coll = msg->cm_coll;
+		local = coll->cl_type == CRT_COLL_ALLGATHER ?
+			coll->cl_bulk : coll->cl_recv_bulk;
+		memcpy(local + msg->cm_segs[ev.ce_seg].off,
+		       (char *)msg->cm_in.c_bulk +
+		       msg->cm_segs[ev.ce_seg].remote_off,
+		       msg->cm_segs[ev.ce_seg].len);
+		bench_coll.bc_pulled_bytes += msg->cm_segs[ev.ce_seg].len;
+		crt_coll_pulled(msg, 0);
+		break;
+	case BC_EV_REPLY:
+		if (ev.ce_src != NULL)
+			crt_coll_sent(ev.ce_src, &ev.ce_in, ev.ce_rc);
+		break;
+	}
+}
+
+static void
+bench_coll_cb(const struct crt_coll_cb_info *cb_info)
+{
+	bench_coll.bc_done++;
+	if (cb_info->coci_rc != 0 && bench_coll.bc_rc == 0)
+		bench_coll.bc_rc = cb_info->coci_rc;
+}
+
+/* cost of the protocol and of the copies of one collective */
+static int
+bench_coll_size(uint32_t size, enum crt_coll_type type)
+{
+	struct crt_coll_info	*info;
+	struct timespec		 start;
+	struct timespec		 end;
+	d_iov_t			 send_iov;
+	d_iov_t			 recv_iov;
+	uint64_t		 nsecs;
+	char			*send;
+	char			*recv;
+	d_rank_t		 rank;
+	int			 rc = 0;
+
+	memset(&bench_coll, 0, sizeof(bench_coll));
+	fake_queue_init(&bench_coll.bc_queue, sizeof(struct bench_coll_ev));
+	D_ALLOC_ARRAY(bench_coll.bc_grps, size);
+	D_ALLOC(send, (size_t)size * size * BENCH_COLL_BLOCK);
+	D_ALLOC(recv, (size_t)size * size * BENCH_COLL_BLOCK);
+	if (bench_coll.bc_grps == NULL || send == NULL || recv == NULL)
+		D_GOTO(out, rc = -DER_NOMEM);
+
+	for (rank = 0; rank < size; rank++) {
+		rc = crt_coll_info_init(&bench_coll.bc_grps[rank]);
+		D_ASSERT(rc == 0);
+		bench_coll.bc_grps[rank].gp_coll_info.ci_transport =
+			&bench_coll_transport;
+	}
+
+	d_gettime(&start);
+	for (rank = 0; rank < size && rc == 0; rank++) {
+		info = &bench_coll.bc_grps[rank].gp_coll_info;
+		d_iov_set(&send_iov, send + (size_t)rank * size *
+			  BENCH_COLL_BLOCK, type == CRT_COLL_ALLGATHER ?
+			  BENCH_COLL_BLOCK : size * BENCH_COLL_BLOCK);
+		d_iov_set(&recv_iov, recv + (size_t)rank * size *
+			  BENCH_COLL_BLOCK, size * BENCH_COLL_BLOCK);
+		rc = crt_coll_start(info, NULL, type, bench_rank_list(size),
+				    rank, 1, size, &send_iov, &recv_iov,
+				    BENCH_COLL_BLOCK, bench_coll_cb, NULL);
+	}
+	while (fake_queue_len(&bench_coll.bc_queue) > 0)
+		bench_coll_deliver();
+	d_gettime(&end);
+	if (rc == 0)
+		rc = bench_coll.bc_rc;
+	if (rc == 0 && bench_coll.bc_done != size) {
+		D_ERROR("only %u collectives completed.\n", bench_coll.bc_done);
+		rc = -DER_MISC;
+	}
+
+	nsecs = d_timediff_ns(&start, &end);
+	printf("  %-10s %4u ranks x %u bytes: "DF_U64" notifications, "
+	       "%.1f us, %.1f MB/s per rank\n",
+	       type == CRT_COLL_ALLGATHER ? "allgather" : "all-to-all", size,
+	       BENCH_COLL_BLOCK, bench_coll.bc_sent, nsecs / 1e3,
+	       (double)bench_coll.bc_pulled_bytes / size / nsecs * 1e3);
+
+	for (rank = 0; rank < size; rank++)
+		crt_coll_info_destroy(&bench_coll.bc_grps[rank]);
+out:
+	D_FREE(bench_coll.bc_grps);
+	fake_queue_fini(&bench_coll.bc_queue);
+	D_FREE(send);
+	D_FREE(recv);
+	return rc;
+}
+
+/* allgather and all-to-all, up to 128 ranks */
+static int
+bench_coll_run(void)
+{
+	uint32_t	size;
+	int		rc = 0;
+
+	printf("collectives:\n");
+	for (size = 16; size <= BENCH_COLL_RANKS && rc == 0; size *= 2) {
+		rc = bench_coll_size(size, CRT_COLL_ALLGATHER);
+		if (rc == 0)
+			rc = bench_coll_size(size, CRT_COLL_ALLTOALL);
+	}
+
+	return rc;
+}
+
+int
+main(int argc, char **argv)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0) {
+		fprintf(stderr, "d_log_init() failed. rc: %d\n", rc);
+		return rc;
+	}
+	rc = crt_setup_log_fac();
+	if (rc != 0)
+		D_GOTO(out, rc);
+
+	rc = bench_lc_lookup();
+	if (rc == 0)
+		rc = bench_p2s();
+	if (rc == 0)
+		rc = bench_barrier_run();
+	if (rc == 0)
+		rc = bench_coll_run();
+	if (rc != 0)
+		fprintf(stderr, "benchmark failed, rc: %d\n", rc);
+
+out:
+	d_log_fini();
+	return rc;
+}
@@ -980,6 +980,400 @@ cleanup_nothread:
 	return ret;
 }
 
+/* trees timed by --tree-sweep, the branch ratio is ignored by FLAT and AUTO */
+static const struct {
+	enum crt_tree_type	type;
+	uint32_t		ratio;
+} st_sweep_trees[] = {
+	{ CRT_TREE_FLAT, 0 },
+	{ CRT_TREE_KARY, 2 },
+	{ CRT_TREE_KARY, 4 },
+	{ CRT_TREE_KARY, 8 },
+	{ CRT_TREE_KARY, 16 },
+	{ CRT_TREE_KNOMIAL, 2 },
+	{ CRT_TREE_KNOMIAL, 4 },
+	{ CRT_TREE_KNOMIAL, 8 },
+	{ CRT_TREE_KNOMIAL, 16 },
+	{ CRT_TREE_HIER, 4 },
+	{ CRT_TREE_AUTO, 0 },
+};
+
+static const char * const st_tree_type_str[] = { "INVALID",
+						 "FLAT",
+						 "KARY",
+						 "KNOMIAL",
+						 "HIER",
+						 "AUTO" };
+
+static void st_tree_str(uint32_t tree_topo, char *buf, size_t len)
+{
+	uint32_t type = tree_topo >> CRT_TREE_TYPE_SHIFT;
+	uint32_t ratio = tree_topo & ((1U << CRT_TREE_TYPE_SHIFT) - 1);
+
+	if (type >= ARRAY_SIZE(st_tree_type_str))
+		type = CRT_TREE_INVALID;
+	if (type == CRT_TREE_FLAT || type == CRT_TREE_AUTO ||
+	    type == CRT_TREE_INVALID)
+		snprintf(buf, len, "%s", st_tree_type_str[type]);
+	else
+		snprintf(buf, len, "%s %u", st_tree_type_str[type], ratio);
+}
+
+static void
+tree_sweep_cb(const struct crt_cb_info *cb_info)
+{
+	/* Result returned to main thread */
+	struct crt_st_tree_sweep_out *return_status = cb_info->cci_arg;
+
+	/* Status retrieved from the RPC result payload */
+	struct crt_st_tree_sweep_out *reply_status;
+
+	/* Check the status of the RPC transport itself */
+	if (cb_info->cci_rc != 0) {
+		return_status->status = cb_info->cci_rc;
+		return;
+	}
+
+	reply_status = crt_reply_get(cb_info->cci_rpc);
+	D_ASSERT(reply_status != NULL);
+
+	/* status last, the main thread polls on it */
+	return_status->test_duration_ns = reply_status->test_duration_ns;
+	return_status->tree_topo = reply_status->tree_topo;
+	return_status->status = reply_status->status;
+}
+
+/*
+ * Time rep_count broadcasts over grp_size ranks with one tree on the master
+ * endpoint. Returns the average in ns through *avg_ns.
+ */
+static int tree_sweep_one(crt_context_t crt_ctx, crt_endpoint_t *ms_endpt,
+			  uint32_t grp_size, int tree_topo, uint32_t payload,
+			  int rep_count, double *avg_ns, uint32_t *tree_used)
+{
+	struct crt_st_tree_sweep_in	*args;
+	struct crt_st_tree_sweep_out	 reply = { 0 };
+	crt_rpc_t			*new_rpc;
+	int				 ret;
+
+	ret = crt_req_create(crt_ctx, ms_endpt, CRT_OPC_SELF_TEST_TREE_SWEEP,
+			     &new_rpc);
+	if (ret != 0) {
+		D_ERROR("Creating tree sweep RPC failed to endpoint %u:%u;"
+			" ret = %d\n", ms_endpt->ep_rank, ms_endpt->ep_tag,
+			ret);
+		return ret;
+	}
+
+	args = crt_req_get(new_rpc);
+	D_ASSERTF(args != NULL, "crt_req_get returned NULL\n");
+	args->grp_size = grp_size;
+	args->tree_topo = tree_topo;
+	args->payload = payload;
+	args->rep_count = rep_count;
+
+	/* Set the status to a known impossible value */
+	reply.status = INT32_MAX;
+
+	ret = crt_req_send(new_rpc, tree_sweep_cb, &reply);
+	if (ret != 0) {
+		D_ERROR("Failed to send tree sweep RPC to endpoint %u:%u;"
+			" ret = %d\n", ms_endpt->ep_rank, ms_endpt->ep_tag,
+			ret);
+		return ret;
+	}
+
+	while (reply.status == INT32_MAX)
+		sched_yield();
+
+	if (reply.status != 0) {
+		D_ERROR("Tree sweep failed on endpoint %u:%u; ret = %d\n",
+			ms_endpt->ep_rank, ms_endpt->ep_tag, reply.status);
+		return reply.status;
+	}
+
+	*avg_ns = (double)reply.test_duration_ns / rep_count;
+	*tree_used = reply.tree_topo;
+	return 0;
+}
+
+/*
+ * Time collective broadcasts from the master endpoint over each tree of
+ * st_sweep_trees, for 2, 4, 8... up to all ranks of the group and for each
+ * payload size, and compare what CRT_TREE_AUTO chose against the fastest.
+ */
+static int run_tree_sweep(struct st_size_params all_params[],
+			  int num_msg_sizes, int rep_count, char *dest_name,
+			  struct st_endpoint *ms_endpt_in,
+			  char *attach_info_path)
+{
+	crt_context_t		 crt_ctx;
+	crt_group_t		*srv_grp = NULL;
+	pthread_t		 tid;
+	crt_endpoint_t		 ms_endpt;
+	uint32_t		 grp_size, sweep_size;
+	double			 avg_ns, best_ns, auto_ns;
+	uint32_t		 tree_used, best_idx, auto_topo;
+	char			 tree_str[32];
+	int			 size_idx;
+	uint32_t		 i;
+	int			 ret;
+	int			 cleanup_ret;
+
+	ret = self_test_init(dest_name, &crt_ctx, &srv_grp, &tid,
+			     attach_info_path, false /* run as server */);
+	if (ret != 0) {
+		D_ERROR("self_test_init failed; ret = %d\n", ret);
+		D_GOTO(cleanup_nothread, ret);
+	}
+
+	ret = crt_group_size(srv_grp, &grp_size);
+	if (ret != 0) {
+		D_ERROR("crt_group_size failed; ret = %d\n", ret);
+		D_GOTO(cleanup, ret);
+	}
+
+	ms_endpt.ep_grp = srv_grp;
+	ms_endpt.ep_rank = ms_endpt_in->rank;
+	ms_endpt.ep_tag = ms_endpt_in->tag;
+
+	sweep_size = grp_size < 2 ? grp_size : 2;
+	while (1) {
+		for (size_idx = 0; size_idx < num_msg_sizes; size_idx++) {
+			uint32_t payload = all_params[size_idx].send_size;
+
+			printf("Tree sweep from %u:%u over %u ranks,"
+			       " payload %u bytes:\n", ms_endpt.ep_rank,
+			       ms_endpt.ep_tag, sweep_size, payload);
+
+			best_ns = 0;
+			best_idx = 0;
+			auto_ns = 0;
+			auto_topo = 0;
+			for (i = 0; i < ARRAY_SIZE(st_sweep_trees); i++) {
+				ret = tree_sweep_one(crt_ctx, &ms_endpt,
+					sweep_size,
+					crt_tree_topo(st_sweep_trees[i].type,
+						      st_sweep_trees[i].ratio),
+					payload, rep_count, &avg_ns,
+					&tree_used);
+				if (ret != 0)
+					D_GOTO(cleanup, ret);
+
+				st_tree_str(tree_used, tree_str,
+					    sizeof(tree_str));
+				if (st_sweep_trees[i].type == CRT_TREE_AUTO) {
+					auto_ns = avg_ns;
+					auto_topo = tree_used;
+					printf("  %-12s %12.1f us (AUTO)\n",
+					       tree_str, avg_ns / 1000);
+					continue;
+				}
+				printf("  %-12s %12.1f us\n", tree_str,
+				       avg_ns / 1000);
+				if (i == 0 || avg_ns < best_ns) {
+					best_ns = avg_ns;
+					best_idx = i;
+				}
+			}
+
+			st_tree_str(crt_tree_topo(st_sweep_trees[best_idx].type,
+						  st_sweep_trees[best_idx].ratio),
+				    tree_str, sizeof(tree_str));
+			printf("  Fastest: %s, %.1f us\n", tree_str,
+			       best_ns / 1000);
+			st_tree_str(auto_topo, tree_str, sizeof(tree_str));
+			printf("  AUTO chose %s, %.1f us, %.2fx the fastest\n\n",
+			       tree_str, auto_ns / 1000,
+			       best_ns > 0 ? auto_ns / best_ns : 1.0);
+		}
+
+		if (sweep_size >= grp_size)
+			break;
+		sweep_size = sweep_size * 2 > grp_size ? grp_size :
+			     sweep_size * 2;
+	}
+
+cleanup:
+	/* Tell the progress thread to abort and exit */
+	g_shutdown_flag = 1;
+
+	cleanup_ret = pthread_join(tid, NULL);
+	if (cleanup_ret)
+		D_ERROR("Could not join progress thread");
+
+cleanup_nothread:
+	if (srv_grp != NULL) {
+		cleanup_ret = crt_group_detach(srv_grp);
+		if (cleanup_ret != 0)
+			D_ERROR("crt_group_detach failed; ret = %d\n",
+				cleanup_ret);
+		/* Make sure first error is returned, if applicable */
+		ret = ((ret == 0) ? cleanup_ret : ret);
+	}
+
+	cleanup_ret = crt_context_destroy(crt_ctx, 0);
+	if (cleanup_ret != 0)
+		D_ERROR("crt_context_destroy failed; ret = %d\n", cleanup_ret);
+	/* Make sure first error is returned, if applicable */
+	ret = ((ret == 0) ? cleanup_ret : ret);
+
+	cleanup_ret = crt_finalize();
+	if (cleanup_ret != 0)
+		D_ERROR("crt_finalize failed; ret = %d\n", cleanup_ret);
+	/* Make sure first error is returned, if applicable */
+	ret = ((ret == 0) ? cleanup_ret : ret);
+	return ret;
+}
+
+static void
+coll_test_cb(const struct crt_cb_info *cb_info)
+{
+	/* Result returned to main thread */
+	struct crt_st_coll_out *return_status = cb_info->cci_arg;
+
+	/* Status retrieved from the RPC result payload */
+	struct crt_st_coll_out *reply_status;
+
+	/* Check the status of the RPC transport itself */
+	if (cb_info->cci_rc != 0) {
+		return_status->status = cb_info->cci_rc;
+		return;
+	}
+
+	reply_status = crt_reply_get(cb_info->cci_rpc);
+	D_ASSERT(reply_status != NULL);
+
+	/* status last, the main thread polls on it */
+	return_status->test_duration_ns = reply_status->test_duration_ns;
+	return_status->grp_size = reply_status->grp_size;
+	return_status->status = reply_status->status;
+}
+
+/*
+ * Make the master endpoint run rep_count allgathers or all-to-alls over all
+ * ranks of the group, for the send size of each --message-sizes tuple as the
+ * block size, and print the time per collective and the throughput per rank.
+ */
+static int run_coll_test(struct st_size_params all_params[],
+			 int num_msg_sizes, int rep_count, char *dest_name,
+			 struct st_endpoint *ms_endpt_in,
+			 enum crt_st_coll_type coll_type, int output_megabits,
+			 char *attach_info_path)
+{
+	struct crt_st_coll_in	*args;
+	struct crt_st_coll_out	 reply;
+	crt_context_t		 crt_ctx;
+	crt_group_t		*srv_grp = NULL;
+	pthread_t		 tid;
+	crt_endpoint_t		 ms_endpt;
+	crt_rpc_t		*new_rpc;
+	double			 avg_ns, bytes, rate;
+	uint32_t		 block_size;
+	int			 size_idx;
+	int			 ret;
+	int			 cleanup_ret;
+
+	ret = self_test_init(dest_name, &crt_ctx, &srv_grp, &tid,
+			     attach_info_path, false /* run as server */);
+	if (ret != 0) {
+		D_ERROR("self_test_init failed; ret = %d\n", ret);
+		D_GOTO(cleanup_nothread, ret);
+	}
+
+	ms_endpt.ep_grp = srv_grp;
+	ms_endpt.ep_rank = ms_endpt_in->rank;
+	ms_endpt.ep_tag = ms_endpt_in->tag;
+
+	for (size_idx = 0; size_idx < num_msg_sizes; size_idx++) {
+		block_size = all_params[size_idx].send_size;
+		if (block_size == 0)
+			continue;
+
+		ret = crt_req_create(crt_ctx, &ms_endpt,
+				     CRT_OPC_SELF_TEST_COLL_SWEEP, &new_rpc);
+		if (ret != 0) {
+			D_ERROR("Creating collective test RPC failed to"
+				" endpoint %u:%u; ret = %d\n",
+				ms_endpt.ep_rank, ms_endpt.ep_tag, ret);
+			D_GOTO(cleanup, ret);
+		}
+
+		args = crt_req_get(new_rpc);
+		D_ASSERTF(args != NULL, "crt_req_get returned NULL\n");
+		args->coll_type = coll_type;
+		args->block_size = block_size;
+		args->rep_count = rep_count;
+
+		/* Set the status to a known impossible value */
+		reply.status = INT32_MAX;
+
+		ret = crt_req_send(new_rpc, coll_test_cb, &reply);
+		if (ret != 0) {
+			D_ERROR("Failed to send collective test RPC to"
+				" endpoint %u:%u; ret = %d\n",
+				ms_endpt.ep_rank, ms_endpt.ep_tag, ret);
+			D_GOTO(cleanup, ret);
+		}
+
+		while (reply.status == INT32_MAX)
+			sched_yield();
+
+		if (reply.status != 0) {
+			D_ERROR("Collective test failed on endpoint %u:%u;"
+				" ret = %d\n", ms_endpt.ep_rank,
+				ms_endpt.ep_tag, reply.status);
+			D_GOTO(cleanup, ret = reply.status);
+		}
+
+		/* each rank receives a block from each other rank */
+		avg_ns = (double)reply.test_duration_ns / rep_count;
+		bytes = (double)block_size * (reply.grp_size - 1);
+		if (output_megabits)
+			rate = bytes * 8 * 1e9 / avg_ns / 1000000;
+		else
+			rate = bytes * 1e9 / avg_ns / (1024 * 1024);
+
+		printf("%s over %u ranks, %u bytes per block:\n"
+		       "  %.1f us per collective, %.2f %s per rank\n\n",
+		       coll_type == CRT_ST_COLL_ALLGATHER ? "Allgather" :
+							    "All-to-all",
+		       reply.grp_size, block_size, avg_ns / 1000, rate,
+		       output_megabits ? "Mbits/sec" : "MB/sec");
+	}
+
+cleanup:
+	/* Tell the progress thread to abort and exit */
+	g_shutdown_flag = 1;
+
+	cleanup_ret = pthread_join(tid, NULL);
+	if (cleanup_ret)
+		D_ERROR("Could not join progress thread");
+
+cleanup_nothread:
+	if (srv_grp != NULL) {
+		cleanup_ret = crt_group_detach(srv_grp);
+		if (cleanup_ret != 0)
+			D_ERROR("crt_group_detach failed; ret = %d\n",
+				cleanup_ret);
+		/* Make sure first error is returned, if applicable */
+		ret = ((ret == 0) ? cleanup_ret : ret);
+	}
+
+	cleanup_ret = crt_context_destroy(crt_ctx, 0);
+	if (cleanup_ret != 0)
+		D_ERROR("crt_context_destroy failed; ret = %d\n", cleanup_ret);
+	/* Make sure first error is returned, if applicable */
+	ret = ((ret == 0) ? cleanup_ret : ret);
+
+	cleanup_ret = crt_finalize();
+	if (cleanup_ret != 0)
+		D_ERROR("crt_finalize failed; ret = %d\n", cleanup_ret);
+	/* Make sure first error is returned, if applicable */
+	ret = ((ret == 0) ? cleanup_ret : ret);
+	return ret;
+}
+
 static void print_usage(const char *prog_name, const char *msg_sizes_str,
 			int rep_count,
 			int max_inflight)
@@ -1139,6 +1533,24 @@ static void print_usage(const char *prog_name, const char *msg_sizes_str,
 	       "      Short version: -b\n"
 	       "      By default, self-test outputs performance results in MB (#Bytes/1024^2)\n"
 	       "      Specifying --Mbits switches the output to megabits (#bits/1000000)\n"
+	       "  --tree-sweep\n"
+	       "      Short version: -T\n"
+	       "      Instead of the 1:many test, make the first --master-endpoint, which\n"
+	       "        must be a server of the group, time --repetitions-per-size collective\n"
+	       "        broadcasts over several tree types and branch ratios and over\n"
+	       "        CRT_TREE_AUTO. This is repeated over the first 2, 4, 8... ranks of the\n"
+	       "        group, and for the send size of each --message-sizes tuple, which is\n"
+	       "        chained to the broadcasts as a bulk. --endpoint is not needed.\n"
+	       "      The output shows which tree was fastest and what CRT_TREE_AUTO chose.\n"
+	       "  --coll [allgather|alltoall]\n"
+	       "      Short version: -C\n"
+	       "      Instead of the 1:many test, make the first --master-endpoint, which\n"
+	       "        must be a server of the group, have all live ranks of the group run\n"
+	       "        --repetitions-per-size allgathers or all-to-alls one after the other.\n"
+	       "        The send size of each --message-sizes tuple is the size of the block\n"
+	       "        each rank sends to each other rank. --endpoint is not needed.\n"
+	       "      The output shows the time per collective of the slowest rank, and the\n"
+	       "        bytes each rank received per second.\n"
 	       "  --singleton\n"
 	       "      Short version: -t\n"
 	       "      If specified, self_test will launch as a singleton process (with no orterun).\n"
@@ -1617,6 +2029,9 @@ int main(int argc, char *argv[])
 	int16_t				 buf_alignment =
 		CRT_ST_BUF_ALIGN_DEFAULT;
 	char				*attach_info_path = NULL;
+	bool				 tree_sweep = false;
+	bool				 coll_test = false;
+	enum crt_st_coll_type		 coll_type = CRT_ST_COLL_ALLGATHER;
 
 	ret = d_log_init();
 	if (ret != 0) {
@@ -1636,10 +2051,12 @@ int main(int argc, char *argv[])
 			{"Mbits", no_argument, 0, 'b'},
 			{"singleton", no_argument, 0, 't'},
 			{"path", required_argument, 0, 'p'},
+			{"tree-sweep", no_argument, 0, 'T'},
+			{"coll", required_argument, 0, 'C'},
 			{0, 0, 0, 0}
 		};
 
-		c = getopt_long(argc, argv, "g:m:e:s:r:i:a:btp:",
+		c = getopt_long(argc, argv, "g:m:e:s:r:i:a:btp:TC:",
 				long_options, NULL);
 		if (c == -1)
 			break;
@@ -1697,6 +2114,20 @@ int main(int argc, char *argv[])
 			is_singleton = 1;
 			attach_info_path = optarg;
 			break;
+		case 'T':
+			tree_sweep = true;
+			break;
+		case 'C':
+			coll_test = true;
+			if (strcmp(optarg, "allgather") == 0) {
+				coll_type = CRT_ST_COLL_ALLGATHER;
+			} else if (strcmp(optarg, "alltoall") == 0) {
+				coll_type = CRT_ST_COLL_ALLTOALL;
+			} else {
+				printf("Invalid --coll argument %s\n", optarg);
+				D_GOTO(cleanup, ret = -DER_INVAL);
+			}
+			break;
 		case '?':
 		default:
 			print_usage(argv[0], default_msg_sizes_str,
@@ -1781,10 +2212,23 @@ int main(int argc, char *argv[])
 		printf("--group-name argument not specified or is invalid\n");
 		D_GOTO(cleanup, ret = -DER_INVAL);
 	}
+	if (tree_sweep && ms_endpts == NULL) {
+		printf("--tree-sweep needs a --master-endpoint\n");
+		D_GOTO(cleanup, ret = -DER_INVAL);
+	}
+	if (coll_test && ms_endpts == NULL) {
+		printf("--coll needs a --master-endpoint\n");
+		D_GOTO(cleanup, ret = -DER_INVAL);
+	}
+	if (coll_test && tree_sweep) {
+		printf("--coll and --tree-sweep are exclusive\n");
+		D_GOTO(cleanup, ret = -DER_INVAL);
+	}
 	if (ms_endpts == NULL)
 		printf("Warning: No --master-endpoint specified; using this"
 		       " command line application as the master endpoint\n");
-	if (endpts == NULL || num_endpts == 0) {
+	if (!tree_sweep && !coll_test &&
+	    (endpts == NULL || num_endpts == 0)) {
 		printf("No endpoints specified\n");
 		D_GOTO(cleanup, ret = -DER_INVAL);
 	}
@@ -1830,6 +2274,19 @@ int main(int argc, char *argv[])
 	       rep_count, max_inflight);
 
 	/********************* Run the self test *********************/
+	if (tree_sweep) {
+		ret = run_tree_sweep(all_params, num_msg_sizes, rep_count,
+				     dest_name, &ms_endpts[0],
+				     attach_info_path);
+		D_GOTO(cleanup, ret);
+	}
+	if (coll_test) {
+		ret = run_coll_test(all_params, num_msg_sizes, rep_count,
+				    dest_name, &ms_endpts[0], coll_type,
+				    output_megabits, attach_info_path);
+		D_GOTO(cleanup, ret);
+	}
+
 	ret = run_self_test(all_params, num_msg_sizes, rep_count,
 			    max_inflight, dest_name, ms_endpts,
 			    num_ms_endpts, endpts, num_endpts,
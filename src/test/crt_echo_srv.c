@@ -117,11 +117,15 @@ static int run_echo_srver(void)
 	d_rank_list_t	grp_membs;
 	d_rank_t		excluded_ranks[4] = {1, 4, 2, 9};
 	d_rank_list_t	excluded_membs;
+	d_rank_t		included_ranks[2] = {7, 6};
+	d_rank_list_t	included_membs;
 
 	grp_membs.rl_nr = 6;
 	grp_membs.rl_ranks = grp_ranks;
 	excluded_membs.rl_nr = 4;
 	excluded_membs.rl_ranks = excluded_ranks;
+	included_membs.rl_nr = 2;
+	included_membs.rl_ranks = included_ranks;
 
 	if (mysize >= 8 && myrank == 4) {
 		crt_rpc_t				*corpc_req;
@@ -152,6 +156,23 @@ static int run_echo_srver(void)
 		echo_sem_timedwait(&gecho.token_to_proceed, 61, __LINE__);
 
 		if (!gecho.grp_destroy_piggyback) {
+			/* the same with an inclusion list, root left out */
+			rc = crt_corpc_req_create(gecho.crt_ctx,
+					example_grp_hdl, &included_membs,
+					ECHO_CORPC_EXAMPLE, NULL, NULL,
+					CRT_RPC_FLAG_INCLUSIVE,
+					crt_tree_topo(CRT_TREE_KNOMIAL, 4),
+					&corpc_req);
+			D_ASSERT(rc == 0 && corpc_req != NULL);
+			corpc_in = crt_req_get(corpc_req);
+			D_ASSERT(corpc_in != NULL);
+			corpc_in->co_msg = "testing inclusive corpc, rank 4";
+
+			rc = crt_req_send(corpc_req, client_cb_common, NULL);
+			D_ASSERT(rc == 0);
+			echo_sem_timedwait(&gecho.token_to_proceed, 61,
+					   __LINE__);
+
 			rc = crt_group_destroy(example_grp_hdl, grp_destroy_cb,
 					       &myrank);
 			printf("crt_group_destroy rc: %d, arg %p.\n",
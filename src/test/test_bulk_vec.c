@@ -0,0 +1,323 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * Vectored bulk transfer test. Rank 0 sends rank 1 a bulk handle of
+ * TEST_VEC_NR segments, rank 1 pulls them with one crt_bulk_transfer_vec()
+ * call where one descriptor is out of the bulk range, and checks that only
+ * that one fails. With CRT_BULK_SM=1 and both ranks on one host, the
+ * descriptors take the shared-memory path.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <gurt/common.h>
+#include <cart/api.h>
+
+#define TEST_OPC_BULK_VEC	(0xC2)
+#define TEST_OPC_SHUTDOWN	(0xC3)
+
+/* segments pulled, the descriptor TEST_VEC_BAD is past the end of the bulk */
+#define TEST_VEC_NR		(8)
+#define TEST_VEC_BAD		(3)
+#define TEST_VEC_SEG_LEN	(4096)
+
+static int g_do_shutdown;
+static int g_result = -DER_UNINIT;
+
+struct test_bulk_vec_in {
+	crt_bulk_t	bulk_hdl;
+};
+
+struct test_bulk_vec_out {
+	int		rc;
+};
+
+struct crt_msg_field *test_bulk_vec_in_fields[] = {
+	&CMF_BULK,
+};
+
+struct crt_msg_field *test_bulk_vec_out_fields[] = {
+	&CMF_INT,
+};
+
+struct crt_req_format DQF_BULK_VEC = DEFINE_CRT_REQ_FMT("BULK_VEC",
+						test_bulk_vec_in_fields,
+						test_bulk_vec_out_fields);
+
+struct crt_req_format DQF_SHUTDOWN = DEFINE_CRT_REQ_FMT("SHUTDOWN", NULL,
+							NULL);
+
+/* state of the transfer in rank 1's handler */
+struct test_bulk_vec {
+	crt_rpc_t		*rpc;
+	crt_bulk_t		 local_hdl;
+	d_sg_list_t		 sgl;
+	d_iov_t			 iov;
+	struct crt_bulk_desc	 descs[TEST_VEC_NR];
+};
+
+static inline char
+test_vec_byte(size_t i)
+{
+	return (char)(i * 7 + 3);
+}
+
+static int
+test_bulk_vec_cb(const struct crt_bulk_vec_cb_info *cb_info)
+{
+	struct test_bulk_vec		*vec = cb_info->bvci_arg;
+	struct test_bulk_vec_out	*out;
+	char				*buf = vec->iov.iov_buf;
+	size_t				 j;
+	int				 i;
+	int				 rc = 0;
+
+	if (cb_info->bvci_nr != TEST_VEC_NR ||
+	    cb_info->bvci_rc != cb_info->bvci_rcs[TEST_VEC_BAD]) {
+		D_ERROR("bad callback info, nr %d, rc %d\n", cb_info->bvci_nr,
+			cb_info->bvci_rc);
+		rc = -DER_MISC;
+	}
+	for (i = 0; i < TEST_VEC_NR && rc == 0; i++) {
+		if (i == TEST_VEC_BAD) {
+			if (cb_info->bvci_rcs[i] == 0) {
+				D_ERROR("out of range desc %d succeeded\n", i);
+				rc = -DER_MISC;
+			}
+			continue;
+		}
+		if (cb_info->bvci_rcs[i] != 0) {
+			D_ERROR("desc %d failed, rc %d\n", i,
+				cb_info->bvci_rcs[i]);
+			rc = cb_info->bvci_rcs[i];
+			break;
+		}
+		for (j = i * TEST_VEC_SEG_LEN; j < (i + 1) * TEST_VEC_SEG_LEN;
+		     j++) {
+			if (buf[j] != test_vec_byte(j)) {
+				D_ERROR("desc %d, byte %zu mismatch\n", i, j);
+				rc = -DER_MISC;
+				break;
+			}
+		}
+	}
+
+	out = crt_reply_get(vec->rpc);
+	out->rc = rc;
+	rc = crt_reply_send(vec->rpc);
+	assert(rc == 0);
+
+	crt_bulk_free(vec->local_hdl);
+	crt_req_decref(vec->rpc);
+	D_FREE(vec->iov.iov_buf);
+	D_FREE_PTR(vec);
+	return 0;
+}
+
+static void
+test_bulk_vec_hdlr(crt_rpc_t *rpc)
+{
+	struct test_bulk_vec_in		*in = crt_req_get(rpc);
+	struct test_bulk_vec		*vec;
+	struct crt_bulk_desc		*desc;
+	int				 i;
+	int				 rc;
+
+	D_ALLOC_PTR(vec);
+	assert(vec != NULL);
+	D_ALLOC(vec->iov.iov_buf, TEST_VEC_NR * TEST_VEC_SEG_LEN);
+	assert(vec->iov.iov_buf != NULL);
+	vec->iov.iov_buf_len = TEST_VEC_NR * TEST_VEC_SEG_LEN;
+	vec->iov.iov_len = TEST_VEC_NR * TEST_VEC_SEG_LEN;
+	vec->sgl.sg_iovs = &vec->iov;
+	vec->sgl.sg_nr = 1;
+	rc = crt_bulk_create(rpc->cr_ctx, &vec->sgl, CRT_BULK_RW,
+			     &vec->local_hdl);
+	assert(rc == 0);
+	vec->rpc = rpc;
+
+	for (i = 0; i < TEST_VEC_NR; i++) {
+		desc = &vec->descs[i];
+		desc->bd_rpc = rpc;
+		desc->bd_bulk_op = CRT_BULK_GET;
+		desc->bd_remote_hdl = in->bulk_hdl;
+		desc->bd_remote_off = i * TEST_VEC_SEG_LEN;
+		desc->bd_local_hdl = vec->local_hdl;
+		desc->bd_local_off = i * TEST_VEC_SEG_LEN;
+		desc->bd_len = TEST_VEC_SEG_LEN;
+	}
+	/* only TEST_VEC_NR - 1 segments were exposed by rank 0 */
+	vec->descs[TEST_VEC_BAD].bd_remote_off =
+		(TEST_VEC_NR - 1) * TEST_VEC_SEG_LEN;
+
+	/* a call where no descriptor can be submitted fails as a whole */
+	rc = crt_bulk_transfer_vec(&vec->descs[TEST_VEC_BAD], 1,
+				   test_bulk_vec_cb, vec);
+	assert(rc != 0);
+
+	rc = crt_req_addref(rpc);
+	assert(rc == 0);
+	rc = crt_bulk_transfer_vec(vec->descs, TEST_VEC_NR, test_bulk_vec_cb,
+				   vec);
+	assert(rc == 0);
+}
+
+static void
+test_shutdown_hdlr(crt_rpc_t *rpc)
+{
+	int rc;
+
+	rc = crt_reply_send(rpc);
+	assert(rc == 0);
+	g_do_shutdown = 1;
+}
+
+static void
+test_bulk_vec_reply(const struct crt_cb_info *info)
+{
+	struct test_bulk_vec_out	*out;
+
+	if (info->cci_rc == 0) {
+		out = crt_reply_get(info->cci_rpc);
+		g_result = out->rc;
+	} else {
+		g_result = info->cci_rc;
+	}
+}
+
+static void
+test_shutdown_reply(const struct crt_cb_info *info)
+{
+	g_do_shutdown = 1;
+}
+
+static void
+test_send(crt_context_t ctx, crt_opcode_t opc, crt_bulk_t bulk_hdl,
+	  crt_cb_t cb)
+{
+	crt_endpoint_t			 ep = { .ep_grp = NULL, .ep_rank = 1 };
+	struct test_bulk_vec_in		*in;
+	crt_rpc_t			*rpc;
+	int				 rc;
+
+	rc = crt_req_create(ctx, &ep, opc, &rpc);
+	assert(rc == 0);
+	if (opc == TEST_OPC_BULK_VEC) {
+		in = crt_req_get(rpc);
+		in->bulk_hdl = bulk_hdl;
+	}
+	rc = crt_req_send(rpc, cb, NULL);
+	assert(rc == 0);
+}
+
+int main(void)
+{
+	crt_context_t	ctx;
+	crt_bulk_t	bulk_hdl;
+	d_sg_list_t	sgl;
+	d_iov_t		iov;
+	char		*buf;
+	d_rank_t	my_rank;
+	uint32_t	grp_size;
+	size_t		j;
+	int		i;
+	int		rc;
+
+	rc = crt_init(NULL, CRT_FLAG_BIT_SERVER);
+	assert(rc == 0);
+	rc = crt_rpc_srv_register(TEST_OPC_BULK_VEC, 0, &DQF_BULK_VEC,
+				  test_bulk_vec_hdlr);
+	assert(rc == 0);
+	rc = crt_rpc_srv_register(TEST_OPC_SHUTDOWN, 0, &DQF_SHUTDOWN,
+				  test_shutdown_hdlr);
+	assert(rc == 0);
+	rc = crt_context_create(&ctx);
+	assert(rc == 0);
+
+	rc = crt_group_rank(NULL, &my_rank);
+	assert(rc == 0);
+	rc = crt_group_size(NULL, &grp_size);
+	assert(rc == 0);
+	assert(grp_size >= 2);
+
+	if (my_rank == 0) {
+		/* expose all segments but the last one */
+		D_ALLOC(buf, TEST_VEC_NR * TEST_VEC_SEG_LEN);
+		assert(buf != NULL);
+		for (j = 0; j < TEST_VEC_NR * TEST_VEC_SEG_LEN; j++)
+			buf[j] = test_vec_byte(j);
+		d_iov_set(&iov, buf, (TEST_VEC_NR - 1) * TEST_VEC_SEG_LEN);
+		sgl.sg_iovs = &iov;
+		sgl.sg_nr = 1;
+		rc = crt_bulk_create(ctx, &sgl, CRT_BULK_RO, &bulk_hdl);
+		assert(rc == 0);
+
+		test_send(ctx, TEST_OPC_BULK_VEC, bulk_hdl,
+			  test_bulk_vec_reply);
+		while (g_result == -DER_UNINIT)
+			crt_progress(ctx, 1000, NULL, NULL);
+		D_DEBUG(DB_TEST, "vectored bulk result %d\n", g_result);
+
+		crt_bulk_free(bulk_hdl);
+		D_FREE(buf);
+		test_send(ctx, TEST_OPC_SHUTDOWN, CRT_BULK_NULL,
+			  test_shutdown_reply);
+	} else if (my_rank != 1) {
+		g_do_shutdown = 1;
+		g_result = 0;
+	} else {
+		g_result = 0;
+	}
+
+	while (!g_do_shutdown)
+		crt_progress(ctx, 1000, NULL, NULL);
+
+	/* let the last reply go out */
+	for (i = 0; i < 1000; i++)
+		crt_progress(ctx, 1000, NULL, NULL);
+
+	rc = crt_context_destroy(ctx, true);
+	assert(rc == 0);
+	rc = crt_finalize();
+	assert(rc == 0);
+
+	return g_result == 0 ? 0 : 1;
+}
@@ -63,6 +63,10 @@ struct test_t {
 			 t_shutdown:1,
 			 t_complete:1;
 	int		 t_is_service;
+	/* check in on every tag, their URI lookups go out in batches */
+	int		 t_batch;
+	/* resolve all URIs of the remote group before checking in */
+	int		 t_warmup;
 	int		 t_infinite_loop;
 	int		 t_hold;
 	uint32_t	 t_hold_time;
@@ -331,7 +335,7 @@ test_init(void)
 }
 
 void
-check_in(crt_group_t *remote_group, int rank)
+check_in(crt_group_t *remote_group, int rank, int tag)
 {
 	crt_rpc_t			*rpc_req = NULL;
 	struct crt_test_checkin_req	*rpc_req_input;
@@ -341,6 +345,7 @@ check_in(crt_group_t *remote_group, int rank)
 
 	server_ep.ep_grp = remote_group;
 	server_ep.ep_rank = rank;
+	server_ep.ep_tag = tag;
 	rc = crt_req_create(test_g.t_crt_ctx[0], &server_ep,
 			TEST_OPC_CHECKIN, &rpc_req);
 	D_ASSERTF(rc == 0 && rpc_req != NULL, "crt_req_create() failed,"
@@ -365,11 +370,24 @@ check_in(crt_group_t *remote_group, int rank)
 	D_ASSERTF(rc == 0, "crt_req_send() failed. rc: %d\n", rc);
 }
 
+static void
+test_warmup_cb(const struct crt_warmup_cb_info *cb_info)
+{
+	D_ASSERTF(cb_info->wci_rc == 0, "warmup failed, rc: %d\n",
+		  cb_info->wci_rc);
+	fprintf(stderr, "warmed up %s, %u resolved, %u failed in "DF_U64
+		" us.\n", cb_info->wci_grp->cg_grpid, cb_info->wci_resolved,
+		cb_info->wci_failed, cb_info->wci_elapsed_us);
+	sem_post(&test_g.t_token_to_proceed);
+}
+
 void
 test_run(void)
 {
 	crt_group_t			*remote_group = NULL;
+	int				 tag_nr = 1;
 	int				 ii;
+	int				 tag;
 	int				 rc;
 
 	if (!test_g.t_should_attach)
@@ -397,14 +415,38 @@ test_run(void)
 	fprintf(stderr, "size of %s is %d\n", test_g.t_remote_group_name,
 		test_g.t_remote_group_size);
 
-	for (ii = 0; ii < test_g.t_remote_group_size; ii++)
-		check_in(test_g.t_remote_group, ii);
+	if (test_g.t_batch)
+		/* every context of every rank misses the cache at once */
+		tag_nr = test_g.t_ctx_num;
+
+	if (test_g.t_warmup) {
+		rc = crt_group_warmup(test_g.t_remote_group,
+				      test_g.t_crt_ctx[0], NULL, NULL, 0,
+				      test_warmup_cb, NULL);
+		D_ASSERTF(rc == 0, "crt_group_warmup() failed. rc: %d\n", rc);
+		test_sem_timedwait(&test_g.t_token_to_proceed, 61, __LINE__);
+	}
 
 	for (ii = 0; ii < test_g.t_remote_group_size; ii++)
+		for (tag = 0; tag < tag_nr; tag++)
+			check_in(test_g.t_remote_group, ii, tag);
+
+	for (ii = 0; ii < test_g.t_remote_group_size * tag_nr; ii++)
 		test_sem_timedwait(&test_g.t_token_to_proceed, 61, __LINE__);
 
+	for (ii = 0; ii < test_g.t_remote_group_size; ii++) {
+		struct crt_ep_stats	stats;
+
+		rc = crt_ep_stats_get(test_g.t_crt_ctx[0], ii, &stats);
+		D_ASSERTF(rc == 0, "crt_ep_stats_get() failed. rc: %d\n", rc);
+		fprintf(stderr, "rank %d: sent "DF_U64", replies "DF_U64
+			" (sm "DF_U64", fabric "DF_U64").\n", ii,
+			stats.eps_req_num, stats.eps_reply_num,
+			stats.eps_sm_reply_num, stats.eps_fabric_reply_num);
+	}
+
 	while (test_g.t_infinite_loop) {
-		check_in(test_g.t_remote_group, 1);
+		check_in(test_g.t_remote_group, 1, 0);
 		test_sem_timedwait(&test_g.t_token_to_proceed, 61, __LINE__);
 	}
 }
@@ -479,6 +521,8 @@ test_parse_args(int argc, char **argv)
 		{"holdtime", required_argument, 0, 'h'},
 		{"hold", no_argument, &test_g.t_hold, 1},
 		{"is_service", no_argument, &test_g.t_is_service, 1},
+		{"batch", no_argument, &test_g.t_batch, 1},
+		{"warmup", no_argument, &test_g.t_warmup, 1},
 		{"ctx_num", required_argument, 0, 'c'},
 		{"loop", no_argument, &test_g.t_infinite_loop, 1},
 		{0, 0, 0, 0}
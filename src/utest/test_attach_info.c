@@ -0,0 +1,215 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the binary attach info format of CaRT groups
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+
+static char *test_ai_uris[3] = {"tcp://10.0.0.1:1000", NULL,
+				"tcp://10.0.0.3:1002"};
+
+/* all ranks, rank 1 has no URI */
+static void
+test_attach_info_all(void **state)
+{
+	struct crt_attach_info_hdr	*hdr;
+	const char			*uri;
+	d_rank_t			 rank;
+	void				*buf;
+	size_t				 len;
+
+	assert_int_equal(crt_attach_info_pack("grp_a", 3, 0, true,
+					      test_ai_uris, &buf, &len), 0);
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr), 0);
+	assert_int_equal(hdr->ahi_size, 3);
+	assert_int_equal(crt_attach_info_uri(hdr, 2, &rank, &uri), 0);
+	assert_int_equal(rank, 2);
+	assert_string_equal(uri, test_ai_uris[2]);
+	assert_int_equal(crt_attach_info_uri(hdr, 0, &rank, &uri), 0);
+	assert_string_equal(uri, test_ai_uris[0]);
+	assert_int_equal(crt_attach_info_uri(hdr, 1, &rank, &uri),
+			 -DER_NONEXIST);
+	assert_int_equal(crt_attach_info_uri(hdr, 3, &rank, &uri),
+			 -DER_INVAL);
+	D_FREE(buf);
+}
+
+/* a single rank's URI is returned whatever rank asked for */
+static void
+test_attach_info_single(void **state)
+{
+	struct crt_attach_info_hdr	*hdr;
+	const char			*uri;
+	d_rank_t			 rank;
+	void				*buf;
+	size_t				 len;
+
+	assert_int_equal(crt_attach_info_pack("grp_a", 8, 5, false,
+					      &test_ai_uris[2], &buf, &len), 0);
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr), 0);
+	assert_int_equal(crt_attach_info_uri(hdr, 1, &rank, &uri), 0);
+	assert_int_equal(rank, 5);
+	assert_string_equal(uri, test_ai_uris[2]);
+	D_FREE(buf);
+}
+
+/* foreign and truncated images are rejected */
+static void
+test_attach_info_foreign(void **state)
+{
+	struct crt_attach_info_hdr	*hdr;
+	void				*buf;
+	size_t				 len;
+
+	assert_int_equal(crt_attach_info_pack("grp_a", 3, 0, true,
+					      test_ai_uris, &buf, &len), 0);
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_b", &hdr),
+			 -DER_INVAL);
+	assert_int_equal(crt_attach_info_unpack(buf, len - 1, "grp_a", &hdr),
+			 -DER_INVAL);
+	hdr = buf;
+	hdr->ahi_version = CRT_AI_VERSION + 1;
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr),
+			 -DER_INVAL);
+	hdr->ahi_magic = ~CRT_AI_MAGIC;
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr),
+			 -DER_INVAL);
+	D_FREE(buf);
+}
+
+/* a header disagreeing with itself or with the file size is rejected */
+static void
+test_attach_info_bad_hdr(void **state)
+{
+	struct crt_attach_info_hdr	*hdr;
+	void				*buf;
+	size_t				 len;
+
+	assert_int_equal(crt_attach_info_pack("grp_a", 3, 0, true,
+					      test_ai_uris, &buf, &len), 0);
+	hdr = buf;
+
+	hdr->ahi_len = len + 1;
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr),
+			 -DER_INVAL);
+	hdr->ahi_len = len;
+
+	/* an image of all ranks has one entry per rank */
+	hdr->ahi_nr = 1;
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr),
+			 -DER_INVAL);
+
+	/* the offset table runs past the end of the file */
+	hdr->ahi_nr = hdr->ahi_size = len;
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr),
+			 -DER_INVAL);
+	hdr->ahi_nr = hdr->ahi_size = 3;
+
+	memset(hdr->ahi_grpid, 'a', sizeof(hdr->ahi_grpid));
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr),
+			 -DER_INVAL);
+	D_FREE(buf);
+}
+
+/* an offset out of the string pool or an unterminated URI is rejected */
+static void
+test_attach_info_bad_pool(void **state)
+{
+	struct crt_attach_info_hdr	*hdr;
+	const char			*uri;
+	d_rank_t			 rank;
+	uint32_t			*offs;
+	uint32_t			 pool_len;
+	void				*buf;
+	size_t				 len;
+
+	assert_int_equal(crt_attach_info_pack("grp_a", 3, 0, true,
+					      test_ai_uris, &buf, &len), 0);
+	assert_int_equal(crt_attach_info_unpack(buf, len, "grp_a", &hdr), 0);
+	offs = (uint32_t *)(hdr + 1);
+	pool_len = len - sizeof(*hdr) - 3 * sizeof(*offs);
+
+	offs[2] = pool_len;
+	assert_int_equal(crt_attach_info_uri(hdr, 2, &rank, &uri), -DER_INVAL);
+	offs[2] = pool_len - 1;
+	assert_int_equal(crt_attach_info_uri(hdr, 2, &rank, &uri), 0);
+	assert_string_equal(uri, "");
+
+	/* the last URI of the pool loses its terminator */
+	offs[2] = pool_len - strlen(test_ai_uris[2]) - 1;
+	((char *)buf)[len - 1] = 'x';
+	assert_int_equal(crt_attach_info_uri(hdr, 2, &rank, &uri), -DER_INVAL);
+	assert_int_equal(crt_attach_info_uri(hdr, 0, &rank, &uri), 0);
+	assert_string_equal(uri, test_ai_uris[0]);
+	D_FREE(buf);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_attach_info_all),
+		cmocka_unit_test(test_attach_info_single),
+		cmocka_unit_test(test_attach_info_foreign),
+		cmocka_unit_test(test_attach_info_bad_hdr),
+		cmocka_unit_test(test_attach_info_bad_pool),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
@@ -0,0 +1,456 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the dissemination barrier of CaRT groups over a fake
+ * in-process transport
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+#include "utest_fake_queue.h"
+
+/* barriers in flight per rank */
+#define BARRIER_TEST_NR		(8)
+
+/* fake in-process transport and state of the fake ranks of a barrier test */
+static struct {
+	struct crt_grp_priv		*tb_grps;
+	/* of struct crt_barrier_msg pointers */
+	struct fake_queue		 tb_queue;
+	uint64_t			 tb_sent;
+	uint32_t			 tb_size;
+	/*
+	 * rank evicted from the test, its messages are lost and their replies
+	 * time out once all ranks learned the eviction
+	 */
+	d_rank_t			 tb_evicted;
+	d_list_t			 tb_lost;
+	/*
+	 * percentage of notifications failing with a timeout, and of sends
+	 * failing right away, but never on their last resend
+	 */
+	int				 tb_fail_pct;
+	/* all sends fail right away, or all notifications time out */
+	bool				 tb_send_down;
+	bool				 tb_recv_down;
+	uint64_t			 tb_failed;
+	/* ranks that entered each barrier */
+	uint32_t			 tb_entered[BARRIER_TEST_NR + 1];
+	/* barriers completed by each rank */
+	uint64_t			*tb_exited;
+} fake_barrier;
+
+static inline uint32_t
+test_barrier_queued(void)
+{
+	return fake_queue_len(&fake_barrier.tb_queue);
+}
+
+/* a notification fails at random, but not on its last resend */
+static bool
+test_barrier_fail(struct crt_barrier_msg *msg)
+{
+	return msg->bm_retry < CRT_BARRIER_SEND_RETRY &&
+	       random() % 100 < fake_barrier.tb_fail_pct;
+}
+
+static int
+test_barrier_send(struct crt_barrier_msg *msg)
+{
+	struct crt_barrier_msg	**ev;
+
+	if (fake_barrier.tb_send_down || test_barrier_fail(msg)) {
+		fake_barrier.tb_failed++;
+		return -DER_NOMEM;
+	}
+
+	ev = fake_queue_add(&fake_barrier.tb_queue);
+	assert_non_null(ev);
+	*ev = msg;
+	fake_barrier.tb_sent++;
+
+	return 0;
+}
+
+/* deliver one queued notification, a random one if shuffle is set */
+static void
+test_barrier_deliver(bool shuffle)
+{
+	struct crt_barrier_msg		*msg;
+	struct crt_barrier_out		 out;
+	int				 rc = 0;
+
+	fake_queue_take(&fake_barrier.tb_queue, shuffle, &msg);
+
+	if (msg->bm_rank == fake_barrier.tb_evicted ||
+	    msg->bm_info->bi_primary_grp->gp_self == fake_barrier.tb_evicted) {
+		d_list_add_tail(&msg->bm_link, &fake_barrier.tb_lost);
+		return;
+	}
+
+	if (fake_barrier.tb_recv_down || test_barrier_fail(msg)) {
+		fake_barrier.tb_failed++;
+		rc = -DER_TIMEDOUT;
+	} else {
+		crt_barrier_recv(&fake_barrier.tb_grps[msg->bm_rank]
+				 .gp_barrier_info, &msg->bm_in, &out);
+	}
+	crt_barrier_sent(msg, rc, &out);
+}
+
+/* resend the failed notifications of the live ranks, false if there is none */
+static bool
+test_barrier_resend(void)
+{
+	struct crt_barrier_info	*info;
+	bool			 pending = false;
+	d_rank_t		 rank;
+
+	for (rank = 0; rank < fake_barrier.tb_size; rank++) {
+		info = &fake_barrier.tb_grps[rank].gp_barrier_info;
+		if (rank == fake_barrier.tb_evicted ||
+		    d_list_empty(&info->bi_resend))
+			continue;
+		pending = true;
+		crt_barrier_resend(info, UINT64_MAX);
+	}
+
+	return pending;
+}
+
+static void
+test_barrier_cb(struct crt_barrier_cb_info *cb_info)
+{
+	d_rank_t	rank = (uintptr_t)cb_info->bci_arg;
+	uint64_t	b_num = ++fake_barrier.tb_exited[rank];
+	uint32_t	live_nr = fake_barrier.tb_size -
+				  (fake_barrier.tb_evicted != -1);
+
+	assert_int_equal(cb_info->bci_rc, 0);
+	/* no rank leaves a barrier before all live ranks entered it */
+	assert_true(b_num <= BARRIER_TEST_NR);
+	assert_true(fake_barrier.tb_entered[b_num] >= live_nr);
+}
+
+static void
+test_barrier_failed_cb(struct crt_barrier_cb_info *cb_info)
+{
+	d_rank_t	rank = (uintptr_t)cb_info->bci_arg;
+
+	assert_int_equal(cb_info->bci_rc, fake_barrier.tb_send_down ?
+					  -DER_NOMEM : -DER_TIMEDOUT);
+	fake_barrier.tb_exited[rank]++;
+}
+
+static d_rank_list_t *
+test_barrier_live(uint32_t size, d_rank_t evicted)
+{
+	d_rank_list_t	*live;
+	d_rank_t	 rank;
+
+	live = d_rank_list_alloc(size);
+	assert_non_null(live);
+	live->rl_nr = 0;
+	for (rank = 0; rank < size; rank++)
+		if (rank != evicted)
+			live->rl_ranks[live->rl_nr++] = rank;
+
+	return live;
+}
+
+static void
+test_barrier_init(uint32_t size)
+{
+	struct crt_barrier_info	*info;
+	d_rank_t		 rank;
+
+	memset(&fake_barrier, 0, sizeof(fake_barrier));
+	fake_barrier.tb_size = size;
+	fake_barrier.tb_evicted = -1;
+	D_INIT_LIST_HEAD(&fake_barrier.tb_lost);
+	fake_queue_init(&fake_barrier.tb_queue,
+			sizeof(struct crt_barrier_msg *));
+	D_ALLOC_ARRAY(fake_barrier.tb_grps, size);
+	assert_non_null(fake_barrier.tb_grps);
+	D_ALLOC_ARRAY(fake_barrier.tb_exited, size);
+	assert_non_null(fake_barrier.tb_exited);
+
+	for (rank = 0; rank < size; rank++) {
+		fake_barrier.tb_grps[rank].gp_primary = 1;
+		fake_barrier.tb_grps[rank].gp_self = rank;
+		assert_int_equal(crt_barrier_info_init(
+				 &fake_barrier.tb_grps[rank]), 0);
+		info = &fake_barrier.tb_grps[rank].gp_barrier_info;
+		info->bi_send = test_barrier_send;
+		crt_barrier_set_live(info, test_barrier_live(size, -1),
+				     rank, 1);
+	}
+}
+
+static void
+test_barrier_fini(void)
+{
+	struct crt_barrier_msg	*msg;
+	d_rank_t		 rank;
+
+	/*
+	 * the lost notifications of the survivors time out, the evicted rank
+	 * is gone with its own
+	 */
+	while (!d_list_empty(&fake_barrier.tb_lost)) {
+		msg = d_list_entry(fake_barrier.tb_lost.next,
+				   struct crt_barrier_msg, bm_link);
+		d_list_del(&msg->bm_link);
+		if (msg->bm_info->bi_primary_grp->gp_self ==
+		    fake_barrier.tb_evicted)
+			D_FREE_PTR(msg);
+		else
+			crt_barrier_sent(msg, -DER_TIMEDOUT, NULL);
+	}
+	assert_int_equal(test_barrier_queued(), 0);
+
+	for (rank = 0; rank < fake_barrier.tb_size; rank++)
+		crt_barrier_info_destroy(&fake_barrier.tb_grps[rank]);
+	D_FREE(fake_barrier.tb_grps);
+	D_FREE(fake_barrier.tb_exited);
+	fake_queue_fini(&fake_barrier.tb_queue);
+}
+
+/*
+ * The ranks start BARRIER_TEST_NR barriers each, interleaved at random with
+ * the delivery of notifications in random order. If evict is set, a rank
+ * leaves half way and the others learn it at random times.
+ */
+static void
+test_barrier_run(uint32_t size, int fail_pct, bool evict)
+{
+	uint32_t	*started;
+	uint32_t	 todo = size * BARRIER_TEST_NR;
+	uint32_t	 notified = 0;
+	d_rank_t	 rank;
+
+	test_barrier_init(size);
+	fake_barrier.tb_fail_pct = fail_pct;
+	D_ALLOC_ARRAY(started, size);
+	assert_non_null(started);
+
+	while (todo > 0 || test_barrier_queued() > 0 ||
+	       test_barrier_resend()) {
+		if (evict && fake_barrier.tb_evicted == -1 &&
+		    todo < size * BARRIER_TEST_NR / 2) {
+			fake_barrier.tb_evicted = random() % size;
+			todo -= BARRIER_TEST_NR -
+				started[fake_barrier.tb_evicted];
+		}
+		/* survivors learn the eviction one at a time */
+		if (fake_barrier.tb_evicted != -1 && notified < size &&
+		    random() % 4 == 0) {
+			rank = notified++;
+			if (rank != fake_barrier.tb_evicted)
+				crt_barrier_set_live(
+					&fake_barrier.tb_grps[rank]
+					.gp_barrier_info,
+					test_barrier_live(size,
+						fake_barrier.tb_evicted),
+					rank, 2);
+			continue;
+		}
+		if (todo > 0 && (test_barrier_queued() == 0 ||
+				 random() % 2 == 0)) {
+			rank = random() % size;
+			if (started[rank] == BARRIER_TEST_NR ||
+			    rank == fake_barrier.tb_evicted)
+				continue;
+			started[rank]++;
+			fake_barrier.tb_entered[started[rank]]++;
+			todo--;
+			assert_int_equal(crt_barrier_enter(
+				&fake_barrier.tb_grps[rank].gp_barrier_info,
+				test_barrier_cb, (void *)(uintptr_t)rank),
+				0);
+			continue;
+		}
+		/* the failed notifications are resent in the meantime */
+		if (test_barrier_queued() > 0 && random() % 16 != 0)
+			test_barrier_deliver(true);
+		else
+			test_barrier_resend();
+	}
+
+	/* let the remaining ranks learn the eviction */
+	while (fake_barrier.tb_evicted != -1 && notified < size) {
+		rank = notified++;
+		if (rank == fake_barrier.tb_evicted)
+			continue;
+		crt_barrier_set_live(&fake_barrier.tb_grps[rank]
+				     .gp_barrier_info,
+				     test_barrier_live(size,
+					fake_barrier.tb_evicted), rank, 2);
+		do {
+			while (test_barrier_queued() > 0)
+				test_barrier_deliver(true);
+		} while (test_barrier_resend());
+	}
+
+	for (rank = 0; rank < size; rank++)
+		if (rank != fake_barrier.tb_evicted)
+			assert_int_equal(fake_barrier.tb_exited[rank],
+					 BARRIER_TEST_NR);
+
+	D_FREE(started);
+	test_barrier_fini();
+}
+
+/* dissemination barrier over a fake in-process transport */
+static void
+test_barrier(void **state)
+{
+	uint32_t	size;
+	uint32_t	rounds;
+	d_rank_t	rank;
+	int		i;
+
+	for (size = 1; size <= 33; size += 4) {
+		test_barrier_run(size, 0, false);
+		test_barrier_run(size, 10, false);
+		if (size > 2)
+			test_barrier_run(size, 10, true);
+	}
+	for (i = 0; i < 20; i++)
+		test_barrier_run(2 + random() % 100, random() % 20,
+				 random() % 2);
+
+	/* notifications of one barrier, delivered in FIFO order */
+	for (size = 4; size <= 256; size *= 4) {
+		test_barrier_init(size);
+		for (i = 1; i <= BARRIER_TEST_NR; i++) {
+			fake_barrier.tb_entered[i] = size;
+			for (rank = 0; rank < size; rank++)
+				assert_int_equal(crt_barrier_enter(
+					&fake_barrier.tb_grps[rank]
+					.gp_barrier_info, test_barrier_cb,
+					(void *)(uintptr_t)rank), 0);
+			while (test_barrier_queued() > 0)
+				test_barrier_deliver(false);
+		}
+		for (rank = 0; rank < size; rank++)
+			assert_int_equal(fake_barrier.tb_exited[rank],
+					 BARRIER_TEST_NR);
+
+		rounds = fake_barrier.tb_grps[0].gp_barrier_info.bi_rounds;
+		assert_int_equal(fake_barrier.tb_sent,
+				 (uint64_t)size * rounds * BARRIER_TEST_NR);
+		test_barrier_fini();
+	}
+}
+
+/* a barrier whose notifications keep failing fails after the resends */
+static void
+test_barrier_send_fail_run(bool recv_down)
+{
+	struct crt_barrier_info	*info;
+	uint32_t		 size = 4;
+	d_rank_t		 rank;
+
+	test_barrier_init(size);
+	fake_barrier.tb_send_down = !recv_down;
+	fake_barrier.tb_recv_down = recv_down;
+	for (rank = 0; rank < size; rank++)
+		assert_int_equal(crt_barrier_enter(
+			&fake_barrier.tb_grps[rank].gp_barrier_info,
+			test_barrier_failed_cb, (void *)(uintptr_t)rank), 0);
+	while (test_barrier_queued() > 0)
+		test_barrier_deliver(false);
+	assert_int_equal(fake_barrier.tb_failed, size);
+
+	/* not resent before their delay */
+	for (rank = 0; rank < size; rank++) {
+		info = &fake_barrier.tb_grps[rank].gp_barrier_info;
+		crt_barrier_resend(info, d_timeus_secdiff(0));
+	}
+	assert_int_equal(test_barrier_queued(), 0);
+	assert_int_equal(fake_barrier.tb_failed, size);
+
+	do {
+		while (test_barrier_queued() > 0)
+			test_barrier_deliver(false);
+	} while (test_barrier_resend());
+
+	assert_int_equal(fake_barrier.tb_failed,
+			 size * (CRT_BARRIER_SEND_RETRY + 1));
+	for (rank = 0; rank < size; rank++)
+		assert_int_equal(fake_barrier.tb_exited[rank], 1);
+	test_barrier_fini();
+}
+
+static void
+test_barrier_send_fail(void **state)
+{
+	test_barrier_send_fail_run(false);
+	test_barrier_send_fail_run(true);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_barrier),
+		cmocka_unit_test(test_barrier_send_fail),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
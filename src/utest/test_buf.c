@@ -0,0 +1,274 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the registered buffer pool of CaRT. Bulk registration is
+ * replaced by fake handles so that no transport is needed.
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+
+/* the region a fake bulk handle covers */
+struct test_buf_bulk {
+	void	*tb_buf;
+	size_t	 tb_len;
+};
+
+/* live fake handles, and the number of creates left before one fails */
+static int	test_buf_bulk_nr;
+static int	test_buf_bulk_fail_in = -1;
+
+int
+__wrap_crt_bulk_create(crt_context_t crt_ctx, d_sg_list_t *sgl,
+		       crt_bulk_perm_t bulk_perm, crt_bulk_t *bulk_hdl)
+{
+	struct test_buf_bulk	*bulk;
+
+	assert_non_null(crt_ctx);
+	assert_int_equal(sgl->sg_nr, 1);
+	assert_int_equal(bulk_perm, CRT_BULK_RW);
+
+	if (test_buf_bulk_fail_in == 0)
+		return -DER_NOMEM;
+	if (test_buf_bulk_fail_in > 0)
+		test_buf_bulk_fail_in--;
+
+	D_ALLOC_PTR(bulk);
+	assert_non_null(bulk);
+	bulk->tb_buf = sgl->sg_iovs[0].iov_buf;
+	bulk->tb_len = sgl->sg_iovs[0].iov_buf_len;
+	test_buf_bulk_nr++;
+	*bulk_hdl = bulk;
+
+	return 0;
+}
+
+int
+__wrap_crt_bulk_free(crt_bulk_t bulk_hdl)
+{
+	if (bulk_hdl == CRT_BULK_NULL)
+		return 0;
+
+	assert_true(test_buf_bulk_nr > 0);
+	test_buf_bulk_nr--;
+	D_FREE(bulk_hdl);
+
+	return 0;
+}
+
+/* any non-NULL context, the fake handles don't use it */
+static int test_buf_ctx;
+
+static void
+test_buf_pool_create(void **state)
+{
+	size_t			 sizes[] = { 65536, 4096 };
+	size_t			 bad_sizes[] = { 4096, 0 };
+	crt_buf_pool_t		 pool = NULL;
+	struct crt_buf_pool	*pool_priv;
+
+	assert_int_equal(crt_buf_pool_create(NULL, sizes, 2, 2, 0, &pool),
+			 -DER_INVAL);
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, sizes, 0, 2, 0,
+					     &pool), -DER_INVAL);
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, sizes, 2, 0, 0,
+					     &pool), -DER_INVAL);
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, bad_sizes, 2, 2,
+					     0, &pool), -DER_INVAL);
+	assert_null(pool);
+
+	/* one registration per class, classes sorted by size */
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, sizes, 2, 2, 0,
+					     &pool), 0);
+	assert_non_null(pool);
+	assert_int_equal(test_buf_bulk_nr, 2);
+	pool_priv = pool;
+	assert_int_equal(pool_priv->cbp_class_nr, 2);
+	assert_int_equal(pool_priv->cbp_classes[0].cbc_size, 4096);
+	assert_int_equal(pool_priv->cbp_classes[1].cbc_size, 65536);
+	assert_int_equal(crt_buf_pool_destroy(pool), 0);
+	assert_int_equal(test_buf_bulk_nr, 0);
+
+	/* a class failing to register frees the ones done already */
+	test_buf_bulk_fail_in = 1;
+	pool = NULL;
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, sizes, 2, 2, 0,
+					     &pool), -DER_NOMEM);
+	assert_null(pool);
+	assert_int_equal(test_buf_bulk_nr, 0);
+	test_buf_bulk_fail_in = -1;
+
+	/* falls back to normal pages without huge pages */
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, sizes, 2, 1,
+					     CRT_BUF_POOL_HUGEPAGE, &pool), 0);
+	assert_int_equal(crt_buf_pool_destroy(pool), 0);
+	assert_int_equal(test_buf_bulk_nr, 0);
+}
+
+static void
+test_buf_get_put(void **state)
+{
+	size_t			 sizes[] = { 4096, 65536 };
+	struct crt_buf		*bufs[4];
+	struct crt_buf		*buf;
+	struct test_buf_bulk	*bulk;
+	crt_buf_pool_t		 pool;
+	int			 i;
+
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, sizes, 2, 2, 0,
+					     &pool), 0);
+	assert_int_equal(crt_buf_get(pool, 0, &buf), -DER_INVAL);
+	assert_int_equal(crt_buf_get(pool, 65537, &buf), -DER_NOSPACE);
+
+	/* small buffers come from the small class, then from the large one */
+	for (i = 0; i < 4; i++) {
+		assert_int_equal(crt_buf_get(pool, 100, &bufs[i]), 0);
+		assert_int_equal(bufs[i]->cb_len, 100);
+		assert_int_equal(bufs[i]->cb_size, i < 2 ? 4096 : 65536);
+
+		/* each buffer is its own part of the registered slab */
+		bulk = bufs[i]->cb_bulk_hdl;
+		assert_non_null(bulk);
+		assert_ptr_equal((char *)bulk->tb_buf + bufs[i]->cb_bulk_off,
+				 bufs[i]->cb_buf);
+		assert_true(bufs[i]->cb_bulk_off + bufs[i]->cb_size <=
+			    bulk->tb_len);
+		memset(bufs[i]->cb_buf, i, bufs[i]->cb_size);
+	}
+	assert_ptr_equal(bufs[0]->cb_bulk_hdl, bufs[1]->cb_bulk_hdl);
+	assert_ptr_not_equal(bufs[0]->cb_bulk_hdl, bufs[2]->cb_bulk_hdl);
+	for (i = 0; i < 4; i++)
+		assert_int_equal(((unsigned char *)bufs[i]->cb_buf)[0], i);
+	assert_int_equal(crt_buf_get(pool, 1, &buf), -DER_NOSPACE);
+
+	/* buffers in use keep the pool alive */
+	assert_int_equal(crt_buf_pool_destroy(pool), -DER_BUSY);
+
+	/* a put buffer is reused */
+	assert_int_equal(crt_buf_put(bufs[1]), 0);
+	assert_int_equal(crt_buf_get(pool, 4096, &buf), 0);
+	assert_ptr_equal(buf, bufs[1]);
+
+	for (i = 0; i < 4; i++)
+		assert_int_equal(crt_buf_put(bufs[i]), 0);
+	assert_int_equal(crt_buf_put(NULL), -DER_INVAL);
+	assert_int_equal(crt_buf_pool_destroy(pool), 0);
+	assert_int_equal(test_buf_bulk_nr, 0);
+}
+
+static void
+test_buf_view(void **state)
+{
+	size_t			 sizes[] = { 4096 };
+	struct crt_buf		*buf;
+	struct test_buf_bulk	*bulk;
+	crt_buf_pool_t		 pool;
+	crt_bulk_t		 view;
+	crt_bulk_t		 view2;
+
+	assert_int_equal(crt_buf_pool_create(&test_buf_ctx, sizes, 1, 1, 0,
+					     &pool), 0);
+	assert_int_equal(crt_buf_get(pool, 100, &buf), 0);
+
+	/* a view covers exactly the asked length of the buffer */
+	assert_int_equal(crt_buf_view(buf, 100, &view), 0);
+	bulk = view;
+	assert_ptr_equal(bulk->tb_buf, buf->cb_buf);
+	assert_int_equal(bulk->tb_len, 100);
+	assert_ptr_not_equal(view, buf->cb_bulk_hdl);
+	assert_int_equal(test_buf_bulk_nr, 2);
+
+	/* it is cached across users of the buffer asking the same length */
+	assert_int_equal(crt_buf_view(buf, 100, &view2), 0);
+	assert_ptr_equal(view2, view);
+	assert_int_equal(crt_buf_put(buf), 0);
+	assert_int_equal(crt_buf_get(pool, 100, &buf), 0);
+	assert_int_equal(crt_buf_view(buf, 100, &view2), 0);
+	assert_ptr_equal(view2, view);
+	assert_int_equal(test_buf_bulk_nr, 2);
+
+	/* and registered again for another length */
+	assert_int_equal(crt_buf_view(buf, 4096, &view2), 0);
+	bulk = view2;
+	assert_int_equal(bulk->tb_len, 4096);
+	assert_int_equal(test_buf_bulk_nr, 2);
+
+	/* a failed registration leaves no stale view */
+	test_buf_bulk_fail_in = 0;
+	assert_int_equal(crt_buf_view(buf, 200, &view2), -DER_NOMEM);
+	test_buf_bulk_fail_in = -1;
+	assert_int_equal(test_buf_bulk_nr, 1);
+	assert_int_equal(crt_buf_view(buf, 200, &view2), 0);
+	assert_int_equal(test_buf_bulk_nr, 2);
+
+	/* the view is freed with the pool */
+	assert_int_equal(crt_buf_put(buf), 0);
+	assert_int_equal(crt_buf_pool_destroy(pool), 0);
+	assert_int_equal(test_buf_bulk_nr, 0);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_buf_pool_create),
+		cmocka_unit_test(test_buf_get_put),
+		cmocka_unit_test(test_buf_view),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
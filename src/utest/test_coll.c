@@ -0,0 +1,622 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the allgather and all-to-all collectives of CaRT groups
+ * over a fake in-process transport
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+#include "utest_fake_queue.h"
+
+/* collectives started per rank */
+#define COLL_TEST_NR		(6)
+
+/* an event of the fake collective transport */
+struct test_coll_ev {
+	enum {
+		TC_EV_SEND,
+		TC_EV_PULL,
+		TC_EV_REPLY,
+	}			 ce_type;
+	/* sender of the notification */
+	struct crt_coll		*ce_src;
+	d_rank_t		 ce_dst;
+	struct crt_coll_in	 ce_in;
+	struct crt_coll_msg	*ce_msg;
+	uint32_t		 ce_seg;
+	int			 ce_rc;
+};
+
+/* fake in-process transport and state of the fake ranks of a collective test */
+static struct {
+	struct crt_grp_priv	*tc_grps;
+	/* of struct test_coll_ev */
+	struct fake_queue	 tc_queue;
+	uint64_t		 tc_sent;
+	uint32_t		 tc_size;
+	uint32_t		 tc_len;
+	/* rank evicted from the test, frozen from then on */
+	d_rank_t		 tc_evicted;
+	/* membership version known by each rank */
+	uint32_t		*tc_ver;
+	/* buffers of each rank for each collective */
+	char			**tc_send;
+	char			**tc_recv;
+	/* collectives completed by each rank, and how many failed */
+	uint32_t		*tc_done;
+	uint32_t		 tc_failed;
+	/* the ranks are destroyed with collectives in flight */
+	bool			 tc_cancel;
+} fake_coll;
+
+static struct test_coll_ev *
+test_coll_ev_add(int type)
+{
+	struct test_coll_ev	*ev;
+
+	ev = fake_queue_add(&fake_coll.tc_queue);
+	assert_non_null(ev);
+	ev->ce_type = type;
+
+	return ev;
+}
+
+static inline uint32_t
+test_coll_queued(void)
+{
+	return fake_queue_len(&fake_coll.tc_queue);
+}
+
+static bool
+test_coll_evicted(struct crt_coll *coll)
+{
+	return coll != NULL && fake_coll.tc_evicted != -1 &&
+	       coll->cl_info ==
+	       &fake_coll.tc_grps[fake_coll.tc_evicted].gp_coll_info;
+}
+
+/* the fake bulk handle is the address of the buffer */
+static int
+test_coll_bulk_create(struct crt_coll *coll, void *buf, uint64_t len,
+		      crt_bulk_t *bulk)
+{
+	*bulk = buf;
+	return 0;
+}
+
+static void
+test_coll_bulk_free(crt_bulk_t bulk)
+{
+}
+
+static int
+test_coll_send(struct crt_coll *coll, d_rank_t rank,
+	       struct crt_coll_in *in)
+{
+	struct test_coll_ev	*ev = test_coll_ev_add(TC_EV_SEND);
+
+	ev->ce_src = coll;
+	ev->ce_dst = rank;
+	ev->ce_in = *in;
+	fake_coll.tc_sent++;
+
+	return 0;
+}
+
+static int
+test_coll_pull(struct crt_coll_msg *msg, uint32_t seg)
+{
+	struct test_coll_ev	*ev = test_coll_ev_add(TC_EV_PULL);
+
+	ev->ce_msg = msg;
+	ev->ce_seg = seg;
+
+	return 0;
+}
+
+static void
+test_coll_reply(struct crt_coll_msg *msg, int rc)
+{
+	struct test_coll_ev	*ev = test_coll_ev_add(TC_EV_REPLY);
+
+	ev->ce_src = msg->cm_handle;
+	ev->ce_in = msg->cm_in;
+	ev->ce_rc = rc;
+	D_FREE_PTR(msg);
+}
+
+static struct crt_coll_transport test_coll_transport = {
+	.ct_bulk_create	= test_coll_bulk_create,
+	.ct_bulk_free	= test_coll_bulk_free,
+	.ct_send	= test_coll_send,
+	.ct_pull	= test_coll_pull,
+	.ct_reply	= test_coll_reply,
+};
+
+/* the sender of a notification held by the evicted rank times out */
+static void
+test_coll_timeout(struct crt_coll_msg *msg)
+{
+	if (msg->cm_handle != NULL && !test_coll_evicted(msg->cm_handle))
+		crt_coll_sent(msg->cm_handle, &msg->cm_in, -DER_TIMEDOUT);
+	D_FREE_PTR(msg);
+}
+
+/* rank leaves, with the notifications it did not reply yet */
+static void
+test_coll_evict(d_rank_t rank)
+{
+	struct crt_coll_info	*info = &fake_coll.tc_grps[rank].gp_coll_info;
+	struct crt_coll_msg	*msg, *next_msg;
+	struct crt_coll		*coll;
+
+	fake_coll.tc_evicted = rank;
+	d_list_for_each_entry(coll, &info->ci_colls, cl_link) {
+		d_list_for_each_entry_safe(msg, next_msg, &coll->cl_msgs,
+					   cm_link) {
+			d_list_del(&msg->cm_link);
+			test_coll_timeout(msg);
+		}
+	}
+}
+
+/* handle one queued event, a random one if shuffle is set */
+static void
+test_coll_deliver(bool shuffle)
+{
+	struct test_coll_ev	 ev;
+	struct crt_coll_msg	*msg;
+	struct crt_coll		*coll;
+	char			*local;
+	int			 rc = 0;
+
+	fake_queue_take(&fake_coll.tc_queue, shuffle, &ev);
+
+	switch (ev.ce_type) {
+	case TC_EV_SEND:
+		if (test_coll_evicted(ev.ce_src))
+			break;
+		if (ev.ce_dst == fake_coll.tc_evicted) {
+			if (ev.ce_src != NULL)
+				crt_coll_sent(ev.ce_src, &ev.ce_in,
+					      -DER_TIMEDOUT);
+			break;
+		}
+		D_ALLOC_PTR(msg);
+		assert_non_null(msg);
+		msg->cm_handle = ev.ce_src;
+		msg->cm_in = ev.ce_in;
+		crt_coll_recv(&fake_coll.tc_grps[ev.ce_dst].gp_coll_info, msg);
+		break;
+	case TC_EV_PULL:
+		msg = ev.ce_msg;
+		coll = msg->cm_coll;
+		if (test_coll_evicted(coll)) {
+			if (--msg->cm_pulls == 0)
+				test_coll_timeout(msg);
+			break;
+		}
+		if (test_coll_evicted(msg->cm_handle)) {
+			rc = -DER_TIMEDOUT;
+		} else {
+			local = coll->cl_type == CRT_COLL_ALLGATHER ?
+				coll->cl_bulk : coll->cl_recv_bulk;
+			memcpy(local + msg->cm_segs[ev.ce_seg].off,
+			       (char *)msg->cm_in.c_bulk +
+			       msg->cm_segs[ev.ce_seg].remote_off,
+			       msg->cm_segs[ev.ce_seg].len);
+		}
+		crt_coll_pulled(msg, rc);
+		break;
+	case TC_EV_REPLY:
+		if (ev.ce_src != NULL && !test_coll_evicted(ev.ce_src))
+			crt_coll_sent(ev.ce_src, &ev.ce_in, ev.ce_rc);
+		break;
+	}
+}
+
+/* byte i of the block sent by rank src to rank dst in collective num */
+static inline char
+test_coll_byte(uint32_t num, d_rank_t src, d_rank_t dst, uint32_t i)
+{
+	return (char)(num * 131 + src * 31 + dst * 7 + i);
+}
+
+static inline enum crt_coll_type
+test_coll_type(uint32_t num)
+{
+	return num % 2 ? CRT_COLL_ALLGATHER : CRT_COLL_ALLTOALL;
+}
+
+static void
+test_coll_cb(const struct crt_coll_cb_info *cb_info)
+{
+	uint32_t	 idx = (uintptr_t)cb_info->coci_arg;
+	d_rank_t	 rank = idx / (COLL_TEST_NR + 1);
+	uint32_t	 num = idx % (COLL_TEST_NR + 1) + 1;
+	uint32_t	 len = fake_coll.tc_len;
+	char		*recv;
+	d_rank_t	 src;
+	uint32_t	 i;
+
+	/* collectives can complete out of order */
+	fake_coll.tc_done[rank]++;
+	if (cb_info->coci_rc != 0) {
+		/*
+		 * only the collectives of an eviction or of a destroyed rank
+		 * are allowed to fail
+		 */
+		assert_true(fake_coll.tc_evicted != -1 ||
+			    (fake_coll.tc_cancel &&
+			     cb_info->coci_rc == -DER_CANCELED));
+		fake_coll.tc_failed++;
+		return;
+	}
+
+	recv = fake_coll.tc_recv[idx];
+	for (src = 0; src < fake_coll.tc_size; src++) {
+		if (src == fake_coll.tc_evicted &&
+		    cb_info->coci_rank_nr < fake_coll.tc_size)
+			continue;
+		for (i = 0; i < len; i++)
+			assert_int_equal(recv[src * len + i],
+				test_coll_byte(num, src,
+					test_coll_type(num) ==
+					CRT_COLL_ALLGATHER ? 0 : rank, i));
+	}
+}
+
+static d_rank_list_t *
+test_coll_ranks(uint32_t size, d_rank_t evicted)
+{
+	d_rank_list_t	*live;
+	d_rank_t	 rank;
+
+	live = d_rank_list_alloc(size);
+	assert_non_null(live);
+	live->rl_nr = 0;
+	for (rank = 0; rank < size; rank++)
+		if (rank != evicted)
+			live->rl_ranks[live->rl_nr++] = rank;
+
+	return live;
+}
+
+static d_rank_list_t *
+test_coll_live(d_rank_t rank)
+{
+	return test_coll_ranks(fake_coll.tc_size,
+			       fake_coll.tc_ver[rank] > 1 ?
+			       fake_coll.tc_evicted : -1);
+}
+
+/* start the next collective on rank */
+static void
+test_coll_start(d_rank_t rank, uint32_t num)
+{
+	uint32_t	 size = fake_coll.tc_size;
+	uint32_t	 len = fake_coll.tc_len;
+	d_iov_t		 send_iov;
+	d_iov_t		 recv_iov;
+	char		*send;
+	char		*recv;
+	d_rank_t	 dst;
+	uint32_t	 idx = rank * (COLL_TEST_NR + 1) + num - 1;
+	uint32_t	 i;
+
+	send = fake_coll.tc_send[idx];
+	recv = fake_coll.tc_recv[idx];
+	if (test_coll_type(num) == CRT_COLL_ALLGATHER) {
+		for (i = 0; i < len; i++)
+			send[i] = test_coll_byte(num, rank, 0, i);
+		d_iov_set(&send_iov, send, len);
+	} else {
+		for (dst = 0; dst < size; dst++)
+			for (i = 0; i < len; i++)
+				send[dst * len + i] =
+					test_coll_byte(num, rank, dst, i);
+		d_iov_set(&send_iov, send, size * len);
+	}
+	d_iov_set(&recv_iov, recv, size * len);
+
+	assert_int_equal(crt_coll_start(
+		&fake_coll.tc_grps[rank].gp_coll_info, NULL,
+		test_coll_type(num), test_coll_live(rank), rank,
+		fake_coll.tc_ver[rank], size, &send_iov, &recv_iov, len,
+		test_coll_cb, (void *)(uintptr_t)idx), 0);
+}
+
+static void
+test_coll_init(uint32_t size, uint32_t len)
+{
+	d_rank_t	rank;
+	uint32_t	idx;
+	uint32_t	i;
+
+	memset(&fake_coll, 0, sizeof(fake_coll));
+	fake_coll.tc_size = size;
+	fake_coll.tc_len = len;
+	fake_coll.tc_evicted = -1;
+	fake_queue_init(&fake_coll.tc_queue, sizeof(struct test_coll_ev));
+	D_ALLOC_ARRAY(fake_coll.tc_grps, size);
+	assert_non_null(fake_coll.tc_grps);
+	D_ALLOC_ARRAY(fake_coll.tc_ver, size);
+	assert_non_null(fake_coll.tc_ver);
+	D_ALLOC_ARRAY(fake_coll.tc_done, size);
+	assert_non_null(fake_coll.tc_done);
+	D_ALLOC_ARRAY(fake_coll.tc_send, size * (COLL_TEST_NR + 1));
+	assert_non_null(fake_coll.tc_send);
+	D_ALLOC_ARRAY(fake_coll.tc_recv, size * (COLL_TEST_NR + 1));
+	assert_non_null(fake_coll.tc_recv);
+
+	for (rank = 0; rank < size; rank++) {
+		fake_coll.tc_ver[rank] = 1;
+		assert_int_equal(crt_coll_info_init(&fake_coll.tc_grps[rank]),
+				 0);
+		fake_coll.tc_grps[rank].gp_coll_info.ci_transport =
+			&test_coll_transport;
+		for (i = 0; i < COLL_TEST_NR + 1; i++) {
+			idx = rank * (COLL_TEST_NR + 1) + i;
+			D_ALLOC(fake_coll.tc_send[idx], size * len);
+			assert_non_null(fake_coll.tc_send[idx]);
+			D_ALLOC(fake_coll.tc_recv[idx], size * len);
+			assert_non_null(fake_coll.tc_recv[idx]);
+		}
+	}
+}
+
+static void
+test_coll_fini(void)
+{
+	d_rank_t	rank;
+	uint32_t	i;
+
+	for (rank = 0; rank < fake_coll.tc_size; rank++) {
+		if (rank != fake_coll.tc_evicted)
+			assert_true(d_list_empty(&fake_coll.tc_grps[rank]
+						 .gp_coll_info.ci_colls));
+		crt_coll_info_destroy(&fake_coll.tc_grps[rank]);
+	}
+	for (i = 0; i < fake_coll.tc_size * (COLL_TEST_NR + 1); i++) {
+		D_FREE(fake_coll.tc_send[i]);
+		D_FREE(fake_coll.tc_recv[i]);
+	}
+	D_FREE(fake_coll.tc_send);
+	D_FREE(fake_coll.tc_recv);
+	D_FREE(fake_coll.tc_grps);
+	D_FREE(fake_coll.tc_ver);
+	D_FREE(fake_coll.tc_done);
+	fake_queue_fini(&fake_coll.tc_queue);
+}
+
+/*
+ * The ranks start COLL_TEST_NR collectives each, allgathers and all-to-alls
+ * in turn, interleaved at random with the events of the transport. If evict
+ * is set, a rank leaves half way and the others learn it at random times,
+ * then the survivors run one more collective which has to succeed.
+ */
+static void
+test_coll_run(uint32_t size, uint32_t len, bool evict)
+{
+	uint32_t	*started;
+	uint32_t	 todo = size * COLL_TEST_NR;
+	uint32_t	 notified = 0;
+	d_rank_t	 rank;
+
+	test_coll_init(size, len);
+	D_ALLOC_ARRAY(started, size);
+	assert_non_null(started);
+
+	while (todo > 0 || test_coll_queued() > 0 ||
+	       (fake_coll.tc_evicted != -1 && notified < size)) {
+		if (evict && fake_coll.tc_evicted == -1 &&
+		    todo < size * COLL_TEST_NR / 2) {
+			test_coll_evict(random() % size);
+			todo -= COLL_TEST_NR - started[fake_coll.tc_evicted];
+		}
+		/* survivors learn the eviction one at a time */
+		if (fake_coll.tc_evicted != -1 && notified < size &&
+		    random() % 4 == 0) {
+			rank = notified++;
+			fake_coll.tc_ver[rank] = 2;
+			if (rank != fake_coll.tc_evicted)
+				crt_coll_set_ver(&fake_coll.tc_grps[rank]
+						 .gp_coll_info,
+						 test_coll_live(rank), rank,
+						 2);
+			continue;
+		}
+		if (todo > 0 && (test_coll_queued() == 0 ||
+				 random() % 2 == 0)) {
+			rank = random() % size;
+			if (started[rank] == COLL_TEST_NR ||
+			    rank == fake_coll.tc_evicted)
+				continue;
+			todo--;
+			test_coll_start(rank, ++started[rank]);
+			continue;
+		}
+		if (test_coll_queued() > 0)
+			test_coll_deliver(true);
+	}
+
+	for (rank = 0; rank < size; rank++)
+		if (rank != fake_coll.tc_evicted)
+			assert_int_equal(fake_coll.tc_done[rank], COLL_TEST_NR);
+
+	if (fake_coll.tc_evicted != -1) {
+		fake_coll.tc_failed = 0;
+		for (rank = 0; rank < size; rank++)
+			if (rank != fake_coll.tc_evicted)
+				test_coll_start(rank, COLL_TEST_NR + 1);
+		while (test_coll_queued() > 0)
+			test_coll_deliver(true);
+		for (rank = 0; rank < size; rank++)
+			if (rank != fake_coll.tc_evicted)
+				assert_int_equal(fake_coll.tc_done[rank],
+						 COLL_TEST_NR + 1);
+		assert_int_equal(fake_coll.tc_failed, 0);
+	}
+
+	D_FREE(started);
+	test_coll_fini();
+}
+
+/*
+ * All ranks but the last one start collective num, which cannot complete
+ * without it, then the ranks are destroyed. The started collectives complete
+ * with -DER_CANCELED and the notifications parked on the last rank are
+ * replied to.
+ */
+static void
+test_coll_cancel(uint32_t size, uint32_t num)
+{
+	struct crt_coll_info	*info;
+	struct test_coll_ev	 ev;
+	uint32_t		 reply_nr = 0;
+	d_rank_t		 rank;
+	uint32_t		 i;
+
+	test_coll_init(size, 64);
+	for (rank = 0; rank < size - 1; rank++)
+		test_coll_start(rank, num);
+	while (test_coll_queued() > 0)
+		test_coll_deliver(false);
+	for (rank = 0; rank < size; rank++)
+		assert_int_equal(fake_coll.tc_done[rank], 0);
+
+	fake_coll.tc_cancel = true;
+	for (i = 0; i < size; i++) {
+		/* the last rank first, its replies are not delivered */
+		rank = (size - 1 + i) % size;
+		info = &fake_coll.tc_grps[rank].gp_coll_info;
+		assert_false(d_list_empty(&info->ci_colls));
+		crt_coll_info_destroy(&fake_coll.tc_grps[rank]);
+		assert_int_equal(fake_coll.tc_done[rank], rank < size - 1);
+		if (rank == size - 1)
+			reply_nr = test_coll_queued();
+
+		assert_int_equal(crt_coll_info_init(&fake_coll.tc_grps[rank]),
+				 0);
+		info->ci_transport = &test_coll_transport;
+	}
+	assert_int_equal(fake_coll.tc_failed, size - 1);
+	assert_true(reply_nr > 0);
+	assert_int_equal(test_coll_queued(), reply_nr);
+	for (i = 0; i < reply_nr; i++) {
+		fake_queue_take(&fake_coll.tc_queue, false, &ev);
+		assert_int_equal(ev.ce_type, TC_EV_REPLY);
+		assert_int_equal(ev.ce_rc, -DER_CANCELED);
+	}
+	test_coll_fini();
+}
+
+/* allgather and all-to-all over a fake in-process transport */
+static void
+test_coll(void **state)
+{
+	uint32_t	rounds;
+	uint32_t	size;
+	uint32_t	num;
+	d_rank_t	rank;
+	int		i;
+
+	for (size = 1; size <= 33; size += 4) {
+		test_coll_run(size, 1 + random() % 64, false);
+		if (size > 2)
+			test_coll_run(size, 1 + random() % 64, true);
+	}
+	for (i = 0; i < 20; i++)
+		test_coll_run(2 + random() % 100, 1 + random() % 64,
+			      random() % 2);
+
+	/* notifications of one collective, events handled in FIFO order */
+	for (size = 2; size <= 64; size *= 2) {
+		test_coll_init(size, 64);
+		for (num = 1; num <= 2; num++) {
+			fake_coll.tc_sent = 0;
+			for (rank = 0; rank < size; rank++)
+				test_coll_start(rank, num);
+			while (test_coll_queued() > 0)
+				test_coll_deliver(false);
+			for (rank = 0; rank < size; rank++)
+				assert_int_equal(fake_coll.tc_done[rank], num);
+
+			/* ceil(log2(size)) rounds or size - 1 steps */
+			for (rounds = 0; (1U << rounds) < size; rounds++)
+				;
+			assert_int_equal(fake_coll.tc_sent, (uint64_t)size *
+					 (num == 1 ? rounds : size - 1));
+		}
+		test_coll_fini();
+	}
+
+	for (size = 2; size <= 33; size += 5)
+		for (num = 1; num <= 2; num++)
+			test_coll_cancel(size, num);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_coll),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
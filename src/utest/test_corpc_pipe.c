@@ -0,0 +1,639 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the pipelined pull of the chained bulk of a corpc. The node
+ * under test is a leaf of the tree, rank 1 under rank 0. The bulk transfers,
+ * the RPCs to the parent and the replies are replaced by fakes that the tests
+ * complete one by one, and the children of the node are played by calling
+ * crt_hdlr_corpc_seg_wait() directly.
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+
+#define PIPE_TEST_SHIFT		(12)
+#define PIPE_TEST_SEG_NR	(5)
+#define PIPE_TEST_LEN		(((PIPE_TEST_SEG_NR - 1) << PIPE_TEST_SHIFT) \
+				 + 100)
+#define PIPE_TEST_OPC		(0x10000001)
+#define PIPE_TEST_PARENT	(0)
+#define PIPE_TEST_SELF		(1)
+/* the pipe of the parent */
+#define PIPE_TEST_PARENT_ID	(7)
+
+/* the region a fake bulk handle covers */
+struct test_pipe_bulk {
+	void	*tb_buf;
+	size_t	 tb_len;
+};
+
+/* a fake CRT_OPC_CORPC_SEG_WAIT, to the parent or from a child */
+struct test_pipe_rpc {
+	crt_rpc_t			tr_rpc;
+	struct crt_corpc_seg_wait_in	tr_in;
+	struct crt_corpc_seg_wait_out	tr_out;
+	int				tr_ref;
+};
+
+struct test_pipe_state {
+	/* the chained bulk of the parent */
+	char			*ts_src;
+	struct test_pipe_bulk	 ts_parent_bulk;
+	/* segments the parent was told to hold */
+	uint32_t		 ts_parent_avail;
+	/* fake handles created and not freed yet */
+	int			 ts_bulk_nr;
+	/* the pull in flight, the pipe pulls one segment at a time */
+	bool			 ts_pulling;
+	struct crt_bulk_desc	 ts_pull_desc;
+	crt_bulk_cb_t		 ts_pull_cb;
+	void			*ts_pull_arg;
+	/* the CRT_OPC_CORPC_SEG_WAIT to the parent in flight */
+	struct test_pipe_rpc	*ts_wait;
+	crt_cb_t		 ts_wait_cb;
+	void			*ts_wait_arg;
+	int			 ts_wait_nr;
+	/* replies to the children's waits, and the waits not released yet */
+	int			 ts_child_reply_nr;
+	uint32_t		 ts_child_avail;
+	int			 ts_child_rc;
+	int			 ts_child_nr;
+	/* local handler runs, replies to the parent and RPC destroys */
+	int			 ts_local_nr;
+	int			 ts_reply_nr;
+	int			 ts_reply_rc;
+	int			 ts_destroy_nr;
+};
+
+static struct test_pipe_state	test_pipe;
+static struct crt_grp_priv	test_pipe_grp;
+static struct crt_grp_gdata	test_pipe_grp_gdata;
+static struct crt_opc_info	test_pipe_opc_info;
+/* any non-NULL context, the fakes don't use it */
+static int			test_pipe_ctx;
+
+bool
+__wrap_crt_initialized(void)
+{
+	return true;
+}
+
+struct crt_buf_pool *
+__wrap_crt_context_buf_pool(struct crt_context *ctx)
+{
+	return NULL;
+}
+
+int
+__wrap_crt_bulk_create(crt_context_t crt_ctx, d_sg_list_t *sgl,
+		       crt_bulk_perm_t bulk_perm, crt_bulk_t *bulk_hdl)
+{
+	struct test_pipe_bulk	*bulk;
+
+	assert_int_equal(sgl->sg_nr, 1);
+
+	D_ALLOC_PTR(bulk);
+	assert_non_null(bulk);
+	bulk->tb_buf = sgl->sg_iovs[0].iov_buf;
+	bulk->tb_len = sgl->sg_iovs[0].iov_buf_len;
+	test_pipe.ts_bulk_nr++;
+	*bulk_hdl = bulk;
+
+	return 0;
+}
+
+int
+__wrap_crt_bulk_free(crt_bulk_t bulk_hdl)
+{
+	assert_true(test_pipe.ts_bulk_nr > 0);
+	test_pipe.ts_bulk_nr--;
+	D_FREE(bulk_hdl);
+
+	return 0;
+}
+
+int
+__wrap_crt_bulk_get_len(crt_bulk_t bulk_hdl, size_t *bulk_len)
+{
+	struct test_pipe_bulk	*bulk = bulk_hdl;
+
+	*bulk_len = bulk->tb_len;
+
+	return 0;
+}
+
+int
+__wrap_crt_bulk_access(crt_bulk_t bulk_hdl, d_sg_list_t *sgl)
+{
+	struct test_pipe_bulk	*bulk = bulk_hdl;
+
+	sgl->sg_nr_out = 1;
+	if (sgl->sg_nr < 1)
+		return -DER_TRUNC;
+	sgl->sg_iovs[0].iov_buf = bulk->tb_buf;
+	sgl->sg_iovs[0].iov_buf_len = bulk->tb_len;
+	sgl->sg_iovs[0].iov_len = bulk->tb_len;
+
+	return 0;
+}
+
+int
+__wrap_crt_bulk_transfer(struct crt_bulk_desc *bulk_desc,
+			 crt_bulk_cb_t complete_cb, void *arg,
+			 crt_bulk_opid_t *opid)
+{
+	size_t	off = bulk_desc->bd_remote_off;
+
+	assert_false(test_pipe.ts_pulling);
+	assert_int_equal(bulk_desc->bd_bulk_op, CRT_BULK_GET);
+	assert_ptr_equal(bulk_desc->bd_remote_hdl, &test_pipe.ts_parent_bulk);
+	assert_int_equal(bulk_desc->bd_local_off, off);
+	/* only segments the parent holds, one segment long */
+	assert_int_equal(off & ((1 << PIPE_TEST_SHIFT) - 1), 0);
+	assert_true((off >> PIPE_TEST_SHIFT) < test_pipe.ts_parent_avail);
+	assert_int_equal(bulk_desc->bd_len,
+			 min(PIPE_TEST_LEN - off, 1 << PIPE_TEST_SHIFT));
+
+	test_pipe.ts_pulling = true;
+	test_pipe.ts_pull_desc = *bulk_desc;
+	test_pipe.ts_pull_cb = complete_cb;
+	test_pipe.ts_pull_arg = arg;
+
+	return 0;
+}
+
+int
+__wrap_crt_tree_get_children(struct crt_grp_priv *grp_priv, uint32_t grp_ver,
+			     d_rank_list_t *filter_ranks, bool filter_incl,
+			     int tree_topo, d_rank_t root, d_rank_t self,
+			     d_rank_list_t **children_rank_list,
+			     bool *ver_match)
+{
+	assert_int_equal(self, PIPE_TEST_SELF);
+	*children_rank_list = NULL;
+	if (ver_match != NULL)
+		*ver_match = true;
+
+	return 0;
+}
+
+int
+__wrap_crt_group_rank(crt_group_t *grp, d_rank_t *rank)
+{
+	*rank = PIPE_TEST_SELF;
+
+	return 0;
+}
+
+int
+__wrap_crt_req_create(crt_context_t crt_ctx, crt_endpoint_t *tgt_ep,
+		      crt_opcode_t opc, crt_rpc_t **req)
+{
+	struct test_pipe_rpc	*rpc;
+
+	assert_int_equal(opc, CRT_OPC_CORPC_SEG_WAIT);
+	assert_int_equal(tgt_ep->ep_rank, PIPE_TEST_PARENT);
+	/* one wait at a time */
+	assert_null(test_pipe.ts_wait);
+
+	D_ALLOC_PTR(rpc);
+	assert_non_null(rpc);
+	rpc->tr_rpc.cr_input = &rpc->tr_in;
+	rpc->tr_rpc.cr_output = &rpc->tr_out;
+	test_pipe.ts_wait = rpc;
+	*req = &rpc->tr_rpc;
+
+	return 0;
+}
+
+int
+__wrap_crt_req_send(crt_rpc_t *req, crt_cb_t complete_cb, void *arg)
+{
+	assert_ptr_equal(req, &test_pipe.ts_wait->tr_rpc);
+	assert_int_equal(test_pipe.ts_wait->tr_in.csw_id, PIPE_TEST_PARENT_ID);
+	test_pipe.ts_wait_cb = complete_cb;
+	test_pipe.ts_wait_arg = arg;
+	test_pipe.ts_wait_nr++;
+
+	return 0;
+}
+
+/* replies to the waits of the children */
+int
+__wrap_crt_reply_send(crt_rpc_t *req)
+{
+	struct crt_corpc_seg_wait_out	*out = crt_reply_get(req);
+
+	test_pipe.ts_child_reply_nr++;
+	test_pipe.ts_child_avail = out->csw_avail;
+	test_pipe.ts_child_rc = out->csw_rc;
+
+	return 0;
+}
+
+int
+__wrap_crt_req_addref(crt_rpc_t *req)
+{
+	struct test_pipe_rpc	*rpc;
+
+	rpc = container_of(req, struct test_pipe_rpc, tr_rpc);
+	rpc->tr_ref++;
+
+	return 0;
+}
+
+int
+__wrap_crt_req_decref(crt_rpc_t *req)
+{
+	struct test_pipe_rpc	*rpc;
+
+	rpc = container_of(req, struct test_pipe_rpc, tr_rpc);
+	assert_true(rpc->tr_ref > 0);
+	if (--rpc->tr_ref == 0) {
+		test_pipe.ts_child_nr--;
+		D_FREE(rpc);
+	}
+
+	return 0;
+}
+
+int
+__wrap_crt_rpc_common_hdlr(struct crt_rpc_priv *rpc_priv)
+{
+	struct test_pipe_bulk	*bulk = rpc_priv->crp_pub.cr_co_bulk_hdl;
+
+	/* the handler only runs on the whole bulk */
+	assert_int_equal(bulk->tb_len, PIPE_TEST_LEN);
+	assert_memory_equal(bulk->tb_buf, test_pipe.ts_src, PIPE_TEST_LEN);
+	test_pipe.ts_local_nr++;
+
+	return 0;
+}
+
+int
+__wrap_crt_hg_reply_send(struct crt_rpc_priv *rpc_priv)
+{
+	test_pipe.ts_reply_nr++;
+	test_pipe.ts_reply_rc = rpc_priv->crp_reply_hdr.cch_rc;
+
+	return 0;
+}
+
+void
+__wrap_crt_req_destroy(struct crt_rpc_priv *rpc_priv)
+{
+	test_pipe.ts_destroy_nr++;
+}
+
+/* complete the pull in flight */
+static void
+test_pipe_pull_complete(int rc)
+{
+	struct crt_bulk_cb_info	 cb_info;
+	struct crt_bulk_desc	*desc = &test_pipe.ts_pull_desc;
+	struct test_pipe_bulk	*local = desc->bd_local_hdl;
+
+	assert_true(test_pipe.ts_pulling);
+	test_pipe.ts_pulling = false;
+	if (rc == 0)
+		memcpy((char *)local->tb_buf + desc->bd_local_off,
+		       test_pipe.ts_src + desc->bd_remote_off, desc->bd_len);
+
+	cb_info.bci_bulk_desc = desc;
+	cb_info.bci_arg = test_pipe.ts_pull_arg;
+	cb_info.bci_rc = rc;
+	test_pipe.ts_pull_cb(&cb_info);
+}
+
+/* reply to the wait in flight that the parent holds avail segments */
+static void
+test_pipe_wait_complete(uint32_t avail, int rc)
+{
+	struct test_pipe_rpc	*rpc = test_pipe.ts_wait;
+	struct crt_cb_info	 cb_info;
+
+	assert_non_null(rpc);
+	test_pipe.ts_wait = NULL;
+	if (rc == 0)
+		test_pipe.ts_parent_avail = avail;
+	rpc->tr_out.csw_avail = avail;
+	rpc->tr_out.csw_rc = rc;
+
+	cb_info.cci_rpc = &rpc->tr_rpc;
+	cb_info.cci_arg = test_pipe.ts_wait_arg;
+	cb_info.cci_rc = 0;
+	test_pipe.ts_wait_cb(&cb_info);
+	D_FREE(rpc);
+}
+
+/* a child of this node waits for want segments of pipe id */
+static void
+test_pipe_child_wait(uint32_t id, uint32_t want)
+{
+	struct test_pipe_rpc	*rpc;
+
+	D_ALLOC_PTR(rpc);
+	assert_non_null(rpc);
+	rpc->tr_rpc.cr_input = &rpc->tr_in;
+	rpc->tr_rpc.cr_output = &rpc->tr_out;
+	rpc->tr_in.csw_id = id;
+	rpc->tr_in.csw_want = want;
+	rpc->tr_ref = 1;
+	test_pipe.ts_child_nr++;
+	crt_hdlr_corpc_seg_wait(&rpc->tr_rpc);
+	/* the handler returned, a parked wait holds its own reference */
+	crt_req_decref(&rpc->tr_rpc);
+}
+
+/*
+ * Receive the corpc from the parent, which holds the whole bulk or only what
+ * it pulled so far. Returns the corpc, and in id the pipe of this node.
+ */
+static struct crt_rpc_priv *
+test_pipe_start(bool parent_complete, uint32_t *id)
+{
+	struct crt_rpc_priv	*rpc_priv;
+	struct crt_corpc_hdr	*co_hdr;
+	uint32_t		 i;
+
+	memset(&test_pipe, 0, sizeof(test_pipe));
+	D_ALLOC(test_pipe.ts_src, PIPE_TEST_LEN);
+	assert_non_null(test_pipe.ts_src);
+	for (i = 0; i < PIPE_TEST_LEN; i++)
+		test_pipe.ts_src[i] = i % 251;
+	test_pipe.ts_parent_bulk.tb_buf = test_pipe.ts_src;
+	test_pipe.ts_parent_bulk.tb_len = PIPE_TEST_LEN;
+	if (parent_complete)
+		test_pipe.ts_parent_avail = PIPE_TEST_SEG_NR;
+
+	memset(&test_pipe_grp, 0, sizeof(test_pipe_grp));
+	test_pipe_grp.gp_pub.cg_grpid = "pipe";
+	test_pipe_grp.gp_primary = 1;
+	test_pipe_grp.gp_local = 1;
+	test_pipe_grp.gp_self = PIPE_TEST_SELF;
+	test_pipe_grp.gp_refcount = 1;
+	assert_int_equal(D_RWLOCK_INIT(&test_pipe_grp.gp_rwlock, NULL), 0);
+	test_pipe_grp_gdata.gg_srv_pri_grp = &test_pipe_grp;
+	crt_gdata.cg_grp = &test_pipe_grp_gdata;
+	crt_gdata.cg_server = true;
+
+	D_ALLOC_PTR(rpc_priv);
+	assert_non_null(rpc_priv);
+	assert_int_equal(D_SPIN_INIT(&rpc_priv->crp_lock,
+				     PTHREAD_PROCESS_PRIVATE), 0);
+	rpc_priv->crp_refcount = 1;
+	rpc_priv->crp_flags = CRT_RPC_FLAG_COLL | CRT_RPC_FLAG_PRIMARY_GRP;
+	rpc_priv->crp_opc_info = &test_pipe_opc_info;
+	rpc_priv->crp_pub.cr_opc = PIPE_TEST_OPC;
+	rpc_priv->crp_pub.cr_ctx = &test_pipe_ctx;
+	rpc_priv->crp_req_hdr.cch_rank = PIPE_TEST_PARENT;
+	co_hdr = &rpc_priv->crp_coreq_hdr;
+	co_hdr->coh_bulk_hdl = &test_pipe.ts_parent_bulk;
+	co_hdr->coh_tree_topo = crt_tree_topo(CRT_TREE_KNOMIAL, 2);
+	co_hdr->coh_root = PIPE_TEST_PARENT;
+	co_hdr->coh_seg = PIPE_TEST_SHIFT |
+			  (PIPE_TEST_PARENT_ID << CRT_CORPC_SEG_ID_SHIFT);
+	if (parent_complete)
+		co_hdr->coh_seg |= CRT_CORPC_SEG_COMPLETE;
+
+	assert_int_equal(crt_corpc_common_hdlr(rpc_priv), 0);
+
+	/* the children pull from this node, which holds part of the bulk */
+	assert_int_equal(co_hdr->coh_seg & CRT_CORPC_SEG_SHIFT_MASK,
+			 PIPE_TEST_SHIFT);
+	assert_int_equal(co_hdr->coh_seg & CRT_CORPC_SEG_COMPLETE, 0);
+	assert_ptr_not_equal(rpc_priv->crp_pub.cr_co_bulk_hdl,
+			     &test_pipe.ts_parent_bulk);
+	assert_int_equal(test_pipe.ts_bulk_nr, 1);
+	*id = co_hdr->coh_seg >> CRT_CORPC_SEG_ID_SHIFT;
+
+	return rpc_priv;
+}
+
+/*
+ * Reply to the parent with the local reply if the pipe did not fail the corpc
+ * itself, check the reply and release the corpc.
+ */
+static void
+test_pipe_finish(struct crt_rpc_priv *rpc_priv, uint32_t id, int rc)
+{
+	struct crt_cb_info	cb_info;
+
+	if (rc == 0) {
+		cb_info.cci_rpc = &rpc_priv->crp_pub;
+		cb_info.cci_rc = 0;
+		cb_info.cci_arg = rpc_priv;
+		crt_corpc_reply_hdlr(&cb_info);
+	}
+	assert_int_equal(test_pipe.ts_reply_nr, 1);
+	assert_int_equal(test_pipe.ts_reply_rc, rc);
+	assert_int_equal(test_pipe.ts_local_nr, rc == 0 ? 1 : 0);
+	assert_false(test_pipe.ts_pulling);
+	assert_null(test_pipe.ts_wait);
+	/* the local bulk is released with the reply */
+	assert_int_equal(test_pipe.ts_bulk_nr, 0);
+
+	/* the pipe is gone for the late children */
+	test_pipe.ts_child_reply_nr = 0;
+	test_pipe_child_wait(id, 1);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 1);
+	assert_int_equal(test_pipe.ts_child_rc, -DER_NONEXIST);
+	assert_int_equal(test_pipe.ts_child_nr, 0);
+
+	RPC_DECREF(rpc_priv);
+	assert_int_equal(test_pipe.ts_destroy_nr, 1);
+	/* what crt_req_destroy() would release */
+	crt_corpc_info_fini(rpc_priv);
+	crt_corpc_pipe_free(rpc_priv->crp_co_pipe);
+	D_SPIN_DESTROY(&rpc_priv->crp_lock);
+	D_FREE(rpc_priv);
+
+	assert_int_equal(test_pipe_grp.gp_refcount, 1);
+	D_RWLOCK_DESTROY(&test_pipe_grp.gp_rwlock);
+	crt_gdata.cg_grp = NULL;
+	crt_gdata.cg_server = false;
+	D_FREE(test_pipe.ts_src);
+}
+
+/* the parent holds the whole bulk, the segments are pulled in turn */
+static void
+test_corpc_pipe_seg(void **state)
+{
+	struct crt_rpc_priv	*rpc_priv;
+	uint32_t		 id;
+	uint32_t		 seg;
+
+	rpc_priv = test_pipe_start(true, &id);
+	assert_true(test_pipe.ts_pulling);
+
+	/* a child waiting for two segments is parked until they landed */
+	test_pipe_child_wait(id, 2);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 0);
+	assert_int_equal(test_pipe.ts_child_nr, 1);
+
+	test_pipe_pull_complete(0);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 0);
+	/* one that asks for what is already there is replied right away */
+	test_pipe_child_wait(id, 1);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 1);
+	assert_int_equal(test_pipe.ts_child_avail, 1);
+	assert_int_equal(test_pipe.ts_child_rc, 0);
+
+	test_pipe_pull_complete(0);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 2);
+	assert_int_equal(test_pipe.ts_child_avail, 2);
+	assert_int_equal(test_pipe.ts_child_rc, 0);
+	assert_int_equal(test_pipe.ts_child_nr, 0);
+
+	for (seg = 2; seg < PIPE_TEST_SEG_NR; seg++) {
+		assert_int_equal(test_pipe.ts_local_nr, 0);
+		test_pipe_pull_complete(0);
+	}
+	assert_int_equal(test_pipe.ts_local_nr, 1);
+	assert_false(test_pipe.ts_pulling);
+	/* the parent holds the whole bulk, it is never asked for more */
+	assert_int_equal(test_pipe.ts_wait_nr, 0);
+
+	/* the pipe stays up for the children until the reply */
+	test_pipe_child_wait(id, PIPE_TEST_SEG_NR);
+	assert_int_equal(test_pipe.ts_child_avail, PIPE_TEST_SEG_NR);
+	assert_int_equal(test_pipe.ts_child_rc, 0);
+
+	test_pipe_finish(rpc_priv, id, 0);
+}
+
+/* the parent pulls the bulk itself, it is asked for the next segments */
+static void
+test_corpc_pipe_seg_wait(void **state)
+{
+	struct crt_rpc_priv	*rpc_priv;
+	uint32_t		 id;
+	uint32_t		 seg;
+
+	rpc_priv = test_pipe_start(false, &id);
+	assert_false(test_pipe.ts_pulling);
+	assert_int_equal(test_pipe.ts_wait_nr, 1);
+	assert_int_equal(test_pipe.ts_wait->tr_in.csw_want, 1);
+
+	/* no wait is sent while the parent holds more than the next one */
+	test_pipe_wait_complete(2, 0);
+	assert_true(test_pipe.ts_pulling);
+	assert_null(test_pipe.ts_wait);
+
+	/* pulling the last one the parent holds asks for more */
+	test_pipe_pull_complete(0);
+	assert_true(test_pipe.ts_pulling);
+	assert_int_equal(test_pipe.ts_wait_nr, 2);
+	assert_int_equal(test_pipe.ts_wait->tr_in.csw_want, 3);
+
+	/* and nothing is pulled past what the parent holds */
+	test_pipe_pull_complete(0);
+	assert_false(test_pipe.ts_pulling);
+	test_pipe_child_wait(id, 3);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 0);
+
+	test_pipe_wait_complete(PIPE_TEST_SEG_NR, 0);
+	assert_true(test_pipe.ts_pulling);
+	for (seg = 2; seg < PIPE_TEST_SEG_NR; seg++)
+		test_pipe_pull_complete(0);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 1);
+	assert_int_equal(test_pipe.ts_child_avail, 3);
+	assert_int_equal(test_pipe.ts_local_nr, 1);
+	assert_int_equal(test_pipe.ts_wait_nr, 2);
+
+	test_pipe_finish(rpc_priv, id, 0);
+}
+
+/* a failed pull, or a failed parent, fails the corpc and the waiters */
+static void
+test_corpc_pipe_fail(void **state)
+{
+	struct crt_rpc_priv	*rpc_priv;
+	uint32_t		 id;
+
+	rpc_priv = test_pipe_start(true, &id);
+	test_pipe_child_wait(id, 3);
+	test_pipe_pull_complete(0);
+	test_pipe_pull_complete(-DER_HG);
+	assert_false(test_pipe.ts_pulling);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 1);
+	assert_int_equal(test_pipe.ts_child_rc, -DER_HG);
+	assert_int_equal(test_pipe.ts_child_nr, 0);
+	test_pipe_finish(rpc_priv, id, -DER_HG);
+
+	rpc_priv = test_pipe_start(false, &id);
+	test_pipe_wait_complete(1, 0);
+	test_pipe_pull_complete(0);
+	/* the parent's own pull failed while this node waited for it */
+	test_pipe_child_wait(id, 2);
+	test_pipe_wait_complete(0, -DER_CANCELED);
+	assert_int_equal(test_pipe.ts_child_reply_nr, 1);
+	assert_int_equal(test_pipe.ts_child_rc, -DER_CANCELED);
+	test_pipe_finish(rpc_priv, id, -DER_CANCELED);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_corpc_pipe_seg),
+		cmocka_unit_test(test_corpc_pipe_seg_wait),
+		cmocka_unit_test(test_corpc_pipe_fail),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
@@ -47,6 +47,7 @@
 #include "gurt/heap.h"
 #include "gurt/dlog.h"
 #include "gurt/hash.h"
+#include "gurt/rank_set.h"
 
 /* machine epsilon */
 #define EPSILON (1.0E-16)
@@ -554,6 +555,293 @@ test_binheap(void **state)
 	d_binheap_destroy(h);
 }
 
+/* check set against a byte map of ranks [0, nr) */
+static void
+test_rank_set_check(d_rank_set_t *set, const uint8_t *map, uint32_t nr)
+{
+	d_rank_list_t	*list = NULL;
+	d_rank_t	 rank;
+	uint32_t	 idx = 0;
+	uint32_t	 i;
+
+	for (i = 0; i < nr; i++) {
+		assert_int_equal(d_rank_set_has(set, i), map[i]);
+		if (!map[i])
+			continue;
+		assert_int_equal(d_rank_set_idx(set, i, &rank), 0);
+		assert_int_equal(rank, idx);
+		assert_int_equal(d_rank_set_rank(set, idx, &rank), 0);
+		assert_int_equal(rank, i);
+		idx++;
+	}
+	assert_int_equal(d_rank_set_nr(set), idx);
+	assert_int_equal(d_rank_set_rank(set, idx, &rank), -DER_NONEXIST);
+
+	assert_int_equal(d_rank_set_to_list(set, &list), 0);
+	assert_int_equal(list->rl_nr, idx);
+	for (i = 1; i < list->rl_nr; i++)
+		assert_true(list->rl_ranks[i - 1] < list->rl_ranks[i]);
+	d_rank_list_free(list);
+}
+
+static void
+test_gurt_rank_set(void **state)
+{
+	d_rank_list_t	*list;
+	d_rank_set_t	*set;
+	d_rank_set_t	*other;
+	d_rank_set_t	*copy;
+	uint8_t		*map;
+	uint8_t		*map2;
+	uint32_t	 nr = 300000;
+	uint32_t	 idx;
+	uint32_t	 i;
+	uint32_t	 n;
+
+	(void)state;
+
+	D_ALLOC_ARRAY(map, nr);
+	assert_non_null(map);
+	D_ALLOC_ARRAY(map2, nr);
+	assert_non_null(map2);
+
+	/* a million consecutive ranks */
+	set = d_rank_set_alloc();
+	assert_non_null(set);
+	assert_int_equal(d_rank_set_add_range(set, 0, 999999), 0);
+	assert_int_equal(d_rank_set_nr(set), 1000000);
+	assert_int_equal(d_rank_set_idx(set, 654321, &idx), 0);
+	assert_int_equal(idx, 654321);
+	assert_int_equal(d_rank_set_idx(set, 1000000, &idx), -DER_NONEXIST);
+	assert_int_equal(d_rank_set_del(set, 500), 0);
+	assert_int_equal(d_rank_set_idx(set, 654321, &idx), 0);
+	assert_int_equal(idx, 654320);
+	d_rank_set_free(set);
+
+	/* unsorted list with duplicates, sparse, dense and contiguous parts */
+	srand(0);
+	list = d_rank_list_alloc(0);
+	assert_non_null(list);
+	for (i = 0; i < nr; i++) {
+		if (i < 100000)
+			map[i] = rand() % 100 == 0;
+		else if (i < 200000)
+			map[i] = rand() % 100 < 60;
+		else
+			map[i] = i % 70000 < 50000;
+	}
+	n = 0;
+	for (i = 0; i < nr; i++)
+		n += map[i];
+	list = d_rank_list_realloc(list, n + 10);
+	assert_non_null(list);
+	n = 0;
+	for (i = nr; i > 0; i--)
+		if (map[i - 1])
+			list->rl_ranks[n++] = i - 1;
+	for (i = 0; i < 10; i++)
+		list->rl_ranks[n++] = list->rl_ranks[i * 7];
+	assert_int_equal(d_rank_set_from_list(&set, list), 0);
+	d_rank_list_free(list);
+	test_rank_set_check(set, map, nr);
+
+	/* single rank updates in every kind of container */
+	for (i = 0; i < 20000; i++) {
+		n = rand() % nr;
+		if (rand() % 2) {
+			assert_int_equal(d_rank_set_add(set, n), 0);
+			map[n] = 1;
+		} else {
+			assert_int_equal(d_rank_set_del(set, n), 0);
+			map[n] = 0;
+		}
+	}
+	test_rank_set_check(set, map, nr);
+
+	/* set operations against another mixed set */
+	other = d_rank_set_alloc();
+	assert_non_null(other);
+	memset(map2, 0, nr);
+	for (i = 0; i < nr; i += 3) {
+		assert_int_equal(d_rank_set_add(other, i), 0);
+		map2[i] = 1;
+	}
+	assert_int_equal(d_rank_set_add_range(other, 150000, 250000), 0);
+	memset(&map2[150000], 1, 100001);
+
+	assert_int_equal(d_rank_set_dup(&copy, set), 0);
+	assert_true(d_rank_set_identical(copy, set));
+	assert_int_equal(d_rank_set_union(copy, other), 0);
+	for (i = 0; i < nr; i++)
+		map2[i] |= 2 * map[i];
+	for (i = 0; i < nr; i++)
+		map[i] = map2[i] != 0;
+	test_rank_set_check(copy, map, nr);
+	d_rank_set_free(copy);
+
+	assert_int_equal(d_rank_set_dup(&copy, set), 0);
+	assert_int_equal(d_rank_set_diff(copy, other), 0);
+	for (i = 0; i < nr; i++)
+		map[i] = map2[i] == 2;
+	test_rank_set_check(copy, map, nr);
+	assert_false(d_rank_set_identical(copy, set));
+	d_rank_set_free(copy);
+
+	assert_int_equal(d_rank_set_dup(&copy, set), 0);
+	assert_int_equal(d_rank_set_intersect(copy, other), 0);
+	for (i = 0; i < nr; i++)
+		map[i] = map2[i] == 3;
+	test_rank_set_check(copy, map, nr);
+	d_rank_set_free(copy);
+
+	/* removing everything leaves an empty set */
+	for (i = 0; i < nr; i++)
+		assert_int_equal(d_rank_set_del(set, i), 0);
+	memset(map, 0, nr);
+	test_rank_set_check(set, map, nr);
+
+	d_rank_set_free(other);
+	d_rank_set_free(set);
+	D_FREE(map2);
+	D_FREE(map);
+}
+
+static int
+test_rank_cmp(const void *a, const void *b)
+{
+	d_rank_t	ra = *(const d_rank_t *)a;
+	d_rank_t	rb = *(const d_rank_t *)b;
+
+	return ra < rb ? -1 : ra > rb;
+}
+
+/*
+ * Check the rank list kernels against straightforward reference versions
+ * (qsort, a membership map) on random lists of nr ranks, and print timings.
+ */
+static void
+test_gurt_rank_list_size(uint32_t nr)
+{
+	d_rank_list_t	*list;
+	d_rank_list_t	*uniq;
+	d_rank_list_t	*filter;
+	d_rank_list_t	*dst;
+	d_rank_t	*ref;
+	uint8_t		*map;
+	struct timespec	 start;
+	struct timespec	 end;
+	double		 sort_secs;
+	double		 qsort_secs;
+	double		 filter_secs;
+	uint32_t	 range = nr * 4;
+	uint32_t	 ref_nr;
+	uint32_t	 idx;
+	uint32_t	 i, j;
+	int		 errors = 0;
+	int		 exclude;
+
+	list = d_rank_list_alloc(nr);
+	assert_non_null(list);
+	filter = d_rank_list_alloc(nr / 2);
+	assert_non_null(filter);
+	D_ALLOC_ARRAY(ref, nr);
+	assert_non_null(ref);
+	D_ALLOC_ARRAY(map, range);
+	assert_non_null(map);
+
+	for (i = 0; i < nr; i++)
+		list->rl_ranks[i] = rand() % range;
+	/* a few ranks above 2^24 so every radix pass runs */
+	list->rl_ranks[0] = 0xfffffffe;
+	list->rl_ranks[nr / 2] = 0x10000000 + nr;
+	for (i = 0; i < filter->rl_nr; i++) {
+		filter->rl_ranks[i] = rand() % range;
+		map[filter->rl_ranks[i]] = 1;
+	}
+
+	/* sort + uniq */
+	memcpy(ref, list->rl_ranks, nr * sizeof(d_rank_t));
+	d_gettime(&start);
+	qsort(ref, nr, sizeof(d_rank_t), test_rank_cmp);
+	d_gettime(&end);
+	qsort_secs = d_timediff_ns(&start, &end) / 1e9;
+	for (ref_nr = 1, i = 1; i < nr; i++)
+		if (ref[i] != ref[ref_nr - 1])
+			ref[ref_nr++] = ref[i];
+
+	d_gettime(&start);
+	assert_int_equal(d_rank_list_dup_sort_uniq(&uniq, list), 0);
+	d_gettime(&end);
+	sort_secs = d_timediff_ns(&start, &end) / 1e9;
+	assert_int_equal(uniq->rl_nr, ref_nr);
+	assert_memory_equal(uniq->rl_ranks, ref, ref_nr * sizeof(d_rank_t));
+
+	/* lookups, first occurrence in the unsorted list */
+	for (i = 0; i < 1000; i++) {
+		j = rand() % nr;
+		assert_int_equal(d_idx_in_rank_list(list, list->rl_ranks[j],
+						    &idx), 0);
+		assert_true(idx <= j);
+		assert_int_equal(list->rl_ranks[idx], list->rl_ranks[j]);
+		if (!d_rank_in_rank_list(uniq, list->rl_ranks[j]))
+			errors++;
+	}
+	assert_false(d_rank_in_rank_list(list, range));
+	assert_int_equal(d_idx_in_rank_list(list, range, &idx),
+			 -DER_NONEXIST);
+
+	/* filter, unsorted and sorted destination, both modes */
+	filter_secs = 0;
+	for (exclude = 0; exclude < 2; exclude++) {
+		for (j = 0; j < 2; j++) {
+			assert_int_equal(d_rank_list_dup(&dst, j ? uniq : list),
+					 0);
+			d_gettime(&start);
+			d_rank_list_filter(filter, dst, exclude);
+			d_gettime(&end);
+			filter_secs += d_timediff_ns(&start, &end) / 1e9;
+
+			ref_nr = 0;
+			for (i = 0; i < (j ? uniq : list)->rl_nr; i++) {
+				d_rank_t r = (j ? uniq : list)->rl_ranks[i];
+				bool member = r < range && map[r];
+
+				if (member != exclude)
+					ref[ref_nr++] = r;
+			}
+			assert_int_equal(dst->rl_nr, ref_nr);
+			assert_memory_equal(dst->rl_ranks, ref,
+					    ref_nr * sizeof(d_rank_t));
+			d_rank_list_free(dst);
+		}
+	}
+	assert_int_equal(errors, 0);
+
+	print_message("%7u ranks: sort+uniq %.3f ms (qsort %.3f ms), "
+		      "filter %.3f ms\n", nr, sort_secs * 1e3,
+		      qsort_secs * 1e3, filter_secs / 4 * 1e3);
+
+	D_FREE(map);
+	D_FREE(ref);
+	d_rank_list_free(uniq);
+	d_rank_list_free(filter);
+	d_rank_list_free(list);
+}
+
+static void
+test_gurt_rank_list(void **state)
+{
+	uint32_t	nr;
+
+	srand(0);
+	for (nr = 1000; nr <= 1000000; nr *= 10)
+		test_gurt_rank_list_size(nr);
+	test_gurt_rank_list_size(1 << 20);
+	/* small lists take the insertion sort and scan paths */
+	for (nr = 2; nr < 80; nr += 7)
+		test_gurt_rank_list_size(nr);
+}
+
 #define LOG_DEBUG(fac, ...) \
 	d_log(fac | DLOG_DBG, __VA_ARGS__)
 
@@ -1637,6 +1925,8 @@ main(int argc, char **argv)
 		cmocka_unit_test(test_gurt_list),
 		cmocka_unit_test(test_gurt_hlist),
 		cmocka_unit_test(test_binheap),
+		cmocka_unit_test(test_gurt_rank_set),
+		cmocka_unit_test(test_gurt_rank_list),
 		cmocka_unit_test(test_log),
 		cmocka_unit_test(test_gurt_hash_empty),
 		cmocka_unit_test(test_gurt_hash_insert_lookup_delete),
@@ -0,0 +1,365 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the address lookup cache of CaRT groups
+ */
+#include <stdio.h>
+#include <malloc.h>
+#include <pthread.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+
+/* number of ranks with a cached URI in each fake group */
+#define LC_TEST_RESOLVED	(1000)
+/* upper bound of the memory used per resolved rank, in bytes */
+#define LC_TEST_RANK_BYTES	(512)
+/* resolved ranks, lookups per thread and threads of the parallel test */
+#define LC_TEST_PAR_RANKS	(1000)
+#define LC_TEST_PAR_LOOKUPS	(10000)
+#define LC_TEST_PAR_THREADS	(4)
+
+struct test_lc_thread_arg {
+	struct crt_grp_priv	*ta_grp_priv;
+	pthread_t		 ta_thread;
+	int			 ta_idx;
+	int			 ta_errors;
+};
+
+static size_t
+test_lc_heap_used(void)
+{
+	struct mallinfo	mi = mallinfo();
+
+	/* large allocations are mmap()ed and accounted in hblkhd */
+	return (size_t)(unsigned int)mi.uordblks +
+	       (size_t)(unsigned int)mi.hblkhd;
+}
+
+static void
+test_lc_grp_init(struct crt_grp_priv *grp_priv, uint32_t size)
+{
+	memset(grp_priv, 0, sizeof(*grp_priv));
+	grp_priv->gp_primary = 1;
+	grp_priv->gp_size = size;
+	D_INIT_LIST_HEAD(&grp_priv->gp_lc_items);
+	assert_int_equal(D_RWLOCK_INIT(&grp_priv->gp_rwlock, NULL), 0);
+}
+
+static void
+test_lc_grp_fini(struct crt_grp_priv *grp_priv)
+{
+	assert_int_equal(crt_grp_lc_destroy(grp_priv), 0);
+	assert_null(grp_priv->gp_lookup_cache);
+	D_RWLOCK_DESTROY(&grp_priv->gp_rwlock);
+}
+
+static void
+test_lc_footprint_size(uint32_t grp_size)
+{
+	struct crt_grp_priv	grp_priv;
+	crt_phy_addr_t		uri;
+	char			uri_str[CRT_ADDR_STR_MAX_LEN];
+	d_rank_t		stride = grp_size / LC_TEST_RESOLVED;
+	d_rank_t		rank;
+	size_t			before;
+	size_t			used;
+	size_t			bound;
+	int			i;
+
+	test_lc_grp_init(&grp_priv, grp_size);
+
+	/* lookups do not create the cache */
+	uri = NULL;
+	assert_int_equal(crt_grp_lc_lookup(&grp_priv, 0, 0, 0, &uri, NULL), 0);
+	assert_null(uri);
+	assert_null(grp_priv.gp_lookup_cache);
+
+	before = test_lc_heap_used();
+	for (i = 0; i < LC_TEST_RESOLVED; i++) {
+		rank = i * stride;
+		snprintf(uri_str, sizeof(uri_str), "ofi+sockets://10.0.0.%d:%d",
+			 i % 256, 31416 + i);
+		assert_int_equal(crt_grp_lc_uri_insert(&grp_priv, 0, rank, 0,
+						       uri_str), 0);
+	}
+	used = test_lc_heap_used() - before;
+
+	/* one pointer per rank plus the items of the resolved ranks */
+	bound = grp_size * sizeof(struct crt_lookup_item *) +
+		LC_TEST_RESOLVED * LC_TEST_RANK_BYTES;
+	print_message("group size %u, %d ranks resolved: %zu bytes (bound "
+		      "%zu)\n", grp_size, LC_TEST_RESOLVED, used, bound);
+	assert_true(used <= bound);
+
+	/* resolved ranks are visible from every context */
+	for (i = 0; i < LC_TEST_RESOLVED; i += 97) {
+		uri = NULL;
+		assert_int_equal(crt_grp_lc_lookup(&grp_priv,
+						   i % CRT_SRV_CONTEXT_NUM,
+						   i * stride, 0, &uri, NULL),
+				 0);
+		assert_non_null(uri);
+	}
+
+	/* unresolved ranks have no item */
+	if (stride > 1) {
+		uri = NULL;
+		assert_int_equal(crt_grp_lc_lookup(&grp_priv, 0, 1, 0, &uri,
+						   NULL), 0);
+		assert_null(uri);
+		assert_null(grp_priv.gp_lookup_cache[1]);
+	}
+
+	test_lc_grp_fini(&grp_priv);
+}
+
+static void
+test_lc_footprint(void **state)
+{
+	test_lc_footprint_size(LC_TEST_RESOLVED);
+	test_lc_footprint_size(100000);
+	test_lc_footprint_size(1000000);
+}
+
+static void
+test_lc_tag_overflow(void **state)
+{
+	struct crt_grp_priv	grp_priv;
+	crt_phy_addr_t		uri;
+	char			uri_str[CRT_ADDR_STR_MAX_LEN];
+	int			tag;
+
+	test_lc_grp_init(&grp_priv, 16);
+
+	/* enough tags to grow the overflow array several times */
+	for (tag = CRT_SRV_CONTEXT_NUM - 1; tag >= 0; tag--) {
+		snprintf(uri_str, sizeof(uri_str), "tcp://host:%d", tag);
+		assert_int_equal(crt_grp_lc_uri_insert(&grp_priv, 0, 3, tag,
+						       uri_str), 0);
+	}
+	/* duplicated inserts keep the first URI */
+	assert_int_equal(crt_grp_lc_uri_insert(&grp_priv, 0, 3, 7, "dup"), 0);
+
+	for (tag = 0; tag < CRT_SRV_CONTEXT_NUM; tag++) {
+		snprintf(uri_str, sizeof(uri_str), "tcp://host:%d", tag);
+		uri = NULL;
+		assert_int_equal(crt_grp_lc_lookup(&grp_priv, 0, 3, tag, &uri,
+						   NULL), 0);
+		assert_non_null(uri);
+		assert_string_equal(uri, uri_str);
+	}
+
+	test_lc_grp_fini(&grp_priv);
+}
+
+static void
+test_lc_resolve_dedup(void **state)
+{
+	struct crt_grp_priv	 grp_priv;
+	struct crt_li_pending	*lp;
+	d_list_t		 waiters[6];
+	hg_addr_t		 hg_addr;
+	int			 i;
+
+	test_lc_grp_init(&grp_priv, 16);
+	for (i = 0; i < 6; i++)
+		D_INIT_LIST_HEAD(&waiters[i]);
+
+	/* the first request resolves, the following ones are parked */
+	assert_int_equal(crt_grp_lc_resolve_begin(&grp_priv, 0, 5, 1,
+						  &waiters[0], &hg_addr), 0);
+	assert_null(hg_addr);
+	for (i = 1; i < 4; i++)
+		assert_int_equal(crt_grp_lc_resolve_begin(&grp_priv, 0, 5, 1,
+							  &waiters[i],
+							  &hg_addr), 1);
+	/* other contexts resolve their own address */
+	assert_int_equal(crt_grp_lc_resolve_begin(&grp_priv, 1, 5, 1,
+						  &waiters[4], &hg_addr), 0);
+
+	/* a parked request can leave once */
+	assert_true(crt_grp_lc_resolve_cancel(&grp_priv, 5, &waiters[2]));
+	assert_false(crt_grp_lc_resolve_cancel(&grp_priv, 5, &waiters[2]));
+
+	lp = crt_grp_lc_resolve_end(&grp_priv, 0, 5, 1);
+	assert_non_null(lp);
+	/* misses after the end start a new resolution */
+	assert_int_equal(crt_grp_lc_resolve_begin(&grp_priv, 0, 5, 1,
+						  &waiters[5], &hg_addr), 0);
+	/* the others are released in order */
+	assert_ptr_equal(crt_li_pending_pop(lp), &waiters[1]);
+	assert_false(crt_grp_lc_resolve_cancel(&grp_priv, 5, &waiters[1]));
+	assert_ptr_equal(crt_li_pending_pop(lp), &waiters[3]);
+	assert_null(crt_li_pending_pop(lp));
+
+	for (i = 0; i < 2; i++) {
+		lp = crt_grp_lc_resolve_end(&grp_priv, i, 5, 1);
+		assert_non_null(lp);
+		assert_null(crt_li_pending_pop(lp));
+		assert_null(crt_grp_lc_resolve_end(&grp_priv, i, 5, 1));
+	}
+
+	test_lc_grp_fini(&grp_priv);
+}
+
+static void *
+test_lc_lookup_thread(void *arg)
+{
+	struct test_lc_thread_arg	*ta = arg;
+	crt_phy_addr_t			 uri;
+	hg_addr_t			 hg_addr;
+	d_rank_t			 rank = ta->ta_idx;
+	int				 i;
+	int				 rc;
+
+	for (i = 0; i < LC_TEST_PAR_LOOKUPS; i++) {
+		/* stride through the resolved ranks */
+		rank = (rank + 7919) % LC_TEST_PAR_RANKS;
+		uri = NULL;
+		hg_addr = NULL;
+		rc = crt_grp_lc_lookup(ta->ta_grp_priv,
+				       ta->ta_idx % CRT_SRV_CONTEXT_NUM,
+				       rank, 0, &uri, &hg_addr);
+		if (rc != 0 || uri == NULL)
+			ta->ta_errors++;
+	}
+
+	return NULL;
+}
+
+/* keep resolving new ranks while the lookup threads run */
+static void *
+test_lc_insert_thread(void *arg)
+{
+	struct test_lc_thread_arg	*ta = arg;
+	char				 uri_str[CRT_ADDR_STR_MAX_LEN];
+	d_rank_t			 rank;
+
+	for (rank = LC_TEST_PAR_RANKS; rank < ta->ta_grp_priv->gp_size;
+	     rank++) {
+		snprintf(uri_str, sizeof(uri_str), "tcp://host%d:31416", rank);
+		if (crt_grp_lc_uri_insert(ta->ta_grp_priv, 0, rank, 0,
+					  uri_str) != 0)
+			ta->ta_errors++;
+	}
+
+	return NULL;
+}
+
+/* lookups from several threads racing with the insertion of new ranks */
+static void
+test_lc_lookup_parallel(void **state)
+{
+	struct crt_grp_priv		grp_priv;
+	struct test_lc_thread_arg	args[LC_TEST_PAR_THREADS];
+	struct test_lc_thread_arg	writer;
+	char				uri_str[CRT_ADDR_STR_MAX_LEN];
+	crt_phy_addr_t			uri;
+	d_rank_t			rank;
+	int				i;
+
+	test_lc_grp_init(&grp_priv, 2 * LC_TEST_PAR_RANKS);
+	for (rank = 0; rank < LC_TEST_PAR_RANKS; rank++) {
+		snprintf(uri_str, sizeof(uri_str), "tcp://host%d:31416", rank);
+		assert_int_equal(crt_grp_lc_uri_insert(&grp_priv, 0, rank, 0,
+						       uri_str), 0);
+	}
+
+	memset(&writer, 0, sizeof(writer));
+	writer.ta_grp_priv = &grp_priv;
+	assert_int_equal(pthread_create(&writer.ta_thread, NULL,
+					test_lc_insert_thread, &writer), 0);
+	for (i = 0; i < LC_TEST_PAR_THREADS; i++) {
+		memset(&args[i], 0, sizeof(args[i]));
+		args[i].ta_grp_priv = &grp_priv;
+		args[i].ta_idx = i;
+		assert_int_equal(pthread_create(&args[i].ta_thread, NULL,
+						test_lc_lookup_thread,
+						&args[i]), 0);
+	}
+	for (i = 0; i < LC_TEST_PAR_THREADS; i++) {
+		pthread_join(args[i].ta_thread, NULL);
+		assert_int_equal(args[i].ta_errors, 0);
+	}
+	pthread_join(writer.ta_thread, NULL);
+	assert_int_equal(writer.ta_errors, 0);
+
+	/* every rank inserted by the writer is visible */
+	for (rank = 0; rank < grp_priv.gp_size; rank++) {
+		snprintf(uri_str, sizeof(uri_str), "tcp://host%d:31416", rank);
+		uri = NULL;
+		assert_int_equal(crt_grp_lc_lookup(&grp_priv, rank % 2, rank,
+						   0, &uri, NULL), 0);
+		assert_non_null(uri);
+		assert_string_equal(uri, uri_str);
+	}
+
+	test_lc_grp_fini(&grp_priv);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_lc_footprint),
+		cmocka_unit_test(test_lc_tag_overflow),
+		cmocka_unit_test(test_lc_resolve_dedup),
+		cmocka_unit_test(test_lc_lookup_parallel),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
@@ -0,0 +1,128 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the primary to subgroup rank translation of CaRT groups
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+
+static void
+test_p2s_size(uint32_t nr, uint32_t stride)
+{
+	struct crt_grp_priv	grp_priv;
+	d_rank_t		rank;
+	uint32_t		i;
+
+	memset(&grp_priv, 0, sizeof(grp_priv));
+	grp_priv.gp_membs = d_rank_list_alloc(nr);
+	assert_non_null(grp_priv.gp_membs);
+	for (i = 0; i < nr; i++)
+		grp_priv.gp_membs->rl_ranks[i] = 3 + i * stride;
+	grp_priv.gp_size = nr;
+	assert_int_equal(crt_grp_membs_idx_init(&grp_priv), 0);
+	if (stride <= CRT_GRP_MEMBS_IDX_DENSITY)
+		assert_non_null(grp_priv.gp_membs_idx);
+	else
+		assert_null(grp_priv.gp_membs_idx);
+
+	for (i = 0; i < nr; i++) {
+		assert_int_equal(crt_grp_rank_p2s(&grp_priv,
+						  3 + i * stride, &rank), 0);
+		assert_int_equal(rank, i);
+		if (stride > 1)
+			assert_int_equal(crt_grp_rank_p2s(&grp_priv,
+							  4 + i * stride,
+							  &rank), -DER_OOG);
+	}
+	assert_int_equal(crt_grp_rank_p2s(&grp_priv, 2, &rank), -DER_OOG);
+	assert_int_equal(crt_grp_rank_p2s(&grp_priv, 3 + nr * stride, &rank),
+			 -DER_OOG);
+
+	crt_grp_membs_idx_fini(&grp_priv);
+	assert_null(grp_priv.gp_membs_idx);
+	d_rank_list_free(grp_priv.gp_membs);
+}
+
+/* member lists dense enough for the reverse index */
+static void
+test_p2s_index(void **state)
+{
+	test_p2s_size(1, 1);
+	test_p2s_size(1000, 1);
+	test_p2s_size(1000, 2);
+	test_p2s_size(1000, CRT_GRP_MEMBS_IDX_DENSITY);
+}
+
+/* sparse member lists, translated by a binary search of gp_membs */
+static void
+test_p2s_search(void **state)
+{
+	test_p2s_size(1000, CRT_GRP_MEMBS_IDX_DENSITY + 1);
+	test_p2s_size(1000, 100);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_p2s_index),
+		cmocka_unit_test(test_p2s_search),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
@@ -0,0 +1,237 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the built-in reductions of CaRT collective RPCs
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+
+/* elements of the reduced arrays, not a multiple of the vector width */
+#define REDUCE_TEST_NR		(1003)
+
+/* scalar reference of element i of the reduction */
+static void
+test_reduce_ref(int type, int op, void *dst, const void *src_a,
+		const void *src_b, size_t i)
+{
+	int32_t		ia, ib;
+	int64_t		la, lb;
+	uint64_t	ua, ub;
+	double		da, db;
+
+	switch (type) {
+	case CRT_REDUCE_INT32:
+		ia = ((const int32_t *)src_a)[i];
+		ib = ((const int32_t *)src_b)[i];
+		((int32_t *)dst)[i] =
+			op == CRT_REDUCE_SUM ? (int32_t)((uint32_t)ia + ib) :
+			op == CRT_REDUCE_MIN ? (ia < ib ? ia : ib) :
+			op == CRT_REDUCE_MAX ? (ia > ib ? ia : ib) :
+			op == CRT_REDUCE_BAND ? ia & ib :
+			op == CRT_REDUCE_BOR ? ia | ib : ia ^ ib;
+		break;
+	case CRT_REDUCE_INT64:
+		la = ((const int64_t *)src_a)[i];
+		lb = ((const int64_t *)src_b)[i];
+		((int64_t *)dst)[i] =
+			op == CRT_REDUCE_SUM ? (int64_t)((uint64_t)la + lb) :
+			op == CRT_REDUCE_MIN ? (la < lb ? la : lb) :
+			op == CRT_REDUCE_MAX ? (la > lb ? la : lb) :
+			op == CRT_REDUCE_BAND ? la & lb :
+			op == CRT_REDUCE_BOR ? la | lb : la ^ lb;
+		break;
+	case CRT_REDUCE_UINT64:
+		ua = ((const uint64_t *)src_a)[i];
+		ub = ((const uint64_t *)src_b)[i];
+		((uint64_t *)dst)[i] =
+			op == CRT_REDUCE_SUM ? ua + ub :
+			op == CRT_REDUCE_MIN ? (ua < ub ? ua : ub) :
+			op == CRT_REDUCE_MAX ? (ua > ub ? ua : ub) :
+			op == CRT_REDUCE_BAND ? ua & ub :
+			op == CRT_REDUCE_BOR ? ua | ub : ua ^ ub;
+		break;
+	default:
+		da = ((const double *)src_a)[i];
+		db = ((const double *)src_b)[i];
+		((double *)dst)[i] =
+			op == CRT_REDUCE_SUM ? da + db :
+			op == CRT_REDUCE_MIN ? (da < db ? da : db) :
+			(da > db ? da : db);
+		break;
+	}
+}
+
+/* built-in corpc reductions against a scalar reference */
+static void
+test_reduce(void **state)
+{
+	struct crt_corpc_reduce	 reduce;
+	struct crt_rpc_priv	*rpc_priv;
+	struct {
+		uint32_t	 out_rc;
+		d_iov_t		 out_iov;
+	}			 result, source;
+	uint64_t		 a[REDUCE_TEST_NR];
+	uint64_t		 b[REDUCE_TEST_NR];
+	uint64_t		 dst[REDUCE_TEST_NR];
+	uint64_t		 ref[REDUCE_TEST_NR];
+	double			 da[REDUCE_TEST_NR];
+	double			 db[REDUCE_TEST_NR];
+	int64_t			 sum[REDUCE_TEST_NR];
+	crt_rpc_t		 source_rpc = { .cr_output = &source };
+	const void		*sa, *sb;
+	size_t			 nr;
+	size_t			 i;
+	int			 type;
+	int			 op;
+
+	for (i = 0; i < REDUCE_TEST_NR; i++) {
+		a[i] = ((uint64_t)random() << 33) ^ random();
+		b[i] = ((uint64_t)random() << 33) ^ random();
+		da[i] = (int32_t)a[i] / 7.0;
+		db[i] = (int32_t)b[i] / 3.0;
+	}
+
+	for (type = 0; type < CRT_REDUCE_TYPE_NR; type++) {
+		for (op = 0; op < CRT_REDUCE_OP_NR; op++) {
+			reduce.cr_type = type;
+			reduce.cr_op = op;
+			reduce.cr_offset = 0;
+			if (type == CRT_REDUCE_DOUBLE &&
+			    op >= CRT_REDUCE_BAND) {
+				assert_int_equal(crt_reduce_check(&reduce,
+						 sizeof(d_iov_t)), -DER_INVAL);
+				continue;
+			}
+			assert_int_equal(crt_reduce_check(&reduce,
+							  sizeof(d_iov_t)), 0);
+
+			sa = type == CRT_REDUCE_DOUBLE ? (void *)da : a;
+			sb = type == CRT_REDUCE_DOUBLE ? (void *)db : b;
+			nr = type == CRT_REDUCE_INT32 ?
+			     REDUCE_TEST_NR * 2 : REDUCE_TEST_NR;
+			for (i = 0; i < nr; i++)
+				test_reduce_ref(type, op, ref, sa, sb, i);
+
+			/* every length up to a few vectors */
+			for (i = 0; i < 17; i++) {
+				memset(dst, 0, sizeof(dst));
+				crt_reduce_array(type, op, dst, sa, sb, i);
+				assert_memory_equal(dst, ref, i * (type ==
+					CRT_REDUCE_INT32 ? 4 : 8));
+			}
+			/* the whole arrays, in place */
+			memcpy(dst, sa, sizeof(dst));
+			crt_reduce_array(type, op, dst, dst, sb, nr);
+			assert_memory_equal(dst, ref, sizeof(dst));
+		}
+	}
+
+	reduce.cr_type = CRT_REDUCE_INT32;
+	reduce.cr_op = CRT_REDUCE_OP_NR;
+	assert_int_equal(crt_reduce_check(&reduce, sizeof(result)), -DER_INVAL);
+	reduce.cr_op = CRT_REDUCE_SUM;
+	reduce.cr_offset = offsetof(typeof(result), out_iov) + 1;
+	assert_int_equal(crt_reduce_check(&reduce, sizeof(result)), -DER_INVAL);
+
+	/* reduce three replies into a result, the first one being empty */
+	D_ALLOC_PTR(rpc_priv);
+	assert_non_null(rpc_priv);
+	rpc_priv->crp_pub.cr_output = &result;
+	reduce.cr_type = CRT_REDUCE_INT64;
+	reduce.cr_offset = offsetof(typeof(result), out_iov);
+	assert_int_equal(crt_reduce_check(&reduce, sizeof(result)), 0);
+	memset(&result, 0, sizeof(result));
+	memset(&source, 0, sizeof(source));
+	for (i = 0; i < REDUCE_TEST_NR; i++)
+		sum[i] = i;
+	d_iov_set(&result.out_iov, sum, sizeof(sum));
+	assert_int_equal(crt_reduce_reply(rpc_priv, &source_rpc, &reduce), 0);
+	assert_ptr_equal(result.out_iov.iov_buf, sum);
+	d_iov_set(&source.out_iov, a, sizeof(a));
+	for (i = 0; i < 2; i++) {
+		assert_int_equal(crt_reduce_reply(rpc_priv, &source_rpc,
+						  &reduce), 0);
+		assert_ptr_equal(result.out_iov.iov_buf,
+				 rpc_priv->crp_co_reduce_buf);
+	}
+	for (i = 0; i < REDUCE_TEST_NR; i++) {
+		/* the handler's buffer is left untouched */
+		assert_int_equal(sum[i], i);
+		assert_int_equal(((int64_t *)result.out_iov.iov_buf)[i],
+				 (int64_t)(i + 2 * a[i]));
+	}
+
+	/* mismatching lengths are a protocol error */
+	d_iov_set(&source.out_iov, a, sizeof(a) / 2);
+	assert_int_equal(crt_reduce_reply(rpc_priv, &source_rpc, &reduce),
+			 -DER_PROTO);
+
+	D_FREE(rpc_priv->crp_co_reduce_buf);
+	D_FREE(rpc_priv);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_reduce),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
@@ -0,0 +1,547 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file tests the topologies of the CaRT collective RPC trees and the
+ * cache of the tree nodes of a group
+ */
+#include <stdio.h>
+#include "utest_cmocka.h"
+#include "crt_internal.h"
+
+/*
+ * Broadcast over the tree of every rank on a simulated layout. Each send
+ * costs TREE_TEST_SEND_COST to the sender, in the order of its children
+ * list, and takes TREE_TEST_INTER_COST more to cross hosts or
+ * TREE_TEST_INTRA_COST within a host.
+ */
+#define TREE_TEST_SEND_COST	(1)
+#define TREE_TEST_INTER_COST	(20)
+#define TREE_TEST_INTRA_COST	(2)
+
+struct test_tree_cost {
+	uint32_t	tb_inter_msgs;
+	uint32_t	tb_inter_depth;
+	uint32_t	tb_time;
+};
+
+static void
+test_tree_bcast(uint32_t size, uint32_t root, const uint32_t *hosts,
+		uint32_t host_nr, int tree_type, uint32_t ratio,
+		struct test_tree_cost *tb)
+{
+	uint32_t	*children;
+	uint32_t	*arrival;
+	uint32_t	*inter_depth;
+	uint32_t	*queue;
+	uint32_t	 nchildren;
+	uint32_t	 parent;
+	uint32_t	 head = 0, tail = 0;
+	uint32_t	 self, child;
+	uint32_t	 i;
+
+	D_ALLOC_ARRAY(children, size);
+	D_ALLOC_ARRAY(arrival, size);
+	D_ALLOC_ARRAY(inter_depth, size);
+	D_ALLOC_ARRAY(queue, size);
+	assert_non_null(children);
+	assert_non_null(arrival);
+	assert_non_null(inter_depth);
+	assert_non_null(queue);
+	for (i = 0; i < size; i++)
+		arrival[i] = UINT32_MAX;
+
+	memset(tb, 0, sizeof(*tb));
+	arrival[root] = 0;
+	queue[tail++] = root;
+	while (head < tail) {
+		self = queue[head++];
+		if (tree_type == CRT_TREE_HIER) {
+			assert_int_equal(crt_hier_get_children(size, ratio,
+					 root, self, hosts, host_nr, children,
+					 &nchildren), 0);
+		} else {
+			assert_int_equal(crt_knomial_ops.to_get_children_cnt(
+					 size, ratio, root, self, &nchildren),
+					 0);
+			assert_int_equal(crt_knomial_ops.to_get_children(size,
+					 ratio, root, self, children), 0);
+		}
+		for (i = 0; i < nchildren; i++) {
+			child = children[i];
+			/* every rank is reached exactly once */
+			assert_int_equal(arrival[child], UINT32_MAX);
+			if (tree_type == CRT_TREE_HIER)
+				assert_int_equal(crt_hier_get_parent(size,
+						 ratio, root, child, hosts,
+						 host_nr, &parent), 0);
+			else
+				assert_int_equal(crt_knomial_ops.to_get_parent(
+						 size, ratio, root, child,
+						 &parent), 0);
+			assert_int_equal(parent, self);
+
+			arrival[child] = arrival[self] +
+					 (i + 1) * TREE_TEST_SEND_COST;
+			inter_depth[child] = inter_depth[self];
+			if (hosts[child] != hosts[self]) {
+				arrival[child] += TREE_TEST_INTER_COST;
+				inter_depth[child]++;
+				tb->tb_inter_msgs++;
+			} else {
+				arrival[child] += TREE_TEST_INTRA_COST;
+			}
+			tb->tb_time = max(tb->tb_time, arrival[child]);
+			tb->tb_inter_depth = max(tb->tb_inter_depth,
+						 inter_depth[child]);
+			queue[tail++] = child;
+		}
+	}
+	assert_int_equal(tail, size);
+
+	D_FREE(queue);
+	D_FREE(inter_depth);
+	D_FREE(arrival);
+	D_FREE(children);
+}
+
+static void
+test_tree_hier_layout(uint32_t host_nr, uint32_t ppn, bool cyclic,
+		      uint32_t root)
+{
+	struct test_tree_cost	knomial;
+	struct test_tree_cost	hier;
+	uint32_t		*hosts;
+	uint32_t		 size = host_nr * ppn;
+	uint32_t		 i;
+
+	D_ALLOC_ARRAY(hosts, size);
+	assert_non_null(hosts);
+	for (i = 0; i < size; i++)
+		hosts[i] = cyclic ? i % host_nr : i / ppn;
+
+	test_tree_bcast(size, root, hosts, host_nr, CRT_TREE_KNOMIAL, 4,
+			&knomial);
+	test_tree_bcast(size, root, hosts, host_nr, CRT_TREE_HIER, 4,
+			&hier);
+	/* the network is crossed once per host */
+	assert_int_equal(hier.tb_inter_msgs, host_nr - 1);
+	assert_true(hier.tb_inter_msgs <= knomial.tb_inter_msgs);
+
+	print_message("%u hosts x %u %s, root %u: inter-host msgs %u -> %u, "
+		      "depth %u -> %u, time %u -> %u\n", host_nr, ppn,
+		      cyclic ? "cyclic" : "block", root,
+		      knomial.tb_inter_msgs, hier.tb_inter_msgs,
+		      knomial.tb_inter_depth, hier.tb_inter_depth,
+		      knomial.tb_time, hier.tb_time);
+	D_FREE(hosts);
+}
+
+/* CRT_TREE_HIER against CRT_TREE_KNOMIAL on simulated multi-host layouts */
+static void
+test_tree_hier(void **state)
+{
+	uint32_t	hosts[1] = {0};
+	uint32_t	children[1];
+	uint32_t	nchildren;
+	uint32_t	parent;
+
+	/* a single rank is a leaf root */
+	assert_int_equal(crt_hier_get_children(1, 2, 0, 0, hosts, 1, children,
+					       &nchildren), 0);
+	assert_int_equal(nchildren, 0);
+	assert_int_equal(crt_hier_get_parent(1, 2, 0, 0, hosts, 1, &parent),
+			 -DER_INVAL);
+
+	test_tree_hier_layout(1, 16, false, 0);
+	test_tree_hier_layout(16, 1, false, 3);
+	test_tree_hier_layout(64, 16, false, 0);
+	test_tree_hier_layout(64, 16, true, 0);
+	test_tree_hier_layout(64, 16, false, 517);
+	test_tree_hier_layout(100, 7, true, 99);
+}
+
+/* the primary group crt_grp_pub2priv(NULL) returns */
+static struct crt_grp_priv	*test_tree_primary;
+
+struct crt_grp_priv *__real_crt_grp_pub2priv(crt_group_t *grp);
+
+struct crt_grp_priv *
+__wrap_crt_grp_pub2priv(crt_group_t *grp)
+{
+	if (grp == NULL && test_tree_primary != NULL)
+		return test_tree_primary;
+
+	return __real_crt_grp_pub2priv(grp);
+}
+
+/* a primary group of size live ranks, at membership version 1 */
+static void
+test_tree_grp_init(struct crt_grp_priv *grp_priv, pthread_rwlock_t *rwlock,
+		   const char *grpid, uint32_t size)
+{
+	d_rank_t	rank;
+
+	memset(grp_priv, 0, sizeof(*grp_priv));
+	grp_priv->gp_primary = 1;
+	grp_priv->gp_pub.cg_grpid = (char *)grpid;
+	grp_priv->gp_size = size;
+	grp_priv->gp_membs_ver = 1;
+	grp_priv->gp_membs = d_rank_list_alloc(size);
+	assert_non_null(grp_priv->gp_membs);
+	for (rank = 0; rank < size; rank++)
+		grp_priv->gp_membs->rl_ranks[rank] = rank;
+	grp_priv->gp_live_set = d_rank_set_alloc();
+	assert_non_null(grp_priv->gp_live_set);
+	assert_int_equal(d_rank_set_add_range(grp_priv->gp_live_set, 0,
+					      size - 1), 0);
+	assert_int_equal(D_RWLOCK_INIT(rwlock, NULL), 0);
+	grp_priv->gp_rwlock_ft = rwlock;
+	assert_int_equal(crt_tree_cache_init(grp_priv), 0);
+	test_tree_primary = grp_priv;
+}
+
+static void
+test_tree_grp_fini(struct crt_grp_priv *grp_priv)
+{
+	test_tree_primary = NULL;
+	crt_tree_cache_fini(grp_priv);
+	D_RWLOCK_DESTROY(grp_priv->gp_rwlock_ft);
+	d_rank_set_free(grp_priv->gp_live_set);
+	d_rank_list_free(grp_priv->gp_membs);
+}
+
+/* number of tree nodes cached for the current membership version */
+static int
+test_tree_cache_nr(struct crt_grp_priv *grp_priv)
+{
+	int	nr = 0;
+	int	i;
+
+	for (i = 0; i < CRT_TREE_CACHE_NR; i++)
+		if (grp_priv->gp_tree_cache[i].tc_valid &&
+		    grp_priv->gp_tree_cache[i].tc_membs_ver ==
+		    grp_priv->gp_membs_ver)
+			nr++;
+
+	return nr;
+}
+
+/*
+ * Query nchildren of self in the tree, and check that it was a cache hit or
+ * a miss, going by whether a node got installed.
+ */
+static int
+test_tree_cache_query(struct crt_grp_priv *grp_priv, d_rank_list_t *filter,
+		      bool incl, int tree_topo, d_rank_t root, d_rank_t self,
+		      bool hit, uint32_t *nchildren)
+{
+	int	nr;
+	int	rc;
+
+	nr = test_tree_cache_nr(grp_priv);
+	rc = crt_tree_get_nchildren(grp_priv, grp_priv->gp_membs_ver, filter,
+				    incl, tree_topo, root, self, nchildren);
+	assert_int_equal(test_tree_cache_nr(grp_priv), hit ? nr : nr + 1);
+
+	return rc;
+}
+
+/* the memoized tree nodes are only reused for the exact same tree */
+static void
+test_tree_cache(void **state)
+{
+	struct crt_grp_priv	 grp_priv;
+	pthread_rwlock_t	 rwlock;
+	d_rank_list_t		*filter;
+	d_rank_list_t		*filter_dup;
+	d_rank_list_t		*children = NULL;
+	d_rank_list_t		 empty = {0};
+	uint32_t		 size = 16;
+	uint32_t		 nchildren;
+	uint32_t		 knomial;
+	int			 topo_knomial;
+	int			 topo_flat;
+	d_rank_t		 rank;
+
+	test_tree_grp_init(&grp_priv, &rwlock, "tree_cache", size);
+
+	topo_knomial = crt_tree_topo(CRT_TREE_KNOMIAL, 2);
+	topo_flat = crt_tree_topo(CRT_TREE_FLAT, 0);
+
+	/* the same query hits, whichever of the queries asks it */
+	assert_int_equal(test_tree_cache_query(&grp_priv, NULL, false,
+			 topo_knomial, 0, 0, false, &knomial), 0);
+	assert_int_equal(knomial, 4);
+	assert_int_equal(test_tree_cache_query(&grp_priv, NULL, false,
+			 topo_knomial, 0, 0, true, &nchildren), 0);
+	assert_int_equal(nchildren, knomial);
+	assert_int_equal(crt_tree_get_children(&grp_priv,
+			 grp_priv.gp_membs_ver, NULL, false, topo_knomial, 0,
+			 0, &children, NULL), 0);
+	assert_int_equal(test_tree_cache_nr(&grp_priv), 1);
+	assert_non_null(children);
+	assert_int_equal(children->rl_nr, knomial);
+	d_rank_list_free(children);
+
+	/* other root or topo miss */
+	assert_int_equal(test_tree_cache_query(&grp_priv, NULL, false,
+			 topo_knomial, 1, 0, false, &nchildren), 0);
+	assert_int_equal(nchildren, 0);
+	assert_int_equal(test_tree_cache_query(&grp_priv, NULL, false,
+			 topo_flat, 0, 0, false, &nchildren), 0);
+	assert_int_equal(nchildren, size - 1);
+
+	/* filters match by value, not by list */
+	filter = d_rank_list_alloc(1);
+	filter_dup = d_rank_list_alloc(1);
+	assert_non_null(filter);
+	assert_non_null(filter_dup);
+	filter->rl_ranks[0] = 3;
+	filter_dup->rl_ranks[0] = 3;
+	assert_int_equal(test_tree_cache_query(&grp_priv, filter, false,
+			 topo_flat, 0, 0, false, &nchildren), 0);
+	assert_int_equal(nchildren, size - 2);
+	assert_int_equal(test_tree_cache_query(&grp_priv, filter_dup, false,
+			 topo_flat, 0, 0, true, &nchildren), 0);
+	assert_int_equal(nchildren, size - 2);
+	filter_dup->rl_ranks[0] = 4;
+	assert_int_equal(test_tree_cache_query(&grp_priv, filter_dup, false,
+			 topo_flat, 0, 0, false, &nchildren), 0);
+	assert_int_equal(nchildren, size - 2);
+	d_rank_list_free(filter_dup);
+	d_rank_list_free(filter);
+
+	/*
+	 * An empty exclusion list is no filter while an empty inclusion list
+	 * leaves no rank, flipping the flag must not hit the other one.
+	 */
+	assert_int_equal(test_tree_cache_query(&grp_priv, &empty, false,
+			 topo_flat, 0, 0, true, &nchildren), 0);
+	assert_int_equal(nchildren, size - 1);
+	assert_int_equal(test_tree_cache_query(&grp_priv, &empty, true,
+			 topo_flat, 0, 0, false, &nchildren), -DER_INVAL);
+	assert_int_equal(test_tree_cache_query(&grp_priv, &empty, true,
+			 topo_flat, 0, 0, true, &nchildren), -DER_INVAL);
+	assert_int_equal(test_tree_cache_query(&grp_priv, &empty, false,
+			 topo_flat, 0, 0, true, &nchildren), 0);
+	assert_int_equal(nchildren, size - 1);
+
+	/* an eviction bumps the version, the nodes of the old one are gone */
+	assert_int_equal(d_rank_set_del(grp_priv.gp_live_set, 7), 0);
+	grp_priv.gp_membs_ver++;
+	assert_int_equal(test_tree_cache_query(&grp_priv, NULL, false,
+			 topo_flat, 0, 0, false, &nchildren), 0);
+	assert_int_equal(nchildren, size - 2);
+	for (rank = 0; rank < CRT_TREE_CACHE_NR; rank++)
+		assert_true(!grp_priv.gp_tree_cache[rank].tc_valid ||
+			    grp_priv.gp_tree_cache[rank].tc_membs_ver ==
+			    grp_priv.gp_membs_ver);
+	assert_int_equal(test_tree_cache_query(&grp_priv, NULL, false,
+			 topo_knomial, 0, 0, false, &nchildren), 0);
+	assert_int_equal(test_tree_cache_query(&grp_priv, NULL, false,
+			 topo_knomial, 0, 0, true, &nchildren), 0);
+
+	test_tree_grp_fini(&grp_priv);
+}
+
+/*
+ * Walk the tree of an inclusion list from root. It has to reach every live
+ * rank of the list exactly once, each from its parent, and no other rank.
+ */
+static void
+test_tree_incl_walk(struct crt_grp_priv *grp_priv, d_rank_list_t *incl,
+		    int tree_topo, d_rank_t root, bool *in_tree)
+{
+	d_rank_list_t	*children;
+	d_rank_t	*queue;
+	bool		*reached;
+	uint32_t	 size = grp_priv->gp_size;
+	uint32_t	 head = 0, tail = 0;
+	uint32_t	 nchildren;
+	d_rank_t	 parent;
+	d_rank_t	 self, child;
+	uint32_t	 i;
+
+	D_ALLOC_ARRAY(queue, size);
+	D_ALLOC_ARRAY(reached, size);
+	assert_non_null(queue);
+	assert_non_null(reached);
+
+	reached[root] = true;
+	queue[tail++] = root;
+	while (head < tail) {
+		self = queue[head++];
+		assert_true(in_tree[self]);
+		assert_int_equal(crt_tree_get_nchildren(grp_priv,
+				 grp_priv->gp_membs_ver, incl, true,
+				 tree_topo, root, self, &nchildren), 0);
+		children = NULL;
+		assert_int_equal(crt_tree_get_children(grp_priv,
+				 grp_priv->gp_membs_ver, incl, true,
+				 tree_topo, root, self, &children, NULL), 0);
+		if (nchildren == 0) {
+			assert_null(children);
+			continue;
+		}
+		assert_non_null(children);
+		assert_int_equal(children->rl_nr, nchildren);
+		for (i = 0; i < nchildren; i++) {
+			child = children->rl_ranks[i];
+			assert_true(child < size);
+			assert_false(reached[child]);
+			assert_int_equal(crt_tree_get_parent(grp_priv,
+					 grp_priv->gp_membs_ver, incl, true,
+					 tree_topo, root, child, &parent), 0);
+			assert_int_equal(parent, self);
+			reached[child] = true;
+			queue[tail++] = child;
+		}
+		d_rank_list_free(children);
+	}
+
+	for (i = 0; i < size; i++)
+		assert_int_equal(reached[i], in_tree[i]);
+
+	D_FREE(reached);
+	D_FREE(queue);
+}
+
+/* trees over sparse inclusion lists, with duplicates and evicted ranks */
+static void
+test_tree_incl(void **state)
+{
+	struct crt_grp_priv	 grp_priv;
+	pthread_rwlock_t	 rwlock;
+	d_rank_list_t		*incl;
+	bool			*in_tree;
+	uint32_t		 size = 1000;
+	uint32_t		 nchildren;
+	uint32_t		 incl_nr;
+	int			 topos[4];
+	d_rank_t		 root;
+	d_rank_t		 rank;
+	uint32_t		 i, j;
+
+	test_tree_grp_init(&grp_priv, &rwlock, "tree_incl", size);
+	for (rank = 5; rank < size; rank += 97)
+		assert_int_equal(d_rank_set_del(grp_priv.gp_live_set, rank),
+				 0);
+	grp_priv.gp_membs_ver++;
+
+	topos[0] = crt_tree_topo(CRT_TREE_KNOMIAL, 2);
+	topos[1] = crt_tree_topo(CRT_TREE_KNOMIAL, 4);
+	topos[2] = crt_tree_topo(CRT_TREE_KARY, 3);
+	topos[3] = crt_tree_topo(CRT_TREE_FLAT, 0);
+
+	D_ALLOC_ARRAY(in_tree, size);
+	assert_non_null(in_tree);
+	for (i = 0; i < 40; i++) {
+		incl_nr = 1 + random() % 64;
+		incl = d_rank_list_alloc(incl_nr);
+		assert_non_null(incl);
+		memset(in_tree, 0, size * sizeof(*in_tree));
+		root = -1;
+		for (j = 0; j < incl_nr; j++) {
+			/* some duplicates, out of order */
+			if (j > 0 && random() % 8 == 0)
+				rank = incl->rl_ranks[random() % j];
+			else
+				rank = random() % size;
+			incl->rl_ranks[j] = rank;
+			in_tree[rank] = d_rank_set_has(grp_priv.gp_live_set,
+							rank);
+			if (in_tree[rank] && root == -1)
+				root = rank;
+		}
+		if (root == -1) {
+			d_rank_list_free(incl);
+			continue;
+		}
+
+		for (j = 0; j < ARRAY_SIZE(topos); j++) {
+			test_tree_incl_walk(&grp_priv, incl, topos[j], root,
+					    in_tree);
+
+			/* ranks out of the list or evicted are not in it */
+			for (rank = 0; rank < size; rank += 7) {
+				if (in_tree[rank])
+					continue;
+				assert_int_not_equal(crt_tree_get_nchildren(
+						 &grp_priv,
+						 grp_priv.gp_membs_ver, incl,
+						 true, topos[j], root, rank,
+						 &nchildren), 0);
+			}
+		}
+		d_rank_list_free(incl);
+	}
+
+	D_FREE(in_tree);
+	test_tree_grp_fini(&grp_priv);
+}
+
+static int
+init_tests(void **state)
+{
+	int	rc;
+
+	rc = d_log_init();
+	if (rc != 0)
+		return rc;
+
+	return crt_setup_log_fac();
+}
+
+static int
+fini_tests(void **state)
+{
+	d_log_fini();
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct CMUnitTest	tests[] = {
+		cmocka_unit_test(test_tree_hier),
+		cmocka_unit_test(test_tree_cache),
+		cmocka_unit_test(test_tree_incl),
+	};
+
+	return cmocka_run_group_tests(tests, init_tests, fini_tests);
+}
@@ -0,0 +1,132 @@
+/* Copyright (C) 2018 Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted for any purpose (including commercial purposes)
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the
+ *    documentation and/or materials provided with the distribution.
+ *
+ * 3. In addition, redistributions of modified forms of the source or binary
+ *    code must carry prominent notices stating that the original code was
+ *    changed and the date of the change.
+ *
+ *  4. All publications or advertising materials mentioning features or use of
+ *     this software are asked, but not required, to acknowledge that it was
+ *     developed by Intel Corporation and credit the contributors.
+ *
+ * 5. Neither the name of Intel Corporation, nor the name of any Contributor
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * Event queue of the fake in-process transports the group protocols are
+ * tested and benchmarked over
+ */
+#ifndef __UTEST_FAKE_QUEUE_H__
+#define __UTEST_FAKE_QUEUE_H__
+
+#include <gurt/common.h>
+
+/* events of fq_ev_size bytes, queued by the senders */
+struct fake_queue {
+	char		*fq_evs;
+	size_t		 fq_ev_size;
+	uint32_t	 fq_head;
+	uint32_t	 fq_tail;
+	uint32_t	 fq_max;
+};
+
+static inline void
+fake_queue_init(struct fake_queue *fq, size_t ev_size)
+{
+	memset(fq, 0, sizeof(*fq));
+	fq->fq_ev_size = ev_size;
+}
+
+static inline void
+fake_queue_fini(struct fake_queue *fq)
+{
+	D_FREE(fq->fq_evs);
+	fq->fq_head = 0;
+	fq->fq_tail = 0;
+	fq->fq_max = 0;
+}
+
+static inline uint32_t
+fake_queue_len(struct fake_queue *fq)
+{
+	return fq->fq_tail - fq->fq_head;
+}
+
+/* Append a zeroed event, NULL if out of memory */
+static inline void *
+fake_queue_add(struct fake_queue *fq)
+{
+	size_t		 size = fq->fq_ev_size;
+	uint32_t	 max;
+	char		*evs;
+	char		*ev;
+
+	if (fq->fq_tail == fq->fq_max) {
+		if (fq->fq_head > fq->fq_max / 2) {
+			/* reuse the room of the events taken */
+			memmove(fq->fq_evs, fq->fq_evs + fq->fq_head * size,
+				fake_queue_len(fq) * size);
+			fq->fq_tail -= fq->fq_head;
+			fq->fq_head = 0;
+		} else {
+			max = 2 * fq->fq_max + 1024;
+			D_REALLOC(evs, fq->fq_evs, max * size);
+			if (evs == NULL)
+				return NULL;
+			fq->fq_evs = evs;
+			fq->fq_max = max;
+		}
+	}
+	ev = fq->fq_evs + fq->fq_tail++ * size;
+	memset(ev, 0, size);
+
+	return ev;
+}
+
+/*
+ * Take the first queued event, a random one if shuffle is set. It is copied
+ * to ev as handling it can queue more events and move the queue.
+ */
+static inline void
+fake_queue_take(struct fake_queue *fq, bool shuffle, void *ev)
+{
+	size_t		size = fq->fq_ev_size;
+	uint32_t	i = fq->fq_head;
+
+	D_ASSERT(fake_queue_len(fq) > 0);
+	if (shuffle)
+		i += random() % fake_queue_len(fq);
+	memcpy(ev, fq->fq_evs + i * size, size);
+	if (i != fq->fq_head)
+		memcpy(fq->fq_evs + i * size, fq->fq_evs + fq->fq_head * size,
+		       size);
+	if (++fq->fq_head == fq->fq_tail) {
+		fq->fq_head = 0;
+		fq->fq_tail = 0;
+	}
+}
+
+#endif /* __UTEST_FAKE_QUEUE_H__ */
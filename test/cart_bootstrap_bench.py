@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# Copyright (C) 2018 Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted for any purpose (including commercial purposes)
+# provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions, and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions, and the following disclaimer in the
+#    documentation and/or materials provided with the distribution.
+#
+# 3. In addition, redistributions of modified forms of the source or binary
+#    code must carry prominent notices stating that the original code was
+#    changed and the date of the change.
+#
+#  4. All publications or advertising materials mentioning features or use of
+#     this software are asked, but not required, to acknowledge that it was
+#     developed by Intel Corporation and credit the contributors.
+#
+# 5. Neither the name of Intel Corporation, nor the name of any Contributor
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# -*- coding: utf-8 -*-
+"""
+cart file-based bootstrap benchmark
+
+Starts N test_group servers on the local node without orterun, bootstrapping
+them through a shared directory (CRT_BOOTSTRAP_DIR), then attaches a client
+that checks in with every rank and shuts the group down. The wall-clock time
+from the first server launch to the client's exit is logged for each N.
+"""
+
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+import commontestsuite
+
+class BootstrapBench(commontestsuite.CommonTestSuite):
+    """ Execute file-based bootstrap benchmark """
+
+    def setUp(self):
+        """setup the test"""
+        self.get_test_info()
+        self.boot_dir = tempfile.mkdtemp(prefix="crt_boot_")
+        self.base_env = dict(os.environ)
+        self.base_env.setdefault("D_LOG_MASK", "WARN")
+        self.base_env.setdefault("CRT_PHY_ADDR_STR", "ofi+sockets")
+        self.base_env.setdefault("OFI_INTERFACE", "lo")
+
+    def tearDown(self):
+        """tear down the test"""
+        self.logger.info("tearDown begin")
+        shutil.rmtree(self.boot_dir, ignore_errors=True)
+        self.logger.info("tearDown end\n")
+
+    def launch(self, args, boot_dir, size, rank=None):
+        """Launch one bootstrapped process"""
+        env = dict(self.base_env)
+        env["CRT_BOOTSTRAP_DIR"] = boot_dir
+        env["CRT_BOOTSTRAP_SIZE"] = str(size)
+        env["CRT_BOOTSTRAP_JOB"] = os.path.basename(boot_dir)
+        if rank is not None:
+            env["CRT_BOOTSTRAP_RANK"] = str(rank)
+        if os.getenv('TR_REDIRECT_OUTPUT', "no").lower() == "no":
+            return subprocess.Popen(args, env=env)
+        return subprocess.Popen(args, env=env,
+                                stdout=subprocess.DEVNULL,
+                                stderr=subprocess.DEVNULL)
+
+    def run_bootstrap(self, testmsg, nproc, pin_ranks):
+        """Bootstrap nproc servers and one client, return elapsed seconds"""
+        boot_dir = tempfile.mkdtemp(dir=self.boot_dir)
+        srv_args = ["tests/test_group", "--name", "service_group",
+                    "--is_service"]
+        cli_args = ["tests/test_group", "--name", "client_group",
+                    "--attach_to", "service_group"]
+
+        start_time = time.time()
+        servers = [self.launch(srv_args, boot_dir, nproc,
+                               rank if pin_ranks else None)
+                   for rank in range(nproc)]
+        client = self.launch(cli_args, boot_dir, 1)
+
+        try:
+            procrtn = client.wait(timeout=180)
+        except subprocess.TimeoutExpired:
+            client.kill()
+            procrtn = -1
+        elapsed = time.time() - start_time
+        if procrtn == 0 and os.path.exists(os.path.join(
+                boot_dir, "client_group.%s.boot.0" %
+                os.path.basename(boot_dir))):
+            self.logger.error("client left its bootstrap file behind")
+            procrtn = -1
+
+        for server in servers:
+            self.stop_process(testmsg, server)
+
+        self.logger.info("bootstrap of %d ranks (pinned: %s): %.3f s, "
+                         "return code %d", nproc, pin_ranks, elapsed,
+                         procrtn)
+        return procrtn
+
+    def test_bootstrap_bench(self):
+        """Time file-based bootstrap for increasing group sizes"""
+        testmsg = self.shortDescription()
+
+        nprocs = [int(n) for n in
+                  os.getenv("CRT_BOOTSTRAP_BENCH_SIZES", "1 8 32").split()]
+        for nproc in nprocs:
+            for pin_ranks in [True, False]:
+                procrtn = self.run_bootstrap(testmsg, nproc, pin_ranks)
+                if procrtn:
+                    self.fail("Bootstrap of %d ranks failed with %d" \
+                              % (nproc, procrtn))
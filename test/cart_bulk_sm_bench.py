@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+# Copyright (C) 2018 Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted for any purpose (including commercial purposes)
+# provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions, and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions, and the following disclaimer in the
+#    documentation and/or materials provided with the distribution.
+#
+# 3. In addition, redistributions of modified forms of the source or binary
+#    code must carry prominent notices stating that the original code was
+#    changed and the date of the change.
+#
+#  4. All publications or advertising materials mentioning features or use of
+#     this software are asked, but not required, to acknowledge that it was
+#     developed by Intel Corporation and credit the contributors.
+#
+# 5. Neither the name of Intel Corporation, nor the name of any Contributor
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# -*- coding: utf-8 -*-
+"""
+cart shared-memory bulk benchmark
+
+Runs self_test against a target on the same node, once with the
+shared-memory bulk path disabled (CRT_BULK_SM=0, i.e. bulk over the NA plugin
+over loopback) and once with it enabled, so the bandwidth reported by
+self_test can be compared.
+"""
+
+import os
+import time
+import commontestsuite
+
+class BulkSmBench(commontestsuite.CommonTestSuite):
+    """ Execute shared-memory bulk benchmark """
+
+    def setUp(self):
+        """setup the test"""
+        self.get_test_info()
+        log_mask = os.getenv("D_LOG_MASK", "WARN")
+        crt_phy_addr = os.getenv("CRT_PHY_ADDR_STR", "ofi+sockets")
+        ofi_interface = os.getenv("OFI_INTERFACE", "lo")
+        baseport = self.generate_port_numbers(ofi_interface)
+        self.pass_env = ' -x D_LOG_MASK={!s} -x CRT_PHY_ADDR_STR={!s}' \
+                        ' -x OFI_INTERFACE={!s} -x OFI_PORT={!s}'.format(
+                            log_mask, crt_phy_addr, ofi_interface, baseport)
+
+    def tearDown(self):
+        """tear down the test"""
+        self.logger.info("tearDown begin")
+        os.environ.pop("CRT_PHY_ADDR_STR", "")
+        os.environ.pop("OFI_INTERFACE", "")
+        os.environ.pop("D_LOG_MASK", "")
+        self.free_port()
+        self.logger.info("tearDown end\n")
+
+    def run_self_test(self, testmsg, host, bulk_sm):
+        """Run one target/self_test pair with CRT_BULK_SM set to bulk_sm"""
+        self_test_dir = os.getenv("CRT_PREFIX_BIN", None)
+        if self_test_dir:
+            self_test_binary = os.path.join(self_test_dir, 'self_test')
+        else:
+            self_test_binary = 'self_test'
+
+        env = self.pass_env + ' -x CRT_BULK_SM={!s}'.format(bulk_sm)
+        srv_args = "tests/test_group" + \
+            " --name target --hold --is_service"
+        server_proc = self.launch_bg(testmsg, '1', env,
+                                     ''.join([' -H ', host]), srv_args)
+        if server_proc is None:
+            self.fail("Server launch failed")
+
+        time.sleep(2)
+
+        if not self.check_process(server_proc):
+            procrtn = self.stop_process(testmsg, server_proc)
+            self.fail("Server did not launch, return code %s" \
+                       % procrtn)
+
+        # bulk-only sizes, from 4KB up to 4MB in each direction
+        message_sizes = "b4096,b4096 b65536,b65536 b1048576,b1048576" + \
+            " b4194304,b4194304"
+
+        client_args = [self_test_binary]
+        client_args.extend(['--group-name', 'target',
+                            '--endpoint', '0:0',
+                            '--message-sizes', message_sizes,
+                            '--max-inflight-rpcs', '16',
+                            '--repetitions', '1000'])
+
+        self.logger.info("self_test with CRT_BULK_SM=%d", bulk_sm)
+        procrtn = self.launch_test(testmsg, '1', env,
+                                   cli=''.join([' -H ', host]),
+                                   cli_arg=' '.join(client_args))
+
+        self.stop_process(testmsg, server_proc)
+        return procrtn
+
+    def test_bulk_sm_bench(self):
+        """Compare bulk bandwidth with and without shared-memory bulk"""
+
+        if not os.getenv('TR_USE_URI', ""):
+            self.skipTest('requires DVM to run.')
+
+        testmsg = self.shortDescription()
+
+        client = self.get_client_list()
+        if not client:
+            self.skipTest('Client list is empty.')
+        host = client.pop(0)
+
+        for bulk_sm in [0, 1]:
+            procrtn = self.run_self_test(testmsg, host, bulk_sm)
+            if procrtn:
+                self.fail("Self test with CRT_BULK_SM=%d failed with %d" \
+                          % (bulk_sm, procrtn))
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+# Copyright (C) 2018 Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted for any purpose (including commercial purposes)
+# provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions, and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions, and the following disclaimer in the
+#    documentation and/or materials provided with the distribution.
+#
+# 3. In addition, redistributions of modified forms of the source or binary
+#    code must carry prominent notices stating that the original code was
+#    changed and the date of the change.
+#
+#  4. All publications or advertising materials mentioning features or use of
+#     this software are asked, but not required, to acknowledge that it was
+#     developed by Intel Corporation and credit the contributors.
+#
+# 5. Neither the name of Intel Corporation, nor the name of any Contributor
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# -*- coding: utf-8 -*-
+"""
+cart multi-rail benchmark
+
+Runs self_test from a client node against all the contexts of a target on a
+server node, once with the first interface of OFI_INTERFACE only and once with
+all of them. The target contexts do not share an NA class, so with several
+interfaces listed they are bound to the rails round-robin and the bandwidth
+reported by self_test is the aggregate over the rails.
+"""
+
+import os
+import time
+import commontestsuite
+
+class MultiRailBench(commontestsuite.CommonTestSuite):
+    """ Execute multi-rail benchmark """
+
+    def setUp(self):
+        """setup the test"""
+        self.get_test_info()
+        log_mask = os.getenv("D_LOG_MASK", "WARN")
+        crt_phy_addr = os.getenv("CRT_PHY_ADDR_STR", "ofi+sockets")
+        self.ofi_interface = os.getenv("OFI_INTERFACE", "eth0")
+        self.ctx_num = os.getenv("CRT_TEST_CTX_NUM", "4")
+        baseport = self.generate_port_numbers(self.ofi_interface)
+        self.pass_env = ' -x D_LOG_MASK={!s} -x CRT_PHY_ADDR_STR={!s}' \
+                        ' -x OFI_PORT={!s} -x CRT_CTX_SHARE_ADDR=0'.format(
+                            log_mask, crt_phy_addr, baseport)
+
+    def tearDown(self):
+        """tear down the test"""
+        self.logger.info("tearDown begin")
+        os.environ.pop("CRT_PHY_ADDR_STR", "")
+        os.environ.pop("OFI_INTERFACE", "")
+        os.environ.pop("D_LOG_MASK", "")
+        self.free_port()
+        self.logger.info("tearDown end\n")
+
+    def run_self_test(self, testmsg, server, client, interfaces):
+        """Run one target/self_test pair with OFI_INTERFACE=interfaces"""
+        self_test_dir = os.getenv("CRT_PREFIX_BIN", None)
+        if self_test_dir:
+            self_test_binary = os.path.join(self_test_dir, 'self_test')
+        else:
+            self_test_binary = 'self_test'
+
+        env = self.pass_env + ' -x OFI_INTERFACE={!s}'.format(interfaces)
+        srv_args = "tests/test_group" + \
+            " --name target --hold --is_service" + \
+            " --ctx_num {!s}".format(self.ctx_num)
+        server_proc = self.launch_bg(testmsg, '1', env,
+                                     ''.join([' -H ', server]), srv_args)
+        if server_proc is None:
+            self.fail("Server launch failed")
+
+        time.sleep(2)
+
+        if not self.check_process(server_proc):
+            procrtn = self.stop_process(testmsg, server_proc)
+            self.fail("Server did not launch, return code %s" \
+                       % procrtn)
+
+        message_sizes = "b1048576,b1048576 b4194304,b4194304"
+        endpoints = "0:0-{!s}".format(int(self.ctx_num) - 1)
+
+        client_args = [self_test_binary]
+        client_args.extend(['--group-name', 'target',
+                            '--endpoint', endpoints,
+                            '--message-sizes', message_sizes,
+                            '--max-inflight-rpcs', '16',
+                            '--repetitions', '1000'])
+
+        self.logger.info("self_test with OFI_INTERFACE=%s", interfaces)
+        procrtn = self.launch_test(testmsg, '1', env,
+                                   cli=''.join([' -H ', client]),
+                                   cli_arg=' '.join(client_args))
+
+        self.stop_process(testmsg, server_proc)
+        return procrtn
+
+    def test_multi_rail_bench(self):
+        """Compare bandwidth over one rail and over all rails"""
+
+        if not os.getenv('TR_USE_URI', ""):
+            self.skipTest('requires DVM to run.')
+
+        testmsg = self.shortDescription()
+
+        servers = self.get_server_list()
+        clients = self.get_client_list()
+        if not servers or not clients:
+            self.skipTest('Server or client list is empty.')
+
+        first = self.ofi_interface.split(',')[0]
+        for interfaces in [first, self.ofi_interface]:
+            procrtn = self.run_self_test(testmsg, servers[0], clients[0],
+                                         interfaces)
+            if procrtn:
+                self.fail("Self test with OFI_INTERFACE=%s failed with %d" \
+                          % (interfaces, procrtn))
@@ -142,3 +142,127 @@ class SelfTest(commontestsuite.CommonTestSuite):
 
         if procrtn:
             self.fail("Self test failed with %d" % procrtn)
+
+    def test_self_test_tree_sweep(self):
+        """Time collectives over each tree and CRT_TREE_AUTO"""
+
+        # Ensure that DVM is running, as this test requires launching two jobs
+        # under the same environment.
+        if not os.getenv('TR_USE_URI', ""):
+            self.skipTest('requires DVM to run.')
+
+        testmsg = self.shortDescription()
+
+        self_test_dir = os.getenv("CRT_PREFIX_BIN", None)
+        if self_test_dir:
+            self_test_binary = os.path.join(self_test_dir, 'self_test')
+        else:
+            self_test_binary = 'self_test'
+
+        servers = self.get_server_list()
+        if not servers:
+            self.skipTest('Server list is empty.')
+
+        client = self.get_client_list()
+        if not client:
+            self.skipTest('Client list is empty.')
+
+        # The collectives go over the ranks of the target group, so give it a
+        # few.
+        srv_args = "tests/test_group" + \
+            " --name target --hold --is_service"
+        server = ''.join([' -H ', servers.pop(0)])
+        server_proc = self.launch_bg(testmsg, '4', self.pass_env, \
+                                     server, srv_args)
+
+        if server_proc is None:
+            self.fail("Server launch failed, return code %s" \
+                       % server_proc.returncode)
+
+        time.sleep(2)
+
+        # Verify the server is still running.
+        if not self.check_process(server_proc):
+            procrtn = self.stop_process(testmsg, server_proc)
+            self.fail("Server did not launch, return code %s" \
+                       % procrtn)
+        self.logger.info("Server running")
+
+        client_args = [self_test_binary]
+        client_args.extend(['--group-name', 'target',
+                            '--master-endpoint', '0:0',
+                            '--tree-sweep',
+                            '--message-sizes', '0,b4096',
+                            '--repetitions', '20'])
+
+        procrtn = self.launch_test(testmsg, '1', self.pass_env, \
+                                   cli=''.join([' -H ', client.pop(0)]), \
+                                   cli_arg=' '.join(client_args))
+
+        self.stop_process(testmsg, server_proc)
+
+        if procrtn:
+            self.fail("Self test tree sweep failed with %d" % procrtn)
+
+    def test_self_test_coll(self):
+        """Time allgathers and all-to-alls over the target group"""
+
+        # Ensure that DVM is running, as this test requires launching two jobs
+        # under the same environment.
+        if not os.getenv('TR_USE_URI', ""):
+            self.skipTest('requires DVM to run.')
+
+        testmsg = self.shortDescription()
+
+        self_test_dir = os.getenv("CRT_PREFIX_BIN", None)
+        if self_test_dir:
+            self_test_binary = os.path.join(self_test_dir, 'self_test')
+        else:
+            self_test_binary = 'self_test'
+
+        servers = self.get_server_list()
+        if not servers:
+            self.skipTest('Server list is empty.')
+
+        client = self.get_client_list()
+        if not client:
+            self.skipTest('Client list is empty.')
+
+        # The collectives go over all ranks of the target group.
+        srv_args = "tests/test_group" + \
+            " --name target --hold --is_service"
+        server = ''.join([' -H ', servers.pop(0)])
+        server_proc = self.launch_bg(testmsg, '4', self.pass_env, \
+                                     server, srv_args)
+
+        if server_proc is None:
+            self.fail("Server launch failed, return code %s" \
+                       % server_proc.returncode)
+
+        time.sleep(2)
+
+        # Verify the server is still running.
+        if not self.check_process(server_proc):
+            procrtn = self.stop_process(testmsg, server_proc)
+            self.fail("Server did not launch, return code %s" \
+                       % procrtn)
+        self.logger.info("Server running")
+
+        for coll in ['allgather', 'alltoall']:
+            client_args = [self_test_binary]
+            client_args.extend(['--group-name', 'target',
+                                '--master-endpoint', '0:0',
+                                '--coll', coll,
+                                '--message-sizes', '8,4096',
+                                '--repetitions', '20'])
+
+            procrtn = self.launch_test(testmsg, '1', self.pass_env, \
+                                       cli=''.join([' -H ', client[0]]), \
+                                       cli_arg=' '.join(client_args))
+            if procrtn:
+                break
+
+        self.stop_process(testmsg, server_proc)
+
+        if procrtn:
+            self.fail("Self test collectives failed with %d" % procrtn)
@@ -107,6 +107,44 @@ class TestGroup(commontestsuite.CommonTestSuite):
         if procrtn:
             self.fail("Failed, return code %d" % procrtn)
 
+    def test_group_uri_batch(self):
+        """Process group test with batched URI lookups on one node"""
+        testmsg = self.shortDescription()
+        clients = self.get_client_list()
+        if clients:
+            self.skipTest('Client list is not empty.')
+
+        # No warmup, the client sends to the 8 contexts of the service at
+        # once so their URI lookups are batched.
+        procrtn = self.launch_test(testmsg, '1', self.pass_env, \
+                                   cli_arg='tests/test_group' + \
+                                             ' --name client_group' + \
+                                             ' --attach_to service_group' + \
+                                             ' --ctx_num 8 --batch',
+                                   srv_arg='tests/test_group' + \
+                                             ' --name service_group' + \
+                                             ' --is_service --ctx_num 8')
+        if procrtn:
+            self.fail("Failed, return code %d" % procrtn)
+
+    def test_group_warmup(self):
+        """Process group test with a warmup of the URIs on one node"""
+        testmsg = self.shortDescription()
+        clients = self.get_client_list()
+        if clients:
+            self.skipTest('Client list is not empty.')
+
+        procrtn = self.launch_test(testmsg, '1', self.pass_env, \
+                                   cli_arg='tests/test_group' + \
+                                             ' --name client_group' + \
+                                             ' --attach_to service_group' + \
+                                             ' --ctx_num 8 --warmup',
+                                   srv_arg='tests/test_group' + \
+                                             ' --name service_group' + \
+                                             ' --is_service --ctx_num 8')
+        if procrtn:
+            self.fail("Failed, return code %d" % procrtn)
+
     def test_group_two_nodes(self):
         """Simple process group test two node"""
 